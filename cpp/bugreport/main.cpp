@@ -67,6 +67,8 @@ constexpr const int kWaitTimeBetweenConnectAttemptsInSec = 1;
 constexpr const int kDumpstateTimeoutInSec = 600;
 // The prefix for screenshot filename in the generated zip file.
 constexpr const char* kScreenshotPrefix = "/screenshot";
+// Wait time for the screenshots of all the displays, which are captured in parallel.
+constexpr const int kScreenshotTimeoutInSec = 10;
 
 using android::OK;
 using android::PhysicalDisplayId;
@@ -276,57 +278,28 @@ bool doBugreport(int progress_socket, size_t* out_bytes_written, std::string* zi
     return true;
 }
 
-bool waitpid_with_timeout(pid_t pid, int timeout_secs, int* status) {
-    sigset_t child_mask, old_mask;
-    sigemptyset(&child_mask);
-    sigaddset(&child_mask, SIGCHLD);
-
-    if (sigprocmask(SIG_BLOCK, &child_mask, &old_mask) == -1) {
-        ALOGE("*** sigprocmask failed: %s\n", strerror(errno));
-        return false;
-    }
-
-    timespec ts = {.tv_sec = timeout_secs, .tv_nsec = 0};
-    int ret = TEMP_FAILURE_RETRY(sigtimedwait(&child_mask, nullptr, &ts));
-    int saved_errno = errno;
-
-    // Set the signals back the way they were.
-    if (sigprocmask(SIG_SETMASK, &old_mask, nullptr) == -1) {
-        ALOGE("*** sigprocmask failed: %s\n", strerror(errno));
-        if (ret == 0) {
-            return false;
-        }
-    }
-    if (ret == -1) {
-        errno = saved_errno;
-        if (errno == EAGAIN) {
-            errno = ETIMEDOUT;
-        } else {
-            ALOGE("*** sigtimedwait failed: %s\n", strerror(errno));
-        }
-        return false;
-    }
-
-    pid_t child_pid = waitpid(pid, status, WNOHANG);
-    if (child_pid != pid) {
-        if (child_pid != -1) {
-            ALOGE("*** Waiting for pid %d, got pid %d instead\n", pid, child_pid);
-        } else {
-            ALOGE("*** waitpid failed: %s\n", strerror(errno));
-        }
-        return false;
-    }
-    return true;
-}
-
-// Runs the given command. Kills the command if it does not finish by timeout.
-int runCommand(int timeout_secs, const char* file, std::vector<const char*> args) {
+// Screenshots being captured by screencap processes that run in parallel.
+struct PendingScreenshots {
+    // The pids of the running screencap processes, -1 for the already reaped ones.
+    std::vector<pid_t> pids;
+    std::vector<std::string> display_ids;
+    // All screencap processes are killed if they are still running at this time.
+    int64_t deadline_millis = 0;
+    // Whether SIGCHLD is blocked, and the signal mask before it was blocked.
+    bool is_sigchld_blocked = false;
+    sigset_t old_mask;
+};
+
+// Forks and executes the given command with |signal_mask| as its signal mask.
+// Returns the pid of the command or -1 on failure.
+pid_t startCommand(const char* file, const std::vector<const char*>& args,
+                   const sigset_t& signal_mask) {
     pid_t pid = fork();
 
     // handle error case
     if (pid < 0) {
         ALOGE("fork failed %s", strerror(errno));
-        return pid;
+        return -1;
     }
 
     // handle child case
@@ -334,6 +307,9 @@ int runCommand(int timeout_secs, const char* file, std::vector<const char*> args
         /* make sure the child dies when parent dies */
         prctl(PR_SET_PDEATHSIG, SIGKILL);
 
+        /* the signal mask is inherited through exec, don't leave SIGCHLD blocked */
+        sigprocmask(SIG_SETMASK, &signal_mask, nullptr);
+
         /* just ignore SIGPIPE, will go down with parent's */
         struct sigaction sigact;
         memset(&sigact, 0, sizeof(sigact));
@@ -341,65 +317,115 @@ int runCommand(int timeout_secs, const char* file, std::vector<const char*> args
         sigaction(SIGPIPE, &sigact, nullptr);
 
         execvp(file, const_cast<char* const*>(args.data()));
-        // execvp's result will be handled after waitpid_with_timeout() below, but
-        // if it failed, it's safer to exit dumpstate.
         ALOGE("execvp on command %s failed (error: %s)", file, strerror(errno));
         _exit(EXIT_FAILURE);
     }
+    return pid;
+}
 
-    // handle parent case
-    int status;
-    bool ret = waitpid_with_timeout(pid, timeout_secs, &status);
+// Starts capturing the screenshots of all the physical displays in parallel, and adds the
+// screenshot files to |extra_files|. The captures must be collected by waitForScreenshots().
+PendingScreenshots startScreenshots(const char* tmp_dir, std::vector<std::string>* extra_files) {
+    PendingScreenshots pending;
+    pending.deadline_millis = android::uptimeMillis() + kScreenshotTimeoutInSec * 1000;
 
-    if (!ret) {
-        if (errno == ETIMEDOUT) {
-            ALOGE("command %s timed out (killing pid %d)", file, pid);
-        } else {
-            ALOGE("command %s: Error (killing pid %d)\n", file, pid);
-        }
-        kill(pid, SIGTERM);
-        if (!waitpid_with_timeout(pid, 5, nullptr)) {
-            kill(pid, SIGKILL);
-            if (!waitpid_with_timeout(pid, 5, nullptr)) {
-                ALOGE("could not kill command '%s' (pid %d) even with SIGKILL.\n", file, pid);
-            }
-        }
-        return -1;
+    // Block SIGCHLD before forking, so that no exit of a screencap process is missed while
+    // waiting for it with sigtimedwait().
+    sigset_t child_mask;
+    sigemptyset(&child_mask);
+    sigaddset(&child_mask, SIGCHLD);
+    if (sigprocmask(SIG_BLOCK, &child_mask, &pending.old_mask) == -1) {
+        ALOGE("*** sigprocmask failed: %s\n", strerror(errno));
+        return pending;
     }
+    pending.is_sigchld_blocked = true;
 
-    if (WIFSIGNALED(status)) {
-        ALOGE("command '%s' failed: killed by signal %d\n", file, WTERMSIG(status));
-    } else if (WIFEXITED(status) && WEXITSTATUS(status) > 0) {
-        status = WEXITSTATUS(status);
-        ALOGE("command '%s' failed: exit code %d\n", file, status);
+    std::vector<PhysicalDisplayId> ids = SurfaceComposerClient::getPhysicalDisplayIds();
+    for (PhysicalDisplayId id : ids) {
+        std::string id_as_string = to_string(id);
+        std::string filename = std::string(tmp_dir) + kScreenshotPrefix + id_as_string + ".png";
+        std::vector<const char*> args{"-p", "-d", id_as_string.c_str(), filename.c_str(),
+                                      nullptr};
+        ALOGI("capturing screen for display (%s) as %s", id_as_string.c_str(), filename.c_str());
+        pid_t pid = startCommand("/system/bin/screencap", args, pending.old_mask);
+        if (pid == -1) {
+            ALOGW("Failed to take screenshot for display: %s", id_as_string.c_str());
+        } else {
+            pending.pids.push_back(pid);
+            pending.display_ids.push_back(id_as_string);
+        }
+        // add the file regardless of the exit status of the screencap util.
+        extra_files->push_back(filename);
     }
-
-    return status;
+    return pending;
 }
 
-void takeScreenshotForDisplayId(PhysicalDisplayId id, const char* tmp_dir,
-                                std::vector<std::string>* extra_files) {
-    std::string id_as_string = to_string(id);
-    std::string filename = std::string(tmp_dir) + kScreenshotPrefix + id_as_string + ".png";
-    std::vector<const char*> args{"-p", "-d", id_as_string.c_str(), filename.c_str(), nullptr};
-    ALOGI("capturing screen for display (%s) as %s", id_as_string.c_str(), filename.c_str());
-    int status = runCommand(10, "/system/bin/screencap", args);
-    if (status == 0) {
-        ALOGI("Screenshot saved for display: %s", id_as_string.c_str());
+// Logs the result of the screencap process that exited with |status|.
+void logScreenshotStatus(const std::string& display_id, int status) {
+    if (WIFEXITED(status) && WEXITSTATUS(status) == 0) {
+        ALOGI("Screenshot saved for display: %s", display_id.c_str());
+    } else if (WIFSIGNALED(status)) {
+        ALOGW("Failed to take screenshot for display: %s, killed by signal %d",
+              display_id.c_str(), WTERMSIG(status));
     } else {
-        ALOGW("Failed to take screenshot for display: %s", id_as_string.c_str());
+        ALOGW("Failed to take screenshot for display: %s, exit code %d", display_id.c_str(),
+              WEXITSTATUS(status));
     }
-    // add the file regardless of the exit status of the screencap util.
-    extra_files->push_back(filename);
 }
 
-void takeScreenshot(const char* tmp_dir, std::vector<std::string>* extra_files) {
-    // Now send the screencaptures
-    std::vector<PhysicalDisplayId> ids = SurfaceComposerClient::getPhysicalDisplayIds();
-
-    for (PhysicalDisplayId display_id : ids) {
-        takeScreenshotForDisplayId(display_id, tmp_dir, extra_files);
+// Waits until all the screencap processes started by startScreenshots() exit. Kills the ones
+// still running at the deadline.
+void waitForScreenshots(PendingScreenshots* pending) {
+    if (!pending->is_sigchld_blocked) {
+        return;
+    }
+    sigset_t child_mask;
+    sigemptyset(&child_mask);
+    sigaddset(&child_mask, SIGCHLD);
+    size_t remaining = pending->pids.size();
+    while (remaining > 0) {
+        // SIGCHLD signals of the processes exiting at the same time are merged, so reap all the
+        // exited processes after each signal.
+        for (size_t i = 0; i < pending->pids.size(); i++) {
+            int status;
+            if (pending->pids[i] == -1 ||
+                TEMP_FAILURE_RETRY(waitpid(pending->pids[i], &status, WNOHANG)) == 0) {
+                continue;
+            }
+            logScreenshotStatus(pending->display_ids[i], status);
+            pending->pids[i] = -1;
+            remaining--;
+        }
+        int64_t timeout_millis = pending->deadline_millis - android::uptimeMillis();
+        if (remaining == 0 || timeout_millis <= 0) {
+            break;
+        }
+        timespec ts = {.tv_sec = static_cast<time_t>(timeout_millis / 1000),
+                       .tv_nsec = static_cast<long>(timeout_millis % 1000) * 1000000};
+        if (TEMP_FAILURE_RETRY(sigtimedwait(&child_mask, nullptr, &ts)) == -1 &&
+            errno != EAGAIN) {
+            ALOGE("*** sigtimedwait failed: %s\n", strerror(errno));
+            break;
+        }
     }
+    for (size_t i = 0; i < pending->pids.size(); i++) {
+        if (pending->pids[i] == -1) {
+            continue;
+        }
+        ALOGE("screenshot for display %s timed out (killing pid %d)",
+              pending->display_ids[i].c_str(), pending->pids[i]);
+        kill(pending->pids[i], SIGKILL);
+        TEMP_FAILURE_RETRY(waitpid(pending->pids[i], nullptr, 0));
+        pending->pids[i] = -1;
+    }
+    // Drop the SIGCHLD signals of the reaped processes before unblocking SIGCHLD.
+    timespec no_wait = {.tv_sec = 0, .tv_nsec = 0};
+    while (sigtimedwait(&child_mask, nullptr, &no_wait) == SIGCHLD) {
+    }
+    if (sigprocmask(SIG_SETMASK, &pending->old_mask, nullptr) == -1) {
+        ALOGE("*** sigprocmask failed: %s\n", strerror(errno));
+    }
+    pending->is_sigchld_blocked = false;
 }
 
 bool recursiveRemoveDir(const std::string& path) {
@@ -453,9 +479,11 @@ int main(void) {
     auto started_at_millis = android::elapsedRealtime();
 
     std::vector<std::string> extra_files;
+    PendingScreenshots screenshots;
     if (createTempDir(kTempDirectory) == OK) {
-        // take screenshots of the physical displays as early as possible
-        takeScreenshot(kTempDirectory, &extra_files);
+        // take screenshots of the physical displays as early as possible, they are captured
+        // while dumpstate runs.
+        screenshots = startScreenshots(kTempDirectory, &extra_files);
     }
 
     // Start the dumpstatez service.
@@ -468,6 +496,7 @@ int main(void) {
     if (progress_socket < 0) {
         // early out. in this case we will not print the final message, but that is ok.
         android::base::SetProperty("ctl.stop", "cardumpstatez");
+        waitForScreenshots(&screenshots);
         return EXIT_FAILURE;
     }
     bool is_success = doBugreport(progress_socket, &bytes_written, &zip_path);
@@ -481,6 +510,8 @@ int main(void) {
         }
     }
 
+    waitForScreenshots(&screenshots);
+
     int extra_output_socket = openSocket(kCarBrExtraOutputSocket);
     if (extra_output_socket != -1 && is_success) {
         zipFilesToFd(extra_files, extra_output_socket);
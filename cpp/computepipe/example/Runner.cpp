@@ -19,6 +19,7 @@
 #include <iostream>
 #include <memory>
 #include <thread>
+#include <vector>
 
 #include "ClientConfig.pb.h"
 #include "ClientInterface.h"
@@ -50,27 +51,46 @@ void terminate(bool isError, std::string msg) {
     exit(0);
 }
 
-int main(int /* argc */, char** /* argv */) {
-    std::shared_ptr<RunnerEngine> engine =
-            sEngineFactory.createRunnerEngine(RunnerEngineFactory::kDefault, "");
+// Hosts the graphs of the libraries given on the command line, or the face graph by default.
+// Each graph gets an engine and a client interface of its own, while the graphs using the same
+// camera share its stream.
+int main(int argc, char** argv) {
+    std::vector<std::string> graphLibraries(argv + 1, argv + argc);
+    if (graphLibraries.empty()) {
+        graphLibraries.push_back("libfacegraph.so");
+    }
+    const std::string engineArgs = graphLibraries.size() > 1 ? "shared_inputs" : "";
+
+    std::vector<std::shared_ptr<RunnerEngine>> engines;
+    for (const std::string& graphLibrary : graphLibraries) {
+        std::shared_ptr<RunnerEngine> engine =
+                sEngineFactory.createRunnerEngine(RunnerEngineFactory::kDefault, engineArgs);
 
-    std::unique_ptr<PrebuiltGraph> graph;
-    graph.reset(android::automotive::computepipe::graph::GetLocalGraphFromLibrary("libfacegraph.so",
-                                                                                  engine));
+        std::unique_ptr<PrebuiltGraph> graph;
+        graph.reset(android::automotive::computepipe::graph::GetLocalGraphFromLibrary(
+                graphLibrary, engine));
+        if (!graph) {
+            std::cerr << "Unable to load graph " << graphLibrary;
+            return -1;
+        }
 
-    Options options = graph->GetSupportedGraphConfigs();
-    engine->setPrebuiltGraph(std::move(graph));
+        Options options = graph->GetSupportedGraphConfigs();
+        engine->setPrebuiltGraph(std::move(graph));
 
-    std::function<void(bool, std::string)> cb = terminate;
-    std::unique_ptr<ClientInterface> client =
-        sClientFactory.createClientInterface("aidl", options, engine);
-    if (!client) {
-        std::cerr << "Unable to allocate client";
-        return -1;
+        std::unique_ptr<ClientInterface> client =
+            sClientFactory.createClientInterface("aidl", options, engine);
+        if (!client) {
+            std::cerr << "Unable to allocate client";
+            return -1;
+        }
+        engine->setClientInterface(std::move(client));
+        engines.push_back(engine);
     }
-    engine->setClientInterface(std::move(client));
+
     ABinderProcess_startThreadPool();
-    engine->activate();
+    for (auto& engine : engines) {
+        engine->activate();
+    }
     ABinderProcess_joinThreadPool();
     return 0;
 }
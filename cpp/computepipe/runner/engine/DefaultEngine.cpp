@@ -63,6 +63,11 @@ void DefaultEngine::setPrebuiltGraph(std::unique_ptr<PrebuiltGraph>&& graph) {
     }
 }
 
+void DefaultEngine::setInputManagerPool(
+        std::shared_ptr<input_manager::SharedInputManagerPool> pool) {
+    mInputManagerPool = pool;
+}
+
 Status DefaultEngine::setArgs(std::string engineArgs) {
     mEngineArgs = engineArgs;
     auto pos = engineArgs.find(kNoInputManager);
@@ -599,9 +604,15 @@ Status DefaultEngine::populateInputManagers(const ClientConfig& config) {
                     return this->mGraph->SetInputStreamPixelData(streamId, timestamp, frame);
                 });
             proto::InputConfig overrideConfig;
-            mInputManagers.emplace(selectedId,
-                                   mInputFactory.createInputManager(
-                                        inputDescriptor, overrideConfig, cb));
+            if (mInputManagerPool) {
+                mInputManagers.emplace(selectedId,
+                                       mInputManagerPool->createInputManager(
+                                            inputDescriptor, overrideConfig, cb));
+            } else {
+                mInputManagers.emplace(selectedId,
+                                       mInputFactory.createInputManager(
+                                            inputDescriptor, overrideConfig, cb));
+            }
             if (mInputManagers[selectedId] == nullptr) {
                 LOG(ERROR) << "unable to create input manager for stream " << selectedId;
                 // TODO: Add print
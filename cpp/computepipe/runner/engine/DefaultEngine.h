@@ -28,6 +28,7 @@
 #include "InputManager.h"
 #include "Options.pb.h"
 #include "RunnerEngine.h"
+#include "SharedInputManager.h"
 #include "StreamManager.h"
 
 namespace android {
@@ -83,6 +84,7 @@ class DefaultEngine : public RunnerEngine {
   public:
     static constexpr char kDisplayStreamId[] = "display_stream:";
     static constexpr char kNoInputManager[] = "no_input_manager";
+    static constexpr char kSharedInputs[] = "shared_inputs";
     static constexpr char kResetPhase[] = "Reset";
     static constexpr char kConfigPhase[] = "Config";
     static constexpr char kRunPhase[] = "Running";
@@ -94,6 +96,11 @@ class DefaultEngine : public RunnerEngine {
     void setClientInterface(std::unique_ptr<client_interface::ClientInterface>&& client) override;
     void setPrebuiltGraph(std::unique_ptr<graph::PrebuiltGraph>&& graph) override;
     Status activate() override;
+    /**
+     * Create the input managers through |pool|, so the cameras are shared with the other engines
+     * of the runner that use the same pool.
+     */
+    void setInputManagerPool(std::shared_ptr<input_manager::SharedInputManagerPool> pool);
     /**
      * Methods from ClientEngineInterface to override
      */
@@ -239,6 +246,7 @@ class DefaultEngine : public RunnerEngine {
      */
     std::map<int, std::unique_ptr<input_manager::InputManager>> mInputManagers;
     input_manager::InputManagerFactory mInputFactory;
+    std::shared_ptr<input_manager::SharedInputManagerPool> mInputManagerPool = nullptr;
     /**
      * stream to dump to display for debug purposes
      */
@@ -22,11 +22,15 @@ namespace runner {
 namespace engine {
 
 namespace {
-std::unique_ptr<DefaultEngine> createDefaultEngine(std::string engine_args) {
+std::unique_ptr<DefaultEngine> createDefaultEngine(
+        std::string engine_args, std::shared_ptr<input_manager::SharedInputManagerPool> pool) {
     std::unique_ptr<DefaultEngine> engine = std::make_unique<DefaultEngine>();
     if (engine->setArgs(engine_args) != Status::SUCCESS) {
         return nullptr;
     }
+    if (pool) {
+        engine->setInputManagerPool(pool);
+    }
     return engine;
 }
 }  // namespace
@@ -34,7 +38,14 @@ std::unique_ptr<DefaultEngine> createDefaultEngine(std::string engine_args) {
 std::unique_ptr<RunnerEngine> RunnerEngineFactory::createRunnerEngine(std::string engine,
                                                                       std::string engine_args) {
     if (engine == kDefault) {
-        return createDefaultEngine(engine_args);
+        std::shared_ptr<input_manager::SharedInputManagerPool> pool = nullptr;
+        if (engine_args.find(DefaultEngine::kSharedInputs) != std::string::npos) {
+            if (!mInputManagerPool) {
+                mInputManagerPool = std::make_shared<input_manager::SharedInputManagerPool>();
+            }
+            pool = mInputManagerPool;
+        }
+        return createDefaultEngine(engine_args, pool);
     }
     return nullptr;
 }
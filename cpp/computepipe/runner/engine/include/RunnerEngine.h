@@ -26,6 +26,10 @@ namespace android {
 namespace automotive {
 namespace computepipe {
 namespace runner {
+namespace input_manager {
+class SharedInputManagerPool;
+}  // namespace input_manager
+
 namespace engine {
 
 /**
@@ -56,10 +60,18 @@ class RunnerEngine : public client_interface::ClientEngineInterface,
 class RunnerEngineFactory {
   public:
     static constexpr char kDefault[] = "default_engine";
+    /**
+     * Engines created with the "shared_inputs" arg share their cameras with the other such
+     * engines created by this factory, so a runner can host several graphs using the same
+     * cameras.
+     */
     std::unique_ptr<RunnerEngine> createRunnerEngine(std::string engine, std::string engine_args);
     RunnerEngineFactory(const RunnerEngineFactory&) = delete;
     RunnerEngineFactory& operator=(const RunnerEngineFactory&) = delete;
     RunnerEngineFactory() = default;
+
+  private:
+    std::shared_ptr<input_manager::SharedInputManagerPool> mInputManagerPool = nullptr;
 };
 
 }  // namespace engine
@@ -19,6 +19,7 @@
 
 #include <functional>
 #include <iostream>
+#include <map>
 #include <mutex>
 #include <shared_mutex>
 #include <string>
@@ -39,16 +40,15 @@ namespace graph {
 #define LOAD_FUNCTION(name)                                                        \
     {                                                                              \
         std::string func_name = std::string("PrebuiltComputepipeRunner_") + #name; \
-        mPrebuiltGraphInstance->mFn##name =                                        \
-                dlsym(mPrebuiltGraphInstance->mHandle, func_name.c_str());         \
-        if (mPrebuiltGraphInstance->mFn##name == nullptr) {                        \
+        graph->mFn##name = dlsym(graph->mHandle, func_name.c_str());               \
+        if (graph->mFn##name == nullptr) {                                         \
             initialized = false;                                                   \
             LOG(ERROR) << std::string(dlerror()) << std::endl;                     \
         }                                                                          \
     }
 
 std::mutex LocalPrebuiltGraph::mCreationMutex;
-LocalPrebuiltGraph* LocalPrebuiltGraph::mPrebuiltGraphInstance = nullptr;
+std::map<std::string, LocalPrebuiltGraph*> LocalPrebuiltGraph::mPrebuiltGraphInstances;
 
 // Function to confirm that there would be no further changes to the graph configuration. This
 // needs to be called before starting the graph.
@@ -179,24 +179,25 @@ LocalPrebuiltGraph* LocalPrebuiltGraph::GetPrebuiltGraphFromLibrary(
         const std::string& prebuilt_library,
         std::weak_ptr<PrebuiltEngineInterface> engineInterface) {
     std::unique_lock<std::mutex> lock(LocalPrebuiltGraph::mCreationMutex);
-    if (mPrebuiltGraphInstance == nullptr) {
-        mPrebuiltGraphInstance = new LocalPrebuiltGraph();
+    // A runner hosting several graphs loads each of their libraries into its own instance.
+    LocalPrebuiltGraph*& graph = mPrebuiltGraphInstances[prebuilt_library];
+    if (graph == nullptr) {
+        graph = new LocalPrebuiltGraph();
     }
-    if (mPrebuiltGraphInstance->mGraphState.load() != PrebuiltGraphState::UNINITIALIZED) {
-        return mPrebuiltGraphInstance;
+    if (graph->mGraphState.load() != PrebuiltGraphState::UNINITIALIZED) {
+        return graph;
     }
-    mPrebuiltGraphInstance->mHandle = dlopen(prebuilt_library.c_str(), RTLD_NOW);
+    graph->mHandle = dlopen(prebuilt_library.c_str(), RTLD_NOW);
 
-    if (mPrebuiltGraphInstance->mHandle) {
+    if (graph->mHandle) {
         bool initialized = true;
 
         // Load config and version number first.
         const unsigned char* (*getVersionFn)() =
-                (const unsigned char* (*)())dlsym(mPrebuiltGraphInstance->mHandle,
+                (const unsigned char* (*)())dlsym(graph->mHandle,
                                                   "PrebuiltComputepipeRunner_GetVersion");
         if (getVersionFn != nullptr) {
-            mPrebuiltGraphInstance->mGraphVersion =
-                    std::string(reinterpret_cast<const char*>(getVersionFn()));
+            graph->mGraphVersion = std::string(reinterpret_cast<const char*>(getVersionFn()));
         } else {
             LOG(ERROR) << std::string(dlerror());
             initialized = false;
@@ -204,7 +205,7 @@ LocalPrebuiltGraph* LocalPrebuiltGraph::GetPrebuiltGraphFromLibrary(
 
         void (*getSupportedGraphConfigsFn)(const void**, size_t*) =
                 (void (*)(const void**,
-                          size_t*))dlsym(mPrebuiltGraphInstance->mHandle,
+                          size_t*))dlsym(graph->mHandle,
                                          "PrebuiltComputepipeRunner_GetSupportedGraphConfigs");
         if (getSupportedGraphConfigsFn != nullptr) {
             size_t graphConfigSize;
@@ -213,7 +214,7 @@ LocalPrebuiltGraph* LocalPrebuiltGraph::GetPrebuiltGraphFromLibrary(
             getSupportedGraphConfigsFn(&graphConfig, &graphConfigSize);
 
             if (graphConfigSize > 0) {
-                initialized &= mPrebuiltGraphInstance->mGraphConfig.ParseFromString(
+                initialized &= graph->mGraphConfig.ParseFromString(
                         std::string(reinterpret_cast<const char*>(graphConfig), graphConfigSize));
             }
         } else {
@@ -245,12 +246,12 @@ LocalPrebuiltGraph* LocalPrebuiltGraph::GetPrebuiltGraphFromLibrary(
         // lock around object creation, so no need to hold the graphState lock
         // here.
         if (initialized) {
-            mPrebuiltGraphInstance->mGraphState.store(PrebuiltGraphState::STOPPED);
-            mPrebuiltGraphInstance->mEngineInterface = engineInterface;
+            graph->mGraphState.store(PrebuiltGraphState::STOPPED);
+            graph->mEngineInterface = engineInterface;
         }
     }
 
-    return mPrebuiltGraphInstance;
+    return graph;
 }
 
 LocalPrebuiltGraph::~LocalPrebuiltGraph() {
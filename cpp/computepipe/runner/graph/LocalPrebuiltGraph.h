@@ -16,6 +16,7 @@
 #define COMPUTEPIPE_RUNNER_GRAPH_GRPC_GRAPH_H
 
 #include <functional>
+#include <map>
 #include <shared_mutex>
 #include <string>
 
@@ -114,7 +115,8 @@ class LocalPrebuiltGraph : public PrebuiltGraph {
     std::weak_ptr<PrebuiltEngineInterface> mEngineInterface;
 
     static std::mutex mCreationMutex;
-    static LocalPrebuiltGraph* mPrebuiltGraphInstance;
+    // Instances by library path
+    static std::map<std::string, LocalPrebuiltGraph*> mPrebuiltGraphInstances;
 
     // Even though mutexes are generally preferred over atomics, the only varialble in this class
     // that changes after initialization is graph state and that is the only vairable that needs
@@ -0,0 +1,332 @@
+// Copyright 2024 The Android Open Source Project
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "SharedInputManager.h"
+
+#include <android-base/logging.h>
+
+#include <set>
+#include <shared_mutex>
+#include <vector>
+
+#include "EventGenerator.h"
+
+namespace android {
+namespace automotive {
+namespace computepipe {
+namespace runner {
+namespace input_manager {
+
+using ::android::automotive::computepipe::runner::generator::DefaultEvent;
+
+namespace {
+
+/**
+ * Receives the frames of a shared camera and forwards them to the running subscribers. A frame
+ * is only borrowed from the underlying input manager for the duration of the dispatch, so all the
+ * subscribers see the same buffer and none of them pays for a copy or an import of its own.
+ */
+class FanOutCallback : public InputEngineInterface {
+  public:
+    void subscribe(const void* subscriber, int streamId,
+                   std::shared_ptr<InputEngineInterface> engine) {
+        std::lock_guard lock(mSubscribersLock);
+        mSubscribers[subscriber] = {streamId, engine};
+    }
+
+    // Returns the number of subscribers left
+    size_t unsubscribe(const void* subscriber) {
+        std::lock_guard lock(mSubscribersLock);
+        mSubscribers.erase(subscriber);
+        return mSubscribers.size();
+    }
+
+    Status dispatchInputFrame(int /* streamId */, int64_t timestamp,
+                              const InputFrame& frame) override {
+        std::shared_lock lock(mSubscribersLock);
+        Status status = Status::SUCCESS;
+        for (auto& [subscriber, target] : mSubscribers) {
+            Status ret = target.engine->dispatchInputFrame(target.streamId, timestamp, frame);
+            if (ret != Status::SUCCESS) {
+                LOG(ERROR) << "Failed to dispatch a shared input frame to stream "
+                           << target.streamId;
+                status = ret;
+            }
+        }
+        return status;
+    }
+
+    void notifyInputError() override {
+        std::shared_lock lock(mSubscribersLock);
+        for (auto& [subscriber, target] : mSubscribers) {
+            target.engine->notifyInputError();
+        }
+    }
+
+  private:
+    struct Target {
+        int streamId;
+        std::shared_ptr<InputEngineInterface> engine;
+    };
+
+    std::shared_mutex mSubscribersLock;
+    std::map<const void*, Target> mSubscribers;
+};
+
+}  // namespace
+
+/**
+ * A camera opened by the pool. The underlying input manager runs as long as one of the graphs
+ * using the camera is running.
+ */
+class SharedInputSource {
+  public:
+    SharedInputSource(std::unique_ptr<InputManager> inputManager,
+                      std::shared_ptr<FanOutCallback> fanOut,
+                      const proto::InputStreamConfig& streamConfig,
+                      const proto::InputConfig& overrideConfig)
+        : mInputManager(std::move(inputManager)),
+          mFanOut(fanOut),
+          mCameraConfig(getCameraConfig(streamConfig)),
+          mOverrideConfig(overrideConfig.SerializeAsString()) {
+    }
+
+    Status startStreaming(const void* subscriber, int streamId,
+                          std::shared_ptr<InputEngineInterface> engine) {
+        std::lock_guard lock(mLock);
+        if (mSubscribers.count(subscriber) != 0) {
+            return Status::SUCCESS;
+        }
+        mFanOut->subscribe(subscriber, streamId, engine);
+        if (mSubscribers.empty()) {
+            Status ret = mInputManager->handleExecutionPhase(
+                    DefaultEvent::generateEntryEvent(DefaultEvent::RUN));
+            if (ret != Status::SUCCESS) {
+                mFanOut->unsubscribe(subscriber);
+                return ret;
+            }
+            (void)mInputManager->handleExecutionPhase(
+                    DefaultEvent::generateTransitionCompleteEvent(DefaultEvent::RUN));
+        }
+        mSubscribers.insert(subscriber);
+        return Status::SUCCESS;
+    }
+
+    /**
+     * Returns whether the camera is opened with |streamConfig| and |overrideConfig|. The stream
+     * id is not compared, since each graph assigns its own.
+     */
+    bool isOpenedWith(const proto::InputStreamConfig& streamConfig,
+                      const proto::InputConfig& overrideConfig) const {
+        return getCameraConfig(streamConfig) == mCameraConfig &&
+               overrideConfig.SerializeAsString() == mOverrideConfig;
+    }
+
+    void stopStreaming(const void* subscriber, DefaultEvent::Phase phase) {
+        std::lock_guard lock(mLock);
+        if (mSubscribers.erase(subscriber) == 0) {
+            return;
+        }
+        mFanOut->unsubscribe(subscriber);
+        if (!mSubscribers.empty()) {
+            return;
+        }
+        if (phase == DefaultEvent::STOP_IMMEDIATE) {
+            (void)mInputManager->handleStopImmediatePhase(
+                    DefaultEvent::generateEntryEvent(phase));
+            (void)mInputManager->handleStopImmediatePhase(
+                    DefaultEvent::generateTransitionCompleteEvent(phase));
+        } else {
+            (void)mInputManager->handleStopWithFlushPhase(
+                    DefaultEvent::generateEntryEvent(phase));
+            (void)mInputManager->handleStopWithFlushPhase(
+                    DefaultEvent::generateTransitionCompleteEvent(phase));
+        }
+    }
+
+  private:
+    static std::string getCameraConfig(const proto::InputStreamConfig& streamConfig) {
+        proto::InputStreamConfig cameraConfig = streamConfig;
+        cameraConfig.clear_stream_id();
+        return cameraConfig.SerializeAsString();
+    }
+
+    std::mutex mLock;
+    std::unique_ptr<InputManager> mInputManager;
+    std::shared_ptr<FanOutCallback> mFanOut;
+    /**
+     * Serialized configurations the camera is opened with
+     */
+    const std::string mCameraConfig;
+    const std::string mOverrideConfig;
+    /**
+     * The shared input managers that are running
+     */
+    std::set<const void*> mSubscribers;
+};
+
+namespace {
+
+/**
+ * Input manager of a graph whose cameras are shared through the pool.
+ */
+class SharedInputManager : public InputManager {
+  public:
+    struct Binding {
+        std::shared_ptr<SharedInputSource> source;
+        int streamId;
+    };
+
+    SharedInputManager(std::vector<Binding>&& bindings,
+                       std::shared_ptr<InputEngineInterface> engine)
+        : mBindings(std::move(bindings)), mEngine(engine) {
+    }
+
+    ~SharedInputManager() {
+        stopStreaming(DefaultEvent::STOP_IMMEDIATE);
+    }
+
+    Status handleExecutionPhase(const RunnerEvent& e) override {
+        if (e.isAborted()) {
+            stopStreaming(DefaultEvent::STOP_IMMEDIATE);
+            return Status::SUCCESS;
+        } else if (e.isTransitionComplete()) {
+            return Status::SUCCESS;
+        }
+
+        for (auto& binding : mBindings) {
+            Status ret = binding.source->startStreaming(this, binding.streamId, mEngine);
+            if (ret != Status::SUCCESS) {
+                LOG(ERROR) << "Unable to start the shared input of stream " << binding.streamId;
+                stopStreaming(DefaultEvent::STOP_IMMEDIATE);
+                return ret;
+            }
+        }
+        return Status::SUCCESS;
+    }
+
+    Status handleStopImmediatePhase(const RunnerEvent& e) override {
+        if (e.isPhaseEntry()) {
+            stopStreaming(DefaultEvent::STOP_IMMEDIATE);
+        }
+        return Status::SUCCESS;
+    }
+
+    Status handleStopWithFlushPhase(const RunnerEvent& e) override {
+        if (e.isPhaseEntry()) {
+            stopStreaming(DefaultEvent::STOP_WITH_FLUSH);
+        }
+        return Status::SUCCESS;
+    }
+
+    Status handleResetPhase(const RunnerEvent& /* e */) override {
+        // The cameras are released along with this input manager.
+        return Status::SUCCESS;
+    }
+
+  private:
+    void stopStreaming(DefaultEvent::Phase phase) {
+        for (auto& binding : mBindings) {
+            binding.source->stopStreaming(this, phase);
+        }
+    }
+
+    std::vector<Binding> mBindings;
+    std::shared_ptr<InputEngineInterface> mEngine;
+};
+
+}  // namespace
+
+SharedInputManagerPool::SharedInputManagerPool(CreateInputManagerFn createInputManager)
+    : mCreateInputManager(std::move(createInputManager)) {
+    if (!mCreateInputManager) {
+        auto factory = std::make_shared<InputManagerFactory>();
+        mCreateInputManager = [factory](const proto::InputConfig& config,
+                                        const proto::InputConfig& overrideConfig,
+                                        std::shared_ptr<InputEngineInterface> engine) {
+            return factory->createInputManager(config, overrideConfig, engine);
+        };
+    }
+}
+
+std::unique_ptr<InputManager> SharedInputManagerPool::createInputManager(
+        const proto::InputConfig& config, const proto::InputConfig& overrideConfig,
+        std::shared_ptr<InputEngineInterface> engine) {
+    for (int i = 0; i < config.input_stream_size(); i++) {
+        if (config.input_stream(i).type() != proto::InputStreamConfig::CAMERA) {
+            return mCreateInputManager(config, overrideConfig, engine);
+        }
+    }
+
+    std::vector<SharedInputManager::Binding> bindings;
+    for (int i = 0; i < config.input_stream_size(); i++) {
+        std::shared_ptr<SharedInputSource> source = acquireSource(config, i, overrideConfig);
+        if (source == nullptr) {
+            LOG(ERROR) << "Unable to open camera " << config.input_stream(i).cam_config().cam_id();
+            return nullptr;
+        }
+        bindings.push_back({source, config.input_stream(i).stream_id()});
+    }
+    return std::make_unique<SharedInputManager>(std::move(bindings), engine);
+}
+
+int SharedInputManagerPool::getSharedInputCount() {
+    std::lock_guard lock(mLock);
+    int count = 0;
+    for (auto& [cameraId, source] : mSources) {
+        if (!source.expired()) {
+            count++;
+        }
+    }
+    return count;
+}
+
+std::shared_ptr<SharedInputSource> SharedInputManagerPool::acquireSource(
+        const proto::InputConfig& config, int index, const proto::InputConfig& overrideConfig) {
+    const proto::InputStreamConfig& streamConfig = config.input_stream(index);
+    std::lock_guard lock(mLock);
+    auto it = mSources.find(streamConfig.cam_config().cam_id());
+    if (it != mSources.end()) {
+        if (std::shared_ptr<SharedInputSource> source = it->second.lock()) {
+            if (!source->isOpenedWith(streamConfig, overrideConfig)) {
+                LOG(ERROR) << "Camera " << streamConfig.cam_config().cam_id()
+                           << " is already shared with a different configuration";
+                return nullptr;
+            }
+            return source;
+        }
+    }
+
+    // The first graph using the camera decides the configuration of its stream. The graphs that
+    // join it later must ask for the same one.
+    proto::InputConfig sourceConfig;
+    sourceConfig.set_config_id(config.config_id());
+    *sourceConfig.add_input_stream() = streamConfig;
+    auto fanOut = std::make_shared<FanOutCallback>();
+    std::unique_ptr<InputManager> inputManager =
+            mCreateInputManager(sourceConfig, overrideConfig, fanOut);
+    if (inputManager == nullptr) {
+        return nullptr;
+    }
+    auto source = std::make_shared<SharedInputSource>(std::move(inputManager), fanOut,
+                                                      streamConfig, overrideConfig);
+    mSources[streamConfig.cam_config().cam_id()] = source;
+    return source;
+}
+
+}  // namespace input_manager
+}  // namespace runner
+}  // namespace computepipe
+}  // namespace automotive
+}  // namespace android
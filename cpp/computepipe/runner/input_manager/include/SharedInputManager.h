@@ -0,0 +1,94 @@
+// Copyright 2024 The Android Open Source Project
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef COMPUTEPIPE_RUNNER_INPUT_MANAGER_INCLUDE_SHAREDINPUTMANAGER_H_
+#define COMPUTEPIPE_RUNNER_INPUT_MANAGER_INCLUDE_SHAREDINPUTMANAGER_H_
+
+#include <functional>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+
+#include "InputConfig.pb.h"
+#include "InputEngineInterface.h"
+#include "InputManager.h"
+#include "types/Status.h"
+
+namespace android {
+namespace automotive {
+namespace computepipe {
+namespace runner {
+namespace input_manager {
+
+class SharedInputSource;
+
+/**
+ * Hands out input managers to the engines of the graphs hosted by one runner, so that graphs
+ * using the same camera share a single camera stream. Each camera is opened by one underlying
+ * input manager, which is started when the first graph enters the run phase and stopped when the
+ * last one leaves it. Its frames are fanned out to every running graph under the stream id that
+ * graph's input config assigns to the camera.
+ * The graphs sharing a camera must configure its stream identically, apart from the stream id.
+ *
+ * Inputs other than cameras are not shared, and get an input manager of their own per graph.
+ */
+class SharedInputManagerPool {
+  public:
+    using CreateInputManagerFn = std::function<std::unique_ptr<InputManager>(
+            const proto::InputConfig&, const proto::InputConfig&,
+            std::shared_ptr<InputEngineInterface>)>;
+
+    /**
+     * Creates the underlying input managers with |createInputManager|, or with
+     * InputManagerFactory when it is empty.
+     */
+    explicit SharedInputManagerPool(CreateInputManagerFn createInputManager = nullptr);
+
+    /**
+     * Returns an input manager that delivers the streams of |config| to |engine|, or nullptr if
+     * an underlying input manager couldn't be created or a camera of |config| is already shared
+     * with a different stream configuration or |overrideConfig|.
+     */
+    std::unique_ptr<InputManager> createInputManager(const proto::InputConfig& config,
+                                                     const proto::InputConfig& overrideConfig,
+                                                     std::shared_ptr<InputEngineInterface> engine);
+
+    /**
+     * Returns the number of cameras currently opened by the pool.
+     */
+    int getSharedInputCount();
+
+    SharedInputManagerPool(const SharedInputManagerPool&) = delete;
+    SharedInputManagerPool& operator=(const SharedInputManagerPool&) = delete;
+
+  private:
+    std::shared_ptr<SharedInputSource> acquireSource(const proto::InputConfig& config, int index,
+                                                     const proto::InputConfig& overrideConfig);
+
+    CreateInputManagerFn mCreateInputManager;
+    std::mutex mLock;
+    /**
+     * Sources by camera id. A source is released along with the last input manager using it.
+     */
+    std::map<std::string, std::weak_ptr<SharedInputSource>> mSources;
+};
+
+}  // namespace input_manager
+}  // namespace runner
+}  // namespace computepipe
+}  // namespace automotive
+}  // namespace android
+
+#endif  // COMPUTEPIPE_RUNNER_INPUT_MANAGER_INCLUDE_SHAREDINPUTMANAGER_H_
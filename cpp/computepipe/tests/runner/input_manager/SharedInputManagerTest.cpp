@@ -0,0 +1,247 @@
+/*
+ * Copyright 2024 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <gmock/gmock.h>
+#include <gtest/gtest.h>
+
+#include <map>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "EventGenerator.h"
+#include "InputConfig.pb.h"
+#include "InputEngineInterface.h"
+#include "InputFrame.h"
+#include "InputManager.h"
+#include "RunnerComponent.h"
+#include "SharedInputManager.h"
+#include "types/Status.h"
+
+using namespace android::automotive::computepipe::runner::input_manager;
+using namespace android::automotive::computepipe;
+using android::automotive::computepipe::runner::InputFrame;
+using android::automotive::computepipe::runner::RunnerEvent;
+using android::automotive::computepipe::runner::generator::DefaultEvent;
+using testing::ElementsAre;
+
+namespace {
+
+// Receives the frames of a graph
+class FakeEngine : public InputEngineInterface {
+  public:
+    Status dispatchInputFrame(int streamId, int64_t /* timestamp */,
+                              const InputFrame& /* frame */) override {
+        mReceivedStreamIds.push_back(streamId);
+        return Status::SUCCESS;
+    }
+    void notifyInputError() override {
+        mErrorCount++;
+    }
+
+    std::vector<int> mReceivedStreamIds;
+    int mErrorCount = 0;
+};
+
+// Stands in for the input manager of a camera
+class FakeInputManager : public InputManager {
+  public:
+    struct Counters {
+        int startCount = 0;
+        int stopCount = 0;
+    };
+
+    FakeInputManager(std::shared_ptr<InputEngineInterface> engine, Counters* counters)
+        : mEngine(engine), mCounters(counters) {
+    }
+
+    Status handleExecutionPhase(const RunnerEvent& e) override {
+        if (e.isPhaseEntry()) {
+            mCounters->startCount++;
+        }
+        return Status::SUCCESS;
+    }
+    Status handleStopWithFlushPhase(const RunnerEvent& e) override {
+        if (e.isPhaseEntry()) {
+            mCounters->stopCount++;
+        }
+        return Status::SUCCESS;
+    }
+    Status handleStopImmediatePhase(const RunnerEvent& e) override {
+        if (e.isPhaseEntry()) {
+            mCounters->stopCount++;
+        }
+        return Status::SUCCESS;
+    }
+
+    void deliverFrame(int streamId) {
+        uint8_t pixels[4] = {};
+        InputFrame frame(1, 1, PixelFormat::RGBA, 4, pixels);
+        (void)mEngine->dispatchInputFrame(streamId, 0, frame);
+    }
+
+  private:
+    std::shared_ptr<InputEngineInterface> mEngine;
+    Counters* mCounters;
+};
+
+proto::InputConfig makeConfig(const std::map<int, std::string>& cameraIdsByStreamId,
+                              proto::InputStreamConfig::InputType type =
+                                      proto::InputStreamConfig::CAMERA) {
+    proto::InputConfig config;
+    config.set_config_id(0);
+    for (auto& [streamId, cameraId] : cameraIdsByStreamId) {
+        proto::InputStreamConfig* stream = config.add_input_stream();
+        stream->set_type(type);
+        stream->set_stream_id(streamId);
+        stream->mutable_cam_config()->set_cam_id(cameraId);
+    }
+    return config;
+}
+
+}  // namespace
+
+class SharedInputManagerTest : public ::testing::Test {
+  protected:
+    void SetUp() override {
+        mPool = std::make_unique<SharedInputManagerPool>(
+                [this](const proto::InputConfig& config, const proto::InputConfig&,
+                       std::shared_ptr<InputEngineInterface> engine) {
+                    mCreatedConfigs.push_back(config);
+                    auto inputManager = std::make_unique<FakeInputManager>(
+                            engine, &mCounters[config.input_stream(0).cam_config().cam_id()]);
+                    mInputManagers.push_back(inputManager.get());
+                    return inputManager;
+                });
+    }
+
+    static Status start(InputManager* inputManager) {
+        Status status = inputManager->handleExecutionPhase(
+                DefaultEvent::generateEntryEvent(DefaultEvent::RUN));
+        (void)inputManager->handleExecutionPhase(
+                DefaultEvent::generateTransitionCompleteEvent(DefaultEvent::RUN));
+        return status;
+    }
+
+    static void stop(InputManager* inputManager) {
+        (void)inputManager->handleStopWithFlushPhase(
+                DefaultEvent::generateEntryEvent(DefaultEvent::STOP_WITH_FLUSH));
+        (void)inputManager->handleStopWithFlushPhase(
+                DefaultEvent::generateTransitionCompleteEvent(DefaultEvent::STOP_WITH_FLUSH));
+    }
+
+    std::unique_ptr<SharedInputManagerPool> mPool;
+    std::vector<proto::InputConfig> mCreatedConfigs;
+    std::vector<FakeInputManager*> mInputManagers;
+    std::map<std::string, FakeInputManager::Counters> mCounters;
+};
+
+TEST_F(SharedInputManagerTest, GraphsShareCameraStream) {
+    auto laneEngine = std::make_shared<FakeEngine>();
+    auto driverEngine = std::make_shared<FakeEngine>();
+    std::unique_ptr<InputManager> laneInput =
+            mPool->createInputManager(makeConfig({{0, "cam0"}}), {}, laneEngine);
+    std::unique_ptr<InputManager> driverInput =
+            mPool->createInputManager(makeConfig({{5, "cam0"}}), {}, driverEngine);
+    ASSERT_NE(laneInput, nullptr);
+    ASSERT_NE(driverInput, nullptr);
+    ASSERT_EQ(mInputManagers.size(), 1u);
+    EXPECT_EQ(mPool->getSharedInputCount(), 1);
+
+    EXPECT_EQ(start(laneInput.get()), Status::SUCCESS);
+    EXPECT_EQ(start(driverInput.get()), Status::SUCCESS);
+    EXPECT_EQ(mCounters["cam0"].startCount, 1);
+
+    // Each graph receives the frame under its own stream id
+    mInputManagers[0]->deliverFrame(mCreatedConfigs[0].input_stream(0).stream_id());
+    EXPECT_THAT(laneEngine->mReceivedStreamIds, ElementsAre(0));
+    EXPECT_THAT(driverEngine->mReceivedStreamIds, ElementsAre(5));
+
+    // The camera keeps streaming for the graph still running
+    stop(laneInput.get());
+    EXPECT_EQ(mCounters["cam0"].stopCount, 0);
+    mInputManagers[0]->deliverFrame(0);
+    EXPECT_THAT(laneEngine->mReceivedStreamIds, ElementsAre(0));
+    EXPECT_THAT(driverEngine->mReceivedStreamIds, ElementsAre(5, 5));
+
+    stop(driverInput.get());
+    EXPECT_EQ(mCounters["cam0"].stopCount, 1);
+
+    laneInput.reset();
+    driverInput.reset();
+    EXPECT_EQ(mPool->getSharedInputCount(), 0);
+}
+
+TEST_F(SharedInputManagerTest, GraphsOpenEachCameraOnce) {
+    auto surroundEngine = std::make_shared<FakeEngine>();
+    auto laneEngine = std::make_shared<FakeEngine>();
+    std::unique_ptr<InputManager> surroundInput = mPool->createInputManager(
+            makeConfig({{0, "front"}, {1, "rear"}}), {}, surroundEngine);
+    std::unique_ptr<InputManager> laneInput =
+            mPool->createInputManager(makeConfig({{0, "front"}}), {}, laneEngine);
+    ASSERT_NE(surroundInput, nullptr);
+    ASSERT_NE(laneInput, nullptr);
+    EXPECT_EQ(mPool->getSharedInputCount(), 2);
+
+    EXPECT_EQ(start(surroundInput.get()), Status::SUCCESS);
+    EXPECT_EQ(start(laneInput.get()), Status::SUCCESS);
+    EXPECT_EQ(mCounters["front"].startCount, 1);
+    EXPECT_EQ(mCounters["rear"].startCount, 1);
+}
+
+TEST_F(SharedInputManagerTest, StopsCameraWhenLastGraphIsReleased) {
+    auto laneEngine = std::make_shared<FakeEngine>();
+    std::unique_ptr<InputManager> laneInput =
+            mPool->createInputManager(makeConfig({{0, "cam0"}}), {}, laneEngine);
+    ASSERT_NE(laneInput, nullptr);
+    EXPECT_EQ(start(laneInput.get()), Status::SUCCESS);
+
+    laneInput.reset();
+    EXPECT_EQ(mCounters["cam0"].stopCount, 1);
+    EXPECT_EQ(mPool->getSharedInputCount(), 0);
+}
+
+TEST_F(SharedInputManagerTest, RejectsCameraSharedWithDifferentConfig) {
+    auto laneEngine = std::make_shared<FakeEngine>();
+    auto driverEngine = std::make_shared<FakeEngine>();
+    std::unique_ptr<InputManager> laneInput =
+            mPool->createInputManager(makeConfig({{0, "cam0"}}), {}, laneEngine);
+    ASSERT_NE(laneInput, nullptr);
+
+    proto::InputConfig largerConfig = makeConfig({{0, "cam0"}});
+    largerConfig.mutable_input_stream(0)->set_width(1920);
+    EXPECT_EQ(mPool->createInputManager(largerConfig, {}, driverEngine), nullptr);
+
+    proto::InputConfig overrideConfig = makeConfig({{0, "cam1"}});
+    EXPECT_EQ(mPool->createInputManager(makeConfig({{0, "cam0"}}), overrideConfig, driverEngine),
+              nullptr);
+    EXPECT_EQ(mInputManagers.size(), 1u);
+
+    // Another configuration can be used once the camera is released
+    laneInput.reset();
+    EXPECT_NE(mPool->createInputManager(largerConfig, {}, driverEngine), nullptr);
+    EXPECT_EQ(mInputManagers.size(), 2u);
+}
+
+TEST_F(SharedInputManagerTest, VideoFileInputsAreNotShared) {
+    auto engine = std::make_shared<FakeEngine>();
+    proto::InputConfig config = makeConfig({{0, ""}}, proto::InputStreamConfig::VIDEO_FILE);
+    std::unique_ptr<InputManager> firstInput = mPool->createInputManager(config, {}, engine);
+    std::unique_ptr<InputManager> secondInput = mPool->createInputManager(config, {}, engine);
+
+    EXPECT_EQ(mInputManagers.size(), 2u);
+    EXPECT_EQ(mPool->getSharedInputCount(), 0);
+}
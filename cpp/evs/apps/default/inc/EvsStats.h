@@ -17,15 +17,11 @@
 #ifndef CAR_EVS_APP_EVSSTATS_H
 #define CAR_EVS_APP_EVSSTATS_H
 
-#include <aidl/android/frameworks/automotive/telemetry/CarData.h>
-#include <aidl/android/frameworks/automotive/telemetry/ICarTelemetry.h>
-#include <android/binder_status.h>
-#include <utils/Mutex.h>
+#include <TelemetryPublisher.h>
 
-#include <deque>
 #include <memory>
 
-// Performs metric computations, sends to `ICarTelemetry`.
+// Performs metric computations, sends to `ICarTelemetry` through `TelemetryPublisher`.
 //
 // Not thread-safe. Methods `startComputingFirstFrameLatency`, `finishComputingFirstFrameLatency`
 // and `sendCollectedDataBlocking` must be called from the same thread.
@@ -40,7 +36,8 @@ public:
     // Param `startTimeMillis` should be `android::uptimeMillis()`.
     void startComputingFirstFrameLatency(int64_t startTimeMillis);
 
-    // Computes the latency and sends the data to `ICarTelemetry` if the receiving service is up.
+    // Computes the latency and queues the data for sending to `ICarTelemetry`. Doesn't block,
+    // the data is sent from the publisher thread when the receiving service is up.
     // Call this method when the first camera frame is displayed on the screen and don't call
     // after that unless a new computation is started.
     // Param `finishTimeMillis` should be `android::uptimeMillis()`.
@@ -56,35 +53,13 @@ private:
     };
 
 private:
-    EvsStats(bool enabled) :
-          mEnabled(enabled),
-          mBinderDeathRecipient(::AIBinder_DeathRecipient_new(EvsStats::telemetryBinderDied)) {}
+    explicit EvsStats(
+            std::unique_ptr<android::automotive::telemetry::TelemetryPublisher> publisher) :
+          mPublisher(std::move(publisher)) {}
 
-    // Death recipient callback that is called when ICarTelemetry dies.
-    // The cookie is a pointer to a EvsStats object.
-    static void telemetryBinderDied(void* cookie);
-
-    void telemetryBinderDiedImpl();
-
-    // Tries sending data if the receiving service is up.
-    // Must be called when both `mEnabled` is true and `mCollectedData` is not empty.
-    //
-    // \param waitIfNotReady - if true, it can block briefly until ICarTelemetry is ready.
-    void sendCollectedDataUnsafe(bool waitIfNotReady);
-
-    // Returns the instance of ICarTelemetry.
-    //
-    // \param waitIfNotReady - if true, it can block briefly until ICarTelemetry is ready.
-    std::shared_ptr<aidl::android::frameworks::automotive::telemetry::ICarTelemetry>
-    getCarTelemetry(bool waitIfNotReady);
-
-    std::mutex mMutex;
-    bool mEnabled;
     int64_t mFirstFrameLatencyStartTimeMillis = EvsStatsState::NOT_STARTED;
-    // This is a ring buffer
-    std::deque<aidl::android::frameworks::automotive::telemetry::CarData> mCollectedData;
-    std::shared_ptr<aidl::android::frameworks::automotive::telemetry::ICarTelemetry> mCarTelemetry;
-    ndk::ScopedAIBinder_DeathRecipient mBinderDeathRecipient;
+    // Null if `ICarTelemetry` is not available on the device.
+    std::unique_ptr<android::automotive::telemetry::TelemetryPublisher> mPublisher;
 };
 
 #endif  // CAR_EVS_APP_EVSSTATS_H
@@ -28,6 +28,10 @@
 void copyNV21toRGB32(unsigned width, unsigned height, uint8_t* src, uint32_t* dst,
                      unsigned dstStridePixels);
 
+// Same as above, but only converts the rows in [firstRow, lastRow) into the same rows of |dst|.
+void copyNV21toRGB32(unsigned width, unsigned height, unsigned firstRow, unsigned lastRow,
+                     uint8_t* src, uint32_t* dst, unsigned dstStridePixels);
+
 // Given an image buffer in YV12 format (HAL_PIXEL_FORMAT_YV12), output 32bit RGBx values.
 // The YV12 format provides a Y array of 8bit values, followed by a 1/2 x 1/2 U array, followed
 // by another 1/2 x 1/2 V array.  It assumes an even width and height for the overall image,
@@ -36,6 +40,10 @@ void copyNV21toRGB32(unsigned width, unsigned height, uint8_t* src, uint32_t* ds
 void copyYV12toRGB32(unsigned width, unsigned height, uint8_t* src, uint32_t* dst,
                      unsigned dstStridePixels);
 
+// Same as above, but only converts the rows in [firstRow, lastRow) into the same rows of |dst|.
+void copyYV12toRGB32(unsigned width, unsigned height, unsigned firstRow, unsigned lastRow,
+                     uint8_t* src, uint32_t* dst, unsigned dstStridePixels);
+
 // Given an image buffer in YUYV format (HAL_PIXEL_FORMAT_YCBCR_422_I), output 32bit RGBx values.
 // The NV21 format provides a Y array of 8bit values, followed by a 1/2 x 1/2 interleaved
 // U/V array.  It assumes an even width and height for the overall image, and a horizontal
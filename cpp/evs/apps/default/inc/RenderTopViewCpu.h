@@ -0,0 +1,68 @@
+/*
+ * Copyright (C) 2024 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef CAR_EVS_APP_RENDERTOPVIEWCPU_H
+#define CAR_EVS_APP_RENDERTOPVIEWCPU_H
+
+#include "ConfigManager.h"
+#include "RenderBase.h"
+#include "StreamHandler.h"
+#include "TopViewCompositor.h"
+
+#include <aidl/android/hardware/automotive/evs/BufferDesc.h>
+#include <aidl/android/hardware/automotive/evs/IEvsEnumerator.h>
+
+#include <memory>
+#include <vector>
+
+/*
+ * Combines the views from all available cameras into one reprojected top down view without using
+ * the GPU.  See TopViewCompositor.
+ */
+class RenderTopViewCpu final : public RenderBase {
+public:
+    RenderTopViewCpu(
+            std::shared_ptr<aidl::android::hardware::automotive::evs::IEvsEnumerator> enumerator,
+            const std::vector<ConfigManager::CameraInfo>& camList, const ConfigManager& config);
+
+    virtual bool activate() override;
+    virtual void deactivate() override;
+
+    virtual bool drawFrame(const aidl::android::hardware::automotive::evs::BufferDesc& tgtBuffer);
+
+protected:
+    struct ActiveCamera {
+        const ConfigManager::CameraInfo& info;
+        std::shared_ptr<StreamHandler> streamHandler;
+        std::vector<uint32_t> pixels;  // Latest frame converted to 32bit RGBA
+        TopViewCompositor::Image image;
+
+        ActiveCamera(const ConfigManager::CameraInfo& c) : info(c) {};
+    };
+
+    // Converts the rows mCompositor samples of the newest frame of camera |cameraIndex|, if any,
+    // into its RGBA image
+    bool updateImage(unsigned cameraIndex);
+
+    std::shared_ptr<aidl::android::hardware::automotive::evs::IEvsEnumerator> mEnumerator;
+    const ConfigManager& mConfig;
+    std::vector<ActiveCamera> mActiveCameras;
+
+    // Created for the size of the first target buffer
+    std::unique_ptr<TopViewCompositor> mCompositor;
+};
+
+#endif  // CAR_EVS_APP_RENDERTOPVIEWCPU_H
@@ -0,0 +1,159 @@
+/*
+ * Copyright (C) 2024 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef CAR_EVS_APP_TOPVIEWCOMPOSITOR_H
+#define CAR_EVS_APP_TOPVIEWCOMPOSITOR_H
+
+#include "ConfigManager.h"
+
+#include <stdint.h>
+
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+/*
+ * Composes the top down view on the CPU, for the configurations without a GPU or with a GPU too
+ * busy to run RenderTopView.
+ *
+ * The ground plane projection of RenderTopView is precomputed into a remap table per camera,
+ * which lists the display pixels the camera covers and where to sample them in the camera image.
+ * A composition then only walks the tables, bilinearly sampling four RGBA channels at a time with
+ * vector instructions, over row bands split across worker threads.
+ */
+class TopViewCompositor final {
+public:
+    // Car space extent of the display and of the car body
+    struct Geometry {
+        float left;
+        float right;
+        float top;
+        float bottom;
+
+        float carLeft;
+        float carRight;
+        float carFront;
+        float carRear;
+    };
+
+    // 32bit RGBA image
+    struct Image {
+        const uint32_t* pixels = nullptr;  // nullptr if the camera has no frame yet
+        unsigned width = 0;
+        unsigned height = 0;
+        unsigned stride = 0;  // in pixels
+    };
+
+    // Rows [first, last) of a camera image
+    struct SourceRows {
+        unsigned first = 0;
+        unsigned last = 0;
+    };
+
+    // Returns the geometry RenderTopView uses for a display with |aspectRatio|
+    static Geometry getGeometry(const ConfigManager& config, float aspectRatio);
+
+    // |numThreads| includes the thread calling compose()
+    TopViewCompositor(const std::vector<ConfigManager::CameraInfo>& cameras,
+                      const Geometry& geometry, unsigned width, unsigned height,
+                      unsigned numThreads = kDefaultNumThreads);
+    ~TopViewCompositor();
+
+    TopViewCompositor(const TopViewCompositor&) = delete;
+    TopViewCompositor& operator=(const TopViewCompositor&) = delete;
+
+    // Composes |inputs|, one per camera in the order given to the constructor, into a
+    // width x height |dst| with |dstStride| pixels per row.  The remap table of a camera is
+    // rebuilt when its image size changes.
+    void compose(const std::vector<Image>& inputs, uint32_t* dst, unsigned dstStride);
+
+    // Returns the rows compose() samples in a |srcWidth| x |srcHeight| image of camera
+    // |cameraIndex|, so the caller can skip preparing the others.  This builds the remap table of
+    // the camera if its image size changes.
+    SourceRows getSourceRows(unsigned cameraIndex, unsigned srcWidth, unsigned srcHeight);
+
+    unsigned getWidth() const { return mWidth; }
+    unsigned getHeight() const { return mHeight; }
+
+    static constexpr unsigned kDefaultNumThreads = 4;
+    static constexpr uint32_t kBackgroundColor = 0xFF000000;  // Opaque black
+    static constexpr uint32_t kCarColor = 0xFF404040;         // Opaque dark gray
+
+private:
+    // A display pixel and the top left of its 2x2 source pixels, with the weights of the right
+    // and bottom source pixels in 1/256 units
+    struct RemapEntry {
+        uint16_t dstX;
+        uint16_t srcX;
+        uint16_t srcY;
+        uint8_t fracX;
+        uint8_t fracY;
+    };
+
+    struct RemapTable {
+        unsigned srcWidth = 0;
+        unsigned srcHeight = 0;
+        std::vector<RemapEntry> entries;  // Ordered by the display row and column
+        std::vector<uint32_t> rowStart;   // Index of the first entry of each row, plus the end
+        SourceRows sourceRows;            // Source rows the entries sample
+    };
+
+    void buildRemapTable(unsigned cameraIndex, unsigned srcWidth, unsigned srcHeight);
+    void composeRows(unsigned firstRow, unsigned lastRow);
+    void runWorker(unsigned band);
+
+    // Car space location of a display pixel's center
+    float getCarX(unsigned x) const {
+        return mGeometry.left + (x + 0.5f) * (mGeometry.right - mGeometry.left) / mWidth;
+    }
+    float getCarY(unsigned y) const {
+        return mGeometry.top - (y + 0.5f) * (mGeometry.top - mGeometry.bottom) / mHeight;
+    }
+
+    const std::vector<ConfigManager::CameraInfo> mCameras;
+    const Geometry mGeometry;
+    const unsigned mWidth;
+    const unsigned mHeight;
+    const unsigned mNumBands;
+
+    std::vector<RemapTable> mTables;
+
+    // Camera that shows each display pixel, or -1 for the car body and the pixels no camera
+    // sees.  Like RenderTopView, the last camera in the list wins where views overlap.
+    std::vector<int8_t> mOwners;
+
+    // Display columns the car body covers on the rows in [mCarTopRow, mCarBottomRow)
+    unsigned mCarLeftColumn = 0;
+    unsigned mCarRightColumn = 0;
+    unsigned mCarTopRow = 0;
+    unsigned mCarBottomRow = 0;
+
+    // Composition in progress; written before the workers are woken up
+    const std::vector<Image>* mInputs = nullptr;
+    uint32_t* mDst = nullptr;
+    unsigned mDstStride = 0;
+
+    std::vector<std::thread> mWorkers;
+    std::mutex mLock;
+    std::condition_variable mWorkReady;
+    std::condition_variable mWorkDone;
+    uint64_t mGeneration = 0;     // Incremented for each composition
+    unsigned mPendingBands = 0;   // Bands the workers have yet to finish
+    bool mQuit = false;
+};
+
+#endif  // CAR_EVS_APP_TOPVIEWCOMPOSITOR_H
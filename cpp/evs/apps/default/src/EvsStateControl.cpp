@@ -19,6 +19,7 @@
 #include "RenderDirectView.h"
 #include "RenderPixelCopy.h"
 #include "RenderTopView.h"
+#include "RenderTopViewCpu.h"
 
 #include <aidl/android/hardware/automotive/evs/CameraDesc.h>
 #include <aidl/android/hardware/automotive/evs/DisplayState.h>
@@ -331,7 +332,15 @@ bool EvsStateControl::configureEvsPipeline(State desiredState) {
 
     if (!isGlReady && !isSfReady()) {
         // Graphics is not ready yet; using CPU renderer.
-        if (mCameraList[desiredState].size() >= 1) {
+        if (mCameraList[desiredState].size() > 1 ||
+            (mCameraList[desiredState].size() > 0 && desiredState == PARKING)) {
+            mDesiredRenderer =
+                    std::make_unique<RenderTopViewCpu>(mEvs, mCameraList[desiredState], mConfig);
+            if (!mDesiredRenderer) {
+                LOG(ERROR) << "Failed to construct CPU top view renderer.  Skipping state change.";
+                return false;
+            }
+        } else if (mCameraList[desiredState].size() == 1) {
             mDesiredRenderer =
                     std::make_unique<RenderPixelCopy>(mEvs, mCameraList[desiredState][0]);
             if (!mDesiredRenderer) {
@@ -17,29 +17,25 @@
 
 #include "packages/services/Car/cpp/telemetry/proto/evs.pb.h"
 
-#include <aidl/android/frameworks/automotive/telemetry/CarData.h>
-#include <aidl/android/frameworks/automotive/telemetry/ICarTelemetry.h>
 #include <android-base/logging.h>
-#include <android/binder_manager.h>
 #include <binder/IServiceManager.h>
-#include <utils/SystemClock.h>
 
+#include <chrono>
 #include <vector>
 
 namespace {
 
-using ::aidl::android::frameworks::automotive::telemetry::CarData;
-using ::aidl::android::frameworks::automotive::telemetry::ICarTelemetry;
 using ::android::automotive::telemetry::EvsFirstFrameLatency;
+using ::android::automotive::telemetry::TelemetryPublisher;
 
 // Name of ICarTelemetry service that consumes RVC latency metrics.
 constexpr const char kCarTelemetryServiceName[] =
         "android.frameworks.automotive.telemetry.ICarTelemetry/default";
 
 const int kCollectedDataSizeLimit = 200;  // arbitrary chosen
-// 10kb limit is imposed by ICarTelemetry, the limit if only for
-// CarData.content vector.
-const int kCarTelemetryMaxDataSizePerWrite = 10 * 1024;
+
+// How long sendCollectedDataBlocking() waits for ICarTelemetry to accept the collected data.
+constexpr std::chrono::milliseconds kSendCollectedDataTimeout = std::chrono::seconds(5);
 
 // Defined in packages/services/Car/cpp/telemetry/proto/CarData.proto
 const int kEvsFirstFrameLatencyId = 1;
@@ -58,8 +54,12 @@ EvsStats EvsStats::build() {
 
     if (!enabled) {
         LOG(DEBUG) << "Telemetry service is not available.";
+        return EvsStats(nullptr);
     }
-    return EvsStats(enabled);
+    TelemetryPublisher::Options options;
+    options.maxBufferedDataCount = kCollectedDataSizeLimit;
+    options.carDataIds = {kEvsFirstFrameLatencyId};
+    return EvsStats(std::make_unique<TelemetryPublisher>(options));
 }
 
 void EvsStats::startComputingFirstFrameLatency(int64_t startTimeMillis) {
@@ -67,7 +67,7 @@ void EvsStats::startComputingFirstFrameLatency(int64_t startTimeMillis) {
 }
 
 void EvsStats::finishComputingFirstFrameLatency(int64_t finishTimeMillis) {
-    if (!mEnabled) {
+    if (mPublisher == nullptr) {
         return;
     }
     if (mFirstFrameLatencyStartTimeMillis == EvsStatsState::NOT_STARTED) {
@@ -75,124 +75,32 @@ void EvsStats::finishComputingFirstFrameLatency(int64_t finishTimeMillis) {
                      << "startComputingFirstFrameLatency was not called before.";
         return;
     }
-    auto firstFrameLatencyMillis = finishTimeMillis - mFirstFrameLatencyStartTimeMillis;
+    auto startTimeMillis = mFirstFrameLatencyStartTimeMillis;
+    auto firstFrameLatencyMillis = finishTimeMillis - startTimeMillis;
     mFirstFrameLatencyStartTimeMillis = EvsStatsState::NOT_STARTED;
 
     LOG(DEBUG) << __func__ << ": firstFrameLatencyMillis = " << firstFrameLatencyMillis;
 
+    // cartelemetryd drops the data that no one subscribed to, don't serialize and send it.
+    if (!mPublisher->isSubscribed(kEvsFirstFrameLatencyId)) {
+        return;
+    }
+
     EvsFirstFrameLatency latency;
-    latency.set_start_timestamp_millis(mFirstFrameLatencyStartTimeMillis);
+    latency.set_start_timestamp_millis(startTimeMillis);
     latency.set_latency_millis(firstFrameLatencyMillis);
     std::vector<uint8_t> bytes(latency.ByteSizeLong());
     latency.SerializeToArray(&bytes[0], latency.ByteSizeLong());
-    CarData msg;
-    msg.id = kEvsFirstFrameLatencyId;
-    msg.content = std::move(bytes);
-
-    if (msg.content.size() > kCarTelemetryMaxDataSizePerWrite) {
-        LOG(WARNING) << __func__ << "finishComputingFirstFrameLatency is trying to store data "
-                     << "with size " << msg.content.size() << ", which is larger than allowed "
-                     << kCarTelemetryMaxDataSizePerWrite;
-        return;
-    }
 
-    mCollectedData.push_back(msg);
-
-    while (mCollectedData.size() > kCollectedDataSizeLimit) {
-        mCollectedData.pop_front();
-    }
-
-    sendCollectedDataUnsafe(/* waitIfNotReady= */ false);
+    mPublisher->publish(kEvsFirstFrameLatencyId, std::move(bytes));
 }
 
 void EvsStats::sendCollectedDataBlocking() {
-    if (!mEnabled || mCollectedData.empty()) {
-        return;
-    }
-    sendCollectedDataUnsafe(/* waitIfNotReady= */ true);
-}
-
-std::shared_ptr<ICarTelemetry> EvsStats::getCarTelemetry(bool waitIfNotReady) {
-    {
-        const std::scoped_lock<std::mutex> lock(mMutex);
-        if (mCarTelemetry != nullptr) {
-            return mCarTelemetry;
-        }
-    }
-
-    AIBinder* binder;
-    if (waitIfNotReady) {
-        binder = ::AServiceManager_waitForService(kCarTelemetryServiceName);
-    } else {
-        binder = ::AServiceManager_checkService(kCarTelemetryServiceName);
-    }
-
-    if (binder == nullptr) {
-        LOG(WARNING) << __func__ << ": ICarTelemetry is not ready";
-        return nullptr;
-    }
-
-    const std::scoped_lock<std::mutex> lock(mMutex);  // locks until the end of the method
-    mCarTelemetry = ICarTelemetry::fromBinder(ndk::SpAIBinder(binder));
-    if (!mCarTelemetry) {
-        LOG(WARNING) << "CarTelemetry service is not available.";
-        return nullptr;
-    }
-
-    auto status = ndk::ScopedAStatus::fromStatus(
-            ::AIBinder_linkToDeath(mCarTelemetry->asBinder().get(), mBinderDeathRecipient.get(),
-                                   this));
-    if (!status.isOk()) {
-        LOG(WARNING) << __func__
-                     << ": Failed to linkToDeath, continuing anyway: " << status.getMessage();
-    }
-    return mCarTelemetry;
-}
-
-void EvsStats::sendCollectedDataUnsafe(bool waitIfNotReady) {
-    std::shared_ptr<ICarTelemetry> telemetry = getCarTelemetry(waitIfNotReady);
-    if (telemetry == nullptr) {
-        LOG(INFO) << __func__ << ": CarTelemetry is not ready, ignoring";
+    if (mPublisher == nullptr) {
         return;
     }
-
-    // Send data chunk by chnk, because Binder has transfer data size limit.
-    // Adds the oldest elements to `sendingData` and tries to push ICarTelemetryService.
-    // If successful, erases then from `mCollectedData`, otherwise leaves them there to try again
-    // later.
-    while (!mCollectedData.empty()) {
-        int sendingDataSizeBytes = 0;
-        std::vector<CarData> sendingData;
-        auto it = mCollectedData.begin();
-        while (it != mCollectedData.end()) {
-            sendingDataSizeBytes += it->content.size();
-            if (sendingDataSizeBytes > kCarTelemetryMaxDataSizePerWrite) {
-                break;
-            }
-            sendingData.push_back(*it);
-            it++;
-        }
-        ndk::ScopedAStatus status = telemetry->write(sendingData);
-        if (!status.isOk()) {
-            LOG(WARNING) << __func__
-                         << "Failed to write data to ICarTelemetry: " << status.getMessage();
-            return;
-        }
-        mCollectedData.erase(mCollectedData.begin(), it);
+    if (!mPublisher->flush(kSendCollectedDataTimeout)) {
+        LOG(WARNING) << __func__ << ": CarTelemetry did not accept the collected data in "
+                     << kSendCollectedDataTimeout.count() << "ms";
     }
 }
-
-// Removes the listener if its binder dies.
-void EvsStats::telemetryBinderDiedImpl() {
-    LOG(WARNING) << __func__ << "ICarTelemetry service died, resetting the state";
-    const std::scoped_lock<std::mutex> lock(mMutex);
-    mCarTelemetry = nullptr;
-}
-
-// static
-void EvsStats::telemetryBinderDied(void* cookie) {
-    // We expect the pointer to be alive as there is only a single instance of
-    // EvsStats and if EvsStats is destructed, then the whole evs_app should be dead too.
-    auto thiz = static_cast<EvsStats*>(cookie);
-    thiz->telemetryBinderDiedImpl();
-}
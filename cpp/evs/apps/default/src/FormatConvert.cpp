@@ -53,6 +53,12 @@ static uint32_t yuvToRgbx(const unsigned char Y, const unsigned char Uin, const
 
 void copyNV21toRGB32(unsigned width, unsigned height, uint8_t* src, uint32_t* dst,
                      unsigned dstStridePixels) {
+    copyNV21toRGB32(width, height, /* firstRow= */ 0, /* lastRow= */ height, src, dst,
+                    dstStridePixels);
+}
+
+void copyNV21toRGB32(unsigned width, unsigned height, unsigned firstRow, unsigned lastRow,
+                     uint8_t* src, uint32_t* dst, unsigned dstStridePixels) {
     // The NV21 format provides a Y array of 8bit values, followed by a 1/2 x 1/2 interleaved
     // U/V array.  It assumes an even width and height for the overall image, and a horizontal
     // stride that is an even multiple of 16 bytes for both the Y and UV arrays.
@@ -64,7 +70,7 @@ void copyNV21toRGB32(unsigned width, unsigned height, uint8_t* src, uint32_t* ds
     uint8_t* srcY = src;
     uint8_t* srcUV = src + offsetUV;
 
-    for (unsigned r = 0; r < height; r++) {
+    for (unsigned r = firstRow; r < lastRow; r++) {
         // Note that we're walking the same UV row twice for even/odd luminance rows
         uint8_t* rowY = srcY + r * strideLum;
         uint8_t* rowUV = srcUV + (r / 2 * strideColor);
@@ -81,6 +87,12 @@ void copyNV21toRGB32(unsigned width, unsigned height, uint8_t* src, uint32_t* ds
 
 void copyYV12toRGB32(unsigned width, unsigned height, uint8_t* src, uint32_t* dst,
                      unsigned dstStridePixels) {
+    copyYV12toRGB32(width, height, /* firstRow= */ 0, /* lastRow= */ height, src, dst,
+                    dstStridePixels);
+}
+
+void copyYV12toRGB32(unsigned width, unsigned height, unsigned firstRow, unsigned lastRow,
+                     uint8_t* src, uint32_t* dst, unsigned dstStridePixels) {
     // The YV12 format provides a Y array of 8bit values, followed by a 1/2 x 1/2 U array, followed
     // by another 1/2 x 1/2 V array.  It assumes an even width and height for the overall image,
     // and a horizontal stride that is an even multiple of 16 bytes for each of the Y, U,
@@ -96,7 +108,7 @@ void copyYV12toRGB32(unsigned width, unsigned height, uint8_t* src, uint32_t* ds
     uint8_t* srcU = src + offsetU;
     uint8_t* srcV = src + offsetV;
 
-    for (unsigned r = 0; r < height; r++) {
+    for (unsigned r = firstRow; r < lastRow; r++) {
         // Note that we're walking the same U and V rows twice for even/odd luminance rows
         uint8_t* rowY = srcY + r * strideLum;
         uint8_t* rowU = srcU + (r / 2 * strideColor);
@@ -0,0 +1,215 @@
+/*
+ * Copyright (C) 2024 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+#include "RenderTopViewCpu.h"
+
+#include "FormatConvert.h"
+#include "Utils.h"
+
+#include <aidl/android/hardware/automotive/evs/IEvsCamera.h>
+#include <aidl/android/hardware/automotive/evs/Stream.h>
+#include <aidlcommonsupport/NativeHandle.h>
+#include <android-base/logging.h>
+#include <android-base/scopeguard.h>
+
+namespace {
+
+using aidl::android::hardware::automotive::evs::BufferDesc;
+using aidl::android::hardware::automotive::evs::IEvsCamera;
+using aidl::android::hardware::automotive::evs::IEvsEnumerator;
+using aidl::android::hardware::automotive::evs::Stream;
+
+android::sp<android::GraphicBuffer> wrapBuffer(native_handle_t* handle,
+                                               const AHardwareBuffer_Desc* pDesc) {
+    return new android::GraphicBuffer(handle, android::GraphicBuffer::CLONE_HANDLE, pDesc->width,
+                                      pDesc->height, pDesc->format, pDesc->layers, pDesc->usage,
+                                      pDesc->stride);
+}
+
+}  // namespace
+
+RenderTopViewCpu::RenderTopViewCpu(std::shared_ptr<IEvsEnumerator> enumerator,
+                                   const std::vector<ConfigManager::CameraInfo>& camList,
+                                   const ConfigManager& config) :
+      mEnumerator(enumerator), mConfig(config) {
+    // Copy the list of cameras we're to employ into our local storage.  We'll create and
+    // associate a StreamHandler with each of these cameras when we activate.
+    for (auto&& cam : camList) {
+        mActiveCameras.emplace_back(cam);
+    }
+}
+
+bool RenderTopViewCpu::activate() {
+    for (auto&& cam : mActiveCameras) {
+        Stream emptyConfig;
+        std::shared_ptr<IEvsCamera> pCamera;
+        if (auto status = mEnumerator->openCamera(cam.info.cameraId.c_str(), emptyConfig, &pCamera);
+            !status.isOk()) {
+            LOG(ERROR) << "Failed to allocate new EVS Camera interface for " << cam.info.cameraId;
+            deactivate();
+            return false;
+        }
+
+        cam.streamHandler = ndk::SharedRefBase::make<StreamHandler>(pCamera);
+        if (!cam.streamHandler) {
+            LOG(ERROR) << "Failed to allocate FrameHandler";
+            deactivate();
+            return false;
+        }
+
+        if (!cam.streamHandler->startStream()) {
+            LOG(ERROR) << "Start stream failed for " << cam.info.cameraId;
+            deactivate();
+            return false;
+        }
+    }
+
+    return true;
+}
+
+void RenderTopViewCpu::deactivate() {
+    // Release our video streams and the compositor's worker threads
+    for (auto&& cam : mActiveCameras) {
+        cam.streamHandler.reset();
+        cam.image = {};
+    }
+    mCompositor.reset();
+}
+
+bool RenderTopViewCpu::updateImage(unsigned cameraIndex) {
+    ActiveCamera& cam = mActiveCameras[cameraIndex];
+    if (!cam.streamHandler->newFrameAvailable()) {
+        // Keep composing the last frame we have
+        return true;
+    }
+
+    const BufferDesc& srcBuffer = cam.streamHandler->getNewFrame();
+    const auto frameGuard = android::base::make_scope_guard(
+            [&cam, &srcBuffer] { cam.streamHandler->doneWithFrame(srcBuffer); });
+    native_handle_t* srcBufferNativeHandle = getNativeHandle(srcBuffer);
+    if (srcBufferNativeHandle == nullptr) {
+        LOG(ERROR) << "Source buffer has an invalid native handle.";
+        return false;
+    }
+
+    const auto handleGuard = android::base::make_scope_guard(
+            [srcBufferNativeHandle] { free(srcBufferNativeHandle); });
+    const AHardwareBuffer_Desc* pSrcDesc =
+            reinterpret_cast<const AHardwareBuffer_Desc*>(&srcBuffer.buffer.description);
+    android::sp<android::GraphicBuffer> src = wrapBuffer(srcBufferNativeHandle, pSrcDesc);
+
+    unsigned char* srcPixels = nullptr;
+    src->lock(GRALLOC_USAGE_SW_READ_OFTEN, (void**)&srcPixels);
+    if (srcPixels == nullptr) {
+        LOG(ERROR) << "Failed to get pointer into src image data";
+        return false;
+    }
+
+    // The converters write the rows back to back.  Only the rows the compositor samples are
+    // converted; the ground is usually seen in the bottom half of a camera image.
+    const unsigned width = pSrcDesc->width;
+    const unsigned height = pSrcDesc->height;
+    const auto rows = mCompositor->getSourceRows(cameraIndex, width, height);
+    const unsigned numRows = rows.last - rows.first;
+    cam.pixels.resize(static_cast<size_t>(width) * height);
+    uint32_t* dstRows = cam.pixels.data() + static_cast<size_t>(rows.first) * width;
+    bool success = true;
+    if (pSrcDesc->format == HAL_PIXEL_FORMAT_YCRCB_420_SP) {  // 420SP == NV21
+        copyNV21toRGB32(width, height, rows.first, rows.last, srcPixels, cam.pixels.data(),
+                        width);
+    } else if (pSrcDesc->format == HAL_PIXEL_FORMAT_YV12) {  // YUV_420P == YV12
+        copyYV12toRGB32(width, height, rows.first, rows.last, srcPixels, cam.pixels.data(),
+                        width);
+    } else if (pSrcDesc->format == HAL_PIXEL_FORMAT_YCBCR_422_I) {  // YUYV
+        copyYUYVtoRGB32(width, numRows, srcPixels + rows.first * pSrcDesc->stride * 2,
+                        pSrcDesc->stride, dstRows, width);
+    } else if (pSrcDesc->format == HAL_PIXEL_FORMAT_RGBA_8888) {  // 32bit RGBA
+        copyMatchedInterleavedFormats(width, numRows,
+                                      srcPixels + rows.first * pSrcDesc->stride * sizeof(uint32_t),
+                                      pSrcDesc->stride, dstRows, width, sizeof(uint32_t));
+    } else {
+        LOG(ERROR) << "Unsupported source format " << pSrcDesc->format << " from "
+                   << cam.info.cameraId;
+        success = false;
+    }
+    src->unlock();
+
+    if (success) {
+        cam.image = {
+                .pixels = cam.pixels.data(),
+                .width = width,
+                .height = height,
+                .stride = width,
+        };
+    } else {
+        // The resize above may have reallocated the pixels the previous image points to
+        cam.image = {};
+    }
+    return success;
+}
+
+bool RenderTopViewCpu::drawFrame(const BufferDesc& tgtBuffer) {
+    native_handle_t* targetBufferNativeHandle = getNativeHandle(tgtBuffer);
+    if (targetBufferNativeHandle == nullptr) {
+        LOG(ERROR) << "Target buffer has an invalid native handle.";
+        return false;
+    }
+
+    const auto handleGuard = android::base::make_scope_guard(
+            [targetBufferNativeHandle] { free(targetBufferNativeHandle); });
+    const AHardwareBuffer_Desc* pTgtDesc =
+            reinterpret_cast<const AHardwareBuffer_Desc*>(&tgtBuffer.buffer.description);
+    if (pTgtDesc->format != HAL_PIXEL_FORMAT_RGBA_8888) {
+        LOG(ERROR) << "Diplay buffer is always expected to be 32bit RGBA";
+        return false;
+    }
+
+    if (!mCompositor || mCompositor->getWidth() != pTgtDesc->width ||
+        mCompositor->getHeight() != pTgtDesc->height) {
+        // The remap tables depend on the display size, so this only happens on the first frame
+        const float aspectRatio = static_cast<float>(pTgtDesc->width) / pTgtDesc->height;
+        const auto geometry = TopViewCompositor::getGeometry(mConfig, aspectRatio);
+        std::vector<ConfigManager::CameraInfo> cameras;
+        for (auto&& cam : mActiveCameras) {
+            cameras.push_back(cam.info);
+        }
+        mCompositor = std::make_unique<TopViewCompositor>(cameras, geometry, pTgtDesc->width,
+                                                          pTgtDesc->height);
+    }
+
+    // Bring the camera images up to date before locking the display buffer
+    std::vector<TopViewCompositor::Image> images;
+    images.reserve(mActiveCameras.size());
+    for (unsigned i = 0; i < mActiveCameras.size(); ++i) {
+        if (!updateImage(i)) {
+            LOG(WARNING) << "Failed to update the image of " << mActiveCameras[i].info.cameraId;
+        }
+        images.push_back(mActiveCameras[i].image);
+    }
+
+    android::sp<android::GraphicBuffer> tgt = wrapBuffer(targetBufferNativeHandle, pTgtDesc);
+    uint32_t* tgtPixels = nullptr;
+    tgt->lock(GRALLOC_USAGE_SW_WRITE_OFTEN, (void**)&tgtPixels);
+    if (tgtPixels == nullptr) {
+        LOG(ERROR) << "Failed to lock buffer contents for contents transfer";
+        return false;
+    }
+
+    mCompositor->compose(images, tgtPixels, pTgtDesc->stride);
+    tgt->unlock();
+    return true;
+}
@@ -0,0 +1,344 @@
+/*
+ * Copyright (C) 2024 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "TopViewCompositor.h"
+
+#include <android-base/logging.h>
+
+#include <math.h>
+#include <string.h>
+
+#include <algorithm>
+
+namespace {
+
+// Four 8bit channels and the same widened to 16bit lanes; the compiler maps operations on these
+// to NEON or SSE instructions.
+typedef uint8_t Pixel8 __attribute__((vector_size(4)));
+typedef uint16_t Pixel16 __attribute__((vector_size(8)));
+
+Pixel16 widen(uint32_t pixel) {
+    Pixel8 channels;
+    memcpy(&channels, &pixel, sizeof(channels));
+    return __builtin_convertvector(channels, Pixel16);
+}
+
+// Blends the 2x2 source pixels from |topLeft| with 8bit fixed point weights.  Each intermediate
+// value is at most 255 * 256, so it fits in a 16bit lane.
+uint32_t sampleBilinear(const uint32_t* topLeft, unsigned stride, uint16_t fracX,
+                        uint16_t fracY) {
+    const uint16_t invFracX = 256 - fracX;
+    const uint16_t invFracY = 256 - fracY;
+    const Pixel16 top = (widen(topLeft[0]) * invFracX + widen(topLeft[1]) * fracX) >> 8;
+    const Pixel16 bottom =
+            (widen(topLeft[stride]) * invFracX + widen(topLeft[stride + 1]) * fracX) >> 8;
+    const Pixel8 blended = __builtin_convertvector((top * invFracY + bottom * fracY) >> 8, Pixel8);
+
+    uint32_t pixel;
+    memcpy(&pixel, &blended, sizeof(pixel));
+    return pixel;
+}
+
+// Projects car space ground points into a camera image the way RenderTopView's projected texture
+// shader does.  Since we assume no roll in these views, the camera basis only depends on the yaw
+// and the pitch.
+class CameraProjection final {
+public:
+    explicit CameraProjection(const ConfigManager::CameraInfo& info) {
+        float sinPitch, cosPitch;
+        sincosf(info.pitch, &sinPitch, &cosPitch);
+        float sinYaw, cosYaw;
+        sincosf(info.yaw, &sinYaw, &cosYaw);
+
+        mAt[0] = cosPitch * -sinYaw;
+        mAt[1] = cosPitch * cosYaw;
+        mAt[2] = sinPitch;
+        mRight[0] = cosYaw;
+        mRight[1] = sinYaw;
+        mRight[2] = 0.0f;
+        // mUp = -cross(mAt, mRight)
+        mUp[0] = -(mAt[1] * mRight[2] - mAt[2] * mRight[1]);
+        mUp[1] = -(mAt[2] * mRight[0] - mAt[0] * mRight[2]);
+        mUp[2] = -(mAt[0] * mRight[1] - mAt[1] * mRight[0]);
+        for (int i = 0; i < 3; ++i) {
+            mEye[i] = info.position[i];
+        }
+        mTanHalfFovX = tanf(info.hfov * 0.5f);
+        mTanHalfFovY = tanf(info.vfov * 0.5f);
+    }
+
+    // Returns true and the texture coordinates if the ground point (x, y) is in the view
+    bool project(float x, float y, float* u, float* v) const {
+        const float d[3] = {x - mEye[0], y - mEye[1], -mEye[2]};
+        const float depth = dot(mAt, d);
+        if (depth <= 0.0f) {
+            return false;
+        }
+
+        const float ndcX = dot(mRight, d) / (depth * mTanHalfFovX);
+        const float ndcY = dot(mUp, d) / (depth * mTanHalfFovY);
+        *u = (ndcX + 1.0f) * 0.5f;
+        *v = (1.0f - ndcY) * 0.5f;  // The image rows go down
+        return *u >= 0.0f && *u <= 1.0f && *v >= 0.0f && *v <= 1.0f;
+    }
+
+private:
+    static float dot(const float* a, const float* b) {
+        return a[0] * b[0] + a[1] * b[1] + a[2] * b[2];
+    }
+
+    float mEye[3];
+    float mAt[3];
+    float mRight[3];
+    float mUp[3];
+    float mTanHalfFovX;
+    float mTanHalfFovY;
+};
+
+// Returns the top left source pixel and the weight of the next one for a texture coordinate
+void toSourcePixel(float coord, unsigned size, uint16_t* pixel, uint8_t* frac) {
+    // Texel centers are at half pixels
+    const float pos = std::clamp(coord * size - 0.5f, 0.0f, static_cast<float>(size - 1));
+    const unsigned first = std::min(static_cast<unsigned>(pos), size - 2);
+    *pixel = static_cast<uint16_t>(first);
+    *frac = static_cast<uint8_t>(std::min(lroundf((pos - first) * 256.0f), 255L));
+}
+
+}  // namespace
+
+TopViewCompositor::Geometry TopViewCompositor::getGeometry(const ConfigManager& config,
+                                                           float aspectRatio) {
+    return {
+            .left = config.getDisplayLeftLocation(aspectRatio),
+            .right = config.getDisplayRightLocation(aspectRatio),
+            .top = config.getDisplayTopLocation(),
+            .bottom = config.getDisplayBottomLocation(),
+            .carLeft = config.getLeftLocation(),
+            .carRight = config.getRightLocation(),
+            .carFront = config.getFrontLocation(),
+            .carRear = config.getRearLocation(),
+    };
+}
+
+TopViewCompositor::TopViewCompositor(const std::vector<ConfigManager::CameraInfo>& cameras,
+                                     const Geometry& geometry, unsigned width, unsigned height,
+                                     unsigned numThreads) :
+      mCameras(cameras),
+      mGeometry(geometry),
+      mWidth(width),
+      mHeight(height),
+      mNumBands(std::clamp(numThreads, 1u, std::max(height, 1u))),
+      mTables(cameras.size()) {
+    // Display columns and rows of the car body
+    const float unitsPerColumn = (mGeometry.right - mGeometry.left) / mWidth;
+    const float unitsPerRow = (mGeometry.top - mGeometry.bottom) / mHeight;
+    const float maxColumn = static_cast<float>(mWidth);
+    const float maxRow = static_cast<float>(mHeight);
+    auto toColumn = [&](float x) {
+        return static_cast<unsigned>(
+                std::clamp((x - mGeometry.left) / unitsPerColumn, 0.0f, maxColumn));
+    };
+    auto toRow = [&](float y) {
+        return static_cast<unsigned>(std::clamp((mGeometry.top - y) / unitsPerRow, 0.0f, maxRow));
+    };
+    mCarLeftColumn = toColumn(mGeometry.carLeft);
+    mCarRightColumn = toColumn(mGeometry.carRight);
+    mCarTopRow = toRow(mGeometry.carFront);
+    mCarBottomRow = toRow(mGeometry.carRear);
+
+    std::vector<CameraProjection> projections;
+    projections.reserve(mCameras.size());
+    for (auto&& camera : mCameras) {
+        projections.emplace_back(camera);
+    }
+    mOwners.assign(static_cast<size_t>(mWidth) * mHeight, -1);
+    for (unsigned y = 0; y < mHeight; ++y) {
+        for (unsigned x = 0; x < mWidth; ++x) {
+            if (x >= mCarLeftColumn && x < mCarRightColumn && y >= mCarTopRow &&
+                y < mCarBottomRow) {
+                continue;
+            }
+            const float carX = getCarX(x);
+            const float carY = getCarY(y);
+            for (int i = static_cast<int>(projections.size()) - 1; i >= 0; --i) {
+                float u, v;
+                if (projections[i].project(carX, carY, &u, &v)) {
+                    mOwners[y * mWidth + x] = i;
+                    break;
+                }
+            }
+        }
+    }
+
+    // The caller of compose() works on the first band
+    mWorkers.reserve(mNumBands - 1);
+    for (unsigned band = 1; band < mNumBands; ++band) {
+        mWorkers.emplace_back([this, band]() { runWorker(band); });
+    }
+}
+
+TopViewCompositor::~TopViewCompositor() {
+    {
+        std::lock_guard<std::mutex> lock(mLock);
+        mQuit = true;
+    }
+    mWorkReady.notify_all();
+    for (auto&& worker : mWorkers) {
+        worker.join();
+    }
+}
+
+void TopViewCompositor::buildRemapTable(unsigned cameraIndex, unsigned srcWidth,
+                                        unsigned srcHeight) {
+    LOG(DEBUG) << "Building a remap table of camera " << mCameras[cameraIndex].cameraId << " for "
+               << srcWidth << " x " << srcHeight << " images";
+    RemapTable& table = mTables[cameraIndex];
+    table.srcWidth = srcWidth;
+    table.srcHeight = srcHeight;
+    table.entries.clear();
+    table.rowStart.assign(mHeight + 1, 0);
+    table.sourceRows = {};
+    if (srcWidth < 2 || srcHeight < 2) {
+        // Nothing to interpolate between
+        return;
+    }
+
+    const CameraProjection projection(mCameras[cameraIndex]);
+    for (unsigned y = 0; y < mHeight; ++y) {
+        table.rowStart[y] = table.entries.size();
+        const int8_t* owners = mOwners.data() + y * mWidth;
+        for (unsigned x = 0; x < mWidth; ++x) {
+            if (owners[x] != static_cast<int>(cameraIndex)) {
+                continue;
+            }
+
+            float u = 0.0f, v = 0.0f;
+            projection.project(getCarX(x), getCarY(y), &u, &v);
+            RemapEntry entry = {.dstX = static_cast<uint16_t>(x)};
+            toSourcePixel(u, srcWidth, &entry.srcX, &entry.fracX);
+            toSourcePixel(v, srcHeight, &entry.srcY, &entry.fracY);
+            table.entries.push_back(entry);
+        }
+    }
+    table.rowStart[mHeight] = table.entries.size();
+
+    if (!table.entries.empty()) {
+        // Each entry also samples the row below its source pixel
+        const auto [top, bottom] =
+                std::minmax_element(table.entries.begin(), table.entries.end(),
+                                    [](const RemapEntry& lhs, const RemapEntry& rhs) {
+                                        return lhs.srcY < rhs.srcY;
+                                    });
+        table.sourceRows = {.first = top->srcY, .last = bottom->srcY + 2u};
+    }
+}
+
+TopViewCompositor::SourceRows TopViewCompositor::getSourceRows(unsigned cameraIndex,
+                                                               unsigned srcWidth,
+                                                               unsigned srcHeight) {
+    if (cameraIndex >= mTables.size()) {
+        return {};
+    }
+
+    RemapTable& table = mTables[cameraIndex];
+    if (srcWidth != table.srcWidth || srcHeight != table.srcHeight) {
+        buildRemapTable(cameraIndex, srcWidth, srcHeight);
+    }
+    return table.sourceRows;
+}
+
+void TopViewCompositor::compose(const std::vector<Image>& inputs, uint32_t* dst,
+                                unsigned dstStride) {
+    if (inputs.size() != mCameras.size()) {
+        LOG(WARNING) << "Expected " << mCameras.size() << " images but received "
+                     << inputs.size();
+    }
+
+    for (unsigned i = 0; i < std::min(inputs.size(), mTables.size()); ++i) {
+        const Image& input = inputs[i];
+        if (input.pixels != nullptr &&
+            (input.width != mTables[i].srcWidth || input.height != mTables[i].srcHeight)) {
+            buildRemapTable(i, input.width, input.height);
+        }
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(mLock);
+        mInputs = &inputs;
+        mDst = dst;
+        mDstStride = dstStride;
+        mPendingBands = mNumBands - 1;
+        ++mGeneration;
+    }
+    mWorkReady.notify_all();
+
+    composeRows(0, mHeight / mNumBands);
+
+    std::unique_lock<std::mutex> lock(mLock);
+    mWorkDone.wait(lock, [this]() { return mPendingBands == 0; });
+}
+
+void TopViewCompositor::runWorker(unsigned band) {
+    const unsigned firstRow = band * mHeight / mNumBands;
+    const unsigned lastRow = (band + 1) * mHeight / mNumBands;
+    uint64_t generation = 0;
+    while (true) {
+        {
+            std::unique_lock<std::mutex> lock(mLock);
+            mWorkReady.wait(lock, [&]() { return mQuit || mGeneration != generation; });
+            if (mQuit) {
+                return;
+            }
+            generation = mGeneration;
+        }
+
+        composeRows(firstRow, lastRow);
+
+        std::lock_guard<std::mutex> lock(mLock);
+        if (--mPendingBands == 0) {
+            mWorkDone.notify_one();
+        }
+    }
+}
+
+void TopViewCompositor::composeRows(unsigned firstRow, unsigned lastRow) {
+    const std::vector<Image>& inputs = *mInputs;
+    const unsigned numInputs = std::min(inputs.size(), mTables.size());
+    for (unsigned y = firstRow; y < lastRow; ++y) {
+        uint32_t* row = mDst + y * mDstStride;
+        std::fill(row, row + mWidth, kBackgroundColor);
+        if (y >= mCarTopRow && y < mCarBottomRow) {
+            std::fill(row + mCarLeftColumn, row + mCarRightColumn, kCarColor);
+        }
+
+        for (unsigned i = 0; i < numInputs; ++i) {
+            const Image& input = inputs[i];
+            const RemapTable& table = mTables[i];
+            if (input.pixels == nullptr || input.width != table.srcWidth ||
+                input.height != table.srcHeight || table.entries.empty()) {
+                continue;
+            }
+
+            const RemapEntry* entry = table.entries.data() + table.rowStart[y];
+            const RemapEntry* end = table.entries.data() + table.rowStart[y + 1];
+            for (; entry != end; ++entry) {
+                row[entry->dstX] =
+                        sampleBilinear(input.pixels + entry->srcY * input.stride + entry->srcX,
+                                       input.stride, entry->fracX, entry->fracY);
+            }
+        }
+    }
+}
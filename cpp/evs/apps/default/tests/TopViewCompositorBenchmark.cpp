@@ -0,0 +1,170 @@
+/*
+ * Copyright (C) 2024 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "FormatConvert.h"
+#include "TopViewCompositor.h"
+
+#include <benchmark/benchmark.h>
+
+#include <math.h>
+
+#include <vector>
+
+namespace {
+
+constexpr unsigned kDisplayWidth = 1280;
+constexpr unsigned kDisplayHeight = 720;
+constexpr unsigned kCameraWidth = 1280;
+constexpr unsigned kCameraHeight = 720;
+
+ConfigManager::CameraInfo makeCamera(float x, float y, float z, float yawDegrees, float hfovDegrees,
+                                     float vfovDegrees) {
+    constexpr float kDegreesToRadians = M_PI / 180.0f;
+    ConfigManager::CameraInfo info;
+    info.position[0] = x;
+    info.position[1] = y;
+    info.position[2] = z;
+    info.yaw = yawDegrees * kDegreesToRadians;
+    info.pitch = -10.0f * kDegreesToRadians;
+    info.hfov = hfovDegrees * kDegreesToRadians;
+    info.vfov = vfovDegrees * kDegreesToRadians;
+    return info;
+}
+
+// The four cameras and the car of res/config.json
+std::vector<ConfigManager::CameraInfo> getCameras() {
+    return {
+            makeCamera(0.0f, 20.0f, 48.0f, 180.0f, 115.0f, 80.0f),
+            makeCamera(0.0f, 100.0f, 48.0f, 0.0f, 115.0f, 80.0f),
+            makeCamera(-25.0f, 60.0f, 88.0f, -90.0f, 60.0f, 62.0f),
+            makeCamera(20.0f, 60.0f, 88.0f, 90.0f, 60.0f, 62.0f),
+    };
+}
+
+TopViewCompositor::Geometry getGeometry() {
+    constexpr float kCarWidth = 76.7f;
+    constexpr float kWheelBase = 117.9f;
+    constexpr float kFrontExtent = 44.7f;
+    constexpr float kRearExtent = 40.0f;
+    constexpr float kFrontRange = 100.0f;
+    constexpr float kRearRange = 100.0f;
+    const float top = kWheelBase + kFrontExtent + kFrontRange;
+    const float bottom = -kRearExtent - kRearRange;
+    const float right = (top - bottom) * 0.5f * kDisplayWidth / kDisplayHeight;
+    return {
+            .left = -right,
+            .right = right,
+            .top = top,
+            .bottom = bottom,
+            .carLeft = -kCarWidth * 0.5f,
+            .carRight = kCarWidth * 0.5f,
+            .carFront = kWheelBase + kFrontExtent,
+            .carRear = -kRearExtent,
+    };
+}
+
+// Returns an NV21 frame with a Y value gradient and neutral chroma
+std::vector<uint8_t> makeNv21Frame(unsigned seed) {
+    std::vector<uint8_t> frame(kCameraWidth * kCameraHeight * 3 / 2, 128);
+    for (size_t p = 0; p < kCameraWidth * kCameraHeight; ++p) {
+        frame[p] = static_cast<uint8_t>(p * 2654435761u + seed);
+    }
+    return frame;
+}
+
+void BM_Compose(benchmark::State& state) {
+    const auto cameras = getCameras();
+    TopViewCompositor compositor(cameras, getGeometry(), kDisplayWidth, kDisplayHeight,
+                                 state.range(0));
+
+    std::vector<std::vector<uint32_t>> frames(cameras.size());
+    std::vector<TopViewCompositor::Image> images;
+    for (size_t i = 0; i < frames.size(); ++i) {
+        frames[i].resize(kCameraWidth * kCameraHeight);
+        for (size_t p = 0; p < frames[i].size(); ++p) {
+            frames[i][p] = 0xFF000000 | (p * 2654435761u + i);
+        }
+        images.push_back({
+                .pixels = frames[i].data(),
+                .width = kCameraWidth,
+                .height = kCameraHeight,
+                .stride = kCameraWidth,
+        });
+    }
+    std::vector<uint32_t> display(kDisplayWidth * kDisplayHeight);
+
+    // Builds the remap tables
+    compositor.compose(images, display.data(), kDisplayWidth);
+
+    for (auto _ : state) {
+        compositor.compose(images, display.data(), kDisplayWidth);
+        benchmark::DoNotOptimize(display.data());
+        benchmark::ClobberMemory();
+    }
+}
+
+// Converts the sampled rows of four NV21 camera frames to RGBA and composes them, as
+// RenderTopViewCpu does for each display frame
+void BM_ConvertAndCompose(benchmark::State& state) {
+    const auto cameras = getCameras();
+    TopViewCompositor compositor(cameras, getGeometry(), kDisplayWidth, kDisplayHeight,
+                                 state.range(0));
+
+    std::vector<std::vector<uint8_t>> frames;
+    std::vector<std::vector<uint32_t>> pixels(cameras.size());
+    std::vector<TopViewCompositor::Image> images;
+    for (size_t i = 0; i < cameras.size(); ++i) {
+        frames.push_back(makeNv21Frame(i));
+        pixels[i].resize(kCameraWidth * kCameraHeight);
+        images.push_back({
+                .pixels = pixels[i].data(),
+                .width = kCameraWidth,
+                .height = kCameraHeight,
+                .stride = kCameraWidth,
+        });
+    }
+    std::vector<uint32_t> display(kDisplayWidth * kDisplayHeight);
+
+    // Builds the remap tables
+    compositor.compose(images, display.data(), kDisplayWidth);
+
+    for (auto _ : state) {
+        for (size_t i = 0; i < frames.size(); ++i) {
+            const auto rows = compositor.getSourceRows(i, kCameraWidth, kCameraHeight);
+            copyNV21toRGB32(kCameraWidth, kCameraHeight, rows.first, rows.last, frames[i].data(),
+                            pixels[i].data(), kCameraWidth);
+        }
+        compositor.compose(images, display.data(), kDisplayWidth);
+        benchmark::DoNotOptimize(display.data());
+        benchmark::ClobberMemory();
+    }
+}
+
+}  // namespace
+
+// Reports the time per 1280x720 composition of four 1280x720 camera images
+BENCHMARK(BM_Compose)->Arg(1)->Arg(2)->Arg(4)->Unit(benchmark::kMillisecond)->UseRealTime();
+
+// Reports the time per display frame of RenderTopViewCpu, including the conversion of the camera
+// frames
+BENCHMARK(BM_ConvertAndCompose)
+        ->Arg(1)
+        ->Arg(2)
+        ->Arg(4)
+        ->Unit(benchmark::kMillisecond)
+        ->UseRealTime();
+
+BENCHMARK_MAIN();
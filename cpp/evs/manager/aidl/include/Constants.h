@@ -21,3 +21,34 @@
 
 inline constexpr int32_t kDisplayIdUnavailable = std::numeric_limits<int32_t>::min();
 inline constexpr int32_t kExclusiveDisplayId = std::numeric_limits<uint8_t>::max();
+
+namespace aidl::android::automotive::evs::implementation {
+
+// Frame delivery priority of a client, which is assigned when the client opens a camera. A
+// smaller value is served first.
+enum class LatencyClass : int32_t {
+    // Clients that render a safety-critical view such as the rearview.
+    SAFETY_CRITICAL = 0,
+    // Clients that render a view to the user.
+    INTERACTIVE,
+    // Clients such as recorders and analytics; these miss frames when the frame delivery budget
+    // is exceeded.
+    BACKGROUND,
+
+    NUM_LATENCY_CLASSES,
+};
+
+inline const char* toString(LatencyClass latencyClass) {
+    switch (latencyClass) {
+        case LatencyClass::SAFETY_CRITICAL:
+            return "SAFETY_CRITICAL";
+        case LatencyClass::INTERACTIVE:
+            return "INTERACTIVE";
+        case LatencyClass::BACKGROUND:
+            return "BACKGROUND";
+        default:
+            return "UNKNOWN";
+    }
+}
+
+}  // namespace aidl::android::automotive::evs::implementation
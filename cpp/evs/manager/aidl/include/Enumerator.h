@@ -17,6 +17,7 @@
 #ifndef CPP_EVS_MANAGER_AIDL_INCLUDE_ENUMERATOR_H
 #define CPP_EVS_MANAGER_AIDL_INCLUDE_ENUMERATOR_H
 
+#include "Constants.h"
 #include "HalCamera.h"
 #include "VirtualCamera.h"
 #include "stats/include/StatsCollector.h"
@@ -67,6 +68,9 @@ public:
 
     // Implementation details
     bool init(const std::string_view& hardwareServiceName);
+    // Sets the latency classes of the clients by their UIDs. A client not listed here is
+    // INTERACTIVE. This must be called before the service is registered.
+    void setLatencyClasses(const std::unordered_map<uid_t, LatencyClass>& latencyClasses);
     void broadcastDeviceStatusChange(const std::vector<aidlevs::DeviceStatus>& list);
 
     // Destructor
@@ -141,6 +145,9 @@ private:
 
     bool mDisablePermissionCheck = false;
 
+    // Latency classes of the clients, which are configured by the command line options
+    std::unordered_map<uid_t, LatencyClass> mLatencyClasses;
+
     std::list<std::weak_ptr<VirtualCamera>> mActiveCameraClients;
 };
 
@@ -58,7 +58,8 @@ public:
     virtual ~HalCamera();
 
     // Factory methods for client VirtualCameras
-    std::shared_ptr<VirtualCamera> makeVirtualCamera();
+    std::shared_ptr<VirtualCamera> makeVirtualCamera(
+            LatencyClass latencyClass = LatencyClass::INTERACTIVE);
     bool ownVirtualCamera(const std::shared_ptr<VirtualCamera>& virtualCamera);
     void disownVirtualCamera(const VirtualCamera* virtualCamera);
 
@@ -117,6 +118,8 @@ private:
     struct FrameRequest {
         std::weak_ptr<VirtualCamera> client;
         int64_t timestamp = -1;
+        // Number of consecutive frames skipped to stay within the frame delivery budget
+        unsigned framesSkippedOverBudget = 0;
     };
 
     // synchronization
@@ -29,6 +29,8 @@
 #include <aidl/android/hardware/automotive/evs/Stream.h>
 #include <android-base/thread_annotations.h>
 
+#include "Constants.h"
+
 #include <condition_variable>
 #include <deque>
 #include <set>
@@ -75,10 +77,12 @@ public:
     ::ndk::ScopedAStatus stopVideoStream() override;
     ::ndk::ScopedAStatus unsetPrimaryClient() override;
 
-    explicit VirtualCamera(const std::vector<std::shared_ptr<HalCamera>>& halCameras);
+    explicit VirtualCamera(const std::vector<std::shared_ptr<HalCamera>>& halCameras,
+                           LatencyClass latencyClass = LatencyClass::INTERACTIVE);
     virtual ~VirtualCamera();
 
     unsigned getAllowedBuffers() { return mFramesAllowed; };
+    LatencyClass getLatencyClass() const { return mLatencyClass; }
     bool isStreaming() {
         std::lock_guard lock(mMutex);
         return mStreamState == RUNNING;
@@ -88,7 +92,7 @@ public:
 
     // Proxy to receive frames and forward them to the client's stream
     bool notify(const aidlevs::EvsEventDesc& event);
-    bool deliverFrame(const aidlevs::BufferDesc& bufDesc);
+    virtual bool deliverFrame(const aidlevs::BufferDesc& bufDesc);
 
     // Dump current status to a given file descriptor
     std::string toString(const char* indent = "") const NO_THREAD_SAFETY_ANALYSIS;
@@ -103,6 +107,9 @@ private:
 
     std::shared_ptr<aidlevs::IEvsCameraStream> mStream;
 
+    // Frame delivery priority of this client
+    const LatencyClass mLatencyClass;
+
     unsigned mFramesAllowed = 1;
     enum {
         STOPPED,
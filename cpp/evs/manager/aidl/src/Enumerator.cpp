@@ -32,6 +32,7 @@ namespace {
 
 namespace hidlevs = ::android::hardware::automotive::evs;
 
+using ::aidl::android::automotive::evs::implementation::LatencyClass;
 using ::aidl::android::hardware::automotive::evs::CameraDesc;
 using ::aidl::android::hardware::automotive::evs::DisplayState;
 using ::aidl::android::hardware::automotive::evs::EvsResult;
@@ -422,8 +423,14 @@ ScopedAStatus Enumerator::openCamera(const std::string& id, const Stream& cfg,
 
         // TODO(b/147170360): Implement a logic to handle a failure.
         // 3. Create a proxy camera object
+        // The latency class of a client is configured by its UID because the client cannot
+        // declare it through IEvsEnumerator.
+        const auto latencyClassIt = mLatencyClasses.find(AIBinder_getCallingUid());
+        const LatencyClass latencyClass = latencyClassIt != mLatencyClasses.end()
+                ? latencyClassIt->second
+                : LatencyClass::INTERACTIVE;
         std::shared_ptr<VirtualCamera> clientCamera =
-                ::ndk::SharedRefBase::make<VirtualCamera>(sourceCameras);
+                ::ndk::SharedRefBase::make<VirtualCamera>(sourceCameras, latencyClass);
         if (!clientCamera) {
             // TODO(b/213108625): Any resource needs to be cleaned up explicitly?
             LOG(ERROR) << "Failed to create a client camera object";
@@ -951,4 +958,8 @@ void Enumerator::enablePermissionCheck(bool enable) {
     mDisablePermissionCheck = !enable;
 }
 
+void Enumerator::setLatencyClasses(const std::unordered_map<uid_t, LatencyClass>& latencyClasses) {
+    mLatencyClasses = latencyClasses;
+}
+
 }  // namespace aidl::android::automotive::evs::implementation
@@ -24,6 +24,9 @@
 #include <android-base/file.h>
 #include <android-base/logging.h>
 
+#include <algorithm>
+#include <chrono>
+
 namespace aidl::android::automotive::evs::implementation {
 
 using ::aidl::android::hardware::automotive::evs::BufferDesc;
@@ -35,6 +38,18 @@ using ::aidl::android::hardware::automotive::evs::Stream;
 using ::android::base::StringAppendF;
 using ::ndk::ScopedAStatus;
 
+namespace {
+
+// Time budget to deliver a frame to the clients. Once it is exceeded, the frame is not delivered to
+// the background clients, which stay in the queue for the next frame.
+constexpr std::chrono::milliseconds kFrameDeliveryBudget(8);
+
+// Maximum number of consecutive frames a background client skips over the budget. The next frame
+// is delivered to it regardless of the budget so it is not starved.
+constexpr unsigned kMaxFramesSkippedOverBudget = 2;
+
+}  // namespace
+
 // TODO(b/213108625):
 // We need to hook up death monitoring to detect stream death so we can attempt a reconnect
 
@@ -45,13 +60,13 @@ HalCamera::~HalCamera() {
     mUsageStats->writeStats();
 }
 
-std::shared_ptr<VirtualCamera> HalCamera::makeVirtualCamera() {
+std::shared_ptr<VirtualCamera> HalCamera::makeVirtualCamera(LatencyClass latencyClass) {
     // Create the client camera interface object
     std::vector<std::shared_ptr<HalCamera>> sourceCameras;
     sourceCameras.reserve(1);
     sourceCameras.push_back(std::move(ref<HalCamera>()));
     std::shared_ptr<VirtualCamera> client =
-            ::ndk::SharedRefBase::make<VirtualCamera>(sourceCameras);
+            ::ndk::SharedRefBase::make<VirtualCamera>(sourceCameras, latencyClass);
     if (!client || !ownVirtualCamera(client)) {
         LOG(ERROR) << "Failed to create client camera object";
         return nullptr;
@@ -332,32 +347,51 @@ ScopedAStatus HalCamera::deliverFrame(const std::vector<BufferDesc>& buffers) {
     // TODO(b/145750636): For now, we are using a approximately half of 1 seconds / 30 frames = 33ms
     //           but this must be derived from current framerate.
     constexpr int64_t kThreshold = 16'000;  // ms
+    const auto deliveryStart = std::chrono::steady_clock::now();
     unsigned frameDeliveries = 0;
-    std::deque<FrameRequest> currentRequests;
+    std::vector<std::pair<std::shared_ptr<VirtualCamera>, FrameRequest>> currentRequests;
     std::deque<FrameRequest> puntedRequests;
     {
         std::lock_guard<std::mutex> lock(mFrameMutex);
-        currentRequests.insert(currentRequests.end(),
-                               std::make_move_iterator(mNextRequests.begin()),
-                               std::make_move_iterator(mNextRequests.end()));
+        currentRequests.reserve(mNextRequests.size());
+        for (auto&& req : mNextRequests) {
+            std::shared_ptr<VirtualCamera> vCam = req.client.lock();
+            if (!vCam) {
+                // Ignore a client already dead.
+                continue;
+            }
+            currentRequests.emplace_back(std::move(vCam), std::move(req));
+        }
         mNextRequests.clear();
         mFrameOpInProgress = true;
     }
 
-    while (!currentRequests.empty()) {
-        auto req = currentRequests.front();
-        currentRequests.pop_front();
-        std::shared_ptr<VirtualCamera> vCam = req.client.lock();
-        if (!vCam) {
-            // Ignore a client already dead.
-            continue;
-        }
+    // Serves the clients in the higher latency classes first. Clients in the same class are served
+    // in the order of their requests.
+    std::stable_sort(currentRequests.begin(), currentRequests.end(),
+                     [](const auto& lhs, const auto& rhs) {
+                         return lhs.first->getLatencyClass() < rhs.first->getLatencyClass();
+                     });
 
+    for (auto&& [vCam, req] : currentRequests) {
         if (timestamp - req.timestamp < kThreshold) {
             // Skip current frame because it arrives too soon.
             LOG(DEBUG) << "Skips a frame from " << getId();
             mUsageStats->framesSkippedToSync();
-            puntedRequests.push_back(req);
+            puntedRequests.push_back(std::move(req));
+            continue;
+        }
+
+        const auto latencyClass = vCam->getLatencyClass();
+        if (latencyClass == LatencyClass::BACKGROUND &&
+            req.framesSkippedOverBudget < kMaxFramesSkippedOverBudget &&
+            std::chrono::steady_clock::now() - deliveryStart > kFrameDeliveryBudget) {
+            // Skip current frame because the higher classes have used up the budget.
+            LOG(DEBUG) << "Skips a frame from " << getId() << " for a background client "
+                       << vCam.get();
+            mUsageStats->framesSkippedOverBudget();
+            ++req.framesSkippedOverBudget;
+            puntedRequests.push_back(std::move(req));
             continue;
         }
 
@@ -367,6 +401,10 @@ ScopedAStatus HalCamera::deliverFrame(const std::vector<BufferDesc>& buffers) {
             LOG(DEBUG) << getId() << " forwarded the buffer #" << buffers[0].bufferId << " to "
                        << vCam.get() << " from " << this;
             ++frameDeliveries;
+            mUsageStats->framesDelivered(latencyClass,
+                                         std::chrono::duration_cast<std::chrono::microseconds>(
+                                                 std::chrono::steady_clock::now() - deliveryStart)
+                                                 .count());
         }
     }
 
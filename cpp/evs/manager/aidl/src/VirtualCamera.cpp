@@ -48,8 +48,9 @@ using ::android::base::StringAppendF;
 using ::ndk::ScopedAStatus;
 using ::std::chrono_literals::operator""s;
 
-VirtualCamera::VirtualCamera(const std::vector<std::shared_ptr<HalCamera>>& halCameras) :
-      mStreamState(STOPPED) {
+VirtualCamera::VirtualCamera(const std::vector<std::shared_ptr<HalCamera>>& halCameras,
+                             LatencyClass latencyClass) :
+      mLatencyClass(latencyClass), mStreamState(STOPPED) {
     for (auto&& cam : halCameras) {
         mHalCamera.insert_or_assign(cam->getId(), cam);
     }
@@ -872,9 +873,11 @@ std::string VirtualCamera::toString(const char* indent) const {
     std::string buffer;
     StringAppendF(&buffer,
                   "%sLogical camera device: %s\n"
+                  "%sLatency class: %s\n"
                   "%sFramesAllowed: %u\n"
                   "%sFrames in use:\n",
-                  indent, mHalCamera.size() > 1 ? "T" : "F", indent, mFramesAllowed, indent);
+                  indent, mHalCamera.size() > 1 ? "T" : "F", indent,
+                  implementation::toString(mLatencyClass), indent, mFramesAllowed, indent);
 
     std::string next_indent(indent);
     next_indent += "\t";
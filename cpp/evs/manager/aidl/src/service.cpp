@@ -19,25 +19,31 @@
 #include "ServiceNames.h"
 
 #include <android-base/logging.h>
+#include <android-base/parseint.h>
 #include <android/binder_manager.h>
 #include <android/binder_process.h>
 #include <android/hardware/automotive/evs/1.1/IEvsEnumerator.h>
 #include <hidl/HidlTransportSupport.h>
 
 #include <string_view>
+#include <unordered_map>
 
 namespace {
 
 using ::aidl::android::automotive::evs::implementation::Enumerator;
 using ::aidl::android::automotive::evs::implementation::HidlEnumerator;
+using ::aidl::android::automotive::evs::implementation::LatencyClass;
+using ::android::base::ParseUint;
 using ::android::hardware::configureRpcThreadpool;
 
 const std::string kSeparator = "/";
 
 void startService(const std::string_view& hardwareServiceName,
-                  const std::string_view& managerServiceName) {
+                  const std::string_view& managerServiceName,
+                  const std::unordered_map<uid_t, LatencyClass>& latencyClasses) {
     LOG(INFO) << "EVS managed service connecting to hardware service at " << hardwareServiceName;
     std::shared_ptr<Enumerator> aidlService = ::ndk::SharedRefBase::make<Enumerator>();
+    aidlService->setLatencyClasses(latencyClasses);
     if (!aidlService->init(hardwareServiceName)) {
         LOG(FATAL) << "Error while connecting to the hardware service, " << hardwareServiceName;
     }
@@ -80,6 +86,7 @@ int main(int argc, char** argv) {
     // Set up default behavior, then check for command line options
     bool printHelp = false;
     std::string_view evsHardwareServiceName = kHardwareEnumeratorName;
+    std::unordered_map<uid_t, LatencyClass> latencyClasses;
     for (int i = 1; i < argc; i++) {
         if (strcmp(argv[i], "--mock") == 0) {
             evsHardwareServiceName = kMockEnumeratorName;
@@ -90,6 +97,18 @@ int main(int argc, char** argv) {
             } else {
                 evsHardwareServiceName = argv[i];
             }
+        } else if (strcmp(argv[i], "--safety-critical-uid") == 0 ||
+                   strcmp(argv[i], "--background-uid") == 0) {
+            const LatencyClass latencyClass = strcmp(argv[i], "--safety-critical-uid") == 0
+                    ? LatencyClass::SAFETY_CRITICAL
+                    : LatencyClass::BACKGROUND;
+            i++;
+            uid_t uid;
+            if (i >= argc || !ParseUint(argv[i], &uid)) {
+                LOG(ERROR) << argv[i - 1] << " <uid> was not provided with a valid uid";
+            } else {
+                latencyClasses[uid] = latencyClass;
+            }
         } else if (strcmp(argv[i], "--help") == 0) {
             printHelp = true;
         } else {
@@ -101,7 +120,10 @@ int main(int argc, char** argv) {
     if (printHelp) {
         printf("Options include:\n");
         printf("  --mock                   Connect to the mock driver at EvsEnumeratorHw-Mock\n");
-        printf("  --target <service_name>  Connect to the named IEvsEnumerator service");
+        printf("  --target <service_name>  Connect to the named IEvsEnumerator service\n");
+        printf("  --safety-critical-uid <uid>  Deliver frames to this client first\n");
+        printf("  --background-uid <uid>   Skip frames of this client once the delivery budget is "
+               "used up");
         return EXIT_SUCCESS;
     }
 
@@ -114,7 +136,8 @@ int main(int argc, char** argv) {
 
     // The connection to the underlying hardware service must happen on a dedicated thread to ensure
     // that the hwbinder response can be processed by the thread pool without blocking.
-    std::thread registrationThread(startService, evsHardwareServiceName, kManagedEnumeratorName);
+    std::thread registrationThread(startService, evsHardwareServiceName, kManagedEnumeratorName,
+                                   latencyClasses);
 
     // Send this main thread to become a permanent part of the thread pool.
     // This is not expected to return.
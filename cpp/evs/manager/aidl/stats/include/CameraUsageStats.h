@@ -17,12 +17,15 @@
 #ifndef CPP_EVS_MANAGER_AIDL_STATS_INCLUDE_CAMERAUSAGESTATS_H
 #define CPP_EVS_MANAGER_AIDL_STATS_INCLUDE_CAMERAUSAGESTATS_H
 
+#include "Constants.h"
+
 #include <aidl/android/hardware/automotive/evs/BufferDesc.h>
 #include <android-base/stringprintf.h>
 #include <utils/Mutex.h>
 #include <utils/RefBase.h>
 #include <utils/SystemClock.h>
 
+#include <array>
 #include <cinttypes>
 #include <queue>
 #include <unordered_map>
@@ -31,6 +34,24 @@ namespace aidl::android::automotive::evs::implementation {
 
 namespace aidlevs = ::aidl::android::hardware::automotive::evs;
 
+// Frame delivery latencies of the clients in a latency class, measured from the frame arrival to
+// the delivery to each client.
+struct DeliveryLatencyRecord {
+    // Number of frames delivered
+    int64_t framesDelivered;
+
+    // Sum of the delivery latencies in microseconds
+    int64_t sumLatencyUs;
+
+    // Peak delivery latency in microseconds
+    int64_t peakLatencyUs;
+
+    // Average delivery latency in microseconds
+    double getAvgLatencyUs() const {
+        return framesDelivered > 0 ? static_cast<double>(sumLatencyUs) / framesDelivered : 0;
+    }
+};
+
 struct CameraUsageStatsRecord {
 public:
     // Time a snapshot is generated
@@ -63,6 +84,14 @@ public:
     // Peak number of active clients
     int32_t peakClientsCount;
 
+    // Number of frames not delivered to the background clients to stay within the frame delivery
+    // budget
+    int64_t framesSkippedOverBudget;
+
+    // Frame delivery latencies per latency class
+    std::array<DeliveryLatencyRecord, static_cast<size_t>(LatencyClass::NUM_LATENCY_CLASSES)>
+            deliveryLatencies;
+
     // Calculates a delta between two records
     CameraUsageStatsRecord& operator-=(const CameraUsageStatsRecord& rhs) {
         // Only calculates differences in the frame statistics
@@ -71,6 +100,11 @@ public:
         framesIgnored = framesIgnored - rhs.framesIgnored;
         framesSkippedToSync = framesSkippedToSync - rhs.framesSkippedToSync;
         erroneousEventsCount = erroneousEventsCount - rhs.erroneousEventsCount;
+        framesSkippedOverBudget = framesSkippedOverBudget - rhs.framesSkippedOverBudget;
+        for (size_t i = 0; i < deliveryLatencies.size(); ++i) {
+            deliveryLatencies[i].framesDelivered -= rhs.deliveryLatencies[i].framesDelivered;
+            deliveryLatencies[i].sumLatencyUs -= rhs.deliveryLatencies[i].sumLatencyUs;
+        }
 
         return *this;
     }
@@ -93,12 +127,25 @@ public:
                                        "%sFrames First Roundtrip: %" PRId64 "\n"
                                        "%sFrames Peak Roundtrip: %" PRId64 "\n"
                                        "%sFrames Average Roundtrip: %f\n"
-                                       "%sPeak Number of Clients: %" PRId32 "\n\n",
+                                       "%sFrames Skipped Over Budget: %" PRId64 "\n"
+                                       "%sPeak Number of Clients: %" PRId32 "\n",
                                        indent, ns2ms(timestamp), indent, framesReceived, indent,
                                        framesReturned, indent, framesIgnored, indent,
                                        framesSkippedToSync, indent, framesFirstRoundtripLatency,
                                        indent, framesPeakRoundtripLatency, indent,
-                                       framesAvgRoundtripLatency, indent, peakClientsCount);
+                                       framesAvgRoundtripLatency, indent, framesSkippedOverBudget,
+                                       indent, peakClientsCount);
+        for (size_t i = 0; i < deliveryLatencies.size(); ++i) {
+            const auto& record = deliveryLatencies[i];
+            ::android::base::StringAppendF(&buffer,
+                                           "%sDelivery Latency (%s): %" PRId64
+                                           " frames, average %f us, peak %" PRId64 " us\n",
+                                           indent,
+                                           implementation::toString(static_cast<LatencyClass>(i)),
+                                           record.framesDelivered, record.getAvgLatencyUs(),
+                                           record.peakLatencyUs);
+        }
+        buffer += "\n";
 
         return buffer;
     }
@@ -134,6 +181,10 @@ public:
     void framesReturned(const std::vector<aidlevs::BufferDesc>& bufs) EXCLUDES(mMutex);
     void framesIgnored(int32_t n = 1) EXCLUDES(mMutex);
     void framesSkippedToSync(int32_t n = 1) EXCLUDES(mMutex);
+    void framesSkippedOverBudget(int32_t n = 1) EXCLUDES(mMutex);
+    // Records a frame delivered to a client in |latencyClass| |latencyUs| microseconds after the
+    // frame arrival
+    void framesDelivered(LatencyClass latencyClass, int64_t latencyUs) EXCLUDES(mMutex);
     void eventsReceived() EXCLUDES(mMutex);
     int64_t getTimeCreated() const EXCLUDES(mMutex);
     int64_t getFramesReceived() const EXCLUDES(mMutex);
@@ -105,6 +105,27 @@ void CameraUsageStats::framesSkippedToSync(int32_t n) {
     mStats.framesSkippedToSync += n;
 }
 
+void CameraUsageStats::framesSkippedOverBudget(int32_t n) {
+    AutoMutex lock(mMutex);
+    mStats.framesSkippedOverBudget += n;
+}
+
+void CameraUsageStats::framesDelivered(LatencyClass latencyClass, int64_t latencyUs) {
+    const auto index = static_cast<size_t>(latencyClass);
+    AutoMutex lock(mMutex);
+    if (index >= mStats.deliveryLatencies.size()) {
+        LOG(WARNING) << "Latency class " << index << " is unknown.";
+        return;
+    }
+
+    auto& record = mStats.deliveryLatencies[index];
+    ++record.framesDelivered;
+    record.sumLatencyUs += latencyUs;
+    if (latencyUs > record.peakLatencyUs) {
+        record.peakLatencyUs = latencyUs;
+    }
+}
+
 void CameraUsageStats::eventsReceived() {
     AutoMutex lock(mMutex);
     ++mStats.erroneousEventsCount;
@@ -0,0 +1,79 @@
+/*
+ * Copyright 2024 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "Constants.h"
+#include "stats/include/CameraUsageStats.h"
+
+#include <gtest/gtest.h>
+
+namespace aidl::android::automotive::evs::implementation {
+
+namespace {
+
+const DeliveryLatencyRecord& getDeliveryLatency(const CameraUsageStatsRecord& record,
+                                                LatencyClass latencyClass) {
+    return record.deliveryLatencies[static_cast<size_t>(latencyClass)];
+}
+
+}  // namespace
+
+TEST(CameraUsageStatsUnitTest, RecordsDeliveryLatencyPerLatencyClass) {
+    ::android::sp<CameraUsageStats> stats = new CameraUsageStats(/* id= */ 0);
+
+    stats->framesDelivered(LatencyClass::SAFETY_CRITICAL, 100);
+    stats->framesDelivered(LatencyClass::SAFETY_CRITICAL, 300);
+    stats->framesDelivered(LatencyClass::BACKGROUND, 5000);
+    stats->framesSkippedOverBudget(2);
+
+    const auto record = stats->snapshot();
+    const auto& safetyCritical = getDeliveryLatency(record, LatencyClass::SAFETY_CRITICAL);
+    EXPECT_EQ(safetyCritical.framesDelivered, 2);
+    EXPECT_EQ(safetyCritical.peakLatencyUs, 300);
+    EXPECT_DOUBLE_EQ(safetyCritical.getAvgLatencyUs(), 200);
+
+    const auto& interactive = getDeliveryLatency(record, LatencyClass::INTERACTIVE);
+    EXPECT_EQ(interactive.framesDelivered, 0);
+    EXPECT_DOUBLE_EQ(interactive.getAvgLatencyUs(), 0);
+
+    const auto& background = getDeliveryLatency(record, LatencyClass::BACKGROUND);
+    EXPECT_EQ(background.framesDelivered, 1);
+    EXPECT_EQ(background.peakLatencyUs, 5000);
+    EXPECT_EQ(record.framesSkippedOverBudget, 2);
+
+    const auto dump = record.toString();
+    EXPECT_NE(dump.find("Delivery Latency (SAFETY_CRITICAL): 2 frames"), std::string::npos)
+            << dump;
+    EXPECT_NE(dump.find("Frames Skipped Over Budget: 2"), std::string::npos) << dump;
+}
+
+TEST(CameraUsageStatsUnitTest, CalculatesDeliveryLatencyDelta) {
+    ::android::sp<CameraUsageStats> stats = new CameraUsageStats(/* id= */ 0);
+
+    stats->framesDelivered(LatencyClass::INTERACTIVE, 1000);
+    const auto previous = stats->snapshot();
+    stats->framesDelivered(LatencyClass::INTERACTIVE, 2000);
+    stats->framesDelivered(LatencyClass::INTERACTIVE, 4000);
+    stats->framesSkippedOverBudget();
+
+    const auto delta = stats->snapshot() - previous;
+    const auto& interactive = getDeliveryLatency(delta, LatencyClass::INTERACTIVE);
+    EXPECT_EQ(interactive.framesDelivered, 2);
+    EXPECT_DOUBLE_EQ(interactive.getAvgLatencyUs(), 3000);
+    EXPECT_EQ(interactive.peakLatencyUs, 4000);
+    EXPECT_EQ(delta.framesSkippedOverBudget, 1);
+}
+
+}  // namespace aidl::android::automotive::evs::implementation
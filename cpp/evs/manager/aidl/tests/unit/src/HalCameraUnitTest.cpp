@@ -0,0 +1,146 @@
+/*
+ * Copyright 2024 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "Constants.h"
+#include "HalCamera.h"
+#include "MockEvsCamera.h"
+#include "VirtualCamera.h"
+
+#include <gmock/gmock.h>
+#include <gtest/gtest.h>
+
+#include <chrono>
+#include <thread>
+#include <vector>
+
+namespace aidl::android::automotive::evs::implementation {
+
+namespace {
+
+using ::aidl::android::hardware::automotive::evs::BufferDesc;
+using ::ndk::ScopedAStatus;
+using ::testing::ElementsAre;
+
+// Longer than the frame delivery budget of HalCamera
+constexpr std::chrono::milliseconds kSlowDeliveryTime(10);
+
+// Frame interval long enough not to be skipped to sync the clients
+constexpr int64_t kFrameIntervalUs = 33'000;
+
+// Records the order of the frame deliveries instead of forwarding frames to a client stream.
+class FakeVirtualCamera final : public VirtualCamera {
+public:
+    FakeVirtualCamera(const std::shared_ptr<HalCamera>& halCamera, LatencyClass latencyClass,
+                      std::vector<LatencyClass>* deliveries,
+                      std::chrono::milliseconds deliveryTime = std::chrono::milliseconds(0)) :
+          VirtualCamera({halCamera}, latencyClass),
+          mDeliveries(deliveries),
+          mDeliveryTime(deliveryTime) {}
+
+    bool deliverFrame([[maybe_unused]] const BufferDesc& bufDesc) override {
+        std::this_thread::sleep_for(mDeliveryTime);
+        mDeliveries->push_back(getLatencyClass());
+        return true;
+    }
+
+private:
+    std::vector<LatencyClass>* mDeliveries;
+    std::chrono::milliseconds mDeliveryTime;
+};
+
+std::vector<BufferDesc> makeFrame(int32_t bufferId, int64_t timestamp) {
+    std::vector<BufferDesc> buffers(1);
+    buffers[0].bufferId = bufferId;
+    buffers[0].timestamp = timestamp;
+    return buffers;
+}
+
+}  // namespace
+
+class HalCameraUnitTest : public ::testing::Test {
+protected:
+    void SetUp() override {
+        mMockHwCamera = ::ndk::SharedRefBase::make<NiceMockEvsCamera>("/dev/video0");
+        ON_CALL(*mMockHwCamera, setMaxFramesInFlight)
+                .WillByDefault([]([[maybe_unused]] int32_t bufferCount) {
+                    return ScopedAStatus::ok();
+                });
+        mHalCamera = ::ndk::SharedRefBase::make<HalCamera>(mMockHwCamera, "/dev/video0");
+    }
+
+    std::shared_ptr<VirtualCamera> makeClient(
+            LatencyClass latencyClass,
+            std::chrono::milliseconds deliveryTime = std::chrono::milliseconds(0)) {
+        auto client = ::ndk::SharedRefBase::make<FakeVirtualCamera>(mHalCamera, latencyClass,
+                                                                    &mDeliveries, deliveryTime);
+        EXPECT_TRUE(mHalCamera->ownVirtualCamera(client));
+        return client;
+    }
+
+    std::shared_ptr<NiceMockEvsCamera> mMockHwCamera;
+    std::shared_ptr<HalCamera> mHalCamera;
+    std::vector<LatencyClass> mDeliveries;
+};
+
+TEST_F(HalCameraUnitTest, DeliversFramesInLatencyClassOrder) {
+    auto background = makeClient(LatencyClass::BACKGROUND);
+    auto interactive = makeClient(LatencyClass::INTERACTIVE);
+    auto safetyCritical = makeClient(LatencyClass::SAFETY_CRITICAL);
+
+    // Requests are made in the reverse order of the latency classes.
+    mHalCamera->requestNewFrame(background, /* lastTimestamp= */ 0);
+    mHalCamera->requestNewFrame(interactive, /* lastTimestamp= */ 0);
+    mHalCamera->requestNewFrame(safetyCritical, /* lastTimestamp= */ 0);
+
+    ASSERT_TRUE(mHalCamera->deliverFrame(makeFrame(/* bufferId= */ 0, kFrameIntervalUs)).isOk());
+
+    EXPECT_THAT(mDeliveries,
+                ElementsAre(LatencyClass::SAFETY_CRITICAL, LatencyClass::INTERACTIVE,
+                            LatencyClass::BACKGROUND));
+    EXPECT_EQ(mHalCamera->getStats().framesSkippedOverBudget, 0);
+}
+
+TEST_F(HalCameraUnitTest, SkipsBackgroundClientsOverBudgetWithoutStarvingThem) {
+    auto background = makeClient(LatencyClass::BACKGROUND);
+    auto interactive = makeClient(LatencyClass::INTERACTIVE, kSlowDeliveryTime);
+
+    mHalCamera->requestNewFrame(background, /* lastTimestamp= */ 0);
+    int64_t timestamp = 0;
+    std::vector<std::vector<LatencyClass>> deliveriesPerFrame;
+    for (int32_t i = 0; i < 3; ++i) {
+        // The interactive client uses up the budget on every frame.
+        mHalCamera->requestNewFrame(interactive, timestamp);
+        timestamp += kFrameIntervalUs;
+        mDeliveries.clear();
+        ASSERT_TRUE(mHalCamera->deliverFrame(makeFrame(i, timestamp)).isOk());
+        deliveriesPerFrame.push_back(mDeliveries);
+    }
+
+    // The background client keeps its request while skipping the frames over the budget and
+    // receives the third frame regardless of the budget.
+    EXPECT_THAT(deliveriesPerFrame,
+                ElementsAre(ElementsAre(LatencyClass::INTERACTIVE),
+                            ElementsAre(LatencyClass::INTERACTIVE),
+                            ElementsAre(LatencyClass::INTERACTIVE, LatencyClass::BACKGROUND)));
+
+    const auto stats = mHalCamera->getStats();
+    EXPECT_EQ(stats.framesSkippedOverBudget, 2);
+    EXPECT_EQ(stats.deliveryLatencies[static_cast<size_t>(LatencyClass::BACKGROUND)]
+                      .framesDelivered,
+              1);
+}
+
+}  // namespace aidl::android::automotive::evs::implementation
@@ -0,0 +1,129 @@
+/*
+ * Copyright (C) 2024 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef CPP_EVS_SAMPLEDRIVER_AIDL_INCLUDE_BUFFERINDEXPOOL_H
+#define CPP_EVS_SAMPLEDRIVER_AIDL_INCLUDE_BUFFERINDEXPOOL_H
+
+#include <array>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+
+namespace aidl::android::hardware::automotive::evs::implementation {
+
+/*
+ * Tracks which of a fixed number of buffer slots are available to be filled and which are held by
+ * a client, without a lock.
+ *
+ * Each slot is in one of three states: empty (not published), available, or in use. The capture
+ * thread claims an available slot with acquire(), client threads return it with release(), and
+ * the control path publishes newly allocated slots with markAvailable() and takes idle slots out
+ * of circulation with tryRetire(). All transitions are single atomic read-modify-write operations
+ * on per-word bitmaps so the capture thread never waits on a client thread.
+ */
+template <size_t kCapacity>
+class BufferIndexPool final {
+public:
+    static constexpr size_t kBitsPerWord = 64;
+    static constexpr size_t kNumWords = (kCapacity + kBitsPerWord - 1) / kBitsPerWord;
+
+    BufferIndexPool() {
+        for (size_t i = 0; i < kNumWords; ++i) {
+            mAvailable[i].store(0, std::memory_order_relaxed);
+            mInUse[i].store(0, std::memory_order_relaxed);
+        }
+    }
+
+    BufferIndexPool(const BufferIndexPool&) = delete;
+    BufferIndexPool& operator=(const BufferIndexPool&) = delete;
+
+    static constexpr size_t capacity() { return kCapacity; }
+
+    // Claims the lowest available slot and marks it in use. Returns -1 when no slot is available.
+    int acquire() {
+        for (size_t w = 0; w < kNumWords; ++w) {
+            uint64_t bits = mAvailable[w].load(std::memory_order_acquire);
+            while (bits != 0) {
+                const uint64_t mask = bits & (~bits + 1);
+                if (mAvailable[w].compare_exchange_weak(bits, bits & ~mask,
+                                                        std::memory_order_acq_rel,
+                                                        std::memory_order_acquire)) {
+                    mInUse[w].fetch_or(mask, std::memory_order_release);
+                    mNumInUse.fetch_add(1, std::memory_order_relaxed);
+                    return static_cast<int>(w * kBitsPerWord + __builtin_ctzll(mask));
+                }
+            }
+        }
+        return -1;
+    }
+
+    // Clears the in-use mark of a slot. Returns false if the slot was not in use, e.g. when a
+    // client returns the same buffer twice. The slot is not made available again; the caller
+    // either calls markAvailable() or releases the underlying buffer.
+    bool release(size_t idx) {
+        if (idx >= kCapacity) {
+            return false;
+        }
+        const uint64_t mask = maskOf(idx);
+        const uint64_t prev = mInUse[wordOf(idx)].fetch_and(~mask, std::memory_order_acq_rel);
+        if ((prev & mask) == 0) {
+            return false;
+        }
+        mNumInUse.fetch_sub(1, std::memory_order_relaxed);
+        return true;
+    }
+
+    // Publishes a slot to the capture thread. Any writes to the slot's record made before this
+    // call are visible to the thread that subsequently acquires it.
+    void markAvailable(size_t idx) {
+        if (idx >= kCapacity) {
+            return;
+        }
+        mAvailable[wordOf(idx)].fetch_or(maskOf(idx), std::memory_order_release);
+    }
+
+    // Takes an available slot out of circulation. Returns false if the slot is not currently
+    // available, which includes slots held by a client.
+    bool tryRetire(size_t idx) {
+        if (idx >= kCapacity) {
+            return false;
+        }
+        const uint64_t mask = maskOf(idx);
+        const uint64_t prev = mAvailable[wordOf(idx)].fetch_and(~mask, std::memory_order_acq_rel);
+        return (prev & mask) != 0;
+    }
+
+    bool isInUse(size_t idx) const {
+        if (idx >= kCapacity) {
+            return false;
+        }
+        return (mInUse[wordOf(idx)].load(std::memory_order_acquire) & maskOf(idx)) != 0;
+    }
+
+    unsigned numInUse() const { return mNumInUse.load(std::memory_order_relaxed); }
+
+private:
+    static constexpr size_t wordOf(size_t idx) { return idx / kBitsPerWord; }
+    static constexpr uint64_t maskOf(size_t idx) { return uint64_t{1} << (idx % kBitsPerWord); }
+
+    std::array<std::atomic<uint64_t>, kNumWords> mAvailable;
+    std::array<std::atomic<uint64_t>, kNumWords> mInUse;
+    std::atomic<unsigned> mNumInUse = 0;
+};
+
+}  // namespace aidl::android::hardware::automotive::evs::implementation
+
+#endif  // CPP_EVS_SAMPLEDRIVER_AIDL_INCLUDE_BUFFERINDEXPOOL_H
@@ -0,0 +1,47 @@
+/*
+ * Copyright (C) 2024 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef CPP_EVS_SAMPLEDRIVER_AIDL_INCLUDE_CAPTUREFORMAT_H
+#define CPP_EVS_SAMPLEDRIVER_AIDL_INCLUDE_CAPTUREFORMAT_H
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace aidl::android::hardware::automotive::evs::implementation {
+
+/*
+ * Returns the V4L2 capture formats that can fill a graphics buffer of |halFormat|, a value from
+ * android_pixel_format_t, ordered from the cheapest: a pass-through copy first and then the
+ * conversions from the cheapest to the most expensive.
+ */
+std::vector<uint32_t> getCaptureFormatsFor(uint32_t halFormat);
+
+/*
+ * Returns the cheapest capture format in |deviceFormats| that can fill a graphics buffer of
+ * |halFormat|, or 0 if the device supports none of them.
+ */
+uint32_t negotiateCaptureFormat(uint32_t halFormat, const std::vector<uint32_t>& deviceFormats);
+
+// Returns true if frames of |v4l2Format| are copied into |halFormat| buffers as they are.
+bool isPassThrough(uint32_t halFormat, uint32_t v4l2Format);
+
+// Returns the four character code of a V4L2 pixel format, e.g. "YUYV".
+std::string fourccToString(uint32_t v4l2Format);
+
+}  // namespace aidl::android::hardware::automotive::evs::implementation
+
+#endif  // CPP_EVS_SAMPLEDRIVER_AIDL_INCLUDE_CAPTUREFORMAT_H
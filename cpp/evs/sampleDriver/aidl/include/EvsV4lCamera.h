@@ -17,6 +17,7 @@
 #ifndef CPP_EVS_SAMPLEDRIVER_AIDL_INCLUDE_EVSV4LCAMERA_H
 #define CPP_EVS_SAMPLEDRIVER_AIDL_INCLUDE_EVSV4LCAMERA_H
 
+#include "BufferIndexPool.h"
 #include "ConfigManager.h"
 #include "VideoCapture.h"
 
@@ -33,6 +34,8 @@
 #include <android/hardware_buffer.h>
 #include <ui/GraphicBuffer.h>
 
+#include <array>
+#include <atomic>
 #include <functional>
 #include <thread>
 
@@ -87,15 +90,25 @@ public:
     ::android::base::Result<void> startDumpFrames(const std::string& path);
     ::android::base::Result<void> stopDumpFrames();
 
+    // Describes the capture format and how frames are moved into the output buffers
+    std::string toString(const char* indent = "") const;
+
     // Constructors
     EvsV4lCamera(const char* deviceName, std::unique_ptr<ConfigManager::CameraInfo>& camInfo);
 
 private:
+    // Arbitrary limit on number of graphics buffers allowed to be allocated
+    // Safeguards against unreasonable resource consumption and provides a testable limit
+    static constexpr unsigned kMaxBuffersInFlight = 100;
+
     // These three functions are expected to be called while mAccessLock is held
     bool setAvailableFrames_Locked(unsigned bufferCount);
     unsigned increaseAvailableFrames_Locked(unsigned numToAdd);
     unsigned decreaseAvailableFrames_Locked(unsigned numToRemove);
 
+    // Configures the capture with the cheapest V4L2 format that can fill mFormat buffers
+    bool setCaptureFormat(int32_t width, int32_t height);
+
     void forwardFrame(imageBuffer* tgt, void* data);
     inline bool convertToV4l2CID(aidlevs::CameraParam id, uint32_t& v4l2cid);
 
@@ -113,18 +126,20 @@ private:
     uint32_t mStride = 0;  // Pixels per row (may be greater than image width)
 
     struct BufferRecord {
-        buffer_handle_t handle;
-        bool inUse;
-
-        explicit BufferRecord(buffer_handle_t h) : handle(h), inUse(false) {};
+        buffer_handle_t handle = nullptr;
     };
 
-    // Graphics buffers to transfer images
-    std::vector<BufferRecord> mBuffers;
+    // Graphics buffers to transfer images. This is sized up front so the capture thread can index
+    // into it without holding mAccessLock; a slot's handle is only written by the control path
+    // while the slot is out of circulation in mBufferPool.
+    std::array<BufferRecord, kMaxBuffersInFlight> mBuffers;
+    // Tracks which slots of mBuffers are free to fill and which are held by the client
+    BufferIndexPool<kMaxBuffersInFlight> mBufferPool;
     // How many buffers are we currently using
     unsigned mFramesAllowed;
-    // How many buffers are currently outstanding
-    unsigned mFramesInUse;
+    // How many buffers to release as soon as the client returns them, because a shrink request
+    // arrived while they were outstanding
+    std::atomic<unsigned> mFramesToRelease = 0;
 
     std::set<uint32_t> mCameraControls;  // Available camera controls
 
@@ -135,7 +150,12 @@ private:
     aidlevs::EvsResult doneWithFrame_impl(const aidlevs::BufferDesc& bufferDesc);
     aidlevs::EvsResult doneWithFrame_impl(uint32_t id, buffer_handle_t handle);
 
-    // Synchronization necessary to deconflict the capture thread from the main service thread
+    // Puts a buffer returned by the client back into circulation, or frees it and any idle
+    // buffers if a shrink is pending
+    void returnBuffer(unsigned idx);
+
+    // Synchronization necessary to deconflict the control calls from binder threads.  The capture
+    // thread does not take this lock; it claims buffers through mBufferPool instead.
     // Note that the service interface remains single threaded (ie: not reentrant)
     mutable std::mutex mAccessLock;
 
@@ -22,22 +22,37 @@
 #include <functional>
 #include <set>
 #include <thread>
+#include <vector>
 
 typedef v4l2_buffer imageBuffer;
 
 class VideoCapture final {
 public:
-    bool open(const char* deviceName, const int32_t width = 0, const int32_t height = 0);
+    // Opens a capture device and lists the capture formats it supports
+    bool open(const char* deviceName);
     void close();
 
+    // Sets the capture resolution and V4L2 pixel format.  The device may adjust them; see the
+    // getters below for the effective values.
+    bool setFormat(const int32_t width, const int32_t height, const uint32_t pixelFormat);
+
     bool startStream(std::function<void(VideoCapture*, imageBuffer*, void*)> callback = nullptr);
     void stopStream();
 
     // Valid only after open()
-    __u32 getWidth() { return mWidth; };
-    __u32 getHeight() { return mHeight; };
-    __u32 getStride() { return mStride; };
-    __u32 getV4LFormat() { return mFormat; };
+    const std::vector<uint32_t>& getSupportedFormats() const { return mSupportedFormats; }
+    bool isMultiPlanar() const { return mBufType == V4L2_BUF_TYPE_VIDEO_CAPTURE_MPLANE; }
+
+    // Valid only after setFormat()
+    __u32 getWidth() const { return mWidth; };
+    __u32 getHeight() const { return mHeight; };
+    __u32 getStride() const { return mStride; };
+    __u32 getV4LFormat() const { return mFormat; };
+
+    // Size of a capture buffer in bytes
+    __u32 getLength(const imageBuffer& buf) const {
+        return isMultiPlanar() ? buf.m.planes[0].length : buf.length;
+    }
 
     // NULL until stream is started
     void* getLatestData() {
@@ -66,8 +81,15 @@ private:
 
     int mDeviceFd = -1;
 
+    // V4L2_BUF_TYPE_VIDEO_CAPTURE, or V4L2_BUF_TYPE_VIDEO_CAPTURE_MPLANE if the device only
+    // supports the multi-planar API
+    __u32 mBufType = V4L2_BUF_TYPE_VIDEO_CAPTURE;
+    std::vector<uint32_t> mSupportedFormats;
+
     int mNumBuffers = 0;
     std::unique_ptr<v4l2_buffer[]> mBufferInfos = nullptr;
+    // Plane of each buffer in the multi-planar API; only a single memory plane is supported
+    std::unique_ptr<v4l2_plane[]> mPlanes = nullptr;
     std::unique_ptr<void*[]> mPixelBuffers = nullptr;
 
     __u32 mFormat = 0;
@@ -25,9 +25,15 @@ namespace aidl::android::hardware::automotive::evs::implementation {
 void fillNV21FromNV21(const ::aidl::android::hardware::automotive::evs::BufferDesc& tgtBuff,
                       uint8_t* tgt, void* imgData, unsigned imgStride);
 
+void fillNV21FromNV12(const ::aidl::android::hardware::automotive::evs::BufferDesc& tgtBuff,
+                      uint8_t* tgt, void* imgData, unsigned imgStride);
+
 void fillNV21FromYUYV(const ::aidl::android::hardware::automotive::evs::BufferDesc& tgtBuff,
                       uint8_t* tgt, void* imgData, unsigned imgStride);
 
+void fillRGBAFromRGBA(const ::aidl::android::hardware::automotive::evs::BufferDesc& tgtBuff,
+                      uint8_t* tgt, void* imgData, unsigned imgStride);
+
 void fillRGBAFromYUYV(const ::aidl::android::hardware::automotive::evs::BufferDesc& tgtBuff,
                       uint8_t* tgt, void* imgData, unsigned imgStride);
 
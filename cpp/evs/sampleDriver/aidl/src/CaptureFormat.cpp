@@ -0,0 +1,85 @@
+/*
+ * Copyright (C) 2024 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "CaptureFormat.h"
+
+#include <linux/videodev2.h>
+#include <system/graphics.h>
+
+#include <algorithm>
+
+namespace {
+
+struct CapturePath {
+    uint32_t halFormat;   // Values from android_pixel_format_t
+    uint32_t v4l2Format;  // Values from videodev2.h
+    bool passThrough;
+};
+
+// The capture formats EvsV4lCamera can convert into each output buffer format, ordered by the
+// conversion cost.
+constexpr CapturePath kCapturePaths[] = {
+        // NV21: a copy, a chroma swap, and a 4:2:2 to 4:2:0 down sampling
+        {HAL_PIXEL_FORMAT_YCRCB_420_SP, V4L2_PIX_FMT_NV21, true},
+        {HAL_PIXEL_FORMAT_YCRCB_420_SP, V4L2_PIX_FMT_NV12, false},
+        {HAL_PIXEL_FORMAT_YCRCB_420_SP, V4L2_PIX_FMT_YUYV, false},
+        // RGBA: a copy and a color space conversion
+        {HAL_PIXEL_FORMAT_RGBA_8888, V4L2_PIX_FMT_RGBA32, true},
+        {HAL_PIXEL_FORMAT_RGBA_8888, V4L2_PIX_FMT_YUYV, false},
+        // YUYV: a copy and a byte swizzle
+        {HAL_PIXEL_FORMAT_YCBCR_422_I, V4L2_PIX_FMT_YUYV, true},
+        {HAL_PIXEL_FORMAT_YCBCR_422_I, V4L2_PIX_FMT_UYVY, false},
+};
+
+}  // namespace
+
+namespace aidl::android::hardware::automotive::evs::implementation {
+
+std::vector<uint32_t> getCaptureFormatsFor(uint32_t halFormat) {
+    std::vector<uint32_t> formats;
+    for (const auto& path : kCapturePaths) {
+        if (path.halFormat == halFormat) {
+            formats.push_back(path.v4l2Format);
+        }
+    }
+    return formats;
+}
+
+uint32_t negotiateCaptureFormat(uint32_t halFormat, const std::vector<uint32_t>& deviceFormats) {
+    for (const auto& format : getCaptureFormatsFor(halFormat)) {
+        if (std::find(deviceFormats.begin(), deviceFormats.end(), format) != deviceFormats.end()) {
+            return format;
+        }
+    }
+    return 0;
+}
+
+bool isPassThrough(uint32_t halFormat, uint32_t v4l2Format) {
+    return std::any_of(std::begin(kCapturePaths), std::end(kCapturePaths),
+                       [halFormat, v4l2Format](const auto& path) {
+                           return path.halFormat == halFormat && path.v4l2Format == v4l2Format &&
+                                   path.passThrough;
+                       });
+}
+
+std::string fourccToString(uint32_t v4l2Format) {
+    return std::string({static_cast<char>(v4l2Format & 0xFF),
+                        static_cast<char>((v4l2Format >> 8) & 0xFF),
+                        static_cast<char>((v4l2Format >> 16) & 0xFF),
+                        static_cast<char>((v4l2Format >> 24) & 0xFF)});
+}
+
+}  // namespace aidl::android::hardware::automotive::evs::implementation
@@ -786,13 +786,15 @@ binder_status_t EvsEnumerator::parseCommand(int fd, const std::vector<std::strin
 
 void EvsEnumerator::cmdHelp(int fd) {
     WriteStringToFd("--help: shows this help.\n"
+                    "--dump [id]\n"
+                    "\tShow the capture format of an active camera\n"
                     "--dump [id] [start|stop] [directory]\n"
                     "\tDump camera frames to a target directory\n",
                     fd);
 }
 
 binder_status_t EvsEnumerator::cmdDump(int fd, const std::vector<std::string>& options) {
-    if (options.size() < 3) {
+    if (options.size() < 2) {
         WriteStringToFd("Necessary argument is missing\n", fd);
         cmdHelp(fd);
         return STATUS_BAD_VALUE;
@@ -810,6 +812,13 @@ binder_status_t EvsEnumerator::cmdDump(int fd, const std::vector<std::string>& o
         return STATUS_DEAD_OBJECT;
     }
 
+    if (options.size() < 3) {
+        // --dump [device id]
+        WriteStringToFd(StringPrintf("%s\n%s", options[1].data(), device->toString("\t").data()),
+                        fd);
+        return STATUS_OK;
+    }
+
     const std::string command = options[2];
     if (EqualsIgnoreCase(command, "start")) {
         // --dump [device id] start [path]
@@ -16,11 +16,13 @@
 
 #include "EvsV4lCamera.h"
 
+#include "CaptureFormat.h"
 #include "bufferCopy.h"
 
 #include <aidl/android/hardware/graphics/common/HardwareBufferDescription.h>
 #include <aidlcommonsupport/NativeHandle.h>
 #include <android-base/logging.h>
+#include <android-base/stringprintf.h>
 #include <android-base/unique_fd.h>
 #include <android/hardware_buffer.h>
 #include <ui/GraphicBufferAllocator.h>
@@ -36,22 +38,19 @@ using ::aidl::android::hardware::graphics::common::BufferUsage;
 using ::aidl::android::hardware::graphics::common::HardwareBufferDescription;
 using ::android::base::Error;
 using ::android::base::Result;
+using ::android::base::StringAppendF;
 using ::ndk::ScopedAStatus;
 
 // Default camera output image resolution
 constexpr std::array<int32_t, 2> kDefaultResolution = {640, 480};
 
-// Arbitrary limit on number of graphics buffers allowed to be allocated
-// Safeguards against unreasonable resource consumption and provides a testable limit
-constexpr unsigned kMaxBuffersInFlight = 100;
-
 }  // namespace
 
 namespace aidl::android::hardware::automotive::evs::implementation {
 
 EvsV4lCamera::EvsV4lCamera(const char* deviceName,
                            std::unique_ptr<ConfigManager::CameraInfo>& camInfo) :
-      mFramesAllowed(0), mFramesInUse(0), mCameraInfo(camInfo) {
+      mFramesAllowed(0), mCameraInfo(camInfo) {
     LOG(DEBUG) << "EvsV4lCamera instantiated";
 
     mDescription.id = deviceName;
@@ -87,17 +86,22 @@ void EvsV4lCamera::shutdown() {
     mVideo.close();
 
     // Drop all the graphics buffers we've been using
-    if (mBuffers.size() > 0) {
-        ::android::GraphicBufferAllocator& alloc(::android::GraphicBufferAllocator::get());
-        for (auto&& rec : mBuffers) {
-            if (rec.inUse) {
-                LOG(WARNING) << "Releasing buffer despite remote ownership";
-            }
-            alloc.free(rec.handle);
-            rec.handle = nullptr;
+    ::android::GraphicBufferAllocator& alloc(::android::GraphicBufferAllocator::get());
+    for (unsigned idx = 0; idx < mBuffers.size(); ++idx) {
+        auto& rec = mBuffers[idx];
+        if (rec.handle == nullptr) {
+            continue;
+        }
+        if (mBufferPool.release(idx)) {
+            LOG(WARNING) << "Releasing buffer despite remote ownership";
+        } else {
+            mBufferPool.tryRetire(idx);
         }
-        mBuffers.clear();
+        alloc.free(rec.handle);
+        rec.handle = nullptr;
     }
+    mFramesAllowed = 0;
+    mFramesToRelease = 0;
 }
 
 // Methods from ::aidl::android::hardware::automotive::evs::IEvsCamera follow.
@@ -171,6 +175,9 @@ ScopedAStatus EvsV4lCamera::startVideoStream(const std::shared_ptr<IEvsCameraStr
                 case V4L2_PIX_FMT_NV21:
                     mFillBufferFromVideo = fillNV21FromNV21;
                     break;
+                case V4L2_PIX_FMT_NV12:
+                    mFillBufferFromVideo = fillNV21FromNV12;
+                    break;
                 case V4L2_PIX_FMT_YUYV:
                     mFillBufferFromVideo = fillNV21FromYUYV;
                     break;
@@ -182,6 +189,9 @@ ScopedAStatus EvsV4lCamera::startVideoStream(const std::shared_ptr<IEvsCameraStr
             break;
         case HAL_PIXEL_FORMAT_RGBA_8888:
             switch (videoSrcFormat) {
+                case V4L2_PIX_FMT_RGBA32:
+                    mFillBufferFromVideo = fillRGBAFromRGBA;
+                    break;
                 case V4L2_PIX_FMT_YUYV:
                     mFillBufferFromVideo = fillRGBAFromYUYV;
                     break;
@@ -423,20 +433,20 @@ ScopedAStatus EvsV4lCamera::importExternalBuffers(const std::vector<BufferDesc>&
             }
 
             auto stored = false;
-            for (auto&& rec : mBuffers) {
-                if (rec.handle == nullptr) {
-                    // Use this existing entry
-                    rec.handle = memHandle;
-                    rec.inUse = false;
-
+            for (unsigned idx = 0; idx < mBuffers.size(); ++idx) {
+                if (mBuffers[idx].handle == nullptr) {
+                    // Use this empty entry and hand it to the capture thread
+                    mBuffers[idx].handle = memHandle;
+                    mBufferPool.markAvailable(idx);
                     stored = true;
                     break;
                 }
             }
 
             if (!stored) {
-                // Add a BufferRecord wrapping this handle to our set of available buffers
-                mBuffers.push_back(std::move(BufferRecord(memHandle)));
+                LOG(WARNING) << "No empty slot for an imported buffer " << b.bufferId;
+                mapper.freeBuffer(memHandle);
+                break;
             }
 
             ++mFramesAllowed;
@@ -453,44 +463,24 @@ EvsResult EvsV4lCamera::doneWithFrame_impl(const BufferDesc& bufferDesc) {
         return EvsResult::OK;
     }
 
-    if (static_cast<uint32_t>(bufferDesc.bufferId) >= mBuffers.size()) {
+    if (bufferDesc.bufferId < 0 || static_cast<uint32_t>(bufferDesc.bufferId) >= mBuffers.size()) {
         LOG(WARNING) << "Ignoring doneWithFrame called with invalid id " << bufferDesc.bufferId
                      << " (max is " << mBuffers.size() - 1 << ")";
         return EvsResult::OK;
     }
 
     // Mark this buffer as available
-    {
-        std::lock_guard<std::mutex> lock(mAccessLock);
-        mBuffers[bufferDesc.bufferId].inUse = false;
-        --mFramesInUse;
-
-        // If this frame's index is high in the array, try to move it down
-        // to improve locality after mFramesAllowed has been reduced.
-        if (static_cast<uint32_t>(bufferDesc.bufferId) >= mFramesAllowed) {
-            // Find an empty slot lower in the array (which should always exist in this case)
-            bool found = false;
-            for (auto&& rec : mBuffers) {
-                if (!rec.handle) {
-                    rec.handle = mBuffers[bufferDesc.bufferId].handle;
-                    mBuffers[bufferDesc.bufferId].handle = nullptr;
-                    found = true;
-                    break;
-                }
-            }
-
-            if (!found) {
-                LOG(WARNING) << "No empty slot!";
-            }
-        }
+    if (!mBufferPool.release(bufferDesc.bufferId)) {
+        LOG(WARNING) << "Ignoring doneWithFrame called on frame " << bufferDesc.bufferId
+                     << " which is already free";
+        return EvsResult::OK;
     }
 
+    returnBuffer(bufferDesc.bufferId);
     return EvsResult::OK;
 }
 
 EvsResult EvsV4lCamera::doneWithFrame_impl(uint32_t bufferId, buffer_handle_t handle) {
-    std::lock_guard<std::mutex> lock(mAccessLock);
-
     // If we've been displaced by another owner of the camera, then we can't do anything else
     if (!mVideo.isOpen()) {
         LOG(WARNING) << "Ignoring doneWithFrame call when camera has been lost.";
@@ -502,35 +492,37 @@ EvsResult EvsV4lCamera::doneWithFrame_impl(uint32_t bufferId, buffer_handle_t ha
     } else if (bufferId >= mBuffers.size()) {
         LOG(ERROR) << "Ignoring doneWithFrame called with invalid bufferId " << bufferId
                    << " (max is " << mBuffers.size() - 1 << ")";
-    } else if (!mBuffers[bufferId].inUse) {
+    } else if (!mBufferPool.release(bufferId)) {
         LOG(ERROR) << "Ignoring doneWithFrame called on frame " << bufferId
                    << " which is already free";
     } else {
         // Mark the frame as available
-        mBuffers[bufferId].inUse = false;
-        --mFramesInUse;
-
-        // If this frame's index is high in the array, try to move it down
-        // to improve locality after mFramesAllowed has been reduced.
-        if (bufferId >= mFramesAllowed) {
-            // Find an empty slot lower in the array (which should always exist in this case)
-            bool found = false;
-            for (auto&& rec : mBuffers) {
-                if (!rec.handle) {
-                    rec.handle = mBuffers[bufferId].handle;
-                    mBuffers[bufferId].handle = nullptr;
-                    found = true;
-                    break;
-                }
-            }
+        returnBuffer(bufferId);
+    }
 
-            if (!found) {
-                LOG(WARNING) << "No empty slot!";
+    return EvsResult::OK;
+}
+
+void EvsV4lCamera::returnBuffer(unsigned idx) {
+    if (mFramesToRelease.load() > 0) {
+        // A shrink request could not be completed while this buffer was outstanding; finish it
+        // now.  This is the only case where returning a buffer takes mAccessLock.
+        std::lock_guard<std::mutex> lock(mAccessLock);
+        if (mFramesToRelease > 0 && mBuffers[idx].handle != nullptr) {
+            ::android::GraphicBufferAllocator::get().free(mBuffers[idx].handle);
+            mBuffers[idx].handle = nullptr;
+            --mFramesToRelease;
+            --mFramesAllowed;
+            // Frames the capture thread failed to deliver went straight back to the pool so that
+            // thread never waits on this lock; reclaim any of them that are still idle here.
+            if (mFramesToRelease > 0) {
+                mFramesToRelease -= decreaseAvailableFrames_Locked(mFramesToRelease);
             }
+            return;
         }
     }
 
-    return EvsResult::OK;
+    mBufferPool.markAvailable(idx);
 }
 
 bool EvsV4lCamera::setAvailableFrames_Locked(unsigned bufferCount) {
@@ -543,6 +535,9 @@ bool EvsV4lCamera::setAvailableFrames_Locked(unsigned bufferCount) {
         return false;
     }
 
+    // A new request supersedes any shrink that is still waiting for outstanding buffers
+    mFramesToRelease = 0;
+
     // Is an increase required?
     if (mFramesAllowed < bufferCount) {
         // An increase is required
@@ -565,8 +560,10 @@ bool EvsV4lCamera::setAvailableFrames_Locked(unsigned bufferCount) {
         if (released != framesToRelease) {
             // This shouldn't happen with a properly behaving client because the client
             // should only make this call after returning sufficient outstanding buffers
-            // to allow a clean resize.
-            LOG(ERROR) << "Buffer queue shrink failed -- too many buffers currently in use?";
+            // to allow a clean resize.  Release the rest as they come back.
+            LOG(WARNING) << "Buffer queue shrink deferred -- " << framesToRelease - released
+                         << " buffers are currently in use";
+            mFramesToRelease = framesToRelease - released;
         }
     }
 
@@ -603,18 +600,19 @@ unsigned EvsV4lCamera::increaseAvailableFrames_Locked(unsigned numToAdd) {
 
         // Find a place to store the new buffer
         auto stored = false;
-        for (auto&& rec : mBuffers) {
-            if (rec.handle == nullptr) {
-                // Use this existing entry
-                rec.handle = memHandle;
-                rec.inUse = false;
+        for (unsigned idx = 0; idx < mBuffers.size(); ++idx) {
+            if (mBuffers[idx].handle == nullptr) {
+                // Use this empty entry and hand it to the capture thread
+                mBuffers[idx].handle = memHandle;
+                mBufferPool.markAvailable(idx);
                 stored = true;
                 break;
             }
         }
         if (!stored) {
-            // Add a BufferRecord wrapping this handle to our set of available buffers
-            mBuffers.push_back(std::move(BufferRecord(memHandle)));
+            LOG(ERROR) << "No empty slot for a new buffer";
+            alloc.free(memHandle);
+            break;
         }
 
         ++mFramesAllowed;
@@ -629,9 +627,11 @@ unsigned EvsV4lCamera::decreaseAvailableFrames_Locked(unsigned numToRemove) {
     ::android::GraphicBufferAllocator& alloc(::android::GraphicBufferAllocator::get());
 
     unsigned removed = 0;
-    for (auto&& rec : mBuffers) {
-        // Is this record not in use, but holding a buffer that we can free?
-        if ((rec.inUse == false) && (rec.handle != nullptr)) {
+    for (unsigned idx = 0; idx < mBuffers.size(); ++idx) {
+        auto& rec = mBuffers[idx];
+        // Is this record not in use, but holding a buffer that we can free?  Retiring it from the
+        // pool first guarantees the capture thread cannot claim it while we free it.
+        if (rec.handle != nullptr && mBufferPool.tryRetire(idx)) {
             // Release buffer and update the record so we can recognize it as "empty"
             alloc.free(rec.handle);
             rec.handle = nullptr;
@@ -651,37 +651,14 @@ unsigned EvsV4lCamera::decreaseAvailableFrames_Locked(unsigned numToRemove) {
 // This is the async callback from the video camera that tells us a frame is ready
 void EvsV4lCamera::forwardFrame(imageBuffer* pV4lBuff, void* pData) {
     LOG(DEBUG) << __FUNCTION__;
-    bool readyForFrame = false;
-    unsigned idx = 0;
 
-    // Lock scope for updating shared state
-    {
-        std::lock_guard<std::mutex> lock(mAccessLock);
-
-        // Are we allowed to issue another buffer?
-        if (mFramesInUse >= mFramesAllowed) {
-            // Can't do anything right now -- skip this frame
-            LOG(WARNING) << "Skipped a frame because too many are in flight";
-        } else {
-            // Identify an available buffer to fill
-            for (idx = 0; idx < mBuffers.size(); idx++) {
-                if (!mBuffers[idx].inUse) {
-                    if (mBuffers[idx].handle != nullptr) {
-                        // Found an available record, so stop looking
-                        break;
-                    }
-                }
-            }
-            if (idx >= mBuffers.size()) {
-                // This shouldn't happen since we already checked mFramesInUse vs mFramesAllowed
-                LOG(ERROR) << "Failed to find an available buffer slot";
-            } else {
-                // We're going to make the frame busy
-                mBuffers[idx].inUse = true;
-                mFramesInUse++;
-                readyForFrame = true;
-            }
-        }
+    // Claim an available buffer to fill.  This does not take mAccessLock so a frame is never held
+    // up by the client returning buffers or changing parameters.
+    const int idx = mBufferPool.acquire();
+    const bool readyForFrame = idx >= 0;
+    if (!readyForFrame) {
+        // Can't do anything right now -- skip this frame
+        LOG(WARNING) << "Skipped a frame because too many are in flight";
     }
 
     if (mDumpFrame) {
@@ -702,7 +679,7 @@ void EvsV4lCamera::forwardFrame(imageBuffer* pV4lBuff, void* pData) {
             len += write(fd.get(), &height, sizeof(height));
             len += write(fd.get(), &mStride, sizeof(mStride));
             len += write(fd.get(), &mFormat, sizeof(mFormat));
-            len += write(fd.get(), pData, pV4lBuff->length);
+            len += write(fd.get(), pData, mVideo.getLength(*pV4lBuff));
             LOG(INFO) << len << " bytes are written to " << filename;
         }
     }
@@ -785,10 +762,11 @@ void EvsV4lCamera::forwardFrame(imageBuffer* pV4lBuff, void* pData) {
             // until cleaned up on the main thread.
             LOG(ERROR) << "Frame delivery call failed in the transport layer.";
 
-            // Since we didn't actually deliver it, mark the frame as available
-            std::lock_guard<std::mutex> lock(mAccessLock);
-            mBuffers[idx].inUse = false;
-            --mFramesInUse;
+            // Since we didn't actually deliver it, mark the frame as available.  This must not
+            // take mAccessLock, so a deferred shrink reclaims it on the next doneWithFrame call.
+            if (mBufferPool.release(idx)) {
+                mBufferPool.markAvailable(idx);
+            }
         }
     }
 
@@ -852,6 +830,11 @@ std::shared_ptr<EvsV4lCamera> EvsV4lCamera::Create(
     }
 
     // Initialize the video device
+    if (!evsCamera->mVideo.open(deviceName)) {
+        LOG(ERROR) << "Failed to open a video device";
+        return nullptr;
+    }
+
     bool success = false;
     if (camInfo != nullptr && requestedStreamCfg != nullptr) {
         LOG(INFO) << "Requested stream configuration:";
@@ -885,14 +868,13 @@ std::shared_ptr<EvsV4lCamera> EvsV4lCamera::Create(
             LOG(INFO) << "  height = " << camInfo->streamConfigurations[streamId].height;
             LOG(INFO) << "  format = "
                       << static_cast<int>(camInfo->streamConfigurations[streamId].format);
-            success = evsCamera->mVideo.open(deviceName,
-                                             camInfo->streamConfigurations[streamId].width,
-                                             camInfo->streamConfigurations[streamId].height);
             // Safe to statically cast
             // ::aidl::android::hardware::graphics::common::PixelFormat type to
             // android_pixel_format_t
             evsCamera->mFormat =
                     static_cast<uint32_t>(camInfo->streamConfigurations[streamId].format);
+            success = evsCamera->setCaptureFormat(camInfo->streamConfigurations[streamId].width,
+                                                  camInfo->streamConfigurations[streamId].height);
         }
     }
 
@@ -900,7 +882,7 @@ std::shared_ptr<EvsV4lCamera> EvsV4lCamera::Create(
         // Create a camera object with the default resolution and format
         // , HAL_PIXEL_FORMAT_RGBA_8888.
         LOG(INFO) << "Open a video with default parameters";
-        success = evsCamera->mVideo.open(deviceName, kDefaultResolution[0], kDefaultResolution[1]);
+        success = evsCamera->setCaptureFormat(kDefaultResolution[0], kDefaultResolution[1]);
         if (!success) {
             LOG(ERROR) << "Failed to open a video stream";
             return nullptr;
@@ -918,6 +900,32 @@ std::shared_ptr<EvsV4lCamera> EvsV4lCamera::Create(
     return evsCamera;
 }
 
+bool EvsV4lCamera::setCaptureFormat(int32_t width, int32_t height) {
+    // Prefers a capture format we can pass through to the output buffers, and then the one with
+    // the cheapest conversion.
+    auto captureFormat = negotiateCaptureFormat(mFormat, mVideo.getSupportedFormats());
+    if (captureFormat == 0) {
+        LOG(WARNING) << mDescription.id << " supports no capture format for the output format 0x"
+                     << std::hex << mFormat << "; requesting YUYV";
+        captureFormat = V4L2_PIX_FMT_YUYV;
+    }
+
+    return mVideo.setFormat(width, height, captureFormat);
+}
+
+std::string EvsV4lCamera::toString(const char* indent) const {
+    const auto captureFormat = mVideo.getV4LFormat();
+    std::string buffer;
+    StringAppendF(&buffer,
+                  "%sCapture: %s, %u x %u, %u bytes per line, %s API\n"
+                  "%sOutput: format 0x%X, %s\n",
+                  indent, fourccToString(captureFormat).data(), mVideo.getWidth(),
+                  mVideo.getHeight(), mVideo.getStride(),
+                  mVideo.isMultiPlanar() ? "multi-planar" : "single-planar", indent, mFormat,
+                  isPassThrough(mFormat, captureFormat) ? "pass-through" : "converted by CPU");
+    return buffer;
+}
+
 Result<void> EvsV4lCamera::startDumpFrames(const std::string& path) {
     struct stat info;
     if (stat(path.data(), &info) != 0) {
@@ -36,7 +36,7 @@
 //        during the resource setup phase.  Of particular note is the potential to leak
 //        the file descriptor.  This must be fixed before using this code for anything but
 //        experimentation.
-bool VideoCapture::open(const char* deviceName, const int32_t width, const int32_t height) {
+bool VideoCapture::open(const char* deviceName) {
     // If we want a polling interface for getting frames, we would use O_NONBLOCK
     mDeviceFd = ::open(deviceName, O_RDWR, 0);
     if (mDeviceFd < 0) {
@@ -62,66 +62,98 @@ bool VideoCapture::open(const char* deviceName, const int32_t width, const int32
     LOG(DEBUG) << "  All Caps: " << std::hex << std::setw(8) << caps.capabilities;
     LOG(DEBUG) << "  Dev Caps: " << std::hex << caps.device_caps;
 
+    // Verify we can use this device for video capture.  We prefer the single-planar API and use
+    // the multi-planar API with the devices, e.g. NV12 sensors of some SoCs, that only offer it.
+    if (!(caps.capabilities & V4L2_CAP_STREAMING)) {
+        // Can't do streaming capture.
+        LOG(ERROR) << "Streaming capture not supported by " << deviceName;
+        return false;
+    } else if (caps.capabilities & V4L2_CAP_VIDEO_CAPTURE) {
+        mBufType = V4L2_BUF_TYPE_VIDEO_CAPTURE;
+    } else if (caps.capabilities & V4L2_CAP_VIDEO_CAPTURE_MPLANE) {
+        mBufType = V4L2_BUF_TYPE_VIDEO_CAPTURE_MPLANE;
+    } else {
+        LOG(ERROR) << "Video capture not supported by " << deviceName;
+        return false;
+    }
+
     // Enumerate the available capture formats (if any)
     LOG(DEBUG) << "Supported capture formats:";
+    mSupportedFormats.clear();
     v4l2_fmtdesc formatDescriptions;
-    formatDescriptions.type = V4L2_BUF_TYPE_VIDEO_CAPTURE;
+    formatDescriptions.type = mBufType;
     for (int i = 0; true; i++) {
         formatDescriptions.index = i;
         if (ioctl(mDeviceFd, VIDIOC_ENUM_FMT, &formatDescriptions) == 0) {
             LOG(DEBUG) << "  " << std::setw(2) << i << ": " << formatDescriptions.description << " "
                        << std::hex << std::setw(8) << formatDescriptions.pixelformat << " "
                        << std::hex << formatDescriptions.flags;
+            mSupportedFormats.push_back(formatDescriptions.pixelformat);
         } else {
             // No more formats available
             break;
         }
     }
 
-    // Verify we can use this device for video capture
-    if (!(caps.capabilities & V4L2_CAP_VIDEO_CAPTURE) ||
-        !(caps.capabilities & V4L2_CAP_STREAMING)) {
-        // Can't do streaming capture.
-        LOG(ERROR) << "Streaming capture not supported by " << deviceName;
-        return false;
-    }
+    // Make sure we're initialized to the STOPPED state
+    mRunMode = STOPPED;
+    mFrames.clear();
+
+    // Ready to go!
+    return true;
+}
 
+bool VideoCapture::setFormat(const int32_t width, const int32_t height,
+                             const uint32_t pixelFormat) {
     // Set our desired output format
-    v4l2_format format;
-    format.type = V4L2_BUF_TYPE_VIDEO_CAPTURE;
-    format.fmt.pix.pixelformat = V4L2_PIX_FMT_YUYV;
-    format.fmt.pix.width = width;
-    format.fmt.pix.height = height;
-    LOG(INFO) << "Requesting format: " << ((char*)&format.fmt.pix.pixelformat)[0]
-              << ((char*)&format.fmt.pix.pixelformat)[1] << ((char*)&format.fmt.pix.pixelformat)[2]
-              << ((char*)&format.fmt.pix.pixelformat)[3] << "(" << std::hex << std::setw(8)
-              << format.fmt.pix.pixelformat << ")";
+    v4l2_format format = {};
+    format.type = mBufType;
+    if (isMultiPlanar()) {
+        format.fmt.pix_mp.pixelformat = pixelFormat;
+        format.fmt.pix_mp.width = width;
+        format.fmt.pix_mp.height = height;
+        format.fmt.pix_mp.field = V4L2_FIELD_ANY;
+        format.fmt.pix_mp.num_planes = 1;
+    } else {
+        format.fmt.pix.pixelformat = pixelFormat;
+        format.fmt.pix.width = width;
+        format.fmt.pix.height = height;
+    }
+    LOG(INFO) << "Requesting format: " << ((char*)&pixelFormat)[0] << ((char*)&pixelFormat)[1]
+              << ((char*)&pixelFormat)[2] << ((char*)&pixelFormat)[3] << "(" << std::hex
+              << std::setw(8) << pixelFormat << ")" << (isMultiPlanar() ? ", multi-planar" : "");
 
     if (ioctl(mDeviceFd, VIDIOC_S_FMT, &format) < 0) {
         PLOG(ERROR) << "VIDIOC_S_FMT failed";
     }
 
     // Report the current output format
-    format.type = V4L2_BUF_TYPE_VIDEO_CAPTURE;
-    if (ioctl(mDeviceFd, VIDIOC_G_FMT, &format) == 0) {
+    format.type = mBufType;
+    if (ioctl(mDeviceFd, VIDIOC_G_FMT, &format) < 0) {
+        PLOG(ERROR) << "VIDIOC_G_FMT failed";
+        return false;
+    }
+
+    if (isMultiPlanar()) {
+        if (format.fmt.pix_mp.num_planes != 1) {
+            // The frame handlers take a single pointer to the image data
+            LOG(ERROR) << "Formats with " << static_cast<unsigned>(format.fmt.pix_mp.num_planes)
+                       << " memory planes are not supported";
+            return false;
+        }
+        mFormat = format.fmt.pix_mp.pixelformat;
+        mWidth = format.fmt.pix_mp.width;
+        mHeight = format.fmt.pix_mp.height;
+        mStride = format.fmt.pix_mp.plane_fmt[0].bytesperline;
+    } else {
         mFormat = format.fmt.pix.pixelformat;
         mWidth = format.fmt.pix.width;
         mHeight = format.fmt.pix.height;
         mStride = format.fmt.pix.bytesperline;
-
-        LOG(INFO) << "Current output format:  " << "fmt=0x" << std::hex
-                  << format.fmt.pix.pixelformat << ", " << std::dec << format.fmt.pix.width << " x "
-                  << format.fmt.pix.height << ", pitch=" << format.fmt.pix.bytesperline;
-    } else {
-        PLOG(ERROR) << "VIDIOC_G_FMT failed";
-        return false;
     }
 
-    // Make sure we're initialized to the STOPPED state
-    mRunMode = STOPPED;
-    mFrames.clear();
-
-    // Ready to go!
+    LOG(INFO) << "Current output format:  " << "fmt=0x" << std::hex << mFormat << ", " << std::dec
+              << mWidth << " x " << mHeight << ", pitch=" << mStride;
     return true;
 }
 
@@ -148,7 +180,7 @@ bool VideoCapture::startStream(std::function<void(VideoCapture*, imageBuffer*, v
 
     // Tell the L4V2 driver to prepare our streaming buffers
     v4l2_requestbuffers bufrequest;
-    bufrequest.type = V4L2_BUF_TYPE_VIDEO_CAPTURE;
+    bufrequest.type = mBufType;
     bufrequest.memory = V4L2_MEMORY_MMAP;
     bufrequest.count = 1;
     if (ioctl(mDeviceFd, VIDIOC_REQBUFS, &bufrequest) < 0) {
@@ -158,35 +190,44 @@ bool VideoCapture::startStream(std::function<void(VideoCapture*, imageBuffer*, v
 
     mNumBuffers = bufrequest.count;
     mBufferInfos = std::make_unique<v4l2_buffer[]>(mNumBuffers);
+    mPlanes = std::make_unique<v4l2_plane[]>(mNumBuffers);
     mPixelBuffers = std::make_unique<void*[]>(mNumBuffers);
 
     for (int i = 0; i < mNumBuffers; ++i) {
         // Get the information on the buffer that was created for us
         memset(&mBufferInfos[i], 0, sizeof(v4l2_buffer));
-        mBufferInfos[i].type = V4L2_BUF_TYPE_VIDEO_CAPTURE;
+        memset(&mPlanes[i], 0, sizeof(v4l2_plane));
+        mBufferInfos[i].type = mBufType;
         mBufferInfos[i].memory = V4L2_MEMORY_MMAP;
         mBufferInfos[i].index = i;
+        if (isMultiPlanar()) {
+            mBufferInfos[i].m.planes = &mPlanes[i];
+            mBufferInfos[i].length = 1;
+        }
 
         if (ioctl(mDeviceFd, VIDIOC_QUERYBUF, &mBufferInfos[i]) < 0) {
             PLOG(ERROR) << "VIDIOC_QUERYBUF failed";
             return false;
         }
 
+        const auto offset =
+                isMultiPlanar() ? mPlanes[i].m.mem_offset : mBufferInfos[i].m.offset;
+        const auto length = getLength(mBufferInfos[i]);
         LOG(DEBUG) << "Buffer description:";
-        LOG(DEBUG) << "  offset: " << mBufferInfos[i].m.offset;
-        LOG(DEBUG) << "  length: " << mBufferInfos[i].length;
+        LOG(DEBUG) << "  offset: " << offset;
+        LOG(DEBUG) << "  length: " << length;
         LOG(DEBUG) << "  flags : " << std::hex << mBufferInfos[i].flags;
 
         // Get a pointer to the buffer contents by mapping into our address space
-        mPixelBuffers[i] = mmap(NULL, mBufferInfos[i].length, PROT_READ | PROT_WRITE, MAP_SHARED,
-                                mDeviceFd, mBufferInfos[i].m.offset);
+        mPixelBuffers[i] =
+                mmap(NULL, length, PROT_READ | PROT_WRITE, MAP_SHARED, mDeviceFd, offset);
 
         if (mPixelBuffers[i] == MAP_FAILED) {
             PLOG(ERROR) << "mmap() failed";
             return false;
         }
 
-        memset(mPixelBuffers[i], 0, mBufferInfos[i].length);
+        memset(mPixelBuffers[i], 0, length);
         LOG(INFO) << "Buffer mapped at " << mPixelBuffers[i];
 
         // Queue the first capture buffer
@@ -197,7 +238,7 @@ bool VideoCapture::startStream(std::function<void(VideoCapture*, imageBuffer*, v
     }
 
     // Start the video stream
-    const int type = V4L2_BUF_TYPE_VIDEO_CAPTURE;
+    const int type = mBufType;
     if (ioctl(mDeviceFd, VIDIOC_STREAMON, &type) < 0) {
         PLOG(ERROR) << "VIDIOC_STREAMON failed";
         return false;
@@ -230,7 +271,7 @@ void VideoCapture::stopStream() {
         }
 
         // Stop the underlying video stream (automatically empties the buffer queue)
-        const int type = V4L2_BUF_TYPE_VIDEO_CAPTURE;
+        const int type = mBufType;
         if (ioctl(mDeviceFd, VIDIOC_STREAMOFF, &type) < 0) {
             PLOG(ERROR) << "VIDIOC_STREAMOFF failed";
         }
@@ -240,12 +281,12 @@ void VideoCapture::stopStream() {
 
     for (int i = 0; i < mNumBuffers; ++i) {
         // Unmap the buffers we allocated
-        munmap(mPixelBuffers[i], mBufferInfos[i].length);
+        munmap(mPixelBuffers[i], getLength(mBufferInfos[i]));
     }
 
     // Tell the L4V2 driver to release our streaming buffers
     v4l2_requestbuffers bufrequest;
-    bufrequest.type = V4L2_BUF_TYPE_VIDEO_CAPTURE;
+    bufrequest.type = mBufType;
     bufrequest.memory = V4L2_MEMORY_MMAP;
     bufrequest.count = 0;
     ioctl(mDeviceFd, VIDIOC_REQBUFS, &bufrequest);
@@ -256,6 +297,7 @@ void VideoCapture::stopStream() {
     // Release capture buffers
     mNumBuffers = 0;
     mBufferInfos = nullptr;
+    mPlanes = nullptr;
     mPixelBuffers = nullptr;
 }
 
@@ -281,7 +323,12 @@ bool VideoCapture::returnFrame(int id) {
 void VideoCapture::collectFrames() {
     // Run until our atomic signal is cleared
     while (mRunMode == RUN) {
-        struct v4l2_buffer buf = {.type = V4L2_BUF_TYPE_VIDEO_CAPTURE, .memory = V4L2_MEMORY_MMAP};
+        struct v4l2_plane plane = {};
+        struct v4l2_buffer buf = {.type = mBufType, .memory = V4L2_MEMORY_MMAP};
+        if (isMultiPlanar()) {
+            buf.m.planes = &plane;
+            buf.length = 1;
+        }
 
         // Wait for a buffer to be ready
         if (ioctl(mDeviceFd, VIDIOC_DQBUF, &buf) < 0) {
@@ -292,6 +339,10 @@ void VideoCapture::collectFrames() {
         mFrames.insert(buf.index);
 
         // Update a frame metadata
+        if (isMultiPlanar()) {
+            mPlanes[buf.index] = plane;
+            buf.m.planes = &mPlanes[buf.index];
+        }
         mBufferInfos[buf.index] = buf;
 
         // If a callback was requested per frame, do that now
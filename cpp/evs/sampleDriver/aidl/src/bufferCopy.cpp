@@ -49,6 +49,27 @@ void fillNV21FromNV21(const BufferDesc& tgtBuff, uint8_t* tgt, void* imgData, un
     memcpy(tgt, imgData, totalBytes);
 }
 
+void fillNV21FromNV12(const BufferDesc& tgtBuff, uint8_t* tgt, void* imgData, unsigned imgStride) {
+    // NV12 differs from NV21 only in the order of the interleaved chroma samples, U/V instead of
+    // V/U, so we copy the Y array and swap each pair of chroma samples.
+    const AHardwareBuffer_Desc* pDesc =
+            reinterpret_cast<const AHardwareBuffer_Desc*>(&tgtBuff.buffer.description);
+    const unsigned strideLum = align<16>(pDesc->width);
+    const unsigned sizeY = strideLum * pDesc->height;
+    const unsigned strideColor = strideLum;  // 1/2 the samples, but two interleaved channels
+
+    // The source chroma array follows the Y array with the same stride
+    const uint8_t* srcY = reinterpret_cast<const uint8_t*>(imgData);
+    const uint8_t* srcUV = srcY + imgStride * pDesc->height;
+
+    // libyuv only knows the NV21 to NV12 direction, which is the same swap
+    auto result = libyuv::NV21ToNV12(srcY, imgStride, srcUV, imgStride, tgt, strideLum,
+                                     tgt + sizeY, strideColor, pDesc->width, pDesc->height);
+    if (result) {
+        LOG(ERROR) << "Failed to convert NV12 to NV21.";
+    }
+}
+
 void fillNV21FromYUYV(const BufferDesc& tgtBuff, uint8_t* tgt, void* imgData, unsigned imgStride) {
     // The YUYV format provides an interleaved array of pixel values with U and V subsampled in
     // the horizontal direction only.  Also known as interleaved 422 format.  A 4 byte
@@ -136,6 +157,22 @@ void fillRGBAFromYUYV(const BufferDesc& tgtBuff, uint8_t* tgt, void* imgData, un
     }
 }
 
+void fillRGBAFromRGBA(const BufferDesc& tgtBuff, uint8_t* tgt, void* imgData, unsigned imgStride) {
+    const AHardwareBuffer_Desc* pDesc =
+            reinterpret_cast<const AHardwareBuffer_Desc*>(&tgtBuff.buffer.description);
+    unsigned width = pDesc->width;
+    unsigned height = pDesc->height;
+    uint8_t* src = (uint8_t*)imgData;
+    uint8_t* dst = (uint8_t*)tgt;
+    unsigned srcStrideBytes = imgStride;
+    unsigned dstStrideBytes = pDesc->stride * 4;
+
+    for (unsigned r = 0; r < height; r++) {
+        // Copy a pixel row at a time (4 bytes per pixel)
+        memcpy(dst + r * dstStrideBytes, src + r * srcStrideBytes, width * 4);
+    }
+}
+
 void fillYUYVFromYUYV(const BufferDesc& tgtBuff, uint8_t* tgt, void* imgData, unsigned imgStride) {
     const AHardwareBuffer_Desc* pDesc =
             reinterpret_cast<const AHardwareBuffer_Desc*>(&tgtBuff.buffer.description);
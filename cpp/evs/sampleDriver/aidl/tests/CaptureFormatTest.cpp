@@ -0,0 +1,62 @@
+/*
+ * Copyright (C) 2024 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "CaptureFormat.h"
+
+#include <gtest/gtest.h>
+#include <linux/videodev2.h>
+#include <system/graphics.h>
+
+#include <vector>
+
+namespace aidl::android::hardware::automotive::evs::implementation {
+
+TEST(CaptureFormatTest, TestPrefersPassThrough) {
+    const std::vector<uint32_t> deviceFormats = {V4L2_PIX_FMT_YUYV, V4L2_PIX_FMT_NV12,
+                                                 V4L2_PIX_FMT_NV21};
+
+    EXPECT_EQ(negotiateCaptureFormat(HAL_PIXEL_FORMAT_YCRCB_420_SP, deviceFormats),
+              V4L2_PIX_FMT_NV21);
+    EXPECT_TRUE(isPassThrough(HAL_PIXEL_FORMAT_YCRCB_420_SP, V4L2_PIX_FMT_NV21));
+}
+
+TEST(CaptureFormatTest, TestPrefersCheapestConversion) {
+    EXPECT_EQ(negotiateCaptureFormat(HAL_PIXEL_FORMAT_YCRCB_420_SP,
+                                     {V4L2_PIX_FMT_YUYV, V4L2_PIX_FMT_NV12}),
+              V4L2_PIX_FMT_NV12);
+    EXPECT_FALSE(isPassThrough(HAL_PIXEL_FORMAT_YCRCB_420_SP, V4L2_PIX_FMT_NV12));
+    EXPECT_EQ(negotiateCaptureFormat(HAL_PIXEL_FORMAT_YCRCB_420_SP, {V4L2_PIX_FMT_YUYV}),
+              V4L2_PIX_FMT_YUYV);
+    EXPECT_EQ(negotiateCaptureFormat(HAL_PIXEL_FORMAT_RGBA_8888,
+                                     {V4L2_PIX_FMT_YUYV, V4L2_PIX_FMT_RGBA32}),
+              V4L2_PIX_FMT_RGBA32);
+    EXPECT_EQ(negotiateCaptureFormat(HAL_PIXEL_FORMAT_YCBCR_422_I,
+                                     {V4L2_PIX_FMT_UYVY, V4L2_PIX_FMT_YUYV}),
+              V4L2_PIX_FMT_YUYV);
+}
+
+TEST(CaptureFormatTest, TestReturnsZeroWithoutCommonFormat) {
+    EXPECT_EQ(negotiateCaptureFormat(HAL_PIXEL_FORMAT_RGBA_8888, {V4L2_PIX_FMT_NV12}), 0u);
+    EXPECT_EQ(negotiateCaptureFormat(HAL_PIXEL_FORMAT_RGBA_8888, {}), 0u);
+    EXPECT_TRUE(getCaptureFormatsFor(HAL_PIXEL_FORMAT_BLOB).empty());
+}
+
+TEST(CaptureFormatTest, TestFourccToString) {
+    EXPECT_EQ(fourccToString(V4L2_PIX_FMT_NV12), "NV12");
+    EXPECT_EQ(fourccToString(V4L2_PIX_FMT_YUYV), "YUYV");
+}
+
+}  // namespace aidl::android::hardware::automotive::evs::implementation
@@ -41,10 +41,23 @@ struct BufferedCarData {
     }
 
     // Returns the size of the stored data. Note that it's not the exact size of the struct.
+    // It's the compressed size when the content is compressed.
     int32_t contentSizeInBytes() const { return mContent.size(); }
 
+    // Returns the size of the content as it was written by the publisher.
+    int32_t uncompressedSizeInBytes() const {
+        return isCompressed() ? mUncompressedSize : mContent.size();
+    }
+
+    bool isCompressed() const { return mUncompressedSize > 0; }
+
     const int32_t mId;
-    const std::vector<uint8_t> mContent;
+
+    // LZ4 compressed when `mUncompressedSize` is positive. See RingBuffer.
+    std::vector<uint8_t> mContent;
+
+    // The size of the content before the compression, or 0 if the content is not compressed.
+    int32_t mUncompressedSize = 0;
 
     // The uid of the logging client.
     const uid_t mPublisherUid;
@@ -17,42 +17,131 @@
 #include "RingBuffer.h"
 
 #include <android-base/logging.h>
+#include <lz4.h>
 
 #include <inttypes.h>  // for PRIu64 and friends
 
+#include <algorithm>
+#include <iterator>
 #include <memory>
 
 namespace android {
 namespace automotive {
 namespace telemetry {
 
-RingBuffer::RingBuffer(int32_t limit) : mSizeLimit(limit) {}
+using ::android::base::Error;
+using ::android::base::Result;
+
+RingBuffer::RingBuffer(int32_t sizeLimit, int64_t bytesLimit, int32_t compressionThresholdBytes) :
+      mSizeLimit(sizeLimit),
+      mBytesLimit(bytesLimit),
+      mCompressionThresholdBytes(compressionThresholdBytes) {}
 
 void RingBuffer::push(BufferedCarData&& data) {
+    mStoredBytes += data.contentSizeInBytes();
+    mUncompressedBytes += data.uncompressedSizeInBytes();
     mList.push_back(std::move(data));
     while (mList.size() > mSizeLimit) {
-        mList.pop_front();
-        mTotalDroppedDataCount += 1;
+        dropFront();
+    }
+    if (mStoredBytes > mBytesLimit && mCompressionThresholdBytes > kCompressionDisabled) {
+        compressOldestData();
+    }
+    while (mStoredBytes > mBytesLimit && !mList.empty()) {
+        dropFront();
     }
 }
 
-BufferedCarData RingBuffer::popBack() {
-    auto result = std::move(mList.back());
+Result<BufferedCarData> RingBuffer::popBack() {
+    auto data = std::move(mList.back());
     mList.pop_back();
-    return result;
+    mStoredBytes -= data.contentSizeInBytes();
+    mUncompressedBytes -= data.uncompressedSizeInBytes();
+    mCompressionCheckedCount = std::min(mCompressionCheckedCount, mList.size());
+    return decompress(std::move(data));
+}
+
+BufferedCarData RingBuffer::popFront() {
+    auto data = std::move(mList.front());
+    mList.pop_front();
+    mStoredBytes -= data.contentSizeInBytes();
+    mUncompressedBytes -= data.uncompressedSizeInBytes();
+    if (mCompressionCheckedCount > 0) {
+        mCompressionCheckedCount -= 1;
+    }
+    return data;
+}
+
+Result<BufferedCarData> RingBuffer::decompress(BufferedCarData data) {
+    if (!data.isCompressed()) {
+        return data;
+    }
+    std::vector<uint8_t> content(data.mUncompressedSize);
+    int decompressedSize =
+            LZ4_decompress_safe(reinterpret_cast<const char*>(data.mContent.data()),
+                                reinterpret_cast<char*>(content.data()),
+                                data.contentSizeInBytes(), data.mUncompressedSize);
+    if (decompressedSize != data.mUncompressedSize) {
+        return Error() << "Failed to decompress CarData with ID=" << data.mId << ", expected "
+                       << data.mUncompressedSize << " bytes, got " << decompressedSize;
+    }
+    data.mContent = std::move(content);
+    data.mUncompressedSize = 0;
+    return data;
+}
+
+void RingBuffer::compressOldestData() {
+    auto it = std::next(mList.begin(), mCompressionCheckedCount);
+    for (; it != mList.end() && mStoredBytes > mBytesLimit; ++it, ++mCompressionCheckedCount) {
+        int32_t size = it->contentSizeInBytes();
+        if (it->isCompressed() || size < mCompressionThresholdBytes) {
+            continue;
+        }
+        mCompressionBuffer.resize(LZ4_compressBound(size));
+        int compressedSize =
+                LZ4_compress_default(reinterpret_cast<const char*>(it->mContent.data()),
+                                     reinterpret_cast<char*>(mCompressionBuffer.data()), size,
+                                     mCompressionBuffer.size());
+        // Incompressible data stays as is, it is not worth decompressing later.
+        if (compressedSize <= 0 || compressedSize >= size) {
+            continue;
+        }
+        // A new vector, as assign() would keep the uncompressed capacity allocated.
+        it->mContent = std::vector<uint8_t>(mCompressionBuffer.begin(),
+                                            mCompressionBuffer.begin() + compressedSize);
+        it->mUncompressedSize = size;
+        mStoredBytes -= size - compressedSize;
+        mTotalCompressedDataCount += 1;
+    }
+}
+
+void RingBuffer::dropFront() {
+    popFront();
+    mTotalDroppedDataCount += 1;
 }
 
 void RingBuffer::dump(int fd) const {
     dprintf(fd, "    RingBuffer:\n");
     dprintf(fd, "      mSizeLimit=%d\n", mSizeLimit);
+    dprintf(fd, "      mBytesLimit=%" PRId64 "\n", mBytesLimit);
+    dprintf(fd, "      mCompressionThresholdBytes=%d\n", mCompressionThresholdBytes);
     dprintf(fd, "      mList.size=%zu\n", mList.size());
-    dprintf(fd, "      mTotalDroppedDataCount=%" PRIu64 "\n", mTotalDroppedDataCount);
+    dprintf(fd, "      mStoredBytes=%" PRId64 "\n", mStoredBytes);
+    dprintf(fd, "      mUncompressedBytes=%" PRId64 "\n", mUncompressedBytes);
+    dprintf(fd, "      compressionRatio=%.2f\n",
+            mStoredBytes > 0 ? static_cast<double>(mUncompressedBytes) / mStoredBytes : 1.0);
+    dprintf(fd, "      mTotalCompressedDataCount=%" PRId64 "\n", mTotalCompressedDataCount);
+    dprintf(fd, "      mTotalDroppedDataCount=%" PRId64 "\n", mTotalDroppedDataCount);
 }
 
 int32_t RingBuffer::size() const {
     return mList.size();
 }
 
+int64_t RingBuffer::sizeInBytes() const {
+    return mStoredBytes;
+}
+
 }  // namespace telemetry
 }  // namespace automotive
 }  // namespace android
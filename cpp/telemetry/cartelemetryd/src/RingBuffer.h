@@ -19,19 +19,35 @@
 
 #include "BufferedCarData.h"
 
+#include <android-base/result.h>
+
+#include <limits>
 #include <list>
+#include <vector>
 
 namespace android {
 namespace automotive {
 namespace telemetry {
 
 // A ring buffer that holds BufferedCarData. It drops old data if it's full.
+//
+// When the stored content exceeds the byte limit, the buffer first LZ4 compresses the oldest
+// uncompressed data that is at least `compressionThresholdBytes` large, and only then drops the
+// oldest data. The compression is lazy, so the ingest path stays cheap while the buffer has
+// room. Compressed data is decompressed when it is popped.
+//
 // Not thread-safe.
 class RingBuffer {
 public:
-    // RingBuffer limits the number of elements in the buffer to the given param `sizeLimit`.
+    // Disables the compression when used as `compressionThresholdBytes`.
+    static constexpr int32_t kCompressionDisabled = 0;
+
+    // RingBuffer limits the number of elements in the buffer to the given param `sizeLimit` and
+    // the total size of the stored (possibly compressed) content to `bytesLimit`.
     // Doesn't pre-allocate the memory.
-    explicit RingBuffer(int32_t sizeLimit);
+    explicit RingBuffer(int32_t sizeLimit,
+                        int64_t bytesLimit = std::numeric_limits<int64_t>::max(),
+                        int32_t compressionThresholdBytes = kCompressionDisabled);
 
     // Not copyable or movable
     RingBuffer(const RingBuffer&) = delete;
@@ -39,12 +55,23 @@ public:
     RingBuffer(RingBuffer&&) = delete;
     RingBuffer& operator=(RingBuffer&&) = delete;
 
-    // Pushes the data to the buffer. If the buffer is full, it removes the oldest data.
-    // Supports moving the data to the RingBuffer.
+    // Pushes the data to the buffer. If the buffer is full, it compresses or removes the oldest
+    // data. Supports moving the data to the RingBuffer.
     void push(BufferedCarData&& data);
 
-    // Returns the newest element from the ring buffer and removes it from the buffer.
-    BufferedCarData popBack();
+    // Returns the newest element from the ring buffer and removes it from the buffer. The returned
+    // content is always uncompressed. Returns an error if the content cannot be decompressed,
+    // the element is removed from the buffer in that case too.
+    android::base::Result<BufferedCarData> popBack();
+
+    // Returns the oldest element from the ring buffer and removes it from the buffer. The
+    // returned content may be compressed, which lets the caller decompress it with `decompress()`
+    // outside of its lock.
+    BufferedCarData popFront();
+
+    // Returns the given data with its content decompressed. Returns an error if the content
+    // cannot be decompressed.
+    static android::base::Result<BufferedCarData> decompress(BufferedCarData data);
 
     // Dumps the current state for dumpsys.
     void dump(int fd) const;
@@ -52,11 +79,35 @@ public:
     // Returns the number of elements in the buffer.
     int32_t size() const;
 
+    // Returns the total size of the stored content, which counts the compressed size of the
+    // compressed data.
+    int64_t sizeInBytes() const;
+
 private:
+    // Compresses the oldest not yet checked data until the buffer fits into `mBytesLimit`.
+    void compressOldestData();
+
+    // Removes the oldest element from the buffer.
+    void dropFront();
+
     const int32_t mSizeLimit;
+    const int64_t mBytesLimit;
+    const int32_t mCompressionThresholdBytes;
 
     // TODO(b/174608802): Improve dropped CarData handling, see ag/13818937 for details.
-    int64_t mTotalDroppedDataCount;
+    int64_t mTotalDroppedDataCount = 0;
+    int64_t mTotalCompressedDataCount = 0;
+
+    // Total size of the content in `mList`, as stored and as written by the publishers.
+    int64_t mStoredBytes = 0;
+    int64_t mUncompressedBytes = 0;
+
+    // Number of the oldest elements that are already compressed or were found not worth
+    // compressing. The compression resumes after them.
+    size_t mCompressionCheckedCount = 0;
+
+    // Reused output buffer for the compression.
+    std::vector<uint8_t> mCompressionBuffer;
 
     // Linked list that holds all the data and allows deleting old data when the buffer is full.
     std::list<BufferedCarData> mList;
@@ -45,14 +45,19 @@ constexpr int kMsgPushCarDataToListener = 1;
 // If ICarDataListener cannot accept data, the next push should be delayed little bit to allow
 // the listener to recover.
 constexpr const std::chrono::seconds kPushCarDataFailureDelaySeconds = 1s;
+
+// Maximum uncompressed size of the CarData popped from the buffer at once. The last CarData can
+// exceed it.
+constexpr int64_t kMaxPushCarDataBatchBytes = 256 * 1024;
 }  // namespace
 
 TelemetryServer::TelemetryServer(LooperWrapper* looper,
                                  const std::chrono::nanoseconds& pushCarDataDelayNs,
-                                 const int maxBufferSize) :
+                                 const int maxBufferSize, const int64_t maxBufferBytes,
+                                 const int32_t compressionThresholdBytes) :
       mLooper(looper),
       mPushCarDataDelayNs(pushCarDataDelayNs),
-      mRingBuffer(maxBufferSize),
+      mRingBuffer(maxBufferSize, maxBufferBytes, compressionThresholdBytes),
       mMessageHandler(new MessageHandlerImpl(this)) {}
 
 void TelemetryServer::setListener(const std::shared_ptr<ICarDataListener>& listener) {
@@ -83,41 +88,32 @@ std::vector<int32_t> TelemetryServer::findCarDataIdsIntersection(const std::vect
 
 void TelemetryServer::addCarDataIds(const std::vector<int32_t>& ids) {
     const std::scoped_lock<std::mutex> lock(mMutex);
-    mCarDataIds.insert(ids.cbegin(), ids.cend());
-    std::unordered_set<TelemetryCallback, TelemetryCallback::HashFunction> invokedCallbacks;
-    LOG(VERBOSE) << "Received addCarDataIds call from CarTelemetryService, notifying callbacks";
+    std::vector<int32_t> addedIds;
     for (int32_t id : ids) {
-        if (mIdToCallbacksMap.find(id) == mIdToCallbacksMap.end()) {
-            // prevent out of range exception when calling unordered_map.at()
-            continue;
-        }
-        const auto& callbacksForId = mIdToCallbacksMap.at(id);
-        LOG(VERBOSE) << "Invoking " << callbacksForId.size() << " callbacks for ID=" << id;
-        for (const TelemetryCallback& tc : callbacksForId) {
-            if (invokedCallbacks.find(tc) != invokedCallbacks.end()) {
-                // skipping already invoked callbacks
-                continue;
-            }
-            invokedCallbacks.insert(tc);
-            ndk::ScopedAStatus status =
-                    tc.callback->onChange(findCarDataIdsIntersection(tc.config.carDataIds));
-            if (status.getExceptionCode() == EX_TRANSACTION_FAILED &&
-                status.getStatus() == STATUS_DEAD_OBJECT) {
-                LOG(WARNING) << "Failed to invoke onChange() on a dead object, removing callback";
-                removeCallback(tc.callback);
-            }
+        if (mCarDataIds.insert(id).second) {
+            addedIds.push_back(id);
         }
     }
+    LOG(VERBOSE) << "Received addCarDataIds call from CarTelemetryService, notifying callbacks";
+    notifyCallbacksLocked(addedIds);
 }
 
 void TelemetryServer::removeCarDataIds(const std::vector<int32_t>& ids) {
     const std::scoped_lock<std::mutex> lock(mMutex);
+    std::vector<int32_t> removedIds;
     for (int32_t id : ids) {
-        mCarDataIds.erase(id);
+        if (mCarDataIds.erase(id) > 0) {
+            removedIds.push_back(id);
+        }
     }
-    std::unordered_set<TelemetryCallback, TelemetryCallback::HashFunction> invokedCallbacks;
     LOG(VERBOSE) << "Received removeCarDataIds call from CarTelemetryService, notifying callbacks";
-    for (int32_t id : ids) {
+    notifyCallbacksLocked(removedIds);
+}
+
+void TelemetryServer::notifyCallbacksLocked(const std::vector<int32_t>& changedIds) {
+    std::unordered_set<TelemetryCallback, TelemetryCallback::HashFunction> invokedCallbacks;
+    std::vector<std::shared_ptr<ICarTelemetryCallback>> deadCallbacks;
+    for (int32_t id : changedIds) {
         if (mIdToCallbacksMap.find(id) == mIdToCallbacksMap.end()) {
             // prevent out of range exception when calling unordered_map.at()
             continue;
@@ -135,10 +131,14 @@ void TelemetryServer::removeCarDataIds(const std::vector<int32_t>& ids) {
             if (status.getExceptionCode() == EX_TRANSACTION_FAILED &&
                 status.getStatus() == STATUS_DEAD_OBJECT) {
                 LOG(WARNING) << "Failed to invoke onChange() on a dead object, removing callback";
-                removeCallback(tc.callback);
+                deadCallbacks.push_back(tc.callback);
             }
         }
     }
+    // Removed after the loop, as removing modifies mIdToCallbacksMap.
+    for (const auto& callback : deadCallbacks) {
+        removeCallbackLocked(callback);
+    }
 }
 
 std::shared_ptr<ICarDataListener> TelemetryServer::getListener() {
@@ -177,15 +177,14 @@ Result<void> TelemetryServer::addCallback(const CallbackConfig& config,
                      << " associated callbacks";
     }
 
+    // Notifies the new callback even if none of its IDs are active, so that the publisher knows
+    // it can skip the CarData with these IDs.
     std::vector<int32_t> interestedIds = findCarDataIdsIntersection(config.carDataIds);
-    if (interestedIds.size() == 0) {
-        return {};
-    }
     LOG(VERBOSE) << "Notifying new callback with active CarData IDs";
     ndk::ScopedAStatus status = callback->onChange(interestedIds);
     if (status.getExceptionCode() == EX_TRANSACTION_FAILED &&
         status.getStatus() == STATUS_DEAD_OBJECT) {
-        removeCallback(callback);
+        removeCallbackLocked(callback);
         return Error(EX_ILLEGAL_ARGUMENT)
                 << "Failed to invoke onChange() on a dead object, removing callback";
     }
@@ -195,6 +194,11 @@ Result<void> TelemetryServer::addCallback(const CallbackConfig& config,
 Result<void> TelemetryServer::removeCallback(
         const std::shared_ptr<ICarTelemetryCallback>& callback) {
     const std::scoped_lock<std::mutex> lock(mMutex);
+    return removeCallbackLocked(callback);
+}
+
+Result<void> TelemetryServer::removeCallbackLocked(
+        const std::shared_ptr<ICarTelemetryCallback>& callback) {
     auto it = mCallbacks.find(TelemetryCallback(callback));
     if (it == mCallbacks.end()) {
         constexpr char msg[] = "Attempting to remove a CarTelemetryCallback that does not exist";
@@ -249,33 +253,68 @@ void TelemetryServer::writeCarData(const std::vector<CarData>& dataList, uid_t p
 
 // Runs on the main thread.
 void TelemetryServer::pushCarDataToListeners() {
-    std::vector<CarDataInternal> pendingCarDataInternals;
+    int32_t remainingCount = 0;
     {
         const std::scoped_lock<std::mutex> lock(mMutex);
         // Remove extra messages.
         mLooper->removeMessages(mMessageHandler, kMsgPushCarDataToListener);
-        if (mCarDataListener == nullptr || mRingBuffer.size() == 0) {
-            return;
+        // Only the data buffered so far is pushed, so that the publishers cannot keep the main
+        // thread busy.
+        remainingCount = mRingBuffer.size();
+    }
+
+    // The data is popped in batches, oldest first, and decompressed outside of the lock, so the
+    // decompressed content of at most one batch is held in memory at a time.
+    while (remainingCount > 0) {
+        std::vector<BufferedCarData> batch;
+        {
+            const std::scoped_lock<std::mutex> lock(mMutex);
+            if (mCarDataListener == nullptr) {
+                // setListener() schedules the push of the remaining data.
+                return;
+            }
+            int64_t batchBytes = 0;
+            while (remainingCount > 0 && mRingBuffer.size() > 0 &&
+                   batchBytes < kMaxPushCarDataBatchBytes) {
+                batch.push_back(mRingBuffer.popFront());
+                batchBytes += batch.back().uncompressedSizeInBytes();
+                remainingCount -= 1;
+            }
+            if (batch.empty()) {
+                return;
+            }
         }
-        // Push elements to pendingCarDataInternals in reverse order so we can send data
-        // from the back of the pendingCarDataInternals vector.
-        while (mRingBuffer.size() > 0) {
-            auto carData = std::move(mRingBuffer.popBack());
+
+        for (auto&& bufferedCarData : batch) {
+            auto carData = RingBuffer::decompress(std::move(bufferedCarData));
+            if (!carData.ok()) {
+                LOG(WARNING) << "Dropping CarData: " << carData.error();
+                continue;
+            }
             CarDataInternal data;
-            data.id = carData.mId;
-            data.content = std::move(carData.mContent);
-            pendingCarDataInternals.push_back(data);
+            data.id = carData->mId;
+            data.content = std::move(carData->mContent);
+            sendCarDataToListener(data);
         }
     }
 
+    const std::scoped_lock<std::mutex> lock(mMutex);
+    // writeCarData() doesn't schedule a push while the buffer is not empty.
+    if (mCarDataListener != nullptr && mRingBuffer.size() > 0) {
+        mLooper->sendMessageDelayed(mPushCarDataDelayNs.count(), mMessageHandler,
+                                    kMsgPushCarDataToListener);
+    }
+}
+
+void TelemetryServer::sendCarDataToListener(const CarDataInternal& data) {
     // TODO(b/186477983): send data in batch to improve performance, but careful sending too
     //                    many data at once, as it could clog the Binder - it has <1MB limit.
-    while (!pendingCarDataInternals.empty()) {
+    while (true) {
         ndk::ScopedAStatus status = ndk::ScopedAStatus::ok();
         {
             const std::scoped_lock<std::mutex> lock(mMutex);
             if (mCarDataListener != nullptr) {
-                status = mCarDataListener->onCarDataReceived({pendingCarDataInternals.back()});
+                status = mCarDataListener->onCarDataReceived({data});
             } else {
                 status = ndk::ScopedAStatus::
                         fromServiceSpecificErrorWithMessage(EX_NULL_POINTER,
@@ -283,17 +322,16 @@ void TelemetryServer::pushCarDataToListeners() {
                                                             "null, will try again.");
             }
         }
-        if (!status.isOk()) {
-            LOG(WARNING) << "Failed to push CarDataInternal, will try again. Status: "
-                         << status.getStatus()
-                         << ", service-specific error: " << status.getServiceSpecificError()
-                         << ", message: " << status.getMessage()
-                         << ", exception code: " << status.getExceptionCode()
-                         << ", description: " << status.getDescription();
-            sleep(kPushCarDataFailureDelaySeconds.count());
-        } else {
-            pendingCarDataInternals.pop_back();
+        if (status.isOk()) {
+            return;
         }
+        LOG(WARNING) << "Failed to push CarDataInternal, will try again. Status: "
+                     << status.getStatus()
+                     << ", service-specific error: " << status.getServiceSpecificError()
+                     << ", message: " << status.getMessage()
+                     << ", exception code: " << status.getExceptionCode()
+                     << ", description: " << status.getDescription();
+        sleep(kPushCarDataFailureDelaySeconds.count());
     }
 }
 
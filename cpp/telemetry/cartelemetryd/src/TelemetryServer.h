@@ -20,6 +20,7 @@
 #include "LooperWrapper.h"
 #include "RingBuffer.h"
 
+#include <aidl/android/automotive/telemetry/internal/CarDataInternal.h>
 #include <aidl/android/automotive/telemetry/internal/ICarDataListener.h>
 #include <aidl/android/frameworks/automotive/telemetry/CallbackConfig.h>
 #include <aidl/android/frameworks/automotive/telemetry/CarData.h>
@@ -84,7 +85,8 @@ struct TelemetryCallback {
 class TelemetryServer {
 public:
     explicit TelemetryServer(LooperWrapper* looper,
-                             const std::chrono::nanoseconds& pushCarDataDelayNs, int maxBufferSize);
+                             const std::chrono::nanoseconds& pushCarDataDelayNs, int maxBufferSize,
+                             int64_t maxBufferBytes, int32_t compressionThresholdBytes);
 
     /**
      * Dumps the current state for dumpsys.
@@ -103,7 +105,8 @@ public:
             uid_t publisherUid);
 
     /**
-     * Adds a ICarTelemtryCallback and associate it with the CallbackConfig.
+     * Adds a ICarTelemtryCallback and associate it with the CallbackConfig. The callback
+     * is notified about its active CarData IDs right away, even if there are none.
      *
      * <p>Expected to be called from a binder thread pool.
 
@@ -141,7 +144,8 @@ public:
 
     /**
      * Adds active CarData IDs, called by CarTelemetrydPublisher when the IDs
-     * has active subscribers.
+     * has active subscribers. Only the callbacks interested in the newly active IDs
+     * are notified, so that publishers can stop skipping them.
      *
      * <p>Expected to be called from a binder thread pool.
      */
@@ -149,7 +153,8 @@ public:
 
     /**
      * Removes CarData IDs, called by CarTelemetrydPublisher when the IDs
-     * no longer has subscribers.
+     * no longer has subscribers. Only the callbacks interested in the IDs that were
+     * active are notified.
      *
      * <p>Expected to be called from a binder thread pool.
      */
@@ -174,8 +179,16 @@ private:
 private:
     // Find the common elements in mCarDataIds and the argument ids
     std::vector<int32_t> findCarDataIdsIntersection(const std::vector<int32_t>& ids);
+    // Notifies the callbacks interested in any of the changed IDs about their active IDs, and
+    // removes the dead callbacks.
+    void notifyCallbacksLocked(const std::vector<int32_t>& changedIds) REQUIRES(mMutex);
+    android::base::Result<void> removeCallbackLocked(
+            const std::shared_ptr<ICarTelemetryCallback>& callback) REQUIRES(mMutex);
     // Periodically called by mLooper if there is a "push car data" messages.
     void pushCarDataToListeners();
+    // Sends the CarData to mCarDataListener, retrying until it succeeds.
+    void sendCarDataToListener(
+            const aidl::android::automotive::telemetry::internal::CarDataInternal& data);
 
     LooperWrapper* mLooper;  // not owned
     const std::chrono::nanoseconds mPushCarDataDelayNs;
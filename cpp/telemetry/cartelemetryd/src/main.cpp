@@ -49,15 +49,24 @@ constexpr const char kCarTelemetryInternalServiceName[] =
 constexpr const std::chrono::nanoseconds kPushCarDataDelayNs = 10ms;
 
 // TODO(b/183444070): make it configurable using sysprop
-// CarData count limit in the RingBuffer. In worst case it will use kMaxBufferSize * 10Kb memory,
-// which is ~ 1MB.
-const int kMaxBufferSize = 100;
+// CarData count limit in the RingBuffer. It bounds the per-element overhead, the memory used by
+// the content is bounded by kMaxBufferBytes.
+const int kMaxBufferSize = 1000;
+
+// Limit of the stored CarData content size in the RingBuffer, ~ 1MB. Compressed CarData is
+// counted by its compressed size.
+const int64_t kMaxBufferBytes = 1024 * 1024;
+
+// CarData smaller than this is not compressed when the RingBuffer is over kMaxBufferBytes,
+// compressing it would save little memory.
+const int32_t kCompressionThresholdBytes = 512;
 
 int main(void) {
     LOG(INFO) << "Starting cartelemetryd";
 
     LooperWrapper looper(android::Looper::prepare(/* opts= */ 0));
-    TelemetryServer server(&looper, kPushCarDataDelayNs, kMaxBufferSize);
+    TelemetryServer server(&looper, kPushCarDataDelayNs, kMaxBufferSize, kMaxBufferBytes,
+                           kCompressionThresholdBytes);
     std::shared_ptr<CarTelemetryImpl> telemetry =
             ndk::SharedRefBase::make<CarTelemetryImpl>(&server);
     std::shared_ptr<CarTelemetryInternalImpl> telemetryInternal =
@@ -0,0 +1,109 @@
+/*
+ * Copyright 2024 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "BufferedCarData.h"
+#include "RingBuffer.h"
+
+#include <benchmark/benchmark.h>
+
+#include <stdio.h>
+
+#include <random>
+#include <string>
+#include <vector>
+
+namespace android {
+namespace automotive {
+namespace telemetry {
+
+namespace {
+
+// Same limits as in main.cpp.
+constexpr int32_t kMaxBufferSize = 1000;
+constexpr int64_t kMaxBufferBytes = 1024 * 1024;
+constexpr int32_t kCompressionThresholdBytes = 512;
+
+constexpr int32_t kPayloadCount = 64;
+constexpr uid_t kPublisherUid = 1000;
+
+// Builds payloads that resemble the CarData published on a device: text-like serialized
+// records with repeated field names and varying values, 1KB - 10KB large.
+std::vector<std::vector<uint8_t>> buildPayloads() {
+    std::mt19937 random(/* seed= */ 42);
+    std::uniform_int_distribution<int32_t> sizes(1024, 10 * 1024);
+    std::uniform_int_distribution<int32_t> values(0, 100000);
+    std::vector<std::vector<uint8_t>> payloads;
+    for (int32_t i = 0; i < kPayloadCount; i++) {
+        const int32_t size = sizes(random);
+        std::string record;
+        while (record.size() < static_cast<size_t>(size)) {
+            record += "{\"uid\":" + std::to_string(values(random) % 200 + 10000) +
+                    ",\"package\":\"com.android.car.app" + std::to_string(values(random) % 20) +
+                    "\",\"cpu_time_ms\":" + std::to_string(values(random)) +
+                    ",\"rss_kb\":" + std::to_string(values(random)) + "}";
+        }
+        payloads.emplace_back(record.begin(), record.begin() + size);
+    }
+    return payloads;
+}
+
+void BM_Push(benchmark::State& state) {
+    const int32_t compressionThresholdBytes =
+            state.range(0) ? kCompressionThresholdBytes : RingBuffer::kCompressionDisabled;
+    const std::vector<std::vector<uint8_t>> payloads = buildPayloads();
+    RingBuffer buffer(kMaxBufferSize, kMaxBufferBytes, compressionThresholdBytes);
+    int64_t pushedBytes = 0;
+    int32_t i = 0;
+    for (auto _ : state) {
+        const auto& payload = payloads[i++ % payloads.size()];
+        buffer.push({i, payload, kPublisherUid});
+        pushedBytes += payload.size();
+    }
+    state.SetItemsProcessed(state.iterations());
+    state.SetBytesProcessed(pushedBytes);
+    // Number of the newest CarData the buffer holds within kMaxBufferBytes.
+    state.counters["retained"] = buffer.size();
+}
+
+void BM_PopBack(benchmark::State& state) {
+    const int32_t compressionThresholdBytes =
+            state.range(0) ? kCompressionThresholdBytes : RingBuffer::kCompressionDisabled;
+    const std::vector<std::vector<uint8_t>> payloads = buildPayloads();
+    RingBuffer buffer(kMaxBufferSize, kMaxBufferBytes, compressionThresholdBytes);
+    int32_t i = 0;
+    for (auto _ : state) {
+        state.PauseTiming();
+        if (buffer.size() == 0) {
+            for (int32_t j = 0; j < kMaxBufferSize; j++, i++) {
+                buffer.push({i, payloads[i % payloads.size()], kPublisherUid});
+            }
+        }
+        state.ResumeTiming();
+        benchmark::DoNotOptimize(buffer.popBack());
+    }
+    state.SetItemsProcessed(state.iterations());
+}
+
+}  // namespace
+
+BENCHMARK(BM_Push)->ArgName("compression")->Arg(0)->Arg(1);
+BENCHMARK(BM_PopBack)->ArgName("compression")->Arg(0)->Arg(1);
+
+}  // namespace telemetry
+}  // namespace automotive
+}  // namespace android
+
+BENCHMARK_MAIN();
@@ -0,0 +1,168 @@
+/*
+ * Copyright 2024 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "BufferedCarData.h"
+#include "RingBuffer.h"
+
+#include <gtest/gtest.h>
+
+#include <string>
+#include <vector>
+
+namespace android {
+namespace automotive {
+namespace telemetry {
+
+namespace {
+
+const uid_t kPublisherUid = 1000;
+
+// Builds CarData content that compresses well, like text or repeated proto fields.
+std::vector<uint8_t> buildCompressibleContent(int32_t size, uint8_t seed) {
+    const std::string pattern = "speed=" + std::to_string(seed) + ";gear=D;";
+    std::vector<uint8_t> content(size);
+    for (int32_t i = 0; i < size; i++) {
+        content[i] = pattern[i % pattern.size()];
+    }
+    return content;
+}
+
+// Builds CarData content that does not compress.
+std::vector<uint8_t> buildIncompressibleContent(int32_t size, uint32_t seed) {
+    std::vector<uint8_t> content(size);
+    for (int32_t i = 0; i < size; i++) {
+        seed = seed * 1103515245 + 12345;
+        content[i] = seed >> 24;
+    }
+    return content;
+}
+
+}  // namespace
+
+TEST(RingBufferTest, DropsOldestDataOverSizeLimit) {
+    RingBuffer buffer(/* sizeLimit= */ 2);
+
+    buffer.push({1, {1}, kPublisherUid});
+    buffer.push({2, {2}, kPublisherUid});
+    buffer.push({3, {3}, kPublisherUid});
+
+    ASSERT_EQ(buffer.size(), 2);
+    EXPECT_EQ(*buffer.popBack(), BufferedCarData(3, {3}, kPublisherUid));
+    EXPECT_EQ(*buffer.popBack(), BufferedCarData(2, {2}, kPublisherUid));
+    EXPECT_EQ(buffer.size(), 0);
+    EXPECT_EQ(buffer.sizeInBytes(), 0);
+}
+
+TEST(RingBufferTest, DropsOldestDataOverBytesLimit) {
+    RingBuffer buffer(/* sizeLimit= */ 10, /* bytesLimit= */ 200);
+
+    buffer.push({1, buildCompressibleContent(100, 1), kPublisherUid});
+    buffer.push({2, buildCompressibleContent(100, 2), kPublisherUid});
+    buffer.push({3, buildCompressibleContent(100, 3), kPublisherUid});
+
+    ASSERT_EQ(buffer.size(), 2);
+    EXPECT_EQ(buffer.sizeInBytes(), 200);
+    EXPECT_EQ(buffer.popBack()->mId, 3);
+    EXPECT_EQ(buffer.popBack()->mId, 2);
+}
+
+TEST(RingBufferTest, CompressesOldestDataOverBytesLimit) {
+    RingBuffer buffer(/* sizeLimit= */ 10, /* bytesLimit= */ 2000,
+                      /* compressionThresholdBytes= */ 100);
+
+    for (int32_t id = 0; id < 5; id++) {
+        buffer.push({id, buildCompressibleContent(1000, id), kPublisherUid});
+    }
+
+    // All data fits after compressing it.
+    ASSERT_EQ(buffer.size(), 5);
+    EXPECT_LE(buffer.sizeInBytes(), 2000);
+    for (int32_t id = 4; id >= 0; id--) {
+        auto data = buffer.popBack();
+        ASSERT_TRUE(data.ok()) << data.error();
+        EXPECT_EQ(*data, BufferedCarData(id, buildCompressibleContent(1000, id), kPublisherUid));
+        EXPECT_FALSE(data->isCompressed());
+    }
+    EXPECT_EQ(buffer.sizeInBytes(), 0);
+}
+
+TEST(RingBufferTest, PopsOldestDataAsStored) {
+    RingBuffer buffer(/* sizeLimit= */ 10, /* bytesLimit= */ 2000,
+                      /* compressionThresholdBytes= */ 100);
+
+    for (int32_t id = 0; id < 3; id++) {
+        buffer.push({id, buildCompressibleContent(1000, id), kPublisherUid});
+    }
+
+    // The two oldest data were compressed to fit the newest one.
+    for (int32_t id = 0; id < 3; id++) {
+        BufferedCarData stored = buffer.popFront();
+        EXPECT_EQ(stored.mId, id);
+        EXPECT_EQ(stored.isCompressed(), id < 2);
+        if (stored.isCompressed()) {
+            // The memory of the uncompressed content must be released.
+            EXPECT_EQ(stored.mContent.capacity(), stored.mContent.size());
+        }
+        auto data = RingBuffer::decompress(std::move(stored));
+        ASSERT_TRUE(data.ok()) << data.error();
+        EXPECT_EQ(*data, BufferedCarData(id, buildCompressibleContent(1000, id), kPublisherUid));
+    }
+    EXPECT_EQ(buffer.size(), 0);
+    EXPECT_EQ(buffer.sizeInBytes(), 0);
+}
+
+TEST(RingBufferTest, DoesNotCompressDataUnderBytesLimit) {
+    RingBuffer buffer(/* sizeLimit= */ 10, /* bytesLimit= */ 2000,
+                      /* compressionThresholdBytes= */ 100);
+
+    buffer.push({1, buildCompressibleContent(1000, 1), kPublisherUid});
+    buffer.push({2, buildCompressibleContent(1000, 2), kPublisherUid});
+
+    EXPECT_EQ(buffer.sizeInBytes(), 2000);
+}
+
+TEST(RingBufferTest, DoesNotCompressDataUnderThreshold) {
+    RingBuffer buffer(/* sizeLimit= */ 10, /* bytesLimit= */ 200,
+                      /* compressionThresholdBytes= */ 101);
+
+    buffer.push({1, buildCompressibleContent(100, 1), kPublisherUid});
+    buffer.push({2, buildCompressibleContent(100, 2), kPublisherUid});
+    buffer.push({3, buildCompressibleContent(100, 3), kPublisherUid});
+
+    ASSERT_EQ(buffer.size(), 2);
+    EXPECT_EQ(buffer.sizeInBytes(), 200);
+}
+
+TEST(RingBufferTest, KeepsIncompressibleDataAsIs) {
+    RingBuffer buffer(/* sizeLimit= */ 10, /* bytesLimit= */ 2000,
+                      /* compressionThresholdBytes= */ 100);
+
+    buffer.push({1, buildIncompressibleContent(1000, 1), kPublisherUid});
+    buffer.push({2, buildIncompressibleContent(1000, 2), kPublisherUid});
+    buffer.push({3, buildCompressibleContent(1000, 3), kPublisherUid});
+
+    // Only the newest data compresses, which is not enough to keep the oldest data.
+    ASSERT_EQ(buffer.size(), 2);
+    EXPECT_LT(buffer.sizeInBytes(), 2000);
+    EXPECT_EQ(*buffer.popBack(),
+              BufferedCarData(3, buildCompressibleContent(1000, 3), kPublisherUid));
+    EXPECT_EQ(*buffer.popBack(),
+              BufferedCarData(2, buildIncompressibleContent(1000, 2), kPublisherUid));
+}
+
+}  // namespace telemetry
+}  // namespace automotive
+}  // namespace android
@@ -54,12 +54,15 @@ using ::aidl::android::frameworks::automotive::telemetry::ICarTelemetry;
 using ::ndk::ScopedAStatus;
 using ::testing::_;
 using ::testing::ByMove;
+using ::testing::IsEmpty;
 using ::testing::Return;
 using ::testing::UnorderedElementsAre;
 
 constexpr const std::chrono::nanoseconds kPushCarDataDelayNs = 1000ms;
 constexpr const std::chrono::nanoseconds kAllowedErrorNs = 100ms;
 const int kMaxBufferSize = 3;
+const int64_t kMaxBufferBytes = 1024;
+const int32_t kCompressionThresholdBytes = 64;
 
 // Because `ScopedAStatus` is move-only, `EXPECT_CALL().WillRepeatedly()` will not work.
 inline testing::internal::ReturnAction<testing::internal::ByMoveWrapper<ScopedAStatus>> ReturnOk() {
@@ -107,7 +110,8 @@ public:
 class TelemetryServerTest : public ::testing::Test {
 protected:
     TelemetryServerTest() :
-          mTelemetryServer(&mFakeLooper, kPushCarDataDelayNs, kMaxBufferSize),
+          mTelemetryServer(&mFakeLooper, kPushCarDataDelayNs, kMaxBufferSize, kMaxBufferBytes,
+                           kCompressionThresholdBytes),
           mDefaultConfig(buildConfig({101})),
           mMockCarDataListener(ndk::SharedRefBase::make<MockCarDataListener>()),
           mMockCarTelemetryCallback(ndk::SharedRefBase::make<MockCarTelemetryCallback>()),
@@ -169,6 +173,30 @@ TEST_F(TelemetryServerTest, AddCarDataIdsNotifiesInterestedCallbacks) {
     mTelemetryInternal->addCarDataIds({101, 102, 103, 104});
 }
 
+TEST_F(TelemetryServerTest, AddCarDataIdsDoesNotNotifyCallbacksForActiveIds) {
+    mTelemetry->addCallback(mDefaultConfig, mMockCarTelemetryCallback);
+
+    // mDefaultConfig only contains ID 101, which becomes active only once.
+    EXPECT_CALL(*mMockCarTelemetryCallback, onChange(UnorderedElementsAre(101)))
+            .Times(1)
+            .WillOnce(ReturnOk());
+
+    mTelemetryInternal->addCarDataIds({101});
+    mTelemetryInternal->addCarDataIds({101, 102});
+}
+
+TEST_F(TelemetryServerTest, AddCarDataIdsRemovesDeadCallbacks) {
+    mTelemetry->addCallback(mDefaultConfig, mMockCarTelemetryCallback);
+
+    EXPECT_CALL(*mMockCarTelemetryCallback, onChange(UnorderedElementsAre(101)))
+            .Times(1)
+            .WillOnce(Return(ByMove(ScopedAStatus::fromStatus(STATUS_DEAD_OBJECT))));
+
+    mTelemetryInternal->addCarDataIds({101});
+
+    EXPECT_FALSE(mTelemetry->removeCallback(mMockCarTelemetryCallback).isOk());
+}
+
 TEST_F(TelemetryServerTest, RemoveCarDataIdsReturnsOk) {
     mTelemetryInternal->addCarDataIds({101, 102, 103});
     EXPECT_EQ(3, mTelemetryServer.mCarDataIds.size());
@@ -196,6 +224,14 @@ TEST_F(TelemetryServerTest, RemoveCarDataIdsNotifiesInterestedCallbacks) {
     mTelemetryInternal->removeCarDataIds({103, 104});
 }
 
+TEST_F(TelemetryServerTest, RemoveCarDataIdsDoesNotNotifyCallbacksForInactiveIds) {
+    mTelemetry->addCallback(mDefaultConfig, mMockCarTelemetryCallback);
+
+    EXPECT_CALL(*mMockCarTelemetryCallback, onChange(_)).Times(0);
+
+    mTelemetryInternal->removeCarDataIds({101});
+}
+
 TEST_F(TelemetryServerTest, SetListenerReturnsOk) {
     auto status = mTelemetryInternal->setListener(mMockCarDataListener);
 
@@ -255,6 +291,14 @@ TEST_F(TelemetryServerTest, AddCallbackReceivesCarDataIds) {
     auto status = mTelemetry->addCallback(config, mMockCarTelemetryCallback);
 }
 
+TEST_F(TelemetryServerTest, AddCallbackReceivesEmptyCarDataIds) {
+    mTelemetryInternal->addCarDataIds({104});
+
+    EXPECT_CALL(*mMockCarTelemetryCallback, onChange(IsEmpty())).Times(1).WillOnce(ReturnOk());
+
+    mTelemetry->addCallback(mDefaultConfig, mMockCarTelemetryCallback);
+}
+
 TEST_F(TelemetryServerTest, RemoveCallbackReturnsOk) {
     mTelemetry->addCallback(mDefaultConfig, mMockCarTelemetryCallback);
 
@@ -312,6 +356,25 @@ TEST_F(TelemetryServerTest, BuffersOnlyLimitedData) {
     mFakeLooper.poll();
 }
 
+TEST_F(TelemetryServerTest, PushesCompressedDataDecompressedInWriteOrder) {
+    mTelemetryInternal->setListener(mMockCarDataListener);
+    mTelemetryInternal->addCarDataIds({101, 102, 103});
+    // 3 x 400 bytes exceed kMaxBufferBytes, so the oldest CarData gets compressed.
+    const std::vector<uint8_t> content(400, 7);
+    std::vector<CarData> dataList = {buildCarData(101, content), buildCarData(102, content),
+                                     buildCarData(103, content)};
+
+    mTelemetry->write(dataList);
+
+    testing::InSequence sequence;
+    expectMockListenerToReceive({buildCarDataInternal(101, content)}).WillOnce(ReturnOk());
+    expectMockListenerToReceive({buildCarDataInternal(102, content)}).WillOnce(ReturnOk());
+    expectMockListenerToReceive({buildCarDataInternal(103, content)}).WillOnce(ReturnOk());
+
+    mFakeLooper.poll();
+    mFakeLooper.poll();  // extra poll to verify there was not excess push calls
+}
+
 // Data is filtered out when mTelemetryInternal->addCarDataIds() is not called
 TEST_F(TelemetryServerTest, WriteFiltersDataBasedOnId) {
     std::vector<CarData> dataList = {buildCarData(101, {1})};
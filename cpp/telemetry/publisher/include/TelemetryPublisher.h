@@ -0,0 +1,220 @@
+/*
+ * Copyright (c) 2024, The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+#ifndef CPP_TELEMETRY_PUBLISHER_INCLUDE_TELEMETRYPUBLISHER_H_
+#define CPP_TELEMETRY_PUBLISHER_INCLUDE_TELEMETRYPUBLISHER_H_
+
+#include <aidl/android/frameworks/automotive/telemetry/CarData.h>
+#include <aidl/android/frameworks/automotive/telemetry/ICarTelemetry.h>
+#include <android-base/thread_annotations.h>
+#include <android/binder_auto_utils.h>
+
+#include <stdint.h>
+
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <thread>
+#include <unordered_set>
+#include <vector>
+
+namespace android {
+namespace automotive {
+namespace telemetry {
+
+// Publishes CarData to ICarTelemetry from native processes.
+//
+// `publish()` only buffers the data, a background thread sends the buffered data in batches that
+// fit into a single ICarTelemetry::write() call. The thread connects to ICarTelemetry lazily and
+// reconnects after a failed write. While ICarTelemetry is unavailable, the data stays in a
+// bounded buffer and the oldest data is dropped when the buffer is full.
+//
+// When `Options::carDataIds` is set, the publisher registers an ICarTelemetryCallback for these
+// IDs and drops the CarData that has no subscribers in cartelemetryd without sending it. Callers
+// can check `isSubscribed()` to skip building such CarData at all.
+//
+// This class is thread-safe.
+class TelemetryPublisher final {
+public:
+    // ICarTelemetry limits the size of CarData.content in a single write() call.
+    static constexpr int32_t kMaxDataSizePerWrite = 10 * 1024;
+
+    struct Options {
+        // Limit of the CarData count buffered while waiting to be sent.
+        int32_t maxBufferedDataCount = 200;
+        // The time to wait for more CarData before sending a batch that is not full.
+        std::chrono::milliseconds batchDelay = std::chrono::milliseconds(100);
+        // The time to wait before connecting again after ICarTelemetry was unavailable.
+        std::chrono::milliseconds reconnectDelay = std::chrono::seconds(1);
+        // CarData IDs published by this publisher whose subscriptions are tracked. Empty disables
+        // the tracking, and all CarData is sent.
+        std::vector<int32_t> carDataIds;
+    };
+
+    struct Stats {
+        // Number of CarData accepted by publish().
+        int64_t publishedDataCount = 0;
+        // Number of CarData written to ICarTelemetry.
+        int64_t sentDataCount = 0;
+        // Number of CarData dropped because the buffer was full.
+        int64_t droppedDataCount = 0;
+        // Number of CarData rejected by publish() because the content was too large.
+        int64_t rejectedDataCount = 0;
+        // Number of CarData skipped by publish() because the ID had no subscribers.
+        int64_t unsubscribedDataCount = 0;
+        // Number of failed attempts to send a batch, because ICarTelemetry was unavailable or
+        // the write() call failed.
+        int64_t failedSendCount = 0;
+    };
+
+    // Returns the ICarTelemetry service, or nullptr if it's not available. Called from the
+    // sender thread.
+    using CarTelemetryGetter = std::function<
+            std::shared_ptr<aidl::android::frameworks::automotive::telemetry::ICarTelemetry>()>;
+
+    // Creates a publisher that sends CarData to the default ICarTelemetry instance.
+    explicit TelemetryPublisher(const Options& options);
+
+    // Creates a publisher that sends CarData to the ICarTelemetry returned by `getCarTelemetry`.
+    TelemetryPublisher(const Options& options, CarTelemetryGetter getCarTelemetry);
+
+    // Stops the sender thread. The CarData that was not sent yet is dropped, call flush() before
+    // to send it.
+    ~TelemetryPublisher();
+
+    // Not copyable or movable
+    TelemetryPublisher(const TelemetryPublisher&) = delete;
+    TelemetryPublisher& operator=(const TelemetryPublisher&) = delete;
+    TelemetryPublisher(TelemetryPublisher&&) = delete;
+    TelemetryPublisher& operator=(TelemetryPublisher&&) = delete;
+
+    // Buffers the CarData for sending and returns without waiting for ICarTelemetry.
+    // Returns false if the CarData is not going to be sent, because the content is larger than
+    // `kMaxDataSizePerWrite` or the ID has no subscribers.
+    bool publish(int32_t id, std::vector<uint8_t>&& content);
+
+    // Returns false if cartelemetryd reported that the CarData ID has no subscribers. Returns
+    // true for the IDs that are not in `Options::carDataIds`, and until cartelemetryd reports
+    // the subscriptions.
+    bool isSubscribed(int32_t id) const;
+
+    // Sends the buffered CarData without waiting for `Options::batchDelay`, and blocks until all
+    // of it is sent or `timeout` passes. Returns true if all the buffered CarData was sent.
+    bool flush(std::chrono::milliseconds timeout);
+
+    // Returns the counters since the publisher was created.
+    Stats getStats() const;
+
+private:
+    class CarTelemetryCallbackImpl;
+    struct SubscriptionState;
+    struct DeathNotifier;
+    struct DeathCookie;
+
+    // Death recipient callback that is called when ICarTelemetry dies.
+    // The cookie is a pointer to a DeathCookie object.
+    static void onCarTelemetryBinderDied(void* cookie);
+
+    // Called when the death recipient is unlinked, deletes the DeathCookie object.
+    static void onCarTelemetryBinderUnlinked(void* cookie);
+
+    // Runs on `mSenderThread`.
+    void sendLoop();
+
+    // Connects to ICarTelemetry if not connected yet. Returns false if it's unavailable.
+    // Runs on `mSenderThread`.
+    bool connect();
+
+    // Removes `mCallback`, drops the connection to ICarTelemetry and the subscriptions reported
+    // through it. Runs on `mSenderThread`.
+    void disconnect();
+
+    // Registers a new `mCallback` for `Options::carDataIds`. Runs on `mSenderThread`.
+    void registerCallback();
+
+    // Writes the batch to ICarTelemetry, connects to it first if needed. Returns true on success.
+    // Runs on `mSenderThread`.
+    bool writeBatch(
+            const std::vector<aidl::android::frameworks::automotive::telemetry::CarData>& batch);
+
+    // Moves the oldest buffered CarData that fits into a single write() call to `batch`.
+    void takeBatchLocked(
+            std::vector<aidl::android::frameworks::automotive::telemetry::CarData>* batch)
+            REQUIRES(mMutex);
+
+    // Puts back the CarData of a failed write() call to the front of the buffer.
+    void returnBatchLocked(
+            std::vector<aidl::android::frameworks::automotive::telemetry::CarData>* batch)
+            REQUIRES(mMutex);
+
+    // Drops the oldest buffered CarData until the buffer fits into the count limit.
+    void dropOldestDataLocked() REQUIRES(mMutex);
+
+    const Options mOptions;
+    const CarTelemetryGetter mGetCarTelemetry;
+    const std::unordered_set<int32_t> mTrackedCarDataIds;
+
+    // Shared with the callbacks, which can outlive the publisher.
+    const std::shared_ptr<SubscriptionState> mSubscriptionState;
+    // Shared with the death notification cookies, which can outlive the publisher.
+    const std::shared_ptr<DeathNotifier> mDeathNotifier;
+    ndk::ScopedAIBinder_DeathRecipient mBinderDeathRecipient;
+
+    // Accessed only by `mSenderThread`, and by the destructor after the thread is stopped.
+    std::shared_ptr<aidl::android::frameworks::automotive::telemetry::ICarTelemetry>
+            mCarTelemetry;
+    // Incremented on every disconnect(). The callbacks and the death notifications of the
+    // previous connections are ignored.
+    int64_t mConnectionGeneration = 0;
+    // Death notification cookie of `mCarTelemetry`, owned by `mBinderDeathRecipient`.
+    DeathCookie* mDeathCookie = nullptr;
+    // Callback of the current connection, set when its registration was tried.
+    std::shared_ptr<CarTelemetryCallbackImpl> mCallback;
+
+    mutable std::mutex mMutex;
+    // Notifies the sender thread about new data, flush() and stopping.
+    std::condition_variable mSenderCondition;
+    // Notifies flush() about sent data.
+    std::condition_variable mFlushCondition;
+
+    std::deque<aidl::android::frameworks::automotive::telemetry::CarData> mBufferedData
+            GUARDED_BY(mMutex);
+    int32_t mBufferedDataSizeBytes GUARDED_BY(mMutex) = 0;
+    // Number of CarData taken by the sender thread and not yet written.
+    int32_t mSendingDataCount GUARDED_BY(mMutex) = 0;
+    // Number of flush() calls waiting for the buffered data to be sent.
+    int32_t mFlushRequestCount GUARDED_BY(mMutex) = 0;
+    // Dropped CarData count that is not logged yet.
+    int64_t mUnreportedDroppedDataCount GUARDED_BY(mMutex) = 0;
+    bool mStopping GUARDED_BY(mMutex) = false;
+    // Set to the connection generation of `mCarTelemetry` when its binder dies.
+    std::optional<int64_t> mDeadConnectionGeneration GUARDED_BY(mMutex);
+    Stats mStats GUARDED_BY(mMutex);
+
+    // Declared last, so it starts after all the other members are initialized.
+    std::thread mSenderThread;
+};
+
+}  // namespace telemetry
+}  // namespace automotive
+}  // namespace android
+
+#endif  // CPP_TELEMETRY_PUBLISHER_INCLUDE_TELEMETRYPUBLISHER_H_
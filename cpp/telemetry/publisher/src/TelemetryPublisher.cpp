@@ -0,0 +1,390 @@
+/*
+ * Copyright (c) 2024, The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+#include "TelemetryPublisher.h"
+
+#include <aidl/android/frameworks/automotive/telemetry/BnCarTelemetryCallback.h>
+#include <aidl/android/frameworks/automotive/telemetry/CallbackConfig.h>
+#include <android-base/logging.h>
+#include <android/binder_manager.h>
+
+#include <string>
+#include <utility>
+
+namespace android {
+namespace automotive {
+namespace telemetry {
+
+namespace {
+
+using ::aidl::android::frameworks::automotive::telemetry::BnCarTelemetryCallback;
+using ::aidl::android::frameworks::automotive::telemetry::CallbackConfig;
+using ::aidl::android::frameworks::automotive::telemetry::CarData;
+using ::aidl::android::frameworks::automotive::telemetry::ICarTelemetry;
+
+std::shared_ptr<ICarTelemetry> getDefaultCarTelemetry() {
+    const std::string instance = std::string(ICarTelemetry::descriptor) + "/default";
+    // Doesn't wait for the service, the sender thread tries again later.
+    return ICarTelemetry::fromBinder(
+            ndk::SpAIBinder(::AServiceManager_checkService(instance.c_str())));
+}
+
+}  // namespace
+
+struct TelemetryPublisher::SubscriptionState {
+    std::mutex mutex;
+    // Connection generation whose callback reports the subscriptions.
+    int64_t connectionGeneration GUARDED_BY(mutex) = 0;
+    // False until cartelemetryd reports the subscriptions, all CarData is treated as subscribed
+    // until then.
+    bool isKnown GUARDED_BY(mutex) = false;
+    std::unordered_set<int32_t> subscribedIds GUARDED_BY(mutex);
+};
+
+// Forwards the death notifications to the publisher while it exists.
+struct TelemetryPublisher::DeathNotifier {
+    explicit DeathNotifier(TelemetryPublisher* publisher) : publisher(publisher) {}
+
+    std::mutex mutex;
+    // Cleared by the publisher destructor.
+    TelemetryPublisher* publisher GUARDED_BY(mutex);
+};
+
+// Owned by the death recipient, which deletes it once the binder is unlinked.
+struct TelemetryPublisher::DeathCookie {
+    std::shared_ptr<DeathNotifier> notifier;
+    int64_t connectionGeneration;
+};
+
+// Receives the subscribed CarData IDs from cartelemetryd for a single connection.
+class TelemetryPublisher::CarTelemetryCallbackImpl : public BnCarTelemetryCallback {
+public:
+    CarTelemetryCallbackImpl(std::shared_ptr<SubscriptionState> state,
+                             int64_t connectionGeneration) :
+          mState(std::move(state)), mConnectionGeneration(connectionGeneration) {}
+
+    ndk::ScopedAStatus onChange(const std::vector<int32_t>& carDataIds) override {
+        const std::scoped_lock<std::mutex> lock(mState->mutex);
+        // onChange() is oneway, the calls made before a reconnect can arrive after it.
+        if (mState->connectionGeneration != mConnectionGeneration) {
+            return ndk::ScopedAStatus::ok();
+        }
+        mState->subscribedIds = std::unordered_set<int32_t>(carDataIds.begin(), carDataIds.end());
+        mState->isKnown = true;
+        return ndk::ScopedAStatus::ok();
+    }
+
+private:
+    const std::shared_ptr<SubscriptionState> mState;
+    const int64_t mConnectionGeneration;
+};
+
+TelemetryPublisher::TelemetryPublisher(const Options& options) :
+      TelemetryPublisher(options, getDefaultCarTelemetry) {}
+
+TelemetryPublisher::TelemetryPublisher(const Options& options,
+                                       CarTelemetryGetter getCarTelemetry) :
+      mOptions(options),
+      mGetCarTelemetry(std::move(getCarTelemetry)),
+      mTrackedCarDataIds(options.carDataIds.begin(), options.carDataIds.end()),
+      mSubscriptionState(std::make_shared<SubscriptionState>()),
+      mDeathNotifier(std::make_shared<DeathNotifier>(this)),
+      mBinderDeathRecipient([]() {
+          AIBinder_DeathRecipient* recipient =
+                  ::AIBinder_DeathRecipient_new(TelemetryPublisher::onCarTelemetryBinderDied);
+          ::AIBinder_DeathRecipient_setOnUnlinked(recipient,
+                                                  TelemetryPublisher::onCarTelemetryBinderUnlinked);
+          return recipient;
+      }()),
+      mSenderThread(&TelemetryPublisher::sendLoop, this) {}
+
+TelemetryPublisher::~TelemetryPublisher() {
+    {
+        const std::scoped_lock<std::mutex> lock(mMutex);
+        mStopping = true;
+    }
+    mSenderCondition.notify_all();
+    mSenderThread.join();
+    {
+        // The death notifications that are still in flight don't reach the publisher anymore.
+        const std::scoped_lock<std::mutex> lock(mDeathNotifier->mutex);
+        mDeathNotifier->publisher = nullptr;
+    }
+    disconnect();
+}
+
+bool TelemetryPublisher::publish(int32_t id, std::vector<uint8_t>&& content) {
+    if (content.size() > kMaxDataSizePerWrite) {
+        LOG(WARNING) << __func__ << ": CarData with ID=" << id << " has size " << content.size()
+                     << ", which is larger than allowed " << kMaxDataSizePerWrite;
+        const std::scoped_lock<std::mutex> lock(mMutex);
+        mStats.rejectedDataCount += 1;
+        return false;
+    }
+    if (!isSubscribed(id)) {
+        const std::scoped_lock<std::mutex> lock(mMutex);
+        mStats.unsubscribedDataCount += 1;
+        return false;
+    }
+    CarData data;
+    data.id = id;
+    data.content = std::move(content);
+    bool shouldWakeSender = false;
+    {
+        const std::scoped_lock<std::mutex> lock(mMutex);
+        mBufferedDataSizeBytes += data.content.size();
+        mBufferedData.push_back(std::move(data));
+        mStats.publishedDataCount += 1;
+        dropOldestDataLocked();
+        // The sender thread waits either for the first CarData or for a full batch, don't wake it
+        // up on every call.
+        shouldWakeSender =
+                mBufferedData.size() == 1 || mBufferedDataSizeBytes >= kMaxDataSizePerWrite;
+    }
+    if (shouldWakeSender) {
+        mSenderCondition.notify_one();
+    }
+    return true;
+}
+
+bool TelemetryPublisher::isSubscribed(int32_t id) const {
+    if (mTrackedCarDataIds.find(id) == mTrackedCarDataIds.end()) {
+        return true;
+    }
+    const std::scoped_lock<std::mutex> lock(mSubscriptionState->mutex);
+    return !mSubscriptionState->isKnown ||
+            mSubscriptionState->subscribedIds.find(id) != mSubscriptionState->subscribedIds.end();
+}
+
+bool TelemetryPublisher::flush(std::chrono::milliseconds timeout) {
+    std::unique_lock<std::mutex> lock(mMutex);
+    mFlushRequestCount += 1;
+    mSenderCondition.notify_one();
+    bool isFlushed = mFlushCondition.wait_for(lock, timeout, [this]() REQUIRES(mMutex) {
+        return mBufferedData.empty() && mSendingDataCount == 0;
+    });
+    mFlushRequestCount -= 1;
+    return isFlushed;
+}
+
+TelemetryPublisher::Stats TelemetryPublisher::getStats() const {
+    const std::scoped_lock<std::mutex> lock(mMutex);
+    return mStats;
+}
+
+// static
+void TelemetryPublisher::onCarTelemetryBinderDied(void* cookie) {
+    auto deathCookie = static_cast<DeathCookie*>(cookie);
+    const std::scoped_lock<std::mutex> notifierLock(deathCookie->notifier->mutex);
+    TelemetryPublisher* thiz = deathCookie->notifier->publisher;
+    if (thiz == nullptr) {
+        return;
+    }
+    LOG(WARNING) << "ICarTelemetry service died, reconnecting";
+    {
+        const std::scoped_lock<std::mutex> lock(thiz->mMutex);
+        thiz->mDeadConnectionGeneration = deathCookie->connectionGeneration;
+    }
+    thiz->mSenderCondition.notify_one();
+}
+
+// static
+void TelemetryPublisher::onCarTelemetryBinderUnlinked(void* cookie) {
+    delete static_cast<DeathCookie*>(cookie);
+}
+
+void TelemetryPublisher::sendLoop() {
+    std::unique_lock<std::mutex> lock(mMutex);
+    while (true) {
+        // The callback is registered right away, as the publisher doesn't publish unsubscribed
+        // CarData and might never have data to send otherwise.
+        mSenderCondition.wait(lock, [this]() REQUIRES(mMutex) {
+            return mStopping || mDeadConnectionGeneration.has_value() || !mBufferedData.empty() ||
+                    (!mTrackedCarDataIds.empty() && mCallback == nullptr);
+        });
+        if (mStopping) {
+            return;
+        }
+        if (mDeadConnectionGeneration.has_value()) {
+            // The death of a connection that was already dropped is ignored.
+            bool isCurrentConnection = *mDeadConnectionGeneration == mConnectionGeneration;
+            mDeadConnectionGeneration.reset();
+            if (isCurrentConnection) {
+                lock.unlock();
+                disconnect();
+                lock.lock();
+            }
+            continue;
+        }
+        if (!mTrackedCarDataIds.empty() && mCallback == nullptr) {
+            lock.unlock();
+            bool isConnected = connect();
+            if (isConnected) {
+                registerCallback();
+            }
+            lock.lock();
+            if (!isConnected) {
+                mSenderCondition.wait_for(lock, mOptions.reconnectDelay,
+                                          [this]() REQUIRES(mMutex) { return mStopping; });
+            }
+            continue;
+        }
+        // Waits for more CarData to send them in a single write() call.
+        mSenderCondition.wait_for(lock, mOptions.batchDelay, [this]() REQUIRES(mMutex) {
+            return mStopping || mFlushRequestCount > 0 ||
+                    mBufferedDataSizeBytes >= kMaxDataSizePerWrite;
+        });
+        if (mStopping) {
+            return;
+        }
+        std::vector<CarData> batch;
+        takeBatchLocked(&batch);
+
+        lock.unlock();
+        bool isWritten = writeBatch(batch);
+        lock.lock();
+
+        if (!isWritten) {
+            mStats.failedSendCount += 1;
+            returnBatchLocked(&batch);
+            mSenderCondition.wait_for(lock, mOptions.reconnectDelay,
+                                      [this]() REQUIRES(mMutex) { return mStopping; });
+            continue;
+        }
+        mSendingDataCount = 0;
+        mStats.sentDataCount += batch.size();
+        if (mUnreportedDroppedDataCount > 0) {
+            LOG(WARNING) << "Dropped " << mUnreportedDroppedDataCount
+                         << " CarData while ICarTelemetry was not accepting data";
+            mUnreportedDroppedDataCount = 0;
+        }
+        mFlushCondition.notify_all();
+    }
+}
+
+bool TelemetryPublisher::writeBatch(const std::vector<CarData>& batch) {
+    if (!connect()) {
+        return false;
+    }
+    ndk::ScopedAStatus status = mCarTelemetry->write(batch);
+    if (!status.isOk()) {
+        LOG(WARNING) << __func__ << ": Failed to write data to ICarTelemetry, reconnecting: "
+                     << status.getMessage();
+        // The service might have died, connect to it again before the next write.
+        disconnect();
+        return false;
+    }
+    return true;
+}
+
+bool TelemetryPublisher::connect() {
+    if (mCarTelemetry != nullptr) {
+        return true;
+    }
+    mCarTelemetry = mGetCarTelemetry();
+    if (mCarTelemetry == nullptr) {
+        LOG(DEBUG) << __func__ << ": ICarTelemetry is not ready";
+        return false;
+    }
+    // The death recipient deletes the cookie once unlinked, also when linking fails.
+    mDeathCookie = new DeathCookie{.notifier = mDeathNotifier,
+                                   .connectionGeneration = mConnectionGeneration};
+    auto status = ndk::ScopedAStatus::fromStatus(
+            ::AIBinder_linkToDeath(mCarTelemetry->asBinder().get(), mBinderDeathRecipient.get(),
+                                   mDeathCookie));
+    if (!status.isOk()) {
+        // Local binders don't support death notifications, failed writes still reconnect.
+        LOG(DEBUG) << __func__ << ": Failed to linkToDeath, continuing anyway: "
+                   << status.getMessage();
+    }
+    return true;
+}
+
+void TelemetryPublisher::disconnect() {
+    if (mCarTelemetry != nullptr) {
+        if (mCallback != nullptr) {
+            // cartelemetryd keeps the callback while it's alive and rejects adding it again.
+            // Fails if cartelemetryd died, its callbacks are gone then anyway.
+            mCarTelemetry->removeCallback(mCallback);
+        }
+        // Deletes the cookie, unless it was already deleted when the binder died or linking
+        // failed. The cookie is only compared then.
+        ::AIBinder_unlinkToDeath(mCarTelemetry->asBinder().get(), mBinderDeathRecipient.get(),
+                                 mDeathCookie);
+        mCarTelemetry = nullptr;
+        mDeathCookie = nullptr;
+    }
+    mCallback = nullptr;
+    mConnectionGeneration += 1;
+    // The subscriptions are unknown until the callback is registered again.
+    const std::scoped_lock<std::mutex> lock(mSubscriptionState->mutex);
+    mSubscriptionState->connectionGeneration = mConnectionGeneration;
+    mSubscriptionState->isKnown = false;
+    mSubscriptionState->subscribedIds.clear();
+}
+
+void TelemetryPublisher::registerCallback() {
+    mCallback = ndk::SharedRefBase::make<CarTelemetryCallbackImpl>(mSubscriptionState,
+                                                                   mConnectionGeneration);
+    CallbackConfig config;
+    config.carDataIds = mOptions.carDataIds;
+    // cartelemetryd reports the currently subscribed IDs to the new callback right away.
+    ndk::ScopedAStatus status = mCarTelemetry->addCallback(config, mCallback);
+    if (!status.isOk()) {
+        LOG(WARNING) << __func__ << ": Failed to add ICarTelemetryCallback, publishing all "
+                     << "CarData: " << status.getMessage();
+    }
+}
+
+void TelemetryPublisher::takeBatchLocked(std::vector<CarData>* batch) {
+    int32_t batchSizeBytes = 0;
+    while (!mBufferedData.empty() &&
+           batchSizeBytes + mBufferedData.front().content.size() <= kMaxDataSizePerWrite) {
+        batchSizeBytes += mBufferedData.front().content.size();
+        batch->push_back(std::move(mBufferedData.front()));
+        mBufferedData.pop_front();
+    }
+    mBufferedDataSizeBytes -= batchSizeBytes;
+    mSendingDataCount = batch->size();
+}
+
+void TelemetryPublisher::returnBatchLocked(std::vector<CarData>* batch) {
+    for (auto it = batch->rbegin(); it != batch->rend(); ++it) {
+        mBufferedDataSizeBytes += it->content.size();
+        mBufferedData.push_front(std::move(*it));
+    }
+    batch->clear();
+    mSendingDataCount = 0;
+    // The data published while sending could have filled the buffer.
+    dropOldestDataLocked();
+}
+
+void TelemetryPublisher::dropOldestDataLocked() {
+    while (mBufferedData.size() > static_cast<size_t>(mOptions.maxBufferedDataCount)) {
+        if (mUnreportedDroppedDataCount == 0) {
+            LOG(WARNING) << "CarData buffer is full, dropping the oldest CarData";
+        }
+        mBufferedDataSizeBytes -= mBufferedData.front().content.size();
+        mBufferedData.pop_front();
+        mStats.droppedDataCount += 1;
+        mUnreportedDroppedDataCount += 1;
+    }
+}
+
+}  // namespace telemetry
+}  // namespace automotive
+}  // namespace android
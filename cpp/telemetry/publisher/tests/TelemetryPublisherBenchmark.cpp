@@ -0,0 +1,119 @@
+/*
+ * Copyright (c) 2024, The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+#include "TelemetryPublisher.h"
+
+#include <aidl/android/frameworks/automotive/telemetry/BnCarTelemetry.h>
+#include <aidl/android/frameworks/automotive/telemetry/CarData.h>
+#include <benchmark/benchmark.h>
+
+#include <chrono>
+#include <memory>
+#include <thread>
+#include <vector>
+
+namespace android {
+namespace automotive {
+namespace telemetry {
+
+namespace {
+
+using ::aidl::android::frameworks::automotive::telemetry::BnCarTelemetry;
+using ::aidl::android::frameworks::automotive::telemetry::CallbackConfig;
+using ::aidl::android::frameworks::automotive::telemetry::CarData;
+using ::aidl::android::frameworks::automotive::telemetry::ICarTelemetry;
+using ::aidl::android::frameworks::automotive::telemetry::ICarTelemetryCallback;
+using ::ndk::ScopedAStatus;
+
+// Size of a serialized EvsFirstFrameLatency.
+constexpr int32_t kPayloadSizeBytes = 16;
+// Roughly the cost of a small binder transaction to cartelemetryd.
+constexpr std::chrono::microseconds kWriteLatency = std::chrono::microseconds(200);
+
+// Accepts the written data after kWriteLatency. Reports no subscribed CarData IDs.
+class SlowCarTelemetry : public BnCarTelemetry {
+public:
+    ScopedAStatus write(const std::vector<CarData>& dataList) override {
+        std::this_thread::sleep_for(kWriteLatency);
+        return ScopedAStatus::ok();
+    }
+
+    ScopedAStatus addCallback(const CallbackConfig& config,
+                              const std::shared_ptr<ICarTelemetryCallback>& callback) override {
+        return callback->onChange({});
+    }
+
+    ScopedAStatus removeCallback(const std::shared_ptr<ICarTelemetryCallback>& callback) override {
+        return ScopedAStatus::ok();
+    }
+};
+
+// The previous EvsStats behavior: a write() call on the caller thread for every CarData.
+void BM_SynchronousWrite(benchmark::State& state) {
+    std::shared_ptr<ICarTelemetry> carTelemetry = ndk::SharedRefBase::make<SlowCarTelemetry>();
+    for (auto _ : state) {
+        CarData data;
+        data.id = 1;
+        data.content = std::vector<uint8_t>(kPayloadSizeBytes);
+        benchmark::DoNotOptimize(carTelemetry->write({data}));
+    }
+    state.SetItemsProcessed(state.iterations());
+}
+
+void BM_Publish(benchmark::State& state) {
+    std::shared_ptr<ICarTelemetry> carTelemetry = ndk::SharedRefBase::make<SlowCarTelemetry>();
+    TelemetryPublisher::Options options;
+    options.maxBufferedDataCount = 1000;
+    TelemetryPublisher publisher(options, [&]() { return carTelemetry; });
+    for (auto _ : state) {
+        benchmark::DoNotOptimize(publisher.publish(1, std::vector<uint8_t>(kPayloadSizeBytes)));
+    }
+    state.SetItemsProcessed(state.iterations());
+    TelemetryPublisher::Stats stats = publisher.getStats();
+    state.counters["dropped"] = stats.droppedDataCount;
+}
+
+// Publishing CarData that has no subscribers. The publisher doesn't buffer or send it.
+void BM_PublishUnsubscribed(benchmark::State& state) {
+    std::shared_ptr<ICarTelemetry> carTelemetry = ndk::SharedRefBase::make<SlowCarTelemetry>();
+    TelemetryPublisher::Options options;
+    options.carDataIds = {1};
+    TelemetryPublisher publisher(options, [&]() { return carTelemetry; });
+    while (publisher.isSubscribed(1)) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+    for (auto _ : state) {
+        if (publisher.isSubscribed(1)) {
+            benchmark::DoNotOptimize(
+                    publisher.publish(1, std::vector<uint8_t>(kPayloadSizeBytes)));
+        }
+    }
+    state.SetItemsProcessed(state.iterations());
+    state.counters["sent"] = publisher.getStats().sentDataCount;
+}
+
+}  // namespace
+
+BENCHMARK(BM_SynchronousWrite);
+BENCHMARK(BM_Publish);
+BENCHMARK(BM_PublishUnsubscribed);
+
+}  // namespace telemetry
+}  // namespace automotive
+}  // namespace android
+
+BENCHMARK_MAIN();
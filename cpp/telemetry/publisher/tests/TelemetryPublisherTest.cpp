@@ -0,0 +1,328 @@
+/*
+ * Copyright (c) 2024, The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+#include "TelemetryPublisher.h"
+
+#include <aidl/android/frameworks/automotive/telemetry/BnCarTelemetry.h>
+#include <aidl/android/frameworks/automotive/telemetry/CarData.h>
+#include <gmock/gmock.h>
+#include <gtest/gtest.h>
+
+#include <atomic>
+#include <chrono>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace android {
+namespace automotive {
+namespace telemetry {
+
+using ::aidl::android::frameworks::automotive::telemetry::BnCarTelemetry;
+using ::aidl::android::frameworks::automotive::telemetry::CallbackConfig;
+using ::aidl::android::frameworks::automotive::telemetry::CarData;
+using ::aidl::android::frameworks::automotive::telemetry::ICarTelemetry;
+using ::aidl::android::frameworks::automotive::telemetry::ICarTelemetryCallback;
+using ::ndk::ScopedAStatus;
+using ::testing::ElementsAre;
+using ::testing::IsEmpty;
+
+namespace {
+
+constexpr std::chrono::milliseconds kFlushTimeout = std::chrono::seconds(5);
+
+// Waits until the publisher learns that the ID has no subscribers.
+bool waitUntilUnsubscribed(const TelemetryPublisher& publisher, int32_t id) {
+    for (int i = 0; i < 500 && publisher.isSubscribed(id); i++) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    }
+    return !publisher.isSubscribed(id);
+}
+
+// Records the written CarData IDs, fails the writes while `isFailing` is set. Reports the
+// subscribed IDs to the callback and rejects adding the same callback twice like cartelemetryd.
+class FakeCarTelemetry : public BnCarTelemetry {
+public:
+    ScopedAStatus write(const std::vector<CarData>& dataList) override {
+        const std::scoped_lock<std::mutex> lock(mMutex);
+        if (isFailing) {
+            return ScopedAStatus::fromServiceSpecificErrorWithMessage(EX_TRANSACTION_FAILED,
+                                                                      "failing");
+        }
+        int32_t sizeBytes = 0;
+        for (const auto& data : dataList) {
+            mIds.push_back(data.id);
+            sizeBytes += data.content.size();
+        }
+        mWriteSizesBytes.push_back(sizeBytes);
+        return ScopedAStatus::ok();
+    }
+
+    ScopedAStatus addCallback(const CallbackConfig& config,
+                              const std::shared_ptr<ICarTelemetryCallback>& callback) override {
+        std::vector<int32_t> subscribedIds;
+        {
+            const std::scoped_lock<std::mutex> lock(mMutex);
+            if (mCallback == callback) {
+                return ScopedAStatus::fromServiceSpecificErrorWithMessage(EX_ILLEGAL_ARGUMENT,
+                                                                          "already exists");
+            }
+            mCallback = callback;
+            mAddCallbackCount += 1;
+            subscribedIds = mSubscribedIds;
+        }
+        return callback->onChange(subscribedIds);
+    }
+
+    ScopedAStatus removeCallback(const std::shared_ptr<ICarTelemetryCallback>& callback) override {
+        const std::scoped_lock<std::mutex> lock(mMutex);
+        mCallback = nullptr;
+        return ScopedAStatus::ok();
+    }
+
+    void setSubscribedIds(const std::vector<int32_t>& ids) {
+        std::shared_ptr<ICarTelemetryCallback> callback;
+        {
+            const std::scoped_lock<std::mutex> lock(mMutex);
+            mSubscribedIds = ids;
+            callback = mCallback;
+        }
+        if (callback != nullptr) {
+            callback->onChange(ids);
+        }
+    }
+
+    bool hasCallback() {
+        const std::scoped_lock<std::mutex> lock(mMutex);
+        return mCallback != nullptr;
+    }
+
+    std::shared_ptr<ICarTelemetryCallback> getCallback() {
+        const std::scoped_lock<std::mutex> lock(mMutex);
+        return mCallback;
+    }
+
+    int32_t getAddCallbackCount() {
+        const std::scoped_lock<std::mutex> lock(mMutex);
+        return mAddCallbackCount;
+    }
+
+    std::vector<int32_t> getIds() {
+        const std::scoped_lock<std::mutex> lock(mMutex);
+        return mIds;
+    }
+
+    std::vector<int32_t> getWriteSizesBytes() {
+        const std::scoped_lock<std::mutex> lock(mMutex);
+        return mWriteSizesBytes;
+    }
+
+    std::atomic<bool> isFailing = false;
+
+private:
+    std::mutex mMutex;
+    std::vector<int32_t> mIds;
+    std::vector<int32_t> mWriteSizesBytes;
+    std::vector<int32_t> mSubscribedIds;
+    std::shared_ptr<ICarTelemetryCallback> mCallback;
+    int32_t mAddCallbackCount = 0;
+};
+
+}  // namespace
+
+class TelemetryPublisherTest : public ::testing::Test {
+protected:
+    TelemetryPublisherTest() :
+          mCarTelemetry(ndk::SharedRefBase::make<FakeCarTelemetry>()),
+          mOptions({.maxBufferedDataCount = 3,
+                    .batchDelay = std::chrono::milliseconds(10),
+                    .reconnectDelay = std::chrono::milliseconds(10)}) {}
+
+    // Returns `mCarTelemetry` while `mIsCarTelemetryAvailable` is set.
+    TelemetryPublisher::CarTelemetryGetter getCarTelemetryGetter() {
+        return [this]() -> std::shared_ptr<ICarTelemetry> {
+            return mIsCarTelemetryAvailable ? mCarTelemetry : nullptr;
+        };
+    }
+
+    std::shared_ptr<FakeCarTelemetry> mCarTelemetry;
+    std::atomic<bool> mIsCarTelemetryAvailable = true;
+    TelemetryPublisher::Options mOptions;
+};
+
+TEST_F(TelemetryPublisherTest, PublishSendsDataInSingleWrite) {
+    TelemetryPublisher publisher(mOptions, getCarTelemetryGetter());
+
+    EXPECT_TRUE(publisher.publish(1, {1, 2}));
+    EXPECT_TRUE(publisher.publish(2, {3}));
+
+    ASSERT_TRUE(publisher.flush(kFlushTimeout));
+    EXPECT_THAT(mCarTelemetry->getIds(), ElementsAre(1, 2));
+    EXPECT_THAT(mCarTelemetry->getWriteSizesBytes(), ElementsAre(3));
+    EXPECT_EQ(publisher.getStats().sentDataCount, 2);
+}
+
+TEST_F(TelemetryPublisherTest, PublishSplitsBatchesByMaxDataSizePerWrite) {
+    mOptions.maxBufferedDataCount = 10;
+    TelemetryPublisher publisher(mOptions, getCarTelemetryGetter());
+    mIsCarTelemetryAvailable = false;
+    const int32_t size = TelemetryPublisher::kMaxDataSizePerWrite / 2;
+
+    for (int32_t id = 1; id <= 5; id++) {
+        EXPECT_TRUE(publisher.publish(id, std::vector<uint8_t>(size)));
+    }
+    mIsCarTelemetryAvailable = true;
+
+    ASSERT_TRUE(publisher.flush(kFlushTimeout));
+    EXPECT_THAT(mCarTelemetry->getIds(), ElementsAre(1, 2, 3, 4, 5));
+    EXPECT_THAT(mCarTelemetry->getWriteSizesBytes(), ElementsAre(2 * size, 2 * size, size));
+}
+
+TEST_F(TelemetryPublisherTest, PublishRejectsTooLargeData) {
+    TelemetryPublisher publisher(mOptions, getCarTelemetryGetter());
+
+    EXPECT_FALSE(publisher.publish(1,
+                                   std::vector<uint8_t>(TelemetryPublisher::kMaxDataSizePerWrite +
+                                                        1)));
+
+    ASSERT_TRUE(publisher.flush(kFlushTimeout));
+    EXPECT_THAT(mCarTelemetry->getIds(), IsEmpty());
+    EXPECT_EQ(publisher.getStats().rejectedDataCount, 1);
+    EXPECT_EQ(publisher.getStats().publishedDataCount, 0);
+}
+
+TEST_F(TelemetryPublisherTest, PublishDropsOldestDataWhileUnavailable) {
+    mIsCarTelemetryAvailable = false;
+    TelemetryPublisher publisher(mOptions, getCarTelemetryGetter());
+
+    for (int32_t id = 1; id <= 5; id++) {
+        EXPECT_TRUE(publisher.publish(id, {1}));
+    }
+
+    EXPECT_FALSE(publisher.flush(std::chrono::milliseconds(50)));
+    mIsCarTelemetryAvailable = true;
+    ASSERT_TRUE(publisher.flush(kFlushTimeout));
+    EXPECT_THAT(mCarTelemetry->getIds(), ElementsAre(3, 4, 5));
+    TelemetryPublisher::Stats stats = publisher.getStats();
+    EXPECT_EQ(stats.publishedDataCount, 5);
+    EXPECT_EQ(stats.droppedDataCount, 2);
+    EXPECT_EQ(stats.sentDataCount, 3);
+    EXPECT_GT(stats.failedSendCount, 0);
+}
+
+TEST_F(TelemetryPublisherTest, PublishReconnectsAfterFailedWrite) {
+    std::shared_ptr<FakeCarTelemetry> failingCarTelemetry =
+            ndk::SharedRefBase::make<FakeCarTelemetry>();
+    failingCarTelemetry->isFailing = true;
+    std::atomic<int32_t> connectCount = 0;
+    TelemetryPublisher publisher(mOptions, [&]() -> std::shared_ptr<ICarTelemetry> {
+        return connectCount++ == 0 ? failingCarTelemetry : mCarTelemetry;
+    });
+
+    EXPECT_TRUE(publisher.publish(1, {1}));
+
+    ASSERT_TRUE(publisher.flush(kFlushTimeout));
+    EXPECT_THAT(mCarTelemetry->getIds(), ElementsAre(1));
+    EXPECT_EQ(connectCount, 2);
+    EXPECT_EQ(publisher.getStats().failedSendCount, 1);
+}
+
+TEST_F(TelemetryPublisherTest, PublishSkipsUnsubscribedData) {
+    mCarTelemetry->setSubscribedIds({1});
+    mOptions.carDataIds = {1, 2};
+    TelemetryPublisher publisher(mOptions, getCarTelemetryGetter());
+    ASSERT_TRUE(waitUntilUnsubscribed(publisher, 2));
+
+    EXPECT_TRUE(publisher.publish(1, {1}));
+    EXPECT_FALSE(publisher.publish(2, {1}));
+    // Not tracked by the publisher.
+    EXPECT_TRUE(publisher.publish(3, {1}));
+
+    ASSERT_TRUE(publisher.flush(kFlushTimeout));
+    EXPECT_THAT(mCarTelemetry->getIds(), ElementsAre(1, 3));
+    EXPECT_EQ(publisher.getStats().unsubscribedDataCount, 1);
+}
+
+TEST_F(TelemetryPublisherTest, IsSubscribedFollowsCallback) {
+    mOptions.carDataIds = {1, 2};
+    TelemetryPublisher publisher(mOptions, getCarTelemetryGetter());
+    ASSERT_TRUE(waitUntilUnsubscribed(publisher, 1));
+
+    mCarTelemetry->setSubscribedIds({1});
+
+    EXPECT_TRUE(publisher.isSubscribed(1));
+    EXPECT_FALSE(publisher.isSubscribed(2));
+}
+
+TEST_F(TelemetryPublisherTest, IsSubscribedUntilSubscriptionsAreReported) {
+    mIsCarTelemetryAvailable = false;
+    mOptions.carDataIds = {1};
+    TelemetryPublisher publisher(mOptions, getCarTelemetryGetter());
+
+    EXPECT_TRUE(publisher.isSubscribed(1));
+    EXPECT_TRUE(publisher.publish(1, {1}));
+}
+
+TEST_F(TelemetryPublisherTest, ReregistersCallbackAfterFailedWrite) {
+    mOptions.carDataIds = {1};
+    TelemetryPublisher publisher(mOptions, getCarTelemetryGetter());
+    ASSERT_TRUE(waitUntilUnsubscribed(publisher, 1));
+    mCarTelemetry->isFailing = true;
+
+    // Not tracked by the publisher, the failed write makes it reconnect.
+    EXPECT_TRUE(publisher.publish(2, {1}));
+    EXPECT_FALSE(publisher.flush(std::chrono::milliseconds(50)));
+    mCarTelemetry->isFailing = false;
+
+    ASSERT_TRUE(publisher.flush(kFlushTimeout));
+    ASSERT_TRUE(waitUntilUnsubscribed(publisher, 1));
+    EXPECT_GT(mCarTelemetry->getAddCallbackCount(), 1);
+}
+
+TEST_F(TelemetryPublisherTest, IgnoresCallbackOfPreviousConnection) {
+    mOptions.carDataIds = {1};
+    TelemetryPublisher publisher(mOptions, getCarTelemetryGetter());
+    ASSERT_TRUE(waitUntilUnsubscribed(publisher, 1));
+    std::shared_ptr<ICarTelemetryCallback> previousCallback = mCarTelemetry->getCallback();
+    mCarTelemetry->isFailing = true;
+    EXPECT_TRUE(publisher.publish(2, {1}));
+    EXPECT_FALSE(publisher.flush(std::chrono::milliseconds(50)));
+    mCarTelemetry->isFailing = false;
+    ASSERT_TRUE(publisher.flush(kFlushTimeout));
+    ASSERT_TRUE(waitUntilUnsubscribed(publisher, 1));
+
+    // A late onChange() call that was made before the reconnect.
+    previousCallback->onChange({1});
+
+    EXPECT_FALSE(publisher.isSubscribed(1));
+}
+
+TEST_F(TelemetryPublisherTest, DestructorRemovesCallback) {
+    mOptions.carDataIds = {1};
+    {
+        TelemetryPublisher publisher(mOptions, getCarTelemetryGetter());
+        ASSERT_TRUE(waitUntilUnsubscribed(publisher, 1));
+        EXPECT_TRUE(mCarTelemetry->hasCallback());
+    }
+
+    EXPECT_FALSE(mCarTelemetry->hasCallback());
+}
+
+}  // namespace telemetry
+}  // namespace automotive
+}  // namespace android
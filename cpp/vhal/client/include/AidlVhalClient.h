@@ -18,6 +18,7 @@
 #define CPP_VHAL_CLIENT_INCLUDE_AIDLVHALCLIENT_H_
 
 #include "IVhalClient.h"
+#include "PendingRequestTimer.h"
 
 #include <aidl/android/hardware/automotive/vehicle/BnVehicleCallback.h>
 #include <aidl/android/hardware/automotive/vehicle/IVehicle.h>
@@ -25,14 +26,16 @@
 #include <android/binder_auto_utils.h>
 #include <android/binder_ibinder.h>
 
-#include <PendingRequestPool.h>
 #include <VehicleUtils.h>
 
 #include <atomic>
+#include <condition_variable>  // NOLINT
 #include <memory>
 #include <mutex>  // NOLINT
+#include <optional>
 #include <unordered_map>
 #include <unordered_set>
+#include <vector>
 
 namespace android {
 namespace frameworks {
@@ -73,9 +76,24 @@ public:
     void getValue(const IHalPropValue& requestValue,
                   std::shared_ptr<GetValueCallbackFunc> callback) override;
 
+    VhalClientFuture<std::unique_ptr<IHalPropValue>> getValueAsync(
+            const IHalPropValue& requestValue, Deadline deadline = NO_DEADLINE) override;
+
+    // Waits for the result on the caller's thread, without the future and the pending request
+    // bookkeeping of the asynchronous path.
+    VhalClientResult<std::unique_ptr<IHalPropValue>> getValueSync(
+            const IHalPropValue& requestValue) override;
+
     void setValue(const IHalPropValue& value,
                   std::shared_ptr<AidlVhalClient::SetValueCallbackFunc> callback) override;
 
+    VhalClientFuture<void> setValueAsync(const IHalPropValue& requestValue,
+                                         Deadline deadline = NO_DEADLINE) override;
+
+    // Waits for the result on the caller's thread, without the future and the pending request
+    // bookkeeping of the asynchronous path.
+    VhalClientResult<void> setValueSync(const IHalPropValue& requestValue) override;
+
     // Add the callback that would be called when VHAL binder died.
     VhalClientResult<void> addOnBinderDiedCallback(
             std::shared_ptr<OnBinderDiedCallbackFunc> callback) override;
@@ -160,17 +178,27 @@ class GetSetValueClient final :
       public aidl::android::hardware::automotive::vehicle::BnVehicleCallback {
 public:
     struct PendingGetValueRequest {
-        std::shared_ptr<AidlVhalClient::GetValueCallbackFunc> callback;
+        VhalClientPromise<std::unique_ptr<IHalPropValue>> promise;
         int32_t propId;
         int32_t areaId;
     };
 
     struct PendingSetValueRequest {
-        std::shared_ptr<AidlVhalClient::SetValueCallbackFunc> callback;
+        VhalClientPromise<void> promise;
         int32_t propId;
         int32_t areaId;
     };
 
+    // A synchronous request lives on the stack of the waiting caller until it is finished or
+    // timed-out.
+    template <class T>
+    struct SyncRequest {
+        int64_t requestId;
+        int32_t propId;
+        int32_t areaId;
+        std::optional<VhalClientResult<T>> result;
+    };
+
     GetSetValueClient(int64_t timeoutInNs,
                       std::shared_ptr<aidl::android::hardware::automotive::vehicle::IVehicle> mHal);
 
@@ -186,12 +214,20 @@ public:
     ndk::ScopedAStatus onPropertySetError(
             const aidl::android::hardware::automotive::vehicle::VehiclePropErrors& errors) override;
 
+    // {@code IVhalClient::NO_DEADLINE} selects the default timeout.
     void getValue(int64_t requestId, const IHalPropValue& requestValue,
-                  std::shared_ptr<AidlVhalClient::GetValueCallbackFunc> clientCallback,
+                  IVhalClient::Deadline deadline,
+                  VhalClientPromise<std::unique_ptr<IHalPropValue>> promise,
                   std::shared_ptr<GetSetValueClient> vhalCallback);
     void setValue(int64_t requestId, const IHalPropValue& requestValue,
-                  std::shared_ptr<AidlVhalClient::SetValueCallbackFunc> clientCallback,
+                  IVhalClient::Deadline deadline, VhalClientPromise<void> promise,
                   std::shared_ptr<GetSetValueClient> vhalCallback);
+    // Blocks until the result is returned or the default timeout expires.
+    VhalClientResult<std::unique_ptr<IHalPropValue>> getValueSync(
+            int64_t requestId, const IHalPropValue& requestValue,
+            std::shared_ptr<GetSetValueClient> vhalCallback);
+    VhalClientResult<void> setValueSync(int64_t requestId, const IHalPropValue& requestValue,
+                                        std::shared_ptr<GetSetValueClient> vhalCallback);
 
 private:
     std::mutex mLock;
@@ -199,19 +235,25 @@ private:
             GUARDED_BY(mLock);
     std::unordered_map<int64_t, std::unique_ptr<PendingSetValueRequest>> mPendingSetValueCallbacks
             GUARDED_BY(mLock);
-    std::unique_ptr<hardware::automotive::vehicle::PendingRequestPool> mPendingRequestPool;
-    std::shared_ptr<android::hardware::automotive::vehicle::PendingRequestPool::TimeoutCallbackFunc>
-            mOnGetValueTimeout;
-    std::shared_ptr<android::hardware::automotive::vehicle::PendingRequestPool::TimeoutCallbackFunc>
-            mOnSetValueTimeout;
+    // Only a few synchronous requests are outstanding at a time, so a vector is cheaper than a map.
+    std::vector<SyncRequest<std::unique_ptr<IHalPropValue>>*> mSyncGetValueRequests
+            GUARDED_BY(mLock);
+    std::vector<SyncRequest<void>*> mSyncSetValueRequests GUARDED_BY(mLock);
+    // Notified when a synchronous request is finished.
+    std::condition_variable mSyncRequestCv;
+    const int64_t mTimeoutInNs;
+    std::unique_ptr<PendingRequestTimer> mPendingRequestTimer;
+    std::shared_ptr<PendingRequestTimer::TimeoutCallbackFunc> mOnGetValueTimeout;
+    std::shared_ptr<PendingRequestTimer::TimeoutCallbackFunc> mOnSetValueTimeout;
     std::shared_ptr<aidl::android::hardware::automotive::vehicle::IVehicle> mHal;
 
     // Add a new GetValue pending request.
     void addGetValueRequest(int64_t requestId, const IHalPropValue& requestValue,
-                            std::shared_ptr<AidlVhalClient::GetValueCallbackFunc> callback);
+                            IVhalClient::Deadline deadline,
+                            VhalClientPromise<std::unique_ptr<IHalPropValue>> promise);
     // Add a new SetValue pending request.
     void addSetValueRequest(int64_t requestId, const IHalPropValue& requestValue,
-                            std::shared_ptr<AidlVhalClient::SetValueCallbackFunc> callback);
+                            IVhalClient::Deadline deadline, VhalClientPromise<void> promise);
     // Try to finish the pending GetValue request according to the requestId. If there is an
     // existing pending request, the request would be finished and returned. Otherwise, if the
     // request has already timed-out, nullptr would be returned.
@@ -226,6 +268,15 @@ private:
                                         std::unordered_map<int64_t, std::unique_ptr<T>>* callbacks)
             REQUIRES(mLock);
 
+    // Removes and returns the synchronous request, or nullptr if it is not outstanding.
+    template <class T>
+    SyncRequest<T>* takeSyncRequestLocked(int64_t requestId,
+                                          std::vector<SyncRequest<T>*>* requests) REQUIRES(mLock);
+    // Waits until |request| is finished or timed-out and returns its result.
+    template <class T>
+    VhalClientResult<T> waitForSyncRequest(SyncRequest<T>* request,
+                                           std::vector<SyncRequest<T>*>* requests);
+
     void onGetValue(const aidl::android::hardware::automotive::vehicle::GetValueResult& result);
     void onSetValue(const aidl::android::hardware::automotive::vehicle::SetValueResult& result);
 
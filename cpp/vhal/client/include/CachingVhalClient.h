@@ -0,0 +1,208 @@
+/*
+ * Copyright (c) 2024, The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef CPP_VHAL_CLIENT_INCLUDE_CACHINGVHALCLIENT_H_
+#define CPP_VHAL_CLIENT_INCLUDE_CACHINGVHALCLIENT_H_
+
+#include "IVhalClient.h"
+
+#include <android-base/thread_annotations.h>
+
+#include <functional>
+#include <memory>
+#include <mutex>  // NOLINT
+#include <string>
+#include <unordered_map>
+
+namespace android {
+namespace frameworks {
+namespace automotive {
+namespace vhal {
+
+// Statistics of the value cache.
+struct CacheStats {
+    // Number of get requests answered from the cache.
+    uint64_t hitCount = 0;
+    // Number of get requests for cacheable properties that were forwarded to VHAL.
+    uint64_t missCount = 0;
+    // Number of get requests for properties that are never cached, for example continuous
+    // properties.
+    uint64_t bypassCount = 0;
+
+    // Returns the ratio of hits to the requests for cacheable properties.
+    float getHitRate() const;
+
+    std::string toString() const;
+};
+
+// CachingVhalClient is an opt-in, read-through value cache that wraps another {@code IVhalClient}.
+//
+// Values of ON_CHANGE and STATIC properties are kept up to date by a background subscription and
+// get requests for them are answered locally. A cached ON_CHANGE value is trusted for as long as
+// its property's subscription is alive, and is invalidated when VHAL reports an error for the
+// property, when the property is set, or when VHAL dies. If the subscription failed, cached values
+// are served only within the staleness bound and the subscription is retried with an exponential
+// backoff. STATIC values never go stale. Requests for CONTINUOUS properties, and requests that
+// carry a payload, are always forwarded to VHAL. All other operations are forwarded to the wrapped
+// client.
+class CachingVhalClient final : public IVhalClient {
+public:
+    // The default staleness bound for cached ON_CHANGE values whose property isn't subscribed.
+    constexpr static int64_t DEFAULT_MAX_STALENESS_IN_MS = 1'000;
+    // The delay before retrying a failed subscription, doubled on every failure up to the max.
+    constexpr static int64_t SUBSCRIPTION_RETRY_INITIAL_DELAY_IN_MS = 1'000;
+    constexpr static int64_t SUBSCRIPTION_RETRY_MAX_DELAY_IN_MS = 60'000;
+
+    static std::shared_ptr<CachingVhalClient> create(
+            std::shared_ptr<IVhalClient> client,
+            int64_t maxStalenessInMs = DEFAULT_MAX_STALENESS_IN_MS);
+
+    // Use {@code create} instead. |getTimeNsFunc| returns the current time in nanoseconds and is
+    // only overridden by tests.
+    CachingVhalClient(std::shared_ptr<IVhalClient> client, int64_t maxStalenessInMs,
+                      std::function<int64_t()> getTimeNsFunc);
+
+    ~CachingVhalClient();
+
+    bool isAidlVhal() override;
+
+    std::unique_ptr<IHalPropValue> createHalPropValue(int32_t propId) override;
+
+    std::unique_ptr<IHalPropValue> createHalPropValue(int32_t propId, int32_t areaId) override;
+
+    void getValue(const IHalPropValue& requestValue,
+                  std::shared_ptr<GetValueCallbackFunc> callback) override;
+
+    // Returns a ready future on a cache hit. Otherwise forwards the request with |deadline|.
+    VhalClientFuture<std::unique_ptr<IHalPropValue>> getValueAsync(
+            const IHalPropValue& requestValue, Deadline deadline = NO_DEADLINE) override;
+
+    VhalClientResult<std::unique_ptr<IHalPropValue>> getValueSync(
+            const IHalPropValue& requestValue) override;
+
+    void setValue(const IHalPropValue& requestValue,
+                  std::shared_ptr<SetValueCallbackFunc> callback) override;
+
+    VhalClientFuture<void> setValueAsync(const IHalPropValue& requestValue,
+                                         Deadline deadline = NO_DEADLINE) override;
+
+    VhalClientResult<void> setValueSync(const IHalPropValue& requestValue) override;
+
+    VhalClientResult<void> addOnBinderDiedCallback(
+            std::shared_ptr<OnBinderDiedCallbackFunc> callback) override;
+
+    VhalClientResult<void> removeOnBinderDiedCallback(
+            std::shared_ptr<OnBinderDiedCallbackFunc> callback) override;
+
+    VhalClientResult<std::vector<std::unique_ptr<IHalPropConfig>>> getAllPropConfigs() override;
+
+    VhalClientResult<std::vector<std::unique_ptr<IHalPropConfig>>> getPropConfigs(
+            std::vector<int32_t> propIds) override;
+
+    std::unique_ptr<ISubscriptionClient> getSubscriptionClient(
+            std::shared_ptr<ISubscriptionCallback> callback) override;
+
+    int32_t getRemoteInterfaceVersion() override;
+
+    // Returns the cache statistics since the client was created.
+    CacheStats getCacheStats();
+
+private:
+    enum class CachePolicy {
+        // The property is never cached.
+        BYPASS,
+        // The cached value is served while the property is subscribed, or until it is older than
+        // the staleness bound otherwise.
+        ON_CHANGE,
+        // The cached value never goes stale.
+        STATIC,
+    };
+
+    enum class SubscriptionState {
+        NOT_SUBSCRIBED,
+        SUBSCRIBING,
+        SUBSCRIBED,
+        FAILED,
+    };
+
+    struct Subscription {
+        SubscriptionState state = SubscriptionState::NOT_SUBSCRIBED;
+        // Number of consecutive failed attempts.
+        int32_t failureCount = 0;
+        // Time after which a failed subscription is retried on the next miss.
+        int64_t nextRetryTimeNs = 0;
+    };
+
+    struct CacheEntry {
+        std::unique_ptr<IHalPropValue> value;
+        // Time when the value was last received from VHAL.
+        int64_t refreshTimeNs = 0;
+    };
+
+    // State shared with the subscription and binder died callbacks, which may outlive the
+    // client.
+    struct ValueCache {
+        std::mutex lock;
+        std::unordered_map<int32_t, CachePolicy> policyByPropId GUARDED_BY(lock);
+        std::unordered_map<int64_t, CacheEntry> entriesByKey GUARDED_BY(lock);
+        // Subscriptions of ON_CHANGE properties since the last binder death.
+        std::unordered_map<int32_t, Subscription> subscriptionsByPropId GUARDED_BY(lock);
+        // Incremented on every invalidation so values fetched before the invalidation are dropped.
+        uint64_t generation GUARDED_BY(lock) = 0;
+        // Incremented on every binder death so subscriptions made before the death are dropped.
+        uint64_t subscriptionGeneration GUARDED_BY(lock) = 0;
+        CacheStats stats GUARDED_BY(lock);
+
+        // Stores the value unless a newer value is already cached.
+        void storeLocked(const IHalPropValue& value, int64_t nowNs) REQUIRES(lock);
+        // Drops the cached values of the property's area.
+        void invalidateLocked(int32_t propId, int32_t areaId) REQUIRES(lock);
+        bool isSubscribedLocked(int32_t propId) REQUIRES(lock);
+        void clear();
+    };
+
+    class SubscriptionCallback;
+
+    static int64_t toKey(int32_t propId, int32_t areaId);
+
+    // Returns the cache policy for the request, looking up the property's change mode on the first
+    // request for the property.
+    CachePolicy getCachePolicy(const IHalPropValue& requestValue);
+    // Returns a copy of the cached value if it is fresh, otherwise nullptr. Updates the stats.
+    // Sets |shouldSubscribe| when the property isn't subscribed and is due for an attempt.
+    std::unique_ptr<IHalPropValue> lookUp(const IHalPropValue& requestValue, CachePolicy policy,
+                                          uint64_t* generation, bool* shouldSubscribe);
+    // Subscribes to the ON_CHANGE property if it wasn't subscribed yet, or retries a failed
+    // subscription once its backoff has elapsed.
+    void maybeSubscribe(int32_t propId);
+    // Caches the value fetched from VHAL unless the cache was invalidated after the fetch started.
+    void storeFetchedValue(const IHalPropValue& value, uint64_t generation);
+    void invalidate(const IHalPropValue& value);
+
+    const std::shared_ptr<IVhalClient> mClient;
+    const int64_t mMaxStalenessNs;
+    const std::function<int64_t()> mGetTimeNsFunc;
+    const std::shared_ptr<ValueCache> mCache;
+    const std::shared_ptr<OnBinderDiedCallbackFunc> mOnBinderDiedCallback;
+    std::unique_ptr<ISubscriptionClient> mSubscriptionClient;
+};
+
+}  // namespace vhal
+}  // namespace automotive
+}  // namespace frameworks
+}  // namespace android
+
+#endif  // CPP_VHAL_CLIENT_INCLUDE_CACHINGVHALCLIENT_H_
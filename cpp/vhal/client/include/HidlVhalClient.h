@@ -18,14 +18,22 @@
 #define CPP_VHAL_CLIENT_INCLUDE_HIDLVHALCLIENT_H_
 
 #include "IVhalClient.h"
+#include "PendingRequestTimer.h"
 
 #include <aidl/android/hardware/automotive/vehicle/SubscribeOptions.h>
 #include <android-base/thread_annotations.h>
 #include <android/hardware/automotive/vehicle/2.0/IVehicle.h>
 #include <utils/StrongPointer.h>
 
-#include <mutex>  // NOLINT
+#include <atomic>
+#include <condition_variable>  // NOLINT
+#include <deque>
+#include <mutex>               // NOLINT
+#include <optional>
+#include <thread>              // NOLINT
+#include <unordered_map>
 #include <unordered_set>
+#include <vector>
 
 namespace android {
 namespace frameworks {
@@ -44,9 +52,20 @@ public:
     static std::shared_ptr<IVhalClient> tryCreate();
     static std::shared_ptr<IVhalClient> tryCreate(const char* descriptor);
 
+    // The default number of worker threads that run asynchronous requests.
+    constexpr static size_t DEFAULT_WORKER_THREAD_COUNT = 4;
+    // The maximum number of asynchronous requests waiting for a worker thread. Requests beyond
+    // this limit fail immediately with TRY_AGAIN_FROM_VHAL.
+    constexpr static size_t MAX_QUEUED_REQUEST_COUNT = 1'024;
+
     explicit HidlVhalClient(
             android::sp<android::hardware::automotive::vehicle::V2_0::IVehicle> hal);
 
+    HidlVhalClient(android::sp<android::hardware::automotive::vehicle::V2_0::IVehicle> hal,
+                   int64_t timeoutInMs, size_t workerThreadCount);
+
+    // Waits for the running requests to finish. Queued requests fail with TIMEOUT. Must not be
+    // called from a get/set callback.
     ~HidlVhalClient();
 
     bool isAidlVhal() override;
@@ -55,12 +74,32 @@ public:
 
     std::unique_ptr<IHalPropValue> createHalPropValue(int32_t propId, int32_t areaId) override;
 
+    // Runs the request on a worker thread. The callback is called from the worker thread, or with
+    // a TIMEOUT error if VHAL doesn't respond within the timeout.
     void getValue(const IHalPropValue& requestValue,
                   std::shared_ptr<GetValueCallbackFunc> callback) override;
 
+    // Runs the request on a worker thread. The future finishes with a TIMEOUT error if VHAL
+    // doesn't respond by |deadline|, even if the request is still waiting for a worker thread.
+    VhalClientFuture<std::unique_ptr<IHalPropValue>> getValueAsync(
+            const IHalPropValue& requestValue, Deadline deadline = NO_DEADLINE) override;
+
+    // Calls the HIDL VHAL directly on the caller's thread.
+    VhalClientResult<std::unique_ptr<IHalPropValue>> getValueSync(
+            const IHalPropValue& requestValue) override;
+
+    // Runs the request on a worker thread. The callback is called from the worker thread, or with
+    // a TIMEOUT error if VHAL doesn't respond within the timeout.
     void setValue(const IHalPropValue& value,
                   std::shared_ptr<HidlVhalClient::SetValueCallbackFunc> callback) override;
 
+    // Runs the request on a worker thread. See {@code getValueAsync}.
+    VhalClientFuture<void> setValueAsync(const IHalPropValue& value,
+                                         Deadline deadline = NO_DEADLINE) override;
+
+    // Calls the HIDL VHAL directly on the caller's thread.
+    VhalClientResult<void> setValueSync(const IHalPropValue& value) override;
+
     // Add the callback that would be called when VHAL binder died.
     VhalClientResult<void> addOnBinderDiedCallback(
             std::shared_ptr<OnBinderDiedCallbackFunc> callback) override;
@@ -91,14 +130,75 @@ private:
         HidlVhalClient* mClient;
     };
 
+    struct PendingRequest {
+        bool isGetValue;
+        // Only one of the promises is used, depending on the request type.
+        VhalClientPromise<std::unique_ptr<IHalPropValue>> getValuePromise;
+        VhalClientPromise<void> setValuePromise;
+        int32_t propId;
+        int32_t areaId;
+    };
+
+    struct QueuedRequest {
+        int64_t requestId;
+        bool isGetValue;
+        android::hardware::automotive::vehicle::V2_0::VehiclePropValue value;
+    };
+
     android::sp<::android::hardware::automotive::vehicle::V2_0::IVehicle> mHal;
     android::sp<DeathRecipient> mDeathRecipient;
+    const size_t mWorkerThreadCount;
 
     std::mutex mLock;
     std::unordered_set<std::shared_ptr<OnBinderDiedCallbackFunc>> mOnBinderDiedCallbacks
             GUARDED_BY(mLock);
 
+    std::atomic<int64_t> mRequestId = 0;
+    std::unique_ptr<PendingRequestTimer> mPendingRequestTimer;
+    std::shared_ptr<PendingRequestTimer::TimeoutCallbackFunc> mOnTimeout;
+
+    std::mutex mRequestLock;
+    // Notified when a request is queued or the client is stopping. Only worker threads wait on it,
+    // so notify_one always wakes a worker.
+    std::condition_variable mWorkerCv;
+    // Notified when |mActiveRequestCount| drops to zero.
+    std::condition_variable mIdleCv;
+    std::unordered_map<int64_t, PendingRequest> mPendingRequests GUARDED_BY(mRequestLock);
+    std::deque<QueuedRequest> mQueuedRequests GUARDED_BY(mRequestLock);
+    // Keys of the (propId, areaId) pairs with a set request running on a worker thread. A set
+    // request waits in the queue while its key is here, so the sets to a property area reach
+    // VHAL in the order they were issued.
+    std::unordered_set<int64_t> mRunningSetRequestKeys GUARDED_BY(mRequestLock);
+    // Number of requests that are queued or running on a worker thread.
+    size_t mActiveRequestCount GUARDED_BY(mRequestLock) = 0;
+    size_t mIdleWorkerCount GUARDED_BY(mRequestLock) = 0;
+    bool mStopping GUARDED_BY(mRequestLock) = false;
+    // Worker threads are started on demand, up to |mWorkerThreadCount|, so clients that only use
+    // the synchronous API don't pay for them.
+    std::vector<std::thread> mWorkerThreads GUARDED_BY(mRequestLock);
+
     void onBinderDied();
+
+    // Adds the request to the pending request timer and queues it for a worker thread.
+    // {@code NO_DEADLINE} selects the default timeout.
+    void enqueueRequest(const IHalPropValue& value, Deadline deadline,
+                        PendingRequest pendingRequest);
+    void runWorker();
+    // Returns the first queued request that can run now, or the end of the queue if none.
+    std::deque<QueuedRequest>::iterator findRunnableRequestLocked() REQUIRES(mRequestLock);
+    void runRequest(const QueuedRequest& request);
+    // Removes and returns the pending request, or std::nullopt if it already timed out.
+    std::optional<PendingRequest> tryFinishRequest(int64_t requestId);
+    void onTimeout(const std::unordered_set<int64_t>& requestIds);
+
+    VhalClientResult<std::unique_ptr<IHalPropValue>> getValueFromHal(
+            const android::hardware::automotive::vehicle::V2_0::VehiclePropValue& requestValue);
+    VhalClientResult<void> setValueToHal(
+            const android::hardware::automotive::vehicle::V2_0::VehiclePropValue& value);
+
+    // Test-only functions:
+    // Blocks until all the asynchronous requests issued so far are finished.
+    void waitForPendingRequests();
 };
 
 class SubscriptionCallback;
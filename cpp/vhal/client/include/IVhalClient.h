@@ -19,6 +19,8 @@
 
 #include "IHalPropConfig.h"
 #include "IHalPropValue.h"
+#include "VhalClientFuture.h"
+#include "VhalClientResult.h"
 
 #include <aidl/android/hardware/automotive/vehicle/StatusCode.h>
 #include <aidl/android/hardware/automotive/vehicle/SubscribeOptions.h>
@@ -26,6 +28,8 @@
 
 #include <VehicleUtils.h>
 
+#include <chrono>  // NOLINT
+
 namespace android {
 namespace frameworks {
 namespace automotive {
@@ -52,84 +56,6 @@ public:
     virtual void onPropertySetError(const std::vector<HalPropError>& errors) = 0;
 };
 
-// Errors for vehicle HAL client interface.
-enum class ErrorCode : int {
-    // Response status is OK. No errors.
-    OK = 0,
-    // The argument is invalid.
-    INVALID_ARG = 1,
-    // The request timed out. The client may try again.
-    TIMEOUT = 2,
-    // Some errors occur while connecting VHAL. The client may try again.
-    TRANSACTION_ERROR = 3,
-    // Some unexpected errors happen in VHAL. Needs to try again.
-    TRY_AGAIN_FROM_VHAL = 4,
-    // The device of corresponding vehicle property is not available.
-    // Example: the HVAC unit is turned OFF when user wants to adjust temperature.
-    NOT_AVAILABLE_FROM_VHAL = 5,
-    // The request is unauthorized.
-    ACCESS_DENIED_FROM_VHAL = 6,
-    // Some unexpected errors, for example OOM, happen in VHAL.
-    INTERNAL_ERROR_FROM_VHAL = 7,
-};
-
-// Convert the VHAL {@code StatusCode} to {@code ErrorCode}.
-static ErrorCode statusCodeToErrorCode(
-        const aidl::android::hardware::automotive::vehicle::StatusCode& code) {
-    switch (code) {
-        case aidl::android::hardware::automotive::vehicle::StatusCode::OK:
-            return ErrorCode::OK;
-        case aidl::android::hardware::automotive::vehicle::StatusCode::TRY_AGAIN:
-            return ErrorCode::TRY_AGAIN_FROM_VHAL;
-        case aidl::android::hardware::automotive::vehicle::StatusCode::INVALID_ARG:
-            return ErrorCode::INVALID_ARG;
-        case aidl::android::hardware::automotive::vehicle::StatusCode::NOT_AVAILABLE:
-            return ErrorCode::NOT_AVAILABLE_FROM_VHAL;
-        case aidl::android::hardware::automotive::vehicle::StatusCode::ACCESS_DENIED:
-            return ErrorCode::ACCESS_DENIED_FROM_VHAL;
-        case aidl::android::hardware::automotive::vehicle::StatusCode::INTERNAL_ERROR:
-            return ErrorCode::INTERNAL_ERROR_FROM_VHAL;
-        default:
-            return ErrorCode::INTERNAL_ERROR_FROM_VHAL;
-    }
-}
-
-// VhalClientError is a wrapper class for {@code ErrorCode} that could act as E in {@code
-// Result<T,E>}.
-class VhalClientError final {
-public:
-    VhalClientError() : mCode(ErrorCode::OK) {}
-
-    VhalClientError(ErrorCode&& code) : mCode(code) {}
-
-    VhalClientError(const ErrorCode& code) : mCode(code) {}
-
-    VhalClientError(aidl::android::hardware::automotive::vehicle::StatusCode&& code) :
-          mCode(statusCodeToErrorCode(code)) {}
-
-    VhalClientError(const aidl::android::hardware::automotive::vehicle::StatusCode& code) :
-          mCode(statusCodeToErrorCode(code)) {}
-
-    ErrorCode value() const;
-
-    inline operator ErrorCode() const { return value(); }
-
-    static std::string toString(ErrorCode code);
-
-    std::string print() const;
-
-private:
-    ErrorCode mCode;
-};
-
-// VhalClientResult is a {@code Result} that contains {@code ErrorCode} as error type.
-template <class T>
-using VhalClientResult = android::base::Result<T, VhalClientError>;
-
-// ClientStatusError could be cast to {@code ResultError} with a {@code ErrorCode}
-// and should be used as error type for {@VhalClientResult}.
-using ClientStatusError = android::base::Error<VhalClientError>;
-
 // ISubscriptionCallback is a client that could be used to subscribe/unsubscribe.
 class ISubscriptionClient {
 public:
@@ -230,6 +156,11 @@ public:
     using SetValueCallbackFunc = std::function<void(VhalClientResult<void>)>;
     using OnBinderDiedCallbackFunc = std::function<void()>;
 
+    // An absolute deadline for a request.
+    using Deadline = std::chrono::steady_clock::time_point;
+    // No deadline, the client's default timeout applies.
+    constexpr static Deadline NO_DEADLINE = Deadline::max();
+
     /**
      * Check whether we are connected to AIDL VHAL backend.
      *
@@ -278,6 +209,20 @@ public:
     virtual VhalClientResult<std::unique_ptr<IHalPropValue>> getValueSync(
             const IHalPropValue& requestValue);
 
+    /**
+     * Get a property value asynchronously.
+     *
+     * @param requestValue The value to request.
+     * @param deadline The time by which the request must finish. The request finishes with a
+     *    TIMEOUT error if VHAL doesn't respond by then. For AIDL and HIDL backends, the deadline is
+     *    enforced by the client's pending request pool, so an expired request is also cleaned up.
+     *    Other clients only reject requests whose deadline already passed.
+     * @return A future that finishes with the got value on success or an error result with
+     *    returned status code as error code.
+     */
+    virtual VhalClientFuture<std::unique_ptr<IHalPropValue>> getValueAsync(
+            const IHalPropValue& requestValue, Deadline deadline = NO_DEADLINE);
+
     /**
      * Set a property value asynchronously.
      *
@@ -299,6 +244,17 @@ public:
      */
     virtual VhalClientResult<void> setValueSync(const IHalPropValue& requestValue);
 
+    /**
+     * Set a property value asynchronously.
+     *
+     * @param requestValue The value to set.
+     * @param deadline The time by which the request must finish. See {@code getValueAsync}.
+     * @return A future that finishes with an empty okay result on success or an error result with
+     *    returned status code as error code.
+     */
+    virtual VhalClientFuture<void> setValueAsync(const IHalPropValue& requestValue,
+                                                 Deadline deadline = NO_DEADLINE);
+
     /**
      * Add a callback that would be called when the binder connection to VHAL died.
      *
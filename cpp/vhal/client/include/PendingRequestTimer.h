@@ -0,0 +1,95 @@
+/*
+ * Copyright (c) 2024, The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef CPP_VHAL_CLIENT_INCLUDE_PENDINGREQUESTTIMER_H_
+#define CPP_VHAL_CLIENT_INCLUDE_PENDINGREQUESTTIMER_H_
+
+#include <android-base/thread_annotations.h>
+
+#include <chrono>              // NOLINT
+#include <condition_variable>  // NOLINT
+#include <functional>
+#include <map>
+#include <memory>
+#include <mutex>   // NOLINT
+#include <thread>  // NOLINT
+#include <unordered_map>
+#include <unordered_set>
+
+namespace android {
+namespace frameworks {
+namespace automotive {
+namespace vhal {
+
+// PendingRequestTimer tracks pending requests, each with its own absolute deadline.
+//
+// All the requests are ordered by deadline on a single timer thread, so a request times out at
+// exactly its own deadline regardless of how many distinct timeouts are in use.
+class PendingRequestTimer final {
+public:
+    using Deadline = std::chrono::steady_clock::time_point;
+    using TimeoutCallbackFunc = std::function<void(const std::unordered_set<int64_t>&)>;
+
+    explicit PendingRequestTimer(int64_t defaultTimeoutInMs);
+
+    // Stops the timer thread and times out all the pending requests.
+    ~PendingRequestTimer();
+
+    // Adds a pending request. Once |deadline| passes, |callback| is called from the timer thread
+    // with the IDs of the timed-out requests. {@code Deadline::max()} selects the default
+    // timeout. Request IDs must be unique across all the callbacks.
+    void addRequest(int64_t requestId, Deadline deadline,
+                    std::shared_ptr<const TimeoutCallbackFunc> callback);
+
+    // Returns whether the request is still pending.
+    bool isRequestPending(int64_t requestId);
+
+    // Removes the request. Returns false if the request already timed out.
+    bool tryFinishRequest(int64_t requestId);
+
+    // Times out all the pending requests.
+    void reset();
+
+private:
+    using CallbackMap =
+            std::map<std::shared_ptr<const TimeoutCallbackFunc>, std::unordered_set<int64_t>>;
+
+    struct PendingRequest {
+        std::multimap<Deadline, int64_t>::iterator deadlineIt;
+        std::shared_ptr<const TimeoutCallbackFunc> callback;
+    };
+
+    const std::chrono::milliseconds mDefaultTimeout;
+
+    std::mutex mLock;
+    std::condition_variable mCv;
+    std::multimap<Deadline, int64_t> mRequestIdsByDeadline GUARDED_BY(mLock);
+    std::unordered_map<int64_t, PendingRequest> mPendingRequests GUARDED_BY(mLock);
+    bool mStopping GUARDED_BY(mLock) = false;
+    std::thread mThread;
+
+    void runTimer();
+    // Removes the requests whose deadline is not after |now| and groups them by callback.
+    CallbackMap takeExpiredRequestsLocked(Deadline now) REQUIRES(mLock);
+    static void callTimeoutCallbacks(const CallbackMap& callbacks);
+};
+
+}  // namespace vhal
+}  // namespace automotive
+}  // namespace frameworks
+}  // namespace android
+
+#endif  // CPP_VHAL_CLIENT_INCLUDE_PENDINGREQUESTTIMER_H_
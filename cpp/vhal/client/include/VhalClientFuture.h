@@ -0,0 +1,259 @@
+/*
+ * Copyright (c) 2024, The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef CPP_VHAL_CLIENT_INCLUDE_VHALCLIENTFUTURE_H_
+#define CPP_VHAL_CLIENT_INCLUDE_VHALCLIENTFUTURE_H_
+
+#include "VhalClientResult.h"
+
+#include <chrono>              // NOLINT
+#include <condition_variable>  // NOLINT
+#include <functional>
+#include <memory>
+#include <mutex>  // NOLINT
+#include <optional>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+namespace android {
+namespace frameworks {
+namespace automotive {
+namespace vhal {
+
+template <class T>
+class VhalClientPromise;
+
+namespace internal {
+
+// State shared by a promise and its future.
+template <class T>
+struct FutureState {
+    std::mutex lock;
+    std::condition_variable cv;
+    std::optional<VhalClientResult<T>> result;
+    // Called instead of storing the result if a continuation is registered before the result is
+    // set.
+    std::function<void(VhalClientResult<T>)> continuation;
+    // Whether the result was set, even if it was already passed to the continuation.
+    bool done = false;
+};
+
+template <class R>
+struct ResultValueType;
+
+template <class U>
+struct ResultValueType<VhalClientResult<U>> {
+    using type = U;
+};
+
+}  // namespace internal
+
+// VhalClientFuture is a completion token for an asynchronous VHAL request.
+//
+// The result could be either waited for, with or without a timeout, or consumed by a continuation
+// registered with {@code then}. The result could be consumed only once. A future is cheap to copy
+// but all copies share the same result.
+template <class T>
+class VhalClientFuture final {
+public:
+    // Creates an invalid future that is never ready. Waiting on it returns immediately and
+    // {@code get} returns an INVALID_ARG error.
+    VhalClientFuture() = default;
+
+    // Returns whether the future is associated with a request.
+    bool isValid() const { return mState != nullptr; }
+
+    // Returns whether the request finished.
+    bool isReady() const {
+        if (!isValid()) {
+            return false;
+        }
+        std::lock_guard<std::mutex> lk(mState->lock);
+        return mState->done;
+    }
+
+    // Blocks until the request finishes.
+    void wait() const {
+        if (!isValid()) {
+            return;
+        }
+        std::unique_lock<std::mutex> lk(mState->lock);
+        mState->cv.wait(lk, [this] { return mState->done; });
+    }
+
+    // Blocks until the request finishes or the timeout expires. Returns whether the request
+    // finished.
+    template <class Rep, class Period>
+    bool waitFor(const std::chrono::duration<Rep, Period>& timeout) const {
+        if (!isValid()) {
+            return false;
+        }
+        std::unique_lock<std::mutex> lk(mState->lock);
+        return mState->cv.wait_for(lk, timeout, [this] { return mState->done; });
+    }
+
+    // Blocks until the request finishes and returns the result. Returns an INVALID_ARG error if
+    // the future is invalid or the result was already consumed by {@code get} or a continuation.
+    VhalClientResult<T> get() {
+        if (!isValid()) {
+            return ClientStatusError(ErrorCode::INVALID_ARG) << "the future is invalid";
+        }
+        std::unique_lock<std::mutex> lk(mState->lock);
+        mState->cv.wait(lk, [this] { return mState->done; });
+        if (!mState->result.has_value()) {
+            return ClientStatusError(ErrorCode::INVALID_ARG) << "the result was already consumed";
+        }
+        VhalClientResult<T> result = std::move(*mState->result);
+        mState->result.reset();
+        return result;
+    }
+
+    // Registers a continuation that is called with the result once the request finishes. If the
+    // request already finished, the continuation is called immediately on the caller's thread.
+    // Otherwise it is called on the thread that finishes the request. On an invalid future, or
+    // if the result was already consumed, the continuation is called immediately with an
+    // INVALID_ARG error.
+    //
+    // If |func| returns void, this returns void. Otherwise |func| must return a
+    // {@code VhalClientResult<U>} and this returns a {@code VhalClientFuture<U>} that finishes
+    // with the value returned by |func|.
+    template <class F>
+    auto then(F&& func) {
+        using R = std::invoke_result_t<F, VhalClientResult<T>>;
+        if constexpr (std::is_void_v<R>) {
+            setContinuation(std::forward<F>(func));
+        } else {
+            VhalClientPromise<typename internal::ResultValueType<R>::type> promise;
+            auto future = promise.getFuture();
+            setContinuation([func = std::forward<F>(func),
+                             promise = std::move(promise)](VhalClientResult<T> result) mutable {
+                promise.setResult(func(std::move(result)));
+            });
+            return future;
+        }
+    }
+
+private:
+    friend class VhalClientPromise<T>;
+
+    explicit VhalClientFuture(std::shared_ptr<internal::FutureState<T>> state) :
+          mState(std::move(state)) {}
+
+    void setContinuation(std::function<void(VhalClientResult<T>)> continuation) {
+        if (!isValid()) {
+            continuation(ClientStatusError(ErrorCode::INVALID_ARG) << "the future is invalid");
+            return;
+        }
+        std::unique_lock<std::mutex> lk(mState->lock);
+        if (!mState->done) {
+            mState->continuation = std::move(continuation);
+            return;
+        }
+        if (!mState->result.has_value()) {
+            lk.unlock();
+            continuation(ClientStatusError(ErrorCode::INVALID_ARG)
+                         << "the result was already consumed");
+            return;
+        }
+        VhalClientResult<T> result = std::move(*mState->result);
+        mState->result.reset();
+        lk.unlock();
+        continuation(std::move(result));
+    }
+
+    std::shared_ptr<internal::FutureState<T>> mState;
+};
+
+// VhalClientPromise is the producer side of a {@code VhalClientFuture}.
+template <class T>
+class VhalClientPromise final {
+public:
+    VhalClientPromise() : mState(std::make_shared<internal::FutureState<T>>()) {}
+
+    VhalClientFuture<T> getFuture() const { return VhalClientFuture<T>(mState); }
+
+    // Finishes the request with the result. Only the first result is kept, so a result that races
+    // with a timeout is dropped. Returns whether the result was kept.
+    bool setResult(VhalClientResult<T> result) const {
+        std::unique_lock<std::mutex> lk(mState->lock);
+        if (mState->done) {
+            return false;
+        }
+        mState->done = true;
+        if (mState->continuation) {
+            auto continuation = std::move(mState->continuation);
+            mState->continuation = nullptr;
+            lk.unlock();
+            mState->cv.notify_all();
+            continuation(std::move(result));
+            return true;
+        }
+        mState->result = std::move(result);
+        lk.unlock();
+        mState->cv.notify_all();
+        return true;
+    }
+
+private:
+    std::shared_ptr<internal::FutureState<T>> mState;
+};
+
+// Returns a future that finishes once all the futures finish. Its value holds the results in the
+// same order as |futures|. The returned future never finishes with an error.
+template <class T>
+VhalClientFuture<std::vector<VhalClientResult<T>>> whenAll(
+        std::vector<VhalClientFuture<T>> futures) {
+    struct Batch {
+        std::mutex lock;
+        std::vector<std::optional<VhalClientResult<T>>> results;
+        size_t remaining;
+        VhalClientPromise<std::vector<VhalClientResult<T>>> promise;
+    };
+    auto batch = std::make_shared<Batch>();
+    auto future = batch->promise.getFuture();
+    if (futures.empty()) {
+        batch->promise.setResult(std::vector<VhalClientResult<T>>());
+        return future;
+    }
+    batch->results.resize(futures.size());
+    batch->remaining = futures.size();
+    for (size_t i = 0; i < futures.size(); i++) {
+        futures[i].then([batch, i](VhalClientResult<T> result) {
+            std::unique_lock<std::mutex> lk(batch->lock);
+            batch->results[i] = std::move(result);
+            if (--batch->remaining != 0) {
+                return;
+            }
+            std::vector<VhalClientResult<T>> results;
+            results.reserve(batch->results.size());
+            for (auto& r : batch->results) {
+                results.push_back(std::move(*r));
+            }
+            batch->results.clear();
+            lk.unlock();
+            batch->promise.setResult(std::move(results));
+        });
+    }
+    return future;
+}
+
+}  // namespace vhal
+}  // namespace automotive
+}  // namespace frameworks
+}  // namespace android
+
+#endif  // CPP_VHAL_CLIENT_INCLUDE_VHALCLIENTFUTURE_H_
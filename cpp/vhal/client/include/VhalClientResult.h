@@ -0,0 +1,113 @@
+/*
+ * Copyright (c) 2024, The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef CPP_VHAL_CLIENT_INCLUDE_VHALCLIENTRESULT_H_
+#define CPP_VHAL_CLIENT_INCLUDE_VHALCLIENTRESULT_H_
+
+#include <aidl/android/hardware/automotive/vehicle/StatusCode.h>
+#include <android-base/result.h>
+
+#include <string>
+
+namespace android {
+namespace frameworks {
+namespace automotive {
+namespace vhal {
+
+// Errors for vehicle HAL client interface.
+enum class ErrorCode : int {
+    // Response status is OK. No errors.
+    OK = 0,
+    // The argument is invalid.
+    INVALID_ARG = 1,
+    // The request timed out. The client may try again.
+    TIMEOUT = 2,
+    // Some errors occur while connecting VHAL. The client may try again.
+    TRANSACTION_ERROR = 3,
+    // Some unexpected errors happen in VHAL. Needs to try again.
+    TRY_AGAIN_FROM_VHAL = 4,
+    // The device of corresponding vehicle property is not available.
+    // Example: the HVAC unit is turned OFF when user wants to adjust temperature.
+    NOT_AVAILABLE_FROM_VHAL = 5,
+    // The request is unauthorized.
+    ACCESS_DENIED_FROM_VHAL = 6,
+    // Some unexpected errors, for example OOM, happen in VHAL.
+    INTERNAL_ERROR_FROM_VHAL = 7,
+};
+
+// Convert the VHAL {@code StatusCode} to {@code ErrorCode}.
+static ErrorCode statusCodeToErrorCode(
+        const aidl::android::hardware::automotive::vehicle::StatusCode& code) {
+    switch (code) {
+        case aidl::android::hardware::automotive::vehicle::StatusCode::OK:
+            return ErrorCode::OK;
+        case aidl::android::hardware::automotive::vehicle::StatusCode::TRY_AGAIN:
+            return ErrorCode::TRY_AGAIN_FROM_VHAL;
+        case aidl::android::hardware::automotive::vehicle::StatusCode::INVALID_ARG:
+            return ErrorCode::INVALID_ARG;
+        case aidl::android::hardware::automotive::vehicle::StatusCode::NOT_AVAILABLE:
+            return ErrorCode::NOT_AVAILABLE_FROM_VHAL;
+        case aidl::android::hardware::automotive::vehicle::StatusCode::ACCESS_DENIED:
+            return ErrorCode::ACCESS_DENIED_FROM_VHAL;
+        case aidl::android::hardware::automotive::vehicle::StatusCode::INTERNAL_ERROR:
+            return ErrorCode::INTERNAL_ERROR_FROM_VHAL;
+        default:
+            return ErrorCode::INTERNAL_ERROR_FROM_VHAL;
+    }
+}
+
+// VhalClientError is a wrapper class for {@code ErrorCode} that could act as E in {@code
+// Result<T,E>}.
+class VhalClientError final {
+public:
+    VhalClientError() : mCode(ErrorCode::OK) {}
+
+    VhalClientError(ErrorCode&& code) : mCode(code) {}
+
+    VhalClientError(const ErrorCode& code) : mCode(code) {}
+
+    VhalClientError(aidl::android::hardware::automotive::vehicle::StatusCode&& code) :
+          mCode(statusCodeToErrorCode(code)) {}
+
+    VhalClientError(const aidl::android::hardware::automotive::vehicle::StatusCode& code) :
+          mCode(statusCodeToErrorCode(code)) {}
+
+    ErrorCode value() const;
+
+    inline operator ErrorCode() const { return value(); }
+
+    static std::string toString(ErrorCode code);
+
+    std::string print() const;
+
+private:
+    ErrorCode mCode;
+};
+
+// VhalClientResult is a {@code Result} that contains {@code ErrorCode} as error type.
+template <class T>
+using VhalClientResult = android::base::Result<T, VhalClientError>;
+
+// ClientStatusError could be cast to {@code ResultError} with a {@code ErrorCode}
+// and should be used as error type for {@VhalClientResult}.
+using ClientStatusError = android::base::Error<VhalClientError>;
+
+}  // namespace vhal
+}  // namespace automotive
+}  // namespace frameworks
+}  // namespace android
+
+#endif  // CPP_VHAL_CLIENT_INCLUDE_VHALCLIENTRESULT_H_
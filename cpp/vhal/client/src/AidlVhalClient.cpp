@@ -40,7 +40,6 @@ namespace {
 using ::android::base::Join;
 using ::android::base::StringPrintf;
 using ::android::hardware::automotive::vehicle::fromStableLargeParcelable;
-using ::android::hardware::automotive::vehicle::PendingRequestPool;
 using ::android::hardware::automotive::vehicle::toInt;
 using ::android::hardware::automotive::vehicle::vectorToStableLargeParcelable;
 
@@ -76,6 +75,34 @@ std::string toString(const std::vector<int32_t>& values) {
     return "[" + Join(strings, ",") + "]";
 }
 
+VhalClientResult<std::unique_ptr<IHalPropValue>> toClientResult(const GetValueResult& result,
+                                                                 int32_t propId, int32_t areaId) {
+    if (result.status != StatusCode::OK) {
+        return ClientStatusError(result.status)
+                << "failed to get value for propId: " << propId << ", areaId: " << areaId
+                << ": status: " << toString(result.status);
+    }
+    if (!result.prop.has_value()) {
+        return ClientStatusError(ErrorCode::INTERNAL_ERROR_FROM_VHAL)
+                << "failed to get value for propId: " << propId << ", areaId: " << areaId
+                << ": returns no value";
+    }
+    VehiclePropValue valueCopy = result.prop.value();
+    std::unique_ptr<IHalPropValue> propValue =
+            std::make_unique<AidlHalPropValue>(std::move(valueCopy));
+    return propValue;
+}
+
+VhalClientResult<void> toClientResult(const SetValueResult& result, int32_t propId,
+                                      int32_t areaId) {
+    if (result.status != StatusCode::OK) {
+        return ClientStatusError(result.status)
+                << "failed to set value for propId: " << propId << ", areaId: " << areaId
+                << ": status: " << toString(result.status);
+    }
+    return {};
+}
+
 }  // namespace
 
 std::shared_ptr<IVhalClient> AidlVhalClient::create() {
@@ -164,14 +191,51 @@ binder_status_t AidlVhalClient::DefaultLinkUnlinkImpl::unlinkToDeath(
 
 void AidlVhalClient::getValue(const IHalPropValue& requestValue,
                               std::shared_ptr<GetValueCallbackFunc> callback) {
+    getValueAsync(requestValue).then(
+            [callback](VhalClientResult<std::unique_ptr<IHalPropValue>> result) {
+                (*callback)(std::move(result));
+            });
+}
+
+VhalClientFuture<std::unique_ptr<IHalPropValue>> AidlVhalClient::getValueAsync(
+        const IHalPropValue& requestValue, Deadline deadline) {
+    if (deadline <= std::chrono::steady_clock::now()) {
+        return IVhalClient::getValueAsync(requestValue, deadline);
+    }
+    VhalClientPromise<std::unique_ptr<IHalPropValue>> promise;
+    auto future = promise.getFuture();
     int64_t requestId = mRequestId++;
-    mGetSetValueClient->getValue(requestId, requestValue, callback, mGetSetValueClient);
+    mGetSetValueClient->getValue(requestId, requestValue, deadline, std::move(promise),
+                                 mGetSetValueClient);
+    return future;
 }
 
 void AidlVhalClient::setValue(const IHalPropValue& requestValue,
                               std::shared_ptr<SetValueCallbackFunc> callback) {
+    setValueAsync(requestValue).then(
+            [callback](VhalClientResult<void> result) { (*callback)(std::move(result)); });
+}
+
+VhalClientFuture<void> AidlVhalClient::setValueAsync(const IHalPropValue& requestValue,
+                                                     Deadline deadline) {
+    if (deadline <= std::chrono::steady_clock::now()) {
+        return IVhalClient::setValueAsync(requestValue, deadline);
+    }
+    VhalClientPromise<void> promise;
+    auto future = promise.getFuture();
     int64_t requestId = mRequestId++;
-    mGetSetValueClient->setValue(requestId, requestValue, callback, mGetSetValueClient);
+    mGetSetValueClient->setValue(requestId, requestValue, deadline, std::move(promise),
+                                 mGetSetValueClient);
+    return future;
+}
+
+VhalClientResult<std::unique_ptr<IHalPropValue>> AidlVhalClient::getValueSync(
+        const IHalPropValue& requestValue) {
+    return mGetSetValueClient->getValueSync(mRequestId++, requestValue, mGetSetValueClient);
+}
+
+VhalClientResult<void> AidlVhalClient::setValueSync(const IHalPropValue& requestValue) {
+    return mGetSetValueClient->setValueSync(mRequestId++, requestValue, mGetSetValueClient);
 }
 
 VhalClientResult<void> AidlVhalClient::addOnBinderDiedCallback(
@@ -271,27 +335,28 @@ std::unique_ptr<ISubscriptionClient> AidlVhalClient::getSubscriptionClient(
 }
 
 GetSetValueClient::GetSetValueClient(int64_t timeoutInNs, std::shared_ptr<IVehicle> hal) :
-      mHal(hal) {
-    mPendingRequestPool = std::make_unique<PendingRequestPool>(timeoutInNs);
-    mOnGetValueTimeout = std::make_unique<PendingRequestPool::TimeoutCallbackFunc>(
+      mTimeoutInNs(timeoutInNs), mHal(hal) {
+    mPendingRequestTimer = std::make_unique<PendingRequestTimer>(timeoutInNs / 1'000'000);
+    mOnGetValueTimeout = std::make_unique<PendingRequestTimer::TimeoutCallbackFunc>(
             [this](const std::unordered_set<int64_t>& requestIds) {
                 onTimeout(requestIds, &mPendingGetValueCallbacks);
             });
-    mOnSetValueTimeout = std::make_unique<PendingRequestPool::TimeoutCallbackFunc>(
+    mOnSetValueTimeout = std::make_unique<PendingRequestTimer::TimeoutCallbackFunc>(
             [this](const std::unordered_set<int64_t>& requestIds) {
                 onTimeout(requestIds, &mPendingSetValueCallbacks);
             });
 }
 
 GetSetValueClient::~GetSetValueClient() {
-    // Delete the pending request pool, mark all pending request as timed-out.
-    mPendingRequestPool.reset();
+    // Stop the timer, which waits for a running timeout callback and marks all the pending
+    // requests as timed-out.
+    mPendingRequestTimer.reset();
 }
 
-void GetSetValueClient::getValue(
-        int64_t requestId, const IHalPropValue& requestValue,
-        std::shared_ptr<AidlVhalClient::GetValueCallbackFunc> clientCallback,
-        std::shared_ptr<GetSetValueClient> vhalCallback) {
+void GetSetValueClient::getValue(int64_t requestId, const IHalPropValue& requestValue,
+                                 IVhalClient::Deadline deadline,
+                                 VhalClientPromise<std::unique_ptr<IHalPropValue>> promise,
+                                 std::shared_ptr<GetSetValueClient> vhalCallback) {
     int32_t propId = requestValue.getPropId();
     int32_t areaId = requestValue.getAreaId();
     std::vector<GetValueRequest> requests = {
@@ -306,7 +371,7 @@ void GetSetValueClient::getValue(
     ScopedAStatus status = vectorToStableLargeParcelable(std::move(requests), &getValueRequests);
     if (!status.isOk()) {
         tryFinishGetValueRequest(requestId);
-        (*clientCallback)(AidlVhalClient::statusToError<
+        promise.setResult(AidlVhalClient::statusToError<
                           std::unique_ptr<IHalPropValue>>(status,
                                                           StringPrintf("failed to serialize "
                                                                        "request for prop: %" PRId32
@@ -314,11 +379,11 @@ void GetSetValueClient::getValue(
                                                                        propId, areaId)));
     }
 
-    addGetValueRequest(requestId, requestValue, clientCallback);
+    addGetValueRequest(requestId, requestValue, deadline, promise);
     status = mHal->getValues(vhalCallback, getValueRequests);
     if (!status.isOk()) {
         tryFinishGetValueRequest(requestId);
-        (*clientCallback)(
+        promise.setResult(
                 AidlVhalClient::statusToError<std::unique_ptr<
                         IHalPropValue>>(status,
                                         StringPrintf("failed to get value for prop: %" PRId32
@@ -327,10 +392,9 @@ void GetSetValueClient::getValue(
     }
 }
 
-void GetSetValueClient::setValue(
-        int64_t requestId, const IHalPropValue& requestValue,
-        std::shared_ptr<AidlVhalClient::SetValueCallbackFunc> clientCallback,
-        std::shared_ptr<GetSetValueClient> vhalCallback) {
+void GetSetValueClient::setValue(int64_t requestId, const IHalPropValue& requestValue,
+                                 IVhalClient::Deadline deadline, VhalClientPromise<void> promise,
+                                 std::shared_ptr<GetSetValueClient> vhalCallback) {
     int32_t propId = requestValue.getPropId();
     int32_t areaId = requestValue.getAreaId();
     std::vector<SetValueRequest> requests = {
@@ -345,18 +409,18 @@ void GetSetValueClient::setValue(
     ScopedAStatus status = vectorToStableLargeParcelable(std::move(requests), &setValueRequests);
     if (!status.isOk()) {
         tryFinishSetValueRequest(requestId);
-        (*clientCallback)(AidlVhalClient::statusToError<
+        promise.setResult(AidlVhalClient::statusToError<
                           void>(status,
                                 StringPrintf("failed to serialize request for prop: %" PRId32
                                              ", areaId: %" PRId32,
                                              propId, areaId)));
     }
 
-    addSetValueRequest(requestId, requestValue, clientCallback);
+    addSetValueRequest(requestId, requestValue, deadline, promise);
     status = mHal->setValues(vhalCallback, setValueRequests);
     if (!status.isOk()) {
         tryFinishSetValueRequest(requestId);
-        (*clientCallback)(AidlVhalClient::statusToError<
+        promise.setResult(AidlVhalClient::statusToError<
                           void>(status,
                                 StringPrintf("failed to set value for prop: %" PRId32
                                              ", areaId: %" PRId32,
@@ -364,30 +428,150 @@ void GetSetValueClient::setValue(
     }
 }
 
+VhalClientResult<std::unique_ptr<IHalPropValue>> GetSetValueClient::getValueSync(
+        int64_t requestId, const IHalPropValue& requestValue,
+        std::shared_ptr<GetSetValueClient> vhalCallback) {
+    int32_t propId = requestValue.getPropId();
+    int32_t areaId = requestValue.getAreaId();
+    std::vector<GetValueRequest> requests = {
+            {
+                    .requestId = requestId,
+                    .prop = *(reinterpret_cast<const VehiclePropValue*>(
+                            requestValue.toVehiclePropValue())),
+            },
+    };
+
+    GetValueRequests getValueRequests;
+    ScopedAStatus status = vectorToStableLargeParcelable(std::move(requests), &getValueRequests);
+    if (!status.isOk()) {
+        return AidlVhalClient::statusToError<std::unique_ptr<
+                IHalPropValue>>(status,
+                                StringPrintf("failed to serialize request for prop: %" PRId32
+                                             ", areaId: %" PRId32,
+                                             propId, areaId));
+    }
+
+    SyncRequest<std::unique_ptr<IHalPropValue>> request{
+            .requestId = requestId,
+            .propId = propId,
+            .areaId = areaId,
+    };
+    {
+        // Registered before the call, as VHAL may return the result before the call returns.
+        std::lock_guard<std::mutex> lk(mLock);
+        mSyncGetValueRequests.push_back(&request);
+    }
+    status = mHal->getValues(vhalCallback, getValueRequests);
+    if (!status.isOk()) {
+        std::lock_guard<std::mutex> lk(mLock);
+        takeSyncRequestLocked(requestId, &mSyncGetValueRequests);
+        return AidlVhalClient::statusToError<std::unique_ptr<
+                IHalPropValue>>(status,
+                                StringPrintf("failed to get value for prop: %" PRId32
+                                             ", areaId: %" PRId32,
+                                             propId, areaId));
+    }
+    return waitForSyncRequest(&request, &mSyncGetValueRequests);
+}
+
+VhalClientResult<void> GetSetValueClient::setValueSync(
+        int64_t requestId, const IHalPropValue& requestValue,
+        std::shared_ptr<GetSetValueClient> vhalCallback) {
+    int32_t propId = requestValue.getPropId();
+    int32_t areaId = requestValue.getAreaId();
+    std::vector<SetValueRequest> requests = {
+            {
+                    .requestId = requestId,
+                    .value = *(reinterpret_cast<const VehiclePropValue*>(
+                            requestValue.toVehiclePropValue())),
+            },
+    };
+
+    SetValueRequests setValueRequests;
+    ScopedAStatus status = vectorToStableLargeParcelable(std::move(requests), &setValueRequests);
+    if (!status.isOk()) {
+        return AidlVhalClient::statusToError<
+                void>(status,
+                      StringPrintf("failed to serialize request for prop: %" PRId32
+                                   ", areaId: %" PRId32,
+                                   propId, areaId));
+    }
+
+    SyncRequest<void> request{
+            .requestId = requestId,
+            .propId = propId,
+            .areaId = areaId,
+    };
+    {
+        // Registered before the call, as VHAL may return the result before the call returns.
+        std::lock_guard<std::mutex> lk(mLock);
+        mSyncSetValueRequests.push_back(&request);
+    }
+    status = mHal->setValues(vhalCallback, setValueRequests);
+    if (!status.isOk()) {
+        std::lock_guard<std::mutex> lk(mLock);
+        takeSyncRequestLocked(requestId, &mSyncSetValueRequests);
+        return AidlVhalClient::statusToError<
+                void>(status,
+                      StringPrintf("failed to set value for prop: %" PRId32 ", areaId: %" PRId32,
+                                   propId, areaId));
+    }
+    return waitForSyncRequest(&request, &mSyncSetValueRequests);
+}
+
+template <class T>
+GetSetValueClient::SyncRequest<T>* GetSetValueClient::takeSyncRequestLocked(
+        int64_t requestId, std::vector<SyncRequest<T>*>* requests) {
+    for (auto it = requests->begin(); it != requests->end(); ++it) {
+        if ((*it)->requestId == requestId) {
+            SyncRequest<T>* request = *it;
+            *it = requests->back();
+            requests->pop_back();
+            return request;
+        }
+    }
+    return nullptr;
+}
+
+template <class T>
+VhalClientResult<T> GetSetValueClient::waitForSyncRequest(SyncRequest<T>* request,
+                                                          std::vector<SyncRequest<T>*>* requests) {
+    std::unique_lock<std::mutex> lk(mLock);
+    if (!mSyncRequestCv.wait_for(lk, std::chrono::nanoseconds(mTimeoutInNs),
+                                 [request] { return request->result.has_value(); })) {
+        // A late result finds no request and is dropped.
+        takeSyncRequestLocked(request->requestId, requests);
+        return ClientStatusError(ErrorCode::TIMEOUT)
+                << "failed to get/set value for propId: " << request->propId
+                << ", areaId: " << request->areaId << ": request timed out";
+    }
+    return std::move(*request->result);
+}
+
 void GetSetValueClient::addGetValueRequest(
-        int64_t requestId, const IHalPropValue& requestProp,
-        std::shared_ptr<AidlVhalClient::GetValueCallbackFunc> callback) {
+        int64_t requestId, const IHalPropValue& requestProp, IVhalClient::Deadline deadline,
+        VhalClientPromise<std::unique_ptr<IHalPropValue>> promise) {
     std::lock_guard<std::mutex> lk(mLock);
     mPendingGetValueCallbacks[requestId] =
             std::make_unique<PendingGetValueRequest>(PendingGetValueRequest{
-                    .callback = callback,
+                    .promise = std::move(promise),
                     .propId = requestProp.getPropId(),
                     .areaId = requestProp.getAreaId(),
             });
-    mPendingRequestPool->addRequests(/*clientId=*/nullptr, {requestId}, mOnGetValueTimeout);
+    mPendingRequestTimer->addRequest(requestId, deadline, mOnGetValueTimeout);
 }
 
-void GetSetValueClient::addSetValueRequest(
-        int64_t requestId, const IHalPropValue& requestProp,
-        std::shared_ptr<AidlVhalClient::SetValueCallbackFunc> callback) {
+void GetSetValueClient::addSetValueRequest(int64_t requestId, const IHalPropValue& requestProp,
+                                           IVhalClient::Deadline deadline,
+                                           VhalClientPromise<void> promise) {
     std::lock_guard<std::mutex> lk(mLock);
     mPendingSetValueCallbacks[requestId] =
             std::make_unique<PendingSetValueRequest>(PendingSetValueRequest{
-                    .callback = callback,
+                    .promise = std::move(promise),
                     .propId = requestProp.getPropId(),
                     .areaId = requestProp.getAreaId(),
             });
-    mPendingRequestPool->addRequests(/*clientId=*/nullptr, {requestId}, mOnSetValueTimeout);
+    mPendingRequestTimer->addRequest(requestId, deadline, mOnSetValueTimeout);
 }
 
 std::unique_ptr<GetSetValueClient::PendingGetValueRequest>
@@ -405,14 +589,13 @@ GetSetValueClient::tryFinishSetValueRequest(int64_t requestId) {
 template <class T>
 std::unique_ptr<T> GetSetValueClient::tryFinishRequest(
         int64_t requestId, std::unordered_map<int64_t, std::unique_ptr<T>>* callbacks) {
-    auto finished = mPendingRequestPool->tryFinishRequests(/*clientId=*/nullptr, {requestId});
-    if (finished.empty()) {
-        return nullptr;
-    }
     auto it = callbacks->find(requestId);
     if (it == callbacks->end()) {
         return nullptr;
     }
+    if (!mPendingRequestTimer->tryFinishRequest(requestId)) {
+        return nullptr;
+    }
     auto request = std::move(it->second);
     callbacks->erase(requestId);
     return std::move(request);
@@ -443,6 +626,16 @@ ScopedAStatus GetSetValueClient::onGetValues(const GetValueResults& results) {
 void GetSetValueClient::onGetValue(const GetValueResult& result) {
     int64_t requestId = result.requestId;
 
+    {
+        std::lock_guard<std::mutex> lk(mLock);
+        if (auto syncRequest = takeSyncRequestLocked(requestId, &mSyncGetValueRequests);
+            syncRequest != nullptr) {
+            syncRequest->result = toClientResult(result, syncRequest->propId, syncRequest->areaId);
+            mSyncRequestCv.notify_all();
+            return;
+        }
+    }
+
     auto pendingRequest = tryFinishGetValueRequest(requestId);
     if (pendingRequest == nullptr) {
         ALOGD("failed to find pending request for ID: %" PRId64 ", maybe already timed-out",
@@ -450,24 +643,8 @@ void GetSetValueClient::onGetValue(const GetValueResult& result) {
         return;
     }
 
-    std::shared_ptr<AidlVhalClient::GetValueCallbackFunc> callback = pendingRequest->callback;
-    int32_t propId = pendingRequest->propId;
-    int32_t areaId = pendingRequest->areaId;
-    if (result.status != StatusCode::OK) {
-        StatusCode status = result.status;
-        (*callback)(ClientStatusError(status)
-                    << "failed to get value for propId: " << propId << ", areaId: " << areaId
-                    << ": status: " << toString(status));
-    } else if (!result.prop.has_value()) {
-        (*callback)(ClientStatusError(ErrorCode::INTERNAL_ERROR_FROM_VHAL)
-                    << "failed to get value for propId: " << propId << ", areaId: " << areaId
-                    << ": returns no value");
-    } else {
-        VehiclePropValue valueCopy = result.prop.value();
-        std::unique_ptr<IHalPropValue> propValue =
-                std::make_unique<AidlHalPropValue>(std::move(valueCopy));
-        (*callback)(std::move(propValue));
-    }
+    pendingRequest->promise.setResult(
+            toClientResult(result, pendingRequest->propId, pendingRequest->areaId));
 }
 
 ScopedAStatus GetSetValueClient::onSetValues(const SetValueResults& results) {
@@ -486,6 +663,16 @@ ScopedAStatus GetSetValueClient::onSetValues(const SetValueResults& results) {
 void GetSetValueClient::onSetValue(const SetValueResult& result) {
     int64_t requestId = result.requestId;
 
+    {
+        std::lock_guard<std::mutex> lk(mLock);
+        if (auto syncRequest = takeSyncRequestLocked(requestId, &mSyncSetValueRequests);
+            syncRequest != nullptr) {
+            syncRequest->result = toClientResult(result, syncRequest->propId, syncRequest->areaId);
+            mSyncRequestCv.notify_all();
+            return;
+        }
+    }
+
     auto pendingRequest = tryFinishSetValueRequest(requestId);
     if (pendingRequest == nullptr) {
         ALOGD("failed to find pending request for ID: %" PRId64 ", maybe already timed-out",
@@ -493,16 +680,8 @@ void GetSetValueClient::onSetValue(const SetValueResult& result) {
         return;
     }
 
-    std::shared_ptr<AidlVhalClient::SetValueCallbackFunc> callback = pendingRequest->callback;
-    int32_t propId = pendingRequest->propId;
-    int32_t areaId = pendingRequest->areaId;
-    if (result.status != StatusCode::OK) {
-        (*callback)(ClientStatusError(result.status)
-                    << "failed to set value for propId: " << propId << ", areaId: " << areaId
-                    << ": status: " << toString(result.status));
-    } else {
-        (*callback)({});
-    }
+    pendingRequest->promise.setResult(
+            toClientResult(result, pendingRequest->propId, pendingRequest->areaId));
 }
 
 ScopedAStatus GetSetValueClient::onPropertyEvent([[maybe_unused]] const VehiclePropValues&,
@@ -537,10 +716,11 @@ void GetSetValueClient::onTimeout(const std::unordered_set<int64_t>& requestIds,
             callbacks->erase(requestId);
         }
 
-        (*pendingRequest->callback)(
-                ClientStatusError(ErrorCode::TIMEOUT)
-                << "failed to get/set value for propId: " << pendingRequest->propId
-                << ", areaId: " << pendingRequest->areaId << ": request timed out");
+        pendingRequest->promise.setResult(ClientStatusError(ErrorCode::TIMEOUT)
+                                          << "failed to get/set value for propId: "
+                                          << pendingRequest->propId
+                                          << ", areaId: " << pendingRequest->areaId
+                                          << ": request timed out");
     }
 }
 
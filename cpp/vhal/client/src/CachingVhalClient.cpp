@@ -0,0 +1,431 @@
+/*
+ * Copyright (c) 2024, The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "CachingVhalClient.h"
+
+#include <aidl/android/hardware/automotive/vehicle/VehiclePropertyChangeMode.h>
+#include <android-base/stringprintf.h>
+#include <utils/Log.h>
+#include <utils/SystemClock.h>
+
+#include <VehicleUtils.h>
+#include <inttypes.h>
+
+#include <algorithm>
+#include <vector>
+
+namespace android {
+namespace frameworks {
+namespace automotive {
+namespace vhal {
+
+using ::aidl::android::hardware::automotive::vehicle::VehiclePropertyChangeMode;
+using ::android::base::StringPrintf;
+using ::android::hardware::automotive::vehicle::toInt;
+
+namespace {
+
+constexpr int64_t kMillisToNanos = 1'000'000;
+
+// Get requests that carry a payload ask VHAL for a value computed from the payload, so their
+// results must not be shared with other requests.
+bool hasPayload(const IHalPropValue& value) {
+    return !value.getInt32Values().empty() || !value.getInt64Values().empty() ||
+            !value.getFloatValues().empty() || !value.getByteValues().empty() ||
+            !value.getStringValue().empty();
+}
+
+}  // namespace
+
+float CacheStats::getHitRate() const {
+    uint64_t total = hitCount + missCount;
+    return total == 0 ? 0.0f : static_cast<float>(hitCount) / static_cast<float>(total);
+}
+
+std::string CacheStats::toString() const {
+    return StringPrintf("hits: %" PRIu64 ", misses: %" PRIu64 ", bypassed: %" PRIu64
+                        ", hit rate: %.2f%%",
+                        hitCount, missCount, bypassCount, getHitRate() * 100.0f);
+}
+
+class CachingVhalClient::SubscriptionCallback final : public ISubscriptionCallback {
+public:
+    SubscriptionCallback(std::weak_ptr<ValueCache> cache, std::function<int64_t()> getTimeNsFunc) :
+          mCache(std::move(cache)), mGetTimeNsFunc(std::move(getTimeNsFunc)) {}
+
+    void onPropertyEvent(const std::vector<std::unique_ptr<IHalPropValue>>& values) override {
+        auto cache = mCache.lock();
+        if (cache == nullptr) {
+            return;
+        }
+        int64_t nowNs = mGetTimeNsFunc();
+        std::lock_guard<std::mutex> lk(cache->lock);
+        for (const auto& value : values) {
+            cache->storeLocked(*value, nowNs);
+        }
+    }
+
+    void onPropertySetError(const std::vector<HalPropError>& errors) override {
+        auto cache = mCache.lock();
+        if (cache == nullptr) {
+            return;
+        }
+        // VHAL failed to apply a value, so the cached value may not reflect the property anymore.
+        std::lock_guard<std::mutex> lk(cache->lock);
+        for (const auto& error : errors) {
+            cache->invalidateLocked(error.propId, error.areaId);
+        }
+    }
+
+private:
+    const std::weak_ptr<ValueCache> mCache;
+    const std::function<int64_t()> mGetTimeNsFunc;
+};
+
+void CachingVhalClient::ValueCache::storeLocked(const IHalPropValue& value, int64_t nowNs) {
+    CacheEntry& entry = entriesByKey[toKey(value.getPropId(), value.getAreaId())];
+    if (entry.value != nullptr && entry.value->getTimestamp() > value.getTimestamp()) {
+        // An older value, for example a get result that raced with a newer property event.
+        return;
+    }
+    entry.value = value.clone();
+    entry.refreshTimeNs = nowNs;
+}
+
+void CachingVhalClient::ValueCache::invalidateLocked(int32_t propId, int32_t areaId) {
+    entriesByKey.erase(toKey(propId, areaId));
+    generation++;
+}
+
+bool CachingVhalClient::ValueCache::isSubscribedLocked(int32_t propId) {
+    auto it = subscriptionsByPropId.find(propId);
+    return it != subscriptionsByPropId.end() && it->second.state == SubscriptionState::SUBSCRIBED;
+}
+
+void CachingVhalClient::ValueCache::clear() {
+    std::lock_guard<std::mutex> lk(lock);
+    entriesByKey.clear();
+    subscriptionsByPropId.clear();
+    generation++;
+    subscriptionGeneration++;
+}
+
+std::shared_ptr<CachingVhalClient> CachingVhalClient::create(std::shared_ptr<IVhalClient> client,
+                                                             int64_t maxStalenessInMs) {
+    if (client == nullptr) {
+        return nullptr;
+    }
+    return std::make_shared<CachingVhalClient>(std::move(client), maxStalenessInMs,
+                                               [] { return elapsedRealtimeNano(); });
+}
+
+CachingVhalClient::CachingVhalClient(std::shared_ptr<IVhalClient> client, int64_t maxStalenessInMs,
+                                     std::function<int64_t()> getTimeNsFunc) :
+      mClient(std::move(client)),
+      mMaxStalenessNs(maxStalenessInMs * kMillisToNanos),
+      mGetTimeNsFunc(std::move(getTimeNsFunc)),
+      mCache(std::make_shared<ValueCache>()),
+      mOnBinderDiedCallback(std::make_shared<OnBinderDiedCallbackFunc>(
+              [cache = std::weak_ptr<ValueCache>(mCache)] {
+                  // Subscriptions don't survive the VHAL's death, so the cached values can't be
+                  // trusted anymore.
+                  if (auto c = cache.lock(); c != nullptr) {
+                      c->clear();
+                  }
+              })) {
+    mSubscriptionClient = mClient->getSubscriptionClient(
+            std::make_shared<SubscriptionCallback>(mCache, mGetTimeNsFunc));
+    if (auto result = mClient->addOnBinderDiedCallback(mOnBinderDiedCallback); !result.ok()) {
+        ALOGW("failed to add binder died callback, error: %s", result.error().message().c_str());
+    }
+}
+
+CachingVhalClient::~CachingVhalClient() {
+    if (auto result = mClient->removeOnBinderDiedCallback(mOnBinderDiedCallback); !result.ok()) {
+        ALOGW("failed to remove binder died callback, error: %s",
+              result.error().message().c_str());
+    }
+    std::vector<int32_t> propIds;
+    {
+        std::lock_guard<std::mutex> lk(mCache->lock);
+        for (const auto& [propId, subscription] : mCache->subscriptionsByPropId) {
+            if (subscription.state == SubscriptionState::SUBSCRIBED) {
+                propIds.push_back(propId);
+            }
+        }
+    }
+    if (!propIds.empty() && mSubscriptionClient != nullptr) {
+        if (auto result = mSubscriptionClient->unsubscribe(propIds); !result.ok()) {
+            ALOGW("failed to unsubscribe cached properties, error: %s",
+                  result.error().message().c_str());
+        }
+    }
+}
+
+int64_t CachingVhalClient::toKey(int32_t propId, int32_t areaId) {
+    return (static_cast<int64_t>(propId) << 32) | static_cast<uint32_t>(areaId);
+}
+
+CachingVhalClient::CachePolicy CachingVhalClient::getCachePolicy(
+        const IHalPropValue& requestValue) {
+    if (hasPayload(requestValue)) {
+        return CachePolicy::BYPASS;
+    }
+    int32_t propId = requestValue.getPropId();
+    {
+        std::lock_guard<std::mutex> lk(mCache->lock);
+        if (auto it = mCache->policyByPropId.find(propId); it != mCache->policyByPropId.end()) {
+            return it->second;
+        }
+    }
+    auto result = mClient->getPropConfigs({propId});
+    if (!result.ok() || result.value().empty()) {
+        // Don't remember the policy so the lookup is retried on the next request.
+        return CachePolicy::BYPASS;
+    }
+    CachePolicy policy = CachePolicy::BYPASS;
+    int32_t changeMode = result.value()[0]->getChangeMode();
+    if (changeMode == toInt(VehiclePropertyChangeMode::ON_CHANGE)) {
+        policy = CachePolicy::ON_CHANGE;
+    } else if (changeMode == toInt(VehiclePropertyChangeMode::STATIC)) {
+        policy = CachePolicy::STATIC;
+    }
+    std::lock_guard<std::mutex> lk(mCache->lock);
+    mCache->policyByPropId[propId] = policy;
+    return policy;
+}
+
+std::unique_ptr<IHalPropValue> CachingVhalClient::lookUp(const IHalPropValue& requestValue,
+                                                         CachePolicy policy,
+                                                         uint64_t* generation,
+                                                         bool* shouldSubscribe) {
+    std::lock_guard<std::mutex> lk(mCache->lock);
+    *generation = mCache->generation;
+    *shouldSubscribe = false;
+    if (policy == CachePolicy::ON_CHANGE) {
+        auto it = mCache->subscriptionsByPropId.find(requestValue.getPropId());
+        *shouldSubscribe = it == mCache->subscriptionsByPropId.end() ||
+                it->second.state == SubscriptionState::NOT_SUBSCRIBED ||
+                (it->second.state == SubscriptionState::FAILED &&
+                 mGetTimeNsFunc() >= it->second.nextRetryTimeNs);
+    }
+    auto it = mCache->entriesByKey.find(toKey(requestValue.getPropId(), requestValue.getAreaId()));
+    // Property events keep the value of a subscribed property up to date, so it stays valid until
+    // it is invalidated. Without a subscription, lost updates are only bounded by the staleness.
+    if (it != mCache->entriesByKey.end() && it->second.value != nullptr &&
+        (policy == CachePolicy::STATIC || mCache->isSubscribedLocked(requestValue.getPropId()) ||
+         mGetTimeNsFunc() - it->second.refreshTimeNs <= mMaxStalenessNs)) {
+        mCache->stats.hitCount++;
+        return it->second.value->clone();
+    }
+    mCache->stats.missCount++;
+    return nullptr;
+}
+
+void CachingVhalClient::maybeSubscribe(int32_t propId) {
+    if (mSubscriptionClient == nullptr) {
+        return;
+    }
+    uint64_t subscriptionGeneration = 0;
+    {
+        std::lock_guard<std::mutex> lk(mCache->lock);
+        Subscription& subscription = mCache->subscriptionsByPropId[propId];
+        if (subscription.state == SubscriptionState::SUBSCRIBING ||
+            subscription.state == SubscriptionState::SUBSCRIBED ||
+            (subscription.state == SubscriptionState::FAILED &&
+             mGetTimeNsFunc() < subscription.nextRetryTimeNs)) {
+            return;
+        }
+        subscription.state = SubscriptionState::SUBSCRIBING;
+        subscriptionGeneration = mCache->subscriptionGeneration;
+    }
+    auto result = mSubscriptionClient->subscribe({SubscribeOptionsBuilder(propId).build()});
+    std::lock_guard<std::mutex> lk(mCache->lock);
+    if (mCache->subscriptionGeneration != subscriptionGeneration) {
+        // VHAL died during the subscription.
+        return;
+    }
+    Subscription& subscription = mCache->subscriptionsByPropId[propId];
+    if (result.ok()) {
+        subscription.state = SubscriptionState::SUBSCRIBED;
+        subscription.failureCount = 0;
+        return;
+    }
+    int64_t retryDelayMs = SUBSCRIPTION_RETRY_INITIAL_DELAY_IN_MS;
+    for (int32_t i = 0;
+         i < subscription.failureCount && retryDelayMs < SUBSCRIPTION_RETRY_MAX_DELAY_IN_MS; i++) {
+        retryDelayMs *= 2;
+    }
+    retryDelayMs = std::min(retryDelayMs, SUBSCRIPTION_RETRY_MAX_DELAY_IN_MS);
+    subscription.state = SubscriptionState::FAILED;
+    subscription.failureCount++;
+    subscription.nextRetryTimeNs = mGetTimeNsFunc() + retryDelayMs * kMillisToNanos;
+    // Until the retry succeeds, the cached value is refreshed only by get requests.
+    ALOGW("failed to subscribe to property: %" PRId32 ", retrying in %" PRId64 " ms, error: %s",
+          propId, retryDelayMs, result.error().message().c_str());
+}
+
+void CachingVhalClient::storeFetchedValue(const IHalPropValue& value, uint64_t generation) {
+    std::lock_guard<std::mutex> lk(mCache->lock);
+    if (mCache->generation != generation) {
+        return;
+    }
+    mCache->storeLocked(value, mGetTimeNsFunc());
+}
+
+void CachingVhalClient::invalidate(const IHalPropValue& value) {
+    std::lock_guard<std::mutex> lk(mCache->lock);
+    mCache->invalidateLocked(value.getPropId(), value.getAreaId());
+}
+
+bool CachingVhalClient::isAidlVhal() {
+    return mClient->isAidlVhal();
+}
+
+std::unique_ptr<IHalPropValue> CachingVhalClient::createHalPropValue(int32_t propId) {
+    return mClient->createHalPropValue(propId);
+}
+
+std::unique_ptr<IHalPropValue> CachingVhalClient::createHalPropValue(int32_t propId,
+                                                                     int32_t areaId) {
+    return mClient->createHalPropValue(propId, areaId);
+}
+
+void CachingVhalClient::getValue(const IHalPropValue& requestValue,
+                                 std::shared_ptr<GetValueCallbackFunc> callback) {
+    getValueAsync(requestValue)
+            .then([callback](VhalClientResult<std::unique_ptr<IHalPropValue>> result) {
+                (*callback)(std::move(result));
+            });
+}
+
+VhalClientFuture<std::unique_ptr<IHalPropValue>> CachingVhalClient::getValueAsync(
+        const IHalPropValue& requestValue, Deadline deadline) {
+    CachePolicy policy = getCachePolicy(requestValue);
+    if (policy == CachePolicy::BYPASS) {
+        {
+            std::lock_guard<std::mutex> lk(mCache->lock);
+            mCache->stats.bypassCount++;
+        }
+        return mClient->getValueAsync(requestValue, deadline);
+    }
+    uint64_t generation = 0;
+    bool shouldSubscribe = false;
+    auto value = lookUp(requestValue, policy, &generation, &shouldSubscribe);
+    if (shouldSubscribe) {
+        maybeSubscribe(requestValue.getPropId());
+    }
+    if (value != nullptr) {
+        VhalClientPromise<std::unique_ptr<IHalPropValue>> promise;
+        promise.setResult(std::move(value));
+        return promise.getFuture();
+    }
+    return mClient->getValueAsync(requestValue, deadline)
+            .then([cache = std::weak_ptr<ValueCache>(mCache), getTimeNsFunc = mGetTimeNsFunc,
+                   generation](VhalClientResult<std::unique_ptr<IHalPropValue>> result) {
+                if (auto c = cache.lock(); c != nullptr && result.ok()) {
+                    std::lock_guard<std::mutex> lk(c->lock);
+                    if (c->generation == generation) {
+                        c->storeLocked(*result.value(), getTimeNsFunc());
+                    }
+                }
+                return result;
+            });
+}
+
+VhalClientResult<std::unique_ptr<IHalPropValue>> CachingVhalClient::getValueSync(
+        const IHalPropValue& requestValue) {
+    CachePolicy policy = getCachePolicy(requestValue);
+    if (policy == CachePolicy::BYPASS) {
+        {
+            std::lock_guard<std::mutex> lk(mCache->lock);
+            mCache->stats.bypassCount++;
+        }
+        return mClient->getValueSync(requestValue);
+    }
+    uint64_t generation = 0;
+    bool shouldSubscribe = false;
+    auto value = lookUp(requestValue, policy, &generation, &shouldSubscribe);
+    if (shouldSubscribe) {
+        maybeSubscribe(requestValue.getPropId());
+    }
+    if (value != nullptr) {
+        return value;
+    }
+    auto result = mClient->getValueSync(requestValue);
+    if (result.ok()) {
+        storeFetchedValue(*result.value(), generation);
+    }
+    return result;
+}
+
+void CachingVhalClient::setValue(const IHalPropValue& requestValue,
+                                 std::shared_ptr<SetValueCallbackFunc> callback) {
+    // VHAL may apply the value asynchronously, so the next get request must go to VHAL until the
+    // property event for the new value arrives.
+    invalidate(requestValue);
+    mClient->setValue(requestValue, std::move(callback));
+}
+
+VhalClientFuture<void> CachingVhalClient::setValueAsync(const IHalPropValue& requestValue,
+                                                        Deadline deadline) {
+    invalidate(requestValue);
+    return mClient->setValueAsync(requestValue, deadline);
+}
+
+VhalClientResult<void> CachingVhalClient::setValueSync(const IHalPropValue& requestValue) {
+    invalidate(requestValue);
+    return mClient->setValueSync(requestValue);
+}
+
+VhalClientResult<void> CachingVhalClient::addOnBinderDiedCallback(
+        std::shared_ptr<OnBinderDiedCallbackFunc> callback) {
+    return mClient->addOnBinderDiedCallback(std::move(callback));
+}
+
+VhalClientResult<void> CachingVhalClient::removeOnBinderDiedCallback(
+        std::shared_ptr<OnBinderDiedCallbackFunc> callback) {
+    return mClient->removeOnBinderDiedCallback(std::move(callback));
+}
+
+VhalClientResult<std::vector<std::unique_ptr<IHalPropConfig>>>
+CachingVhalClient::getAllPropConfigs() {
+    return mClient->getAllPropConfigs();
+}
+
+VhalClientResult<std::vector<std::unique_ptr<IHalPropConfig>>> CachingVhalClient::getPropConfigs(
+        std::vector<int32_t> propIds) {
+    return mClient->getPropConfigs(std::move(propIds));
+}
+
+std::unique_ptr<ISubscriptionClient> CachingVhalClient::getSubscriptionClient(
+        std::shared_ptr<ISubscriptionCallback> callback) {
+    return mClient->getSubscriptionClient(std::move(callback));
+}
+
+int32_t CachingVhalClient::getRemoteInterfaceVersion() {
+    return mClient->getRemoteInterfaceVersion();
+}
+
+CacheStats CachingVhalClient::getCacheStats() {
+    std::lock_guard<std::mutex> lk(mCache->lock);
+    return mCache->stats;
+}
+
+}  // namespace vhal
+}  // namespace automotive
+}  // namespace frameworks
+}  // namespace android
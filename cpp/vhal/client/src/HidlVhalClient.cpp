@@ -23,7 +23,10 @@
 #include <utils/Log.h>
 
 #include <VehicleUtils.h>
+#include <inttypes.h>
+#include <pthread.h>
 
+#include <algorithm>
 #include <memory>
 #include <vector>
 
@@ -36,6 +39,7 @@ namespace {
 
 using ::android::sp;
 using ::android::wp;
+using ::android::base::ScopedLockAssertion;
 using ::android::hardware::hidl_vec;
 using ::android::hardware::Return;
 using ::android::hardware::automotive::vehicle::toInt;
@@ -51,6 +55,10 @@ aidl::android::hardware::automotive::vehicle::StatusCode toAidlStatusCode(Status
     return static_cast<aidl::android::hardware::automotive::vehicle::StatusCode>(code);
 }
 
+int64_t toRequestKey(const VehiclePropValue& value) {
+    return (static_cast<int64_t>(value.prop) << 32) | static_cast<uint32_t>(value.areaId);
+}
+
 }  // namespace
 
 std::shared_ptr<IVhalClient> HidlVhalClient::create() {
@@ -78,12 +86,32 @@ std::shared_ptr<IVhalClient> HidlVhalClient::tryCreate(const char* descriptor) {
     return std::make_shared<HidlVhalClient>(hidlVhal);
 }
 
-HidlVhalClient::HidlVhalClient(sp<IVehicle> hal) : mHal(hal) {
+HidlVhalClient::HidlVhalClient(sp<IVehicle> hal) :
+      HidlVhalClient(hal, DEFAULT_TIMEOUT_IN_SEC * 1'000, DEFAULT_WORKER_THREAD_COUNT) {}
+
+HidlVhalClient::HidlVhalClient(sp<IVehicle> hal, int64_t timeoutInMs, size_t workerThreadCount) :
+      mHal(hal), mWorkerThreadCount(std::max(workerThreadCount, static_cast<size_t>(1))) {
     mDeathRecipient = sp<HidlVhalClient::DeathRecipient>::make(this);
     mHal->linkToDeath(mDeathRecipient, /*cookie=*/0);
+    mPendingRequestTimer = std::make_unique<PendingRequestTimer>(timeoutInMs);
+    mOnTimeout = std::make_shared<PendingRequestTimer::TimeoutCallbackFunc>(
+            [this](const std::unordered_set<int64_t>& requestIds) { onTimeout(requestIds); });
 }
 
 HidlVhalClient::~HidlVhalClient() {
+    std::vector<std::thread> workerThreads;
+    {
+        std::lock_guard<std::mutex> lk(mRequestLock);
+        mStopping = true;
+        workerThreads = std::move(mWorkerThreads);
+    }
+    mWorkerCv.notify_all();
+    for (auto& thread : workerThreads) {
+        thread.join();
+    }
+    // Stop the timer, which waits for a running timeout callback and marks all the pending
+    // requests as timed-out.
+    mPendingRequestTimer.reset();
     mHal->unlinkToDeath(mDeathRecipient);
 }
 
@@ -101,50 +129,254 @@ std::unique_ptr<IHalPropValue> HidlVhalClient::createHalPropValue(int32_t propId
 
 void HidlVhalClient::getValue(const IHalPropValue& requestValue,
                               std::shared_ptr<GetValueCallbackFunc> callback) {
-    const VehiclePropValue* propValue =
-            reinterpret_cast<const VehiclePropValue*>(requestValue.toVehiclePropValue());
-    int32_t propId = requestValue.getPropId();
-    int32_t areaId = requestValue.getAreaId();
-    auto result =
-            mHal->get(*propValue,
-                      [callback, propId, areaId](StatusCode status, const VehiclePropValue& value) {
-                          if (status == StatusCode::OK) {
-                              VehiclePropValue valueCopy = value;
-                              (*callback)(std::make_unique<HidlHalPropValue>(std::move(valueCopy)));
-                          } else {
-                              (*callback)(ClientStatusError(toAidlStatusCode(status))
-                                          << "failed to get value for prop: " << propId
-                                          << ", areaId: " << areaId
-                                          << ": status code: " << toInt(status));
-                          }
-                      });
+    getValueAsync(requestValue)
+            .then([callback](VhalClientResult<std::unique_ptr<IHalPropValue>> result) {
+                (*callback)(std::move(result));
+            });
+}
 
-    if (!result.isOk()) {
-        (*callback)(ClientStatusError(toAidlStatusCode(StatusCode::TRY_AGAIN))
-                    << "failed to get value for prop: " << requestValue.getPropId() << ", areaId: "
-                    << requestValue.getAreaId() << ": error: " << result.description());
+VhalClientFuture<std::unique_ptr<IHalPropValue>> HidlVhalClient::getValueAsync(
+        const IHalPropValue& requestValue, Deadline deadline) {
+    if (deadline <= std::chrono::steady_clock::now()) {
+        return IVhalClient::getValueAsync(requestValue, deadline);
     }
+    PendingRequest pendingRequest{
+            .isGetValue = true,
+            .propId = requestValue.getPropId(),
+            .areaId = requestValue.getAreaId(),
+    };
+    auto future = pendingRequest.getValuePromise.getFuture();
+    enqueueRequest(requestValue, deadline, std::move(pendingRequest));
+    return future;
+}
+
+VhalClientResult<std::unique_ptr<IHalPropValue>> HidlVhalClient::getValueSync(
+        const IHalPropValue& requestValue) {
+    return getValueFromHal(
+            *reinterpret_cast<const VehiclePropValue*>(requestValue.toVehiclePropValue()));
 }
 
 void HidlVhalClient::setValue(const IHalPropValue& value,
                               std::shared_ptr<HidlVhalClient::SetValueCallbackFunc> callback) {
-    const VehiclePropValue* propValue =
-            reinterpret_cast<const VehiclePropValue*>(value.toVehiclePropValue());
-    auto result = mHal->set(*propValue);
+    setValueAsync(value).then(
+            [callback](VhalClientResult<void> result) { (*callback)(std::move(result)); });
+}
+
+VhalClientFuture<void> HidlVhalClient::setValueAsync(const IHalPropValue& value,
+                                                     Deadline deadline) {
+    if (deadline <= std::chrono::steady_clock::now()) {
+        return IVhalClient::setValueAsync(value, deadline);
+    }
+    PendingRequest pendingRequest{
+            .isGetValue = false,
+            .propId = value.getPropId(),
+            .areaId = value.getAreaId(),
+    };
+    auto future = pendingRequest.setValuePromise.getFuture();
+    enqueueRequest(value, deadline, std::move(pendingRequest));
+    return future;
+}
+
+VhalClientResult<void> HidlVhalClient::setValueSync(const IHalPropValue& value) {
+    return setValueToHal(*reinterpret_cast<const VehiclePropValue*>(value.toVehiclePropValue()));
+}
+
+VhalClientResult<std::unique_ptr<IHalPropValue>> HidlVhalClient::getValueFromHal(
+        const VehiclePropValue& requestValue) {
+    StatusCode status = StatusCode::OK;
+    VehiclePropValue gotValue;
+    auto result = mHal->get(requestValue,
+                            [&status, &gotValue](StatusCode s, const VehiclePropValue& value) {
+                                status = s;
+                                if (s == StatusCode::OK) {
+                                    gotValue = value;
+                                }
+                            });
     if (!result.isOk()) {
-        (*callback)(ClientStatusError(toAidlStatusCode(StatusCode::TRY_AGAIN))
-                    << "failed to set value for prop: " << value.getPropId()
-                    << ", areaId: " << value.getAreaId() << ": error: " << result.description());
-        return;
+        return ClientStatusError(toAidlStatusCode(StatusCode::TRY_AGAIN))
+                << "failed to get value for prop: " << requestValue.prop
+                << ", areaId: " << requestValue.areaId << ": error: " << result.description();
+    }
+    if (status != StatusCode::OK) {
+        return ClientStatusError(toAidlStatusCode(status))
+                << "failed to get value for prop: " << requestValue.prop
+                << ", areaId: " << requestValue.areaId << ": status code: " << toInt(status);
+    }
+    return std::make_unique<HidlHalPropValue>(std::move(gotValue));
+}
+
+VhalClientResult<void> HidlVhalClient::setValueToHal(const VehiclePropValue& value) {
+    auto result = mHal->set(value);
+    if (!result.isOk()) {
+        return ClientStatusError(toAidlStatusCode(StatusCode::TRY_AGAIN))
+                << "failed to set value for prop: " << value.prop << ", areaId: " << value.areaId
+                << ": error: " << result.description();
     }
     StatusCode status = result;
     if (status != StatusCode::OK) {
-        (*callback)(ClientStatusError(toAidlStatusCode(status))
-                    << "failed to set value for prop: " << value.getPropId()
-                    << ", areaId: " << value.getAreaId() << ": status code: " << toInt(status));
+        return ClientStatusError(toAidlStatusCode(status))
+                << "failed to set value for prop: " << value.prop << ", areaId: " << value.areaId
+                << ": status code: " << toInt(status);
+    }
+    return {};
+}
+
+void HidlVhalClient::enqueueRequest(const IHalPropValue& value, Deadline deadline,
+                                    PendingRequest pendingRequest) {
+    int64_t requestId = mRequestId++;
+    bool isGetValue = pendingRequest.isGetValue;
+    {
+        std::lock_guard<std::mutex> lk(mRequestLock);
+        if (!mStopping && mQueuedRequests.size() < MAX_QUEUED_REQUEST_COUNT) {
+            mQueuedRequests.push_back(QueuedRequest{
+                    .requestId = requestId,
+                    .isGetValue = isGetValue,
+                    .value = *reinterpret_cast<const VehiclePropValue*>(
+                            value.toVehiclePropValue()),
+            });
+            mPendingRequests[requestId] = std::move(pendingRequest);
+            mPendingRequestTimer->addRequest(requestId, deadline, mOnTimeout);
+            mActiveRequestCount++;
+            if (mIdleWorkerCount == 0 && mWorkerThreads.size() < mWorkerThreadCount) {
+                mWorkerThreads.emplace_back([this] { runWorker(); });
+            }
+            mWorkerCv.notify_one();
+            return;
+        }
+    }
+    if (isGetValue) {
+        pendingRequest.getValuePromise.setResult(ClientStatusError(ErrorCode::TRY_AGAIN_FROM_VHAL)
+                                                 << "failed to queue request for prop: "
+                                                 << value.getPropId()
+                                                 << ", areaId: " << value.getAreaId()
+                                                 << ": too many pending requests");
+    } else {
+        pendingRequest.setValuePromise.setResult(ClientStatusError(ErrorCode::TRY_AGAIN_FROM_VHAL)
+                                                 << "failed to queue request for prop: "
+                                                 << value.getPropId()
+                                                 << ", areaId: " << value.getAreaId()
+                                                 << ": too many pending requests");
+    }
+}
+
+void HidlVhalClient::runWorker() {
+    if (int result = pthread_setname_np(pthread_self(), "HidlVhalWorker"); result != 0) {
+        ALOGW("failed to set worker thread name, error: %d", result);
+    }
+    std::unique_lock<std::mutex> lk(mRequestLock);
+    while (true) {
+        mIdleWorkerCount++;
+        mWorkerCv.wait(lk, [this] {
+            ScopedLockAssertion lockAssertion(mRequestLock);
+            return mStopping || findRunnableRequestLocked() != mQueuedRequests.end();
+        });
+        mIdleWorkerCount--;
+        if (mStopping) {
+            return;
+        }
+        auto it = findRunnableRequestLocked();
+        QueuedRequest request = std::move(*it);
+        mQueuedRequests.erase(it);
+        if (!request.isGetValue) {
+            mRunningSetRequestKeys.insert(toRequestKey(request.value));
+        }
+        lk.unlock();
+        runRequest(request);
+        lk.lock();
+        if (!request.isGetValue) {
+            // A set request waiting for this key is picked up by this worker on the next wait.
+            mRunningSetRequestKeys.erase(toRequestKey(request.value));
+        }
+        if (--mActiveRequestCount == 0) {
+            mIdleCv.notify_all();
+        }
+    }
+}
+
+std::deque<HidlVhalClient::QueuedRequest>::iterator HidlVhalClient::findRunnableRequestLocked() {
+    return std::find_if(mQueuedRequests.begin(), mQueuedRequests.end(),
+                        [this](const QueuedRequest& request) {
+                            ScopedLockAssertion lockAssertion(mRequestLock);
+                            return request.isGetValue ||
+                                    mRunningSetRequestKeys.find(toRequestKey(request.value)) ==
+                                    mRunningSetRequestKeys.end();
+                        });
+}
+
+void HidlVhalClient::runRequest(const QueuedRequest& request) {
+    {
+        std::lock_guard<std::mutex> lk(mRequestLock);
+        auto it = mPendingRequests.find(request.requestId);
+        if (it == mPendingRequests.end() ||
+            !mPendingRequestTimer->isRequestPending(request.requestId)) {
+            // Timed out while waiting for a worker thread.
+            return;
+        }
+    }
+    if (request.isGetValue) {
+        auto result = getValueFromHal(request.value);
+        if (auto pendingRequest = tryFinishRequest(request.requestId);
+            pendingRequest.has_value()) {
+            pendingRequest->getValuePromise.setResult(std::move(result));
+        }
         return;
     }
-    (*callback)({});
+    auto result = setValueToHal(request.value);
+    if (auto pendingRequest = tryFinishRequest(request.requestId); pendingRequest.has_value()) {
+        pendingRequest->setValuePromise.setResult(std::move(result));
+    }
+}
+
+std::optional<HidlVhalClient::PendingRequest> HidlVhalClient::tryFinishRequest(int64_t requestId) {
+    std::lock_guard<std::mutex> lk(mRequestLock);
+    auto it = mPendingRequests.find(requestId);
+    if (it == mPendingRequests.end()) {
+        return std::nullopt;
+    }
+    if (!mPendingRequestTimer->tryFinishRequest(requestId)) {
+        return std::nullopt;
+    }
+    PendingRequest pendingRequest = std::move(it->second);
+    mPendingRequests.erase(it);
+    return pendingRequest;
+}
+
+void HidlVhalClient::onTimeout(const std::unordered_set<int64_t>& requestIds) {
+    for (int64_t requestId : requestIds) {
+        PendingRequest pendingRequest;
+        {
+            std::lock_guard<std::mutex> lk(mRequestLock);
+            auto it = mPendingRequests.find(requestId);
+            if (it == mPendingRequests.end()) {
+                ALOGW("failed to find the timed-out pending request for ID: %" PRId64 ", ignore",
+                      requestId);
+                continue;
+            }
+            pendingRequest = std::move(it->second);
+            mPendingRequests.erase(it);
+        }
+        if (pendingRequest.isGetValue) {
+            pendingRequest.getValuePromise.setResult(ClientStatusError(ErrorCode::TIMEOUT)
+                                                     << "failed to get value for propId: "
+                                                     << pendingRequest.propId
+                                                     << ", areaId: " << pendingRequest.areaId
+                                                     << ": request timed out");
+        } else {
+            pendingRequest.setValuePromise.setResult(ClientStatusError(ErrorCode::TIMEOUT)
+                                                     << "failed to set value for propId: "
+                                                     << pendingRequest.propId
+                                                     << ", areaId: " << pendingRequest.areaId
+                                                     << ": request timed out");
+        }
+    }
+}
+
+void HidlVhalClient::waitForPendingRequests() {
+    std::unique_lock<std::mutex> lk(mRequestLock);
+    mIdleCv.wait(lk, [this] {
+        ScopedLockAssertion lockAssertion(mRequestLock);
+        return mActiveRequestCount == 0;
+    });
 }
 
 // Add the callback that would be called when VHAL binder died.
@@ -22,9 +22,6 @@
 #include <android-base/stringprintf.h>
 #include <android/hardware/automotive/vehicle/2.0/IVehicle.h>
 
-#include <condition_variable>  // NOLINT
-#include <mutex>               // NOLINT
-
 namespace android {
 namespace frameworks {
 namespace automotive {
@@ -60,55 +57,46 @@ std::shared_ptr<IVhalClient> IVhalClient::tryCreateHidlClient(const char* descri
 
 VhalClientResult<std::unique_ptr<IHalPropValue>> IVhalClient::getValueSync(
         const IHalPropValue& requestValue) {
-    struct {
-        std::mutex lock;
-        std::condition_variable cv;
-        VhalClientResult<std::unique_ptr<IHalPropValue>> result;
-        bool gotResult = false;
-    } s;
-
-    auto callback = std::make_shared<IVhalClient::GetValueCallbackFunc>(
-            [&s](VhalClientResult<std::unique_ptr<IHalPropValue>> r) {
-                {
-                    std::lock_guard<std::mutex> lockGuard(s.lock);
-                    s.result = std::move(r);
-                    s.gotResult = true;
-                    s.cv.notify_one();
-                }
-            });
-
-    getValue(requestValue, callback);
-
-    std::unique_lock<std::mutex> lk(s.lock);
-    s.cv.wait(lk, [&s] { return s.gotResult; });
-
-    return std::move(s.result);
+    return getValueAsync(requestValue).get();
+}
+
+VhalClientFuture<std::unique_ptr<IHalPropValue>> IVhalClient::getValueAsync(
+        const IHalPropValue& requestValue, Deadline deadline) {
+    VhalClientPromise<std::unique_ptr<IHalPropValue>> promise;
+    auto future = promise.getFuture();
+    if (deadline <= std::chrono::steady_clock::now()) {
+        promise.setResult(ClientStatusError(ErrorCode::TIMEOUT)
+                          << "failed to get value for prop: " << requestValue.getPropId()
+                          << ", areaId: " << requestValue.getAreaId() << ": deadline exceeded");
+        return future;
+    }
+    getValue(requestValue,
+             std::make_shared<GetValueCallbackFunc>(
+                     [promise](VhalClientResult<std::unique_ptr<IHalPropValue>> result) {
+                         promise.setResult(std::move(result));
+                     }));
+    return future;
 }
 
 VhalClientResult<void> IVhalClient::setValueSync(const IHalPropValue& requestValue) {
-    struct {
-        std::mutex lock;
-        std::condition_variable cv;
-        VhalClientResult<void> result;
-        bool gotResult = false;
-    } s;
-
-    auto callback =
-            std::make_shared<IVhalClient::SetValueCallbackFunc>([&s](VhalClientResult<void> r) {
-                {
-                    std::lock_guard<std::mutex> lockGuard(s.lock);
-                    s.result = std::move(r);
-                    s.gotResult = true;
-                    s.cv.notify_one();
-                }
-            });
-
-    setValue(requestValue, callback);
-
-    std::unique_lock<std::mutex> lk(s.lock);
-    s.cv.wait(lk, [&s] { return s.gotResult; });
-
-    return std::move(s.result);
+    return setValueAsync(requestValue).get();
+}
+
+VhalClientFuture<void> IVhalClient::setValueAsync(const IHalPropValue& requestValue,
+                                                  Deadline deadline) {
+    VhalClientPromise<void> promise;
+    auto future = promise.getFuture();
+    if (deadline <= std::chrono::steady_clock::now()) {
+        promise.setResult(ClientStatusError(ErrorCode::TIMEOUT)
+                          << "failed to set value for prop: " << requestValue.getPropId()
+                          << ", areaId: " << requestValue.getAreaId() << ": deadline exceeded");
+        return future;
+    }
+    setValue(requestValue,
+             std::make_shared<SetValueCallbackFunc>([promise](VhalClientResult<void> result) {
+                 promise.setResult(std::move(result));
+             }));
+    return future;
 }
 
 ErrorCode VhalClientError::value() const {
@@ -0,0 +1,134 @@
+/*
+ * Copyright (c) 2024, The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "PendingRequestTimer.h"
+
+#include <utils/Log.h>
+
+#include <pthread.h>
+
+#include <utility>
+
+namespace android {
+namespace frameworks {
+namespace automotive {
+namespace vhal {
+
+PendingRequestTimer::PendingRequestTimer(int64_t defaultTimeoutInMs) :
+      mDefaultTimeout(defaultTimeoutInMs) {
+    mThread = std::thread([this] { runTimer(); });
+}
+
+PendingRequestTimer::~PendingRequestTimer() {
+    {
+        std::lock_guard<std::mutex> lk(mLock);
+        mStopping = true;
+    }
+    mCv.notify_all();
+    mThread.join();
+    reset();
+}
+
+void PendingRequestTimer::addRequest(int64_t requestId, Deadline deadline,
+                                     std::shared_ptr<const TimeoutCallbackFunc> callback) {
+    if (deadline == Deadline::max()) {
+        deadline = std::chrono::steady_clock::now() + mDefaultTimeout;
+    }
+    bool isEarliest;
+    {
+        std::lock_guard<std::mutex> lk(mLock);
+        auto it = mRequestIdsByDeadline.emplace(deadline, requestId);
+        mPendingRequests[requestId] = PendingRequest{
+                .deadlineIt = it,
+                .callback = std::move(callback),
+        };
+        isEarliest = it == mRequestIdsByDeadline.begin();
+    }
+    // The timer thread only needs to wake up early if this request is due before all the others.
+    if (isEarliest) {
+        mCv.notify_one();
+    }
+}
+
+bool PendingRequestTimer::isRequestPending(int64_t requestId) {
+    std::lock_guard<std::mutex> lk(mLock);
+    return mPendingRequests.find(requestId) != mPendingRequests.end();
+}
+
+bool PendingRequestTimer::tryFinishRequest(int64_t requestId) {
+    std::lock_guard<std::mutex> lk(mLock);
+    auto it = mPendingRequests.find(requestId);
+    if (it == mPendingRequests.end()) {
+        return false;
+    }
+    mRequestIdsByDeadline.erase(it->second.deadlineIt);
+    mPendingRequests.erase(it);
+    return true;
+}
+
+void PendingRequestTimer::reset() {
+    CallbackMap callbacks;
+    {
+        std::lock_guard<std::mutex> lk(mLock);
+        callbacks = takeExpiredRequestsLocked(Deadline::max());
+    }
+    callTimeoutCallbacks(callbacks);
+}
+
+void PendingRequestTimer::runTimer() {
+    if (int result = pthread_setname_np(pthread_self(), "VhalReqTimer"); result != 0) {
+        ALOGW("failed to set timer thread name, error: %d", result);
+    }
+    std::unique_lock<std::mutex> lk(mLock);
+    while (!mStopping) {
+        CallbackMap callbacks = takeExpiredRequestsLocked(std::chrono::steady_clock::now());
+        if (!callbacks.empty()) {
+            // The callbacks finish the requests in the client, which may call back into the timer.
+            lk.unlock();
+            callTimeoutCallbacks(callbacks);
+            lk.lock();
+            continue;
+        }
+        if (mRequestIdsByDeadline.empty()) {
+            mCv.wait(lk);
+        } else {
+            mCv.wait_until(lk, mRequestIdsByDeadline.begin()->first);
+        }
+    }
+}
+
+PendingRequestTimer::CallbackMap PendingRequestTimer::takeExpiredRequestsLocked(Deadline now) {
+    CallbackMap callbacks;
+    auto it = mRequestIdsByDeadline.begin();
+    for (; it != mRequestIdsByDeadline.end() && it->first <= now; ++it) {
+        auto requestIt = mPendingRequests.find(it->second);
+        callbacks[requestIt->second.callback].insert(it->second);
+        mPendingRequests.erase(requestIt);
+    }
+    mRequestIdsByDeadline.erase(mRequestIdsByDeadline.begin(), it);
+    return callbacks;
+}
+
+void PendingRequestTimer::callTimeoutCallbacks(const CallbackMap& callbacks) {
+    for (const auto& [callback, requestIds] : callbacks) {
+        (*callback)(requestIds);
+    }
+}
+
+}  // namespace vhal
+}  // namespace automotive
+}  // namespace frameworks
+}  // namespace android
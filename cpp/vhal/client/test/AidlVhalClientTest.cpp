@@ -475,6 +475,153 @@ TEST_F(AidlVhalClientTest, testGetValueTimeout) {
     ASSERT_EQ(result.error().code(), ErrorCode::TIMEOUT);
 }
 
+TEST_F(AidlVhalClientTest, testGetValueSyncImmediateResult) {
+    // The result is delivered from within the getValues call.
+    getVhal()->setWaitTimeInMs(0);
+    getVhal()->setGetValueResults({
+            GetValueResult{
+                    .requestId = 0,
+                    .status = StatusCode::OK,
+                    .prop =
+                            VehiclePropValue{
+                                    .prop = TEST_PROP_ID,
+                                    .areaId = TEST_AREA_ID,
+                                    .value =
+                                            RawPropValues{
+                                                    .int32Values = {1},
+                                            },
+                            },
+            },
+    });
+
+    AidlHalPropValue propValue(TEST_PROP_ID, TEST_AREA_ID);
+    VhalClientResult<std::unique_ptr<IHalPropValue>> result = getClient()->getValueSync(propValue);
+
+    ASSERT_TRUE(result.ok());
+    ASSERT_EQ(result.value()->getInt32Values(), std::vector<int32_t>({1}));
+}
+
+TEST_F(AidlVhalClientTest, testGetValueSyncTimeout) {
+    // The request will time-out before the response.
+    getVhal()->setWaitTimeInMs(200);
+    getVhal()->setGetValueResults({
+            GetValueResult{
+                    .requestId = 0,
+                    .status = StatusCode::OK,
+                    .prop =
+                            VehiclePropValue{
+                                    .prop = TEST_PROP_ID,
+                                    .areaId = TEST_AREA_ID,
+                            },
+            },
+    });
+
+    AidlHalPropValue propValue(TEST_PROP_ID, TEST_AREA_ID);
+    VhalClientResult<std::unique_ptr<IHalPropValue>> result = getClient()->getValueSync(propValue);
+
+    ASSERT_FALSE(result.ok());
+    ASSERT_EQ(result.error().code(), ErrorCode::TIMEOUT);
+}
+
+TEST_F(AidlVhalClientTest, testGetValueAsync) {
+    getVhal()->setWaitTimeInMs(10);
+    getVhal()->setGetValueResults({
+            GetValueResult{
+                    .requestId = 0,
+                    .status = StatusCode::OK,
+                    .prop =
+                            VehiclePropValue{
+                                    .prop = TEST_PROP_ID,
+                                    .areaId = TEST_AREA_ID,
+                                    .value =
+                                            RawPropValues{
+                                                    .int32Values = {1},
+                                            },
+                            },
+            },
+    });
+
+    AidlHalPropValue propValue(TEST_PROP_ID, TEST_AREA_ID);
+    auto future = getClient()->getValueAsync(propValue);
+
+    ASSERT_TRUE(future.waitFor(std::chrono::milliseconds(1000)));
+    auto result = future.get();
+    ASSERT_TRUE(result.ok());
+    ASSERT_EQ(result.value()->getInt32Values(), std::vector<int32_t>({1}));
+}
+
+TEST_F(AidlVhalClientTest, testGetValueAsyncDeadlineShorterThanTimeout) {
+    // The response arrives after the deadline but before the client's default timeout.
+    getVhal()->setWaitTimeInMs(80);
+    getVhal()->setGetValueResults({
+            GetValueResult{
+                    .requestId = 0,
+                    .status = StatusCode::OK,
+                    .prop =
+                            VehiclePropValue{
+                                    .prop = TEST_PROP_ID,
+                                    .areaId = TEST_AREA_ID,
+                            },
+            },
+    });
+
+    AidlHalPropValue propValue(TEST_PROP_ID, TEST_AREA_ID);
+    auto future = getClient()->getValueAsync(propValue,
+                                             std::chrono::steady_clock::now() +
+                                                     std::chrono::milliseconds(20));
+
+    ASSERT_TRUE(future.waitFor(std::chrono::milliseconds(1000)));
+    auto result = future.get();
+    ASSERT_FALSE(result.ok());
+    ASSERT_EQ(result.error().code(), ErrorCode::TIMEOUT);
+}
+
+TEST_F(AidlVhalClientTest, testGetValueAsyncDeadlineExceeded) {
+    AidlHalPropValue propValue(TEST_PROP_ID, TEST_AREA_ID);
+    auto future = getClient()->getValueAsync(propValue, std::chrono::steady_clock::now());
+
+    ASSERT_TRUE(future.isReady());
+    auto result = future.get();
+    ASSERT_FALSE(result.ok());
+    ASSERT_EQ(result.error().code(), ErrorCode::TIMEOUT);
+    ASSERT_TRUE(getVhal()->getGetValueRequests().empty())
+            << "request with an expired deadline must not be sent to VHAL";
+}
+
+TEST_F(AidlVhalClientTest, testGetValueAsyncWhenAll) {
+    getVhal()->setWaitTimeInMs(10);
+    getVhal()->setGetValueResults({
+            GetValueResult{
+                    .requestId = 0,
+                    .status = StatusCode::OK,
+                    .prop =
+                            VehiclePropValue{
+                                    .prop = TEST_PROP_ID,
+                                    .areaId = TEST_AREA_ID,
+                            },
+            },
+            GetValueResult{
+                    .requestId = 1,
+                    .status = StatusCode::NOT_AVAILABLE,
+            },
+    });
+
+    AidlHalPropValue propValue(TEST_PROP_ID, TEST_AREA_ID);
+    std::vector<VhalClientFuture<std::unique_ptr<IHalPropValue>>> futures;
+    futures.push_back(getClient()->getValueAsync(propValue));
+    futures.push_back(getClient()->getValueAsync(propValue));
+    auto future = whenAll(std::move(futures));
+
+    ASSERT_TRUE(future.waitFor(std::chrono::milliseconds(1000)));
+    auto results = future.get();
+    ASSERT_TRUE(results.ok());
+    ASSERT_EQ(results.value().size(), 2u);
+    ASSERT_TRUE(results.value()[0].ok());
+    ASSERT_EQ(results.value()[0].value()->getPropId(), TEST_PROP_ID);
+    ASSERT_FALSE(results.value()[1].ok());
+    ASSERT_EQ(results.value()[1].error().code(), ErrorCode::NOT_AVAILABLE_FROM_VHAL);
+}
+
 TEST_F(AidlVhalClientTest, testGetValueErrorStatus) {
     VehiclePropValue testProp{
             .prop = TEST_PROP_ID,
@@ -676,6 +823,23 @@ TEST_F(AidlVhalClientTest, testSetValueTimeout) {
     ASSERT_EQ(result.error().code(), ErrorCode::TIMEOUT);
 }
 
+TEST_F(AidlVhalClientTest, testSetValueSyncTimeout) {
+    // The request will time-out before the response.
+    getVhal()->setWaitTimeInMs(200);
+    getVhal()->setSetValueResults({
+            SetValueResult{
+                    .requestId = 0,
+                    .status = StatusCode::OK,
+            },
+    });
+
+    AidlHalPropValue propValue(TEST_PROP_ID, TEST_AREA_ID);
+    VhalClientResult<void> result = getClient()->setValueSync(propValue);
+
+    ASSERT_FALSE(result.ok());
+    ASSERT_EQ(result.error().code(), ErrorCode::TIMEOUT);
+}
+
 TEST_F(AidlVhalClientTest, testSetValueErrorStatus) {
     VehiclePropValue testProp{
             .prop = TEST_PROP_ID,
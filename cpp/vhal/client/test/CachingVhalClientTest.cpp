@@ -0,0 +1,481 @@
+/*
+ * Copyright (c) 2024, The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#define LOG_TAG "CachingVhalClientTest"
+
+#include <aidl/android/hardware/automotive/vehicle/VehiclePropertyChangeMode.h>
+#include <gtest/gtest.h>
+#include <utils/Log.h>
+
+#include <AidlHalPropConfig.h>
+#include <AidlHalPropValue.h>
+#include <CachingVhalClient.h>
+#include <inttypes.h>
+
+#include <algorithm>
+#include <chrono>  // NOLINT
+#include <map>
+#include <thread>  // NOLINT
+#include <utility>
+#include <vector>
+
+namespace android {
+namespace frameworks {
+namespace automotive {
+namespace vhal {
+namespace caching_test {
+
+using ::aidl::android::hardware::automotive::vehicle::StatusCode;
+using ::aidl::android::hardware::automotive::vehicle::SubscribeOptions;
+using ::aidl::android::hardware::automotive::vehicle::VehiclePropConfig;
+using ::aidl::android::hardware::automotive::vehicle::VehiclePropertyChangeMode;
+
+// A fake VHAL that answers requests from an in-memory property store after a configurable
+// latency, which stands in for the binder round-trip.
+class FakeVhalClient final : public IVhalClient {
+public:
+    bool isAidlVhal() override { return true; }
+
+    std::unique_ptr<IHalPropValue> createHalPropValue(int32_t propId) override {
+        return std::make_unique<AidlHalPropValue>(propId);
+    }
+
+    std::unique_ptr<IHalPropValue> createHalPropValue(int32_t propId, int32_t areaId) override {
+        return std::make_unique<AidlHalPropValue>(propId, areaId);
+    }
+
+    void getValue(const IHalPropValue& requestValue,
+                  std::shared_ptr<GetValueCallbackFunc> callback) override {
+        mGetValueCount++;
+        if (mLatency.count() > 0) {
+            std::this_thread::sleep_for(mLatency);
+        }
+        auto it = mValues.find({requestValue.getPropId(), requestValue.getAreaId()});
+        if (it == mValues.end()) {
+            (*callback)(ClientStatusError(StatusCode::NOT_AVAILABLE) << "property not available");
+            return;
+        }
+        (*callback)(it->second->clone());
+    }
+
+    void setValue(const IHalPropValue& requestValue,
+                  std::shared_ptr<SetValueCallbackFunc> callback) override {
+        mValues[{requestValue.getPropId(), requestValue.getAreaId()}] = requestValue.clone();
+        (*callback)({});
+    }
+
+    VhalClientResult<void> addOnBinderDiedCallback(
+            std::shared_ptr<OnBinderDiedCallbackFunc> callback) override {
+        mOnBinderDiedCallbacks.push_back(callback);
+        return {};
+    }
+
+    VhalClientResult<void> removeOnBinderDiedCallback(
+            std::shared_ptr<OnBinderDiedCallbackFunc> callback) override {
+        mOnBinderDiedCallbacks.erase(std::remove(mOnBinderDiedCallbacks.begin(),
+                                                 mOnBinderDiedCallbacks.end(), callback),
+                                     mOnBinderDiedCallbacks.end());
+        return {};
+    }
+
+    VhalClientResult<std::vector<std::unique_ptr<IHalPropConfig>>> getAllPropConfigs() override {
+        std::vector<int32_t> propIds;
+        for (const auto& [propId, _] : mChangeModes) {
+            propIds.push_back(propId);
+        }
+        return getPropConfigs(propIds);
+    }
+
+    VhalClientResult<std::vector<std::unique_ptr<IHalPropConfig>>> getPropConfigs(
+            std::vector<int32_t> propIds) override {
+        mGetPropConfigsCount++;
+        std::vector<std::unique_ptr<IHalPropConfig>> configs;
+        for (int32_t propId : propIds) {
+            auto it = mChangeModes.find(propId);
+            if (it == mChangeModes.end()) {
+                return ClientStatusError(StatusCode::INVALID_ARG) << "unknown property";
+            }
+            configs.push_back(std::make_unique<AidlHalPropConfig>(VehiclePropConfig{
+                    .prop = propId,
+                    .changeMode = it->second,
+            }));
+        }
+        return configs;
+    }
+
+    std::unique_ptr<ISubscriptionClient> getSubscriptionClient(
+            std::shared_ptr<ISubscriptionCallback> callback) override {
+        mSubscriptionCallback = callback;
+        return std::make_unique<FakeSubscriptionClient>(this);
+    }
+
+    // Test functions
+
+    void addProperty(int32_t propId, VehiclePropertyChangeMode changeMode) {
+        mChangeModes[propId] = changeMode;
+    }
+
+    void putValue(int32_t propId, int32_t areaId, int32_t value, int64_t timestamp) {
+        mValues[{propId, areaId}] = makeValue(propId, areaId, value, timestamp);
+    }
+
+    void triggerPropertyEvent(int32_t propId, int32_t areaId, int32_t value, int64_t timestamp) {
+        putValue(propId, areaId, value, timestamp);
+        std::vector<std::unique_ptr<IHalPropValue>> values;
+        values.push_back(mValues[{propId, areaId}]->clone());
+        mSubscriptionCallback->onPropertyEvent(values);
+    }
+
+    void triggerPropertySetError(int32_t propId, int32_t areaId) {
+        mSubscriptionCallback->onPropertySetError({HalPropError{
+                .propId = propId,
+                .areaId = areaId,
+                .status = StatusCode::INTERNAL_ERROR,
+        }});
+    }
+
+    void triggerBinderDied() {
+        for (const auto& callback : mOnBinderDiedCallbacks) {
+            (*callback)();
+        }
+    }
+
+    void setLatency(std::chrono::microseconds latency) { mLatency = latency; }
+
+    void setSubscribeFails(bool subscribeFails) { mSubscribeFails = subscribeFails; }
+
+    int getSubscribeAttemptCount() const { return mSubscribeAttemptCount; }
+
+    int getGetValueCount() const { return mGetValueCount; }
+
+    int getGetPropConfigsCount() const { return mGetPropConfigsCount; }
+
+    std::vector<int32_t> getSubscribedPropIds() const { return mSubscribedPropIds; }
+
+    std::vector<int32_t> getUnsubscribedPropIds() const { return mUnsubscribedPropIds; }
+
+    static std::unique_ptr<IHalPropValue> makeValue(int32_t propId, int32_t areaId, int32_t value,
+                                                    int64_t timestamp) {
+        return std::make_unique<AidlHalPropValue>(
+                ::aidl::android::hardware::automotive::vehicle::VehiclePropValue{
+                        .timestamp = timestamp,
+                        .areaId = areaId,
+                        .prop = propId,
+                        .value.int32Values = {value},
+                });
+    }
+
+private:
+    class FakeSubscriptionClient final : public ISubscriptionClient {
+    public:
+        explicit FakeSubscriptionClient(FakeVhalClient* vhal) : mVhal(vhal) {}
+
+        VhalClientResult<void> subscribe(const std::vector<SubscribeOptions>& options) override {
+            mVhal->mSubscribeAttemptCount++;
+            if (mVhal->mSubscribeFails) {
+                return ClientStatusError(StatusCode::TRY_AGAIN) << "subscription failed";
+            }
+            for (const auto& option : options) {
+                mVhal->mSubscribedPropIds.push_back(option.propId);
+            }
+            return {};
+        }
+
+        VhalClientResult<void> unsubscribe(const std::vector<int32_t>& propIds) override {
+            mVhal->mUnsubscribedPropIds.insert(mVhal->mUnsubscribedPropIds.end(), propIds.begin(),
+                                               propIds.end());
+            return {};
+        }
+
+    private:
+        FakeVhalClient* mVhal;
+    };
+
+    std::map<int32_t, VehiclePropertyChangeMode> mChangeModes;
+    std::map<std::pair<int32_t, int32_t>, std::unique_ptr<IHalPropValue>> mValues;
+    std::vector<std::shared_ptr<OnBinderDiedCallbackFunc>> mOnBinderDiedCallbacks;
+    std::shared_ptr<ISubscriptionCallback> mSubscriptionCallback;
+    std::vector<int32_t> mSubscribedPropIds;
+    std::vector<int32_t> mUnsubscribedPropIds;
+    std::chrono::microseconds mLatency{0};
+    int mGetValueCount = 0;
+    int mGetPropConfigsCount = 0;
+    int mSubscribeAttemptCount = 0;
+    bool mSubscribeFails = false;
+};
+
+class CachingVhalClientTest : public ::testing::Test {
+protected:
+    constexpr static int32_t ON_CHANGE_PROP_ID = 1;
+    constexpr static int32_t STATIC_PROP_ID = 2;
+    constexpr static int32_t CONTINUOUS_PROP_ID = 3;
+    constexpr static int32_t AREA_ID = 4;
+    constexpr static int64_t MAX_STALENESS_IN_MS = 100;
+    constexpr static int64_t MILLIS_TO_NANOS = 1'000'000;
+    constexpr static int BENCHMARK_ITERATIONS = 1'000;
+
+    void SetUp() override {
+        mVhal = std::make_shared<FakeVhalClient>();
+        mVhal->addProperty(ON_CHANGE_PROP_ID, VehiclePropertyChangeMode::ON_CHANGE);
+        mVhal->addProperty(STATIC_PROP_ID, VehiclePropertyChangeMode::STATIC);
+        mVhal->addProperty(CONTINUOUS_PROP_ID, VehiclePropertyChangeMode::CONTINUOUS);
+        mVhal->putValue(ON_CHANGE_PROP_ID, AREA_ID, /*value=*/1, /*timestamp=*/1);
+        mVhal->putValue(STATIC_PROP_ID, AREA_ID, /*value=*/2, /*timestamp=*/1);
+        mVhal->putValue(CONTINUOUS_PROP_ID, AREA_ID, /*value=*/3, /*timestamp=*/1);
+        mClient = std::make_unique<CachingVhalClient>(mVhal, MAX_STALENESS_IN_MS,
+                                                      [this] { return mNowNs; });
+    }
+
+    int32_t getInt32ValueSync(int32_t propId) {
+        auto result = mClient->getValueSync(AidlHalPropValue(propId, AREA_ID));
+        EXPECT_TRUE(result.ok()) << "failed to get value: " << result.error().message();
+        if (!result.ok()) {
+            return -1;
+        }
+        return result.value()->getInt32Values()[0];
+    }
+
+    void advanceTimeMs(int64_t durationMs) { mNowNs += durationMs * MILLIS_TO_NANOS; }
+
+    int64_t mNowNs = 0;
+    std::shared_ptr<FakeVhalClient> mVhal;
+    std::unique_ptr<CachingVhalClient> mClient;
+};
+
+TEST_F(CachingVhalClientTest, testGetValueSyncCachesOnChangeProperty) {
+    ASSERT_EQ(getInt32ValueSync(ON_CHANGE_PROP_ID), 1);
+    ASSERT_EQ(getInt32ValueSync(ON_CHANGE_PROP_ID), 1);
+
+    ASSERT_EQ(mVhal->getGetValueCount(), 1);
+    ASSERT_EQ(mVhal->getGetPropConfigsCount(), 1);
+    ASSERT_EQ(mVhal->getSubscribedPropIds(), std::vector<int32_t>({ON_CHANGE_PROP_ID}));
+    CacheStats stats = mClient->getCacheStats();
+    ASSERT_EQ(stats.hitCount, 1u);
+    ASSERT_EQ(stats.missCount, 1u);
+    ASSERT_EQ(stats.bypassCount, 0u);
+    ASSERT_FLOAT_EQ(stats.getHitRate(), 0.5f);
+}
+
+TEST_F(CachingVhalClientTest, testGetValueSyncUpdatedByPropertyEvent) {
+    ASSERT_EQ(getInt32ValueSync(ON_CHANGE_PROP_ID), 1);
+
+    mVhal->triggerPropertyEvent(ON_CHANGE_PROP_ID, AREA_ID, /*value=*/10, /*timestamp=*/2);
+
+    ASSERT_EQ(getInt32ValueSync(ON_CHANGE_PROP_ID), 10);
+    ASSERT_EQ(mVhal->getGetValueCount(), 1);
+}
+
+TEST_F(CachingVhalClientTest, testGetValueSyncIgnoresOutdatedPropertyEvent) {
+    mVhal->putValue(ON_CHANGE_PROP_ID, AREA_ID, /*value=*/1, /*timestamp=*/5);
+    ASSERT_EQ(getInt32ValueSync(ON_CHANGE_PROP_ID), 1);
+
+    mVhal->triggerPropertyEvent(ON_CHANGE_PROP_ID, AREA_ID, /*value=*/10, /*timestamp=*/2);
+
+    ASSERT_EQ(getInt32ValueSync(ON_CHANGE_PROP_ID), 1);
+}
+
+TEST_F(CachingVhalClientTest, testGetValueSyncTrustsSubscribedValue) {
+    ASSERT_EQ(getInt32ValueSync(ON_CHANGE_PROP_ID), 1);
+
+    advanceTimeMs(MAX_STALENESS_IN_MS * 100);
+
+    ASSERT_EQ(getInt32ValueSync(ON_CHANGE_PROP_ID), 1)
+            << "Value of a subscribed property must not expire";
+    ASSERT_EQ(mVhal->getGetValueCount(), 1);
+}
+
+TEST_F(CachingVhalClientTest, testGetValueSyncRefetchesStaleValueWithoutSubscription) {
+    mVhal->setSubscribeFails(true);
+    ASSERT_EQ(getInt32ValueSync(ON_CHANGE_PROP_ID), 1);
+    mVhal->putValue(ON_CHANGE_PROP_ID, AREA_ID, /*value=*/10, /*timestamp=*/2);
+
+    advanceTimeMs(MAX_STALENESS_IN_MS);
+    ASSERT_EQ(getInt32ValueSync(ON_CHANGE_PROP_ID), 1) << "Value within staleness bound";
+
+    advanceTimeMs(1);
+    ASSERT_EQ(getInt32ValueSync(ON_CHANGE_PROP_ID), 10) << "Value exceeding staleness bound";
+    ASSERT_EQ(mVhal->getGetValueCount(), 2);
+}
+
+TEST_F(CachingVhalClientTest, testFailedSubscriptionIsRetriedWithBackoff) {
+    constexpr int64_t initialDelayMs = CachingVhalClient::SUBSCRIPTION_RETRY_INITIAL_DELAY_IN_MS;
+    mVhal->setSubscribeFails(true);
+    ASSERT_EQ(getInt32ValueSync(ON_CHANGE_PROP_ID), 1);
+    ASSERT_EQ(mVhal->getSubscribeAttemptCount(), 1);
+
+    advanceTimeMs(initialDelayMs - 1);
+    ASSERT_EQ(getInt32ValueSync(ON_CHANGE_PROP_ID), 1);
+    ASSERT_EQ(mVhal->getSubscribeAttemptCount(), 1) << "Must not retry before the backoff";
+
+    advanceTimeMs(1);
+    ASSERT_EQ(getInt32ValueSync(ON_CHANGE_PROP_ID), 1);
+    ASSERT_EQ(mVhal->getSubscribeAttemptCount(), 2) << "Must retry after the backoff";
+
+    advanceTimeMs(initialDelayMs);
+    ASSERT_EQ(getInt32ValueSync(ON_CHANGE_PROP_ID), 1);
+    ASSERT_EQ(mVhal->getSubscribeAttemptCount(), 2) << "Must double the backoff";
+
+    mVhal->setSubscribeFails(false);
+    advanceTimeMs(initialDelayMs);
+    ASSERT_EQ(getInt32ValueSync(ON_CHANGE_PROP_ID), 1);
+    ASSERT_EQ(mVhal->getSubscribeAttemptCount(), 3);
+    ASSERT_EQ(mVhal->getSubscribedPropIds(), std::vector<int32_t>({ON_CHANGE_PROP_ID}));
+
+    int getValueCount = mVhal->getGetValueCount();
+    advanceTimeMs(MAX_STALENESS_IN_MS * 100);
+    ASSERT_EQ(getInt32ValueSync(ON_CHANGE_PROP_ID), 1);
+    ASSERT_EQ(mVhal->getGetValueCount(), getValueCount)
+            << "Value must be trusted once the retried subscription succeeds";
+    ASSERT_EQ(mVhal->getSubscribeAttemptCount(), 3);
+}
+
+TEST_F(CachingVhalClientTest, testPropertySetErrorInvalidatesCache) {
+    ASSERT_EQ(getInt32ValueSync(ON_CHANGE_PROP_ID), 1);
+    mVhal->putValue(ON_CHANGE_PROP_ID, AREA_ID, /*value=*/10, /*timestamp=*/2);
+
+    mVhal->triggerPropertySetError(ON_CHANGE_PROP_ID, AREA_ID);
+
+    ASSERT_EQ(getInt32ValueSync(ON_CHANGE_PROP_ID), 10);
+    ASSERT_EQ(mVhal->getGetValueCount(), 2);
+}
+
+TEST_F(CachingVhalClientTest, testGetValueSyncNeverRefetchesStaticProperty) {
+    ASSERT_EQ(getInt32ValueSync(STATIC_PROP_ID), 2);
+
+    advanceTimeMs(MAX_STALENESS_IN_MS * 10);
+
+    ASSERT_EQ(getInt32ValueSync(STATIC_PROP_ID), 2);
+    ASSERT_EQ(mVhal->getGetValueCount(), 1);
+    ASSERT_TRUE(mVhal->getSubscribedPropIds().empty())
+            << "Static properties must not be subscribed";
+}
+
+TEST_F(CachingVhalClientTest, testGetValueSyncBypassesContinuousProperty) {
+    ASSERT_EQ(getInt32ValueSync(CONTINUOUS_PROP_ID), 3);
+    ASSERT_EQ(getInt32ValueSync(CONTINUOUS_PROP_ID), 3);
+
+    ASSERT_EQ(mVhal->getGetValueCount(), 2);
+    ASSERT_EQ(mVhal->getGetPropConfigsCount(), 1) << "Must remember the change mode";
+    ASSERT_TRUE(mVhal->getSubscribedPropIds().empty());
+    CacheStats stats = mClient->getCacheStats();
+    ASSERT_EQ(stats.hitCount, 0u);
+    ASSERT_EQ(stats.missCount, 0u);
+    ASSERT_EQ(stats.bypassCount, 2u);
+}
+
+TEST_F(CachingVhalClientTest, testGetValueSyncBypassesRequestWithPayload) {
+    AidlHalPropValue request(ON_CHANGE_PROP_ID, AREA_ID);
+    request.setInt32Values({100});
+
+    ASSERT_TRUE(mClient->getValueSync(request).ok());
+    ASSERT_TRUE(mClient->getValueSync(request).ok());
+
+    ASSERT_EQ(mVhal->getGetValueCount(), 2);
+    ASSERT_EQ(mClient->getCacheStats().bypassCount, 2u);
+}
+
+TEST_F(CachingVhalClientTest, testGetValueSyncDoesNotCacheError) {
+    ASSERT_FALSE(mClient->getValueSync(AidlHalPropValue(ON_CHANGE_PROP_ID, AREA_ID + 1)).ok());
+    ASSERT_FALSE(mClient->getValueSync(AidlHalPropValue(ON_CHANGE_PROP_ID, AREA_ID + 1)).ok());
+
+    ASSERT_EQ(mVhal->getGetValueCount(), 2);
+}
+
+TEST_F(CachingVhalClientTest, testSetValueInvalidatesCache) {
+    ASSERT_EQ(getInt32ValueSync(ON_CHANGE_PROP_ID), 1);
+
+    ASSERT_TRUE(
+            mClient->setValueSync(*FakeVhalClient::makeValue(ON_CHANGE_PROP_ID, AREA_ID,
+                                                             /*value=*/20, /*timestamp=*/2))
+                    .ok());
+
+    ASSERT_EQ(getInt32ValueSync(ON_CHANGE_PROP_ID), 20);
+    ASSERT_EQ(mVhal->getGetValueCount(), 2);
+}
+
+TEST_F(CachingVhalClientTest, testBinderDiedClearsCache) {
+    ASSERT_EQ(getInt32ValueSync(ON_CHANGE_PROP_ID), 1);
+
+    mVhal->triggerBinderDied();
+
+    ASSERT_EQ(getInt32ValueSync(ON_CHANGE_PROP_ID), 1);
+    ASSERT_EQ(mVhal->getGetValueCount(), 2);
+    ASSERT_EQ(mVhal->getSubscribedPropIds(),
+              std::vector<int32_t>({ON_CHANGE_PROP_ID, ON_CHANGE_PROP_ID}))
+            << "Must subscribe again after binder died";
+}
+
+TEST_F(CachingVhalClientTest, testGetValueUsesCache) {
+    ASSERT_EQ(getInt32ValueSync(ON_CHANGE_PROP_ID), 1);
+    std::vector<int32_t> gotValues;
+    auto callback = std::make_shared<IVhalClient::GetValueCallbackFunc>(
+            [&gotValues](VhalClientResult<std::unique_ptr<IHalPropValue>> result) {
+                ASSERT_TRUE(result.ok());
+                gotValues.push_back(result.value()->getInt32Values()[0]);
+            });
+
+    mClient->getValue(AidlHalPropValue(ON_CHANGE_PROP_ID, AREA_ID), callback);
+
+    ASSERT_EQ(gotValues, std::vector<int32_t>({1}));
+    ASSERT_EQ(mVhal->getGetValueCount(), 1);
+}
+
+TEST_F(CachingVhalClientTest, testDestructorUnsubscribes) {
+    ASSERT_EQ(getInt32ValueSync(ON_CHANGE_PROP_ID), 1);
+
+    mClient.reset();
+
+    ASSERT_EQ(mVhal->getUnsubscribedPropIds(), std::vector<int32_t>({ON_CHANGE_PROP_ID}));
+}
+
+TEST_F(CachingVhalClientTest, testCachedGetValueSyncBenchmark) {
+    // A conservative stand-in for a binder round-trip to VHAL.
+    mVhal->setLatency(std::chrono::microseconds(50));
+
+    auto start = std::chrono::steady_clock::now();
+    for (int i = 0; i < BENCHMARK_ITERATIONS; i++) {
+        ASSERT_TRUE(mVhal->getValueSync(AidlHalPropValue(ON_CHANGE_PROP_ID, AREA_ID)).ok());
+    }
+    int64_t avgUncachedNs = std::chrono::duration_cast<std::chrono::nanoseconds>(
+                                    std::chrono::steady_clock::now() - start)
+                                    .count() /
+            BENCHMARK_ITERATIONS;
+
+    start = std::chrono::steady_clock::now();
+    for (int i = 0; i < BENCHMARK_ITERATIONS; i++) {
+        ASSERT_TRUE(mClient->getValueSync(AidlHalPropValue(ON_CHANGE_PROP_ID, AREA_ID)).ok());
+    }
+    int64_t avgCachedNs = std::chrono::duration_cast<std::chrono::nanoseconds>(
+                                  std::chrono::steady_clock::now() - start)
+                                  .count() /
+            BENCHMARK_ITERATIONS;
+
+    CacheStats stats = mClient->getCacheStats();
+    ALOGI("getValueSync took %" PRId64 " ns without cache and %" PRId64
+          " ns with cache on average over %d iterations, cache stats: %s",
+          avgUncachedNs, avgCachedNs, BENCHMARK_ITERATIONS, stats.toString().c_str());
+    RecordProperty("avgUncachedGetValueSyncNs", std::to_string(avgUncachedNs));
+    RecordProperty("avgCachedGetValueSyncNs", std::to_string(avgCachedNs));
+    RecordProperty("cacheHitRate", std::to_string(stats.getHitRate()));
+    ASSERT_EQ(stats.missCount, 1u);
+    ASSERT_EQ(stats.hitCount, static_cast<uint64_t>(BENCHMARK_ITERATIONS - 1));
+}
+
+}  // namespace caching_test
+}  // namespace vhal
+}  // namespace automotive
+}  // namespace frameworks
+}  // namespace android
@@ -21,10 +21,20 @@
 #include <android-base/result.h>
 #include <android/hardware/automotive/vehicle/2.0/IVehicle.h>
 #include <gtest/gtest.h>
+#include <utils/Log.h>
 #include <utils/StrongPointer.h>
 
 #include <VehicleUtils.h>
-
+#include <inttypes.h>
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>              // NOLINT
+#include <condition_variable>  // NOLINT
+#include <functional>
+#include <mutex>               // NOLINT
+#include <optional>
+#include <thread>              // NOLINT
 #include <vector>
 
 namespace android {
@@ -61,13 +71,39 @@ public:
     }
 
     Return<void> get(const VehiclePropValue& requestPropValue, IVehicle::get_cb callback) override {
-        mRequestPropValue = requestPropValue;
-        callback(mStatus, mPropValue);
+        StatusCode status;
+        VehiclePropValue value;
+        {
+            std::unique_lock<std::mutex> lk(mGetValueLock);
+            mRequestPropValue = requestPropValue;
+            mRunningGetValueCount++;
+            mGetValueCv.notify_all();
+            mGetValueCv.wait(lk, [this] { return !mGetValueBlocked; });
+            mRunningGetValueCount--;
+            status = mStatus;
+            value = mPropValue;
+        }
+        if (mGetValueLatency.count() > 0) {
+            std::this_thread::sleep_for(mGetValueLatency);
+        }
+        callback(status, value);
         return {};
     }
 
     Return<StatusCode> set(const VehiclePropValue& value) override {
-        mRequestPropValue = value;
+        {
+            std::unique_lock<std::mutex> lk(mSetValueLock);
+            mRequestPropValue = value;
+            mSetValues.push_back(value);
+            mRunningSetValueCount++;
+            mMaxRunningSetValueCount = std::max(mMaxRunningSetValueCount, mRunningSetValueCount);
+            mSetValueCv.notify_all();
+            mSetValueCv.wait(lk, [this] { return !mSetValueBlocked; });
+        }
+        // Gives a reordered request the chance to overtake this one.
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+        std::lock_guard<std::mutex> lk(mSetValueLock);
+        mRunningSetValueCount--;
         return mStatus;
     }
 
@@ -94,6 +130,51 @@ public:
 
     void setVehiclePropValue(VehiclePropValue value) { mPropValue = value; }
 
+    // Simulates the binder round-trip of a get request.
+    void setGetValueLatency(std::chrono::microseconds latency) { mGetValueLatency = latency; }
+
+    // Blocks the get requests until unblocked.
+    void setGetValueBlocked(bool blocked) {
+        {
+            std::lock_guard<std::mutex> lk(mGetValueLock);
+            mGetValueBlocked = blocked;
+        }
+        mGetValueCv.notify_all();
+    }
+
+    // Waits until |count| get requests are running concurrently.
+    bool waitForRunningGetValues(int count) {
+        std::unique_lock<std::mutex> lk(mGetValueLock);
+        return mGetValueCv.wait_for(lk, std::chrono::seconds(5),
+                                    [this, count] { return mRunningGetValueCount == count; });
+    }
+
+    // Blocks the set requests until unblocked.
+    void setSetValueBlocked(bool blocked) {
+        {
+            std::lock_guard<std::mutex> lk(mSetValueLock);
+            mSetValueBlocked = blocked;
+        }
+        mSetValueCv.notify_all();
+    }
+
+    // Waits until |count| set requests are running concurrently.
+    bool waitForRunningSetValues(int count) {
+        std::unique_lock<std::mutex> lk(mSetValueLock);
+        return mSetValueCv.wait_for(lk, std::chrono::seconds(5),
+                                    [this, count] { return mRunningSetValueCount == count; });
+    }
+
+    std::vector<VehiclePropValue> getSetValues() {
+        std::lock_guard<std::mutex> lk(mSetValueLock);
+        return mSetValues;
+    }
+
+    int getMaxRunningSetValueCount() {
+        std::lock_guard<std::mutex> lk(mSetValueLock);
+        return mMaxRunningSetValueCount;
+    }
+
     std::vector<int32_t> getGetPropConfigsProps() { return mGetPropConfigsProps; }
 
     VehiclePropValue getRequestPropValue() { return mRequestPropValue; }
@@ -120,6 +201,19 @@ private:
     sp<IVehicleCallback> mSubscribedCallback;
     std::vector<SubscribeOptions> mSubscribeOptions;
     int32_t mUnsubscribedPropId;
+
+    std::mutex mGetValueLock;
+    std::condition_variable mGetValueCv;
+    bool mGetValueBlocked = false;
+    int mRunningGetValueCount = 0;
+    std::chrono::microseconds mGetValueLatency{0};
+
+    std::mutex mSetValueLock;
+    std::condition_variable mSetValueCv;
+    bool mSetValueBlocked = false;
+    int mRunningSetValueCount = 0;
+    int mMaxRunningSetValueCount = 0;
+    std::vector<VehiclePropValue> mSetValues;
 };
 
 class MockSubscriptionCallback final : public ISubscriptionCallback {
@@ -158,12 +252,24 @@ protected:
         mVhalClient = std::make_unique<HidlVhalClient>(mVhal);
     }
 
+    void TearDown() override {
+        // Destroying the client waits for the running requests.
+        mVhal->setGetValueBlocked(false);
+        mVhal->setSetValueBlocked(false);
+    }
+
     MockVhal* getVhal() { return mVhal.get(); }
 
     HidlVhalClient* getClient() { return mVhalClient.get(); }
 
+    void resetClient(int64_t timeoutInMs, size_t workerThreadCount) {
+        mVhalClient = std::make_unique<HidlVhalClient>(mVhal, timeoutInMs, workerThreadCount);
+    }
+
     void triggerBinderDied() { mVhalClient->onBinderDied(); }
 
+    void waitForPendingRequests() { mVhalClient->waitForPendingRequests(); }
+
 private:
     sp<MockVhal> mVhal;
     std::unique_ptr<HidlVhalClient> mVhalClient;
@@ -186,6 +292,7 @@ TEST_F(HidlVhalClientTest, testGetValue) {
     getVhal()->setVehiclePropValue(TEST_VALUE);
 
     getClient()->getValue(HidlHalPropValue(TEST_PROP_ID, TEST_AREA_ID), callback);
+    waitForPendingRequests();
 
     ASSERT_TRUE(gotResult);
     ASSERT_EQ(getVhal()->getRequestPropValue().prop, TEST_PROP_ID);
@@ -216,6 +323,7 @@ TEST_F(HidlVhalClientTest, testGetValueUnavailableStatus) {
     });
 
     getClient()->getValue(HidlHalPropValue(TEST_PROP_ID, TEST_AREA_ID), callback);
+    waitForPendingRequests();
 
     ASSERT_TRUE(gotResult);
     ASSERT_EQ(getVhal()->getRequestPropValue().prop, TEST_PROP_ID);
@@ -241,6 +349,7 @@ TEST_F(HidlVhalClientTest, testGetValueError) {
             });
 
     getClient()->getValue(HidlHalPropValue(TEST_PROP_ID, TEST_AREA_ID), callback);
+    waitForPendingRequests();
 
     ASSERT_TRUE(gotResult);
     ASSERT_FALSE(result.ok());
@@ -258,6 +367,7 @@ TEST_F(HidlVhalClientTest, testSetValue) {
             });
 
     getClient()->setValue(HidlHalPropValue(TEST_PROP_ID, TEST_AREA_ID), callback);
+    waitForPendingRequests();
 
     ASSERT_TRUE(gotResult);
     ASSERT_EQ(getVhal()->getRequestPropValue().prop, TEST_PROP_ID);
@@ -278,11 +388,194 @@ TEST_F(HidlVhalClientTest, testSetValueError) {
             });
 
     getClient()->setValue(HidlHalPropValue(TEST_PROP_ID, TEST_AREA_ID), callback);
+    waitForPendingRequests();
 
     ASSERT_TRUE(gotResult);
     ASSERT_FALSE(result.ok());
 }
 
+TEST_F(HidlVhalClientTest, testSetValueKeepsOrderForSameArea) {
+    constexpr int requestCount = 8;
+    resetClient(/*timeoutInMs=*/10'000, /*workerThreadCount=*/4);
+    auto callback = std::make_shared<HidlVhalClient::SetValueCallbackFunc>(
+            [](VhalClientResult<void> r) { ASSERT_TRUE(r.ok()); });
+
+    for (int i = 0; i < requestCount; i++) {
+        HidlHalPropValue value(TEST_PROP_ID, TEST_AREA_ID);
+        value.setInt32Values({i});
+        getClient()->setValue(value, callback);
+    }
+    waitForPendingRequests();
+
+    std::vector<VehiclePropValue> setValues = getVhal()->getSetValues();
+    ASSERT_EQ(setValues.size(), static_cast<size_t>(requestCount));
+    for (int i = 0; i < requestCount; i++) {
+        EXPECT_EQ(setValues[i].value.int32Values, std::vector<int32_t>({i}))
+                << "Set requests to the same property area must reach VHAL in order";
+    }
+    EXPECT_EQ(getVhal()->getMaxRunningSetValueCount(), 1)
+            << "Set requests to the same property area must not run concurrently";
+}
+
+TEST_F(HidlVhalClientTest, testSetValueRunsDifferentAreasConcurrently) {
+    resetClient(/*timeoutInMs=*/10'000, /*workerThreadCount=*/2);
+    auto callback = std::make_shared<HidlVhalClient::SetValueCallbackFunc>(
+            [](VhalClientResult<void> r) { ASSERT_TRUE(r.ok()); });
+    getVhal()->setSetValueBlocked(true);
+
+    getClient()->setValue(HidlHalPropValue(TEST_PROP_ID, TEST_AREA_ID), callback);
+    getClient()->setValue(HidlHalPropValue(TEST_PROP_ID, TEST_AREA_ID_2), callback);
+
+    ASSERT_TRUE(getVhal()->waitForRunningSetValues(2))
+            << "Set requests to different property areas must be outstanding at the same time";
+
+    getVhal()->setSetValueBlocked(false);
+    waitForPendingRequests();
+}
+
+TEST_F(HidlVhalClientTest, testGetValueSync) {
+    getVhal()->setVehiclePropValue(TEST_VALUE);
+
+    auto result = getClient()->getValueSync(HidlHalPropValue(TEST_PROP_ID, TEST_AREA_ID));
+
+    ASSERT_TRUE(result.ok());
+    ASSERT_EQ(result.value()->getPropId(), TEST_PROP_ID);
+    ASSERT_EQ(result.value()->getAreaId(), TEST_AREA_ID);
+    ASSERT_EQ(result.value()->getInt32Values(), std::vector<int32_t>({1}));
+}
+
+TEST_F(HidlVhalClientTest, testGetValueDoesNotBlockCaller) {
+    std::atomic<bool> gotResult = false;
+    auto callback = std::make_shared<HidlVhalClient::GetValueCallbackFunc>(
+            [&gotResult](VhalClientResult<std::unique_ptr<IHalPropValue>> r) {
+                ASSERT_TRUE(r.ok());
+                gotResult = true;
+            });
+    getVhal()->setVehiclePropValue(TEST_VALUE);
+    getVhal()->setGetValueBlocked(true);
+
+    getClient()->getValue(HidlHalPropValue(TEST_PROP_ID, TEST_AREA_ID), callback);
+
+    ASSERT_TRUE(getVhal()->waitForRunningGetValues(1));
+    ASSERT_FALSE(gotResult) << "Must not wait for VHAL on the caller's thread";
+
+    getVhal()->setGetValueBlocked(false);
+    waitForPendingRequests();
+
+    ASSERT_TRUE(gotResult);
+}
+
+TEST_F(HidlVhalClientTest, testGetValueTimeout) {
+    resetClient(/*timeoutInMs=*/100, /*workerThreadCount=*/1);
+    std::mutex lock;
+    std::condition_variable cv;
+    std::optional<ErrorCode> errorCode;
+    auto callback = std::make_shared<HidlVhalClient::GetValueCallbackFunc>(
+            [&](VhalClientResult<std::unique_ptr<IHalPropValue>> r) {
+                std::lock_guard<std::mutex> lk(lock);
+                errorCode = r.ok() ? ErrorCode::OK : r.error().code().value();
+                cv.notify_all();
+            });
+    getVhal()->setGetValueBlocked(true);
+
+    getClient()->getValue(HidlHalPropValue(TEST_PROP_ID, TEST_AREA_ID), callback);
+
+    {
+        std::unique_lock<std::mutex> lk(lock);
+        ASSERT_TRUE(cv.wait_for(lk, std::chrono::seconds(5), [&] { return errorCode.has_value(); }))
+                << "The request must time out";
+        ASSERT_EQ(*errorCode, ErrorCode::TIMEOUT);
+        errorCode.reset();
+    }
+
+    getVhal()->setGetValueBlocked(false);
+    waitForPendingRequests();
+
+    std::lock_guard<std::mutex> lk(lock);
+    ASSERT_FALSE(errorCode.has_value()) << "Late result must be dropped after the timeout";
+}
+
+TEST_F(HidlVhalClientTest, testGetValuePipelinesRequests) {
+    constexpr int requestCount = 4;
+    resetClient(/*timeoutInMs=*/10'000, /*workerThreadCount=*/requestCount);
+    std::atomic<int> okCount = 0;
+    auto callback = std::make_shared<HidlVhalClient::GetValueCallbackFunc>(
+            [&okCount](VhalClientResult<std::unique_ptr<IHalPropValue>> r) {
+                if (r.ok()) {
+                    okCount++;
+                }
+            });
+    getVhal()->setVehiclePropValue(TEST_VALUE);
+    getVhal()->setGetValueBlocked(true);
+
+    for (int i = 0; i < requestCount; i++) {
+        getClient()->getValue(HidlHalPropValue(TEST_PROP_ID, TEST_AREA_ID), callback);
+    }
+
+    ASSERT_TRUE(getVhal()->waitForRunningGetValues(requestCount))
+            << "All requests must be outstanding at the same time";
+
+    getVhal()->setGetValueBlocked(false);
+    waitForPendingRequests();
+
+    ASSERT_EQ(okCount, requestCount);
+}
+
+TEST_F(HidlVhalClientTest, testGetValueThroughputBenchmark) {
+    constexpr int callerCount = 4;
+    constexpr int requestsPerCaller = 100;
+    constexpr int totalRequests = callerCount * requestsPerCaller;
+    resetClient(/*timeoutInMs=*/10'000, /*workerThreadCount=*/16);
+    getVhal()->setVehiclePropValue(TEST_VALUE);
+    // A conservative stand-in for a HIDL binder round-trip.
+    getVhal()->setGetValueLatency(std::chrono::microseconds(500));
+    auto runCallers = [&](const std::function<void()>& issueRequests) {
+        auto start = std::chrono::steady_clock::now();
+        std::vector<std::thread> callers;
+        for (int i = 0; i < callerCount; i++) {
+            callers.emplace_back(issueRequests);
+        }
+        for (auto& caller : callers) {
+            caller.join();
+        }
+        waitForPendingRequests();
+        auto durationUs = std::chrono::duration_cast<std::chrono::microseconds>(
+                                  std::chrono::steady_clock::now() - start)
+                                  .count();
+        return static_cast<int64_t>(totalRequests) * 1'000'000 / std::max<int64_t>(durationUs, 1);
+    };
+
+    std::atomic<int> syncOkCount = 0;
+    int64_t syncRequestsPerSec = runCallers([&] {
+        for (int i = 0; i < requestsPerCaller; i++) {
+            if (getClient()->getValueSync(HidlHalPropValue(TEST_PROP_ID, TEST_AREA_ID)).ok()) {
+                syncOkCount++;
+            }
+        }
+    });
+
+    std::atomic<int> asyncOkCount = 0;
+    auto callback = std::make_shared<HidlVhalClient::GetValueCallbackFunc>(
+            [&asyncOkCount](VhalClientResult<std::unique_ptr<IHalPropValue>> r) {
+                if (r.ok()) {
+                    asyncOkCount++;
+                }
+            });
+    int64_t asyncRequestsPerSec = runCallers([&] {
+        for (int i = 0; i < requestsPerCaller; i++) {
+            getClient()->getValue(HidlHalPropValue(TEST_PROP_ID, TEST_AREA_ID), callback);
+        }
+    });
+
+    ALOGI("getValue throughput with %d callers: %" PRId64 " requests/s blocking, %" PRId64
+          " requests/s pipelined",
+          callerCount, syncRequestsPerSec, asyncRequestsPerSec);
+    RecordProperty("syncGetValueRequestsPerSec", std::to_string(syncRequestsPerSec));
+    RecordProperty("asyncGetValueRequestsPerSec", std::to_string(asyncRequestsPerSec));
+    ASSERT_EQ(syncOkCount, totalRequests);
+    ASSERT_EQ(asyncOkCount, totalRequests);
+}
+
 TEST_F(HidlVhalClientTest, testAddOnBinderDiedCallback) {
     struct Result {
         bool callbackOneCalled = false;
@@ -0,0 +1,165 @@
+/*
+ * Copyright (c) 2024, The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <gtest/gtest.h>
+
+#include <PendingRequestTimer.h>
+
+#include <chrono>              // NOLINT
+#include <condition_variable>  // NOLINT
+#include <mutex>               // NOLINT
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+namespace android {
+namespace frameworks {
+namespace automotive {
+namespace vhal {
+namespace timer_test {
+
+using ::std::chrono::milliseconds;
+using ::std::chrono::steady_clock;
+
+class PendingRequestTimerTest : public ::testing::Test {
+protected:
+    void SetUp() override {
+        mTimer = std::make_unique<PendingRequestTimer>(/*defaultTimeoutInMs=*/50);
+        mCallback = std::make_shared<PendingRequestTimer::TimeoutCallbackFunc>(
+                [this](const std::unordered_set<int64_t>& requestIds) {
+                    std::lock_guard<std::mutex> lk(mLock);
+                    for (int64_t requestId : requestIds) {
+                        mTimeoutTimes[requestId] = steady_clock::now();
+                        mTimedOutRequestIds.push_back(requestId);
+                    }
+                    mCv.notify_all();
+                });
+    }
+
+    // The timer calls the callback for the remaining requests when it is destroyed, so it must
+    // go before the state the callback uses.
+    void TearDown() override { mTimer.reset(); }
+
+    bool waitForTimeouts(size_t count, milliseconds timeout) {
+        std::unique_lock<std::mutex> lk(mLock);
+        return mCv.wait_for(lk, timeout,
+                            [this, count] { return mTimedOutRequestIds.size() >= count; });
+    }
+
+    std::vector<int64_t> getTimedOutRequestIds() {
+        std::lock_guard<std::mutex> lk(mLock);
+        return mTimedOutRequestIds;
+    }
+
+    steady_clock::time_point getTimeoutTime(int64_t requestId) {
+        std::lock_guard<std::mutex> lk(mLock);
+        return mTimeoutTimes[requestId];
+    }
+
+    std::unique_ptr<PendingRequestTimer> mTimer;
+    std::shared_ptr<PendingRequestTimer::TimeoutCallbackFunc> mCallback;
+
+private:
+    std::mutex mLock;
+    std::condition_variable mCv;
+    std::vector<int64_t> mTimedOutRequestIds;
+    std::unordered_map<int64_t, steady_clock::time_point> mTimeoutTimes;
+};
+
+TEST_F(PendingRequestTimerTest, testRequestsTimeOutInDeadlineOrder) {
+    // More distinct timeouts than a fixed set of per-timeout pools could serve, added in reverse
+    // order of their deadlines.
+    constexpr int64_t kRequestCount = 12;
+    steady_clock::time_point now = steady_clock::now();
+    std::unordered_map<int64_t, steady_clock::time_point> deadlines;
+    for (int64_t requestId = kRequestCount - 1; requestId >= 0; requestId--) {
+        deadlines[requestId] = now + milliseconds(20 + requestId * 15);
+        mTimer->addRequest(requestId, deadlines[requestId], mCallback);
+    }
+
+    ASSERT_TRUE(waitForTimeouts(kRequestCount, milliseconds(5'000)));
+
+    std::vector<int64_t> expectedRequestIds;
+    for (int64_t requestId = 0; requestId < kRequestCount; requestId++) {
+        expectedRequestIds.push_back(requestId);
+        ASSERT_GE(getTimeoutTime(requestId), deadlines[requestId])
+                << "request " << requestId << " timed out before its deadline";
+    }
+    ASSERT_EQ(getTimedOutRequestIds(), expectedRequestIds);
+}
+
+TEST_F(PendingRequestTimerTest, testEarlierRequestWakesUpTimer) {
+    steady_clock::time_point now = steady_clock::now();
+    mTimer->addRequest(/*requestId=*/0, now + milliseconds(10'000), mCallback);
+    mTimer->addRequest(/*requestId=*/1, now + milliseconds(10), mCallback);
+
+    ASSERT_TRUE(waitForTimeouts(1, milliseconds(1'000)));
+    ASSERT_EQ(getTimedOutRequestIds(), std::vector<int64_t>({1}));
+    ASSERT_TRUE(mTimer->isRequestPending(0));
+}
+
+TEST_F(PendingRequestTimerTest, testDefaultTimeout) {
+    steady_clock::time_point start = steady_clock::now();
+    mTimer->addRequest(/*requestId=*/0, PendingRequestTimer::Deadline::max(), mCallback);
+
+    ASSERT_TRUE(waitForTimeouts(1, milliseconds(5'000)));
+    ASSERT_GE(getTimeoutTime(0) - start, milliseconds(50));
+}
+
+TEST_F(PendingRequestTimerTest, testFinishedRequestDoesNotTimeOut) {
+    mTimer->addRequest(/*requestId=*/0, steady_clock::now() + milliseconds(20), mCallback);
+
+    ASSERT_TRUE(mTimer->isRequestPending(0));
+    ASSERT_TRUE(mTimer->tryFinishRequest(0));
+    ASSERT_FALSE(mTimer->isRequestPending(0));
+    ASSERT_FALSE(mTimer->tryFinishRequest(0));
+
+    ASSERT_FALSE(waitForTimeouts(1, milliseconds(100)));
+}
+
+TEST_F(PendingRequestTimerTest, testTimedOutRequestCannotBeFinished) {
+    mTimer->addRequest(/*requestId=*/0, steady_clock::now() + milliseconds(10), mCallback);
+
+    ASSERT_TRUE(waitForTimeouts(1, milliseconds(1'000)));
+    ASSERT_FALSE(mTimer->isRequestPending(0));
+    ASSERT_FALSE(mTimer->tryFinishRequest(0));
+}
+
+TEST_F(PendingRequestTimerTest, testResetTimesOutAllRequests) {
+    steady_clock::time_point deadline = steady_clock::now() + milliseconds(10'000);
+    mTimer->addRequest(/*requestId=*/0, deadline, mCallback);
+    mTimer->addRequest(/*requestId=*/1, deadline, mCallback);
+
+    mTimer->reset();
+
+    ASSERT_TRUE(waitForTimeouts(2, milliseconds(0)));
+    ASSERT_FALSE(mTimer->isRequestPending(0));
+    ASSERT_FALSE(mTimer->isRequestPending(1));
+}
+
+TEST_F(PendingRequestTimerTest, testDestructorTimesOutAllRequests) {
+    mTimer->addRequest(/*requestId=*/0, steady_clock::now() + milliseconds(10'000), mCallback);
+
+    mTimer.reset();
+
+    ASSERT_TRUE(waitForTimeouts(1, milliseconds(0)));
+}
+
+}  // namespace timer_test
+}  // namespace vhal
+}  // namespace automotive
+}  // namespace frameworks
+}  // namespace android
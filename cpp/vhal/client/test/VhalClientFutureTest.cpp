@@ -0,0 +1,202 @@
+/*
+ * Copyright (c) 2024, The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <gtest/gtest.h>
+
+#include <VhalClientFuture.h>
+
+#include <chrono>  // NOLINT
+#include <thread>  // NOLINT
+#include <vector>
+
+namespace android {
+namespace frameworks {
+namespace automotive {
+namespace vhal {
+namespace future_test {
+
+TEST(VhalClientFutureTest, testGetReadyResult) {
+    VhalClientPromise<int> promise;
+    auto future = promise.getFuture();
+
+    ASSERT_FALSE(future.isReady());
+    ASSERT_TRUE(promise.setResult(1));
+    ASSERT_TRUE(future.isReady());
+
+    auto result = future.get();
+    ASSERT_TRUE(result.ok());
+    ASSERT_EQ(result.value(), 1);
+}
+
+TEST(VhalClientFutureTest, testGetFromAnotherThread) {
+    VhalClientPromise<int> promise;
+    auto future = promise.getFuture();
+
+    std::thread t([promise] {
+        std::this_thread::sleep_for(std::chrono::milliseconds(10));
+        promise.setResult(ClientStatusError(ErrorCode::TIMEOUT) << "timed out");
+    });
+    auto result = future.get();
+    t.join();
+
+    ASSERT_FALSE(result.ok());
+    ASSERT_EQ(result.error().code(), ErrorCode::TIMEOUT);
+}
+
+TEST(VhalClientFutureTest, testWaitForTimesOut) {
+    VhalClientPromise<void> promise;
+    auto future = promise.getFuture();
+
+    ASSERT_FALSE(future.waitFor(std::chrono::milliseconds(10)));
+
+    promise.setResult({});
+
+    ASSERT_TRUE(future.waitFor(std::chrono::milliseconds(10)));
+}
+
+TEST(VhalClientFutureTest, testSetResultFirstWins) {
+    VhalClientPromise<int> promise;
+    auto future = promise.getFuture();
+
+    ASSERT_TRUE(promise.setResult(1));
+    ASSERT_FALSE(promise.setResult(ClientStatusError(ErrorCode::TIMEOUT) << "timed out"));
+
+    auto result = future.get();
+    ASSERT_TRUE(result.ok());
+    ASSERT_EQ(result.value(), 1);
+}
+
+TEST(VhalClientFutureTest, testThenBeforeResult) {
+    VhalClientPromise<int> promise;
+    int gotValue = 0;
+
+    promise.getFuture().then([&gotValue](VhalClientResult<int> result) {
+        gotValue = result.value();
+    });
+
+    ASSERT_EQ(gotValue, 0);
+
+    promise.setResult(2);
+
+    ASSERT_EQ(gotValue, 2);
+}
+
+TEST(VhalClientFutureTest, testThenAfterResult) {
+    VhalClientPromise<int> promise;
+    promise.setResult(2);
+    int gotValue = 0;
+
+    promise.getFuture().then([&gotValue](VhalClientResult<int> result) {
+        gotValue = result.value();
+    });
+
+    ASSERT_EQ(gotValue, 2);
+}
+
+TEST(VhalClientFutureTest, testThenChained) {
+    VhalClientPromise<int> promise;
+
+    auto future = promise.getFuture().then([](VhalClientResult<int> result) -> VhalClientResult<
+                                                                                    bool> {
+        if (!result.ok()) {
+            return ClientStatusError(result.error().code()) << result.error().message();
+        }
+        return result.value() > 1;
+    });
+    promise.setResult(2);
+
+    auto result = future.get();
+    ASSERT_TRUE(result.ok());
+    ASSERT_TRUE(result.value());
+}
+
+TEST(VhalClientFutureTest, testGetAfterThen) {
+    VhalClientPromise<int> promise;
+    auto future = promise.getFuture();
+    int gotValue = 0;
+
+    future.then([&gotValue](VhalClientResult<int> result) { gotValue = result.value(); });
+    promise.setResult(2);
+
+    ASSERT_EQ(gotValue, 2);
+    auto result = future.get();
+    ASSERT_FALSE(result.ok());
+    ASSERT_EQ(result.error().code(), ErrorCode::INVALID_ARG);
+}
+
+TEST(VhalClientFutureTest, testThenAfterGet) {
+    VhalClientPromise<int> promise;
+    auto future = promise.getFuture();
+    promise.setResult(2);
+    ASSERT_TRUE(future.get().ok());
+    ErrorCode gotCode = ErrorCode::OK;
+
+    future.then([&gotCode](VhalClientResult<int> result) { gotCode = result.error().code(); });
+
+    ASSERT_EQ(gotCode, ErrorCode::INVALID_ARG);
+}
+
+TEST(VhalClientFutureTest, testInvalidFuture) {
+    VhalClientFuture<int> future;
+    ErrorCode gotCode = ErrorCode::OK;
+
+    ASSERT_FALSE(future.isValid());
+    ASSERT_FALSE(future.isReady());
+    future.wait();
+    ASSERT_FALSE(future.waitFor(std::chrono::milliseconds(10)));
+    auto result = future.get();
+    ASSERT_FALSE(result.ok());
+    ASSERT_EQ(result.error().code(), ErrorCode::INVALID_ARG);
+    future.then([&gotCode](VhalClientResult<int> result) { gotCode = result.error().code(); });
+    ASSERT_EQ(gotCode, ErrorCode::INVALID_ARG);
+}
+
+TEST(VhalClientFutureTest, testWhenAll) {
+    VhalClientPromise<int> promise1;
+    VhalClientPromise<int> promise2;
+    std::vector<VhalClientFuture<int>> futures = {promise1.getFuture(), promise2.getFuture()};
+
+    auto future = whenAll(std::move(futures));
+
+    // Finish out of order, the results must still follow the order of the futures.
+    promise2.setResult(ClientStatusError(ErrorCode::NOT_AVAILABLE_FROM_VHAL) << "not available");
+    ASSERT_FALSE(future.isReady());
+    promise1.setResult(1);
+    ASSERT_TRUE(future.isReady());
+
+    auto results = future.get();
+    ASSERT_TRUE(results.ok());
+    ASSERT_EQ(results.value().size(), 2u);
+    ASSERT_TRUE(results.value()[0].ok());
+    ASSERT_EQ(results.value()[0].value(), 1);
+    ASSERT_FALSE(results.value()[1].ok());
+    ASSERT_EQ(results.value()[1].error().code(), ErrorCode::NOT_AVAILABLE_FROM_VHAL);
+}
+
+TEST(VhalClientFutureTest, testWhenAllEmpty) {
+    auto future = whenAll(std::vector<VhalClientFuture<int>>());
+
+    ASSERT_TRUE(future.isReady());
+    auto results = future.get();
+    ASSERT_TRUE(results.ok());
+    ASSERT_TRUE(results.value().empty());
+}
+
+}  // namespace future_test
+}  // namespace vhal
+}  // namespace automotive
+}  // namespace frameworks
+}  // namespace android
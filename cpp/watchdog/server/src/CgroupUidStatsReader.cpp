@@ -0,0 +1,149 @@
+/*
+ * Copyright (c) 2024, The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#define LOG_TAG "carwatchdogd"
+
+#include "CgroupUidStatsReader.h"
+
+#include <android-base/stringprintf.h>
+#include <android-base/strings.h>
+
+#include <dirent.h>
+#include <unistd.h>
+
+#include <memory>
+
+namespace android {
+namespace automotive {
+namespace watchdog {
+
+using ::android::base::Error;
+using ::android::base::Result;
+using ::android::base::StartsWith;
+using ::android::base::StringPrintf;
+
+namespace {
+
+constexpr const char kUidCgroupPrefix[] = "uid_";
+// Only cgroup v2 roots have this file.
+constexpr const char kCgroupControllersFile[] = "cgroup.controllers";
+
+// Returns true and sets |uid| when |name| is a UID cgroup's directory name.
+bool parseUidCgroupName(std::string_view name, uid_t* uid) {
+    if (!StartsWith(name, kUidCgroupPrefix)) {
+        return false;
+    }
+    name.remove_prefix(sizeof(kUidCgroupPrefix) - 1);
+    return parseIntField(name, uid);
+}
+
+}  // namespace
+
+bool CgroupUidStatsReader::isAvailable() const {
+    if (access(StringPrintf("%s/%s", mRootPath.c_str(), kCgroupControllersFile).c_str(), R_OK) !=
+        0) {
+        return false;
+    }
+    auto rootDirp = std::unique_ptr<DIR, int (*)(DIR*)>(opendir(mRootPath.c_str()), closedir);
+    if (!rootDirp) {
+        return false;
+    }
+    for (const dirent* entry = nullptr; (entry = readdir(rootDirp.get())) != nullptr;) {
+        uid_t uid = 0;
+        if (entry->d_type != DT_DIR || !parseUidCgroupName(entry->d_name, &uid)) {
+            continue;
+        }
+        const std::string path =
+                StringPrintf("%s/%s/%s", mRootPath.c_str(), entry->d_name, mFileName.c_str());
+        if (access(path.c_str(), R_OK) == 0) {
+            return true;
+        }
+    }
+    return false;
+}
+
+Result<void> CgroupUidStatsReader::read(
+        const std::function<Result<void>(uid_t, bool, std::string_view)>& parseFile) {
+    auto rootDirp = std::unique_ptr<DIR, int (*)(DIR*)>(opendir(mRootPath.c_str()), closedir);
+    if (!rootDirp) {
+        return Error() << "Failed to open " << mRootPath << " directory";
+    }
+    // Moves the readers of the listed UID cgroups, so the readers of the removed UID cgroups are
+    // dropped with the old map.
+    std::unordered_map<uid_t, UidCgroup> cgroups;
+    cgroups.reserve(mCgroups.size());
+    for (const dirent* entry = nullptr; (entry = readdir(rootDirp.get())) != nullptr;) {
+        uid_t uid = 0;
+        if (entry->d_type != DT_DIR || !parseUidCgroupName(entry->d_name, &uid)) {
+            continue;
+        }
+        auto node = mCgroups.extract(uid);
+        const bool isNewCgroup = node.empty() || node.mapped().inode != entry->d_ino;
+        if (isNewCgroup) {
+            // The reader of a removed cgroup must not be reused for the recreated cgroup.
+            cgroups.emplace(uid,
+                            UidCgroup{entry->d_ino,
+                                      ProcFileReader(StringPrintf("%s/%s/%s", mRootPath.c_str(),
+                                                                  entry->d_name,
+                                                                  mFileName.c_str()))});
+        } else {
+            cgroups.insert(std::move(node));
+        }
+        ProcFileReader& reader = cgroups.at(uid).reader;
+        auto contents = reader.read();
+        if (!contents.ok()) {
+            // The cgroup is removed when the UID's last process exits.
+            cgroups.erase(uid);
+            continue;
+        }
+        if (auto result = parseFile(uid, isNewCgroup, *contents); !result.ok()) {
+            // Keeps the readers, so the next read doesn't report the listed cgroups as new. Merging
+            // moves the nodes, so |reader| stays valid.
+            mCgroups.merge(cgroups);
+            return Error() << "Failed to parse " << reader.path() << ": " << result.error();
+        }
+    }
+    mCgroups = std::move(cgroups);
+    if (mCgroups.empty()) {
+        return Error() << "No UID cgroup with " << mFileName << " in " << mRootPath;
+    }
+    return {};
+}
+
+std::string CgroupUidStatsReader::filePath() const {
+    return StringPrintf("%s/%s*/%s", mRootPath.c_str(), kUidCgroupPrefix, mFileName.c_str());
+}
+
+Result<int64_t> parseCgroupCpuTimeMillis(std::string_view contents,
+                                         std::vector<std::string_view>* fields) {
+    LineReader lineReader(contents);
+    for (std::string_view line; lineReader.next(&line);) {
+        splitFields(line, ' ', fields);
+        if (fields->size() != 2 || (*fields)[0] != "usage_usec") {
+            continue;
+        }
+        int64_t usageUs = 0;
+        if (!parseIntField((*fields)[1], &usageUs)) {
+            return Error() << "Invalid line \"" << line << "\"";
+        }
+        return usageUs / 1000;
+    }
+    return Error() << "Missing usage_usec";
+}
+
+}  // namespace watchdog
+}  // namespace automotive
+}  // namespace android
@@ -0,0 +1,99 @@
+/*
+ * Copyright (c) 2024, The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef CPP_WATCHDOG_SERVER_SRC_CGROUPUIDSTATSREADER_H_
+#define CPP_WATCHDOG_SERVER_SRC_CGROUPUIDSTATSREADER_H_
+
+#include "ProcFileReader.h"
+
+#include <android-base/result.h>
+
+#include <stdint.h>
+#include <sys/types.h>
+
+#include <functional>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+namespace android {
+namespace automotive {
+namespace watchdog {
+
+inline constexpr char kCgroupV2RootPath[] = "/sys/fs/cgroup";
+inline constexpr char kCgroupCpuStatFile[] = "cpu.stat";
+
+/**
+ * Reads an accounting file, such as `cpu.stat`, of every UID cgroup in the cgroup v2 UID/PID
+ * hierarchy. In this hierarchy, the processes of a UID live in `<root>/uid_<uid>/pid_<pid>`
+ * cgroups and the accounting files of `<root>/uid_<uid>` hold the totals for the UID.
+ *
+ * The reader keeps a persistent reader per UID cgroup, so a collection costs a directory read
+ * and one read per UID.
+ *
+ * The class isn't thread-safe. The owning collector must serialize the reads.
+ */
+class CgroupUidStatsReader final {
+public:
+    CgroupUidStatsReader(const std::string& rootPath, const std::string& fileName) :
+          mRootPath(rootPath), mFileName(fileName) {}
+
+    CgroupUidStatsReader(CgroupUidStatsReader&&) = default;
+    CgroupUidStatsReader& operator=(CgroupUidStatsReader&&) = default;
+
+    // Returns true when |mRootPath| is a cgroup v2 root with a readable accounting file in a UID
+    // cgroup.
+    bool isAvailable() const;
+
+    /**
+     * Calls |parseFile| with the accounting file's contents of each UID cgroup. |isNewCgroup| is
+     * true when the previous read didn't see the UID cgroup, including when the cgroup was removed
+     * and recreated since then. Skips the UID cgroups removed after listing the root directory.
+     */
+    android::base::Result<void> read(
+            const std::function<android::base::Result<void>(uid_t, bool isNewCgroup,
+                                                            std::string_view)>& parseFile);
+
+    // Returns the path pattern of the accounting files.
+    std::string filePath() const;
+
+private:
+    std::string mRootPath;
+
+    std::string mFileName;
+
+    struct UidCgroup {
+        // Inode of the UID cgroup's directory. A recreated cgroup gets a new inode.
+        ino_t inode;
+        ProcFileReader reader;
+    };
+
+    std::unordered_map<uid_t, UidCgroup> mCgroups;
+};
+
+/**
+ * Parses the CPU time in milliseconds from the `usage_usec` field of a cgroup v2 `cpu.stat`
+ * file.
+ */
+android::base::Result<int64_t> parseCgroupCpuTimeMillis(std::string_view contents,
+                                                        std::vector<std::string_view>* fields);
+
+}  // namespace watchdog
+}  // namespace automotive
+}  // namespace android
+
+#endif  //  CPP_WATCHDOG_SERVER_SRC_CGROUPUIDSTATSREADER_H_
@@ -0,0 +1,602 @@
+/*
+ * Copyright (c) 2024, The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#define LOG_TAG "carwatchdogd"
+
+#include "CpuOveruseMonitor.h"
+
+#include <WatchdogProperties.sysprop.h>
+#include <aidl/android/automotive/watchdog/internal/UidType.h>
+#include <android-base/file.h>
+#include <android-base/parseint.h>
+#include <android-base/properties.h>
+#include <android-base/stringprintf.h>
+#include <android-base/strings.h>
+#include <android-base/unique_fd.h>
+#include <cutils/multiuser.h>
+#include <log/log.h>
+
+#include <inttypes.h>
+#include <sched.h>
+#include <signal.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+namespace android {
+namespace automotive {
+namespace watchdog {
+
+using ::aidl::android::automotive::watchdog::internal::ApplicationCategoryType;
+using ::aidl::android::automotive::watchdog::internal::ComponentType;
+using ::aidl::android::automotive::watchdog::internal::PackageInfo;
+using ::aidl::android::automotive::watchdog::internal::ResourceStats;
+using ::aidl::android::automotive::watchdog::internal::ResourceUsageStats;
+using ::aidl::android::automotive::watchdog::internal::ThreadPolicyWithPriority;
+using ::aidl::android::automotive::watchdog::internal::UidResourceUsageStats;
+using ::aidl::android::automotive::watchdog::internal::UidType;
+using ::android::sp;
+using ::android::wp;
+using ::android::base::ErrnoError;
+using ::android::base::Error;
+using ::android::base::GetIntProperty;
+using ::android::base::GetProperty;
+using ::android::base::ParseInt;
+using ::android::base::ReadFileToString;
+using ::android::base::Result;
+using ::android::base::Split;
+using ::android::base::StringAppendF;
+using ::android::base::StringPrintf;
+using ::android::base::Trim;
+using ::android::base::unique_fd;
+using ::android::base::WriteStringToFd;
+
+namespace {
+
+std::string uniquePackageIdStr(const PackageInfo& packageInfo) {
+    return StringPrintf("%s:%" PRId32, packageInfo.packageIdentifier.name.c_str(),
+                        multiuser_get_user_id(packageInfo.packageIdentifier.uid));
+}
+
+double percentage(int64_t numer, int64_t denom) {
+    return denom <= 0 ? 0.0 : (static_cast<double>(numer) / static_cast<double>(denom)) * 100.0;
+}
+
+Result<ApplicationCategoryType> toApplicationCategoryType(const std::string& value) {
+    if (value == "MAPS") {
+        return ApplicationCategoryType::MAPS;
+    }
+    if (value == "MEDIA") {
+        return ApplicationCategoryType::MEDIA;
+    }
+    return Error() << "Unsupported application category '" << value << "'";
+}
+
+bool isValidCpuSharePercent(double value) {
+    return value > 0.0 && value <= 100.0;
+}
+
+bool containsAnyPackage(const PackageInfo& packageInfo,
+                        const std::unordered_set<std::string>& packages) {
+    if (packages.count(packageInfo.packageIdentifier.name) > 0) {
+        return true;
+    }
+    for (const auto& packageName : packageInfo.sharedUidPackages) {
+        if (packages.count(packageName) > 0) {
+            return true;
+        }
+    }
+    return false;
+}
+
+CpuOveruseConfiguration readComponentConfiguration(
+        ComponentType componentType, const char* maxCpuSharePercentProperty,
+        int defaultMaxCpuSharePercent, const std::vector<std::string>& safeToKillPackages) {
+    return CpuOveruseConfiguration{
+            .componentType = componentType,
+            .safeToKillPackages = safeToKillPackages,
+            .componentLevelThreshold = {.name = toString(componentType),
+                                        .maxCpuSharePercent = static_cast<double>(
+                                                GetIntProperty(maxCpuSharePercentProperty,
+                                                               defaultMaxCpuSharePercent,
+                                                               /*min=*/1, /*max=*/100))},
+    };
+}
+
+}  // namespace
+
+std::vector<CpuOveruseConfiguration> readCpuOveruseConfigurations() {
+    std::vector<std::string> safeToKillPackages;
+    for (const auto& packageName :
+         Split(GetProperty(kPropertyCpuOveruseSafeToKillPackages, /*default_value=*/""), ",")) {
+        if (std::string trimmed = Trim(packageName); !trimmed.empty()) {
+            safeToKillPackages.push_back(std::move(trimmed));
+        }
+    }
+    // Safe to kill packages are matched only against the packages of the same component, so the
+    // list is shared by all the components.
+    return {readComponentConfiguration(ComponentType::SYSTEM, kPropertySystemMaxCpuSharePercent,
+                                       kDefaultSystemMaxCpuSharePercent, safeToKillPackages),
+            readComponentConfiguration(ComponentType::VENDOR, kPropertyVendorMaxCpuSharePercent,
+                                       kDefaultVendorMaxCpuSharePercent, safeToKillPackages),
+            readComponentConfiguration(ComponentType::THIRD_PARTY,
+                                       kPropertyThirdPartyMaxCpuSharePercent,
+                                       kDefaultThirdPartyMaxCpuSharePercent, safeToKillPackages)};
+}
+
+std::string toString(CpuOveruseAction action) {
+    switch (action) {
+        case CpuOveruseAction::NONE:
+            return "NONE";
+        case CpuOveruseAction::NOTIFY:
+            return "NOTIFY";
+        case CpuOveruseAction::DEPRIORITIZE:
+            return "DEPRIORITIZE";
+        case CpuOveruseAction::KILL:
+            return "KILL";
+    }
+    return "UNKNOWN";
+}
+
+std::string PackageCpuOveruseStats::toString() const {
+    return StringPrintf("Package: %s, User: %" PRId32 ", Action: %s, CPU time: %" PRId64
+                        " ms, CPU share: %.2f%%, Budget: %.2f%%\n",
+                        packageInfo.packageIdentifier.name.c_str(),
+                        multiuser_get_user_id(packageInfo.packageIdentifier.uid),
+                        watchdog::toString(action).c_str(), cpuTimeMillis, cpuSharePercent,
+                        maxCpuSharePercent);
+}
+
+Result<void> CpuOveruseMonitor::init() {
+    Mutex::Autolock lock(mMutex);
+    mSystemConfig = {};
+    mVendorConfig = {};
+    mThirdPartyConfig = {};
+    mPerCategoryMaxCpuSharePercent.clear();
+    return {};
+}
+
+void CpuOveruseMonitor::onCarWatchdogServiceRegistered() {
+    Mutex::Autolock lock(mMutex);
+    mDoSendResourceUsageStats =
+            sysprop::syncResourceUsageStatsWithCarServiceEnabled().value_or(false);
+}
+
+void CpuOveruseMonitor::terminate() {
+    Mutex::Autolock lock(mMutex);
+    for (auto& [_, usage] : mCpuUsageById) {
+        restorePriorityLocked(&usage);
+    }
+    mCpuUsageById.clear();
+    mSystemSamples.clear();
+    mSystemWindowCpuTimeMillis = 0;
+    mTrackingStartTime.reset();
+}
+
+Result<void> CpuOveruseMonitor::updateCpuOveruseConfigurations(
+        const std::vector<CpuOveruseConfiguration>& configs) {
+    Mutex::Autolock lock(mMutex);
+    std::unordered_set<ComponentType> seenComponentTypes;
+    for (const auto& config : configs) {
+        if (componentConfigLocked(config.componentType) == nullptr) {
+            return Error() << "Invalid component type " << toString(config.componentType);
+        }
+        if (seenComponentTypes.count(config.componentType) > 0) {
+            return Error() << "Cannot provide duplicate configs for the same component type "
+                           << toString(config.componentType);
+        }
+        if (!isValidCpuSharePercent(config.componentLevelThreshold.maxCpuSharePercent)) {
+            return Error() << "Component level CPU share budget for "
+                           << toString(config.componentType) << " must be within (0, 100]";
+        }
+        if (config.componentType != ComponentType::VENDOR &&
+            !config.categorySpecificThresholds.empty()) {
+            return Error() << "Only the vendor configuration may define category budgets";
+        }
+        seenComponentTypes.insert(config.componentType);
+    }
+    std::string errorMsgs;
+    for (const auto& config : configs) {
+        ComponentConfig* target = componentConfigLocked(config.componentType);
+        *target = {
+                .maxCpuSharePercent = config.componentLevelThreshold.maxCpuSharePercent,
+                .safeToKillPackages = {config.safeToKillPackages.begin(),
+                                       config.safeToKillPackages.end()},
+                .exemptPackages = {config.exemptPackages.begin(), config.exemptPackages.end()},
+        };
+        for (const auto& threshold : config.packageSpecificThresholds) {
+            if (threshold.name.empty() || !isValidCpuSharePercent(threshold.maxCpuSharePercent)) {
+                StringAppendF(&errorMsgs, "\tSkipping invalid package budget '%s'\n",
+                              threshold.name.c_str());
+                continue;
+            }
+            target->perPackageMaxCpuSharePercent[threshold.name] = threshold.maxCpuSharePercent;
+        }
+        if (config.componentType != ComponentType::VENDOR) {
+            continue;
+        }
+        mPerCategoryMaxCpuSharePercent.clear();
+        for (const auto& threshold : config.categorySpecificThresholds) {
+            const auto categoryType = toApplicationCategoryType(threshold.name);
+            if (!categoryType.ok() || !isValidCpuSharePercent(threshold.maxCpuSharePercent)) {
+                StringAppendF(&errorMsgs, "\tSkipping invalid category budget '%s'\n",
+                              threshold.name.c_str());
+                continue;
+            }
+            mPerCategoryMaxCpuSharePercent[*categoryType] = threshold.maxCpuSharePercent;
+        }
+    }
+    if (!errorMsgs.empty()) {
+        ALOGW("CPU overuse configs updated with errors:\n%s", errorMsgs.c_str());
+    }
+    return {};
+}
+
+Result<void> CpuOveruseMonitor::onPeriodicCollection(
+        time_point_millis time, [[maybe_unused]] SystemState systemState,
+        const wp<UidStatsCollectorInterface>& uidStatsCollector,
+        const wp<ProcStatCollectorInterface>& procStatCollector, ResourceStats* resourceStats) {
+    const sp<UidStatsCollectorInterface> uidStatsCollectorSp = uidStatsCollector.promote();
+    const sp<ProcStatCollectorInterface> procStatCollectorSp = procStatCollector.promote();
+    if (uidStatsCollectorSp == nullptr || procStatCollectorSp == nullptr) {
+        return Error() << "Per-UID stats collector and proc stat collector must not be null";
+    }
+    const std::vector<UidStats> uidStats = uidStatsCollectorSp->deltaStats();
+    const int64_t systemCpuTimeMillis = procStatCollectorSp->deltaStats().totalCpuTimeMillis();
+
+    Mutex::Autolock lock(mMutex);
+    if (!mTrackingStartTime.has_value()) {
+        mTrackingStartTime = time;
+    }
+    addSample(time, systemCpuTimeMillis, &mSystemSamples, &mSystemWindowCpuTimeMillis);
+
+    std::unordered_set<std::string> seenIds;
+    for (const auto& curUidStats : uidStats) {
+        if (!curUidStats.hasPackageInfo()) {
+            continue;
+        }
+        const std::string id = uniquePackageIdStr(curUidStats.packageInfo);
+        seenIds.insert(id);
+        PackageCpuUsage& usage = mCpuUsageById[id];
+        addSample(time, curUidStats.cpuTimeMillis, &usage.samples, &usage.windowCpuTimeMillis);
+    }
+    for (auto it = mCpuUsageById.begin(); it != mCpuUsageById.end();) {
+        if (seenIds.count(it->first) > 0) {
+            ++it;
+            continue;
+        }
+        // The package didn't run during the collection.
+        addSample(time, 0, &it->second.samples, &it->second.windowCpuTimeMillis);
+        if (it->second.windowCpuTimeMillis == 0 && it->second.deprioritizedThreads.empty()) {
+            it = mCpuUsageById.erase(it);
+            continue;
+        }
+        ++it;
+    }
+
+    if (time - *mTrackingStartTime < kOveruseWindow || mSystemWindowCpuTimeMillis <= 0) {
+        // The sliding window isn't full yet, so the CPU share isn't representative.
+        return {};
+    }
+
+    std::vector<UidResourceUsageStats> overusingUidStats;
+    for (const auto& curUidStats : uidStats) {
+        if (!curUidStats.hasPackageInfo()) {
+            continue;
+        }
+        const PackageInfo& packageInfo = curUidStats.packageInfo;
+        const std::string id = uniquePackageIdStr(packageInfo);
+        PackageCpuUsage& usage = mCpuUsageById[id];
+        const double cpuSharePercent =
+                percentage(usage.windowCpuTimeMillis, mSystemWindowCpuTimeMillis);
+        const double maxCpuSharePercent = fetchMaxCpuSharePercentLocked(packageInfo);
+        if (cpuSharePercent <= maxCpuSharePercent || isExemptLocked(curUidStats)) {
+            restorePriorityLocked(&usage);
+            usage.lastAction = CpuOveruseAction::NONE;
+            continue;
+        }
+        const CpuOveruseAction action = nextActionLocked(usage, packageInfo, time);
+        if (action == CpuOveruseAction::DEPRIORITIZE) {
+            // Deprioritize again on every collection to catch the newly created threads.
+            deprioritizeLocked(curUidStats, &usage);
+        } else if (action == CpuOveruseAction::KILL) {
+            killLocked(curUidStats);
+        }
+        if (action != usage.lastAction) {
+            PackageCpuOveruseStats stats{
+                    .packageInfo = packageInfo,
+                    .reportTime = time,
+                    .action = action,
+                    .cpuTimeMillis = usage.windowCpuTimeMillis,
+                    .cpuSharePercent = cpuSharePercent,
+                    .maxCpuSharePercent = maxCpuSharePercent,
+            };
+            ALOGW("Detected CPU overuse. %s", stats.toString().c_str());
+            if (mActionHistory.size() >= kMaxCpuOveruseActionHistory) {
+                mActionHistory.erase(mActionHistory.begin());
+            }
+            mActionHistory.push_back(std::move(stats));
+            overusingUidStats.push_back({
+                    .packageIdentifier = packageInfo.packageIdentifier,
+                    .cpuUsageStats = {
+                            .cpuTimeMillis = curUidStats.cpuTimeMillis,
+                            .cpuCycles = static_cast<int64_t>(curUidStats.procStats.cpuCycles),
+                            .cpuTimePercentage =
+                                    percentage(curUidStats.cpuTimeMillis, systemCpuTimeMillis),
+                    },
+            });
+        }
+        if (action == CpuOveruseAction::KILL) {
+            // The killed processes no longer use the CPU, so start tracking the package afresh.
+            mCpuUsageById.erase(id);
+            continue;
+        }
+        if (action != usage.lastAction) {
+            usage.lastAction = action;
+            usage.lastActionTime = time;
+        }
+    }
+    if (resourceStats != nullptr && mDoSendResourceUsageStats && !overusingUidStats.empty()) {
+        // The internal AIDL has no CPU overuse stats, so report the overusing UIDs' usage to
+        // CarWatchdogService with the resource usage stats.
+        resourceStats->resourceUsageStats = ResourceUsageStats{
+                .startTimeEpochMillis = time.time_since_epoch().count(),
+                .uidResourceUsageStats = std::move(overusingUidStats),
+        };
+    }
+    return {};
+}
+
+void CpuOveruseMonitor::addSample(time_point_millis time, int64_t cpuTimeMillis,
+                                  std::deque<CpuTimeSample>* samples,
+                                  int64_t* windowCpuTimeMillis) const {
+    samples->push_back({.time = time, .cpuTimeMillis = cpuTimeMillis});
+    *windowCpuTimeMillis += cpuTimeMillis;
+    while (!samples->empty() && time - samples->front().time >= kOveruseWindow) {
+        *windowCpuTimeMillis -= samples->front().cpuTimeMillis;
+        samples->pop_front();
+    }
+}
+
+const CpuOveruseMonitor::ComponentConfig* CpuOveruseMonitor::componentConfigLocked(
+        ComponentType componentType) const {
+    return const_cast<CpuOveruseMonitor*>(this)->componentConfigLocked(componentType);
+}
+
+CpuOveruseMonitor::ComponentConfig* CpuOveruseMonitor::componentConfigLocked(
+        ComponentType componentType) {
+    switch (componentType) {
+        case ComponentType::SYSTEM:
+            return &mSystemConfig;
+        case ComponentType::VENDOR:
+            return &mVendorConfig;
+        case ComponentType::THIRD_PARTY:
+            return &mThirdPartyConfig;
+        default:
+            return nullptr;
+    }
+}
+
+double CpuOveruseMonitor::fetchMaxCpuSharePercentLocked(const PackageInfo& packageInfo) const {
+    const ComponentConfig* config = componentConfigLocked(packageInfo.componentType);
+    if (config == nullptr) {
+        return 100.0;
+    }
+    if (const auto it =
+                config->perPackageMaxCpuSharePercent.find(packageInfo.packageIdentifier.name);
+        it != config->perPackageMaxCpuSharePercent.end()) {
+        return it->second;
+    }
+    if (const auto it = mPerCategoryMaxCpuSharePercent.find(packageInfo.appCategoryType);
+        it != mPerCategoryMaxCpuSharePercent.end()) {
+        return it->second;
+    }
+    return config->maxCpuSharePercent;
+}
+
+bool CpuOveruseMonitor::isExemptLocked(const UidStats& uidStats) const {
+    const ComponentConfig* config = componentConfigLocked(uidStats.packageInfo.componentType);
+    if (config == nullptr || containsAnyPackage(uidStats.packageInfo, config->exemptPackages)) {
+        return true;
+    }
+    return isForegroundLocked(uidStats);
+}
+
+bool CpuOveruseMonitor::isForegroundLocked(const UidStats& uidStats) const {
+    if (uidStats.packageInfo.uidType != UidType::APPLICATION) {
+        // Only the activity manager sets the oom_score_adj from the process state.
+        return false;
+    }
+    for (const auto& [pid, _] : uidStats.procStats.processStatsByPid) {
+        if (const auto oomScoreAdj = mSystemCalls->readOomScoreAdj(pid);
+            oomScoreAdj.ok() && *oomScoreAdj <= kMaxPerceptibleOomScoreAdj) {
+            return true;
+        }
+    }
+    return false;
+}
+
+bool CpuOveruseMonitor::isSafeToKillLocked(const PackageInfo& packageInfo) const {
+    if (packageInfo.uidType == UidType::NATIVE) {
+        // Native services are restarted by init, so killing them doesn't stop the overuse.
+        return false;
+    }
+    const ComponentConfig* config = componentConfigLocked(packageInfo.componentType);
+    return config != nullptr && containsAnyPackage(packageInfo, config->safeToKillPackages);
+}
+
+CpuOveruseAction CpuOveruseMonitor::nextActionLocked(const PackageCpuUsage& usage,
+                                                     const PackageInfo& packageInfo,
+                                                     time_point_millis time) const {
+    if (usage.lastAction != CpuOveruseAction::NONE &&
+        time - usage.lastActionTime < kOveruseWindow) {
+        // Most of the window was measured before the last action, so the share doesn't show yet
+        // whether the action stopped the overuse.
+        return usage.lastAction;
+    }
+    switch (usage.lastAction) {
+        case CpuOveruseAction::NONE:
+            return CpuOveruseAction::NOTIFY;
+        case CpuOveruseAction::NOTIFY:
+            return CpuOveruseAction::DEPRIORITIZE;
+        default:
+            return isSafeToKillLocked(packageInfo) ? CpuOveruseAction::KILL
+                                                   : CpuOveruseAction::DEPRIORITIZE;
+    }
+}
+
+void CpuOveruseMonitor::deprioritizeLocked(const UidStats& uidStats, PackageCpuUsage* usage) {
+    std::unordered_set<pid_t> deprioritizedTids;
+    for (const auto& thread : usage->deprioritizedThreads) {
+        deprioritizedTids.insert(thread.tid);
+    }
+    const int uid = static_cast<int>(uidStats.uid());
+    std::vector<ThreadIdentifier> threads;
+    for (const auto& [pid, processStats] : uidStats.procStats.processStatsByPid) {
+        std::vector<pid_t> tids;
+        for (const auto& [tid, _] : processStats.cpuCyclesByTid) {
+            tids.push_back(tid);
+        }
+        if (tids.empty()) {
+            // Per-thread stats are unavailable, so deprioritize only the main thread.
+            tids.push_back(pid);
+        }
+        for (const pid_t tid : tids) {
+            if (deprioritizedTids.count(tid) == 0) {
+                threads.push_back({.pid = pid, .tid = tid, .uid = uid});
+            }
+        }
+    }
+    if (threads.empty()) {
+        return;
+    }
+    // Read and update all threads with batched calls, so the threads are validated with a single
+    // pass over the package's /proc entries.
+    const auto originalPolicies = mThreadPriorityController->getThreadPriorities(threads);
+    std::vector<ThreadPriorityRequest> requests;
+    std::vector<DeprioritizedThread> pendingThreads;
+    for (size_t i = 0; i < threads.size() && i < originalPolicies.size(); ++i) {
+        if (!originalPolicies[i].ok() || originalPolicies[i]->policy == SCHED_IDLE) {
+            continue;
+        }
+        requests.push_back({.thread = threads[i], .policy = SCHED_IDLE, .priority = 0});
+        pendingThreads.push_back({.pid = threads[i].pid,
+                                  .tid = threads[i].tid,
+                                  .uid = static_cast<uid_t>(uid),
+                                  .originalPolicy = *originalPolicies[i]});
+    }
+    if (requests.empty()) {
+        return;
+    }
+    const auto results = mThreadPriorityController->setThreadPriorities(requests);
+    for (size_t i = 0; i < pendingThreads.size() && i < results.size(); ++i) {
+        if (!results[i].ok()) {
+            ALOGW("Failed to deprioritize thread %d of '%s': %s", pendingThreads[i].tid,
+                  uidStats.genericPackageName().c_str(), results[i].error().message().c_str());
+            continue;
+        }
+        usage->deprioritizedThreads.push_back(pendingThreads[i]);
+    }
+}
+
+void CpuOveruseMonitor::restorePriorityLocked(PackageCpuUsage* usage) {
+    if (usage->deprioritizedThreads.empty()) {
+        return;
+    }
+    std::vector<ThreadPriorityRequest> requests;
+    requests.reserve(usage->deprioritizedThreads.size());
+    for (const auto& thread : usage->deprioritizedThreads) {
+        requests.push_back({.thread = {.pid = thread.pid,
+                                       .tid = thread.tid,
+                                       .uid = static_cast<int>(thread.uid)},
+                            .policy = thread.originalPolicy.policy,
+                            .priority = thread.originalPolicy.priority});
+    }
+    // Threads that exited in the meantime fail the validation, which is expected.
+    mThreadPriorityController->setThreadPriorities(requests);
+    usage->deprioritizedThreads.clear();
+}
+
+void CpuOveruseMonitor::killLocked(const UidStats& uidStats) {
+    // The pids are from the latest collection, so they may have been reused since.
+    for (const auto& [pid, _] : uidStats.procStats.processStatsByPid) {
+        if (const auto result = mSystemCalls->killProcess(pid, uidStats.uid()); !result.ok()) {
+            ALOGW("Failed to kill process %d of '%s': %s", pid,
+                  uidStats.genericPackageName().c_str(), result.error().message().c_str());
+        }
+    }
+}
+
+Result<void> CpuOveruseMonitor::onDump(int fd) const {
+    Mutex::Autolock lock(mMutex);
+    std::string buffer =
+            StringPrintf("\nCPU overuse monitor:\n%s\n", std::string(20, '-').c_str());
+    StringAppendF(&buffer, "Sliding window: %" PRId64 " seconds\n",
+                  std::chrono::duration_cast<std::chrono::seconds>(kOveruseWindow).count());
+    size_t deprioritizedPackageCount = 0;
+    for (const auto& [_, usage] : mCpuUsageById) {
+        deprioritizedPackageCount += usage.deprioritizedThreads.empty() ? 0 : 1;
+    }
+    StringAppendF(&buffer, "Deprioritized packages: %zu\n", deprioritizedPackageCount);
+    StringAppendF(&buffer, "Recent CPU overuse actions:\n");
+    if (mActionHistory.empty()) {
+        StringAppendF(&buffer, "\tNone\n");
+    }
+    for (const auto& stats : mActionHistory) {
+        StringAppendF(&buffer, "\t%s", stats.toString().c_str());
+    }
+    if (!WriteStringToFd(buffer, fd)) {
+        return Error(FAILED_TRANSACTION) << "Failed to dump the CPU overuse monitor";
+    }
+    return {};
+}
+
+Result<void> CpuOveruseMonitor::SystemCalls::killProcess(pid_t pid, uid_t uid) {
+    // The pidfd refers to the process that had the pid when it was opened. When the pid is reused
+    // after the UID check, the signal fails instead of reaching the new process.
+    unique_fd pidFd(static_cast<int>(syscall(__NR_pidfd_open, pid, /*flags=*/0)));
+    if (!pidFd.ok()) {
+        return ErrnoError() << "Failed to open pidfd";
+    }
+    const auto pidStatus = UidProcStatsCollector::readPidStatusFileForPid(pid);
+    if (!pidStatus.ok()) {
+        return Error() << pidStatus.error();
+    }
+    if (const uid_t processUid = std::get<0>(*pidStatus); processUid != uid) {
+        return Error() << "Process is owned by UID " << processUid << " instead of " << uid;
+    }
+    if (syscall(__NR_pidfd_send_signal, pidFd.get(), SIGKILL, /*info=*/nullptr, /*flags=*/0) !=
+        0) {
+        return ErrnoError() << "Failed to send SIGKILL";
+    }
+    return {};
+}
+
+Result<int> CpuOveruseMonitor::SystemCalls::readOomScoreAdj(pid_t pid) {
+    const std::string path = StringPrintf("/proc/%d/oom_score_adj", pid);
+    std::string buffer;
+    if (!ReadFileToString(path, &buffer)) {
+        return Error() << "Failed to read " << path;
+    }
+    int oomScoreAdj = 0;
+    if (!ParseInt(Trim(buffer), &oomScoreAdj)) {
+        return Error() << "Failed to parse " << path;
+    }
+    return oomScoreAdj;
+}
+
+}  // namespace watchdog
+}  // namespace automotive
+}  // namespace android
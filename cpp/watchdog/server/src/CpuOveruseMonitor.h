@@ -0,0 +1,373 @@
+/*
+ * Copyright (c) 2024, The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef CPP_WATCHDOG_SERVER_SRC_CPUOVERUSEMONITOR_H_
+#define CPP_WATCHDOG_SERVER_SRC_CPUOVERUSEMONITOR_H_
+
+#include "ProcStatCollector.h"
+#include "ThreadPriorityController.h"
+#include "UidStatsCollector.h"
+#include "WatchdogPerfService.h"
+
+#include <aidl/android/automotive/watchdog/internal/ApplicationCategoryType.h>
+#include <aidl/android/automotive/watchdog/internal/ComponentType.h>
+#include <aidl/android/automotive/watchdog/internal/PackageInfo.h>
+#include <aidl/android/automotive/watchdog/internal/ResourceStats.h>
+#include <aidl/android/automotive/watchdog/internal/ThreadPolicyWithPriority.h>
+#include <android-base/result.h>
+#include <android/util/ProtoOutputStream.h>
+#include <utils/Mutex.h>
+
+#include <deque>
+#include <memory>
+#include <optional>
+#include <string>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+namespace android {
+namespace automotive {
+namespace watchdog {
+
+// Sliding window over which the CPU share of a package is measured.
+constexpr std::chrono::milliseconds kDefaultCpuOveruseWindow = 5min;
+// Component level CPU share budgets used when the corresponding properties aren't set.
+constexpr int kDefaultSystemMaxCpuSharePercent = 100;
+constexpr int kDefaultVendorMaxCpuSharePercent = 100;
+constexpr int kDefaultThirdPartyMaxCpuSharePercent = 25;
+// Highest oom_score_adj of a process that the user can perceive. Matches PERCEPTIBLE_APP_ADJ in
+// the activity manager, which is above the foreground and visible app adjustments.
+constexpr int kMaxPerceptibleOomScoreAdj = 200;
+// Property that enables the CPU overuse monitor.
+constexpr const char kPropertyCpuOveruseEnabled[] = "ro.carwatchdog.cpu_overuse.enabled";
+// Properties that override the component level CPU share budgets.
+constexpr const char kPropertySystemMaxCpuSharePercent[] =
+        "ro.carwatchdog.cpu_overuse.system_max_cpu_share_percent";
+constexpr const char kPropertyVendorMaxCpuSharePercent[] =
+        "ro.carwatchdog.cpu_overuse.vendor_max_cpu_share_percent";
+constexpr const char kPropertyThirdPartyMaxCpuSharePercent[] =
+        "ro.carwatchdog.cpu_overuse.third_party_max_cpu_share_percent";
+// Property with the comma separated list of the packages that are safe to kill on CPU overuse.
+constexpr const char kPropertyCpuOveruseSafeToKillPackages[] =
+        "ro.carwatchdog.cpu_overuse.safe_to_kill_packages";
+// Maximum number of CPU overuse actions to cache for the dump.
+constexpr size_t kMaxCpuOveruseActionHistory = 50;
+
+// Forward declaration for testing use only.
+namespace internal {
+
+class CpuOveruseMonitorPeer;
+
+}  // namespace internal
+
+// CPU share budget for a package, an application category or a component.
+struct CpuOveruseThreshold {
+    // Package name, application category name (MAPS or MEDIA), or the component name.
+    std::string name;
+    // Maximum percentage of the total CPU time the package may use over the sliding window.
+    double maxCpuSharePercent = 0.0;
+};
+
+// CPU overuse configuration for a component.
+struct CpuOveruseConfiguration {
+    aidl::android::automotive::watchdog::internal::ComponentType componentType =
+            aidl::android::automotive::watchdog::internal::ComponentType::UNKNOWN;
+    // Packages that are killed when deprioritizing them doesn't stop the overuse.
+    std::vector<std::string> safeToKillPackages;
+    // Critical packages that are never acted on.
+    std::vector<std::string> exemptPackages;
+    // Budget for all packages in the component without a more specific budget.
+    CpuOveruseThreshold componentLevelThreshold;
+    // Per-package budgets. Packages must belong to the component.
+    std::vector<CpuOveruseThreshold> packageSpecificThresholds;
+    // Per application category budgets. Only the vendor configuration may define these.
+    std::vector<CpuOveruseThreshold> categorySpecificThresholds;
+};
+
+// Action taken on a package that overuses its CPU share budget. Actions escalate in this order when
+// the package is still over budget a full sliding window after the previous action.
+enum class CpuOveruseAction {
+    NONE = 0,
+    NOTIFY,
+    DEPRIORITIZE,
+    KILL,
+};
+
+std::string toString(CpuOveruseAction action);
+
+// Returns the CPU overuse configurations for all the components, with the component level budgets
+// and the safe to kill packages read from the system properties.
+std::vector<CpuOveruseConfiguration> readCpuOveruseConfigurations();
+
+// CPU overuse reported for a package.
+struct PackageCpuOveruseStats {
+    aidl::android::automotive::watchdog::internal::PackageInfo packageInfo;
+    time_point_millis reportTime;
+    CpuOveruseAction action = CpuOveruseAction::NONE;
+    // CPU time used by the package during the sliding window.
+    int64_t cpuTimeMillis = 0;
+    double cpuSharePercent = 0.0;
+    double maxCpuSharePercent = 0.0;
+
+    std::string toString() const;
+};
+
+/**
+ * CpuOveruseMonitor enforces per-package CPU share budgets.
+ *
+ * The CPU share of a package is its CPU time over a sliding window divided by the total CPU time
+ * of the system over the same window. When a package stays over its budget, the monitor first
+ * reports the overuse, then moves the package's threads to the SCHED_IDLE policy and finally kills
+ * the package when it is configured as safe to kill. Each step is taken only when the package is
+ * still over its budget a full window after the previous step, so the share is measured after the
+ * previous action took effect. Deprioritized threads are restored once the package is back within
+ * its budget.
+ *
+ * Foreground packages and the configured critical packages are exempt. An application package is
+ * considered foreground when any of its processes has an oom_score_adj at or below the
+ * perceptible app adjustment, as set by the activity manager from the process state.
+ *
+ * The overusing packages' usage is reported with the resource usage stats only when syncing the
+ * resource usage stats with CarWatchdogService is enabled. No package is acted on until the CPU
+ * overuse configurations are provided.
+ */
+class CpuOveruseMonitor final : public DataProcessorInterface {
+public:
+    // An interface for stubbing system calls in unit testing.
+    class SystemCallsInterface {
+    public:
+        // Kills the process only when it is still owned by the UID.
+        virtual android::base::Result<void> killProcess(pid_t pid, uid_t uid) = 0;
+        virtual android::base::Result<int> readOomScoreAdj(pid_t pid) = 0;
+
+        virtual ~SystemCallsInterface() = default;
+    };
+
+    CpuOveruseMonitor() :
+          CpuOveruseMonitor(std::make_unique<ThreadPriorityController>(),
+                            std::make_unique<SystemCalls>(), kDefaultCpuOveruseWindow) {}
+
+    CpuOveruseMonitor(std::unique_ptr<ThreadPriorityControllerInterface> threadPriorityController,
+                      std::unique_ptr<SystemCallsInterface> systemCalls,
+                      std::chrono::milliseconds overuseWindow) :
+          kOveruseWindow(overuseWindow),
+          mThreadPriorityController(std::move(threadPriorityController)),
+          mSystemCalls(std::move(systemCalls)) {}
+
+    ~CpuOveruseMonitor() { terminate(); }
+
+    std::string name() const override { return "CpuOveruseMonitor"; }
+
+    // Implements DataProcessorInterface.
+    android::base::Result<void> onSystemStartup() override {
+        // No CPU overuse tracking across system startup events.
+        return {};
+    }
+
+    void onCarWatchdogServiceRegistered() override;
+
+    android::base::Result<void> onBoottimeCollection(
+            [[maybe_unused]] time_point_millis time,
+            [[maybe_unused]] const android::wp<UidStatsCollectorInterface>& uidStatsCollector,
+            [[maybe_unused]] const android::wp<ProcStatCollectorInterface>& procStatCollector,
+            [[maybe_unused]] aidl::android::automotive::watchdog::internal::ResourceStats*
+                    resourceStats) override {
+        // Boot-time is CPU intensive by design, so don't enforce the budgets.
+        return {};
+    }
+
+    android::base::Result<void> onWakeUpCollection(
+            [[maybe_unused]] time_point_millis time,
+            [[maybe_unused]] const android::wp<UidStatsCollectorInterface>& uidStatsCollector,
+            [[maybe_unused]] const android::wp<ProcStatCollectorInterface>& procStatCollector)
+            override {
+        // No CPU overuse monitoring during wake up.
+        return {};
+    }
+
+    android::base::Result<void> onUserSwitchCollection(
+            [[maybe_unused]] time_point_millis time, [[maybe_unused]] userid_t from,
+            [[maybe_unused]] userid_t to,
+            [[maybe_unused]] const android::wp<UidStatsCollectorInterface>& uidStatsCollector,
+            [[maybe_unused]] const android::wp<ProcStatCollectorInterface>& procStatCollector)
+            override {
+        // No CPU overuse monitoring during user switch.
+        return {};
+    }
+
+    android::base::Result<void> onPeriodicCollection(
+            time_point_millis time, SystemState systemState,
+            const android::wp<UidStatsCollectorInterface>& uidStatsCollector,
+            const android::wp<ProcStatCollectorInterface>& procStatCollector,
+            aidl::android::automotive::watchdog::internal::ResourceStats* resourceStats) override;
+
+    android::base::Result<void> onCustomCollection(
+            [[maybe_unused]] time_point_millis time, [[maybe_unused]] SystemState systemState,
+            [[maybe_unused]] const std::unordered_set<std::string>& filterPackages,
+            [[maybe_unused]] const android::wp<UidStatsCollectorInterface>& uidStatsCollector,
+            [[maybe_unused]] const android::wp<ProcStatCollectorInterface>& procStatCollector,
+            [[maybe_unused]] aidl::android::automotive::watchdog::internal::ResourceStats*
+                    resourceStats) override {
+        // Custom collections are for debugging, so don't act on packages during them.
+        return {};
+    }
+
+    android::base::Result<void> onPeriodicMonitor(
+            [[maybe_unused]] time_t time,
+            [[maybe_unused]] const android::wp<ProcDiskStatsCollectorInterface>&
+                    procDiskStatsCollector,
+            [[maybe_unused]] const std::function<void()>& alertHandler) override {
+        // CPU overuse is tracked only on collections because it needs the per-UID stats.
+        return {};
+    }
+
+    android::base::Result<void> onDump(int fd) const override;
+
+    android::base::Result<void> onDumpProto(
+            [[maybe_unused]] const CollectionIntervals& collectionIntervals,
+            [[maybe_unused]] android::util::ProtoOutputStream& outProto) const override {
+        // No proto dump for CPU overuse monitoring.
+        return {};
+    }
+
+    android::base::Result<void> onCustomCollectionDump([[maybe_unused]] int fd) override {
+        // No special processing for custom collection. Thus no custom collection dump.
+        return {};
+    }
+
+    // Overwrites the CPU overuse configurations of the given components. Must be called after the
+    // monitor is registered with WatchdogPerfService.
+    android::base::Result<void> updateCpuOveruseConfigurations(
+            const std::vector<CpuOveruseConfiguration>& configs);
+
+protected:
+    android::base::Result<void> init() override;
+
+    void terminate() override;
+
+private:
+    class SystemCalls final : public SystemCallsInterface {
+        android::base::Result<void> killProcess(pid_t pid, uid_t uid) override;
+        android::base::Result<int> readOomScoreAdj(pid_t pid) override;
+    };
+
+    struct ComponentConfig {
+        double maxCpuSharePercent = 100.0;
+        std::unordered_map<std::string, double> perPackageMaxCpuSharePercent;
+        std::unordered_set<std::string> safeToKillPackages;
+        std::unordered_set<std::string> exemptPackages;
+    };
+
+    // CPU time used by a package or the system during a collection.
+    struct CpuTimeSample {
+        time_point_millis time;
+        int64_t cpuTimeMillis = 0;
+    };
+
+    // Thread deprioritized by the monitor and its policy before it was deprioritized.
+    struct DeprioritizedThread {
+        pid_t pid = 0;
+        pid_t tid = 0;
+        uid_t uid = 0;
+        aidl::android::automotive::watchdog::internal::ThreadPolicyWithPriority originalPolicy;
+    };
+
+    struct PackageCpuUsage {
+        std::deque<CpuTimeSample> samples;
+        int64_t windowCpuTimeMillis = 0;
+        CpuOveruseAction lastAction = CpuOveruseAction::NONE;
+        // Time when |lastAction| was first taken.
+        time_point_millis lastActionTime;
+        std::vector<DeprioritizedThread> deprioritizedThreads;
+    };
+
+    // Returns the config for the component or nullptr for an unsupported component.
+    const ComponentConfig* componentConfigLocked(
+            aidl::android::automotive::watchdog::internal::ComponentType componentType) const;
+    ComponentConfig* componentConfigLocked(
+            aidl::android::automotive::watchdog::internal::ComponentType componentType);
+
+    double fetchMaxCpuSharePercentLocked(
+            const aidl::android::automotive::watchdog::internal::PackageInfo& packageInfo) const;
+
+    bool isExemptLocked(const UidStats& uidStats) const;
+
+    bool isForegroundLocked(const UidStats& uidStats) const;
+
+    bool isSafeToKillLocked(
+            const aidl::android::automotive::watchdog::internal::PackageInfo& packageInfo) const;
+
+    // Adds the sample to the sliding window and drops the samples that fell out of the window.
+    void addSample(time_point_millis time, int64_t cpuTimeMillis,
+                   std::deque<CpuTimeSample>* samples, int64_t* windowCpuTimeMillis) const;
+
+    // Returns the next action for a package that is over its budget at |time|.
+    CpuOveruseAction nextActionLocked(const PackageCpuUsage& usage,
+                                      const aidl::android::automotive::watchdog::internal::
+                                              PackageInfo& packageInfo,
+                                      time_point_millis time) const;
+
+    void deprioritizeLocked(const UidStats& uidStats, PackageCpuUsage* usage);
+
+    void restorePriorityLocked(PackageCpuUsage* usage);
+
+    void killLocked(const UidStats& uidStats);
+
+    const std::chrono::milliseconds kOveruseWindow;
+
+    // Guards the state below against concurrent collections, configuration updates and dumps.
+    mutable Mutex mMutex;
+
+    std::unique_ptr<ThreadPriorityControllerInterface> mThreadPriorityController
+            GUARDED_BY(mMutex);
+
+    std::unique_ptr<SystemCallsInterface> mSystemCalls GUARDED_BY(mMutex);
+
+    bool mDoSendResourceUsageStats GUARDED_BY(mMutex) = false;
+
+    ComponentConfig mSystemConfig GUARDED_BY(mMutex);
+    ComponentConfig mVendorConfig GUARDED_BY(mMutex);
+    ComponentConfig mThirdPartyConfig GUARDED_BY(mMutex);
+    std::unordered_map<aidl::android::automotive::watchdog::internal::ApplicationCategoryType,
+                       double>
+            mPerCategoryMaxCpuSharePercent GUARDED_BY(mMutex);
+
+    // Time of the first collection in the current tracking period. Packages are acted on only
+    // after the sliding window is full.
+    std::optional<time_point_millis> mTrackingStartTime GUARDED_BY(mMutex);
+
+    // System-wide CPU time samples in the sliding window.
+    std::deque<CpuTimeSample> mSystemSamples GUARDED_BY(mMutex);
+    int64_t mSystemWindowCpuTimeMillis GUARDED_BY(mMutex) = 0;
+
+    // CPU usage per package. Key is a unique ID with the format `packageName:userId`.
+    std::unordered_map<std::string, PackageCpuUsage> mCpuUsageById GUARDED_BY(mMutex);
+
+    // Latest |kMaxCpuOveruseActionHistory| actions taken on the packages.
+    std::vector<PackageCpuOveruseStats> mActionHistory GUARDED_BY(mMutex);
+
+    friend class WatchdogPerfService;
+
+    // For unit tests.
+    friend class internal::CpuOveruseMonitorPeer;
+};
+
+}  // namespace watchdog
+}  // namespace automotive
+}  // namespace android
+
+#endif  //  CPP_WATCHDOG_SERVER_SRC_CPUOVERUSEMONITOR_H_
@@ -0,0 +1,139 @@
+/*
+ * Copyright (c) 2024, The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#define LOG_TAG "carwatchdogd"
+
+#include "DataProcessorExecutor.h"
+
+#include <android-base/thread_annotations.h>
+#include <log/log.h>
+
+#include <pthread.h>
+
+#include <algorithm>
+
+namespace android {
+namespace automotive {
+namespace watchdog {
+
+namespace {
+
+using ::android::base::ScopedLockAssertion;
+
+constexpr const char kThreadName[] = "WdDataProcessor";
+
+}  // namespace
+
+DataProcessorExecutor::DataProcessorExecutor(size_t maxWorkerThreads) :
+      kMaxWorkerThreads(maxWorkerThreads) {}
+
+DataProcessorExecutor::~DataProcessorExecutor() {
+    terminate();
+}
+
+void DataProcessorExecutor::runAll(const std::vector<std::function<void()>>& tasks) {
+    if (tasks.empty()) {
+        return;
+    }
+    Batch batch{.pendingCount = tasks.size()};
+    bool runInline = true;
+    {
+        std::lock_guard<std::mutex> lock(mMutex);
+        if (!mIsTerminated && kMaxWorkerThreads > 0 && tasks.size() > 1) {
+            runInline = false;
+            // The first task runs on the calling thread, so only the remaining tasks are queued.
+            for (size_t i = 1; i < tasks.size(); ++i) {
+                mQueuedTasks.push_back({.task = &tasks[i], .batch = &batch});
+            }
+            size_t neededWorkerThreads = std::min(tasks.size() - 1, kMaxWorkerThreads);
+            while (mWorkerThreads.size() < neededWorkerThreads) {
+                mWorkerThreads.emplace_back([this]() { runWorker(); });
+            }
+            mCv.notify_all();
+        }
+    }
+    if (runInline) {
+        for (const auto& task : tasks) {
+            task();
+        }
+        return;
+    }
+    runTask({.task = &tasks[0], .batch = &batch});
+    std::unique_lock<std::mutex> lock(mMutex);
+    while (true) {
+        // Help the workers drain the queue rather than waiting idle.
+        if (!mQueuedTasks.empty()) {
+            QueuedTask queuedTask = mQueuedTasks.front();
+            mQueuedTasks.pop_front();
+            lock.unlock();
+            runTask(queuedTask);
+            lock.lock();
+            continue;
+        }
+        if (batch.pendingCount == 0) {
+            return;
+        }
+        mCv.wait(lock);
+    }
+}
+
+void DataProcessorExecutor::terminate() {
+    std::vector<std::thread> workerThreads;
+    {
+        std::lock_guard<std::mutex> lock(mMutex);
+        mIsTerminated = true;
+        workerThreads = std::move(mWorkerThreads);
+        mWorkerThreads.clear();
+    }
+    mCv.notify_all();
+    for (auto& thread : workerThreads) {
+        thread.join();
+    }
+}
+
+void DataProcessorExecutor::runWorker() {
+    if (int result = pthread_setname_np(pthread_self(), kThreadName); result != 0) {
+        ALOGW("Failed to set %s thread name: %d", kThreadName, result);
+    }
+    std::unique_lock<std::mutex> lock(mMutex);
+    while (true) {
+        mCv.wait(lock, [this]() {
+            ScopedLockAssertion lockAssertion(mMutex);
+            return mIsTerminated || !mQueuedTasks.empty();
+        });
+        // Queued tasks are drained before terminating because a caller may be waiting on them.
+        if (mQueuedTasks.empty()) {
+            return;
+        }
+        QueuedTask queuedTask = mQueuedTasks.front();
+        mQueuedTasks.pop_front();
+        lock.unlock();
+        runTask(queuedTask);
+        lock.lock();
+    }
+}
+
+void DataProcessorExecutor::runTask(const QueuedTask& queuedTask) {
+    (*queuedTask.task)();
+    std::lock_guard<std::mutex> lock(mMutex);
+    if (--queuedTask.batch->pendingCount == 0) {
+        mCv.notify_all();
+    }
+}
+
+}  // namespace watchdog
+}  // namespace automotive
+}  // namespace android
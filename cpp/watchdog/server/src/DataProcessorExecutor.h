@@ -0,0 +1,87 @@
+/*
+ * Copyright (c) 2024, The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef CPP_WATCHDOG_SERVER_SRC_DATAPROCESSOREXECUTOR_H_
+#define CPP_WATCHDOG_SERVER_SRC_DATAPROCESSOREXECUTOR_H_
+
+#include <android-base/thread_annotations.h>
+
+#include <condition_variable>  // NOLINT(build/c++11)
+#include <deque>
+#include <functional>
+#include <mutex>   // NOLINT(build/c++11)
+#include <thread>  // NOLINT(build/c++11)
+#include <vector>
+
+namespace android {
+namespace automotive {
+namespace watchdog {
+
+// Maximum number of worker threads used to run the data processors concurrently.
+constexpr size_t kMaxDataProcessorWorkerThreads = 3;
+
+/**
+ * DataProcessorExecutor runs a batch of tasks concurrently on a small pool of worker threads and
+ * returns only after every task in the batch has finished.
+ *
+ * The calling thread takes part in the batch, so a batch of N tasks needs at most N - 1 worker
+ * threads. Worker threads are started on demand and live until |terminate| is called.
+ */
+class DataProcessorExecutor final {
+public:
+    explicit DataProcessorExecutor(size_t maxWorkerThreads);
+
+    ~DataProcessorExecutor();
+
+    /**
+     * Runs all |tasks| and returns once they have finished. The tasks may run in any order and on
+     * any thread, so they must not depend on each other. Runs the tasks sequentially on the calling
+     * thread after |terminate| is called.
+     */
+    void runAll(const std::vector<std::function<void()>>& tasks);
+
+    // Stops and joins the worker threads. Must not be called from a task.
+    void terminate();
+
+private:
+    struct Batch {
+        size_t pendingCount = 0;
+    };
+
+    struct QueuedTask {
+        const std::function<void()>* task;
+        Batch* batch;
+    };
+
+    void runWorker();
+
+    // Runs the task and marks it as finished in its batch.
+    void runTask(const QueuedTask& queuedTask);
+
+    const size_t kMaxWorkerThreads;
+
+    std::mutex mMutex;
+    std::condition_variable mCv;
+    std::deque<QueuedTask> mQueuedTasks GUARDED_BY(mMutex);
+    std::vector<std::thread> mWorkerThreads GUARDED_BY(mMutex);
+    bool mIsTerminated GUARDED_BY(mMutex) = false;
+};
+
+}  // namespace watchdog
+}  // namespace automotive
+}  // namespace android
+
+#endif  // CPP_WATCHDOG_SERVER_SRC_DATAPROCESSOREXECUTOR_H_
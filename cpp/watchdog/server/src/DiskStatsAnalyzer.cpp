@@ -0,0 +1,160 @@
+/*
+ * Copyright (c) 2024, The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#define LOG_TAG "carwatchdogd"
+
+#include "DiskStatsAnalyzer.h"
+
+#include <android-base/stringprintf.h>
+
+#include <inttypes.h>
+
+#include <algorithm>
+
+namespace android {
+namespace automotive {
+namespace watchdog {
+
+using ::android::base::StringPrintf;
+
+namespace {
+
+double average(uint64_t total, uint64_t count) {
+    return count == 0 ? 0.0 : static_cast<double>(total) / static_cast<double>(count);
+}
+
+}  // namespace
+
+DiskPerformanceStats DiskPerformanceStats::fromDeltaStats(const DiskStats& deltaStats,
+                                                          int64_t durationMillis) {
+    DiskPerformanceStats stats{
+            .deviceName = deltaStats.deviceName,
+            .numReadsCompleted = deltaStats.numReadsCompleted,
+            .numWritesCompleted = deltaStats.numWritesCompleted,
+            .numFlushCompleted = deltaStats.numFlushCompleted,
+            .avgReadLatencyMillis =
+                    average(deltaStats.readTimeInMillis, deltaStats.numReadsCompleted),
+            .avgWriteLatencyMillis =
+                    average(deltaStats.writeTimeInMillis, deltaStats.numWritesCompleted),
+            .avgFlushLatencyMillis =
+                    average(deltaStats.flushTimeInMillis, deltaStats.numFlushCompleted),
+    };
+    if (durationMillis > 0) {
+        const uint64_t duration = static_cast<uint64_t>(durationMillis);
+        // The I/O time may slightly exceed the poll duration as the kernel updates it lazily.
+        stats.utilizationPercent =
+                std::min(average(deltaStats.totalIoTimeInMillis, duration) * 100.0, 100.0);
+        stats.avgQueueDepth = average(deltaStats.weightedTotalIoTimeInMillis, duration);
+    }
+    return stats;
+}
+
+std::string DiskPerformanceStats::toString() const {
+    return StringPrintf("%s: Reads: %" PRIu64 " (avg %.2f ms), Writes: %" PRIu64
+                        " (avg %.2f ms), Flushes: %" PRIu64
+                        " (avg %.2f ms), Utilization: %.2f%%, Avg queue depth: %.2f, "
+                        "Latency alerts: %" PRId32,
+                        deviceName.c_str(), numReadsCompleted, avgReadLatencyMillis,
+                        numWritesCompleted, avgWriteLatencyMillis, numFlushCompleted,
+                        avgFlushLatencyMillis, utilizationPercent, avgQueueDepth,
+                        latencyAlertCount);
+}
+
+std::vector<std::string> DiskStatsAnalyzer::onPoll(const std::vector<DiskStats>& deltaStats,
+                                                   int64_t durationMillis) {
+    std::vector<std::string> degradedDevices;
+    for (const auto& stats : deltaStats) {
+        auto& history = mDevices[stats.deviceName];
+        Poll poll{.deltaStats = stats, .durationMillis = durationMillis};
+        Poll baseline;
+        for (const auto& windowPoll : history.window) {
+            baseline.deltaStats += windowPoll.deltaStats;
+            baseline.durationMillis += windowPoll.durationMillis;
+        }
+        if (isLatencyDegraded(poll, baseline)) {
+            ++history.latencyAlertCount;
+            degradedDevices.push_back(stats.deviceName);
+        }
+        history.sinceLastCollection.deltaStats += stats;
+        history.sinceLastCollection.durationMillis += durationMillis;
+        history.window.push_back(std::move(poll));
+        if (history.window.size() > kWindowSize) {
+            history.window.pop_front();
+        }
+    }
+    return degradedDevices;
+}
+
+std::vector<DiskPerformanceStats> DiskStatsAnalyzer::onCollection() {
+    std::vector<DiskPerformanceStats> collectionStats;
+    for (auto& [deviceName, history] : mDevices) {
+        const auto& deltaStats = history.sinceLastCollection.deltaStats;
+        if (deltaStats.numReadsCompleted != 0 || deltaStats.numWritesCompleted != 0 ||
+            deltaStats.numFlushCompleted != 0 || history.latencyAlertCount != 0) {
+            auto stats = DiskPerformanceStats::fromDeltaStats(deltaStats,
+                                                              history.sinceLastCollection
+                                                                      .durationMillis);
+            stats.deviceName = deviceName;
+            stats.latencyAlertCount = history.latencyAlertCount;
+            collectionStats.push_back(std::move(stats));
+        }
+        history.sinceLastCollection = {};
+        history.latencyAlertCount = 0;
+    }
+    return collectionStats;
+}
+
+std::vector<DiskPerformanceStats> DiskStatsAnalyzer::windowStats() const {
+    std::vector<DiskPerformanceStats> stats;
+    for (const auto& [deviceName, history] : mDevices) {
+        Poll total;
+        for (const auto& poll : history.window) {
+            total.deltaStats += poll.deltaStats;
+            total.durationMillis += poll.durationMillis;
+        }
+        auto deviceStats = DiskPerformanceStats::fromDeltaStats(total.deltaStats,
+                                                                total.durationMillis);
+        deviceStats.deviceName = deviceName;
+        stats.push_back(std::move(deviceStats));
+    }
+    return stats;
+}
+
+bool DiskStatsAnalyzer::isLatencyDegraded(const Poll& poll, const Poll& baseline) {
+    const auto isDegraded = [](uint64_t ioCount, uint64_t ioTimeMillis, uint64_t baselineIoCount,
+                               uint64_t baselineIoTimeMillis, double floorMillis) {
+        if (ioCount < kMinIoCountForLatencyAlert) {
+            return false;
+        }
+        const double thresholdMillis =
+                std::max(floorMillis,
+                         average(baselineIoTimeMillis, baselineIoCount) *
+                                 kDefaultLatencyDegradationFactor);
+        return average(ioTimeMillis, ioCount) >= thresholdMillis;
+    };
+    const auto& stats = poll.deltaStats;
+    const auto& baselineStats = baseline.deltaStats;
+    return isDegraded(stats.numReadsCompleted, stats.readTimeInMillis,
+                      baselineStats.numReadsCompleted, baselineStats.readTimeInMillis,
+                      kDefaultReadLatencyAlertFloorMillis) ||
+            isDegraded(stats.numWritesCompleted, stats.writeTimeInMillis,
+                       baselineStats.numWritesCompleted, baselineStats.writeTimeInMillis,
+                       kDefaultWriteLatencyAlertFloorMillis);
+}
+
+}  // namespace watchdog
+}  // namespace automotive
+}  // namespace android
@@ -0,0 +1,121 @@
+/*
+ * Copyright (c) 2024, The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef CPP_WATCHDOG_SERVER_SRC_DISKSTATSANALYZER_H_
+#define CPP_WATCHDOG_SERVER_SRC_DISKSTATSANALYZER_H_
+
+#include "ProcDiskStatsCollector.h"
+
+#include <deque>
+#include <map>
+#include <string>
+#include <vector>
+
+namespace android {
+namespace automotive {
+namespace watchdog {
+
+// Number of periodic monitor polls kept per device to baseline the I/O latency.
+constexpr size_t kDefaultDiskStatsWindowSize = 12;
+// A poll's average latency must exceed the window's average latency by this factor to be
+// reported as degraded.
+constexpr double kDefaultLatencyDegradationFactor = 3.0;
+// Latencies below these values are never reported as degraded. These are well above the typical
+// eMMC/UFS latencies, so only stalls noticeable by the user are reported.
+constexpr double kDefaultReadLatencyAlertFloorMillis = 20.0;
+constexpr double kDefaultWriteLatencyAlertFloorMillis = 50.0;
+// Minimum number of completed reads or writes in a poll for its latency to be considered. Avoids
+// alerting on a few slow I/Os on an otherwise idle device.
+constexpr uint64_t kMinIoCountForLatencyAlert = 16;
+
+// Storage performance of a physical block device during a time period, derived from the device's
+// `/proc/diskstats` delta stats.
+struct DiskPerformanceStats {
+    std::string deviceName;
+    uint64_t numReadsCompleted = 0;
+    uint64_t numWritesCompleted = 0;
+    uint64_t numFlushCompleted = 0;
+    double avgReadLatencyMillis = 0.0;
+    double avgWriteLatencyMillis = 0.0;
+    double avgFlushLatencyMillis = 0.0;
+    // Percentage of the period the device had at least one I/O in flight.
+    double utilizationPercent = 0.0;
+    // Average number of I/Os in flight during the period.
+    double avgQueueDepth = 0.0;
+    // Number of periodic monitor polls during the period where the read or write latency degraded.
+    int32_t latencyAlertCount = 0;
+
+    static DiskPerformanceStats fromDeltaStats(const DiskStats& deltaStats, int64_t durationMillis);
+    std::string toString() const;
+};
+
+/*
+ * Derives the storage performance of each physical block device from the per-device delta stats
+ * reported by |ProcDiskStatsCollector| on each periodic monitor poll.
+ *
+ * The stats of the last |windowSize| polls are kept per device and used as the baseline for
+ * detecting latency degradation. The stats are also aggregated until the next collection, so each
+ * performance record reports the storage performance during its collection period.
+ *
+ * This class is not thread-safe. The owner must synchronize the calls.
+ */
+class DiskStatsAnalyzer final {
+public:
+    explicit DiskStatsAnalyzer(size_t windowSize = kDefaultDiskStatsWindowSize) :
+          kWindowSize(windowSize) {}
+
+    // Adds the per-device delta stats of a poll that spanned |durationMillis|. Returns the names of
+    // the devices whose read or write latency degraded during the poll.
+    std::vector<std::string> onPoll(const std::vector<DiskStats>& deltaStats,
+                                    int64_t durationMillis);
+
+    // Returns the stats of each device with I/O activity since the last collection and resets
+    // them. Devices are sorted by name.
+    std::vector<DiskPerformanceStats> onCollection();
+
+    // Returns the stats of each device aggregated over the polls in the window.
+    std::vector<DiskPerformanceStats> windowStats() const;
+
+    void clear() { mDevices.clear(); }
+
+private:
+    struct Poll {
+        DiskStats deltaStats;
+        int64_t durationMillis = 0;
+    };
+
+    struct DeviceHistory {
+        // Latest |kWindowSize| polls, from oldest to newest.
+        std::deque<Poll> window;
+        // Stats aggregated since the last collection.
+        Poll sinceLastCollection;
+        int32_t latencyAlertCount = 0;
+    };
+
+    // Returns true when the latency of |poll| degraded compared to the |baseline|.
+    static bool isLatencyDegraded(const Poll& poll, const Poll& baseline);
+
+    const size_t kWindowSize;
+
+    // History of each device, keyed by the device name.
+    std::map<std::string, DeviceHistory> mDevices;
+};
+
+}  // namespace watchdog
+}  // namespace automotive
+}  // namespace android
+
+#endif  //  CPP_WATCHDOG_SERVER_SRC_DISKSTATSANALYZER_H_
@@ -18,6 +18,7 @@
 
 #include "IoOveruseConfigs.h"
 
+#include "OveruseConfigurationCacheHelper.h"
 #include "OveruseConfigurationXmlHelper.h"
 #include "PackageInfoResolver.h"
 
@@ -26,6 +27,7 @@
 
 #include <inttypes.h>
 
+#include <chrono>
 #include <filesystem>
 #include <limits>
 
@@ -244,6 +246,10 @@ IoOveruseConfigs::ParseXmlFileFunction IoOveruseConfigs::sParseXmlFile =
         &OveruseConfigurationXmlHelper::parseXmlFile;
 IoOveruseConfigs::WriteXmlFileFunction IoOveruseConfigs::sWriteXmlFile =
         &OveruseConfigurationXmlHelper::writeXmlFile;
+IoOveruseConfigs::ReadCacheFileFunction IoOveruseConfigs::sReadCacheFile =
+        &OveruseConfigurationCacheHelper::readCacheFile;
+IoOveruseConfigs::WriteCacheFileFunction IoOveruseConfigs::sWriteCacheFile =
+        &OveruseConfigurationCacheHelper::writeCacheFile;
 
 Result<void> ComponentSpecificConfig::updatePerPackageThresholds(
         const std::vector<PerStateIoOveruseThreshold>& thresholds,
@@ -302,8 +308,11 @@ IoOveruseConfigs::IoOveruseConfigs() :
       mPackagesToAppCategoryMappingUpdateMode(OVERWRITE),
       mPerCategoryThresholds({}),
       mVendorPackagePrefixes({}) {
-    const auto updateFromXmlPerType = [&](const char* filename, const char* configType) -> bool {
-        if (const auto result = this->updateFromXml(filename); !result.ok()) {
+    const auto startTime = std::chrono::steady_clock::now();
+    // Only the latest configs are cached because the build configs are on read-only partitions.
+    const auto updateFromXmlPerType = [&](const char* filename, const char* configType,
+                                          bool useCache = false) -> bool {
+        if (const auto result = this->updateFromXml(filename, useCache); !result.ok()) {
             ALOGE("Failed to parse %s resource overuse configuration from '%s': %s", configType,
                   filename, result.error().message().c_str());
             return false;
@@ -321,10 +330,10 @@ IoOveruseConfigs::IoOveruseConfigs() :
      * priority.
      */
     bool isBuildSystemConfig = false;
-    if (!updateFromXmlPerType(kLatestSystemConfigXmlPath, "latest system")) {
+    if (!updateFromXmlPerType(kLatestSystemConfigXmlPath, "latest system", /*useCache=*/true)) {
         isBuildSystemConfig = updateFromXmlPerType(kBuildSystemConfigXmlPath, "build system");
     }
-    if (!updateFromXmlPerType(kLatestVendorConfigXmlPath, "latest vendor")) {
+    if (!updateFromXmlPerType(kLatestVendorConfigXmlPath, "latest vendor", /*useCache=*/true)) {
         mPackagesToAppCategoryMappingUpdateMode = isBuildSystemConfig ? MERGE : NO_UPDATE;
         if (!updateFromXmlPerType(kBuildVendorConfigXmlPath, "build vendor") &&
             mSystemConfig.mGeneric.name != kDefaultThresholdName) {
@@ -333,13 +342,18 @@ IoOveruseConfigs::IoOveruseConfigs() :
         }
         mPackagesToAppCategoryMappingUpdateMode = OVERWRITE;
     }
-    if (!updateFromXmlPerType(kLatestThirdPartyConfigXmlPath, "latest third-party")) {
+    if (!updateFromXmlPerType(kLatestThirdPartyConfigXmlPath, "latest third-party",
+                              /*useCache=*/true)) {
         if (!updateFromXmlPerType(kBuildThirdPartyConfigXmlPath, "build third-party") &&
             mSystemConfig.mGeneric.name != kDefaultThresholdName) {
             mThirdPartyConfig.mGeneric = mSystemConfig.mGeneric;
             mThirdPartyConfig.mGeneric.name = toString(ComponentType::THIRD_PARTY);
         }
     }
+    ALOGI("Loaded resource overuse configurations in %" PRId64 " us",
+          static_cast<int64_t>(std::chrono::duration_cast<std::chrono::microseconds>(
+                                       std::chrono::steady_clock::now() - startTime)
+                                       .count()));
 }
 
 size_t IoOveruseConfigs::AlertThresholdHashByDuration::operator()(
@@ -414,7 +428,14 @@ Result<void> IoOveruseConfigs::update(
     return {};
 }
 
-Result<void> IoOveruseConfigs::updateFromXml(const char* filename) {
+Result<void> IoOveruseConfigs::updateFromXml(const char* filename, bool useCache) {
+    if (useCache) {
+        if (const auto cachedConfig = sReadCacheFile(filename); cachedConfig.ok() &&
+            isValidResourceOveruseConfig(*cachedConfig).ok()) {
+            updateFromAidlConfig(*cachedConfig);
+            return {};
+        }
+    }
     const auto resourceOveruseConfig = sParseXmlFile(filename);
     if (!resourceOveruseConfig.ok()) {
         return Error() << "Failed to parse configuration: " << resourceOveruseConfig.error();
@@ -423,6 +444,12 @@ Result<void> IoOveruseConfigs::updateFromXml(const char* filename) {
         return result;
     }
     updateFromAidlConfig(*resourceOveruseConfig);
+    if (useCache) {
+        if (const auto result = sWriteCacheFile(*resourceOveruseConfig, filename); !result.ok()) {
+            ALOGW("Failed to cache resource overuse configuration from '%s': %s", filename,
+                  result.error().message().c_str());
+        }
+    }
     return {};
 }
 
@@ -650,27 +677,39 @@ std::optional<ResourceOveruseConfiguration> IoOveruseConfigs::get(
 }
 
 Result<void> IoOveruseConfigs::writeToDisk() {
+    const auto writeFiles = [](const ResourceOveruseConfiguration& config,
+                               const char* filename) -> Result<void> {
+        if (const auto result = sWriteXmlFile(config, filename); !result.ok()) {
+            return result;
+        }
+        // The XML file remains the source of truth, so failing to cache it is not an error.
+        if (const auto result = sWriteCacheFile(config, filename); !result.ok()) {
+            ALOGW("Failed to cache resource overuse configuration for '%s': %s", filename,
+                  result.error().message().c_str());
+        }
+        return {};
+    };
     std::vector<ResourceOveruseConfiguration> resourceOveruseConfigs;
     get(&resourceOveruseConfigs);
     for (const auto resourceOveruseConfig : resourceOveruseConfigs) {
         switch (resourceOveruseConfig.componentType) {
             case ComponentType::SYSTEM:
                 if (const auto result =
-                            sWriteXmlFile(resourceOveruseConfig, kLatestSystemConfigXmlPath);
+                            writeFiles(resourceOveruseConfig, kLatestSystemConfigXmlPath);
                     !result.ok()) {
                     return Error() << "Failed to write system resource overuse config to disk";
                 }
                 continue;
             case ComponentType::VENDOR:
                 if (const auto result =
-                            sWriteXmlFile(resourceOveruseConfig, kLatestVendorConfigXmlPath);
+                            writeFiles(resourceOveruseConfig, kLatestVendorConfigXmlPath);
                     !result.ok()) {
                     return Error() << "Failed to write vendor resource overuse config to disk";
                 }
                 continue;
             case ComponentType::THIRD_PARTY:
                 if (const auto result =
-                            sWriteXmlFile(resourceOveruseConfig, kLatestThirdPartyConfigXmlPath);
+                            writeFiles(resourceOveruseConfig, kLatestThirdPartyConfigXmlPath);
                     !result.ok()) {
                     return Error() << "Failed to write third-party resource overuse config to disk";
                 }
@@ -233,7 +233,10 @@ private:
         MERGE,
         NO_UPDATE,
     };
-    android::base::Result<void> updateFromXml(const char* filename);
+    // Updates the configs from the XML file at |filename|. When |useCache| is true, the configs
+    // are read from the XML file's binary cache when it is up to date, and the cache is refreshed
+    // after parsing the XML file otherwise.
+    android::base::Result<void> updateFromXml(const char* filename, bool useCache);
 
     void updateFromAidlConfig(
             const aidl::android::automotive::watchdog::internal::ResourceOveruseConfiguration&
@@ -287,8 +290,12 @@ private:
             android::base::Result<void>(const aidl::android::automotive::watchdog::internal::
                                                 ResourceOveruseConfiguration&,
                                         const char*)>;
+    using ReadCacheFileFunction = ParseXmlFileFunction;
+    using WriteCacheFileFunction = WriteXmlFileFunction;
     static ParseXmlFileFunction sParseXmlFile;
     static WriteXmlFileFunction sWriteXmlFile;
+    static ReadCacheFileFunction sReadCacheFile;
+    static WriteCacheFileFunction sWriteCacheFile;
 
     friend class internal::IoOveruseConfigsPeer;
 };
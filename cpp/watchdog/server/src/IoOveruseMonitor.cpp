@@ -198,13 +198,17 @@ Result<void> IoOveruseMonitor::init() {
     if (isInitializedLocked()) {
         return Error() << "Cannot initialize " << name() << " more than once";
     }
-    mPeriodicMonitorBufferSize = static_cast<size_t>(
+    const auto periodicMonitorBufferSize = static_cast<size_t>(
             sysprop::periodicMonitorBufferSize().value_or(kDefaultPeriodicMonitorBufferSize));
-    if (mPeriodicMonitorBufferSize == 0 ||
-        mPeriodicMonitorBufferSize > kMaxPeriodicMonitorBufferSize) {
+    if (periodicMonitorBufferSize == 0 ||
+        periodicMonitorBufferSize > kMaxPeriodicMonitorBufferSize) {
         return Error() << "Periodic monitor buffer size cannot be zero or above "
                        << kDefaultPeriodicMonitorBufferSize << ". Received "
-                       << mPeriodicMonitorBufferSize;
+                       << periodicMonitorBufferSize;
+    }
+    {
+        std::lock_guard<std::mutex> monitorLock(mMonitorMutex);
+        mPeriodicMonitorBufferSize = periodicMonitorBufferSize;
     }
     mIoOveruseWarnPercentage = static_cast<double>(
             sysprop::ioOveruseWarnPercentage().value_or(kDefaultIoOveruseWarnPercentage));
@@ -227,7 +231,11 @@ void IoOveruseMonitor::terminate() {
     std::unique_lock writeLock(mRwMutex);
     mWatchdogServiceHelper.clear();
     mIoOveruseConfigs.clear();
-    mSystemWideWrittenBytes.clear();
+    {
+        std::lock_guard<std::mutex> monitorLock(mMonitorMutex);
+        mSystemWideWrittenBytes.clear();
+        mSystemWideAlertThresholds.clear();
+    }
     mUserPackageDailyIoUsageById.clear();
     for (const auto& [_, listener] : mOveruseListenersByUid) {
         AIBinder* aiBinder = listener->asBinder().get();
@@ -403,7 +411,8 @@ Result<void> IoOveruseMonitor::onCustomCollection(
         const android::wp<UidStatsCollectorInterface>& uidStatsCollector,
         const android::wp<ProcStatCollectorInterface>& procStatCollector,
         ResourceStats* resourceStats) {
-    // Nothing special for custom collection.
+    // The per-UID I/O stats are collected for all UIDs even when the custom collection filters the
+    // per-process stats, so the I/O overuse is evaluated the same as the periodic collection.
     return onPeriodicCollection(time, systemState, uidStatsCollector, procStatCollector,
                                 resourceStats);
 }
@@ -415,7 +424,15 @@ Result<void> IoOveruseMonitor::onPeriodicMonitor(
         return Error() << "Proc disk stats collector must not be null";
     }
 
-    std::unique_lock writeLock(mRwMutex);
+    std::lock_guard<std::mutex> monitorLock(mMonitorMutex);
+    /*
+     * |mRwMutex| is held for the whole of a collection, so don't wait on it. Use the thresholds
+     * from the last time it was free instead. They change only on a configuration update.
+     */
+    if (std::shared_lock readLock(mRwMutex, std::try_to_lock);
+        readLock.owns_lock() && isInitializedLocked()) {
+        mSystemWideAlertThresholds = mIoOveruseConfigs->systemWideAlertThresholds();
+    }
     if (mLastSystemWideIoMonitorTime == 0) {
         /*
          * Do not record the first disk stats as it reflects the aggregated disks stats since the
@@ -429,7 +446,7 @@ Result<void> IoOveruseMonitor::onPeriodicMonitor(
     mSystemWideWrittenBytes.push_back(
             {.pollDurationInSecs = difftime(time, mLastSystemWideIoMonitorTime),
              .bytesInKib = diskStats.numKibWritten});
-    for (const auto& threshold : mIoOveruseConfigs->systemWideAlertThresholds()) {
+    for (const auto& threshold : mSystemWideAlertThresholds) {
         int64_t accountedWrittenKib = 0;
         double accountedDurationInSecs = 0;
         size_t accountedPolls = 0;
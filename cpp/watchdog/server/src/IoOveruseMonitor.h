@@ -39,6 +39,7 @@
 
 #include <time.h>
 
+#include <mutex>  // NOLINT
 #include <ostream>
 #include <string>
 #include <unordered_map>
@@ -307,13 +308,22 @@ private:
     // Summary of configs available for all the components and system-wide overuse alert thresholds.
     sp<IoOveruseConfigsInterface> mIoOveruseConfigs GUARDED_BY(mRwMutex);
 
+    /**
+     * Guards the periodic monitor state. The periodic monitor runs on its own thread and must not
+     * wait on |mRwMutex|, which is held for the whole of a collection.
+     */
+    mutable std::mutex mMonitorMutex;
+
     /**
      * Delta of system-wide written kib across all disks from the last |mPeriodicMonitorBufferSize|
      * polls along with the polling duration.
      */
-    std::vector<WrittenBytesSnapshot> mSystemWideWrittenBytes GUARDED_BY(mRwMutex);
-    size_t mPeriodicMonitorBufferSize GUARDED_BY(mRwMutex);
-    time_t mLastSystemWideIoMonitorTime GUARDED_BY(mRwMutex);
+    std::vector<WrittenBytesSnapshot> mSystemWideWrittenBytes GUARDED_BY(mMonitorMutex);
+    size_t mPeriodicMonitorBufferSize GUARDED_BY(mMonitorMutex);
+    time_t mLastSystemWideIoMonitorTime GUARDED_BY(mMonitorMutex);
+    // Copy of the system-wide alert thresholds, refreshed whenever |mRwMutex| is free.
+    IoOveruseConfigsInterface::IoOveruseAlertThresholdSet mSystemWideAlertThresholds
+            GUARDED_BY(mMonitorMutex);
 
     // Cache of I/O usage stats from previous boot that happened today. Key is a unique ID with
     // the format `packageName:userId`.
@@ -0,0 +1,209 @@
+/*
+ * Copyright (c) 2024, The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#define LOG_TAG "carwatchdogd"
+
+#include "MemoryOveruseConfigs.h"
+
+#include <aidl/android/automotive/watchdog/internal/UidType.h>
+#include <android-base/properties.h>
+#include <android-base/stringprintf.h>
+#include <log/log.h>
+
+namespace android {
+namespace automotive {
+namespace watchdog {
+
+using ::aidl::android::automotive::watchdog::internal::ApplicationCategoryType;
+using ::aidl::android::automotive::watchdog::internal::ComponentType;
+using ::aidl::android::automotive::watchdog::internal::PackageInfo;
+using ::aidl::android::automotive::watchdog::internal::UidType;
+using ::android::base::Error;
+using ::android::base::GetIntProperty;
+using ::android::base::Result;
+using ::android::base::StringAppendF;
+
+namespace {
+
+Result<ApplicationCategoryType> toApplicationCategoryType(const std::string& value) {
+    if (value == "MAPS") {
+        return ApplicationCategoryType::MAPS;
+    }
+    if (value == "MEDIA") {
+        return ApplicationCategoryType::MEDIA;
+    }
+    return Error() << "Unsupported application category '" << value << "'";
+}
+
+bool isSafeToKillAnyPackage(const std::vector<std::string>& packages,
+                            const std::unordered_set<std::string>& safeToKillPackages) {
+    for (const auto& packageName : packages) {
+        if (safeToKillPackages.find(packageName) != safeToKillPackages.end()) {
+            return true;
+        }
+    }
+    return false;
+}
+
+Result<void> isValidMemoryOveruseConfiguration(const MemoryOveruseConfiguration& config) {
+    if (config.componentLevelThreshold.maxMemoryKb <= 0) {
+        return Error() << "Component level threshold must be greater than zero";
+    }
+    if (config.componentType != ComponentType::VENDOR &&
+        !config.categorySpecificThresholds.empty()) {
+        return Error() << "Only the vendor configuration may define category specific thresholds";
+    }
+    return {};
+}
+
+MemoryOveruseConfiguration readComponentConfiguration(ComponentType componentType,
+                                                       const char* thresholdProperty,
+                                                       int64_t defaultThresholdKb) {
+    return MemoryOveruseConfiguration{
+            .componentType = componentType,
+            .componentLevelThreshold = {.name = toString(componentType),
+                                        .maxMemoryKb = GetIntProperty<int64_t>(thresholdProperty,
+                                                                               defaultThresholdKb,
+                                                                               /*min=*/1)},
+    };
+}
+
+}  // namespace
+
+std::vector<MemoryOveruseConfiguration> readMemoryOveruseConfigurations() {
+    return {readComponentConfiguration(ComponentType::SYSTEM,
+                                       kPropertySystemMemoryOveruseThresholdKb,
+                                       kDefaultSystemMemoryOveruseThresholdKb),
+            readComponentConfiguration(ComponentType::VENDOR,
+                                       kPropertyVendorMemoryOveruseThresholdKb,
+                                       kDefaultVendorMemoryOveruseThresholdKb),
+            readComponentConfiguration(ComponentType::THIRD_PARTY,
+                                       kPropertyThirdPartyMemoryOveruseThresholdKb,
+                                       kDefaultThirdPartyMemoryOveruseThresholdKb)};
+}
+
+Result<void> MemoryOveruseConfigs::update(const std::vector<MemoryOveruseConfiguration>& configs) {
+    std::unordered_set<ComponentType> seenComponentTypes;
+    for (const auto& config : configs) {
+        if (seenComponentTypes.count(config.componentType) > 0) {
+            return Error() << "Cannot provide duplicate configs for the same component type "
+                           << toString(config.componentType);
+        }
+        if (componentConfig(config.componentType) == nullptr) {
+            return Error() << "Invalid component type " << toString(config.componentType);
+        }
+        if (const auto result = isValidMemoryOveruseConfiguration(config); !result.ok()) {
+            return Error() << "Invalid memory overuse configuration for component "
+                           << toString(config.componentType) << ": " << result.error();
+        }
+        seenComponentTypes.insert(config.componentType);
+    }
+    std::string errorMsgs;
+    for (const auto& config : configs) {
+        ComponentConfig* target = componentConfig(config.componentType);
+        *target = {.genericThresholdKb = config.componentLevelThreshold.maxMemoryKb};
+        for (const auto& threshold : config.packageSpecificThresholds) {
+            if (threshold.name.empty() || threshold.maxMemoryKb <= 0) {
+                StringAppendF(&errorMsgs, "\tSkipping invalid package threshold '%s'\n",
+                              threshold.name.c_str());
+                continue;
+            }
+            target->perPackageThresholdsKb[threshold.name] = threshold.maxMemoryKb;
+        }
+        target->safeToKillPackages.insert(config.safeToKillPackages.begin(),
+                                          config.safeToKillPackages.end());
+        if (config.componentType != ComponentType::VENDOR) {
+            continue;
+        }
+        mPerCategoryThresholdsKb.clear();
+        for (const auto& threshold : config.categorySpecificThresholds) {
+            const auto categoryType = toApplicationCategoryType(threshold.name);
+            if (!categoryType.ok() || threshold.maxMemoryKb <= 0) {
+                StringAppendF(&errorMsgs, "\tSkipping invalid category threshold '%s'\n",
+                              threshold.name.c_str());
+                continue;
+            }
+            mPerCategoryThresholdsKb[*categoryType] = threshold.maxMemoryKb;
+        }
+    }
+    if (!errorMsgs.empty()) {
+        ALOGW("Memory overuse configs updated with errors:\n%s", errorMsgs.c_str());
+    }
+    return {};
+}
+
+int64_t MemoryOveruseConfigs::fetchThresholdKb(const PackageInfo& packageInfo) const {
+    const ComponentConfig* config = componentConfig(packageInfo.componentType);
+    if (config == nullptr) {
+        return kDefaultMemoryOveruseThresholdKb;
+    }
+    /*
+     * Third-party packages aren't known in advance, so they don't have package specific
+     * thresholds.
+     */
+    if (packageInfo.componentType != ComponentType::THIRD_PARTY) {
+        if (const auto it = config->perPackageThresholdsKb.find(packageInfo.packageIdentifier.name);
+            it != config->perPackageThresholdsKb.end()) {
+            return it->second;
+        }
+    }
+    if (const auto it = mPerCategoryThresholdsKb.find(packageInfo.appCategoryType);
+        it != mPerCategoryThresholdsKb.end()) {
+        return it->second;
+    }
+    return config->genericThresholdKb;
+}
+
+bool MemoryOveruseConfigs::isSafeToKill(const PackageInfo& packageInfo) const {
+    if (packageInfo.uidType == UidType::NATIVE) {
+        // Native packages can't be disabled so don't kill them on memory overuse.
+        return false;
+    }
+    switch (packageInfo.componentType) {
+        case ComponentType::SYSTEM:
+        case ComponentType::VENDOR: {
+            const ComponentConfig* config = componentConfig(packageInfo.componentType);
+            return config->safeToKillPackages.count(packageInfo.packageIdentifier.name) > 0 ||
+                    isSafeToKillAnyPackage(packageInfo.sharedUidPackages,
+                                           config->safeToKillPackages);
+        }
+        default:
+            return true;
+    }
+}
+
+const MemoryOveruseConfigs::ComponentConfig* MemoryOveruseConfigs::componentConfig(
+        ComponentType componentType) const {
+    return const_cast<MemoryOveruseConfigs*>(this)->componentConfig(componentType);
+}
+
+MemoryOveruseConfigs::ComponentConfig* MemoryOveruseConfigs::componentConfig(
+        ComponentType componentType) {
+    switch (componentType) {
+        case ComponentType::SYSTEM:
+            return &mSystemConfig;
+        case ComponentType::VENDOR:
+            return &mVendorConfig;
+        case ComponentType::THIRD_PARTY:
+            return &mThirdPartyConfig;
+        default:
+            return nullptr;
+    }
+}
+
+}  // namespace watchdog
+}  // namespace automotive
+}  // namespace android
@@ -0,0 +1,140 @@
+/*
+ * Copyright (c) 2024, The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef CPP_WATCHDOG_SERVER_SRC_MEMORYOVERUSECONFIGS_H_
+#define CPP_WATCHDOG_SERVER_SRC_MEMORYOVERUSECONFIGS_H_
+
+#include <aidl/android/automotive/watchdog/internal/ApplicationCategoryType.h>
+#include <aidl/android/automotive/watchdog/internal/ComponentType.h>
+#include <aidl/android/automotive/watchdog/internal/PackageInfo.h>
+#include <android-base/result.h>
+#include <utils/RefBase.h>
+
+#include <limits>
+#include <string>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+namespace android {
+namespace automotive {
+namespace watchdog {
+
+// Memory threshold used when no threshold is configured for a package.
+constexpr int64_t kDefaultMemoryOveruseThresholdKb = std::numeric_limits<int64_t>::max();
+// Component level thresholds used when the corresponding properties aren't set.
+constexpr int64_t kDefaultSystemMemoryOveruseThresholdKb = 2 * 1024 * 1024;
+constexpr int64_t kDefaultVendorMemoryOveruseThresholdKb = 2 * 1024 * 1024;
+constexpr int64_t kDefaultThirdPartyMemoryOveruseThresholdKb = 1024 * 1024;
+// Properties that override the component level thresholds.
+constexpr const char kPropertySystemMemoryOveruseThresholdKb[] =
+        "ro.carwatchdog.memory_overuse.system_threshold_kb";
+constexpr const char kPropertyVendorMemoryOveruseThresholdKb[] =
+        "ro.carwatchdog.memory_overuse.vendor_threshold_kb";
+constexpr const char kPropertyThirdPartyMemoryOveruseThresholdKb[] =
+        "ro.carwatchdog.memory_overuse.third_party_threshold_kb";
+
+// Memory overuse threshold for a package, an application category or a component.
+struct MemoryOveruseThreshold {
+    // Package name, application category name (MAPS or MEDIA), or the component name.
+    std::string name;
+    // Maximum memory usage in KiB. Usage above this threshold is an overuse.
+    int64_t maxMemoryKb = 0;
+};
+
+// Memory overuse configuration for a component. Follows the layout of
+// ResourceOveruseConfiguration so the I/O and memory overuse configs are defined the same way.
+struct MemoryOveruseConfiguration {
+    aidl::android::automotive::watchdog::internal::ComponentType componentType =
+            aidl::android::automotive::watchdog::internal::ComponentType::UNKNOWN;
+    // Packages that are safe to kill on memory overuse.
+    std::vector<std::string> safeToKillPackages;
+    // Threshold for all packages in the component without a more specific threshold.
+    MemoryOveruseThreshold componentLevelThreshold;
+    // Per-package thresholds. Packages must belong to the component.
+    std::vector<MemoryOveruseThreshold> packageSpecificThresholds;
+    // Per application category thresholds. Only the vendor configuration may define these.
+    std::vector<MemoryOveruseThreshold> categorySpecificThresholds;
+};
+
+// Returns the memory overuse configurations for all the components, with the component level
+// thresholds read from the system properties.
+std::vector<MemoryOveruseConfiguration> readMemoryOveruseConfigurations();
+
+/**
+ * Defines the methods that the memory overuse configs module should implement.
+ */
+class MemoryOveruseConfigsInterface : virtual public android::RefBase {
+public:
+    // Overwrites the existing configurations of the given components.
+    virtual android::base::Result<void> update(
+            const std::vector<MemoryOveruseConfiguration>& configs) = 0;
+
+    // Returns the memory overuse threshold in KiB for the given package.
+    virtual int64_t fetchThresholdKb(
+            const aidl::android::automotive::watchdog::internal::PackageInfo& packageInfo)
+            const = 0;
+
+    // Returns whether or not the package is safe to kill on memory overuse.
+    virtual bool isSafeToKill(const aidl::android::automotive::watchdog::internal::PackageInfo&
+                                      packageInfo) const = 0;
+};
+
+/**
+ * MemoryOveruseConfigs represents the memory overuse thresholds for all the components.
+ *
+ * The thresholds are resolved in the same order as the I/O overuse thresholds: package specific
+ * threshold, then application category threshold, then the component level threshold.
+ */
+class MemoryOveruseConfigs final : public MemoryOveruseConfigsInterface {
+public:
+    MemoryOveruseConfigs() {}
+
+    android::base::Result<void> update(
+            const std::vector<MemoryOveruseConfiguration>& configs) override;
+
+    int64_t fetchThresholdKb(const aidl::android::automotive::watchdog::internal::PackageInfo&
+                                     packageInfo) const override;
+
+    bool isSafeToKill(const aidl::android::automotive::watchdog::internal::PackageInfo&
+                              packageInfo) const override;
+
+private:
+    struct ComponentConfig {
+        int64_t genericThresholdKb = kDefaultMemoryOveruseThresholdKb;
+        std::unordered_map<std::string, int64_t> perPackageThresholdsKb;
+        std::unordered_set<std::string> safeToKillPackages;
+    };
+
+    // Returns the config for the component or nullptr for an unsupported component.
+    const ComponentConfig* componentConfig(
+            aidl::android::automotive::watchdog::internal::ComponentType componentType) const;
+    ComponentConfig* componentConfig(
+            aidl::android::automotive::watchdog::internal::ComponentType componentType);
+
+    ComponentConfig mSystemConfig;
+    ComponentConfig mVendorConfig;
+    ComponentConfig mThirdPartyConfig;
+    std::unordered_map<aidl::android::automotive::watchdog::internal::ApplicationCategoryType,
+                       int64_t>
+            mPerCategoryThresholdsKb;
+};
+
+}  // namespace watchdog
+}  // namespace automotive
+}  // namespace android
+
+#endif  //  CPP_WATCHDOG_SERVER_SRC_MEMORYOVERUSECONFIGS_H_
@@ -0,0 +1,265 @@
+/*
+ * Copyright (c) 2024, The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#define LOG_TAG "carwatchdogd"
+
+#include "MemoryOveruseMonitor.h"
+
+#include <android-base/file.h>
+#include <android-base/properties.h>
+#include <android-base/stringprintf.h>
+#include <cutils/multiuser.h>
+#include <log/log.h>
+
+#include <inttypes.h>
+
+namespace android {
+namespace automotive {
+namespace watchdog {
+
+using ::aidl::android::automotive::watchdog::internal::PackageInfo;
+using ::aidl::android::automotive::watchdog::internal::ResourceOveruseStats;
+using ::aidl::android::automotive::watchdog::internal::ResourceStats;
+using ::android::sp;
+using ::android::wp;
+using ::android::base::Error;
+using ::android::base::GetBoolProperty;
+using ::android::base::Result;
+using ::android::base::StringAppendF;
+using ::android::base::StringPrintf;
+using ::android::base::WriteStringToFd;
+
+namespace {
+
+using InternalPackageMemoryOveruseStats =
+        ::aidl::android::automotive::watchdog::internal::PackageMemoryOveruseStats;
+
+std::string uniquePackageIdStr(const PackageInfo& packageInfo) {
+    return StringPrintf("%s:%" PRId32, packageInfo.packageIdentifier.name.c_str(),
+                        multiuser_get_user_id(packageInfo.packageIdentifier.uid));
+}
+
+InternalPackageMemoryOveruseStats toInternalPackageMemoryOveruseStats(
+        const PackageMemoryOveruseStats& stats, bool isKillEnabled) {
+    InternalPackageMemoryOveruseStats internalStats;
+    internalStats.uid = stats.packageInfo.packageIdentifier.uid;
+    internalStats.memoryKb = stats.memoryKb;
+    internalStats.thresholdKb = stats.thresholdKb;
+    internalStats.overuseDurationMillis = stats.overuseDuration.count();
+    internalStats.totalOveruses = stats.totalOveruses;
+    internalStats.killableOnOveruse = isKillEnabled && stats.killableOnOveruse;
+    return internalStats;
+}
+
+}  // namespace
+
+std::string PackageMemoryOveruseStats::toString() const {
+    return StringPrintf("Package: %s, User: %" PRId32 ", Memory: %" PRId64
+                        " KiB, Threshold: %" PRId64 " KiB, Overuse duration: %" PRId64
+                        " seconds, Total overuses: %d, Killable on overuse: %s\n",
+                        packageInfo.packageIdentifier.name.c_str(),
+                        multiuser_get_user_id(packageInfo.packageIdentifier.uid), memoryKb,
+                        thresholdKb,
+                        std::chrono::duration_cast<std::chrono::seconds>(overuseDuration).count(),
+                        totalOveruses, killableOnOveruse ? "true" : "false");
+}
+
+MemoryOveruseMonitor::MemoryOveruseMonitor(const sp<PressureMonitorInterface>& pressureMonitor) :
+      MemoryOveruseMonitor(pressureMonitor,
+                           GetBoolProperty(kPropertyMemoryOveruseKillEnabled,
+                                           /*default_value=*/false),
+                           kDefaultSustainedMemoryOveruseDuration,
+                           kDefaultMemoryOveruseMinPressureLevel) {}
+
+Result<void> MemoryOveruseMonitor::init() {
+    Mutex::Autolock lock(mMutex);
+    if (mMemoryOveruseConfigs == nullptr) {
+        mMemoryOveruseConfigs = sp<MemoryOveruseConfigs>::make();
+    }
+    if (kPressureMonitor == nullptr || !kPressureMonitor->isEnabled()) {
+        ALOGW("Pressure monitor is disabled. So, memory overuse won't be monitored");
+        return {};
+    }
+    if (const auto result = kPressureMonitor->registerPressureChangeCallback(
+                sp<MemoryOveruseMonitor>::fromExisting(this));
+        !result.ok()) {
+        return Error() << "Failed to register pressure change callback: " << result.error();
+    }
+    mIsPressureCallbackRegistered = true;
+    return {};
+}
+
+void MemoryOveruseMonitor::terminate() {
+    Mutex::Autolock lock(mMutex);
+    if (mIsPressureCallbackRegistered) {
+        kPressureMonitor->unregisterPressureChangeCallback(
+                sp<MemoryOveruseMonitor>::fromExisting(this));
+        mIsPressureCallbackRegistered = false;
+    }
+    mOveruseWindowsById.clear();
+}
+
+Result<void> MemoryOveruseMonitor::onPeriodicCollection(
+        time_point_millis time, [[maybe_unused]] SystemState systemState,
+        const wp<UidStatsCollectorInterface>& uidStatsCollector,
+        [[maybe_unused]] const wp<ProcStatCollectorInterface>& procStatCollector,
+        ResourceStats* resourceStats) {
+    const sp<UidStatsCollectorInterface> uidStatsCollectorSp = uidStatsCollector.promote();
+    if (uidStatsCollectorSp == nullptr) {
+        return Error() << "Per-UID stats collector must not be null";
+    }
+    Mutex::Autolock lock(mMutex);
+    const PressureMonitorInterface::PressureLevel maxPressureLevel =
+            mMaxPressureLevelSinceLastCollection;
+    mMaxPressureLevelSinceLastCollection = mLatestPressureLevel;
+    if (maxPressureLevel < kMinPressureLevel) {
+        // Memory isn't contended, so the ongoing overuses are no longer sustained.
+        mOveruseWindowsById.clear();
+        return {};
+    }
+    const std::vector<PackageMemoryOveruseStats> reportedStats =
+            processLocked(time, uidStatsCollectorSp->latestStats());
+    if (reportedStats.empty() || resourceStats == nullptr) {
+        return {};
+    }
+    if (!(resourceStats->resourceOveruseStats).has_value()) {
+        resourceStats->resourceOveruseStats = std::make_optional<ResourceOveruseStats>({});
+    }
+    auto& internalStats = resourceStats->resourceOveruseStats->packageMemoryOveruseStats;
+    for (const auto& stats : reportedStats) {
+        internalStats.push_back(toInternalPackageMemoryOveruseStats(stats, kIsKillEnabled));
+    }
+    return {};
+}
+
+Result<void> MemoryOveruseMonitor::onCustomCollection(
+        time_point_millis time, SystemState systemState,
+        const std::unordered_set<std::string>& filterPackages,
+        const wp<UidStatsCollectorInterface>& uidStatsCollector,
+        const wp<ProcStatCollectorInterface>& procStatCollector, ResourceStats* resourceStats) {
+    if (!filterPackages.empty()) {
+        // Filtered collections read the stats only for the filtered packages. Packages missing
+        // from the partial stats must not end their overuse windows, so skip the collection.
+        return {};
+    }
+    return onPeriodicCollection(time, systemState, uidStatsCollector, procStatCollector,
+                                resourceStats);
+}
+
+std::vector<PackageMemoryOveruseStats> MemoryOveruseMonitor::processLocked(
+        time_point_millis time, const std::vector<UidStats>& uidStats) {
+    std::vector<PackageMemoryOveruseStats> reportedStats;
+    std::unordered_set<std::string> overusingIds;
+    for (const auto& curUidStats : uidStats) {
+        if (!curUidStats.hasPackageInfo()) {
+            continue;
+        }
+        const PackageInfo& packageInfo = curUidStats.packageInfo;
+        const int64_t memoryKb = static_cast<int64_t>(curUidStats.procStats.totalPssKb > 0
+                                                              ? curUidStats.procStats.totalPssKb
+                                                              : curUidStats.procStats.totalRssKb);
+        const int64_t thresholdKb = mMemoryOveruseConfigs->fetchThresholdKb(packageInfo);
+        if (memoryKb <= thresholdKb) {
+            continue;
+        }
+        const std::string id = uniquePackageIdStr(packageInfo);
+        overusingIds.insert(id);
+        auto it = mOveruseWindowsById.try_emplace(id, OveruseWindow{.startTime = time}).first;
+        const auto overuseDuration =
+                std::chrono::duration_cast<std::chrono::milliseconds>(time - it->second.startTime);
+        if (overuseDuration < kSustainedOveruseDuration) {
+            continue;
+        }
+        PackageMemoryOveruseStats stats{
+                .packageInfo = packageInfo,
+                .reportTime = time,
+                .memoryKb = memoryKb,
+                .thresholdKb = thresholdKb,
+                .overuseDuration = overuseDuration,
+                .totalOveruses = ++mTotalOverusesById[id],
+                .killableOnOveruse = mMemoryOveruseConfigs->isSafeToKill(packageInfo),
+        };
+        ALOGW("Detected sustained memory overuse. %s", stats.toString().c_str());
+        if (mOveruseStatsHistory.size() >= kMaxMemoryOveruseStatsHistory) {
+            mOveruseStatsHistory.erase(mOveruseStatsHistory.begin());
+        }
+        mOveruseStatsHistory.push_back(stats);
+        reportedStats.push_back(std::move(stats));
+        // Start a new window so the package is reported again only if the overuse is sustained
+        // for another |kSustainedOveruseDuration|.
+        it->second.startTime = time;
+    }
+    // Packages that stopped overusing or exited no longer have a continuous overuse.
+    for (auto it = mOveruseWindowsById.begin(); it != mOveruseWindowsById.end();) {
+        if (overusingIds.find(it->first) == overusingIds.end()) {
+            it = mOveruseWindowsById.erase(it);
+            continue;
+        }
+        ++it;
+    }
+    return reportedStats;
+}
+
+void MemoryOveruseMonitor::onPressureChanged(
+        PressureMonitorInterface::PressureLevel pressureLevel) {
+    Mutex::Autolock lock(mMutex);
+    mLatestPressureLevel = pressureLevel;
+    mMaxPressureLevelSinceLastCollection =
+            std::max(mMaxPressureLevelSinceLastCollection, pressureLevel);
+}
+
+Result<void> MemoryOveruseMonitor::updateMemoryOveruseConfigurations(
+        const std::vector<MemoryOveruseConfiguration>& configs) {
+    Mutex::Autolock lock(mMutex);
+    if (mMemoryOveruseConfigs == nullptr) {
+        return Error() << "Memory overuse monitor is not initialized";
+    }
+    if (const auto result = mMemoryOveruseConfigs->update(configs); !result.ok()) {
+        return Error() << "Failed to update memory overuse configs: " << result.error();
+    }
+    // Thresholds changed, so restart tracking the overuses against the new thresholds.
+    mOveruseWindowsById.clear();
+    return {};
+}
+
+Result<void> MemoryOveruseMonitor::onDump(int fd) const {
+    Mutex::Autolock lock(mMutex);
+    std::string buffer =
+            StringPrintf("\nMemory overuse monitor:\n%s\n", std::string(23, '-').c_str());
+    StringAppendF(&buffer, "Pressure monitoring: %s\n",
+                  mIsPressureCallbackRegistered ? "enabled" : "disabled");
+    StringAppendF(&buffer, "Kill on overuse: %s\n", kIsKillEnabled ? "enabled" : "disabled");
+    StringAppendF(&buffer, "Sustained overuse duration: %" PRId64 " seconds\n",
+                  std::chrono::duration_cast<std::chrono::seconds>(kSustainedOveruseDuration)
+                          .count());
+    StringAppendF(&buffer, "Packages currently overusing memory: %zu\n",
+                  mOveruseWindowsById.size());
+    StringAppendF(&buffer, "Recent memory overuses:\n");
+    if (mOveruseStatsHistory.empty()) {
+        StringAppendF(&buffer, "\tNone\n");
+    }
+    for (const auto& stats : mOveruseStatsHistory) {
+        StringAppendF(&buffer, "\t%s", stats.toString().c_str());
+    }
+    if (!WriteStringToFd(buffer, fd)) {
+        return Error(FAILED_TRANSACTION) << "Failed to dump the memory overuse monitor";
+    }
+    return {};
+}
+
+}  // namespace watchdog
+}  // namespace automotive
+}  // namespace android
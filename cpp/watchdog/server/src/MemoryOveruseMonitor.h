@@ -0,0 +1,251 @@
+/*
+ * Copyright (c) 2024, The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef CPP_WATCHDOG_SERVER_SRC_MEMORYOVERUSEMONITOR_H_
+#define CPP_WATCHDOG_SERVER_SRC_MEMORYOVERUSEMONITOR_H_
+
+#include "MemoryOveruseConfigs.h"
+#include "PressureMonitor.h"
+#include "ProcStatCollector.h"
+#include "UidStatsCollector.h"
+#include "WatchdogPerfService.h"
+
+#include <aidl/android/automotive/watchdog/internal/PackageInfo.h>
+#include <aidl/android/automotive/watchdog/internal/ResourceStats.h>
+#include <android-base/result.h>
+#include <android/util/ProtoOutputStream.h>
+#include <utils/Mutex.h>
+
+#include <string>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+namespace android {
+namespace automotive {
+namespace watchdog {
+
+// Duration a package must continuously overuse memory under memory pressure to be reported.
+constexpr std::chrono::milliseconds kDefaultSustainedMemoryOveruseDuration = 5min;
+// Lowest memory pressure level at which the memory overuse is tracked.
+constexpr PressureMonitorInterface::PressureLevel kDefaultMemoryOveruseMinPressureLevel =
+        PressureMonitorInterface::PRESSURE_LEVEL_MEDIUM;
+// Maximum number of memory overuse stats to cache for the dump.
+constexpr size_t kMaxMemoryOveruseStatsHistory = 50;
+// Property that allows CarWatchdogService to kill the packages that are safe to kill on memory
+// overuse.
+constexpr const char kPropertyMemoryOveruseKillEnabled[] =
+        "ro.carwatchdog.memory_overuse.kill_enabled";
+
+// Forward declaration for testing use only.
+namespace internal {
+
+class MemoryOveruseMonitorPeer;
+
+}  // namespace internal
+
+// Memory overuse reported for a package.
+struct PackageMemoryOveruseStats {
+    aidl::android::automotive::watchdog::internal::PackageInfo packageInfo;
+    // Time of the collection that reported the overuse.
+    time_point_millis reportTime;
+    // Memory usage at the time of the report. PSS when available, otherwise RSS.
+    int64_t memoryKb = 0;
+    int64_t thresholdKb = 0;
+    // Duration the package has continuously overused the memory under memory pressure.
+    std::chrono::milliseconds overuseDuration = 0ms;
+    // Number of times the package was reported since the system start.
+    int totalOveruses = 0;
+    bool killableOnOveruse = false;
+
+    std::string toString() const;
+};
+
+/**
+ * MemoryOveruseMonitor reports the packages that use more memory than their configured thresholds
+ * while the system is under memory pressure.
+ *
+ * A package is reported only after it has continuously overused memory for the sustained overuse
+ * duration and the memory pressure stayed at or above the minimum pressure level through the
+ * whole duration. Memory usage doesn't hurt the system when memory isn't contended, so the
+ * tracked overuse is reset whenever the pressure drops below the minimum level.
+ *
+ * The reported overuses are pushed to CarWatchdogService with the resource overuse stats of the
+ * collection. CarWatchdogService decides whether to kill the package, as it does on I/O overuse.
+ * Packages are reported as killable only when killing on overuse is enabled and the package is
+ * safe to kill.
+ *
+ * No overuse is reported until the memory overuse configurations are provided.
+ */
+class MemoryOveruseMonitor final :
+      public DataProcessorInterface,
+      public PressureMonitorInterface::PressureChangeCallbackInterface {
+public:
+    // Reports packages as killable only when the |kPropertyMemoryOveruseKillEnabled| property is
+    // set.
+    explicit MemoryOveruseMonitor(const android::sp<PressureMonitorInterface>& pressureMonitor);
+
+    MemoryOveruseMonitor(const android::sp<PressureMonitorInterface>& pressureMonitor,
+                         bool isKillEnabled, std::chrono::milliseconds sustainedOveruseDuration,
+                         PressureMonitorInterface::PressureLevel minPressureLevel) :
+          kPressureMonitor(pressureMonitor),
+          kIsKillEnabled(isKillEnabled),
+          kSustainedOveruseDuration(sustainedOveruseDuration),
+          kMinPressureLevel(minPressureLevel),
+          mLatestPressureLevel(PressureMonitorInterface::PRESSURE_LEVEL_NONE),
+          mIsPressureCallbackRegistered(false),
+          mMaxPressureLevelSinceLastCollection(PressureMonitorInterface::PRESSURE_LEVEL_NONE) {}
+
+    ~MemoryOveruseMonitor() { terminate(); }
+
+    std::string name() const override { return "MemoryOveruseMonitor"; }
+
+    // Implements DataProcessorInterface.
+    android::base::Result<void> onSystemStartup() override {
+        // No memory overuse tracking across system startup events.
+        return {};
+    }
+
+    void onCarWatchdogServiceRegistered() override {}
+
+    android::base::Result<void> onBoottimeCollection(
+            [[maybe_unused]] time_point_millis time,
+            [[maybe_unused]] const android::wp<UidStatsCollectorInterface>& uidStatsCollector,
+            [[maybe_unused]] const android::wp<ProcStatCollectorInterface>& procStatCollector,
+            [[maybe_unused]] aidl::android::automotive::watchdog::internal::ResourceStats*
+                    resourceStats) override {
+        // No memory overuse monitoring during boot-time.
+        return {};
+    }
+
+    android::base::Result<void> onWakeUpCollection(
+            [[maybe_unused]] time_point_millis time,
+            [[maybe_unused]] const android::wp<UidStatsCollectorInterface>& uidStatsCollector,
+            [[maybe_unused]] const android::wp<ProcStatCollectorInterface>& procStatCollector)
+            override {
+        // No memory overuse monitoring during wake up.
+        return {};
+    }
+
+    android::base::Result<void> onUserSwitchCollection(
+            [[maybe_unused]] time_point_millis time, [[maybe_unused]] userid_t from,
+            [[maybe_unused]] userid_t to,
+            [[maybe_unused]] const android::wp<UidStatsCollectorInterface>& uidStatsCollector,
+            [[maybe_unused]] const android::wp<ProcStatCollectorInterface>& procStatCollector)
+            override {
+        // No memory overuse monitoring during user switch.
+        return {};
+    }
+
+    android::base::Result<void> onPeriodicCollection(
+            time_point_millis time, SystemState systemState,
+            const android::wp<UidStatsCollectorInterface>& uidStatsCollector,
+            const android::wp<ProcStatCollectorInterface>& procStatCollector,
+            aidl::android::automotive::watchdog::internal::ResourceStats* resourceStats) override;
+
+    android::base::Result<void> onCustomCollection(
+            time_point_millis time, SystemState systemState,
+            const std::unordered_set<std::string>& filterPackages,
+            const android::wp<UidStatsCollectorInterface>& uidStatsCollector,
+            const android::wp<ProcStatCollectorInterface>& procStatCollector,
+            aidl::android::automotive::watchdog::internal::ResourceStats* resourceStats) override;
+
+    android::base::Result<void> onPeriodicMonitor(
+            [[maybe_unused]] time_t time,
+            [[maybe_unused]] const android::wp<ProcDiskStatsCollectorInterface>&
+                    procDiskStatsCollector,
+            [[maybe_unused]] const std::function<void()>& alertHandler) override {
+        // Memory overuse is tracked only on collections because it needs the per-UID stats.
+        return {};
+    }
+
+    android::base::Result<void> onDump(int fd) const override;
+
+    android::base::Result<void> onDumpProto(
+            [[maybe_unused]] const CollectionIntervals& collectionIntervals,
+            [[maybe_unused]] android::util::ProtoOutputStream& outProto) const override {
+        // No proto dump for memory overuse monitoring.
+        return {};
+    }
+
+    android::base::Result<void> onCustomCollectionDump([[maybe_unused]] int fd) override {
+        // No special processing for custom collection. Thus no custom collection dump.
+        return {};
+    }
+
+    // Implements PressureChangeCallbackInterface.
+    void onPressureChanged(PressureMonitorInterface::PressureLevel pressureLevel) override;
+
+    // Overwrites the memory overuse configurations of the given components. Must be called after
+    // the monitor is registered with WatchdogPerfService.
+    android::base::Result<void> updateMemoryOveruseConfigurations(
+            const std::vector<MemoryOveruseConfiguration>& configs);
+
+protected:
+    android::base::Result<void> init() override;
+
+    void terminate() override;
+
+private:
+    // Continuous memory overuse of a package.
+    struct OveruseWindow {
+        time_point_millis startTime;
+    };
+
+    // Updates the overuse windows with the latest per-UID memory usage. Returns the overuses
+    // reported on this collection.
+    std::vector<PackageMemoryOveruseStats> processLocked(time_point_millis time,
+                                                         const std::vector<UidStats>& uidStats);
+
+    const android::sp<PressureMonitorInterface> kPressureMonitor;
+    const bool kIsKillEnabled;
+    const std::chrono::milliseconds kSustainedOveruseDuration;
+    const PressureMonitorInterface::PressureLevel kMinPressureLevel;
+
+    // Guards the state below against concurrent collections, pressure changes and dumps.
+    mutable Mutex mMutex;
+
+    android::sp<MemoryOveruseConfigsInterface> mMemoryOveruseConfigs GUARDED_BY(mMutex);
+
+    PressureMonitorInterface::PressureLevel mLatestPressureLevel GUARDED_BY(mMutex);
+
+    bool mIsPressureCallbackRegistered GUARDED_BY(mMutex);
+
+    // Highest pressure level seen since the last collection, so short spikes aren't missed.
+    PressureMonitorInterface::PressureLevel mMaxPressureLevelSinceLastCollection
+            GUARDED_BY(mMutex);
+
+    // Overuse windows of the packages currently overusing memory. Key is a unique ID with the
+    // format `packageName:userId`.
+    std::unordered_map<std::string, OveruseWindow> mOveruseWindowsById GUARDED_BY(mMutex);
+
+    // Total reported overuses per package. Key has the same format as |mOveruseWindowsById|.
+    std::unordered_map<std::string, int> mTotalOverusesById GUARDED_BY(mMutex);
+
+    // Latest |kMaxMemoryOveruseStatsHistory| reported overuses.
+    std::vector<PackageMemoryOveruseStats> mOveruseStatsHistory GUARDED_BY(mMutex);
+
+    friend class WatchdogPerfService;
+
+    // For unit tests.
+    friend class internal::MemoryOveruseMonitorPeer;
+};
+
+}  // namespace watchdog
+}  // namespace automotive
+}  // namespace android
+
+#endif  //  CPP_WATCHDOG_SERVER_SRC_MEMORYOVERUSEMONITOR_H_
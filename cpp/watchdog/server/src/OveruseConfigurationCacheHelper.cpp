@@ -0,0 +1,205 @@
+/*
+ * Copyright (c) 2024, The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#define LOG_TAG "carwatchdogd"
+
+#include "OveruseConfigurationCacheHelper.h"
+
+#include <aidl/android/automotive/watchdog/internal/ICarWatchdog.h>
+#include <android-base/file.h>
+#include <android-base/properties.h>
+#include <android-base/strings.h>
+#include <android/binder_auto_utils.h>
+#include <android/binder_parcel.h>
+#include <android/binder_status.h>
+
+#include <stdio.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <zlib.h>
+
+namespace android {
+namespace automotive {
+namespace watchdog {
+
+using ::aidl::android::automotive::watchdog::internal::ICarWatchdog;
+using ::aidl::android::automotive::watchdog::internal::ResourceOveruseConfiguration;
+using ::android::base::EndsWith;
+using ::android::base::ErrnoError;
+using ::android::base::Error;
+using ::android::base::GetProperty;
+using ::android::base::ReadFileToString;
+using ::android::base::Result;
+using ::android::base::WriteStringToFile;
+using ::ndk::ScopedAParcel;
+
+namespace {
+
+constexpr const char kXmlFileExtension[] = ".xml";
+constexpr const char kTempFileSuffix[] = ".tmp";
+constexpr const char kBuildFingerprintProperty[] = "ro.build.fingerprint";
+// ASCII "CWOC" (Car Watchdog Overuse Configuration) in little-endian byte order.
+constexpr uint32_t kCacheMagic = 0x434f5743;
+// Must be incremented on any change to |CacheHeader| or the payload's encoding.
+constexpr uint32_t kCacheFormatVersion = 2;
+
+struct CacheHeader {
+    uint32_t magic = 0;
+    uint32_t version = 0;
+    uint64_t xmlFileSize = 0;
+    int64_t xmlModifiedTimeNs = 0;
+    uint32_t payloadSize = 0;
+    uint32_t payloadCrc32 = 0;
+    // The parcel encoding depends on the AIDL version and the defaults applied while parsing
+    // depend on the build, so a cache written before an OTA must not be used after it.
+    int32_t aidlVersion = 0;
+    uint32_t buildFingerprintCrc32 = 0;
+};
+
+static_assert(sizeof(CacheHeader) == 40, "CacheHeader must not have padding");
+
+// Reads the size and the modification time of the XML file, which bind the cache to the file.
+Result<void> readXmlFileStamp(const char* xmlFilePath, CacheHeader* header) {
+    struct stat st;
+    if (stat(xmlFilePath, &st) != 0) {
+        return ErrnoError() << "Failed to stat '" << xmlFilePath << "'";
+    }
+    header->xmlFileSize = static_cast<uint64_t>(st.st_size);
+    header->xmlModifiedTimeNs =
+            static_cast<int64_t>(st.st_mtim.tv_sec) * 1'000'000'000 + st.st_mtim.tv_nsec;
+    return {};
+}
+
+uint32_t computeCrc32(const uint8_t* data, size_t size) {
+    return static_cast<uint32_t>(crc32(crc32(0L, Z_NULL, 0), data, static_cast<uInt>(size)));
+}
+
+std::string getBuildFingerprint() {
+    return GetProperty(kBuildFingerprintProperty, "");
+}
+
+uint32_t computeBuildFingerprintCrc32() {
+    const std::string fingerprint = OveruseConfigurationCacheHelper::sGetBuildFingerprint();
+    return computeCrc32(reinterpret_cast<const uint8_t*>(fingerprint.data()), fingerprint.size());
+}
+
+}  // namespace
+
+std::function<std::string()> OveruseConfigurationCacheHelper::sGetBuildFingerprint =
+        &getBuildFingerprint;
+
+std::string OveruseConfigurationCacheHelper::getCacheFilePath(const char* xmlFilePath) {
+    std::string path(xmlFilePath);
+    if (EndsWith(path, kXmlFileExtension)) {
+        path.resize(path.size() - strlen(kXmlFileExtension));
+    }
+    return path + kOveruseConfigurationCacheFileExtension;
+}
+
+Result<ResourceOveruseConfiguration> OveruseConfigurationCacheHelper::readCacheFile(
+        const char* xmlFilePath) {
+    const std::string cacheFilePath = getCacheFilePath(xmlFilePath);
+    std::string contents;
+    if (!ReadFileToString(cacheFilePath, &contents)) {
+        return ErrnoError() << "Failed to read '" << cacheFilePath << "'";
+    }
+    if (contents.size() < sizeof(CacheHeader)) {
+        return Error() << "Cache file '" << cacheFilePath << "' is truncated";
+    }
+    CacheHeader header;
+    memcpy(&header, contents.data(), sizeof(CacheHeader));
+    if (header.magic != kCacheMagic || header.version != kCacheFormatVersion) {
+        return Error() << "Cache file '" << cacheFilePath << "' has unsupported format version "
+                       << header.version;
+    }
+    if (header.aidlVersion != ICarWatchdog::version ||
+        header.buildFingerprintCrc32 != computeBuildFingerprintCrc32()) {
+        return Error() << "Cache file '" << cacheFilePath << "' was written by a different build";
+    }
+    CacheHeader xmlFileStamp;
+    if (const auto result = readXmlFileStamp(xmlFilePath, &xmlFileStamp); !result.ok()) {
+        return result.error();
+    }
+    if (header.xmlFileSize != xmlFileStamp.xmlFileSize ||
+        header.xmlModifiedTimeNs != xmlFileStamp.xmlModifiedTimeNs) {
+        return Error() << "Cache file '" << cacheFilePath << "' is stale";
+    }
+    const uint8_t* payload = reinterpret_cast<const uint8_t*>(contents.data()) + sizeof(CacheHeader);
+    if (const size_t payloadSize = contents.size() - sizeof(CacheHeader);
+        payloadSize != header.payloadSize ||
+        computeCrc32(payload, payloadSize) != header.payloadCrc32) {
+        return Error() << "Cache file '" << cacheFilePath << "' is corrupted";
+    }
+    ScopedAParcel parcel(AParcel_create());
+    if (binder_status_t status = AParcel_unmarshal(parcel.get(), payload, header.payloadSize);
+        status != STATUS_OK) {
+        return Error() << "Failed to unmarshal cache file '" << cacheFilePath
+                       << "': status " << status;
+    }
+    AParcel_setDataPosition(parcel.get(), 0);
+    ResourceOveruseConfiguration configuration;
+    if (binder_status_t status = configuration.readFromParcel(parcel.get()); status != STATUS_OK) {
+        return Error() << "Failed to read configuration from cache file '" << cacheFilePath
+                       << "': status " << status;
+    }
+    return configuration;
+}
+
+Result<void> OveruseConfigurationCacheHelper::writeCacheFile(
+        const ResourceOveruseConfiguration& configuration, const char* xmlFilePath) {
+    CacheHeader header{
+            .magic = kCacheMagic,
+            .version = kCacheFormatVersion,
+            .aidlVersion = ICarWatchdog::version,
+            .buildFingerprintCrc32 = computeBuildFingerprintCrc32(),
+    };
+    if (const auto result = readXmlFileStamp(xmlFilePath, &header); !result.ok()) {
+        return result;
+    }
+    ScopedAParcel parcel(AParcel_create());
+    if (binder_status_t status = configuration.writeToParcel(parcel.get()); status != STATUS_OK) {
+        return Error() << "Failed to write configuration to parcel: status " << status;
+    }
+    const int32_t payloadSize = AParcel_getDataSize(parcel.get());
+    std::string contents(sizeof(CacheHeader) + payloadSize, '\0');
+    uint8_t* payload = reinterpret_cast<uint8_t*>(contents.data()) + sizeof(CacheHeader);
+    if (binder_status_t status = AParcel_marshal(parcel.get(), payload, 0, payloadSize);
+        status != STATUS_OK) {
+        return Error() << "Failed to marshal configuration: status " << status;
+    }
+    header.payloadSize = static_cast<uint32_t>(payloadSize);
+    header.payloadCrc32 = computeCrc32(payload, payloadSize);
+    memcpy(contents.data(), &header, sizeof(CacheHeader));
+
+    // Write to a temporary file first so a crash doesn't leave a partially written cache behind.
+    const std::string cacheFilePath = getCacheFilePath(xmlFilePath);
+    const std::string tempFilePath = cacheFilePath + kTempFileSuffix;
+    if (!WriteStringToFile(contents, tempFilePath)) {
+        return ErrnoError() << "Failed to write '" << tempFilePath << "'";
+    }
+    if (rename(tempFilePath.c_str(), cacheFilePath.c_str()) != 0) {
+        Result<void> result = ErrnoError() << "Failed to rename '" << tempFilePath << "' to '"
+                                           << cacheFilePath << "'";
+        unlink(tempFilePath.c_str());
+        return result;
+    }
+    return {};
+}
+
+}  // namespace watchdog
+}  // namespace automotive
+}  // namespace android
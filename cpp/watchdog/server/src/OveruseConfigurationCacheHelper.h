@@ -0,0 +1,69 @@
+/*
+ * Copyright (c) 2024, The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef CPP_WATCHDOG_SERVER_SRC_OVERUSECONFIGURATIONCACHEHELPER_H_
+#define CPP_WATCHDOG_SERVER_SRC_OVERUSECONFIGURATIONCACHEHELPER_H_
+
+#include <aidl/android/automotive/watchdog/internal/ResourceOveruseConfiguration.h>
+#include <android-base/result.h>
+#include <utils/RefBase.h>
+
+#include <functional>
+#include <string>
+
+namespace android {
+namespace automotive {
+namespace watchdog {
+
+// Extension of the cache file written next to a resource overuse configuration XML file.
+constexpr const char kOveruseConfigurationCacheFileExtension[] = ".cache";
+
+/*
+ * Reads and writes a binary cache of a parsed resource overuse configuration.
+ *
+ * Parsing the XML configurations is on the critical path of the daemon's startup. The cache holds
+ * the configuration as a marshalled parcel behind a header with a magic, a format version, the size
+ * and modification time of the XML file it was derived from, the AIDL version, a CRC32 of the build
+ * fingerprint, and a CRC32 of the payload. The cache is rejected when any of these don't match, so
+ * the XML file always remains the source of truth and a cache doesn't outlive an OTA.
+ */
+class OveruseConfigurationCacheHelper final : virtual public android::RefBase {
+public:
+    // Returns the path of the cache file for the XML file at |xmlFilePath|.
+    static std::string getCacheFilePath(const char* xmlFilePath);
+
+    // Reads the configuration cached for the XML file at |xmlFilePath|. Returns an error when the
+    // cache is missing, corrupted, or doesn't match the current XML file.
+    static android::base::Result<
+            aidl::android::automotive::watchdog::internal::ResourceOveruseConfiguration>
+    readCacheFile(const char* xmlFilePath);
+
+    // Caches |configuration| for the XML file at |xmlFilePath|. Must be called after the XML file
+    // is written because the cache is bound to the XML file's size and modification time.
+    static android::base::Result<void> writeCacheFile(
+            const aidl::android::automotive::watchdog::internal::ResourceOveruseConfiguration&
+                    configuration,
+            const char* xmlFilePath);
+
+    // Returns the build fingerprint that the cache is bound to. Overridden by tests.
+    static std::function<std::string()> sGetBuildFingerprint;
+};
+
+}  // namespace watchdog
+}  // namespace automotive
+}  // namespace android
+
+#endif  //  CPP_WATCHDOG_SERVER_SRC_OVERUSECONFIGURATIONCACHEHELPER_H_
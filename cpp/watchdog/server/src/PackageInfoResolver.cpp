@@ -18,16 +18,25 @@
 
 #include "PackageInfoResolver.h"
 
+#include "ProcFileReader.h"
+
 #include <aidl/android/automotive/watchdog/internal/ApplicationCategoryType.h>
 #include <aidl/android/automotive/watchdog/internal/ComponentType.h>
 #include <aidl/android/automotive/watchdog/internal/UidType.h>
+#include <android-base/file.h>
+#include <android-base/parseint.h>
+#include <android-base/properties.h>
+#include <android-base/stringprintf.h>
 #include <android-base/strings.h>
 #include <cutils/android_filesystem_config.h>
 #include <processgroup/sched_policy.h>
 
+#include <dirent.h>
 #include <inttypes.h>
 #include <pthread.h>
+#include <sys/stat.h>
 
+#include <algorithm>
 #include <future>  // NOLINT(build/c++11)
 #include <iterator>
 #include <string_view>
@@ -41,11 +50,19 @@ using ::aidl::android::automotive::watchdog::internal::ComponentType;
 using ::aidl::android::automotive::watchdog::internal::PackageInfo;
 using ::aidl::android::automotive::watchdog::internal::UidType;
 using ::android::sp;
+using ::android::base::Dirname;
 using ::android::base::Error;
+using ::android::base::GetProperty;
+using ::android::base::ParseInt;
+using ::android::base::ReadFileToString;
 using ::android::base::Result;
 using ::android::base::StartsWith;
+using ::android::base::StringAppendF;
+using ::android::base::StringPrintf;
+using ::android::base::WriteStringToFile;
 
 using GetpwuidFunction = std::function<struct passwd*(uid_t)>;
+using GetRunningUidsFunction = std::function<std::unordered_set<uid_t>()>;
 using PackageToAppCategoryMap = std::unordered_map<std::string, ApplicationCategoryType>;
 
 namespace {
@@ -53,7 +70,19 @@ namespace {
 constexpr const char* kSharedPackagePrefix = "shared:";
 constexpr const char* kServiceName = "PkgInfoResolver";
 
+constexpr const char* kBuildFingerprintProperty = "ro.build.fingerprint";
+constexpr const char* kProcDirPath = "/proc";
+// Bump the version whenever the cache file format changes.
+constexpr int32_t kPackageInfoCacheVersion = 2;
+/*
+ * Delay before persisting the updated cache. Coalesces the many updates made by the first
+ * collections into a single write.
+ */
+constexpr std::chrono::seconds kPackageInfoCachePersistDelay = std::chrono::seconds(10);
+
 const int32_t MSG_RESOLVE_PACKAGE_NAME = 0;
+const int32_t MSG_PREFETCH_PACKAGE_INFOS = 1;
+const int32_t MSG_PERSIST_PACKAGE_INFO_CACHE = 2;
 
 ComponentType getComponentTypeForNativeUid(uid_t uid, std::string_view packageName,
                                            const std::vector<std::string>& vendorPackagePrefixes) {
@@ -94,10 +123,98 @@ Result<PackageInfo> getPackageInfoForNativeUid(
     return packageInfo;
 }
 
+// Returns a stable FNV-1a hash of the package configurations.
+uint64_t hashPackageConfigurations(const std::vector<std::string>& vendorPackagePrefixes,
+                                   const PackageToAppCategoryMap& packagesToAppCategories) {
+    std::vector<std::string> entries(vendorPackagePrefixes.begin(), vendorPackagePrefixes.end());
+    for (const auto& [packageName, appCategoryType] : packagesToAppCategories) {
+        entries.push_back(StringPrintf("%s=%d", packageName.c_str(),
+                                       static_cast<int32_t>(appCategoryType)));
+    }
+    // Prefixes can't contain '=', so the prefixes and the mappings don't collide after sorting.
+    std::sort(entries.begin(), entries.end());
+    uint64_t hash = 14695981039346656037ULL;
+    for (const auto& entry : entries) {
+        for (const char c : entry) {
+            hash = (hash ^ static_cast<uint8_t>(c)) * 1099511628211ULL;
+        }
+        hash = (hash ^ static_cast<uint8_t>('\n')) * 1099511628211ULL;
+    }
+    return hash;
+}
+
+std::string getPackageInfoCacheHeader(uint64_t packageConfigurationsHash) {
+    return StringPrintf("%" PRId32 " %s %" PRIu64, kPackageInfoCacheVersion,
+                        GetProperty(kBuildFingerprintProperty, "").c_str(),
+                        packageConfigurationsHash);
+}
+
+/*
+ * Each cache entry is a line with space separated uid, uid type, component type, application
+ * category type, package name, and shared UID packages. Package names don't contain spaces.
+ */
+std::string toCacheEntry(const PackageInfo& packageInfo) {
+    std::string entry =
+            StringPrintf("%" PRId32 " %d %d %d %s", packageInfo.packageIdentifier.uid,
+                         static_cast<int32_t>(packageInfo.uidType),
+                         static_cast<int32_t>(packageInfo.componentType),
+                         static_cast<int32_t>(packageInfo.appCategoryType),
+                         packageInfo.packageIdentifier.name.c_str());
+    for (const auto& packageName : packageInfo.sharedUidPackages) {
+        StringAppendF(&entry, " %s", packageName.c_str());
+    }
+    return entry;
+}
+
+Result<PackageInfo> fromCacheEntry(std::string_view entry, std::vector<std::string_view>* fields) {
+    splitFields(entry, ' ', fields);
+    int32_t uid = 0;
+    int32_t uidType = 0;
+    int32_t componentType = 0;
+    int32_t appCategoryType = 0;
+    if (fields->size() < 5 || !parseIntField((*fields)[0], &uid) ||
+        !parseIntField((*fields)[1], &uidType) || !parseIntField((*fields)[2], &componentType) ||
+        !parseIntField((*fields)[3], &appCategoryType) || (*fields)[4].empty()) {
+        return Error() << "Malformed entry '" << entry << "'";
+    }
+    PackageInfo packageInfo;
+    packageInfo.packageIdentifier.uid = uid;
+    packageInfo.packageIdentifier.name = (*fields)[4];
+    packageInfo.uidType = static_cast<UidType>(uidType);
+    packageInfo.componentType = static_cast<ComponentType>(componentType);
+    packageInfo.appCategoryType = static_cast<ApplicationCategoryType>(appCategoryType);
+    packageInfo.sharedUidPackages.assign(fields->begin() + 5, fields->end());
+    return packageInfo;
+}
+
+// Returns the UIDs that own the running processes.
+std::unordered_set<uid_t> readRunningUids() {
+    std::unordered_set<uid_t> uids;
+    auto procDirp = std::unique_ptr<DIR, int (*)(DIR*)>(opendir(kProcDirPath), closedir);
+    if (!procDirp) {
+        ALOGW("Failed to open %s directory", kProcDirPath);
+        return uids;
+    }
+    const dirent* entry = nullptr;
+    while ((entry = readdir(procDirp.get())) != nullptr) {
+        pid_t pid = 0;
+        if (entry->d_type != DT_DIR || !ParseInt(entry->d_name, &pid)) {
+            continue;
+        }
+        // The owner of the /proc/[pid] directory is the process's effective UID.
+        struct stat pidDirStat;
+        if (fstatat(dirfd(procDirp.get()), entry->d_name, &pidDirStat, 0) == 0) {
+            uids.insert(pidDirStat.st_uid);
+        }
+    }
+    return uids;
+}
+
 }  // namespace
 
 sp<PackageInfoResolver> PackageInfoResolver::sInstance = nullptr;
 GetpwuidFunction PackageInfoResolver::sGetpwuidHandler = &getpwuid;
+GetRunningUidsFunction PackageInfoResolver::sGetRunningUidsHandler = &readRunningUids;
 
 sp<PackageInfoResolverInterface> PackageInfoResolver::getInstance() {
     if (sInstance == nullptr) {
@@ -137,14 +254,30 @@ void PackageInfoResolver::setPackageConfigurations(
     std::copy(vendorPackagePrefixes.begin(), vendorPackagePrefixes.end(),
               std::back_inserter(mVendorPackagePrefixes));
     mPackagesToAppCategories = packagesToAppCategories;
+    mHasPackageConfigurations = true;
+    const uint64_t packageConfigurationsHash =
+            hashPackageConfigurations(mVendorPackagePrefixes, mPackagesToAppCategories);
+    if (packageConfigurationsHash == mPackageConfigurationsHash) {
+        // The cached package infos, which may be loaded from disk, are still valid.
+        return;
+    }
     // Clear the package info cache as the package configurations have changed.
     mUidToPackageInfoMapping.clear();
+    mPackageConfigurationsHash = packageConfigurationsHash;
+    schedulePackageInfoCachePersistLocked();
 }
 
-void PackageInfoResolver::updatePackageInfos(const std::vector<uid_t>& uids) {
+void PackageInfoResolver::updatePackageInfos(const std::vector<uid_t>& uids,
+                                             bool shouldRefreshAppUids) {
     std::unique_lock writeLock(mRWMutex);
+    maybeLoadPackageInfoCacheLocked();
     std::vector<int32_t> missingUids;
+    bool isCacheUpdated = false;
     for (const uid_t uid : uids) {
+        if (shouldRefreshAppUids && uid >= AID_APP_START) {
+            missingUids.emplace_back(static_cast<int32_t>(uid));
+            continue;
+        }
         if (mUidToPackageInfoMapping.find(uid) != mUidToPackageInfoMapping.end()) {
             continue;
         }
@@ -159,6 +292,7 @@ void PackageInfoResolver::updatePackageInfos(const std::vector<uid_t>& uids) {
             continue;
         }
         mUidToPackageInfoMapping[uid] = *result;
+        isCacheUpdated = true;
         if (StartsWith(result->packageIdentifier.name, kSharedPackagePrefix)) {
             // When the UID is shared, poll car watchdog service to fetch the shared packages info.
             missingUids.emplace_back(static_cast<int32_t>(uid));
@@ -169,6 +303,9 @@ void PackageInfoResolver::updatePackageInfos(const std::vector<uid_t>& uids) {
      * There is delay between creating package manager instance and initializing watchdog service
      * helper. Thus check the watchdog service helper instance before proceeding further.
      */
+    if (isCacheUpdated) {
+        schedulePackageInfoCachePersistLocked();
+    }
     if (missingUids.empty() || mWatchdogServiceHelper == nullptr ||
         !mWatchdogServiceHelper->isServiceConnected()) {
         return;
@@ -207,6 +344,23 @@ void PackageInfoResolver::updatePackageInfos(const std::vector<uid_t>& uids) {
         }
         mUidToPackageInfoMapping[id.uid] = packageInfo;
     }
+    if (shouldRefreshAppUids) {
+        // Drop the application UIDs that the car watchdog service no longer resolves, such as the
+        // UIDs of the uninstalled packages.
+        std::unordered_set<uid_t> resolvedUids;
+        for (const auto& packageInfo : packageInfos) {
+            if (!packageInfo.packageIdentifier.name.empty()) {
+                resolvedUids.insert(packageInfo.packageIdentifier.uid);
+            }
+        }
+        for (const int32_t uid : missingUids) {
+            if (uid >= static_cast<int32_t>(AID_APP_START) &&
+                resolvedUids.find(uid) == resolvedUids.end()) {
+                mUidToPackageInfoMapping.erase(uid);
+            }
+        }
+    }
+    schedulePackageInfoCachePersistLocked();
 }
 
 void PackageInfoResolver::asyncFetchPackageNamesForUids(
@@ -237,6 +391,11 @@ std::unordered_map<uid_t, PackageInfo> PackageInfoResolver::getPackageInfosForUi
     return uidToPackageInfoMapping;
 }
 
+void PackageInfoResolver::asyncPrefetchPackageInfos() {
+    mHandlerLooper->removeMessages(mMessageHandler, MSG_PREFETCH_PACKAGE_INFOS);
+    mHandlerLooper->sendMessage(mMessageHandler, Message(MSG_PREFETCH_PACKAGE_INFOS));
+}
+
 void PackageInfoResolver::resolvePackageName() {
     std::vector<std::pair<std::vector<uid_t>,
                           std::function<void(std::unordered_map<uid_t, std::string>)>>>
@@ -272,6 +431,123 @@ void PackageInfoResolver::resolvePackageName() {
     }
 }
 
+void PackageInfoResolver::prefetchPackageInfos() {
+    std::unordered_set<uid_t> uids = sGetRunningUidsHandler();
+    {
+        std::unique_lock writeLock(mRWMutex);
+        maybeLoadPackageInfoCacheLocked();
+        for (const auto& [uid, _] : mUidToPackageInfoMapping) {
+            if (uid >= AID_APP_START) {
+                uids.insert(uid);
+            }
+        }
+    }
+    if (uids.empty()) {
+        return;
+    }
+    // Refresh the cached application UIDs as the packages may have changed while the car watchdog
+    // service was disconnected.
+    updatePackageInfos(std::vector<uid_t>(uids.begin(), uids.end()),
+                       /*shouldRefreshAppUids=*/true);
+}
+
+void PackageInfoResolver::maybeLoadPackageInfoCacheLocked() {
+    if (mIsPackageInfoCacheLoaded) {
+        return;
+    }
+    // The data partition isn't mounted yet when the daemon starts during early boot.
+    if (access(Dirname(mPackageInfoCacheFilePath).c_str(), R_OK | W_OK) != 0) {
+        return;
+    }
+    mIsPackageInfoCacheLoaded = true;
+    std::string contents;
+    if (!ReadFileToString(mPackageInfoCacheFilePath, &contents)) {
+        if (errno != ENOENT) {
+            ALOGW("Failed to read package info cache from '%s': %s",
+                  mPackageInfoCacheFilePath.c_str(), strerror(errno));
+        }
+        return;
+    }
+    LineReader lineReader(contents);
+    std::string_view header;
+    std::vector<std::string_view> fields;
+    uint64_t packageConfigurationsHash = 0;
+    lineReader.next(&header);
+    splitFields(header, ' ', &fields);
+    if (fields.size() != 3 || !parseIntField(fields[2], &packageConfigurationsHash) ||
+        header != getPackageInfoCacheHeader(packageConfigurationsHash)) {
+        // Either the format or the build changed, so the cached UIDs may have been reassigned.
+        ALOGI("Discarding stale package info cache");
+        return;
+    }
+    if (mHasPackageConfigurations && packageConfigurationsHash != mPackageConfigurationsHash) {
+        ALOGI("Discarding package info cache resolved with different package configurations");
+        return;
+    }
+    std::unordered_map<uid_t, PackageInfo> cachedPackageInfos;
+    for (std::string_view line; lineReader.next(&line);) {
+        if (line.empty()) {
+            continue;
+        }
+        auto packageInfo = fromCacheEntry(line, &fields);
+        if (!packageInfo.ok()) {
+            ALOGW("Discarding corrupted package info cache: %s",
+                  packageInfo.error().message().c_str());
+            return;
+        }
+        uid_t uid = static_cast<uid_t>(packageInfo->packageIdentifier.uid);
+        cachedPackageInfos[uid] = std::move(*packageInfo);
+    }
+    // Entries resolved before the data partition was available are more recent.
+    mUidToPackageInfoMapping.merge(cachedPackageInfos);
+    mPackageConfigurationsHash = packageConfigurationsHash;
+}
+
+void PackageInfoResolver::schedulePackageInfoCachePersistLocked() {
+    if (!mIsPackageInfoCacheLoaded || mIsPackageInfoCachePersistPending) {
+        return;
+    }
+    mIsPackageInfoCachePersistPending = true;
+    const nsecs_t delayNs = std::chrono::nanoseconds(kPackageInfoCachePersistDelay).count();
+    mHandlerLooper->sendMessageAtTime(mHandlerLooper->now() + delayNs, mMessageHandler,
+                                      Message(MSG_PERSIST_PACKAGE_INFO_CACHE));
+}
+
+void PackageInfoResolver::persistPackageInfoCache() {
+    std::string contents;
+    std::string filePath;
+    {
+        std::unique_lock writeLock(mRWMutex);
+        mIsPackageInfoCachePersistPending = false;
+        contents = getPackageInfoCacheHeader(mPackageConfigurationsHash) + "\n";
+        for (const auto& [uid, packageInfo] : mUidToPackageInfoMapping) {
+            /*
+             * Application UIDs are not persisted. An application UID is reassigned to another
+             * package when the package is uninstalled and the other package is installed while
+             * the daemon is not running, so a persisted application UID may resolve to the wrong
+             * package after a restart.
+             */
+            if (uid >= AID_APP_START || packageInfo.packageIdentifier.name.empty()) {
+                continue;
+            }
+            contents += toCacheEntry(packageInfo) + "\n";
+        }
+        filePath = mPackageInfoCacheFilePath;
+    }
+    // Write to a temporary file and rename it, so a crash mid-write doesn't corrupt the cache.
+    const std::string tempFilePath = filePath + ".tmp";
+    if (!WriteStringToFile(contents, tempFilePath)) {
+        ALOGW("Failed to write package info cache to '%s': %s", tempFilePath.c_str(),
+              strerror(errno));
+        return;
+    }
+    if (rename(tempFilePath.c_str(), filePath.c_str()) != 0) {
+        ALOGW("Failed to rename '%s' to '%s': %s", tempFilePath.c_str(), filePath.c_str(),
+              strerror(errno));
+        unlink(tempFilePath.c_str());
+    }
+}
+
 void PackageInfoResolver::startLooper() {
     auto promise = std::promise<void>();
     auto checkLooperSet = promise.get_future();
@@ -306,6 +582,12 @@ void PackageInfoResolver::MessageHandlerImpl::handleMessage(const Message& messa
         case MSG_RESOLVE_PACKAGE_NAME:
             kService->resolvePackageName();
             break;
+        case MSG_PREFETCH_PACKAGE_INFOS:
+            kService->prefetchPackageInfos();
+            break;
+        case MSG_PERSIST_PACKAGE_INFO_CACHE:
+            kService->persistPackageInfoCache();
+            break;
         default:
             ALOGW("Unknown message: %d", message.what);
     }
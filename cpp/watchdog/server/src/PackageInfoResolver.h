@@ -35,6 +35,7 @@
 #include <functional>
 #include <queue>
 #include <shared_mutex>
+#include <string>
 #include <thread>  // NOLINT(build/c++11)
 #include <unordered_map>
 #include <unordered_set>
@@ -61,6 +62,7 @@ public:
             const std::function<void(std::unordered_map<uid_t, std::string>)>& callback) = 0;
     virtual std::unordered_map<uid_t, aidl::android::automotive::watchdog::internal::PackageInfo>
     getPackageInfosForUids(const std::vector<uid_t>& uids) = 0;
+    virtual void asyncPrefetchPackageInfos() = 0;
 
 protected:
     virtual android::base::Result<void> initWatchdogServiceHelper(
@@ -83,6 +85,11 @@ private:
  * daemon. PackageInfoResolver is a singleton and must be accessed only via the public static
  * methods.
  *
+ * The native UIDs in the cache are persisted to disk, so the first collections after a daemon
+ * restart don't resolve them again. The application UIDs are not persisted as they may be
+ * reassigned to other packages while the daemon is not running. The persisted cache is dropped
+ * when the build fingerprint or the package configurations change.
+ *
  * TODO(b/158131194): Extend IUidObserver in WatchdogBinderMediator and use the onUidGone API to
  *  keep the local mapping cache up-to-date.
  */
@@ -121,6 +128,13 @@ public:
     std::unordered_map<uid_t, aidl::android::automotive::watchdog::internal::PackageInfo>
     getPackageInfosForUids(const std::vector<uid_t>& uids);
 
+    /*
+     * Resolves the UIDs of the running processes and refreshes the cached application UIDs with
+     * a single car watchdog service call on the resolver's thread. Must be called when the car
+     * watchdog service connects.
+     */
+    void asyncPrefetchPackageInfos();
+
     virtual void setPackageConfigurations(
             const std::unordered_set<std::string>& vendorPackagePrefixes,
             const std::unordered_map<
@@ -144,18 +158,39 @@ private:
           mWatchdogServiceHelper(nullptr),
           mUidToPackageInfoMapping({}),
           mVendorPackagePrefixes({}),
+          mPackageInfoCacheFilePath(kDefaultPackageInfoCacheFilePath),
+          mIsPackageInfoCacheLoaded(false),
+          mIsPackageInfoCachePersistPending(false),
+          mHasPackageConfigurations(false),
+          mPackageConfigurationsHash(0),
           mShouldTerminateLooper(false),
           mHandlerLooper(android::sp<LooperWrapper>::make()),
           mMessageHandler(android::sp<MessageHandlerImpl>::make(this)) {
         startLooper();
     }
 
-    void updatePackageInfos(const std::vector<uid_t>& uids);
+    /*
+     * Resolves the |uids| missing from the cache. When |shouldRefreshAppUids| is true, resolves
+     * the application UIDs even when they are cached.
+     */
+    void updatePackageInfos(const std::vector<uid_t>& uids, bool shouldRefreshAppUids = false);
 
     void resolvePackageName();
 
+    void prefetchPackageInfos();
+
+    // Loads the persisted cache once the cache file's directory is available.
+    void maybeLoadPackageInfoCacheLocked();
+
+    void schedulePackageInfoCachePersistLocked();
+
+    void persistPackageInfoCache();
+
     void startLooper();
 
+    static constexpr const char kDefaultPackageInfoCacheFilePath[] =
+            "/data/system/car/watchdog/package_info_cache.txt";
+
     // Singleton instance.
     static android::sp<PackageInfoResolver> sInstance;
 
@@ -175,6 +210,12 @@ private:
     std::unordered_map<std::string,
                        aidl::android::automotive::watchdog::internal::ApplicationCategoryType>
             mPackagesToAppCategories GUARDED_BY(mRWMutex);
+    std::string mPackageInfoCacheFilePath GUARDED_BY(mRWMutex);
+    bool mIsPackageInfoCacheLoaded GUARDED_BY(mRWMutex);
+    bool mIsPackageInfoCachePersistPending GUARDED_BY(mRWMutex);
+    bool mHasPackageConfigurations GUARDED_BY(mRWMutex);
+    // Hash of the package configurations used to resolve the cached package infos.
+    uint64_t mPackageConfigurationsHash GUARDED_BY(mRWMutex);
     std::atomic<bool> mShouldTerminateLooper;
     std::thread mHandlerThread;
     android::sp<LooperWrapper> mHandlerLooper;
@@ -188,6 +229,7 @@ private:
 
     // For unit tests.
     static std::function<struct passwd*(uid_t)> sGetpwuidHandler;
+    static std::function<std::unordered_set<uid_t>()> sGetRunningUidsHandler;
 
     friend class internal::PackageInfoResolverPeer;
     FRIEND_TEST(PackageInfoResolverTest, TestResolvesNativeUid);
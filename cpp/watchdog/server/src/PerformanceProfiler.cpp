@@ -23,6 +23,7 @@
 #include <WatchdogProperties.sysprop.h>
 #include <android-base/file.h>
 #include <android-base/stringprintf.h>
+#include <android-base/strings.h>
 #include <android/util/ProtoOutputStream.h>
 #include <log/log.h>
 #include <meminfo/androidprocheaps.h>
@@ -55,6 +56,7 @@ using ::aidl::android::automotive::watchdog::internal::UidIoUsageStats;
 using ::aidl::android::automotive::watchdog::internal::UidResourceUsageStats;
 using ::android::wp;
 using ::android::base::Error;
+using ::android::base::Join;
 using ::android::base::Result;
 using ::android::base::StringAppendF;
 using ::android::base::StringPrintf;
@@ -79,6 +81,9 @@ constexpr const char kUserSwitchEventTitle[] = "\nEvent %zu: From: %d To: %d\n%s
 constexpr const char kCollectionTitle[] =
         "Collection duration: %.f seconds\nMaximum cache size: %zu\nNumber of collections: %zu\n";
 constexpr const char kRecordTitle[] = "\nCollection %zu: <%s>\n%s\n%s";
+constexpr const char kPartialRecordMessage[] =
+        "Partial collection: Per-process stats were collected only for the filtered packages, so "
+        "the per-process totals aren't reported\n";
 constexpr const char kCpuTimeTitle[] = "\nTop N CPU times:\n%s\n";
 constexpr const char kCpuTimeHeader[] = "Android User ID, Package Name, CPU Time (ms), Percentage "
                                         "of total CPU time, CPU Cycles\n\tCommand, CPU Time (ms), "
@@ -106,6 +111,8 @@ constexpr const char kMemStatsTitle[] = "\nTop N memory stats:\n%s\n";
 constexpr const char kMemStatsHeader[] =
         "Android User ID, Package Name, RSS (kb), RSS %%, PSS (kb), PSS %%, USS (kb), Swap PSS (kb)"
         "\n\tCommand, RSS (kb), PSS (kb), USS (kb), Swap PSS (kb)\n";
+constexpr const char kDiskPerformanceTitle[] =
+        "%s\nStorage performance over the last %zu periodic monitor polls:\n%s\n";
 constexpr const char kMemStatsSummary[] = "Total RSS (kb): %" PRIu64 "\n"
                                           "Total PSS (kb): %" PRIu64 "\n";
 
@@ -606,6 +613,40 @@ std::string SystemSummaryStats::toString() const {
     StringAppendF(&buffer, "\tNumber of context switches: %" PRIu64 "\n", contextSwitchesCount);
     StringAppendF(&buffer, "\tNumber of I/O blocked processes/percent: %" PRIu32 " / %.2f%%\n",
                   ioBlockedProcessCount, percentage(ioBlockedProcessCount, totalProcessCount));
+    if (!coreStats.empty()) {
+        StringAppendF(&buffer, "\tPer-core CPU busy/I/O wait/IRQ time (ms)/percent:\n");
+    }
+    for (const auto& core : coreStats) {
+        StringAppendF(&buffer,
+                      "\t\tcpu%" PRId32 ": %" PRId64 " / %.2f%%, %" PRId64 " / %.2f%%, %" PRId64
+                      " / %.2f%%\n",
+                      core.coreId, core.busyTimeMillis,
+                      percentage(core.busyTimeMillis, core.totalTimeMillis),
+                      core.ioWaitTimeMillis,
+                      percentage(core.ioWaitTimeMillis, core.totalTimeMillis),
+                      core.irqTimeMillis, percentage(core.irqTimeMillis, core.totalTimeMillis));
+    }
+    if (!cpuFreqPolicyStats.empty()) {
+        StringAppendF(&buffer, "\tCPU frequency residency (KHz: ms/percent):\n");
+    }
+    for (const auto& policy : cpuFreqPolicyStats) {
+        int64_t policyTimeMillis = 0;
+        for (const auto& [_, timeMillis] : policy.timeMillisByFreqKHz) {
+            policyTimeMillis += timeMillis;
+        }
+        StringAppendF(&buffer, "\t\tpolicy%" PRId32 ":", policy.policyId);
+        for (const auto& [freqKHz, timeMillis] : policy.timeMillisByFreqKHz) {
+            StringAppendF(&buffer, " %" PRIu32 ": %" PRId64 "/%.2f%%", freqKHz, timeMillis,
+                          percentage(timeMillis, policyTimeMillis));
+        }
+        StringAppendF(&buffer, "\n");
+    }
+    if (!diskPerformanceStats.empty()) {
+        StringAppendF(&buffer, "\tStorage performance per device:\n");
+    }
+    for (const auto& stats : diskPerformanceStats) {
+        StringAppendF(&buffer, "\t\t%s\n", stats.toString().c_str());
+    }
     // TODO(b/337115923): Report `totalMajorFaults`, `totalRssKb`, `totalPssKb`, and
     //  `majorFaultsPercentChange` here.
     return buffer;
@@ -613,6 +654,9 @@ std::string SystemSummaryStats::toString() const {
 
 std::string PerfStatsRecord::toString() const {
     std::string buffer;
+    if (isPartial) {
+        StringAppendF(&buffer, "%s", kPartialRecordMessage);
+    }
     StringAppendF(&buffer, "%s\n%s\n%s",
                   pressureLevelDurationMapToString(memoryPressureLevelDurations).c_str(),
                   systemSummaryStats.toString().c_str(),
@@ -703,6 +747,10 @@ void PerformanceProfiler::terminate() {
 
     mCustomCollection.records.clear();
     mCustomCollection = {};
+
+    Mutex::Autolock monitorLock(mMonitorMutex);
+    mDiskStatsAnalyzer.clear();
+    mLastPeriodicMonitorElapsedRealtimeMillis = 0;
 }
 
 Result<void> PerformanceProfiler::onDump(int fd) const {
@@ -735,6 +783,24 @@ Result<void> PerformanceProfiler::onDump(int fd) const {
         !WriteStringToFd(mPeriodicCollection.toString(), fd)) {
         return Error(FAILED_TRANSACTION) << "Failed to dump the periodic collection report.";
     }
+    std::vector<DiskPerformanceStats> windowStats;
+    {
+        Mutex::Autolock monitorLock(mMonitorMutex);
+        windowStats = mDiskStatsAnalyzer.windowStats();
+    }
+    if (!windowStats.empty()) {
+        std::string buffer;
+        for (const auto& stats : windowStats) {
+            StringAppendF(&buffer, "%s\n", stats.toString().c_str());
+        }
+        if (!WriteStringToFd(StringPrintf(kDiskPerformanceTitle, std::string(75, '-').c_str(),
+                                          kDefaultDiskStatsWindowSize,
+                                          std::string(60, '=').c_str()),
+                             fd) ||
+            !WriteStringToFd(buffer, fd)) {
+            return Error(FAILED_TRANSACTION) << "Failed to dump the storage performance report.";
+        }
+    }
     return {};
 }
 
@@ -846,6 +912,9 @@ void PerformanceProfiler::dumpStatsRecordsProto(const CollectionInfo& collection
                        record.userPackageSummaryStats.totalIoStats[FSYNC_COUNT][BACKGROUND]);
         outProto.end(totalStorageIoStatsToken);
 
+        dumpCpuCoreStatsProto(record.systemSummaryStats, outProto);
+        dumpStorageDeviceStatsProto(record.systemSummaryStats.diskPerformanceStats, outProto);
+
         outProto.end(systemWideStatsToken);
 
         dumpPackageCpuStatsProto(record.userPackageSummaryStats.topNCpuTimes, outProto);
@@ -865,6 +934,53 @@ void PerformanceProfiler::dumpStatsRecordsProto(const CollectionInfo& collection
     }
 }
 
+void PerformanceProfiler::dumpCpuCoreStatsProto(const SystemSummaryStats& systemSummaryStats,
+                                                ProtoOutputStream& outProto) const {
+    for (const auto& core : systemSummaryStats.coreStats) {
+        uint64_t cpuCoreStatsToken = outProto.start(SystemWideStats::CPU_CORE_STATS);
+        outProto.write(CpuCoreStats::CORE_ID, core.coreId);
+        outProto.write(CpuCoreStats::BUSY_TIME_MILLIS, core.busyTimeMillis);
+        outProto.write(CpuCoreStats::IO_WAIT_TIME_MILLIS, core.ioWaitTimeMillis);
+        outProto.write(CpuCoreStats::IRQ_TIME_MILLIS, core.irqTimeMillis);
+        outProto.write(CpuCoreStats::TOTAL_TIME_MILLIS, core.totalTimeMillis);
+        outProto.end(cpuCoreStatsToken);
+    }
+    for (const auto& policy : systemSummaryStats.cpuFreqPolicyStats) {
+        uint64_t cpuFreqPolicyStatsToken = outProto.start(SystemWideStats::CPU_FREQ_POLICY_STATS);
+        outProto.write(CpuFreqPolicyStats::POLICY_ID, policy.policyId);
+        for (const auto& [freqKHz, timeMillis] : policy.timeMillisByFreqKHz) {
+            uint64_t freqResidencyToken = outProto.start(CpuFreqPolicyStats::FREQ_RESIDENCIES);
+            outProto.write(CpuFreqPolicyStats::FreqResidency::FREQ_KHZ,
+                           static_cast<int>(freqKHz));
+            outProto.write(CpuFreqPolicyStats::FreqResidency::TIME_MILLIS, timeMillis);
+            outProto.end(freqResidencyToken);
+        }
+        outProto.end(cpuFreqPolicyStatsToken);
+    }
+}
+
+void PerformanceProfiler::dumpStorageDeviceStatsProto(
+        const std::vector<DiskPerformanceStats>& diskPerformanceStats,
+        ProtoOutputStream& outProto) const {
+    for (const auto& stats : diskPerformanceStats) {
+        uint64_t storageDeviceStatsToken = outProto.start(SystemWideStats::STORAGE_DEVICE_STATS);
+        outProto.write(StorageDeviceStats::DEVICE_NAME, stats.deviceName);
+        outProto.write(StorageDeviceStats::READS_COMPLETED,
+                       static_cast<int64_t>(stats.numReadsCompleted));
+        outProto.write(StorageDeviceStats::WRITES_COMPLETED,
+                       static_cast<int64_t>(stats.numWritesCompleted));
+        outProto.write(StorageDeviceStats::FLUSHES_COMPLETED,
+                       static_cast<int64_t>(stats.numFlushCompleted));
+        outProto.write(StorageDeviceStats::AVG_READ_LATENCY_MILLIS, stats.avgReadLatencyMillis);
+        outProto.write(StorageDeviceStats::AVG_WRITE_LATENCY_MILLIS, stats.avgWriteLatencyMillis);
+        outProto.write(StorageDeviceStats::AVG_FLUSH_LATENCY_MILLIS, stats.avgFlushLatencyMillis);
+        outProto.write(StorageDeviceStats::UTILIZATION_PERCENT, stats.utilizationPercent);
+        outProto.write(StorageDeviceStats::AVG_QUEUE_DEPTH, stats.avgQueueDepth);
+        outProto.write(StorageDeviceStats::LATENCY_ALERT_COUNT, stats.latencyAlertCount);
+        outProto.end(storageDeviceStatsToken);
+    }
+}
+
 void PerformanceProfiler::dumpPackageCpuStatsProto(
         const std::vector<UserPackageStats>& topNCpuTimes, ProtoOutputStream& outProto) const {
     for (const auto& userPackageStats : topNCpuTimes) {
@@ -1124,17 +1240,27 @@ Result<void> PerformanceProfiler::processLocked(
     if (collectionInfo->maxCacheSize == 0) {
         return Error() << "Maximum cache size cannot be 0";
     }
+    // Custom collections with filter packages collect the per-process stats only for the
+    // filtered packages, so the per-process totals would cover only those packages.
+    const bool isPartial = !filterPackages.empty();
     PerfStatsRecord record{
             .collectionTimeMillis = time,
+            .isPartial = isPartial,
     };
     if (mIsMemoryProfilingEnabled) {
         record.memoryPressureLevelDurations = mMemoryPressureLevelDeltaInfo.onCollectionLocked();
     }
     bool isGarageModeActive = systemState == SystemState::GARAGE_MODE;
-    bool shouldSendResourceUsageStats = mDoSendResourceUsageStats && (resourceStats != nullptr);
+    // CarService expects the usage stats of all UIDs along with the system-wide totals.
+    bool shouldSendResourceUsageStats =
+            mDoSendResourceUsageStats && (resourceStats != nullptr) && !isPartial;
     std::vector<UidResourceUsageStats>* uidResourceUsageStats =
             shouldSendResourceUsageStats ? new std::vector<UidResourceUsageStats>() : nullptr;
     processProcStatLocked(procStatCollector, &record.systemSummaryStats);
+    {
+        Mutex::Autolock monitorLock(mMonitorMutex);
+        record.systemSummaryStats.diskPerformanceStats = mDiskStatsAnalyzer.onCollection();
+    }
     // The system-wide CPU time should be the same as CPU time aggregated here across all UID, so
     // reuse the total CPU time from SystemSummaryStat
     int64_t totalCpuTimeMillis = record.systemSummaryStats.totalCpuTimeMillis;
@@ -1187,15 +1313,20 @@ void PerformanceProfiler::processUidStatsLocked(
         userPackageSummaryStats->topNMajorFaults.resize(mTopNStatsPerCategory);
         userPackageSummaryStats->topNMemStats.resize(mTopNStatsPerCategory);
     }
+    // The per-UID I/O stats are collected for all UIDs even when the per-process stats are
+    // collected only for the filtered packages.
+    const bool hasAllProcStats = filterPackages.empty();
     int64_t elapsedTimeSinceBootMs = kGetElapsedTimeSinceBootMillisFunc();
     for (const auto& curUidStats : uidStats) {
         // Set the overall stats.
-        userPackageSummaryStats->totalCpuCycles += curUidStats.procStats.cpuCycles;
         addUidIoStats(curUidStats.ioStats.metrics, userPackageSummaryStats->totalIoStats);
-        userPackageSummaryStats->totalMajorFaults += curUidStats.procStats.totalMajorFaults;
-        if (mIsMemoryProfilingEnabled) {
-            userPackageSummaryStats->totalRssKb += curUidStats.procStats.totalRssKb;
-            userPackageSummaryStats->totalPssKb += curUidStats.procStats.totalPssKb;
+        if (hasAllProcStats) {
+            userPackageSummaryStats->totalCpuCycles += curUidStats.procStats.cpuCycles;
+            userPackageSummaryStats->totalMajorFaults += curUidStats.procStats.totalMajorFaults;
+            if (mIsMemoryProfilingEnabled) {
+                userPackageSummaryStats->totalRssKb += curUidStats.procStats.totalRssKb;
+                userPackageSummaryStats->totalPssKb += curUidStats.procStats.totalPssKb;
+            }
         }
 
         // Transform |UidStats| to |UserPackageStats| for each stats view.
@@ -1266,12 +1397,15 @@ void PerformanceProfiler::processUidStatsLocked(
                                                ioWritesStatsView);
         uidResourceUsageStats->push_back(std::move(usageStats));
     }
-    if (mLastMajorFaults != 0) {
-        int64_t increase = userPackageSummaryStats->totalMajorFaults - mLastMajorFaults;
-        userPackageSummaryStats->majorFaultsPercentChange =
-                (static_cast<double>(increase) / static_cast<double>(mLastMajorFaults)) * 100.0;
+    if (hasAllProcStats) {
+        if (mLastMajorFaults != 0) {
+            int64_t increase = userPackageSummaryStats->totalMajorFaults - mLastMajorFaults;
+            userPackageSummaryStats->majorFaultsPercentChange =
+                    (static_cast<double>(increase) / static_cast<double>(mLastMajorFaults)) *
+                    100.0;
+        }
+        mLastMajorFaults = userPackageSummaryStats->totalMajorFaults;
     }
-    mLastMajorFaults = userPackageSummaryStats->totalMajorFaults;
 
     const auto removeEmptyStats = [](std::vector<UserPackageStats>& userPackageStats) {
         for (auto it = userPackageStats.begin(); it != userPackageStats.end(); ++it) {
@@ -1302,6 +1436,67 @@ void PerformanceProfiler::processProcStatLocked(
     systemSummaryStats->contextSwitchesCount = procStatInfo.contextSwitchesCount;
     systemSummaryStats->ioBlockedProcessCount = procStatInfo.ioBlockedProcessCount;
     systemSummaryStats->totalProcessCount = procStatInfo.totalProcessCount();
+    systemSummaryStats->coreStats.clear();
+    for (int32_t coreId = 0; coreId < kMaxCpuCoreCount; ++coreId) {
+        if (!procStatInfo.onlineCores[coreId]) {
+            continue;
+        }
+        const CpuStats& cpuStats = procStatInfo.coreCpuStats[coreId];
+        const int64_t totalTimeMillis = cpuStats.totalTimeMillis();
+        systemSummaryStats->coreStats.push_back(SystemSummaryStats::CoreStats{
+                .coreId = coreId,
+                .busyTimeMillis =
+                        totalTimeMillis - cpuStats.idleTimeMillis - cpuStats.ioWaitTimeMillis,
+                .ioWaitTimeMillis = cpuStats.ioWaitTimeMillis,
+                .irqTimeMillis = cpuStats.irqTimeMillis + cpuStats.softIrqTimeMillis,
+                .totalTimeMillis = totalTimeMillis,
+        });
+    }
+    systemSummaryStats->cpuFreqPolicyStats.clear();
+    for (int32_t i = 0; i < procStatInfo.cpuFreqPolicyCount; ++i) {
+        const auto& policyStats = procStatInfo.cpuFreqPolicyStats[i];
+        SystemSummaryStats::CpuFreqStats policySummary{.policyId = policyStats.policyId};
+        for (int32_t j = 0; j < policyStats.stateCount; ++j) {
+            const auto& residency = policyStats.residencies[j];
+            if (residency.timeMillis > 0) {
+                policySummary.timeMillisByFreqKHz.emplace_back(residency.freqKHz,
+                                                               residency.timeMillis);
+            }
+        }
+        systemSummaryStats->cpuFreqPolicyStats.push_back(std::move(policySummary));
+    }
+}
+
+Result<void> PerformanceProfiler::onPeriodicMonitor(
+        [[maybe_unused]] time_t time,
+        const wp<ProcDiskStatsCollectorInterface>& procDiskStatsCollector,
+        const std::function<void()>& alertHandler) {
+    sp<ProcDiskStatsCollectorInterface> procDiskStatsCollectorSp = procDiskStatsCollector.promote();
+    if (procDiskStatsCollectorSp == nullptr) {
+        return Error() << "Proc disk stats collector must not be null";
+    }
+    Mutex::Autolock lock(mMonitorMutex);
+    const int64_t elapsedRealtimeMillis = kGetElapsedTimeSinceBootMillisFunc();
+    if (mLastPeriodicMonitorElapsedRealtimeMillis == 0) {
+        /*
+         * The first poll reports the disk stats aggregated since the system boot up, which would
+         * skew the latency baseline.
+         */
+        mLastPeriodicMonitorElapsedRealtimeMillis = elapsedRealtimeMillis;
+        return {};
+    }
+    const auto degradedDevices =
+            mDiskStatsAnalyzer.onPoll(procDiskStatsCollectorSp->deltaPhysicalDeviceDiskStats(),
+                                      elapsedRealtimeMillis -
+                                              mLastPeriodicMonitorElapsedRealtimeMillis);
+    mLastPeriodicMonitorElapsedRealtimeMillis = elapsedRealtimeMillis;
+    if (!degradedDevices.empty()) {
+        ALOGW("Storage I/O latency degraded on %s. Requesting a collection",
+              Join(degradedDevices, ", ").c_str());
+        // Capture the system state around the storage stall.
+        alertHandler();
+    }
+    return {};
 }
 
 Result<void> PerformanceProfiler::onUserSwitchCollectionDump(int fd) const {
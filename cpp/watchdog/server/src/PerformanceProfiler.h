@@ -18,6 +18,7 @@
 #define CPP_WATCHDOG_SERVER_SRC_PERFORMANCEPROFILER_H_
 
 #include "PressureMonitor.h"
+#include "DiskStatsAnalyzer.h"
 #include "ProcDiskStatsCollector.h"
 #include "ProcStatCollector.h"
 #include "UidStatsCollector.h"
@@ -187,6 +188,22 @@ struct UserPackageSummaryStats {
 // TODO(b/268402964): Calculate the total CPU cycles using the per-UID BPF tool.
 // System performance stats collected from the `/proc/stats` file.
 struct SystemSummaryStats {
+    // Per-core CPU time breakdown from the `cpu<N>` lines of the `/proc/stats` file.
+    struct CoreStats {
+        int32_t coreId = 0;
+        int64_t busyTimeMillis = 0;
+        int64_t ioWaitTimeMillis = 0;
+        // Time spent servicing both hard and soft interrupts.
+        int64_t irqTimeMillis = 0;
+        int64_t totalTimeMillis = 0;
+    };
+    // Time spent at each frequency by a cpufreq policy. Frequencies with no residency during the
+    // collection are omitted.
+    struct CpuFreqStats {
+        int32_t policyId = 0;
+        std::vector<std::pair<uint32_t, int64_t>> timeMillisByFreqKHz = {};
+    };
+
     int64_t cpuIoWaitTimeMillis = 0;
     int64_t cpuIdleTimeMillis = 0;
     int64_t totalCpuTimeMillis = 0;
@@ -194,6 +211,11 @@ struct SystemSummaryStats {
     uint64_t contextSwitchesCount = 0;
     uint32_t ioBlockedProcessCount = 0;
     uint32_t totalProcessCount = 0;
+    std::vector<CoreStats> coreStats = {};
+    std::vector<CpuFreqStats> cpuFreqPolicyStats = {};
+    // Storage performance of each physical block device during the collection period. Derived
+    // from the periodic monitor polls of the `/proc/diskstats` file.
+    std::vector<DiskPerformanceStats> diskPerformanceStats = {};
     std::string toString() const;
 };
 
@@ -204,6 +226,12 @@ struct PerfStatsRecord {
     UserPackageSummaryStats userPackageSummaryStats;
     std::unordered_map<PressureMonitorInterface::PressureLevel, std::chrono::milliseconds>
             memoryPressureLevelDurations;
+    /**
+     * True when the per-process stats were collected only for the custom collection's filter
+     * packages. The per-process totals, such as the total CPU cycles and major faults, aren't
+     * computed for such records.
+     */
+    bool isPartial = false;
     std::string toString() const;
 };
 
@@ -289,13 +317,9 @@ public:
             aidl::android::automotive::watchdog::internal::ResourceStats* resourceStats) override;
 
     android::base::Result<void> onPeriodicMonitor(
-            [[maybe_unused]] time_t time,
-            [[maybe_unused]] const android::wp<ProcDiskStatsCollectorInterface>&
-                    procDiskStatsCollector,
-            [[maybe_unused]] const std::function<void()>& alertHandler) override {
-        // No monitoring done here as this DataProcessor only collects I/O performance records.
-        return {};
-    }
+            time_t time,
+            const android::wp<ProcDiskStatsCollectorInterface>& procDiskStatsCollector,
+            const std::function<void()>& alertHandler) override;
 
     android::base::Result<void> onDump(int fd) const override;
 
@@ -376,6 +400,12 @@ private:
     void dumpStatsRecordsProto(const CollectionInfo& collection,
                                android::util::ProtoOutputStream& outProto) const;
 
+    void dumpCpuCoreStatsProto(const SystemSummaryStats& systemSummaryStats,
+                               android::util::ProtoOutputStream& outProto) const;
+
+    void dumpStorageDeviceStatsProto(const std::vector<DiskPerformanceStats>& diskPerformanceStats,
+                                     android::util::ProtoOutputStream& outProto) const;
+
     void dumpPackageCpuStatsProto(const std::vector<UserPackageStats>& userPackageStats,
                                   android::util::ProtoOutputStream& outProto) const;
 
@@ -445,6 +475,17 @@ private:
     // Aggregated pressure level changes occurred since the last collection.
     PressureLevelDeltaInfo mMemoryPressureLevelDeltaInfo GUARDED_BY(mMutex);
 
+    // Guards the periodic monitor state. The periodic monitor runs on its own thread and must not
+    // wait on |mMutex|, which is held for the whole of a collection. Acquired after |mMutex| when
+    // both are needed.
+    mutable Mutex mMonitorMutex;
+
+    // Storage performance derived from the periodic monitor polls of the disk stats.
+    DiskStatsAnalyzer mDiskStatsAnalyzer GUARDED_BY(mMonitorMutex);
+
+    // Elapsed realtime of the last periodic monitor poll. Zero until the first poll.
+    int64_t mLastPeriodicMonitorElapsedRealtimeMillis GUARDED_BY(mMonitorMutex) = 0;
+
     friend class WatchdogPerfService;
 
     // For unit tests.
@@ -18,14 +18,14 @@
 
 #include "ProcDiskStatsCollector.h"
 
-#include <android-base/file.h>
-#include <android-base/parseint.h>
 #include <log/log.h>
 
 #include <inttypes.h>
 
 #include <algorithm>
 #include <limits>
+#include <string_view>
+#include <unordered_set>
 
 namespace android {
 namespace automotive {
@@ -33,15 +33,10 @@ namespace watchdog {
 
 using ::android::base::Error;
 using ::android::base::Join;
-using ::android::base::ParseInt;
-using ::android::base::ParseUint;
-using ::android::base::ReadFileToString;
 using ::android::base::Result;
-using ::android::base::Split;
 using ::android::base::StartsWith;
 using ::android::base::StringPrintf;
 using ::android::base::StringReplace;
-using ::android::base::Trim;
 
 namespace {
 
@@ -59,59 +54,62 @@ namespace {
  * values. Duration fields are reported as unsigned int values. The reported values may overflow and
  * the application should deal with it.
  */
-Result<DiskStats> parseDiskStatsLine(const std::string& line) {
-    std::vector<std::string> fields = Split(Trim(line), " ");
-    for (auto it = fields.begin(); it != fields.end();) {
-        if (it->empty() || std::all_of(it->begin(), it->end(), isspace)) {
-            it = fields.erase(it);
-            continue;
-        }
-        ++it;
-    }
+Result<DiskStats> parseDiskStatsLine(std::string_view line,
+                                     std::vector<std::string_view>* fieldsBuffer) {
+    splitFields(line, ' ', fieldsBuffer);
+    std::vector<std::string_view>& fields = *fieldsBuffer;
+    // Fields are padded with spaces, which produces empty fields.
+    fields.erase(std::remove_if(fields.begin(), fields.end(),
+                                [](std::string_view field) {
+                                    return std::all_of(field.begin(), field.end(), isspace);
+                                }),
+                 fields.end());
     uint64_t sectorsRead = 0;
     uint64_t sectorsWritten = 0;
     DiskStats diskStats;
-    if (fields.size() < 14 || !ParseInt(fields[0], &diskStats.major) ||
-        !ParseInt(fields[1], &diskStats.minor) ||
-        !ParseUint(fields[3], &diskStats.numReadsCompleted) ||
-        !ParseUint(fields[4], &diskStats.numReadsMerged) || !ParseUint(fields[5], &sectorsRead) ||
-        !ParseUint(fields[6], &diskStats.readTimeInMillis) ||
-        !ParseUint(fields[7], &diskStats.numWritesCompleted) ||
-        !ParseUint(fields[8], &diskStats.numWritesMerged) ||
-        !ParseUint(fields[9], &sectorsWritten) ||
-        !ParseUint(fields[10], &diskStats.writeTimeInMillis) ||
-        !ParseUint(fields[12], &diskStats.totalIoTimeInMillis) ||
-        !ParseUint(fields[13], &diskStats.weightedTotalIoTimeInMillis)) {
+    if (fields.size() < 14 || !parseIntField(fields[0], &diskStats.major) ||
+        !parseIntField(fields[1], &diskStats.minor) ||
+        !parseIntField(fields[3], &diskStats.numReadsCompleted) ||
+        !parseIntField(fields[4], &diskStats.numReadsMerged) ||
+        !parseIntField(fields[5], &sectorsRead) ||
+        !parseIntField(fields[6], &diskStats.readTimeInMillis) ||
+        !parseIntField(fields[7], &diskStats.numWritesCompleted) ||
+        !parseIntField(fields[8], &diskStats.numWritesMerged) ||
+        !parseIntField(fields[9], &sectorsWritten) ||
+        !parseIntField(fields[10], &diskStats.writeTimeInMillis) ||
+        !parseIntField(fields[12], &diskStats.totalIoTimeInMillis) ||
+        !parseIntField(fields[13], &diskStats.weightedTotalIoTimeInMillis)) {
         return Error() << "Failed to parse from line fields: '" << Join(fields, "', '") << "'";
     }
-    diskStats.deviceName = fields[2];
+    diskStats.deviceName = std::string(fields[2]);
     // Kernel sector size is 512 bytes. Therefore, 2 sectors == 1 KiB.
     diskStats.numKibRead = sectorsRead / 2;
     diskStats.numKibWritten = sectorsWritten / 2;
     if (fields.size() >= 20 &&
-        (!ParseUint(fields[18], &diskStats.numFlushCompleted) ||
-         !ParseUint(fields[19], &diskStats.flushTimeInMillis))) {
+        (!parseIntField(fields[18], &diskStats.numFlushCompleted) ||
+         !parseIntField(fields[19], &diskStats.flushTimeInMillis))) {
         return Error() << "Failed to parse flush stats from line fields: '" << Join(fields, "', '")
                        << "'";
     }
     return diskStats;
 }
 
-Result<ProcDiskStatsCollector::PerPartitionDiskStats> readDiskStatsFile(const std::string& path) {
-    std::string buffer;
-    if (!ReadFileToString(path, &buffer)) {
-        return Error() << "ReadFileToString failed";
+Result<ProcDiskStatsCollector::PerPartitionDiskStats> readDiskStatsFile(
+        ProcFileReader* reader, std::vector<std::string_view>* fields) {
+    const auto contents = reader->read();
+    if (!contents.ok()) {
+        return contents.error();
     }
-    std::vector<std::string> lines = Split(std::move(buffer), "\n");
-    if (lines.empty()) {
+    if (contents->empty()) {
         return Error() << "File is empty";
     }
     ProcDiskStatsCollector::PerPartitionDiskStats perPartitionDiskStats;
-    for (const auto& line : lines) {
+    LineReader lineReader(*contents);
+    for (std::string_view line; lineReader.next(&line);) {
         if (line.empty()) {
             continue;
         }
-        if (auto diskStats = parseDiskStatsLine(line); !diskStats.ok()) {
+        if (auto diskStats = parseDiskStatsLine(line, fields); !diskStats.ok()) {
             return diskStats.error();
         } else if (recordStatsForDevice(diskStats->deviceName)) {
             perPartitionDiskStats.emplace(std::move(*diskStats));
@@ -140,6 +138,43 @@ ProcDiskStatsCollector::PerPartitionDiskStats diffPerPartitionDiskStats(
     return diff;
 }
 
+/*
+ * Returns true when |deviceName| is a partition of another device in |deviceNames|. Partitions
+ * are named after their disk with a numeric suffix, which is prefixed with `p` when the disk name
+ * ends with a digit. E.g., `sda1` of `sda`, `mmcblk0p1` of `mmcblk0` and `nvme0n1p1` of `nvme0n1`.
+ */
+bool isPartition(const std::string& deviceName,
+                 const std::unordered_set<std::string>& deviceNames) {
+    size_t suffixStart = deviceName.find_last_not_of("0123456789");
+    if (suffixStart == std::string::npos || suffixStart + 1 == deviceName.size()) {
+        return false;
+    }
+    if (deviceNames.count(deviceName.substr(0, suffixStart + 1)) != 0) {
+        return true;
+    }
+    return deviceName[suffixStart] == 'p' && suffixStart > 0 &&
+            deviceNames.count(deviceName.substr(0, suffixStart)) != 0;
+}
+
+std::vector<DiskStats> filterPhysicalDeviceDiskStats(
+        const ProcDiskStatsCollector::PerPartitionDiskStats& perPartitionDiskStats) {
+    std::unordered_set<std::string> deviceNames;
+    for (const auto& stats : perPartitionDiskStats) {
+        deviceNames.insert(stats.deviceName);
+    }
+    std::vector<DiskStats> physicalDeviceDiskStats;
+    for (const auto& stats : perPartitionDiskStats) {
+        if (!isVirtualDevice(stats.deviceName) && !isPartition(stats.deviceName, deviceNames)) {
+            physicalDeviceDiskStats.push_back(stats);
+        }
+    }
+    std::sort(physicalDeviceDiskStats.begin(), physicalDeviceDiskStats.end(),
+              [](const DiskStats& lhs, const DiskStats& rhs) {
+                  return lhs.deviceName < rhs.deviceName;
+              });
+    return physicalDeviceDiskStats;
+}
+
 DiskStats aggregateSystemWideDiskStats(
         const ProcDiskStatsCollector::PerPartitionDiskStats&& perPartitionDiskStats) {
     DiskStats systemWideStats;
@@ -208,14 +243,17 @@ Result<void> ProcDiskStatsCollector::collect() {
     }
 
     Mutex::Autolock lock(mMutex);
-    if (auto latestPerPartitionDiskStats = readDiskStatsFile(kPath);
+    if (auto latestPerPartitionDiskStats = readDiskStatsFile(&mReader, &mFields);
         !latestPerPartitionDiskStats.ok()) {
         return Error() << "Failed to read per-partition disk stats from '" << kPath
                        << "': " << latestPerPartitionDiskStats.error();
     } else {
-        mDeltaSystemWideDiskStats = aggregateSystemWideDiskStats(
+        auto deltaPerPartitionDiskStats =
                 diffPerPartitionDiskStats(*latestPerPartitionDiskStats,
-                                          mLatestPerPartitionDiskStats));
+                                          mLatestPerPartitionDiskStats);
+        mDeltaPhysicalDeviceDiskStats = filterPhysicalDeviceDiskStats(deltaPerPartitionDiskStats);
+        mDeltaSystemWideDiskStats =
+                aggregateSystemWideDiskStats(std::move(deltaPerPartitionDiskStats));
         mLatestPerPartitionDiskStats = *latestPerPartitionDiskStats;
     }
     return {};
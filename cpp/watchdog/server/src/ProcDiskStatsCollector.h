@@ -17,6 +17,8 @@
 #ifndef CPP_WATCHDOG_SERVER_SRC_PROCDISKSTATSCOLLECTOR_H_
 #define CPP_WATCHDOG_SERVER_SRC_PROCDISKSTATSCOLLECTOR_H_
 
+#include "ProcFileReader.h"
+
 #include <android-base/result.h>
 #include <android-base/stringprintf.h>
 #include <android-base/strings.h>
@@ -24,6 +26,7 @@
 #include <utils/RefBase.h>
 
 #include <string>
+#include <string_view>
 #include <unordered_set>
 #include <vector>
 
@@ -42,6 +45,16 @@ inline constexpr bool recordStatsForDevice(const std::string& deviceName) {
     return true;
 }
 
+// Returns true when |deviceName| is a virtual block device, which doesn't issue any physical I/O.
+inline constexpr bool isVirtualDevice(const std::string& deviceName) {
+    for (const auto& prefix : {"zram", "ram", "loop", "dm-"}) {
+        if (android::base::StartsWith(deviceName, prefix)) {
+            return true;
+        }
+    }
+    return false;
+}
+
 // Struct that represents the stats from |kUidIoStatsPath|.
 struct DiskStats {
     int major = 0;
@@ -90,6 +103,10 @@ public:
     // Returns the aggregated delta stats since the last before collection.
     virtual DiskStats deltaSystemWideDiskStats() const = 0;
 
+    // Returns the delta stats of each physical block device since the last before collection.
+    // Partitions and virtual devices are excluded.
+    virtual std::vector<DiskStats> deltaPhysicalDeviceDiskStats() const = 0;
+
     // Returns true when the proc diskstats file is accessible. Otherwise, returns false.
     virtual bool enabled() const = 0;
 
@@ -99,7 +116,8 @@ public:
 
 class ProcDiskStatsCollector final : public ProcDiskStatsCollectorInterface {
 public:
-    explicit ProcDiskStatsCollector(const std::string& path = kProcDiskStatsPath) : kPath(path) {}
+    explicit ProcDiskStatsCollector(const std::string& path = kProcDiskStatsPath) :
+          kPath(path), mReader(path) {}
 
     ~ProcDiskStatsCollector() {}
 
@@ -123,6 +141,11 @@ public:
         return mDeltaSystemWideDiskStats;
     }
 
+    std::vector<DiskStats> deltaPhysicalDeviceDiskStats() const {
+        Mutex::Autolock lock(mMutex);
+        return mDeltaPhysicalDeviceDiskStats;
+    }
+
     bool enabled() const {
         Mutex::Autolock lock(mMutex);
         return mEnabled;
@@ -140,9 +163,18 @@ private:
     // True if |kPath| is accessible.
     bool mEnabled GUARDED_BY(mMutex);
 
+    // Reader for the file at |kPath|.
+    ProcFileReader mReader GUARDED_BY(mMutex);
+
+    // Reused across lines and collections to split the lines without allocations.
+    std::vector<std::string_view> mFields GUARDED_BY(mMutex);
+
     // Delta of per-UID I/O usage since last before collection.
     DiskStats mDeltaSystemWideDiskStats GUARDED_BY(mMutex);
 
+    // Delta of per-device I/O usage since last before collection, sorted by device name.
+    std::vector<DiskStats> mDeltaPhysicalDeviceDiskStats GUARDED_BY(mMutex);
+
     /*
      * Latest per-disk stats from the file at |kPath|. Per-disk stats is required for calculating
      * per-disk delta since last collection. Because the stats reported in |kPath| may overflow,
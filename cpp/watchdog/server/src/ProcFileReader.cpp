@@ -0,0 +1,113 @@
+/*
+ * Copyright (c) 2024, The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#define LOG_TAG "carwatchdogd"
+
+#include "ProcFileReader.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <string.h>
+#include <unistd.h>
+
+namespace android {
+namespace automotive {
+namespace watchdog {
+
+using ::android::base::Error;
+using ::android::base::Result;
+
+namespace {
+
+// Most of the fixed procfs files fit in a page, so start with a page-sized buffer.
+constexpr size_t kInitialBufferSize = 4096;
+
+}  // namespace
+
+Result<std::string_view> ProcFileReader::read() {
+    const bool wasOpen = mFd.ok();
+    if (!wasOpen) {
+        mFd.reset(TEMP_FAILURE_RETRY(open(mPath.c_str(), O_RDONLY | O_CLOEXEC)));
+        if (!mFd.ok()) {
+            return Error() << "Failed to open " << mPath << ": " << strerror(errno);
+        }
+        ++mReadStats.openCount;
+    }
+    if (auto contents = readFromOpenFd(); contents.ok() || !wasOpen) {
+        return contents;
+    }
+    // The persistent fd may have gone stale (e.g., the file was recreated), so reopen once.
+    mFd.reset();
+    return read();
+}
+
+Result<std::string_view> ProcFileReader::readFromOpenFd() {
+    if (mBuffer.empty()) {
+        mBuffer.resize(kInitialBufferSize);
+        ++mReadStats.bufferAllocationCount;
+    }
+    size_t totalBytes = 0;
+    while (true) {
+        // Keep one byte for the null terminator.
+        if (totalBytes + 1 >= mBuffer.size()) {
+            mBuffer.resize(mBuffer.size() * 2);
+            ++mReadStats.bufferAllocationCount;
+        }
+        ++mReadStats.readSyscallCount;
+        ssize_t bytesRead = TEMP_FAILURE_RETRY(pread(mFd.get(), mBuffer.data() + totalBytes,
+                                                     mBuffer.size() - totalBytes - 1,
+                                                     static_cast<off_t>(totalBytes)));
+        if (bytesRead < 0) {
+            return Error() << "Failed to read " << mPath << ": " << strerror(errno);
+        }
+        if (bytesRead == 0) {
+            break;
+        }
+        totalBytes += static_cast<size_t>(bytesRead);
+    }
+    mBuffer[totalBytes] = '\0';
+    return std::string_view(mBuffer.data(), totalBytes);
+}
+
+bool LineReader::next(std::string_view* line) {
+    if (mRemaining.empty()) {
+        return false;
+    }
+    if (size_t pos = mRemaining.find('\n'); pos != std::string_view::npos) {
+        *line = mRemaining.substr(0, pos);
+        mRemaining.remove_prefix(pos + 1);
+    } else {
+        *line = mRemaining;
+        mRemaining = {};
+    }
+    return true;
+}
+
+void splitFields(std::string_view line, char delimiter, std::vector<std::string_view>* fields) {
+    fields->clear();
+    while (true) {
+        size_t pos = line.find(delimiter);
+        fields->push_back(line.substr(0, pos));
+        if (pos == std::string_view::npos) {
+            return;
+        }
+        line.remove_prefix(pos + 1);
+    }
+}
+
+}  // namespace watchdog
+}  // namespace automotive
+}  // namespace android
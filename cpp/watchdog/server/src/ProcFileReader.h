@@ -0,0 +1,120 @@
+/*
+ * Copyright (c) 2024, The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef CPP_WATCHDOG_SERVER_SRC_PROCFILEREADER_H_
+#define CPP_WATCHDOG_SERVER_SRC_PROCFILEREADER_H_
+
+#include <android-base/result.h>
+#include <android-base/unique_fd.h>
+
+#include <stdint.h>
+
+#include <charconv>
+#include <string>
+#include <string_view>
+#include <type_traits>
+#include <vector>
+
+namespace android {
+namespace automotive {
+namespace watchdog {
+
+/**
+ * Reads a fixed procfs file that is read on every collection.
+ *
+ * The file is opened once and kept open. Each read restarts from offset 0 with `pread`, which
+ * makes the kernel regenerate the file's contents, into a buffer that is reused across reads and
+ * only grows. So, reading a file whose size doesn't grow costs no allocations and no open/close
+ * syscalls.
+ *
+ * The class isn't thread-safe. The owning collector must serialize the reads.
+ */
+class ProcFileReader final {
+public:
+    // Counters for the work done by the reader since it was created.
+    struct ReadStats {
+        int64_t openCount = 0;
+        int64_t readSyscallCount = 0;
+        int64_t bufferAllocationCount = 0;
+    };
+
+    explicit ProcFileReader(const std::string& path) : mPath(path) {}
+
+    ProcFileReader(ProcFileReader&&) = default;
+    ProcFileReader& operator=(ProcFileReader&&) = default;
+
+    /**
+     * Returns the file's contents. The returned view is null-terminated and remains valid until
+     * the next read.
+     */
+    android::base::Result<std::string_view> read();
+
+    const std::string& path() const { return mPath; }
+
+    const ReadStats& readStats() const { return mReadStats; }
+
+private:
+    android::base::Result<std::string_view> readFromOpenFd();
+
+    std::string mPath;
+
+    android::base::unique_fd mFd;
+
+    // Holds the file's contents followed by a null character.
+    std::vector<char> mBuffer;
+
+    ReadStats mReadStats;
+};
+
+// Iterates over the lines of a file's contents without copying them.
+class LineReader final {
+public:
+    explicit LineReader(std::string_view contents) : mRemaining(contents) {}
+
+    // Sets |line| to the next line, without the newline character. Returns false at the end.
+    bool next(std::string_view* line);
+
+private:
+    std::string_view mRemaining;
+};
+
+/**
+ * Splits |line| on |delimiter| into |fields| without copying them. Like `android::base::Split`,
+ * consecutive delimiters produce empty fields. |fields| is cleared first, so it can be reused
+ * across lines to avoid allocations.
+ */
+void splitFields(std::string_view line, char delimiter, std::vector<std::string_view>* fields);
+
+/**
+ * Parses the whole |field| as a decimal integer. Unlike `android::base::ParseInt`, the field
+ * doesn't need to be null-terminated.
+ */
+template <typename T>
+bool parseIntField(std::string_view field, T* out) {
+    static_assert(std::is_integral_v<T>);
+    if (field.empty()) {
+        return false;
+    }
+    const char* end = field.data() + field.size();
+    const auto [ptr, error] = std::from_chars(field.data(), end, *out);
+    return error == std::errc() && ptr == end;
+}
+
+}  // namespace watchdog
+}  // namespace automotive
+}  // namespace android
+
+#endif  //  CPP_WATCHDOG_SERVER_SRC_PROCFILEREADER_H_
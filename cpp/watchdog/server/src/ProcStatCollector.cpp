@@ -18,12 +18,18 @@
 
 #include "ProcStatCollector.h"
 
-#include <android-base/file.h>
 #include <android-base/parseint.h>
+#include <android-base/stringprintf.h>
 #include <android-base/strings.h>
 #include <log/log.h>
 
+#include <dirent.h>
+#include <inttypes.h>
+#include <string.h>
+
+#include <algorithm>
 #include <string>
+#include <string_view>
 #include <vector>
 
 namespace android {
@@ -32,37 +38,15 @@ namespace watchdog {
 
 using ::android::base::Error;
 using ::android::base::ParseInt;
-using ::android::base::ParseUint;
-using ::android::base::ReadFileToString;
 using ::android::base::Result;
-using ::android::base::Split;
 using ::android::base::StartsWith;
+using ::android::base::StringPrintf;
 
 namespace {
 
-bool parseCpuStats(const std::string& data, int32_t millisPerClockTick, CpuStats* cpuStats) {
-    std::vector<std::string> fields = Split(data, " ");
-    if (fields.size() == 12 && fields[1].empty()) {
-        /* The first cpu line will have an extra space after the first word. This will generate an
-         * empty element when the line is split on " ". Erase the extra element.
-         */
-        fields.erase(fields.begin() + 1);
-    }
-    if (fields.size() != 11 || fields[0] != "cpu" ||
-        !ParseInt(fields[1], &cpuStats->userTimeMillis) ||
-        !ParseInt(fields[2], &cpuStats->niceTimeMillis) ||
-        !ParseInt(fields[3], &cpuStats->sysTimeMillis) ||
-        !ParseInt(fields[4], &cpuStats->idleTimeMillis) ||
-        !ParseInt(fields[5], &cpuStats->ioWaitTimeMillis) ||
-        !ParseInt(fields[6], &cpuStats->irqTimeMillis) ||
-        !ParseInt(fields[7], &cpuStats->softIrqTimeMillis) ||
-        !ParseInt(fields[8], &cpuStats->stealTimeMillis) ||
-        !ParseInt(fields[9], &cpuStats->guestTimeMillis) ||
-        !ParseInt(fields[10], &cpuStats->guestNiceTimeMillis)) {
-        ALOGW("Invalid cpu line: \"%s\"", data.c_str());
-        return false;
-    }
-    // Convert clock ticks to millis
+constexpr const char* kCpuFreqPolicyDirPrefix = "policy";
+
+void convertClockTicksToMillis(int32_t millisPerClockTick, CpuStats* cpuStats) {
     cpuStats->userTimeMillis *= millisPerClockTick;
     cpuStats->niceTimeMillis *= millisPerClockTick;
     cpuStats->sysTimeMillis *= millisPerClockTick;
@@ -73,22 +57,101 @@ bool parseCpuStats(const std::string& data, int32_t millisPerClockTick, CpuStats
     cpuStats->stealTimeMillis *= millisPerClockTick;
     cpuStats->guestTimeMillis *= millisPerClockTick;
     cpuStats->guestNiceTimeMillis *= millisPerClockTick;
+}
+
+bool parseCpuTimeFields(const std::vector<std::string_view>& fields, size_t offset,
+                        CpuStats* cpuStats) {
+    return parseIntField(fields[offset], &cpuStats->userTimeMillis) &&
+            parseIntField(fields[offset + 1], &cpuStats->niceTimeMillis) &&
+            parseIntField(fields[offset + 2], &cpuStats->sysTimeMillis) &&
+            parseIntField(fields[offset + 3], &cpuStats->idleTimeMillis) &&
+            parseIntField(fields[offset + 4], &cpuStats->ioWaitTimeMillis) &&
+            parseIntField(fields[offset + 5], &cpuStats->irqTimeMillis) &&
+            parseIntField(fields[offset + 6], &cpuStats->softIrqTimeMillis) &&
+            parseIntField(fields[offset + 7], &cpuStats->stealTimeMillis) &&
+            parseIntField(fields[offset + 8], &cpuStats->guestTimeMillis) &&
+            parseIntField(fields[offset + 9], &cpuStats->guestNiceTimeMillis);
+}
+
+bool parseCpuStats(std::string_view data, int32_t millisPerClockTick,
+                   std::vector<std::string_view>* fields, CpuStats* cpuStats) {
+    splitFields(data, ' ', fields);
+    if (fields->size() == 12 && (*fields)[1].empty()) {
+        /* The first cpu line will have an extra space after the first word. This will generate an
+         * empty element when the line is split on " ". Erase the extra element.
+         */
+        fields->erase(fields->begin() + 1);
+    }
+    if (fields->size() != 11 || (*fields)[0] != "cpu" ||
+        !parseCpuTimeFields(*fields, /*offset=*/1, cpuStats)) {
+        ALOGW("Invalid cpu line: \"%.*s\"", static_cast<int>(data.size()), data.data());
+        return false;
+    }
+    // Convert clock ticks to millis
+    convertClockTicksToMillis(millisPerClockTick, cpuStats);
     return true;
 }
 
-bool parseContextSwitches(const std::string& data, uint64_t* out) {
-    std::vector<std::string> fields = Split(data, " ");
-    if (fields.size() != 2 || !StartsWith(fields[0], "ctxt") || !ParseUint(fields[1], out)) {
-        ALOGW("Invalid ctxt line: \"%s\"", data.c_str());
+// Parses a per-core `cpu<N>` line. There is one such line per online core.
+bool parseCoreCpuStats(std::string_view data, int32_t millisPerClockTick,
+                       std::vector<std::string_view>* fields, int32_t* coreId,
+                       CpuStats* cpuStats) {
+    splitFields(data, ' ', fields);
+    if (fields->size() != 11 || !StartsWith((*fields)[0], "cpu") ||
+        !parseIntField((*fields)[0].substr(3), coreId) || *coreId < 0 ||
+        !parseCpuTimeFields(*fields, /*offset=*/1, cpuStats)) {
+        ALOGW("Invalid cpu core line: \"%.*s\"", static_cast<int>(data.size()), data.data());
+        return false;
+    }
+    convertClockTicksToMillis(millisPerClockTick, cpuStats);
+    return true;
+}
+
+/*
+ * Parses the contents of a cpufreq `time_in_state` file. Each line has the frequency in KHz and the
+ * time spent at that frequency in clock ticks.
+ */
+bool parseTimeInState(std::string_view data, int32_t millisPerClockTick,
+                      std::vector<std::string_view>* fields, CpuFreqTimeInState* policyStats) {
+    policyStats->stateCount = 0;
+    LineReader lineReader(data);
+    for (std::string_view line; lineReader.next(&line);) {
+        if (line.empty()) {
+            continue;
+        }
+        splitFields(line, ' ', fields);
+        uint32_t freqKHz = 0;
+        int64_t ticks = 0;
+        if (fields->size() < 2 || !parseIntField((*fields)[0], &freqKHz) ||
+            !parseIntField((*fields)[1], &ticks)) {
+            return false;
+        }
+        if (policyStats->stateCount < kMaxCpuFreqStateCount) {
+            auto& residency = policyStats->residencies[policyStats->stateCount++];
+            residency.freqKHz = freqKHz;
+            residency.timeMillis = ticks * millisPerClockTick;
+        }
+    }
+    return policyStats->stateCount > 0;
+}
+
+bool parseContextSwitches(std::string_view data, std::vector<std::string_view>* fields,
+                          uint64_t* out) {
+    splitFields(data, ' ', fields);
+    if (fields->size() != 2 || !StartsWith((*fields)[0], "ctxt") ||
+        !parseIntField((*fields)[1], out)) {
+        ALOGW("Invalid ctxt line: \"%.*s\"", static_cast<int>(data.size()), data.data());
         return false;
     }
     return true;
 }
 
-bool parseProcsCount(const std::string& data, uint32_t* out) {
-    std::vector<std::string> fields = Split(data, " ");
-    if (fields.size() != 2 || !StartsWith(fields[0], "procs_") || !ParseUint(fields[1], out)) {
-        ALOGW("Invalid procs_ line: \"%s\"", data.c_str());
+bool parseProcsCount(std::string_view data, std::vector<std::string_view>* fields,
+                     uint32_t* out) {
+    splitFields(data, ' ', fields);
+    if (fields->size() != 2 || !StartsWith((*fields)[0], "procs_") ||
+        !parseIntField((*fields)[1], out)) {
+        ALOGW("Invalid procs_ line: \"%.*s\"", static_cast<int>(data.size()), data.data());
         return false;
     }
     return true;
@@ -114,63 +177,133 @@ Result<void> ProcStatCollector::collect() {
     return {};
 }
 
-Result<ProcStatInfo> ProcStatCollector::getProcStatLocked() const {
-    std::string buffer;
-    if (!ReadFileToString(kPath, &buffer)) {
-        return Error() << "ReadFileToString failed for " << kPath;
+void ProcStatCollector::initCpuFreqPoliciesLocked() {
+    mCpuFreqTimeInStateReaders.clear();
+    DIR* dir = opendir(kCpuFreqPath.c_str());
+    if (dir == nullptr) {
+        ALOGW("Failed to open %s. Per-policy CPU frequency residency will not be collected",
+              kCpuFreqPath.c_str());
+        return;
+    }
+    while (const dirent* entry = readdir(dir)) {
+        int32_t policyId = -1;
+        if (!StartsWith(entry->d_name, kCpuFreqPolicyDirPrefix) ||
+            !ParseInt(entry->d_name + strlen(kCpuFreqPolicyDirPrefix), &policyId)) {
+            continue;
+        }
+        std::string path = StringPrintf("%s/%s/%s", kCpuFreqPath.c_str(), entry->d_name,
+                                        kTimeInStateFilePath);
+        if (access(path.c_str(), R_OK) != 0) {
+            continue;
+        }
+        mCpuFreqTimeInStateReaders.emplace_back(policyId, ProcFileReader(path));
+    }
+    closedir(dir);
+    std::sort(mCpuFreqTimeInStateReaders.begin(), mCpuFreqTimeInStateReaders.end(),
+              [](const auto& lhs, const auto& rhs) { return lhs.first < rhs.first; });
+    if (mCpuFreqTimeInStateReaders.size() > static_cast<size_t>(kMaxCpuFreqPolicyCount)) {
+        ALOGW("Found %zu cpufreq policies. Only the first %d policies will be collected",
+              mCpuFreqTimeInStateReaders.size(), kMaxCpuFreqPolicyCount);
+        mCpuFreqTimeInStateReaders.erase(mCpuFreqTimeInStateReaders.begin() +
+                                                 kMaxCpuFreqPolicyCount,
+                                         mCpuFreqTimeInStateReaders.end());
+    }
+}
+
+Result<void> ProcStatCollector::getCpuFreqStatsLocked(ProcStatInfo* info) {
+    info->cpuFreqPolicyCount = 0;
+    for (auto& [policyId, reader] : mCpuFreqTimeInStateReaders) {
+        const auto contents = reader.read();
+        if (!contents.ok()) {
+            return contents.error();
+        }
+        auto& policyStats = info->cpuFreqPolicyStats[info->cpuFreqPolicyCount];
+        policyStats.policyId = policyId;
+        if (!parseTimeInState(*contents, mMillisPerClockTick, &mFields, &policyStats)) {
+            return Error() << "Failed to parse " << reader.path();
+        }
+        ++info->cpuFreqPolicyCount;
+    }
+    return {};
+}
+
+Result<ProcStatInfo> ProcStatCollector::getProcStatLocked() {
+    const auto contents = mProcStatReader.read();
+    if (!contents.ok()) {
+        return contents.error();
     }
 
-    std::vector<std::string> lines = Split(std::move(buffer), "\n");
     ProcStatInfo info;
     bool didReadContextSwitches = false;
     bool didReadProcsRunning = false;
     bool didReadProcsBlocked = false;
-    for (size_t i = 0; i < lines.size(); i++) {
-        if (lines[i].empty()) {
+    LineReader lineReader(*contents);
+    for (std::string_view line; lineReader.next(&line);) {
+        if (line.empty()) {
             continue;
         }
-        if (!lines[i].compare(0, 4, "cpu ")) {
+        if (StartsWith(line, "cpu ")) {
             if (info.totalCpuTimeMillis() != 0) {
                 return Error() << "Duplicate `cpu .*` line in " << kPath;
             }
-            if (!parseCpuStats(lines[i], mMillisPerClockTick, &info.cpuStats)) {
+            if (!parseCpuStats(line, mMillisPerClockTick, &mFields, &info.cpuStats)) {
                 return Error() << "Failed to parse `cpu .*` line in " << kPath;
             }
-        } else if (!lines[i].compare(0, 4, "ctxt")) {
+        } else if (StartsWith(line, "cpu")) {
+            int32_t coreId = -1;
+            CpuStats coreCpuStats;
+            if (!parseCoreCpuStats(line, mMillisPerClockTick, &mFields, &coreId,
+                                   &coreCpuStats)) {
+                return Error() << "Failed to parse `cpu<N> .*` line in " << kPath;
+            }
+            if (coreId >= kMaxCpuCoreCount) {
+                continue;
+            }
+            if (info.onlineCores[coreId]) {
+                return Error() << "Duplicate `cpu" << coreId << " .*` line in " << kPath;
+            }
+            info.onlineCores.set(coreId);
+            info.coreCpuStats[coreId] = coreCpuStats;
+        } else if (StartsWith(line, "ctxt")) {
             if (didReadContextSwitches) {
                 return Error() << "Duplicate `ctxt .*` line in " << kPath;
             }
-            if (!parseContextSwitches(std::move(lines[i]), &info.contextSwitchesCount)) {
+            if (!parseContextSwitches(line, &mFields, &info.contextSwitchesCount)) {
                 return Error() << "Failed to parse `ctxt .*` line in " << kPath;
             }
             didReadContextSwitches = true;
-        } else if (!lines[i].compare(0, 6, "procs_")) {
-            if (!lines[i].compare(0, 13, "procs_running")) {
+        } else if (StartsWith(line, "procs_")) {
+            if (StartsWith(line, "procs_running")) {
                 if (didReadProcsRunning) {
                     return Error() << "Duplicate `procs_running .*` line in " << kPath;
                 }
-                if (!parseProcsCount(std::move(lines[i]), &info.runnableProcessCount)) {
+                if (!parseProcsCount(line, &mFields, &info.runnableProcessCount)) {
                     return Error() << "Failed to parse `procs_running .*` line in " << kPath;
                 }
                 didReadProcsRunning = true;
                 continue;
-            } else if (!lines[i].compare(0, 13, "procs_blocked")) {
+            } else if (StartsWith(line, "procs_blocked")) {
                 if (didReadProcsBlocked) {
                     return Error() << "Duplicate `procs_blocked .*` line in " << kPath;
                 }
-                if (!parseProcsCount(std::move(lines[i]), &info.ioBlockedProcessCount)) {
+                if (!parseProcsCount(line, &mFields, &info.ioBlockedProcessCount)) {
                     return Error() << "Failed to parse `procs_blocked .*` line in " << kPath;
                 }
                 didReadProcsBlocked = true;
                 continue;
             }
-            return Error() << "Unknown procs_ line `" << lines[i] << "` in " << kPath;
+            return Error() << "Unknown procs_ line `" << line << "` in " << kPath;
         }
     }
     if (info.totalCpuTimeMillis() == 0 || !didReadContextSwitches || !didReadProcsRunning ||
         !didReadProcsBlocked) {
         return Error() << kPath << " is incomplete";
     }
+    if (const auto result = getCpuFreqStatsLocked(&info); !result.ok()) {
+        // CPU frequency residency is supplementary, so don't fail the collection.
+        ALOGW("Failed to collect CPU frequency residency: %s", result.error().message().c_str());
+        info.cpuFreqPolicyCount = 0;
+    }
     return info;
 }
 
@@ -17,17 +17,35 @@
 #ifndef CPP_WATCHDOG_SERVER_SRC_PROCSTATCOLLECTOR_H_
 #define CPP_WATCHDOG_SERVER_SRC_PROCSTATCOLLECTOR_H_
 
+#include "ProcFileReader.h"
+
 #include <android-base/result.h>
 #include <utils/Mutex.h>
 #include <utils/RefBase.h>
 
 #include <stdint.h>
 
+#include <array>
+#include <bitset>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+
 namespace android {
 namespace automotive {
 namespace watchdog {
 
 constexpr const char* kProcStatPath = "/proc/stat";
+constexpr const char* kCpuFreqPolicyDirPath = "/sys/devices/system/cpu/cpufreq";
+constexpr const char* kTimeInStateFilePath = "stats/time_in_state";
+
+// Upper bounds on the per-core and per-cpufreq-policy stats kept in |ProcStatInfo|. These keep the
+// stats in fixed-size storage so a collection doesn't allocate. Cores, policies and frequency
+// states beyond these bounds are not reported.
+constexpr int32_t kMaxCpuCoreCount = 32;
+constexpr int32_t kMaxCpuFreqPolicyCount = 8;
+constexpr int32_t kMaxCpuFreqStateCount = 32;
 
 struct CpuStats {
     int64_t userTimeMillis = 0;    // Time spent in user mode.
@@ -41,6 +59,12 @@ struct CpuStats {
     int64_t guestTimeMillis = 0;      // Time spent running a virtual CPU for guest OS.
     int64_t guestNiceTimeMillis = 0;  // Time spent running a niced virtual CPU for guest OS.
 
+    int64_t totalTimeMillis() const {
+        return userTimeMillis + niceTimeMillis + sysTimeMillis + idleTimeMillis + ioWaitTimeMillis +
+                irqTimeMillis + softIrqTimeMillis + stealTimeMillis + guestTimeMillis +
+                guestNiceTimeMillis;
+    }
+
     CpuStats& operator-=(const CpuStats& rhs) {
         userTimeMillis -= rhs.userTimeMillis;
         niceTimeMillis -= rhs.niceTimeMillis;
@@ -56,6 +80,33 @@ struct CpuStats {
     }
 };
 
+// Time spent at each CPU frequency by the cores of a single cpufreq policy. Read from the
+// `/sys/devices/system/cpu/cpufreq/policy<N>/stats/time_in_state` file.
+struct CpuFreqTimeInState {
+    struct FreqResidency {
+        uint32_t freqKHz = 0;
+        int64_t timeMillis = 0;
+    };
+
+    int32_t policyId = -1;
+    int32_t stateCount = 0;
+    std::array<FreqResidency, kMaxCpuFreqStateCount> residencies = {};
+
+    // Zeroes the residency of the states that have no matching state in |rhs|, as their time is
+    // accumulated since boot rather than since |rhs| was read.
+    CpuFreqTimeInState& operator-=(const CpuFreqTimeInState& rhs) {
+        for (int32_t i = 0; i < stateCount; ++i) {
+            if (policyId == rhs.policyId && i < rhs.stateCount &&
+                residencies[i].freqKHz == rhs.residencies[i].freqKHz) {
+                residencies[i].timeMillis -= rhs.residencies[i].timeMillis;
+            } else {
+                residencies[i].timeMillis = 0;
+            }
+        }
+        return *this;
+    }
+};
+
 class ProcStatInfo {
 public:
     ProcStatInfo() :
@@ -73,13 +124,16 @@ public:
     uint64_t contextSwitchesCount;
     uint32_t runnableProcessCount;
     uint32_t ioBlockedProcessCount;
-
-    int64_t totalCpuTimeMillis() const {
-        return cpuStats.userTimeMillis + cpuStats.niceTimeMillis + cpuStats.sysTimeMillis +
-                cpuStats.idleTimeMillis + cpuStats.ioWaitTimeMillis + cpuStats.irqTimeMillis +
-                cpuStats.softIrqTimeMillis + cpuStats.stealTimeMillis + cpuStats.guestTimeMillis +
-                cpuStats.guestNiceTimeMillis;
-    }
+    // Per-core stats from the `cpu<N>` lines, indexed by the core id. Offline cores are not
+    // listed in `/proc/stat` and have their bit cleared in |onlineCores|.
+    std::bitset<kMaxCpuCoreCount> onlineCores = {};
+    std::array<CpuStats, kMaxCpuCoreCount> coreCpuStats = {};
+    // Frequency residency per cpufreq policy. Only the first |cpuFreqPolicyCount| entries are
+    // valid.
+    int32_t cpuFreqPolicyCount = 0;
+    std::array<CpuFreqTimeInState, kMaxCpuFreqPolicyCount> cpuFreqPolicyStats = {};
+
+    int64_t totalCpuTimeMillis() const { return cpuStats.totalTimeMillis(); }
     uint32_t totalProcessCount() const { return runnableProcessCount + ioBlockedProcessCount; }
     bool operator==(const ProcStatInfo& info) const {
         return memcmp(&cpuStats, &info.cpuStats, sizeof(cpuStats)) == 0 &&
@@ -88,6 +142,29 @@ public:
     }
     ProcStatInfo& operator-=(const ProcStatInfo& rhs) {
         cpuStats -= rhs.cpuStats;
+        for (int32_t i = 0; i < kMaxCpuCoreCount; ++i) {
+            // A core that came online since the last collection reports its time since boot, so
+            // it has no delta until the next collection.
+            if (!onlineCores[i]) {
+                continue;
+            }
+            if (rhs.onlineCores[i]) {
+                coreCpuStats[i] -= rhs.coreCpuStats[i];
+            } else {
+                coreCpuStats[i] = {};
+            }
+        }
+        for (int32_t i = 0; i < cpuFreqPolicyCount; ++i) {
+            // Policies are matched by id, as a failed read in the last collection drops them all.
+            // A policy without a previous sample is diffed against an empty one, which zeroes it.
+            const CpuFreqTimeInState* previous = nullptr;
+            for (int32_t j = 0; j < rhs.cpuFreqPolicyCount && previous == nullptr; ++j) {
+                if (rhs.cpuFreqPolicyStats[j].policyId == cpuFreqPolicyStats[i].policyId) {
+                    previous = &rhs.cpuFreqPolicyStats[j];
+                }
+            }
+            cpuFreqPolicyStats[i] -= previous != nullptr ? *previous : CpuFreqTimeInState{};
+        }
         /* Don't diff *ProcessCount as they are real-time values unlike |cpuStats|, which are
          * aggregated values since system startup.
          */
@@ -120,8 +197,13 @@ public:
 // Collector/parser for `/proc/stat` file.
 class ProcStatCollector final : public ProcStatCollectorInterface {
 public:
-    explicit ProcStatCollector(const std::string& path = kProcStatPath) :
-          kPath(path), mMillisPerClockTick(1000 / sysconf(_SC_CLK_TCK)), mLatestStats({}) {}
+    explicit ProcStatCollector(const std::string& path = kProcStatPath,
+                               const std::string& cpuFreqPolicyDirPath = kCpuFreqPolicyDirPath) :
+          kPath(path),
+          kCpuFreqPath(cpuFreqPolicyDirPath),
+          mMillisPerClockTick(1000 / sysconf(_SC_CLK_TCK)),
+          mProcStatReader(path),
+          mLatestStats({}) {}
 
     ~ProcStatCollector() {}
 
@@ -131,6 +213,7 @@ public:
         // dependent classes would call the constructor before mocking and get killed due to
         // sepolicy violation.
         mEnabled = access(kPath.c_str(), R_OK) == 0;
+        initCpuFreqPoliciesLocked();
     }
 
     android::base::Result<void> collect();
@@ -154,11 +237,20 @@ public:
 
 private:
     // Reads the contents of |kPath|.
-    android::base::Result<ProcStatInfo> getProcStatLocked() const;
+    android::base::Result<ProcStatInfo> getProcStatLocked();
+
+    // Finds the readable time_in_state files under |kCpuFreqPath|.
+    void initCpuFreqPoliciesLocked();
+
+    // Reads the time_in_state files found by |initCpuFreqPoliciesLocked|.
+    android::base::Result<void> getCpuFreqStatsLocked(ProcStatInfo* info);
 
     // Path to proc stat file. Default path is |kProcStatPath|.
     const std::string kPath;
 
+    // Path to the cpufreq policy directory. Default path is |kCpuFreqPolicyDirPath|.
+    const std::string kCpuFreqPath;
+
     // Number of milliseconds per clock cycle.
     int32_t mMillisPerClockTick;
 
@@ -168,6 +260,15 @@ private:
     // True if |kPath| is accessible.
     bool mEnabled GUARDED_BY(mMutex);
 
+    // Reader for the file at |kPath|.
+    ProcFileReader mProcStatReader GUARDED_BY(mMutex);
+
+    // Policy id and time_in_state file reader of each cpufreq policy, sorted by policy id.
+    std::vector<std::pair<int32_t, ProcFileReader>> mCpuFreqTimeInStateReaders GUARDED_BY(mMutex);
+
+    // Reused across lines and collections to split the lines without allocations.
+    std::vector<std::string_view> mFields GUARDED_BY(mMutex);
+
     // Latest dump of CPU stats from the file at |kPath|.
     ProcStatInfo mLatestStats GUARDED_BY(mMutex);
 
@@ -0,0 +1,455 @@
+/*
+ * Copyright (c) 2024, The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#define LOG_TAG "carwatchdogd"
+
+#include "ProcessSnapshotter.h"
+
+#include <android-base/file.h>
+#include <android-base/parseint.h>
+#include <android-base/stringprintf.h>
+#include <android-base/strings.h>
+#include <android-base/unique_fd.h>
+#include <debuggerd/client.h>
+#include <log/log.h>
+#include <utils/SystemClock.h>
+
+#include <dirent.h>
+#include <errno.h>
+#include <inttypes.h>
+#include <pthread.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <memory>
+
+namespace android {
+namespace automotive {
+namespace watchdog {
+
+using ::aidl::android::automotive::watchdog::internal::ProcessIdentifier;
+using ::android::base::ParseInt;
+using ::android::base::ReadFileToString;
+using ::android::base::StringAppendF;
+using ::android::base::StringPrintf;
+using ::android::base::Trim;
+using ::android::base::unique_fd;
+using ::android::base::WriteStringToFd;
+
+namespace {
+
+constexpr const char kCaptureThreadName[] = "WdProcSnapshot";
+constexpr const char kReportThreadName[] = "WdSnapshotRprt";
+constexpr const char kPidStatPathFormat[] = "%s/%d/stat";
+constexpr const char kPidWchanPathFormat[] = "%s/%d/wchan";
+constexpr const char kPidTaskDirPathFormat[] = "%s/%d/task";
+constexpr const char kTidStatPathFormat[] = "%s/%d/task/%d/stat";
+constexpr const char kTidWchanPathFormat[] = "%s/%d/task/%d/wchan";
+
+int64_t millisSince(std::chrono::steady_clock::time_point start) {
+    return std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() -
+                                                                 start)
+            .count();
+}
+
+/*
+ * Parses the comm and state from a `/proc/<pid>/stat` line. The comm is enclosed with ( ) and may
+ * contain spaces or brackets, so it extends until the last closing bracket.
+ * Example line: 1 (init) S 0 0 0 0 0 0 0 0 220 0 0 0 0 0 0 0 2 0 0 ...etc...
+ */
+bool parseStatLine(const std::string& line, std::string* comm, char* state) {
+    const size_t commStart = line.find('(');
+    const size_t commEnd = line.rfind(')');
+    if (commStart == std::string::npos || commEnd == std::string::npos || commEnd < commStart ||
+        commEnd + 2 >= line.size()) {
+        return false;
+    }
+    *comm = line.substr(commStart + 1, commEnd - commStart - 1);
+    *state = line[commEnd + 2];
+    return true;
+}
+
+std::string readWchan(const std::string& path) {
+    std::string wchan;
+    if (!ReadFileToString(path, &wchan)) {
+        return "";
+    }
+    wchan = Trim(wchan);
+    // The kernel reports "0" when the task is not blocked.
+    return wchan == "0" ? "" : wchan;
+}
+
+std::string dumpNativeStacks(pid_t pid) {
+    unique_fd fd(memfd_create("carwatchdog_stacks", MFD_CLOEXEC));
+    if (fd.get() == -1) {
+        return StringPrintf("Failed to create memfd: %s", strerror(errno));
+    }
+    if (!dump_backtrace_to_file_timeout(pid, kDebuggerdNativeBacktrace,
+                                        kNativeStackDumpTimeoutSecs, fd.get())) {
+        return "Failed to dump native stacks with debuggerd";
+    }
+    if (lseek(fd.get(), 0, SEEK_SET) == -1) {
+        return StringPrintf("Failed to seek memfd: %s", strerror(errno));
+    }
+    std::string stacks(kMaxNativeStacksBytes, '\0');
+    ssize_t totalBytes = 0;
+    while (static_cast<size_t>(totalBytes) < stacks.size()) {
+        ssize_t bytes = TEMP_FAILURE_RETRY(
+                read(fd.get(), stacks.data() + totalBytes, stacks.size() - totalBytes));
+        if (bytes <= 0) {
+            break;
+        }
+        totalBytes += bytes;
+    }
+    stacks.resize(totalBytes);
+    return stacks;
+}
+
+}  // namespace
+
+std::string ProcessSnapshot::toString() const {
+    std::string buffer = StringPrintf("PID: %d, Start time millis: %" PRIi64
+                                      ", Comm: %s, State: %c, Wchan: %s\n",
+                                      pid, startTimeMillis, comm.c_str(), state,
+                                      wchan.empty() ? "-" : wchan.c_str());
+    buffer += "\tDetection to capture: ";
+    if (detectionToCaptureMillis.has_value()) {
+        StringAppendF(&buffer, "%" PRIi64 " ms", *detectionToCaptureMillis);
+    } else {
+        buffer += "not captured";
+    }
+    StringAppendF(&buffer, ", Capture duration: %" PRIi64 " ms, Detection to kill: ",
+                  captureDurationMillis);
+    if (detectionToKillMillis.has_value()) {
+        StringAppendF(&buffer, "%" PRIi64 " ms\n", *detectionToKillMillis);
+    } else {
+        buffer += "not reported\n";
+    }
+    if (!error.empty()) {
+        StringAppendF(&buffer, "\tError: %s\n", error.c_str());
+    }
+    if (!statLine.empty()) {
+        StringAppendF(&buffer, "\tStat: %s\n", statLine.c_str());
+    }
+    for (const auto& thread : threads) {
+        StringAppendF(&buffer, "\tTID: %d, Name: %s, State: %c, Wchan: %s\n", thread.tid,
+                      thread.name.c_str(), thread.state,
+                      thread.wchan.empty() ? "-" : thread.wchan.c_str());
+    }
+    if (!nativeStacks.empty()) {
+        StringAppendF(&buffer, "\tNative stacks:\n%s\n", nativeStacks.c_str());
+    }
+    return buffer;
+}
+
+void ProcessSnapshotter::captureSnapshots(const std::vector<ProcessIdentifier>& processIdentifiers,
+                                          int64_t detectionTimeMillis,
+                                          std::function<void()> onCaptured) {
+    size_t queuedCount = 0;
+    {
+        std::lock_guard<std::mutex> lock(mMutex);
+        const uint64_t batchId = mNextBatchId++;
+        size_t droppedCount = 0;
+        for (const auto& processIdentifier : processIdentifiers) {
+            if (mIsTerminated) {
+                break;
+            }
+            ProcessSnapshot snapshot;
+            snapshot.pid = processIdentifier.pid;
+            snapshot.startTimeMillis = processIdentifier.startTimeMillis;
+            snapshot.detectionTimeMillis = detectionTimeMillis;
+            const uint64_t id = mNextSnapshotId++;
+            if (mPending.size() >= kMaxPendingSnapshots) {
+                snapshot.error = "Dropped because too many processes are waiting to be captured";
+                ++droppedCount;
+            } else {
+                snapshot.error = "Capture pending";
+                mPending.push_back({id, batchId, processIdentifier.pid, detectionTimeMillis});
+                ++queuedCount;
+            }
+            addSnapshotLocked(id, std::move(snapshot));
+        }
+        if (droppedCount > 0) {
+            ALOGW("Dropped snapshots of %zu unresponsive processes because %zu are already pending",
+                  droppedCount, kMaxPendingSnapshots);
+        }
+        if (queuedCount > 0) {
+            mBatches.push_back({batchId, queuedCount,
+                                std::chrono::steady_clock::now() + kCaptureDeadline,
+                                std::move(onCaptured)});
+            startThreadsLocked();
+            mPendingCv.notify_all();
+            mBatchCv.notify_one();
+        }
+    }
+    if (queuedCount == 0 && onCaptured != nullptr) {
+        onCaptured();
+    }
+}
+
+void ProcessSnapshotter::onProcessKilled(const ProcessIdentifier& processIdentifier,
+                                         int64_t killTimeMillis) {
+    std::lock_guard<std::mutex> lock(mMutex);
+    for (auto it = mSnapshots.rbegin(); it != mSnapshots.rend(); ++it) {
+        ProcessSnapshot& snapshot = it->snapshot;
+        if (snapshot.pid != processIdentifier.pid ||
+            snapshot.startTimeMillis != processIdentifier.startTimeMillis ||
+            snapshot.detectionToKillMillis.has_value()) {
+            continue;
+        }
+        snapshot.detectionToKillMillis = killTimeMillis - snapshot.detectionTimeMillis;
+        ALOGI("Process(pid: %d) was killed %" PRIi64 " ms after it was detected as not responding",
+              snapshot.pid, *snapshot.detectionToKillMillis);
+        return;
+    }
+}
+
+bool ProcessSnapshotter::waitForPendingSnapshots(std::chrono::milliseconds timeout) {
+    std::unique_lock<std::mutex> lock(mMutex);
+    return mIdleCv.wait_for(lock, timeout, [this]() REQUIRES(mMutex) {
+        return mIsTerminated || (mPending.empty() && mCapturingCount == 0);
+    });
+}
+
+std::vector<ProcessSnapshot> ProcessSnapshotter::getSnapshots() const {
+    std::lock_guard<std::mutex> lock(mMutex);
+    std::vector<ProcessSnapshot> snapshots;
+    for (const auto& entry : mSnapshots) {
+        snapshots.push_back(entry.snapshot);
+    }
+    return snapshots;
+}
+
+void ProcessSnapshotter::onDump(int fd) const {
+    std::lock_guard<std::mutex> lock(mMutex);
+    std::string buffer = StringPrintf("  Unresponsive process snapshots (latest %zu):\n",
+                                      kMaxSnapshots);
+    if (mSnapshots.empty()) {
+        buffer += "\tNone\n";
+    }
+    for (const auto& entry : mSnapshots) {
+        buffer += entry.snapshot.toString();
+    }
+    WriteStringToFd(buffer, fd);
+}
+
+void ProcessSnapshotter::terminate() {
+    std::vector<std::thread> threads;
+    {
+        std::lock_guard<std::mutex> lock(mMutex);
+        mIsTerminated = true;
+        mPending.clear();
+        mBatches.clear();
+        threads = std::move(mWorkerThreads);
+        mWorkerThreads.clear();
+        threads.push_back(std::move(mReportThread));
+    }
+    mPendingCv.notify_all();
+    mBatchCv.notify_all();
+    mIdleCv.notify_all();
+    for (auto& thread : threads) {
+        if (thread.joinable()) {
+            thread.join();
+        }
+    }
+}
+
+void ProcessSnapshotter::startThreadsLocked() {
+    if (!mReportThread.joinable()) {
+        mReportThread = std::thread([this]() {
+            if (int result = pthread_setname_np(pthread_self(), kReportThreadName); result != 0) {
+                ALOGW("Failed to set %s thread name: %d", kReportThreadName, result);
+            }
+            reportLoop();
+        });
+    }
+    const size_t threadCount =
+            std::min(kMaxConcurrentSnapshots, mPending.size() + mCapturingCount);
+    while (mWorkerThreads.size() < threadCount) {
+        mWorkerThreads.emplace_back([this]() {
+            if (int result = pthread_setname_np(pthread_self(), kCaptureThreadName); result != 0) {
+                ALOGW("Failed to set %s thread name: %d", kCaptureThreadName, result);
+            }
+            captureLoop();
+        });
+    }
+}
+
+void ProcessSnapshotter::captureLoop() {
+    std::unique_lock<std::mutex> lock(mMutex);
+    while (true) {
+        mPendingCv.wait(lock, [this]() REQUIRES(mMutex) {
+            return mIsTerminated || !mPending.empty();
+        });
+        if (mIsTerminated) {
+            return;
+        }
+        const PendingSnapshot pending = mPending.front();
+        mPending.pop_front();
+        ++mCapturingCount;
+        lock.unlock();
+
+        const int64_t captureTimeMillis = elapsedRealtime();
+        ProcessSnapshot captured = captureSnapshot(kProcDirPath, pending.pid, kCaptureNativeStacks);
+
+        lock.lock();
+        --mCapturingCount;
+        // The entry is gone when newer snapshots pushed it out of the ring during the capture.
+        for (auto it = mSnapshots.rbegin(); it != mSnapshots.rend(); ++it) {
+            if (it->id != pending.id) {
+                continue;
+            }
+            ProcessSnapshot& snapshot = it->snapshot;
+            captured.pid = snapshot.pid;
+            captured.startTimeMillis = snapshot.startTimeMillis;
+            captured.detectionTimeMillis = snapshot.detectionTimeMillis;
+            captured.detectionToKillMillis = snapshot.detectionToKillMillis;
+            captured.detectionToCaptureMillis = captureTimeMillis - pending.detectionTimeMillis;
+            snapshot = std::move(captured);
+            break;
+        }
+        // The batch is gone when it was reported at the deadline.
+        for (auto& batch : mBatches) {
+            if (batch.id == pending.batchId && --batch.remainingCount == 0) {
+                mBatchCv.notify_one();
+                break;
+            }
+        }
+        notifyIfIdleLocked();
+    }
+}
+
+void ProcessSnapshotter::reportLoop() {
+    std::unique_lock<std::mutex> lock(mMutex);
+    while (!mIsTerminated) {
+        const auto now = std::chrono::steady_clock::now();
+        std::optional<std::chrono::steady_clock::time_point> nextDeadline;
+        std::vector<std::function<void()>> callbacks;
+        for (auto it = mBatches.begin(); it != mBatches.end();) {
+            if (it->remainingCount > 0 && it->deadline > now) {
+                nextDeadline = std::min(nextDeadline.value_or(it->deadline), it->deadline);
+                ++it;
+                continue;
+            }
+            if (it->remainingCount > 0) {
+                ALOGW("Reporting unresponsive processes before %zu of them were captured",
+                      it->remainingCount);
+                dropPendingSnapshotsLocked(it->id);
+            }
+            if (it->onCaptured != nullptr) {
+                callbacks.push_back(std::move(it->onCaptured));
+            }
+            it = mBatches.erase(it);
+        }
+        if (!callbacks.empty()) {
+            lock.unlock();
+            for (const auto& callback : callbacks) {
+                callback();
+            }
+            lock.lock();
+            continue;
+        }
+        if (nextDeadline.has_value()) {
+            mBatchCv.wait_until(lock, *nextDeadline);
+        } else {
+            mBatchCv.wait(lock);
+        }
+    }
+}
+
+void ProcessSnapshotter::addSnapshotLocked(uint64_t id, ProcessSnapshot snapshot) {
+    mSnapshots.push_back({id, std::move(snapshot)});
+    if (mSnapshots.size() > kMaxSnapshots) {
+        mSnapshots.pop_front();
+    }
+}
+
+void ProcessSnapshotter::dropPendingSnapshotsLocked(uint64_t batchId) {
+    for (auto it = mPending.begin(); it != mPending.end();) {
+        if (it->batchId != batchId) {
+            ++it;
+            continue;
+        }
+        for (auto& entry : mSnapshots) {
+            if (entry.id == it->id) {
+                entry.snapshot.error = "Not captured before the capture deadline";
+                break;
+            }
+        }
+        it = mPending.erase(it);
+    }
+    notifyIfIdleLocked();
+}
+
+void ProcessSnapshotter::notifyIfIdleLocked() {
+    if (mPending.empty() && mCapturingCount == 0) {
+        mIdleCv.notify_all();
+    }
+}
+
+ProcessSnapshot ProcessSnapshotter::captureSnapshot(const std::string& procDirPath, pid_t pid,
+                                                    bool captureNativeStacks) {
+    const auto startTime = std::chrono::steady_clock::now();
+    ProcessSnapshot snapshot;
+    snapshot.pid = pid;
+    std::string path = StringPrintf(kPidStatPathFormat, procDirPath.c_str(), pid);
+    if (!ReadFileToString(path, &snapshot.statLine)) {
+        snapshot.error = StringPrintf("Failed to read '%s'", path.c_str());
+        snapshot.captureDurationMillis = millisSince(startTime);
+        return snapshot;
+    }
+    snapshot.statLine = Trim(snapshot.statLine);
+    if (!parseStatLine(snapshot.statLine, &snapshot.comm, &snapshot.state)) {
+        snapshot.error = StringPrintf("Failed to parse '%s'", path.c_str());
+    }
+    snapshot.wchan = readWchan(StringPrintf(kPidWchanPathFormat, procDirPath.c_str(), pid));
+
+    path = StringPrintf(kPidTaskDirPathFormat, procDirPath.c_str(), pid);
+    auto taskDirp = std::unique_ptr<DIR, int (*)(DIR*)>(opendir(path.c_str()), closedir);
+    for (dirent* tidDir = nullptr; taskDirp != nullptr &&
+         snapshot.threads.size() < kMaxThreadsPerSnapshot &&
+         (tidDir = readdir(taskDirp.get())) != nullptr;) {
+        ThreadSnapshot thread;
+        if (!ParseInt(tidDir->d_name, &thread.tid)) {
+            continue;
+        }
+        std::string statLine;
+        // The thread may have terminated since the task directory was read.
+        if (!ReadFileToString(StringPrintf(kTidStatPathFormat, procDirPath.c_str(), pid,
+                                           thread.tid),
+                              &statLine) ||
+            !parseStatLine(statLine, &thread.name, &thread.state)) {
+            continue;
+        }
+        thread.wchan = readWchan(
+                StringPrintf(kTidWchanPathFormat, procDirPath.c_str(), pid, thread.tid));
+        snapshot.threads.push_back(std::move(thread));
+    }
+    std::sort(snapshot.threads.begin(), snapshot.threads.end(),
+              [](const ThreadSnapshot& l, const ThreadSnapshot& r) { return l.tid < r.tid; });
+
+    if (captureNativeStacks) {
+        snapshot.nativeStacks = dumpNativeStacks(pid);
+    }
+    snapshot.captureDurationMillis = millisSince(startTime);
+    return snapshot;
+}
+
+}  // namespace watchdog
+}  // namespace automotive
+}  // namespace android
@@ -0,0 +1,215 @@
+/*
+ * Copyright (c) 2024, The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef CPP_WATCHDOG_SERVER_SRC_PROCESSSNAPSHOTTER_H_
+#define CPP_WATCHDOG_SERVER_SRC_PROCESSSNAPSHOTTER_H_
+
+#include <aidl/android/automotive/watchdog/internal/ProcessIdentifier.h>
+#include <android-base/thread_annotations.h>
+#include <utils/RefBase.h>
+
+#include <chrono>              // NOLINT(build/c++11)
+#include <condition_variable>  // NOLINT(build/c++11)
+#include <deque>
+#include <functional>
+#include <list>
+#include <mutex>  // NOLINT(build/c++11)
+#include <optional>
+#include <string>
+#include <thread>  // NOLINT(build/c++11)
+#include <vector>
+
+namespace android {
+namespace automotive {
+namespace watchdog {
+
+constexpr const char kSnapshotProcDirPath[] = "/proc";
+// Maximum number of processes captured in parallel.
+constexpr size_t kDefaultMaxConcurrentSnapshots = 4;
+// Upper bound on the time from queuing processes for capture until the caller is notified. A slow
+// capture never delays killing the processes by more than this duration.
+constexpr std::chrono::milliseconds kDefaultSnapshotCaptureDeadline = std::chrono::seconds(2);
+// Maximum number of processes waiting to be captured. Processes reported beyond this limit are
+// recorded as dropped, so a burst of unresponsive processes cannot grow the queue unboundedly.
+constexpr size_t kDefaultMaxPendingSnapshots = 16;
+// Number of the latest process snapshots kept for dumps.
+constexpr size_t kDefaultMaxProcessSnapshots = 20;
+// Timeout for debuggerd to dump the native stacks of a single process.
+constexpr int kNativeStackDumpTimeoutSecs = 1;
+// Limits on the size of a single snapshot.
+constexpr size_t kMaxThreadsPerSnapshot = 256;
+constexpr size_t kMaxNativeStacksBytes = 16 * 1024;
+
+// State of a thread of an unresponsive process at the time of the capture.
+struct ThreadSnapshot {
+    pid_t tid = 0;
+    std::string name;
+    char state = '?';
+    std::string wchan;
+};
+
+// Lightweight snapshot of a process that was reported as not responding.
+struct ProcessSnapshot {
+    pid_t pid = 0;
+    int64_t startTimeMillis = 0;
+    // Elapsed realtime when the process was detected as not responding.
+    int64_t detectionTimeMillis = 0;
+    // Time from the detection until the capture started. Empty until the snapshot is captured.
+    std::optional<int64_t> detectionToCaptureMillis;
+    // Time taken to capture the snapshot.
+    int64_t captureDurationMillis = 0;
+    // Time from the detection until the monitor reported the process as dumped and killed.
+    std::optional<int64_t> detectionToKillMillis;
+    std::string statLine;
+    std::string comm;
+    char state = '?';
+    std::string wchan;
+    std::vector<ThreadSnapshot> threads;
+    // Truncated native stacks dumped by debuggerd. Empty unless the native stack capture is
+    // enabled.
+    std::string nativeStacks;
+    // Reason the snapshot is incomplete. Empty on success.
+    std::string error;
+
+    std::string toString() const;
+};
+
+/*
+ * Captures snapshots of unresponsive processes.
+ *
+ * Each process's `/proc` stat, wchan and per-thread states are captured by a bounded pool of worker
+ * threads, so several hung processes are captured in parallel. The caller is notified once all
+ * processes of a `captureSnapshots()` call are captured or the capture deadline passes, so the
+ * processes are killed after their capture and a slow capture delays the kill by at most the
+ * deadline. Reporting processes never blocks the caller. The latest snapshots are kept in a
+ * bounded ring and included in the dumps.
+ */
+class ProcessSnapshotter final : virtual public android::RefBase {
+public:
+    explicit ProcessSnapshotter(
+            bool captureNativeStacks, const std::string& procDirPath = kSnapshotProcDirPath,
+            size_t maxPendingSnapshots = kDefaultMaxPendingSnapshots,
+            size_t maxSnapshots = kDefaultMaxProcessSnapshots,
+            size_t maxConcurrentSnapshots = kDefaultMaxConcurrentSnapshots,
+            std::chrono::milliseconds captureDeadline = kDefaultSnapshotCaptureDeadline) :
+          kCaptureNativeStacks(captureNativeStacks),
+          kProcDirPath(procDirPath),
+          kMaxPendingSnapshots(maxPendingSnapshots),
+          kMaxSnapshots(maxSnapshots),
+          kMaxConcurrentSnapshots(maxConcurrentSnapshots),
+          kCaptureDeadline(captureDeadline),
+          mNextSnapshotId(0),
+          mNextBatchId(0),
+          mIsTerminated(false),
+          mCapturingCount(0) {}
+
+    ~ProcessSnapshotter() { terminate(); }
+
+    // Queues the given processes for capture and returns without waiting for the capture.
+    // |detectionTimeMillis| is the elapsed realtime when the processes were found not responding.
+    // |onCaptured| is called once all the processes are captured or the capture deadline passes.
+    // It runs on the snapshotter's reporting thread, or on the caller's thread when there is
+    // nothing to capture.
+    void captureSnapshots(
+            const std::vector<aidl::android::automotive::watchdog::internal::ProcessIdentifier>&
+                    processIdentifiers,
+            int64_t detectionTimeMillis, std::function<void()> onCaptured = nullptr);
+
+    // Records the time from the detection until the process was dumped and killed.
+    void onProcessKilled(
+            const aidl::android::automotive::watchdog::internal::ProcessIdentifier&
+                    processIdentifier,
+            int64_t killTimeMillis);
+
+    // Waits until all queued processes are captured. Returns false on timeout.
+    bool waitForPendingSnapshots(std::chrono::milliseconds timeout);
+
+    // Returns the latest snapshots from oldest to newest.
+    std::vector<ProcessSnapshot> getSnapshots() const;
+
+    void onDump(int fd) const;
+
+    // Stops the worker threads. Processes that are still queued are not captured and the pending
+    // |onCaptured| callbacks are not called.
+    void terminate();
+
+private:
+    struct PendingSnapshot {
+        uint64_t id;
+        uint64_t batchId;
+        pid_t pid;
+        int64_t detectionTimeMillis;
+    };
+
+    // Processes queued by a single captureSnapshots() call.
+    struct CaptureBatch {
+        uint64_t id;
+        // Number of the processes that are not captured yet.
+        size_t remainingCount;
+        std::chrono::steady_clock::time_point deadline;
+        std::function<void()> onCaptured;
+    };
+
+    struct SnapshotEntry {
+        uint64_t id;
+        ProcessSnapshot snapshot;
+    };
+
+    void startThreadsLocked() REQUIRES(mMutex);
+
+    void captureLoop();
+
+    // Calls the |onCaptured| callbacks of the batches that are captured or past their deadline.
+    void reportLoop();
+
+    void addSnapshotLocked(uint64_t id, ProcessSnapshot snapshot) REQUIRES(mMutex);
+
+    // Removes the batch's processes that are still waiting to be captured from the queue.
+    void dropPendingSnapshotsLocked(uint64_t batchId) REQUIRES(mMutex);
+
+    void notifyIfIdleLocked() REQUIRES(mMutex);
+
+    static ProcessSnapshot captureSnapshot(const std::string& procDirPath, pid_t pid,
+                                           bool captureNativeStacks);
+
+    const bool kCaptureNativeStacks;
+    const std::string kProcDirPath;
+    const size_t kMaxPendingSnapshots;
+    const size_t kMaxSnapshots;
+    const size_t kMaxConcurrentSnapshots;
+    const std::chrono::milliseconds kCaptureDeadline;
+
+    mutable std::mutex mMutex;
+    std::condition_variable mPendingCv;
+    std::condition_variable mBatchCv;
+    std::condition_variable mIdleCv;
+    std::vector<std::thread> mWorkerThreads GUARDED_BY(mMutex);
+    std::thread mReportThread GUARDED_BY(mMutex);
+    uint64_t mNextSnapshotId GUARDED_BY(mMutex);
+    uint64_t mNextBatchId GUARDED_BY(mMutex);
+    bool mIsTerminated GUARDED_BY(mMutex);
+    // Number of snapshots being captured that were already removed from |mPending|.
+    size_t mCapturingCount GUARDED_BY(mMutex);
+    std::deque<PendingSnapshot> mPending GUARDED_BY(mMutex);
+    std::list<CaptureBatch> mBatches GUARDED_BY(mMutex);
+    std::deque<SnapshotEntry> mSnapshots GUARDED_BY(mMutex);
+};
+
+}  // namespace watchdog
+}  // namespace automotive
+}  // namespace android
+
+#endif  //  CPP_WATCHDOG_SERVER_SRC_PROCESSSNAPSHOTTER_H_
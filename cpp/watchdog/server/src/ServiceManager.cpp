@@ -18,9 +18,12 @@
 
 #include "ServiceManager.h"
 
+#include "CpuOveruseMonitor.h"
+#include "MemoryOveruseMonitor.h"
 #include "PackageInfoResolver.h"
 #include "PerformanceProfiler.h"
 
+#include <android-base/properties.h>
 #include <android/binder_interface_utils.h>
 #include <log/log.h>
 #include <utils/SystemClock.h>
@@ -31,6 +34,7 @@ namespace watchdog {
 
 using ::android::sp;
 using ::android::base::Error;
+using ::android::base::GetBoolProperty;
 using ::android::base::Result;
 using ::android::car::feature::car_watchdog_memory_profiling;
 using ::ndk::SharedRefBase;
@@ -131,6 +135,31 @@ Result<void> ServiceManager::startWatchdogPerfService(
         !result.ok()) {
         return Error() << "Failed to register performance profiler: " << result.error();
     }
+    if (GetBoolProperty(kPropertyCpuOveruseEnabled, /*default_value=*/false)) {
+        sp<CpuOveruseMonitor> cpuOveruseMonitor = sp<CpuOveruseMonitor>::make();
+        if (auto result = mWatchdogPerfService->registerDataProcessor(cpuOveruseMonitor);
+            !result.ok()) {
+            return Error() << "Failed to register CPU overuse monitor: " << result.error();
+        }
+        if (auto result = cpuOveruseMonitor->updateCpuOveruseConfigurations(
+                    readCpuOveruseConfigurations());
+            !result.ok()) {
+            return Error() << "Failed to configure CPU overuse monitor: " << result.error();
+        }
+    }
+    if (car_watchdog_memory_profiling() && mPressureMonitor != nullptr) {
+        sp<MemoryOveruseMonitor> memoryOveruseMonitor =
+                sp<MemoryOveruseMonitor>::make(mPressureMonitor);
+        if (auto result = mWatchdogPerfService->registerDataProcessor(memoryOveruseMonitor);
+            !result.ok()) {
+            return Error() << "Failed to register memory overuse monitor: " << result.error();
+        }
+        if (auto result = memoryOveruseMonitor->updateMemoryOveruseConfigurations(
+                    readMemoryOveruseConfigurations());
+            !result.ok()) {
+            return Error() << "Failed to configure memory overuse monitor: " << result.error();
+        }
+    }
     if (auto result = mWatchdogPerfService->start(); !result.ok()) {
         return Error(result.error().code())
                 << "Failed to start watchdog performance service: " << result.error();
@@ -18,6 +18,8 @@
 
 #include "UidProcStatsCollector.h"
 
+#include <unordered_map>
+
 namespace android {
 namespace automotive {
 namespace watchdog {
@@ -57,15 +59,111 @@ Result<void> ThreadPriorityController::setThreadPriority(int pid, int tid, int u
     if (auto result = checkPidTidUid(ppid, tpid, uuid); !result.ok()) {
         return result;
     }
+    return applyThreadPriority(tpid, policy, priority);
+}
 
-    if (policy != SCHED_FIFO && policy != SCHED_RR && policy != SCHED_OTHER) {
+Result<void> ThreadPriorityController::getThreadPriority(int pid, int tid, int uid,
+                                                         ThreadPolicyWithPriority* result) {
+    pid_t tpid = static_cast<pid_t>(tid);
+    pid_t ppid = static_cast<pid_t>(pid);
+    uid_t uuid = static_cast<uid_t>(uid);
+    if (auto result = checkPidTidUid(ppid, tpid, uuid); !result.ok()) {
+        return result;
+    }
+    return readThreadPriority(tpid, result);
+}
+
+std::vector<Result<void>> ThreadPriorityController::setThreadPriorities(
+        const std::vector<ThreadPriorityRequest>& requests) {
+    std::vector<ThreadIdentifier> threads;
+    threads.reserve(requests.size());
+    for (const auto& request : requests) {
+        threads.push_back(request.thread);
+    }
+    std::vector<Result<void>> results = checkPidTidUids(threads);
+    for (size_t i = 0; i < requests.size(); ++i) {
+        if (!results[i].ok()) {
+            continue;
+        }
+        results[i] = applyThreadPriority(static_cast<pid_t>(requests[i].thread.tid),
+                                         requests[i].policy, requests[i].priority);
+    }
+    return results;
+}
+
+std::vector<Result<ThreadPolicyWithPriority>> ThreadPriorityController::getThreadPriorities(
+        const std::vector<ThreadIdentifier>& threads) {
+    std::vector<Result<void>> checkResults = checkPidTidUids(threads);
+    std::vector<Result<ThreadPolicyWithPriority>> results;
+    results.reserve(threads.size());
+    for (size_t i = 0; i < threads.size(); ++i) {
+        if (!checkResults[i].ok()) {
+            results.push_back(checkResults[i].error());
+            continue;
+        }
+        ThreadPolicyWithPriority policyWithPriority;
+        if (auto result = readThreadPriority(static_cast<pid_t>(threads[i].tid),
+                                             &policyWithPriority);
+            !result.ok()) {
+            results.push_back(result.error());
+            continue;
+        }
+        results.push_back(policyWithPriority);
+    }
+    return results;
+}
+
+std::vector<Result<void>> ThreadPriorityController::checkPidTidUids(
+        const std::vector<ThreadIdentifier>& threads) {
+    struct ProcessInfo {
+        bool isValid = false;
+        uid_t uid = 0;
+        std::unordered_set<pid_t> tids;
+    };
+    std::unordered_map<pid_t, ProcessInfo> processInfoByPid;
+    std::vector<Result<void>> results;
+    results.reserve(threads.size());
+    for (const auto& thread : threads) {
+        pid_t ppid = static_cast<pid_t>(thread.pid);
+        auto [it, inserted] = processInfoByPid.try_emplace(ppid);
+        ProcessInfo& processInfo = it->second;
+        if (inserted) {
+            // The status file is read only for the process because all threads in a process
+            // share the process's UID.
+            auto pidStatus = mSystemCallsInterface->readPidStatusFileForPid(ppid);
+            if (pidStatus.ok() && std::get<1>(*pidStatus) == ppid) {
+                if (auto tids = mSystemCallsInterface->readTidsForPid(ppid); tids.ok()) {
+                    processInfo = ProcessInfo{.isValid = true,
+                                              .uid = std::get<0>(*pidStatus),
+                                              .tids = std::move(*tids)};
+                }
+            }
+        }
+        if (!processInfo.isValid) {
+            results.push_back(Error(EX_ILLEGAL_STATE) << "Invalid process ID: " << thread.pid);
+        } else if (processInfo.tids.count(static_cast<pid_t>(thread.tid)) == 0) {
+            results.push_back(Error(EX_ILLEGAL_STATE) << "Invalid thread ID: " << thread.tid);
+        } else if (processInfo.uid != static_cast<uid_t>(thread.uid)) {
+            results.push_back(Error(EX_ILLEGAL_STATE) << "Invalid user ID: " << thread.uid);
+        } else {
+            results.push_back({});
+        }
+    }
+    return results;
+}
+
+Result<void> ThreadPriorityController::applyThreadPriority(pid_t tid, int policy, int priority) {
+    if (policy != SCHED_FIFO && policy != SCHED_RR && policy != SCHED_OTHER &&
+        policy != SCHED_BATCH && policy != SCHED_IDLE) {
         return Error(EX_ILLEGAL_ARGUMENT)
                 << "Invalid policy: " << policy << ". Supported policies are SCHED_OTHER("
-                << SCHED_OTHER << ") , SCHED_FIFO(" << SCHED_FIFO << ") and SCHED_RR(" << SCHED_RR
+                << SCHED_OTHER << "), SCHED_BATCH(" << SCHED_BATCH << "), SCHED_IDLE("
+                << SCHED_IDLE << "), SCHED_FIFO(" << SCHED_FIFO << ") and SCHED_RR(" << SCHED_RR
                 << ")";
     }
 
-    if (policy == SCHED_OTHER) {
+    if (policy == SCHED_OTHER || policy == SCHED_BATCH || policy == SCHED_IDLE) {
+        // Non real-time policies don't have a static priority.
         priority = 0;
     } else if (priority < PRIORITY_MIN || priority > PRIORITY_MAX) {
         return Error(EX_ILLEGAL_ARGUMENT)
@@ -75,30 +173,23 @@ Result<void> ThreadPriorityController::setThreadPriority(int pid, int tid, int u
 
     sched_param param{.sched_priority = priority};
     errno = 0;
-    if (mSystemCallsInterface->setScheduler(tpid, policy, &param) != 0) {
+    if (mSystemCallsInterface->setScheduler(tid, policy, &param) != 0) {
         return Error(EX_SERVICE_SPECIFIC) << "sched_setscheduler failed, errno: " << errno;
     }
     return {};
 }
 
-Result<void> ThreadPriorityController::getThreadPriority(int pid, int tid, int uid,
-                                                         ThreadPolicyWithPriority* result) {
-    pid_t tpid = static_cast<pid_t>(tid);
-    pid_t ppid = static_cast<pid_t>(pid);
-    uid_t uuid = static_cast<uid_t>(uid);
-    if (auto result = checkPidTidUid(ppid, tpid, uuid); !result.ok()) {
-        return result;
-    }
-
+Result<void> ThreadPriorityController::readThreadPriority(pid_t tid,
+                                                          ThreadPolicyWithPriority* result) {
     errno = 0;
-    int policy = mSystemCallsInterface->getScheduler(tpid);
+    int policy = mSystemCallsInterface->getScheduler(tid);
     if (policy < 0) {
         return Error(EX_SERVICE_SPECIFIC) << "sched_getscheduler failed, errno: " << errno;
     }
 
     sched_param param = {};
     errno = 0;
-    int callResult = mSystemCallsInterface->getParam(tpid, &param);
+    int callResult = mSystemCallsInterface->getParam(tid, &param);
     if (callResult != 0) {
         return Error(EX_SERVICE_SPECIFIC) << "sched_getparam failed, errno: " << errno;
     }
@@ -126,6 +217,10 @@ Result<std::tuple<uid_t, pid_t>> ThreadPriorityController::SystemCalls::readPidS
     return UidProcStatsCollector::readPidStatusFileForPid(pid);
 }
 
+Result<std::unordered_set<pid_t>> ThreadPriorityController::SystemCalls::readTidsForPid(pid_t pid) {
+    return UidProcStatsCollector::readTidsForPid(pid);
+}
+
 }  // namespace watchdog
 }  // namespace automotive
 }  // namespace android
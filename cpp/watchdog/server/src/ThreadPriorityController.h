@@ -22,10 +22,29 @@
 
 #include <sched.h>
 
+#include <memory>
+#include <tuple>
+#include <unordered_set>
+#include <vector>
+
 namespace android {
 namespace automotive {
 namespace watchdog {
 
+// Identifies a thread for the batched thread priority APIs.
+struct ThreadIdentifier {
+    int pid = 0;
+    int tid = 0;
+    int uid = 0;
+};
+
+// Scheduling policy and priority to set for a thread with the batched thread priority API.
+struct ThreadPriorityRequest {
+    ThreadIdentifier thread;
+    int policy = SCHED_OTHER;
+    int priority = 0;
+};
+
 class ThreadPriorityControllerInterface {
 public:
     virtual ~ThreadPriorityControllerInterface() = default;
@@ -34,6 +53,24 @@ public:
     virtual android::base::Result<void> getThreadPriority(
             int pid, int tid, int uid,
             aidl::android::automotive::watchdog::internal::ThreadPolicyWithPriority* result) = 0;
+
+    /**
+     * Sets the scheduling policy and priority for all the requested threads.
+     *
+     * Returns a result per request, in the order of the requests. A failed request doesn't
+     * prevent the other requests from being applied.
+     */
+    virtual std::vector<android::base::Result<void>> setThreadPriorities(
+            const std::vector<ThreadPriorityRequest>& requests) = 0;
+
+    /**
+     * Returns the scheduling policy and priority of all the given threads.
+     *
+     * Returns a result per thread, in the order of the threads.
+     */
+    virtual std::vector<android::base::Result<
+            aidl::android::automotive::watchdog::internal::ThreadPolicyWithPriority>>
+    getThreadPriorities(const std::vector<ThreadIdentifier>& threads) = 0;
 };
 
 class ThreadPriorityController final : public ThreadPriorityControllerInterface {
@@ -46,6 +83,7 @@ public:
         virtual int getParam(pid_t tid, sched_param* param) = 0;
         virtual android::base::Result<std::tuple<uid_t, pid_t>> readPidStatusFileForPid(
                 pid_t pid) = 0;
+        virtual android::base::Result<std::unordered_set<pid_t>> readTidsForPid(pid_t pid) = 0;
 
         virtual ~SystemCallsInterface() = default;
     };
@@ -61,6 +99,11 @@ public:
             int pid, int tid, int uid,
             aidl::android::automotive::watchdog::internal::ThreadPolicyWithPriority* result)
             override;
+    std::vector<android::base::Result<void>> setThreadPriorities(
+            const std::vector<ThreadPriorityRequest>& requests) override;
+    std::vector<android::base::Result<
+            aidl::android::automotive::watchdog::internal::ThreadPolicyWithPriority>>
+    getThreadPriorities(const std::vector<ThreadIdentifier>& threads) override;
 
 private:
     class SystemCalls final : public SystemCallsInterface {
@@ -68,11 +111,25 @@ private:
         int getScheduler(pid_t tid) override;
         int getParam(pid_t tid, sched_param* param) override;
         android::base::Result<std::tuple<uid_t, pid_t>> readPidStatusFileForPid(pid_t pid) override;
+        android::base::Result<std::unordered_set<pid_t>> readTidsForPid(pid_t pid) override;
     };
 
     std::unique_ptr<SystemCallsInterface> mSystemCallsInterface;
 
     android::base::Result<void> checkPidTidUid(pid_t pid, pid_t tid, uid_t uid);
+
+    /**
+     * Validates all the given threads with a single read of each process's status file and task
+     * directory, instead of reading the status file of every thread.
+     */
+    std::vector<android::base::Result<void>> checkPidTidUids(
+            const std::vector<ThreadIdentifier>& threads);
+
+    android::base::Result<void> applyThreadPriority(pid_t tid, int policy, int priority);
+
+    android::base::Result<void> readThreadPriority(
+            pid_t tid,
+            aidl::android::automotive::watchdog::internal::ThreadPolicyWithPriority* result);
 };
 
 }  // namespace watchdog
@@ -18,13 +18,12 @@
 
 #include "UidCpuStatsCollector.h"
 
-#include <android-base/file.h>
-#include <android-base/parseint.h>
 #include <android-base/strings.h>
 
 #include <inttypes.h>
 
 #include <string>
+#include <string_view>
 #include <unordered_map>
 #include <vector>
 
@@ -36,10 +35,7 @@ namespace {
 
 using ::android::base::EndsWith;
 using ::android::base::Error;
-using ::android::base::ParseInt;
-using ::android::base::ReadFileToString;
 using ::android::base::Result;
-using ::android::base::Split;
 
 enum class ReadError : int {
     ERR_INVALID_FILE,
@@ -53,40 +49,42 @@ enum class ReadError : int {
  * /proc/uid_cputime/show_uid_stat file format:
  * <uid>: <user_time_micro_seconds> <system_time_micro_seconds>
  */
-Result<std::unordered_map<uid_t, int64_t>> readUidCpuTimeFile(const std::string& path) {
-    std::string buffer;
-    if (!ReadFileToString(path, &buffer)) {
-        return Error(static_cast<int>(ReadError::ERR_FILE_OPEN_READ))
-                << "ReadFileToString failed for " << path;
+Result<std::unordered_map<uid_t, int64_t>> readUidCpuTimeFile(
+        ProcFileReader* reader, std::vector<std::string_view>* elements) {
+    const std::string& path = reader->path();
+    const auto contents = reader->read();
+    if (!contents.ok()) {
+        return Error(static_cast<int>(ReadError::ERR_FILE_OPEN_READ)) << contents.error();
     }
     std::unordered_map<uid_t, int64_t> cpuTimeMillisByUid;
-    std::vector<std::string> lines = Split(buffer, "\n");
-    for (size_t i = 0; i < lines.size(); i++) {
-        if (lines[i].empty()) {
+    LineReader lineReader(*contents);
+    for (std::string_view line; lineReader.next(&line);) {
+        if (line.empty()) {
             continue;
         }
-        const std::string delimiter = " ";
-        std::vector<std::string> elements = Split(lines[i], delimiter);
-        if (elements.size() < 3) {
+        const char delimiter = ' ';
+        splitFields(line, delimiter, elements);
+        if (elements->size() < 3) {
             return Error(static_cast<int>(ReadError::ERR_INVALID_FILE))
-                    << "Line \"" << lines[i] << "\" doesn't contain the delimiter \"" << delimiter
+                    << "Line \"" << line << "\" doesn't contain the delimiter \"" << delimiter
                     << "\" in file " << path;
         }
-        if (EndsWith(elements[0], ":")) {
-            elements[0].pop_back();
+        if (EndsWith((*elements)[0], ":")) {
+            (*elements)[0].remove_suffix(1);
         }
         int64_t uid = -1;
         int64_t userCpuTimeUs = 0;
         int64_t systemCpuTimeUs = 0;
-        if (!ParseInt(elements[0], &uid) || !ParseInt(elements[1], &userCpuTimeUs) ||
-            !ParseInt(elements[2], &systemCpuTimeUs)) {
+        if (!parseIntField((*elements)[0], &uid) ||
+            !parseIntField((*elements)[1], &userCpuTimeUs) ||
+            !parseIntField((*elements)[2], &systemCpuTimeUs)) {
             return Error(static_cast<int>(ReadError::ERR_INVALID_FILE))
-                    << "Failed to parse line from file: " << path << ", error: line " << lines[i]
+                    << "Failed to parse line from file: " << path << ", error: line " << line
                     << " has invalid format";
         }
         if (cpuTimeMillisByUid.find(uid) != cpuTimeMillisByUid.end()) {
             return Error(static_cast<int>(ReadError::ERR_INVALID_FILE))
-                    << "Duplicate " << uid << " line: \"" << lines[i] << "\" in file " << path;
+                    << "Duplicate " << uid << " line: \"" << line << "\" in file " << path;
         }
         // Store CPU time as milliseconds
         cpuTimeMillisByUid[uid] = userCpuTimeUs / 1000 + systemCpuTimeUs / 1000;
@@ -104,10 +102,12 @@ Result<void> UidCpuStatsCollector::collect() {
     if (!mEnabled) {
         return Error() << "Can not access: " << mPath;
     }
-    auto cpuTimeMillisByUid = readUidCpuTimeFile(mPath);
+    auto cpuTimeMillisByUid =
+            mUsesCgroup ? readCgroupCpuStatsLocked() : readUidCpuTimeFile(&mReader, &mFields);
     if (!cpuTimeMillisByUid.ok()) {
         return Error(cpuTimeMillisByUid.error().code())
-                << "Failed to read top-level per UID CPU time file " << mPath << ": "
+                << "Failed to read top-level per UID CPU time file "
+                << (mUsesCgroup ? mCgroupReader.filePath() : mPath) << ": "
                 << cpuTimeMillisByUid.error().message();
     }
 
@@ -130,6 +130,33 @@ Result<void> UidCpuStatsCollector::collect() {
     return {};
 }
 
+Result<std::unordered_map<uid_t, int64_t>> UidCpuStatsCollector::readCgroupCpuStatsLocked() {
+    std::unordered_map<uid_t, int64_t> cpuTimeMillisByUid;
+    std::vector<uid_t> newCgroupUids;
+    auto result = mCgroupReader.read(
+            [&](uid_t uid, bool isNewCgroup, std::string_view contents) -> Result<void> {
+                auto cpuTimeMillis = parseCgroupCpuTimeMillis(contents, &mFields);
+                if (!cpuTimeMillis.ok()) {
+                    return Error(static_cast<int>(ReadError::ERR_INVALID_FILE))
+                            << cpuTimeMillis.error();
+                }
+                if (isNewCgroup) {
+                    newCgroupUids.push_back(uid);
+                }
+                cpuTimeMillisByUid[uid] = *cpuTimeMillis;
+                return {};
+            });
+    if (!result.ok()) {
+        return result.error();
+    }
+    // The CPU time of a new or recreated UID cgroup starts from zero, so the whole CPU time is the
+    // delta.
+    for (uid_t uid : newCgroupUids) {
+        mLatestStats.erase(uid);
+    }
+    return cpuTimeMillisByUid;
+}
+
 }  // namespace watchdog
 }  // namespace automotive
 }  // namespace android
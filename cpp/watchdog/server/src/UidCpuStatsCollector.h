@@ -17,6 +17,9 @@
 #ifndef CPP_WATCHDOG_SERVER_SRC_UIDCPUSTATSCOLLECTOR_H_
 #define CPP_WATCHDOG_SERVER_SRC_UIDCPUSTATSCOLLECTOR_H_
 
+#include "CgroupUidStatsReader.h"
+#include "ProcFileReader.h"
+
 #include <android-base/result.h>
 #include <android-base/stringprintf.h>
 #include <utils/Mutex.h>
@@ -25,7 +28,9 @@
 #include <stdint.h>
 
 #include <string>
+#include <string_view>
 #include <unordered_map>
+#include <vector>
 
 namespace android {
 namespace automotive {
@@ -33,7 +38,12 @@ namespace watchdog {
 
 inline constexpr char kShowUidCpuTimeFile[] = "/proc/uid_cputime/show_uid_stat";
 
-// Collector/Parser for `/proc/uid_cputime/show_uid_stat`.
+/**
+ * Collector/Parser for `/proc/uid_cputime/show_uid_stat`. Falls back to the cgroup v2 UID
+ * hierarchy's `cpu.stat` files when `/proc/uid_cputime/show_uid_stat` isn't available. Reading a
+ * single procfs file is cheaper than reading a `cpu.stat` file per UID, so the procfs file is
+ * preferred.
+ */
 class UidCpuStatsCollectorInterface : public RefBase {
 public:
     // Initializes the collector.
@@ -44,15 +54,20 @@ public:
     virtual const std::unordered_map<uid_t, int64_t> latestStats() const = 0;
     // Returns the delta of per-UID CPU stats since the last before collection.
     virtual const std::unordered_map<uid_t, int64_t> deltaStats() const = 0;
-    // Returns true only when the per-UID CPU stats file is accessible.
+    // Returns true only when the per-UID CPU stats files are accessible.
     virtual bool enabled() const = 0;
-    // Returns the path for the per-UID CPU stats file.
+    // Returns the path for the per-UID CPU stats files.
     virtual const std::string filePath() const = 0;
 };
 
 class UidCpuStatsCollector final : public UidCpuStatsCollectorInterface {
 public:
-    explicit UidCpuStatsCollector(const std::string& path = kShowUidCpuTimeFile) : mPath(path) {}
+    explicit UidCpuStatsCollector(const std::string& path = kShowUidCpuTimeFile,
+                                  const std::string& cgroupRootPath = kCgroupV2RootPath) :
+          mPath(path),
+          mReader(path),
+          mCgroupReader(cgroupRootPath, kCgroupCpuStatFile),
+          mUsesCgroup(false) {}
 
     ~UidCpuStatsCollector() {}
 
@@ -62,6 +77,8 @@ public:
         // dependent classes would call the constructor before mocking and get killed due to
         // sepolicy violation.
         mEnabled = access(mPath.c_str(), R_OK) == 0;
+        mUsesCgroup = !mEnabled && mCgroupReader.isAvailable();
+        mEnabled |= mUsesCgroup;
     }
 
     android::base::Result<void> collect() override;
@@ -81,9 +98,18 @@ public:
         return mEnabled;
     }
 
-    const std::string filePath() const override { return mPath; }
+    const std::string filePath() const override {
+        Mutex::Autolock lock(mMutex);
+        return mUsesCgroup ? mCgroupReader.filePath() : mPath;
+    }
 
 private:
+    /**
+     * Reads the cgroup v2 UID hierarchy's `cpu.stat` files and returns the CPU time of each UID
+     * cgroup. Drops the latest stats of the UIDs whose cgroup is new or was recreated.
+     */
+    android::base::Result<std::unordered_map<uid_t, int64_t>> readCgroupCpuStatsLocked();
+
     // Path to show_uid_stat file. Default path is |kShowUidCpuTimeFile|.
     const std::string mPath;
 
@@ -93,6 +119,18 @@ private:
     // True if |mPath| is accessible.
     bool mEnabled GUARDED_BY(mMutex);
 
+    // Reader for the file at |mPath|.
+    ProcFileReader mReader GUARDED_BY(mMutex);
+
+    // Reader for the cgroup v2 UID hierarchy's `cpu.stat` files.
+    CgroupUidStatsReader mCgroupReader GUARDED_BY(mMutex);
+
+    // True if the stats are read from the cgroup v2 UID hierarchy instead of |mPath|.
+    bool mUsesCgroup GUARDED_BY(mMutex);
+
+    // Reused across lines and collections to split the lines without allocations.
+    std::vector<std::string_view> mFields GUARDED_BY(mMutex);
+
     // Latest dump from the file at |mPath|.
     std::unordered_map<uid_t, int64_t> mLatestStats GUARDED_BY(mMutex);
 
@@ -18,8 +18,6 @@
 
 #include "UidIoStatsCollector.h"
 
-#include <android-base/file.h>
-#include <android-base/parseint.h>
 #include <android-base/stringprintf.h>
 #include <android-base/strings.h>
 #include <log/log.h>
@@ -27,6 +25,7 @@
 #include <inttypes.h>
 
 #include <string>
+#include <string_view>
 #include <unordered_map>
 #include <utility>
 #include <vector>
@@ -36,25 +35,23 @@ namespace automotive {
 namespace watchdog {
 
 using ::android::base::Error;
-using ::android::base::ParseInt;
-using ::android::base::ParseUint;
-using ::android::base::ReadFileToString;
 using ::android::base::Result;
-using ::android::base::Split;
+using ::android::base::StartsWith;
 using ::android::base::StringPrintf;
 
 namespace {
 
-bool parseUidIoStats(const std::string& data, UidIoStats* stats, uid_t* uid) {
-    std::vector<std::string> fields = Split(data, " ");
-    if (fields.size() < 11 || !ParseUint(fields[0], uid) ||
-        !ParseInt(fields[3], &stats->metrics[READ_BYTES][FOREGROUND]) ||
-        !ParseInt(fields[4], &stats->metrics[WRITE_BYTES][FOREGROUND]) ||
-        !ParseInt(fields[7], &stats->metrics[READ_BYTES][BACKGROUND]) ||
-        !ParseInt(fields[8], &stats->metrics[WRITE_BYTES][BACKGROUND]) ||
-        !ParseInt(fields[9], &stats->metrics[FSYNC_COUNT][FOREGROUND]) ||
-        !ParseInt(fields[10], &stats->metrics[FSYNC_COUNT][BACKGROUND])) {
-        ALOGW("Invalid uid I/O stats: \"%s\"", data.c_str());
+bool parseUidIoStats(std::string_view data, std::vector<std::string_view>* fields,
+                     UidIoStats* stats, uid_t* uid) {
+    splitFields(data, ' ', fields);
+    if (fields->size() < 11 || !parseIntField((*fields)[0], uid) ||
+        !parseIntField((*fields)[3], &stats->metrics[READ_BYTES][FOREGROUND]) ||
+        !parseIntField((*fields)[4], &stats->metrics[WRITE_BYTES][FOREGROUND]) ||
+        !parseIntField((*fields)[7], &stats->metrics[READ_BYTES][BACKGROUND]) ||
+        !parseIntField((*fields)[8], &stats->metrics[WRITE_BYTES][BACKGROUND]) ||
+        !parseIntField((*fields)[9], &stats->metrics[FSYNC_COUNT][FOREGROUND]) ||
+        !parseIntField((*fields)[10], &stats->metrics[FSYNC_COUNT][BACKGROUND])) {
+        ALOGW("Invalid uid I/O stats: \"%.*s\"", static_cast<int>(data.size()), data.data());
         return false;
     }
     return true;
@@ -126,15 +123,15 @@ Result<void> UidIoStatsCollector::collect() {
     return {};
 }
 
-Result<std::unordered_map<uid_t, UidIoStats>> UidIoStatsCollector::readUidIoStatsLocked() const {
-    std::string buffer;
-    if (!ReadFileToString(kPath, &buffer)) {
-        return Error() << "ReadFileToString failed for " << kPath;
+Result<std::unordered_map<uid_t, UidIoStats>> UidIoStatsCollector::readUidIoStatsLocked() {
+    const auto contents = mReader.read();
+    if (!contents.ok()) {
+        return contents.error();
     }
     std::unordered_map<uid_t, UidIoStats> uidIoStatsByUid;
-    std::vector<std::string> lines = Split(std::move(buffer), "\n");
-    for (const auto& line : lines) {
-        if (line.empty() || !line.compare(0, 4, "task")) {
+    LineReader lineReader(*contents);
+    for (std::string_view line; lineReader.next(&line);) {
+        if (line.empty() || StartsWith(line, "task")) {
             /* Skip per-task stats as CONFIG_UID_SYS_STATS_DEBUG is not set in the kernel and
              * the collected data is aggregated only per-UID.
              */
@@ -142,7 +139,7 @@ Result<std::unordered_map<uid_t, UidIoStats>> UidIoStatsCollector::readUidIoStat
         }
         uid_t uid;
         UidIoStats uidIoStats;
-        if (!parseUidIoStats(line, &uidIoStats, &uid)) {
+        if (!parseUidIoStats(line, &mFields, &uidIoStats, &uid)) {
             return Error() << "Failed to parse the contents of " << kPath;
         }
         uidIoStatsByUid[uid] = uidIoStats;
@@ -17,6 +17,8 @@
 #ifndef CPP_WATCHDOG_SERVER_SRC_UIDIOSTATSCOLLECTOR_H_
 #define CPP_WATCHDOG_SERVER_SRC_UIDIOSTATSCOLLECTOR_H_
 
+#include "ProcFileReader.h"
+
 #include <android-base/result.h>
 #include <android-base/stringprintf.h>
 #include <utils/Mutex.h>
@@ -25,7 +27,9 @@
 #include <stdint.h>
 
 #include <string>
+#include <string_view>
 #include <unordered_map>
+#include <vector>
 
 namespace android {
 namespace automotive {
@@ -101,7 +105,8 @@ public:
 
 class UidIoStatsCollector final : public UidIoStatsCollectorInterface {
 public:
-    explicit UidIoStatsCollector(const std::string& path = kUidIoStatsPath) : kPath(path) {}
+    explicit UidIoStatsCollector(const std::string& path = kUidIoStatsPath) :
+          kPath(path), mReader(path) {}
 
     ~UidIoStatsCollector() {}
 
@@ -134,7 +139,7 @@ public:
 
 private:
     // Reads the contents of |kPath|.
-    android::base::Result<std::unordered_map<uid_t, UidIoStats>> readUidIoStatsLocked() const;
+    android::base::Result<std::unordered_map<uid_t, UidIoStats>> readUidIoStatsLocked();
 
     // Path to uid_io stats file. Default path is |kUidIoStatsPath|.
     const std::string kPath;
@@ -145,6 +150,12 @@ private:
     // True if |kPath| is accessible.
     bool mEnabled GUARDED_BY(mMutex);
 
+    // Reader for the file at |kPath|.
+    ProcFileReader mReader GUARDED_BY(mMutex);
+
+    // Reused across lines and collections to split the lines without allocations.
+    std::vector<std::string_view> mFields GUARDED_BY(mMutex);
+
     // Latest dump from the file at |kPath|.
     std::unordered_map<uid_t, UidIoStats> mLatestStats GUARDED_BY(mMutex);
 
@@ -24,6 +24,7 @@
 #include <android-base/result.h>
 #include <android-base/stringprintf.h>
 #include <android-base/strings.h>
+#include <cutils/multiuser.h>
 #include <log/log.h>
 
 #include <dirent.h>
@@ -31,6 +32,7 @@
 #include <string>
 #include <string_view>
 #include <unordered_map>
+#include <unordered_set>
 #include <vector>
 
 namespace android {
@@ -56,6 +58,7 @@ constexpr uint64_t kMaxUint64 = std::numeric_limits<uint64_t>::max();
 
 constexpr const char* kProcPidStatFileFormat = "/proc/%" PRIu32 "/stat";
 constexpr const char* kProcPidStatusFileFormat = "/proc/%" PRIu32 "/status";
+constexpr const char* kProcPidTaskDirFormat = "/proc/%" PRIu32 "/task";
 
 enum ReadStatus {
     // Default value is an error for backwards compatibility with the Result::ErrorCode.
@@ -483,10 +486,31 @@ Result<void> UidProcStatsCollector::collect() {
         }
         mDeltaStats[uid] = std::move(deltaUidStats);
     }
+    if (!mFilterAppIds.empty()) {
+        // Keep the latest stats of the filtered out UIDs, so the next unfiltered collection
+        // reports their deltas instead of their totals.
+        for (auto& [uid, uidProcStats] : mLatestStats) {
+            if (!isFilteredInLocked(uid)) {
+                uidProcStatsByUid->try_emplace(uid, std::move(uidProcStats));
+            }
+        }
+    }
     mLatestStats = std::move(*uidProcStatsByUid);
     return {};
 }
 
+void UidProcStatsCollector::setFilterUids(const std::unordered_set<uid_t>& uids) {
+    Mutex::Autolock lock(mMutex);
+    mFilterAppIds.clear();
+    for (const auto& uid : uids) {
+        mFilterAppIds.insert(multiuser_get_app_id(uid));
+    }
+}
+
+bool UidProcStatsCollector::isFilteredInLocked(uid_t uid) const {
+    return mFilterAppIds.empty() || mFilterAppIds.count(multiuser_get_app_id(uid)) != 0;
+}
+
 Result<std::unordered_map<uid_t, UidProcStats>> UidProcStatsCollector::readUidProcStatsLocked()
         const {
     std::unordered_map<uid_t, UidProcStats> uidProcStatsByUid;
@@ -499,6 +523,15 @@ Result<std::unordered_map<uid_t, UidProcStats>> UidProcStatsCollector::readUidPr
         if (pidDir->d_type != DT_DIR || !ParseInt(pidDir->d_name, &pid)) {
             continue;
         }
+        if (!mFilterAppIds.empty()) {
+            // Skip the filtered out processes before reading their per-process and per-thread
+            // files. Processes with an unreadable status file are filtered after reading them.
+            std::string path = StringPrintf((mPath + kStatusFileFormat).c_str(), pid);
+            if (auto status = readPidStatusFile(path);
+                status.ok() && !isFilteredInLocked(std::get<0>(*status))) {
+                continue;
+            }
+        }
         auto result = readProcessStatsLocked(pid);
         if (!result.ok()) {
             if (result.error().code() != READ_WARNING) {
@@ -510,6 +543,9 @@ Result<std::unordered_map<uid_t, UidProcStats>> UidProcStatsCollector::readUidPr
             continue;
         }
         uid_t uid = std::get<uid_t>(*result);
+        if (!isFilteredInLocked(uid)) {
+            continue;
+        }
         ProcessStats processStats = std::get<ProcessStats>(*result);
         if (uidProcStatsByUid.find(uid) == uidProcStatsByUid.end()) {
             uidProcStatsByUid[uid] = {};
@@ -664,6 +700,23 @@ Result<std::tuple<uid_t, pid_t>> UidProcStatsCollector::readPidStatusFileForPid(
     return readPidStatusFile(path);
 }
 
+Result<std::unordered_set<pid_t>> UidProcStatsCollector::readTidsForPid(pid_t pid) {
+    std::string taskDir = StringPrintf(kProcPidTaskDirFormat, pid);
+    auto taskDirp = std::unique_ptr<DIR, int (*)(DIR*)>(opendir(taskDir.c_str()), closedir);
+    if (taskDirp == nullptr) {
+        return Error() << "Failed to open '" << taskDir << "': " << strerror(errno);
+    }
+    std::unordered_set<pid_t> tids;
+    while (const dirent* tidDir = readdir(taskDirp.get())) {
+        pid_t tid = 0;
+        if (tidDir->d_type != DT_DIR || !ParseInt(tidDir->d_name, &tid)) {
+            continue;
+        }
+        tids.insert(tid);
+    }
+    return tids;
+}
+
 bool UidProcStatsCollector::readSmapsRollup(pid_t pid, ProcessStats* processStatsOut) const {
     if (!mIsSmapsRollupSupported) {
         return false;
@@ -31,6 +31,7 @@
 
 #include <string>
 #include <unordered_map>
+#include <unordered_set>
 #include <vector>
 
 namespace android {
@@ -135,6 +136,11 @@ public:
     virtual bool enabled() const = 0;
     // Returns the /proc files common ancestor directory path.
     virtual const std::string dirPath() const = 0;
+    /**
+     * Restricts the next collections to the processes of the apps with the given UIDs' app IDs,
+     * across all users. Collects all processes when |uids| is empty.
+     */
+    virtual void setFilterUids(const std::unordered_set<uid_t>& uids) = 0;
 };
 
 class UidProcStatsCollector final : public UidProcStatsCollectorInterface {
@@ -171,10 +177,15 @@ public:
 
     const std::string dirPath() const { return mPath; }
 
+    void setFilterUids(const std::unordered_set<uid_t>& uids) override;
+
     static android::base::Result<PidStat> readStatFileForPid(pid_t pid);
 
     static android::base::Result<std::tuple<uid_t, pid_t>> readPidStatusFileForPid(pid_t pid);
 
+    // Returns the IDs of the threads listed in the process's `/proc/[pid]/task` directory.
+    static android::base::Result<std::unordered_set<pid_t>> readTidsForPid(pid_t pid);
+
 private:
     android::base::Result<std::unordered_map<uid_t, UidProcStats>> readUidProcStatsLocked() const;
 
@@ -195,6 +206,9 @@ private:
      */
     bool readSmapsRollup(pid_t pid, ProcessStats* processStatsOut) const;
 
+    // Returns true when the |uid| passes the filter set by |setFilterUids|.
+    bool isFilteredInLocked(uid_t uid) const;
+
     size_t mPageSizeKb;
 
     // Tracks memory profiling feature flag.
@@ -233,6 +247,14 @@ private:
      */
     bool mIsTimeInStateEnabled GUARDED_BY(mMutex);
 
+    /**
+     * App IDs of the processes to collect. Empty when collecting all processes.
+     *
+     * The processes of the other apps are skipped after reading only their status file, so their
+     * stat, statm, smaps_rollup and per-thread files aren't read.
+     */
+    std::unordered_set<uid_t> mFilterAppIds GUARDED_BY(mMutex);
+
     // Latest dump of per-UID stats.
     std::unordered_map<uid_t, UidProcStats> mLatestStats GUARDED_BY(mMutex);
 
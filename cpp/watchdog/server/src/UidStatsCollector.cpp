@@ -53,6 +53,7 @@ Result<void> UidStatsCollector::collect() {
         }
     }
     if (mUidProcStatsCollector->enabled()) {
+        mUidProcStatsCollector->setFilterUids(resolveFilterUidsLocked());
         if (const auto& result = mUidProcStatsCollector->collect(); !result.ok()) {
             return Error() << "Failed to collect per-uid process stats: " << result.error();
         }
@@ -71,6 +72,19 @@ Result<void> UidStatsCollector::collect() {
     return {};
 }
 
+std::unordered_set<uid_t> UidStatsCollector::resolveFilterUidsLocked() const {
+    std::unordered_set<uid_t> uids;
+    if (mFilterPackages.empty()) {
+        return uids;
+    }
+    for (const auto& curUidStats : mLatestStats) {
+        if (mFilterPackages.count(curUidStats.genericPackageName()) != 0) {
+            uids.insert(curUidStats.uid());
+        }
+    }
+    return uids;
+}
+
 std::vector<UidStats> UidStatsCollector::process(
         const std::unordered_map<uid_t, UidIoStats>& uidIoStatsByUid,
         const std::unordered_map<uid_t, UidProcStats>& uidProcStatsByUid,
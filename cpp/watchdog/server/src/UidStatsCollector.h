@@ -29,6 +29,7 @@
 #include <utils/StrongPointer.h>
 
 #include <string>
+#include <unordered_set>
 #include <vector>
 
 namespace android {
@@ -68,6 +69,11 @@ public:
     virtual const std::vector<UidStats> deltaStats() const = 0;
     // Returns true only when the per-UID I/O or proc stats files are accessible.
     virtual bool enabled() const = 0;
+    /**
+     * Restricts the per-process stats collection to the given packages. Collects the per-process
+     * stats of all packages when |packages| is empty.
+     */
+    virtual void setFilterPackages(const std::unordered_set<std::string>& packages) = 0;
 };
 
 class UidStatsCollector final : public UidStatsCollectorInterface {
@@ -101,7 +107,15 @@ public:
         return mUidIoStatsCollector->enabled() || mUidProcStatsCollector->enabled();
     }
 
+    void setFilterPackages(const std::unordered_set<std::string>& packages) override {
+        Mutex::Autolock lock(mMutex);
+        mFilterPackages = packages;
+    }
+
 private:
+    // Returns the UIDs of |mFilterPackages| in |mLatestStats|.
+    std::unordered_set<uid_t> resolveFilterUidsLocked() const;
+
     std::vector<UidStats> process(
             const std::unordered_map<uid_t, UidIoStats>& uidIoStatsByUid,
             const std::unordered_map<uid_t, UidProcStats>& uidProcStatsByUid,
@@ -118,6 +132,13 @@ private:
 
     android::sp<UidProcStatsCollectorInterface> mUidProcStatsCollector GUARDED_BY(mMutex);
 
+    /**
+     * Packages to collect the per-process stats for. The packages are resolved to UIDs with the
+     * latest stats before each collection, so a filtered package's processes are collected from
+     * the collection after the package's UID is first seen.
+     */
+    std::unordered_set<std::string> mFilterPackages GUARDED_BY(mMutex);
+
     std::vector<UidStats> mLatestStats GUARDED_BY(mMutex);
 
     std::vector<UidStats> mDeltaStats GUARDED_BY(mMutex);
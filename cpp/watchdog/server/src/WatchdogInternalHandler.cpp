@@ -41,6 +41,9 @@ using ::aidl::android::automotive::watchdog::internal::PowerCycle;
 using ::aidl::android::automotive::watchdog::internal::ProcessIdentifier;
 using ::aidl::android::automotive::watchdog::internal::ResourceOveruseConfiguration;
 using ::aidl::android::automotive::watchdog::internal::StateType;
+using ::aidl::android::automotive::watchdog::internal::ThreadId;
+using ::aidl::android::automotive::watchdog::internal::ThreadPolicyResult;
+using ::aidl::android::automotive::watchdog::internal::ThreadPolicyUpdate;
 using ::aidl::android::automotive::watchdog::internal::ThreadPolicyWithPriority;
 using ::aidl::android::automotive::watchdog::internal::UserPackageIoUsageStats;
 using ::aidl::android::automotive::watchdog::internal::UserState;
@@ -79,6 +82,22 @@ ScopedAStatus toScopedAStatus(const Result<void>& result) {
     return toScopedAStatus(result.error().code(), result.error().message());
 }
 
+template <typename T>
+ThreadPolicyResult toThreadPolicyResult(const Result<T>& result) {
+    ThreadPolicyResult threadPolicyResult;
+    if (result.ok()) {
+        threadPolicyResult.exceptionCode = EX_NONE;
+        return threadPolicyResult;
+    }
+    threadPolicyResult.exceptionCode = result.error().code();
+    threadPolicyResult.errorMessage = result.error().message();
+    return threadPolicyResult;
+}
+
+ThreadIdentifier toThreadIdentifier(const ThreadId& threadId) {
+    return ThreadIdentifier{.pid = threadId.pid, .tid = threadId.tid, .uid = threadId.uid};
+}
+
 ScopedAStatus checkSystemUser(const std::string& methodName) {
     if (IPCThreadState::self()->getCallingUid() != AID_SYSTEM) {
         return toScopedAStatus(EX_SECURITY,
@@ -221,6 +240,12 @@ ScopedAStatus WatchdogInternalHandler::registerCarWatchdogService(
     auto status = mWatchdogServiceHelper->registerService(service);
     if (status.isOk()) {
         mWatchdogPerfService->onCarWatchdogServiceRegistered();
+        // Lazy initialization of PackageInfoResolver.
+        if (mPackageInfoResolver == nullptr) {
+            mPackageInfoResolver = PackageInfoResolver::getInstance();
+        }
+        // Resolve the UIDs in a single batch before the next collections need them.
+        mPackageInfoResolver->asyncPrefetchPackageInfos();
     }
     return status;
 }
@@ -446,6 +471,52 @@ ScopedAStatus WatchdogInternalHandler::getThreadPriority(
     return ScopedAStatus::ok();
 }
 
+ScopedAStatus WatchdogInternalHandler::setThreadPriorities(
+        const std::vector<ThreadPolicyUpdate>& updates, std::vector<ThreadPolicyResult>* results) {
+    if (auto status = checkSystemUser(/*methodName=*/"setThreadPriorities"); !status.isOk()) {
+        return status;
+    }
+    std::vector<ThreadPriorityRequest> requests;
+    requests.reserve(updates.size());
+    for (const auto& update : updates) {
+        requests.push_back(ThreadPriorityRequest{
+                .thread = toThreadIdentifier(update.thread),
+                .policy = update.policyWithPriority.policy,
+                .priority = update.policyWithPriority.priority,
+        });
+    }
+    const auto setResults = mThreadPriorityController->setThreadPriorities(requests);
+    results->clear();
+    results->reserve(setResults.size());
+    for (const auto& result : setResults) {
+        results->push_back(toThreadPolicyResult(result));
+    }
+    return ScopedAStatus::ok();
+}
+
+ScopedAStatus WatchdogInternalHandler::getThreadPriorities(
+        const std::vector<ThreadId>& threads, std::vector<ThreadPolicyResult>* results) {
+    if (auto status = checkSystemUser(/*methodName=*/"getThreadPriorities"); !status.isOk()) {
+        return status;
+    }
+    std::vector<ThreadIdentifier> threadIdentifiers;
+    threadIdentifiers.reserve(threads.size());
+    for (const auto& thread : threads) {
+        threadIdentifiers.push_back(toThreadIdentifier(thread));
+    }
+    const auto getResults = mThreadPriorityController->getThreadPriorities(threadIdentifiers);
+    results->clear();
+    results->reserve(getResults.size());
+    for (const auto& result : getResults) {
+        auto threadPolicyResult = toThreadPolicyResult(result);
+        if (result.ok()) {
+            threadPolicyResult.policyWithPriority = *result;
+        }
+        results->push_back(std::move(threadPolicyResult));
+    }
+    return ScopedAStatus::ok();
+}
+
 ScopedAStatus WatchdogInternalHandler::onAidlVhalPidFetched(int pid) {
     if (auto status = checkSystemUser(/*methodName=*/"onAidlVhalPidFetched"); !status.isOk()) {
         return status;
@@ -459,6 +530,11 @@ void WatchdogInternalHandler::setThreadPriorityController(
     mThreadPriorityController = std::move(threadPriorityController);
 }
 
+void WatchdogInternalHandler::setPackageInfoResolver(
+        const sp<PackageInfoResolverInterface>& packageInfoResolver) {
+    mPackageInfoResolver = packageInfoResolver;
+}
+
 ScopedAStatus WatchdogInternalHandler::onTodayIoUsageStatsFetched(
         const std::vector<UserPackageIoUsageStats>& userPackageIoUsageStats) {
     if (auto status = checkSystemUser(/*methodName=*/"onTodayIoUsageStatsFetched");
@@ -18,6 +18,7 @@
 #define CPP_WATCHDOG_SERVER_SRC_WATCHDOGINTERNALHANDLER_H_
 
 #include "IoOveruseMonitor.h"
+#include "PackageInfoResolver.h"
 #include "ThreadPriorityController.h"
 #include "WatchdogPerfService.h"
 #include "WatchdogProcessService.h"
@@ -31,6 +32,9 @@
 #include <aidl/android/automotive/watchdog/internal/ProcessIdentifier.h>
 #include <aidl/android/automotive/watchdog/internal/ResourceOveruseConfiguration.h>
 #include <aidl/android/automotive/watchdog/internal/StateType.h>
+#include <aidl/android/automotive/watchdog/internal/ThreadId.h>
+#include <aidl/android/automotive/watchdog/internal/ThreadPolicyResult.h>
+#include <aidl/android/automotive/watchdog/internal/ThreadPolicyUpdate.h>
 #include <aidl/android/automotive/watchdog/internal/UserPackageIoUsageStats.h>
 #include <aidl/android/automotive/watchdog/internal/UserState.h>
 #include <android/binder_auto_utils.h>
@@ -68,6 +72,7 @@ public:
           mWatchdogProcessService(watchdogProcessService),
           mWatchdogPerfService(watchdogPerfService),
           mIoOveruseMonitor(ioOveruseMonitor),
+          mPackageInfoResolver(nullptr),
           mThreadPriorityController(std::make_unique<ThreadPriorityController>()) {}
     ~WatchdogInternalHandler() { terminate(); }
 
@@ -118,6 +123,15 @@ public:
             int pid, int tid, int uid,
             aidl::android::automotive::watchdog::internal::ThreadPolicyWithPriority*
                     threadPolicyWithPriority) override;
+    ndk::ScopedAStatus setThreadPriorities(
+            const std::vector<aidl::android::automotive::watchdog::internal::ThreadPolicyUpdate>&
+                    updates,
+            std::vector<aidl::android::automotive::watchdog::internal::ThreadPolicyResult>*
+                    results) override;
+    ndk::ScopedAStatus getThreadPriorities(
+            const std::vector<aidl::android::automotive::watchdog::internal::ThreadId>& threads,
+            std::vector<aidl::android::automotive::watchdog::internal::ThreadPolicyResult>*
+                    results) override;
     ndk::ScopedAStatus onAidlVhalPidFetched(int pid) override;
     ndk::ScopedAStatus onTodayIoUsageStatsFetched(
             const std::vector<
@@ -129,6 +143,7 @@ public:
         mWatchdogProcessService.clear();
         mWatchdogPerfService.clear();
         mIoOveruseMonitor.clear();
+        mPackageInfoResolver.clear();
     }
 
 private:
@@ -142,11 +157,14 @@ private:
             userid_t userId,
             const aidl::android::automotive::watchdog::internal::UserState& userState);
     void setThreadPriorityController(std::unique_ptr<ThreadPriorityControllerInterface> controller);
+    void setPackageInfoResolver(const android::sp<PackageInfoResolverInterface>& resolver);
 
     android::sp<WatchdogServiceHelperInterface> mWatchdogServiceHelper;
     android::sp<WatchdogProcessServiceInterface> mWatchdogProcessService;
     android::sp<WatchdogPerfServiceInterface> mWatchdogPerfService;
     android::sp<IoOveruseMonitorInterface> mIoOveruseMonitor;
+    // Lazily initialized. Local PackageInfoResolverInterface instance. Useful to mock in tests.
+    android::sp<PackageInfoResolverInterface> mPackageInfoResolver;
     std::unique_ptr<ThreadPriorityControllerInterface> mThreadPriorityController;
 
     // For unit tests.
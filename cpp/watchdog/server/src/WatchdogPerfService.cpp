@@ -27,9 +27,14 @@
 #include <log/log.h>
 #include <processgroup/sched_policy.h>
 
+#include <inttypes.h>
 #include <pthread.h>
 
+#include <algorithm>
+#include <functional>
 #include <iterator>
+#include <unordered_map>
+#include <unordered_set>
 #include <vector>
 
 #include <carwatchdog_daemon_dump.proto.h>
@@ -43,6 +48,8 @@ namespace watchdog {
 namespace {
 
 using ::aidl::android::automotive::watchdog::internal::ResourceStats;
+using ::aidl::android::automotive::watchdog::internal::UidIoUsageStats;
+using ::aidl::android::automotive::watchdog::internal::UidResourceUsageStats;
 using ::aidl::android::automotive::watchdog::internal::UserState;
 using ::android::sp;
 using ::android::String16;
@@ -172,6 +179,74 @@ bool isEmpty(const ResourceStats& resourceStats) {
             !resourceStats.resourceOveruseStats.has_value();
 }
 
+// Merges the per-UID usage stats of the same UID reported by different data processors. Stats
+// missing from |mergedStats| are taken from |processorStats|.
+void mergeUidResourceUsageStats(UidResourceUsageStats processorStats,
+                                UidResourceUsageStats* mergedStats) {
+    mergedStats->uidUptimeMillis =
+            std::max(mergedStats->uidUptimeMillis, processorStats.uidUptimeMillis);
+    if (mergedStats->cpuUsageStats.cpuTimeMillis == 0 &&
+        mergedStats->cpuUsageStats.cpuCycles == 0) {
+        mergedStats->cpuUsageStats = processorStats.cpuUsageStats;
+    }
+    std::unordered_set<int32_t> mergedPids;
+    for (const auto& processStats : mergedStats->processCpuUsageStats) {
+        mergedPids.insert(processStats.pid);
+    }
+    for (auto& processStats : processorStats.processCpuUsageStats) {
+        if (mergedPids.insert(processStats.pid).second) {
+            mergedStats->processCpuUsageStats.push_back(std::move(processStats));
+        }
+    }
+    if (mergedStats->ioUsageStats == UidIoUsageStats{}) {
+        mergedStats->ioUsageStats = processorStats.ioUsageStats;
+    }
+}
+
+// Merges the resource stats reported by a data processor into |mergedStats|. The first usage
+// stats are kept and the per-UID usage stats from the later ones are merged per UID. Overuse stats
+// are appended.
+void mergeResourceStats(ResourceStats processorStats, ResourceStats* mergedStats) {
+    if (processorStats.resourceUsageStats.has_value()) {
+        if (!mergedStats->resourceUsageStats.has_value()) {
+            mergedStats->resourceUsageStats = std::move(processorStats.resourceUsageStats);
+        } else {
+            auto& mergedUidStats = mergedStats->resourceUsageStats->uidResourceUsageStats;
+            std::unordered_map<int32_t, size_t> mergedIndicesByUid;
+            for (size_t i = 0; i < mergedUidStats.size(); ++i) {
+                mergedIndicesByUid.emplace(mergedUidStats[i].packageIdentifier.uid, i);
+            }
+            for (auto& uidStats : processorStats.resourceUsageStats->uidResourceUsageStats) {
+                const int32_t uid = uidStats.packageIdentifier.uid;
+                if (const auto it = mergedIndicesByUid.find(uid); it != mergedIndicesByUid.end()) {
+                    mergeUidResourceUsageStats(std::move(uidStats), &mergedUidStats[it->second]);
+                    continue;
+                }
+                mergedIndicesByUid.emplace(uid, mergedUidStats.size());
+                mergedUidStats.push_back(std::move(uidStats));
+            }
+        }
+    }
+    if (!processorStats.resourceOveruseStats.has_value()) {
+        return;
+    }
+    if (!mergedStats->resourceOveruseStats.has_value()) {
+        mergedStats->resourceOveruseStats = std::move(processorStats.resourceOveruseStats);
+        return;
+    }
+    auto& mergedIoOveruseStats = mergedStats->resourceOveruseStats->packageIoOveruseStats;
+    auto& processorIoOveruseStats = processorStats.resourceOveruseStats->packageIoOveruseStats;
+    mergedIoOveruseStats.insert(mergedIoOveruseStats.end(),
+                                std::make_move_iterator(processorIoOveruseStats.begin()),
+                                std::make_move_iterator(processorIoOveruseStats.end()));
+    auto& mergedMemoryOveruseStats = mergedStats->resourceOveruseStats->packageMemoryOveruseStats;
+    auto& processorMemoryOveruseStats =
+            processorStats.resourceOveruseStats->packageMemoryOveruseStats;
+    mergedMemoryOveruseStats.insert(mergedMemoryOveruseStats.end(),
+                                    std::make_move_iterator(processorMemoryOveruseStats.begin()),
+                                    std::make_move_iterator(processorMemoryOveruseStats.end()));
+}
+
 }  // namespace
 
 std::string WatchdogPerfService::EventMetadata::toString() const {
@@ -197,6 +272,11 @@ Result<void> WatchdogPerfService::registerDataProcessor(sp<DataProcessorInterfac
     }
     Mutex::Autolock lock(mMutex);
     mDataProcessors.push_back(processor);
+    mDataProcessorTimings.push_back({});
+    {
+        Mutex::Autolock monitorLock(mMonitorMutex);
+        mMonitorDataProcessors.push_back(processor);
+    }
     if (DEBUG) {
         ALOGD("Successfully registered %s to %s", processor->name().c_str(), kServiceName);
     }
@@ -240,10 +320,6 @@ Result<void> WatchdogPerfService::start() {
                 .eventType = EventType::WAKE_UP_COLLECTION,
                 .pollingIntervalNs = systemEventCollectionInterval,
         };
-        mPeriodicMonitor = {
-                .eventType = EventType::PERIODIC_MONITOR,
-                .pollingIntervalNs = periodicMonitorInterval,
-        };
         if (mDataProcessors.empty()) {
             ALOGE("Terminating %s: No data processor is registered", kServiceName);
             mCurrCollectionEvent = EventType::TERMINATED;
@@ -251,7 +327,38 @@ Result<void> WatchdogPerfService::start() {
         }
         mUidStatsCollector->init();
         mProcStatCollector->init();
+
+        Mutex::Autolock monitorLock(mMonitorMutex);
+        mPeriodicMonitor = {
+                .eventType = EventType::PERIODIC_MONITOR,
+                .pollingIntervalNs = periodicMonitorInterval,
+        };
         mProcDiskStatsCollector->init();
+        /*
+         * The monitor runs on its own thread unless it shares the collection looper. The monitor
+         * thread keeps the default scheduling policy so the monitor isn't starved by the
+         * background collection thread.
+         */
+        if (mMonitorLooper != mHandlerLooper) {
+            mMonitorLooper->setLooper(sp<Looper>::make(/*allowNonCallbacks=*/false));
+            mMonitorThread = std::thread([&]() {
+                if (int result = pthread_setname_np(pthread_self(), "WdPerfMonitor");
+                    result != 0) {
+                    ALOGE("Failed to set %s monitor thread name: %d", kServiceName, result);
+                }
+                bool isMonitorTerminated = false;
+                while (!isMonitorTerminated) {
+                    sp<LooperWrapper> looper;
+                    {
+                        Mutex::Autolock lock(mMonitorMutex);
+                        looper = mMonitorLooper;
+                    }
+                    looper->pollAll(/*timeoutMillis=*/-1);
+                    Mutex::Autolock lock(mMonitorMutex);
+                    isMonitorTerminated = mIsMonitorTerminated;
+                }
+            });
+        }
     }
 
     mCollectionThread = std::thread([&]() {
@@ -292,6 +399,7 @@ Result<void> WatchdogPerfService::start() {
 }
 
 void WatchdogPerfService::terminate() {
+    bool isMonitorStarted = mMonitorThread.joinable();
     {
         Mutex::Autolock lock(mMutex);
         if (mCurrCollectionEvent == EventType::TERMINATED) {
@@ -306,6 +414,7 @@ void WatchdogPerfService::terminate() {
              */
             mHandlerLooper->removeMessages(sp<WatchdogPerfService>::fromExisting(this));
             mHandlerLooper->wake();
+            isMonitorStarted = true;
         }
         for (const auto& processor : mDataProcessors) {
             processor->terminate();
@@ -313,12 +422,22 @@ void WatchdogPerfService::terminate() {
         mCurrCollectionEvent = EventType::TERMINATED;
         mUnsentResourceStats.clear();
     }
+    if (isMonitorStarted) {
+        terminatePeriodicMonitor();
+    }
     if (mCollectionThread.joinable()) {
         mCollectionThread.join();
         if (DEBUG) {
             ALOGD("%s collection thread terminated", kServiceName);
         }
     }
+    if (mMonitorThread.joinable()) {
+        mMonitorThread.join();
+        if (DEBUG) {
+            ALOGD("%s monitor thread terminated", kServiceName);
+        }
+    }
+    mDataProcessorExecutor->terminate();
 }
 
 void WatchdogPerfService::setSystemState(SystemState systemState) {
@@ -445,6 +564,7 @@ Result<void> WatchdogPerfService::onUserStateChange(userid_t userId, const UserS
 Result<void> WatchdogPerfService::startUserSwitchCollection() {
     auto thiz = sp<WatchdogPerfService>::fromExisting(this);
     mHandlerLooper->removeMessages(thiz);
+    stopPeriodicMonitor();
     mUserSwitchCollection.lastPollUptimeNs = mHandlerLooper->now();
     // End |EventType::USER_SWITCH_COLLECTION| after a timeout because the user switch end
     // signal won't be received within a few seconds when the switch is blocked due to a
@@ -474,6 +594,7 @@ Result<void> WatchdogPerfService::onSuspendExit() {
     notifySystemStartUpLocked();
     auto thiz = sp<WatchdogPerfService>::fromExisting(this);
     mHandlerLooper->removeMessages(thiz);
+    stopPeriodicMonitor();
     nsecs_t now = mHandlerLooper->now();
     mWakeUpCollection.lastPollUptimeNs = now;
     mHandlerLooper->sendMessageAtTime(now + mWakeUpDurationNs.count(), thiz,
@@ -600,6 +721,21 @@ Result<void> WatchdogPerfService::onDump(int fd) const {
                 << "Failed to dump the boot-time and periodic collection reports.";
     }
 
+    {
+        Mutex::Autolock monitorLock(mMonitorMutex);
+        if (!WriteStringToFd(StringPrintf("\nPeriodic monitor information:\n%s\n",
+                                          std::string(29, '=').c_str()),
+                             fd) ||
+            !WriteStringToFd(mPeriodicMonitor.toString(), fd) ||
+            !WriteStringToFd(mMonitorJitterStats.toString(), fd)) {
+            return Error(FAILED_TRANSACTION) << "Failed to dump the periodic monitor information.";
+        }
+    }
+
+    if (const auto result = dumpDataProcessorTimingsLocked(fd); !result.ok()) {
+        return Error(FAILED_TRANSACTION) << result.error();
+    }
+
     for (const auto& processor : mDataProcessors) {
         if (const auto result = processor->onDump(fd); !result.ok()) {
             return result;
@@ -657,6 +793,34 @@ bool WatchdogPerfService::dumpHelpText(int fd) const {
                            fd);
 }
 
+Result<void> WatchdogPerfService::dumpDataProcessorTimingsLocked(int fd) const {
+    std::string buffer = StringPrintf("\nData processor timings:\n%s\n",
+                                      std::string(23, '=').c_str());
+    for (size_t i = 0; i < mDataProcessors.size() && i < mDataProcessorTimings.size(); ++i) {
+        const auto& timing = mDataProcessorTimings[i];
+        int64_t averageDurationMicros = timing.collectionCount == 0
+                ? 0
+                : std::chrono::duration_cast<std::chrono::microseconds>(timing.totalDurationNs)
+                                  .count() /
+                        timing.collectionCount;
+        StringAppendF(&buffer,
+                      "%s: collections: %" PRIi64 ", last: %" PRIi64 " us, average: %" PRIi64
+                      " us, max: %" PRIi64 " us\n",
+                      mDataProcessors[i]->name().c_str(), timing.collectionCount,
+                      static_cast<int64_t>(std::chrono::duration_cast<std::chrono::microseconds>(
+                                                   timing.lastDurationNs)
+                                                   .count()),
+                      averageDurationMicros,
+                      static_cast<int64_t>(std::chrono::duration_cast<std::chrono::microseconds>(
+                                                   timing.maxDurationNs)
+                                                   .count()));
+    }
+    if (!WriteStringToFd(buffer, fd)) {
+        return Error() << "Failed to write data processor timings";
+    }
+    return {};
+}
+
 Result<void> WatchdogPerfService::dumpCollectorsStatusLocked(int fd) const {
     if (!mUidStatsCollector->enabled() &&
         !WriteStringToFd(StringPrintf("UidStatsCollector failed to access proc and I/O files"),
@@ -695,6 +859,7 @@ Result<void> WatchdogPerfService::startCustomCollection(
 
     auto thiz = sp<WatchdogPerfService>::fromExisting(this);
     mHandlerLooper->removeMessages(thiz);
+    stopPeriodicMonitor();
     mHandlerLooper->sendMessageAtTime(now + maxDuration.count(), thiz,
                                       SwitchMessage::END_CUSTOM_COLLECTION);
     mCurrCollectionEvent = EventType::CUSTOM_COLLECTION;
@@ -711,6 +876,7 @@ Result<void> WatchdogPerfService::endCustomCollection(int fd) {
 
     auto thiz = sp<WatchdogPerfService>::fromExisting(this);
     mHandlerLooper->removeMessages(thiz);
+    stopPeriodicMonitor();
     mHandlerLooper->sendMessage(thiz, SwitchMessage::END_CUSTOM_COLLECTION);
 
     if (const auto result = dumpCollectorsStatusLocked(fd); !result.ok()) {
@@ -756,10 +922,7 @@ void WatchdogPerfService::switchToPeriodicLocked(bool startNow) {
         mHandlerLooper->sendMessageAtTime(mPeriodicCollection.lastPollUptimeNs, thiz,
                                           EventType::PERIODIC_COLLECTION);
     }
-    mPeriodicMonitor.lastPollUptimeNs =
-            mHandlerLooper->now() + mPeriodicMonitor.pollingIntervalNs.count();
-    mHandlerLooper->sendMessageAtTime(mPeriodicMonitor.lastPollUptimeNs, thiz,
-                                      EventType::PERIODIC_MONITOR);
+    startPeriodicMonitor();
     ALOGI("Switching to %s and %s", toString(mCurrCollectionEvent),
           toString(EventType::PERIODIC_MONITOR));
 }
@@ -842,6 +1005,7 @@ void WatchdogPerfService::handleMessage(const Message& message) {
         mCurrCollectionEvent = EventType::TERMINATED;
         mHandlerLooper->removeMessages(sp<WatchdogPerfService>::fromExisting(this));
         mHandlerLooper->wake();
+        terminatePeriodicMonitor();
     }
 }
 
@@ -878,6 +1042,8 @@ Result<void> WatchdogPerfService::processCollectionEvent(
     mHandlerLooper->sendMessageAtTime(metadata->lastPollUptimeNs,
                                       sp<WatchdogPerfService>::fromExisting(this),
                                       metadata->eventType);
+    // Handle the collection requested by the periodic monitor while this collection was running.
+    handleCollectionRequestLocked();
     return {};
 }
 
@@ -891,6 +1057,9 @@ Result<void> WatchdogPerfService::collectLocked(WatchdogPerfService::EventMetada
     int64_t timeSinceBootMillis = kGetElapsedTimeSinceBootMillisFunc();
 
     if (mUidStatsCollector->enabled()) {
+        // Only the custom collections have filter packages. Pushing them down to the collector
+        // skips reading the /proc files of the other packages' processes.
+        mUidStatsCollector->setFilterPackages(metadata->filterPackages);
         if (const auto result = mUidStatsCollector->collect(); !result.ok()) {
             return Error() << "Failed to collect per-uid proc and I/O stats: " << result.error();
         }
@@ -902,42 +1071,47 @@ Result<void> WatchdogPerfService::collectLocked(WatchdogPerfService::EventMetada
         }
     }
 
-    ResourceStats resourceStats = {};
+    /*
+     * Each processor writes to its own resource stats, which are merged in the registration order
+     * once all processors finish, so the merged stats don't depend on the processors' scheduling.
+     * The collectors and the arguments are copied so the worker threads don't access any state
+     * guarded by |mMutex|.
+     */
+    const size_t processorCount = mDataProcessors.size();
+    const std::vector<sp<DataProcessorInterface>> processors = mDataProcessors;
+    const sp<UidStatsCollectorInterface> uidStatsCollector = mUidStatsCollector;
+    const sp<ProcStatCollectorInterface> procStatCollector = mProcStatCollector;
+    const EventType eventType = mCurrCollectionEvent;
+    const SystemState systemState = mSystemState;
+    std::vector<ResourceStats> processorResourceStats(processorCount);
+    std::vector<Result<void>> processorResults(processorCount);
+    std::vector<std::chrono::nanoseconds> processorDurationsNs(processorCount);
+    std::vector<std::function<void()>> tasks;
+    tasks.reserve(processorCount);
+    for (size_t i = 0; i < processorCount; ++i) {
+        tasks.push_back([&, i]() {
+            const auto startTime = std::chrono::steady_clock::now();
+            processorResults[i] =
+                    runDataProcessor(processors[i], eventType, *metadata, now, systemState,
+                                     uidStatsCollector, procStatCollector,
+                                     &processorResourceStats[i]);
+            processorDurationsNs[i] = std::chrono::steady_clock::now() - startTime;
+        });
+    }
+    mDataProcessorExecutor->runAll(tasks);
 
-    for (const auto& processor : mDataProcessors) {
-        Result<void> result;
-        switch (mCurrCollectionEvent) {
-            case EventType::BOOT_TIME_COLLECTION:
-                result = processor->onBoottimeCollection(now, mUidStatsCollector,
-                                                         mProcStatCollector, &resourceStats);
-                break;
-            case EventType::PERIODIC_COLLECTION:
-                result = processor->onPeriodicCollection(now, mSystemState, mUidStatsCollector,
-                                                         mProcStatCollector, &resourceStats);
-                break;
-            case EventType::USER_SWITCH_COLLECTION: {
-                WatchdogPerfService::UserSwitchEventMetadata* userSwitchMetadata =
-                        static_cast<WatchdogPerfService::UserSwitchEventMetadata*>(metadata);
-                result = processor->onUserSwitchCollection(now, userSwitchMetadata->from,
-                                                           userSwitchMetadata->to,
-                                                           mUidStatsCollector, mProcStatCollector);
-                break;
-            }
-            case EventType::WAKE_UP_COLLECTION:
-                result = processor->onWakeUpCollection(now, mUidStatsCollector, mProcStatCollector);
-                break;
-            case EventType::CUSTOM_COLLECTION:
-                result = processor->onCustomCollection(now, mSystemState, metadata->filterPackages,
-                                                       mUidStatsCollector, mProcStatCollector,
-                                                       &resourceStats);
-                break;
-            default:
-                result = Error() << "Invalid collection event " << toString(mCurrCollectionEvent);
+    ResourceStats resourceStats = {};
+    for (size_t i = 0; i < processorCount; ++i) {
+        if (i < mDataProcessorTimings.size()) {
+            mDataProcessorTimings[i].update(processorDurationsNs[i]);
         }
-        if (!result.ok()) {
-            return Error() << processor->name() << " failed on " << toString(mCurrCollectionEvent)
-                           << " collection: " << result.error();
+    }
+    for (size_t i = 0; i < processorCount; ++i) {
+        if (!processorResults[i].ok()) {
+            return Error() << processors[i]->name() << " failed on " << toString(eventType)
+                           << " collection: " << processorResults[i].error();
         }
+        mergeResourceStats(std::move(processorResourceStats[i]), &resourceStats);
     }
 
     if (!isEmpty(resourceStats)) {
@@ -964,11 +1138,53 @@ Result<void> WatchdogPerfService::collectLocked(WatchdogPerfService::EventMetada
     return {};
 }
 
+Result<void> WatchdogPerfService::runDataProcessor(
+        const sp<DataProcessorInterface>& processor, EventType eventType,
+        const EventMetadata& metadata, time_point_millis time, SystemState systemState,
+        const sp<UidStatsCollectorInterface>& uidStatsCollector,
+        const sp<ProcStatCollectorInterface>& procStatCollector, ResourceStats* resourceStats) {
+    switch (eventType) {
+        case EventType::BOOT_TIME_COLLECTION:
+            return processor->onBoottimeCollection(time, uidStatsCollector, procStatCollector,
+                                                   resourceStats);
+        case EventType::PERIODIC_COLLECTION:
+            return processor->onPeriodicCollection(time, systemState, uidStatsCollector,
+                                                   procStatCollector, resourceStats);
+        case EventType::USER_SWITCH_COLLECTION: {
+            const auto& userSwitchMetadata =
+                    static_cast<const WatchdogPerfService::UserSwitchEventMetadata&>(metadata);
+            return processor->onUserSwitchCollection(time, userSwitchMetadata.from,
+                                                     userSwitchMetadata.to, uidStatsCollector,
+                                                     procStatCollector);
+        }
+        case EventType::WAKE_UP_COLLECTION:
+            return processor->onWakeUpCollection(time, uidStatsCollector, procStatCollector);
+        case EventType::CUSTOM_COLLECTION:
+            return processor->onCustomCollection(time, systemState, metadata.filterPackages,
+                                                 uidStatsCollector, procStatCollector,
+                                                 resourceStats);
+        default:
+            return Error() << "Invalid collection event " << toString(eventType);
+    }
+}
+
+void WatchdogPerfService::DataProcessorTiming::update(std::chrono::nanoseconds durationNs) {
+    lastDurationNs = durationNs;
+    maxDurationNs = std::max(maxDurationNs, durationNs);
+    totalDurationNs += durationNs;
+    ++collectionCount;
+}
+
 Result<void> WatchdogPerfService::processMonitorEvent(
         WatchdogPerfService::EventMetadata* metadata) {
+    Mutex::Autolock lock(mMonitorMutex);
     if (metadata->eventType != static_cast<int>(EventType::PERIODIC_MONITOR)) {
         return Error() << "Invalid monitor event " << toString(metadata->eventType);
     }
+    if (!mIsMonitorActive) {
+        // The monitor was stopped after this event was dispatched.
+        return {};
+    }
     if (DEBUG) {
         ALOGD("Processing %s monitor event", toString(metadata->eventType));
     }
@@ -981,7 +1197,8 @@ Result<void> WatchdogPerfService::processMonitorEvent(
                 << std::chrono::duration_cast<std::chrono::seconds>(kMinEventInterval).count()
                 << " seconds";
     }
-    Mutex::Autolock lock(mMutex);
+    mMonitorJitterStats.update(
+            std::chrono::nanoseconds(mMonitorLooper->now() - metadata->lastPollUptimeNs));
     if (!mProcDiskStatsCollector->enabled()) {
         return Error() << "Cannot access proc disk stats for monitoring";
     }
@@ -989,30 +1206,15 @@ Result<void> WatchdogPerfService::processMonitorEvent(
     if (const auto result = mProcDiskStatsCollector->collect(); !result.ok()) {
         return Error() << "Failed to collect disk stats: " << result.error();
     }
-    auto* currCollectionMetadata = getCurrentCollectionMetadataLocked();
-    if (currCollectionMetadata == nullptr) {
-        return Error() << "No metadata available for current collection event: "
-                       << toString(mCurrCollectionEvent);
-    }
     bool requestedCollection = false;
-    auto thiz = sp<WatchdogPerfService>::fromExisting(this);
     const auto requestCollection = [&]() mutable {
         if (requestedCollection) {
             return;
         }
-        const nsecs_t prevUptimeNs = currCollectionMetadata->lastPollUptimeNs -
-                currCollectionMetadata->pollingIntervalNs.count();
-        nsecs_t uptimeNs = mHandlerLooper->now();
-        if (const auto delta = std::abs(uptimeNs - prevUptimeNs);
-            delta < kMinEventInterval.count()) {
-            return;
-        }
-        currCollectionMetadata->lastPollUptimeNs = uptimeNs;
-        mHandlerLooper->removeMessages(thiz, currCollectionMetadata->eventType);
-        mHandlerLooper->sendMessage(thiz, currCollectionMetadata->eventType);
         requestedCollection = true;
+        requestCollectionFromMonitor();
     };
-    for (const auto& processor : mDataProcessors) {
+    for (const auto& processor : mMonitorDataProcessors) {
         if (const auto result =
                     processor->onPeriodicMonitor(now, mProcDiskStatsCollector, requestCollection);
             !result.ok()) {
@@ -1020,18 +1222,110 @@ Result<void> WatchdogPerfService::processMonitorEvent(
                            << ": " << result.error();
         }
     }
+    if (!requestedCollection && mIsCollectionRequested) {
+        // Retry the collection request deferred by a running collection.
+        requestCollectionFromMonitor();
+    }
     metadata->lastPollUptimeNs += metadata->pollingIntervalNs.count();
-    if (metadata->lastPollUptimeNs == currCollectionMetadata->lastPollUptimeNs) {
-        /*
-         * If the |PERIODIC_MONITOR| and  *_COLLECTION events overlap, skip the |PERIODIC_MONITOR|
-         * event.
-         */
-        metadata->lastPollUptimeNs += metadata->pollingIntervalNs.count();
+    // Never wait on |mMutex| here. When it is busy, the overlap check is skipped.
+    if (mMutex.tryLock() == NO_ERROR) {
+        if (const auto* currCollectionMetadata = getCurrentCollectionMetadataLocked();
+            currCollectionMetadata != nullptr &&
+            metadata->lastPollUptimeNs == currCollectionMetadata->lastPollUptimeNs) {
+            /*
+             * If the |PERIODIC_MONITOR| and  *_COLLECTION events overlap, skip the
+             * |PERIODIC_MONITOR| event.
+             */
+            metadata->lastPollUptimeNs += metadata->pollingIntervalNs.count();
+        }
+        mMutex.unlock();
     }
-    mHandlerLooper->sendMessageAtTime(metadata->lastPollUptimeNs, thiz, metadata->eventType);
+    mMonitorLooper->sendMessageAtTime(metadata->lastPollUptimeNs,
+                                      sp<WatchdogPerfService>::fromExisting(this),
+                                      metadata->eventType);
     return {};
 }
 
+void WatchdogPerfService::MonitorJitterStats::update(std::chrono::nanoseconds delayNs) {
+    delayNs = std::max(delayNs, std::chrono::nanoseconds(0));
+    ++eventCount;
+    totalDelayNs += delayNs;
+    maxDelayNs = std::max(maxDelayNs, delayNs);
+}
+
+std::string WatchdogPerfService::MonitorJitterStats::toString() const {
+    int64_t averageDelayMicros = eventCount == 0
+            ? 0
+            : std::chrono::duration_cast<std::chrono::microseconds>(totalDelayNs).count() /
+                    eventCount;
+    return StringPrintf("Monitor events: %" PRIi64 ", average delay: %" PRIi64
+                        " us, max delay: %" PRIi64 " us\n",
+                        eventCount, averageDelayMicros,
+                        static_cast<int64_t>(
+                                std::chrono::duration_cast<std::chrono::microseconds>(maxDelayNs)
+                                        .count()));
+}
+
+void WatchdogPerfService::startPeriodicMonitor() {
+    Mutex::Autolock lock(mMonitorMutex);
+    auto thiz = sp<WatchdogPerfService>::fromExisting(this);
+    mMonitorLooper->removeMessages(thiz, EventType::PERIODIC_MONITOR);
+    mIsMonitorActive = true;
+    mPeriodicMonitor.lastPollUptimeNs =
+            mMonitorLooper->now() + mPeriodicMonitor.pollingIntervalNs.count();
+    mMonitorLooper->sendMessageAtTime(mPeriodicMonitor.lastPollUptimeNs, thiz,
+                                      EventType::PERIODIC_MONITOR);
+}
+
+void WatchdogPerfService::stopPeriodicMonitor() {
+    Mutex::Autolock lock(mMonitorMutex);
+    mIsMonitorActive = false;
+    mMonitorLooper->removeMessages(sp<WatchdogPerfService>::fromExisting(this),
+                                   EventType::PERIODIC_MONITOR);
+}
+
+void WatchdogPerfService::terminatePeriodicMonitor() {
+    Mutex::Autolock lock(mMonitorMutex);
+    mIsMonitorActive = false;
+    mIsMonitorTerminated = true;
+    mMonitorLooper->removeMessages(sp<WatchdogPerfService>::fromExisting(this),
+                                   EventType::PERIODIC_MONITOR);
+    mMonitorLooper->wake();
+}
+
+void WatchdogPerfService::requestCollectionFromMonitor() {
+    mIsCollectionRequested = true;
+    if (mMutex.tryLock() != NO_ERROR) {
+        if (DEBUG) {
+            ALOGD("Deferring the collection requested by %s until the running collection ends",
+                  toString(EventType::PERIODIC_MONITOR));
+        }
+        return;
+    }
+    handleCollectionRequestLocked();
+    mMutex.unlock();
+}
+
+void WatchdogPerfService::handleCollectionRequestLocked() {
+    if (!mIsCollectionRequested.exchange(false)) {
+        return;
+    }
+    auto* currCollectionMetadata = getCurrentCollectionMetadataLocked();
+    if (currCollectionMetadata == nullptr) {
+        return;
+    }
+    const nsecs_t prevUptimeNs = currCollectionMetadata->lastPollUptimeNs -
+            currCollectionMetadata->pollingIntervalNs.count();
+    nsecs_t uptimeNs = mHandlerLooper->now();
+    if (const auto delta = std::abs(uptimeNs - prevUptimeNs); delta < kMinEventInterval.count()) {
+        return;
+    }
+    auto thiz = sp<WatchdogPerfService>::fromExisting(this);
+    currCollectionMetadata->lastPollUptimeNs = uptimeNs;
+    mHandlerLooper->removeMessages(thiz, currCollectionMetadata->eventType);
+    mHandlerLooper->sendMessage(thiz, currCollectionMetadata->eventType);
+}
+
 Result<void> WatchdogPerfService::sendResourceStats() {
     std::vector<ResourceStats> unsentResourceStats = {};
     {
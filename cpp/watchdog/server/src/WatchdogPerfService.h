@@ -17,6 +17,7 @@
 #ifndef CPP_WATCHDOG_SERVER_SRC_WATCHDOGPERFSERVICE_H_
 #define CPP_WATCHDOG_SERVER_SRC_WATCHDOGPERFSERVICE_H_
 
+#include "DataProcessorExecutor.h"
 #include "LooperWrapper.h"
 #include "ProcDiskStatsCollector.h"
 #include "ProcStatCollector.h"
@@ -29,6 +30,7 @@
 #include <aidl/android/automotive/watchdog/internal/UserState.h>
 #include <android-base/chrono_utils.h>
 #include <android-base/result.h>
+#include <android-base/thread_annotations.h>
 #include <android/util/ProtoOutputStream.h>
 #include <cutils/multiuser.h>
 #include <gtest/gtest_prod.h>
@@ -42,9 +44,12 @@
 
 #include <time.h>
 
+#include <atomic>
+#include <memory>
 #include <string>
 #include <thread>  // NOLINT(build/c++11)
 #include <unordered_set>
+#include <vector>
 
 namespace android {
 namespace automotive {
@@ -126,7 +131,9 @@ public:
 
     /**
      * Callback to process the data collected on custom collection and filter the results only to
-     * the specified |filterPackages|.
+     * the specified |filterPackages|. When |filterPackages| isn't empty, the per-process stats
+     * aren't collected for the other packages, so their latest per-process stats are stale and
+     * their delta per-process stats are missing.
      */
     virtual android::base::Result<void> onCustomCollection(
             time_point_millis time, SystemState systemState,
@@ -282,7 +289,14 @@ public:
           mProcStatCollector(android::sp<ProcStatCollector>::make()),
           mProcDiskStatsCollector(android::sp<ProcDiskStatsCollector>::make()),
           mDataProcessors({}),
-          mWatchdogServiceHelper(watchdogServiceHelper) {}
+          mWatchdogServiceHelper(watchdogServiceHelper),
+          mDataProcessorExecutor(
+                  std::make_unique<DataProcessorExecutor>(kMaxDataProcessorWorkerThreads)),
+          mMonitorLooper(android::sp<LooperWrapper>::make()),
+          mIsMonitorActive(false),
+          mIsMonitorTerminated(false),
+          mMonitorJitterStats({}),
+          mIsCollectionRequested(false) {}
 
     android::base::Result<void> registerDataProcessor(
             android::sp<DataProcessorInterface> processor) override;
@@ -335,6 +349,59 @@ private:
         userid_t to = 0;
     };
 
+    // Time taken by a data processor to process the collections.
+    struct DataProcessorTiming {
+        std::chrono::nanoseconds lastDurationNs = 0ns;
+        std::chrono::nanoseconds maxDurationNs = 0ns;
+        std::chrono::nanoseconds totalDurationNs = 0ns;
+        int64_t collectionCount = 0;
+
+        void update(std::chrono::nanoseconds durationNs);
+    };
+
+    /**
+     * Calls the |processor|'s callback for the |eventType| collection. Reads only its arguments, so
+     * it is safe to call from a |mDataProcessorExecutor| worker thread.
+     */
+    static android::base::Result<void> runDataProcessor(
+            const android::sp<DataProcessorInterface>& processor, EventType eventType,
+            const EventMetadata& metadata, time_point_millis time, SystemState systemState,
+            const android::sp<UidStatsCollectorInterface>& uidStatsCollector,
+            const android::sp<ProcStatCollectorInterface>& procStatCollector,
+            aidl::android::automotive::watchdog::internal::ResourceStats* resourceStats);
+
+    // Dumps the time taken by the data processors.
+    android::base::Result<void> dumpDataProcessorTimingsLocked(int fd) const;
+
+    // Delay of the periodic monitor events from their scheduled time.
+    struct MonitorJitterStats {
+        int64_t eventCount = 0;
+        std::chrono::nanoseconds totalDelayNs = 0ns;
+        std::chrono::nanoseconds maxDelayNs = 0ns;
+
+        void update(std::chrono::nanoseconds delayNs);
+        std::string toString() const;
+    };
+
+    // Schedules the periodic monitor on |mMonitorLooper|, replacing any scheduled monitor event.
+    void startPeriodicMonitor() EXCLUDES(mMonitorMutex);
+
+    // Removes the scheduled periodic monitor event. A running monitor event won't reschedule.
+    void stopPeriodicMonitor() EXCLUDES(mMonitorMutex);
+
+    // Stops the periodic monitor and ends the monitor thread's loop.
+    void terminatePeriodicMonitor() EXCLUDES(mMonitorMutex);
+
+    /**
+     * Requests an early collection on behalf of a data processor's monitor alert. Handled right
+     * away when |mMutex| is free. Otherwise, a collection is running, and the request is handled
+     * once the collection finishes, so the monitor never waits for a collection.
+     */
+    void requestCollectionFromMonitor();
+
+    // Starts the current collection immediately if |mIsCollectionRequested| is set.
+    void handleCollectionRequestLocked();
+
     // Dumps the collectors' status when they are disabled.
     android::base::Result<void> dumpCollectorsStatusLocked(int fd) const;
 
@@ -436,7 +503,7 @@ private:
     EventMetadata mCustomCollection GUARDED_BY(mMutex);
 
     // Info for the |EventType::PERIODIC_MONITOR| monitor event.
-    EventMetadata mPeriodicMonitor GUARDED_BY(mMutex);
+    EventMetadata mPeriodicMonitor GUARDED_BY(mMonitorMutex);
 
     // Cache of resource stats that have not been sent to CarWatchdogService.
     std::vector<std::tuple<nsecs_t, aidl::android::automotive::watchdog::internal::ResourceStats>>
@@ -457,7 +524,8 @@ private:
     android::sp<ProcStatCollectorInterface> mProcStatCollector GUARDED_BY(mMutex);
 
     // Collector/parser for `/proc/diskstats` file.
-    android::sp<ProcDiskStatsCollectorInterface> mProcDiskStatsCollector GUARDED_BY(mMutex);
+    android::sp<ProcDiskStatsCollectorInterface> mProcDiskStatsCollector
+            GUARDED_BY(mMonitorMutex);
 
     // Data processors for the collected performance data.
     std::vector<android::sp<DataProcessorInterface>> mDataProcessors GUARDED_BY(mMutex);
@@ -465,6 +533,44 @@ private:
     // Helper to communicate with the CarWatchdogService.
     android::sp<WatchdogServiceHelperInterface> mWatchdogServiceHelper GUARDED_BY(mMutex);
 
+    /**
+     * Runs the data processors concurrently during a collection. The collectors aren't updated
+     * until all processors finish, so the processors share a frozen snapshot of the collected data.
+     */
+    std::unique_ptr<DataProcessorExecutor> mDataProcessorExecutor;
+
+    // Timing for each processor in |mDataProcessors|, in the same order.
+    std::vector<DataProcessorTiming> mDataProcessorTimings GUARDED_BY(mMutex);
+
+    /**
+     * The periodic monitor runs on its own thread and looper so a slow collection doesn't delay
+     * it. The monitor never blocks on |mMutex|. When locking both, |mMutex| must be locked first.
+     */
+    mutable Mutex mMonitorMutex;
+
+    // Thread on which the periodic monitor runs.
+    std::thread mMonitorThread;
+
+    // Handler looper for the |EventType::PERIODIC_MONITOR| events on the monitor thread. Tests may
+    // share |mHandlerLooper| here, in which case the monitor runs on the collection thread.
+    android::sp<LooperWrapper> mMonitorLooper GUARDED_BY(mMonitorMutex);
+
+    // Data processors notified on the periodic monitor events. Copy of |mDataProcessors|.
+    std::vector<android::sp<DataProcessorInterface>> mMonitorDataProcessors
+            GUARDED_BY(mMonitorMutex);
+
+    // Whether the periodic monitor is scheduled.
+    bool mIsMonitorActive GUARDED_BY(mMonitorMutex);
+
+    // Whether the monitor thread should exit.
+    bool mIsMonitorTerminated GUARDED_BY(mMonitorMutex);
+
+    // Delay of the periodic monitor events from their schedule.
+    MonitorJitterStats mMonitorJitterStats GUARDED_BY(mMonitorMutex);
+
+    // Whether a data processor requested an early collection that wasn't handled yet.
+    std::atomic<bool> mIsCollectionRequested;
+
     // For unit tests.
     friend class internal::WatchdogPerfServicePeer;
     FRIEND_TEST(WatchdogPerfServiceTest, TestServiceStartAndTerminate);
@@ -68,6 +68,7 @@ using ::aidl::android::hardware::automotive::vehicle::VehiclePropValue;
 using ::android::sp;
 using ::android::String16;
 using ::android::base::Error;
+using ::android::base::GetBoolProperty;
 using ::android::base::GetIntProperty;
 using ::android::base::GetProperty;
 using ::android::base::ReadFileToString;
@@ -116,6 +117,8 @@ constexpr int32_t kMissingIntPropertyValue = -1;
 
 constexpr const char kPropertyVhalCheckInterval[] = "ro.carwatchdog.vhal_healthcheck.interval";
 constexpr const char kPropertyClientCheckInterval[] = "ro.carwatchdog.client_healthcheck.interval";
+constexpr const char kPropertyCaptureNativeStacks[] =
+        "ro.carwatchdog.unresponsive_client.capture_native_stacks";
 constexpr const char kServiceName[] = "WatchdogProcessService";
 constexpr const char kHidlVhalInterfaceName[] = "android.hardware.automotive.vehicle@2.0::IVehicle";
 
@@ -248,6 +251,8 @@ WatchdogProcessService::WatchdogProcessService(
       mLastSessionId(0),
       mServiceStarted(false),
       mDeathRegistrationWrapper(deathRegistrationWrapper),
+      mProcessSnapshotter(sp<ProcessSnapshotter>::make(
+              GetBoolProperty(kPropertyCaptureNativeStacks, /*defaultValue=*/false))),
       mIsEnabled(true),
       mVhalService(nullptr),
       mTotalVhalPidCachingAttempts(0) {
@@ -426,6 +431,7 @@ ScopedAStatus WatchdogProcessService::tellCarWatchdogServiceAlive(
                 fromExceptionCodeWithMessage(EX_ILLEGAL_ARGUMENT,
                                              "Must provide non-null car watchdog service");
     }
+    const int64_t detectionTimeMillis = elapsedRealtime();
     ScopedAStatus status;
     {
         Mutex::Autolock lock(mMutex);
@@ -438,7 +444,7 @@ ScopedAStatus WatchdogProcessService::tellCarWatchdogServiceAlive(
         status = tellClientAliveLocked(service->asBinder(), sessionId);
     }
     if (status.isOk()) {
-        dumpAndKillAllProcesses(clientsNotResponding, /*reportToVhal=*/true);
+        dumpAndKillAllProcesses(clientsNotResponding, /*reportToVhal=*/true, detectionTimeMillis);
     }
     return status;
 }
@@ -453,6 +459,7 @@ ScopedAStatus WatchdogProcessService::tellDumpFinished(
                                                            "invalid monitor is given");
     }
     ALOGI("Process(pid: %d) has been dumped and killed", processIdentifier.pid);
+    mProcessSnapshotter->onProcessKilled(processIdentifier, elapsedRealtime());
     return ScopedAStatus::ok();
 }
 
@@ -563,6 +570,8 @@ void WatchdogProcessService::onDump(int fd) {
     } else {
         WriteStringToFd(StringPrintf("%sVHAL client is not connected", indent), fd);
     }
+    WriteStringToFd("\n", fd);
+    mProcessSnapshotter->onDump(fd);
 }
 
 void WatchdogProcessService::onDumpProto(ProtoOutputStream& outProto) {
@@ -890,6 +899,9 @@ Result<void> WatchdogProcessService::startHealthCheckingLocked(TimeoutLength tim
 }
 
 Result<void> WatchdogProcessService::dumpAndKillClientsIfNotResponding(TimeoutLength timeout) {
+    // Clients that haven't responded by now are detected as not responding. Take the time before
+    // notifying the clients because that may block.
+    const int64_t detectionTimeMillis = elapsedRealtime();
     std::vector<ProcessIdentifier> processIdentifiers;
     std::vector<const ClientInfo*> clientsToNotify;
     {
@@ -923,11 +935,12 @@ Result<void> WatchdogProcessService::dumpAndKillClientsIfNotResponding(TimeoutLe
     for (const ClientInfo*& clientInfo : clientsToNotify) {
         clientInfo->prepareProcessTermination();
     }
-    return dumpAndKillAllProcesses(processIdentifiers, /*reportToVhal=*/true);
+    return dumpAndKillAllProcesses(processIdentifiers, /*reportToVhal=*/true, detectionTimeMillis);
 }
 
 Result<void> WatchdogProcessService::dumpAndKillAllProcesses(
-        const std::vector<ProcessIdentifier>& processesNotResponding, bool reportToVhal) {
+        const std::vector<ProcessIdentifier>& processesNotResponding, bool reportToVhal,
+        int64_t detectionTimeMillis) {
     size_t size = processesNotResponding.size();
     if (size == 0) {
         return {};
@@ -950,13 +963,19 @@ Result<void> WatchdogProcessService::dumpAndKillAllProcesses(
               pidString.c_str());
         return {};
     }
+    auto notifyMonitor = [monitor, processesNotResponding, pidString]() {
+        monitor->onClientsNotResponding(processesNotResponding);
+        if (DEBUG) {
+            ALOGD("Dumping and killing processes is requested: %s", pidString.c_str());
+        }
+    };
+    // The monitor dumps and kills the processes, so it's notified only after the processes are
+    // captured or the capture deadline passes. The capture doesn't block the calling thread.
+    mProcessSnapshotter->captureSnapshots(processesNotResponding, detectionTimeMillis,
+                                          std::move(notifyMonitor));
     if (reportToVhal) {
         reportTerminatedProcessToVhal(processesNotResponding);
     }
-    monitor->onClientsNotResponding(processesNotResponding);
-    if (DEBUG) {
-        ALOGD("Dumping and killing processes is requested: %s", pidString.c_str());
-    }
     return {};
 }
 
@@ -1271,6 +1290,7 @@ int32_t WatchdogProcessService::getNewSessionId() {
 }
 
 void WatchdogProcessService::updateVhalHeartBeat(int64_t value) {
+    const int64_t eventTimeMillis = elapsedRealtime();
     bool wrongHeartBeat;
     {
         Mutex::Autolock lock(mMutex);
@@ -1283,7 +1303,7 @@ void WatchdogProcessService::updateVhalHeartBeat(int64_t value) {
     }
     if (wrongHeartBeat) {
         ALOGW("VHAL updated heart beat with a wrong value. Terminating VHAL...");
-        terminateVhal();
+        terminateVhal(eventTimeMillis);
         return;
     }
     std::chrono::nanoseconds intervalNs = mVhalHealthCheckWindowMillis + kHealthCheckDelayMillis;
@@ -1303,7 +1323,7 @@ void WatchdogProcessService::checkVhalHealth() {
     }
     if (currentUptime > lastEventTime + mVhalHealthCheckWindowMillis.count()) {
         ALOGW("VHAL failed to update heart beat within timeout. Terminating VHAL...");
-        terminateVhal();
+        terminateVhal(elapsedRealtime());
     }
 }
 
@@ -1315,7 +1335,7 @@ void WatchdogProcessService::resetVhalInfoLocked() {
     mHandlerLooper->removeMessages(mMessageHandler, MSG_CACHE_VHAL_PROCESS_IDENTIFIER);
 }
 
-void WatchdogProcessService::terminateVhal() {
+void WatchdogProcessService::terminateVhal(int64_t detectionTimeMillis) {
     std::optional<ProcessIdentifier> processIdentifier;
     {
         Mutex::Autolock lock(mMutex);
@@ -1327,7 +1347,7 @@ void WatchdogProcessService::terminateVhal() {
         }
     }
     dumpAndKillAllProcesses(std::vector<ProcessIdentifier>(1, *processIdentifier),
-                            /*reportToVhal=*/false);
+                            /*reportToVhal=*/false, detectionTimeMillis);
 }
 
 std::chrono::nanoseconds WatchdogProcessService::getTimeoutDurationNs(
@@ -18,6 +18,7 @@
 #define CPP_WATCHDOG_SERVER_SRC_WATCHDOGPROCESSSERVICE_H_
 
 #include "AIBinderDeathRegistrationWrapper.h"
+#include "ProcessSnapshotter.h"
 
 #include <aidl/android/automotive/watchdog/ICarWatchdogClient.h>
 #include <aidl/android/automotive/watchdog/TimeoutLength.h>
@@ -260,10 +261,11 @@ private:
             aidl::android::automotive::watchdog::TimeoutLength timeout);
     android::base::Result<void> dumpAndKillClientsIfNotResponding(
             aidl::android::automotive::watchdog::TimeoutLength timeout);
+    // |detectionTimeMillis| is the elapsed realtime when the processes were found not responding.
     android::base::Result<void> dumpAndKillAllProcesses(
             const std::vector<aidl::android::automotive::watchdog::internal::ProcessIdentifier>&
                     processesNotResponding,
-            bool reportToVhal);
+            bool reportToVhal, int64_t detectionTimeMillis);
     int32_t getNewSessionId();
     android::base::Result<void> updateVhal(
             const aidl::android::hardware::automotive::vehicle::VehiclePropValue& value);
@@ -283,7 +285,7 @@ private:
     void updateVhalHeartBeat(int64_t value);
     void checkVhalHealth();
     void resetVhalInfoLocked();
-    void terminateVhal();
+    void terminateVhal(int64_t detectionTimeMillis);
 
     using ClientInfoMap = std::unordered_map<uintptr_t, ClientInfo>;
     using Processor = std::function<void(ClientInfoMap&, ClientInfoMap::const_iterator)>;
@@ -320,6 +322,7 @@ private:
             mVhalBinderDiedCallback;
     android::sp<AIBinderDeathRegistrationWrapperInterface> mDeathRegistrationWrapper;
     android::sp<PackageInfoResolverInterface> mPackageInfoResolver;
+    android::sp<ProcessSnapshotter> mProcessSnapshotter;
 
     android::Mutex mMutex;
 
@@ -0,0 +1,319 @@
+/*
+ * Copyright 2024 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "CgroupUidStatsReader.h"
+#include "UidCpuStatsCollector.h"
+
+#include <android-base/file.h>
+#include <android-base/logging.h>
+#include <android-base/stringprintf.h>
+#include <gmock/gmock.h>
+
+#include <inttypes.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <chrono>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace android {
+namespace automotive {
+namespace watchdog {
+
+using ::android::base::Error;
+using ::android::base::Result;
+using ::android::base::StringAppendF;
+using ::android::base::StringPrintf;
+using ::android::base::WriteStringToFile;
+using ::testing::Pair;
+using ::testing::UnorderedElementsAre;
+
+namespace {
+
+constexpr char kInvalidPath[] = "/invalid/path";
+constexpr int kBenchmarkUidCount = 100;
+constexpr int kBenchmarkIterations = 100;
+
+std::string toCpuStat(int64_t usageUs) {
+    return StringPrintf("usage_usec %" PRId64 "\nuser_usec %" PRId64 "\nsystem_usec 0\n", usageUs,
+                        usageUs);
+}
+
+}  // namespace
+
+class CgroupUidStatsReaderTest : public ::testing::Test {
+protected:
+    void SetUp() override {
+        ASSERT_TRUE(WriteStringToFile("cpu io memory\n", rootPath() + "/cgroup.controllers"));
+    }
+
+    std::string rootPath() const { return mRootDir.path; }
+
+    void writeUidFile(uid_t uid, const std::string& fileName, const std::string& contents) {
+        const std::string uidPath = StringPrintf("%s/uid_%d", mRootDir.path, uid);
+        if (access(uidPath.c_str(), F_OK) != 0) {
+            ASSERT_EQ(mkdir(uidPath.c_str(), 0700), 0) << "Failed to create " << uidPath;
+        }
+        ASSERT_TRUE(WriteStringToFile(contents, uidPath + "/" + fileName));
+    }
+
+    void removeUidCgroup(uid_t uid, const std::string& fileName) {
+        const std::string uidPath = StringPrintf("%s/uid_%d", mRootDir.path, uid);
+        ASSERT_EQ(unlink((uidPath + "/" + fileName).c_str()), 0);
+        ASSERT_EQ(rmdir(uidPath.c_str()), 0);
+    }
+
+    void recreateUidCgroup(uid_t uid, const std::string& fileName, const std::string& contents) {
+        // Creates the new directory before removing the old one, so it can't reuse the inode.
+        const std::string uidPath = StringPrintf("%s/uid_%d", mRootDir.path, uid);
+        const std::string newUidPath = uidPath + ".new";
+        ASSERT_EQ(mkdir(newUidPath.c_str(), 0700), 0) << "Failed to create " << newUidPath;
+        ASSERT_TRUE(WriteStringToFile(contents, newUidPath + "/" + fileName));
+        ASSERT_NO_FATAL_FAILURE(removeUidCgroup(uid, fileName));
+        ASSERT_EQ(rename(newUidPath.c_str(), uidPath.c_str()), 0);
+    }
+
+private:
+    TemporaryDir mRootDir;
+};
+
+TEST_F(CgroupUidStatsReaderTest, TestIsAvailable) {
+    CgroupUidStatsReader reader(rootPath(), kCgroupCpuStatFile);
+
+    EXPECT_FALSE(reader.isAvailable()) << "Available without any UID cgroup";
+
+    ASSERT_NO_FATAL_FAILURE(writeUidFile(0, kCgroupCpuStatFile, toCpuStat(1000)));
+
+    EXPECT_TRUE(reader.isAvailable());
+    EXPECT_FALSE(CgroupUidStatsReader(rootPath(), "memory.stat").isAvailable())
+            << "Available without any memory.stat file";
+    EXPECT_FALSE(CgroupUidStatsReader(kInvalidPath, kCgroupCpuStatFile).isAvailable())
+            << "Available with an invalid root path";
+}
+
+TEST_F(CgroupUidStatsReaderTest, TestReadSkipsNonUidEntries) {
+    ASSERT_NO_FATAL_FAILURE(writeUidFile(1000, kCgroupCpuStatFile, toCpuStat(1000)));
+    ASSERT_TRUE(WriteStringToFile(toCpuStat(5000), rootPath() + "/" + kCgroupCpuStatFile));
+    ASSERT_EQ(mkdir((rootPath() + "/system").c_str(), 0700), 0);
+
+    CgroupUidStatsReader reader(rootPath(), kCgroupCpuStatFile);
+    std::unordered_map<uid_t, std::string> contentsByUid;
+
+    ASSERT_RESULT_OK(reader.read([&](uid_t uid, bool, std::string_view contents) -> Result<void> {
+        contentsByUid[uid] = contents;
+        return {};
+    }));
+
+    EXPECT_THAT(contentsByUid, UnorderedElementsAre(Pair(1000, toCpuStat(1000))));
+}
+
+TEST_F(CgroupUidStatsReaderTest, TestReadWithRemovedAndRecreatedUidCgroups) {
+    ASSERT_NO_FATAL_FAILURE(writeUidFile(0, kCgroupCpuStatFile, toCpuStat(1000)));
+    ASSERT_NO_FATAL_FAILURE(writeUidFile(1000, kCgroupCpuStatFile, toCpuStat(2000)));
+    ASSERT_NO_FATAL_FAILURE(writeUidFile(1001, kCgroupCpuStatFile, toCpuStat(4000)));
+
+    CgroupUidStatsReader reader(rootPath(), kCgroupCpuStatFile);
+    std::unordered_map<uid_t, std::string> contentsByUid;
+    std::unordered_map<uid_t, bool> isNewCgroupByUid;
+    auto parseFile = [&](uid_t uid, bool isNewCgroup, std::string_view contents) -> Result<void> {
+        contentsByUid[uid] = contents;
+        isNewCgroupByUid[uid] = isNewCgroup;
+        return {};
+    };
+
+    ASSERT_RESULT_OK(reader.read(parseFile));
+    EXPECT_THAT(isNewCgroupByUid,
+                UnorderedElementsAre(Pair(0, true), Pair(1000, true), Pair(1001, true)));
+
+    ASSERT_NO_FATAL_FAILURE(removeUidCgroup(1000, kCgroupCpuStatFile));
+    ASSERT_NO_FATAL_FAILURE(recreateUidCgroup(1001, kCgroupCpuStatFile, toCpuStat(500)));
+    contentsByUid.clear();
+    isNewCgroupByUid.clear();
+
+    ASSERT_RESULT_OK(reader.read(parseFile));
+    EXPECT_THAT(contentsByUid,
+                UnorderedElementsAre(Pair(0, toCpuStat(1000)), Pair(1001, toCpuStat(500))))
+            << "Recreated UID cgroup must be read from the new file";
+    EXPECT_THAT(isNewCgroupByUid, UnorderedElementsAre(Pair(0, false), Pair(1001, true)));
+
+    ASSERT_NO_FATAL_FAILURE(writeUidFile(1000, kCgroupCpuStatFile, toCpuStat(3000)));
+    contentsByUid.clear();
+    isNewCgroupByUid.clear();
+
+    ASSERT_RESULT_OK(reader.read(parseFile));
+    EXPECT_THAT(contentsByUid,
+                UnorderedElementsAre(Pair(0, toCpuStat(1000)), Pair(1000, toCpuStat(3000)),
+                                     Pair(1001, toCpuStat(500))));
+    EXPECT_THAT(isNewCgroupByUid,
+                UnorderedElementsAre(Pair(0, false), Pair(1000, true), Pair(1001, false)));
+}
+
+TEST_F(CgroupUidStatsReaderTest, TestReadReturnsParseErrors) {
+    ASSERT_NO_FATAL_FAILURE(writeUidFile(1000, kCgroupCpuStatFile, toCpuStat(1000)));
+
+    CgroupUidStatsReader reader(rootPath(), kCgroupCpuStatFile);
+
+    EXPECT_FALSE(reader.read([](uid_t, bool, std::string_view) -> Result<void> {
+                           return Error() << "Parse error";
+                       }).ok())
+            << "No error returned for a parse error";
+
+    bool isNewCgroup = true;
+    ASSERT_RESULT_OK(reader.read([&](uid_t, bool isNew, std::string_view) -> Result<void> {
+        isNewCgroup = isNew;
+        return {};
+    }));
+    EXPECT_FALSE(isNewCgroup) << "Cgroup reported as new after a parse error";
+}
+
+TEST_F(CgroupUidStatsReaderTest, TestReadWithoutUidCgroups) {
+    CgroupUidStatsReader reader(rootPath(), kCgroupCpuStatFile);
+
+    EXPECT_FALSE(reader.read([](uid_t, bool, std::string_view) -> Result<void> { return {}; }).ok())
+            << "No error returned without any UID cgroup";
+    EXPECT_FALSE(CgroupUidStatsReader(kInvalidPath, kCgroupCpuStatFile)
+                         .read([](uid_t, bool, std::string_view) -> Result<void> { return {}; })
+                         .ok())
+            << "No error returned for an invalid root path";
+}
+
+TEST(CgroupUidStatsParserTest, TestParseCgroupCpuTimeMillis) {
+    std::vector<std::string_view> fields;
+
+    auto cpuTimeMillis = parseCgroupCpuTimeMillis("usage_usec 12345678\nuser_usec 10000000\n"
+                                                  "system_usec 2345678\nnr_periods 0\n",
+                                                  &fields);
+
+    ASSERT_RESULT_OK(cpuTimeMillis);
+    EXPECT_EQ(*cpuTimeMillis, 12'345);
+    EXPECT_FALSE(parseCgroupCpuTimeMillis("user_usec 10000000\n", &fields).ok())
+            << "No error returned for missing usage_usec";
+    EXPECT_FALSE(parseCgroupCpuTimeMillis("usage_usec CORRUPTED\n", &fields).ok())
+            << "No error returned for invalid usage_usec";
+}
+
+TEST_F(CgroupUidStatsReaderTest, TestUidCpuStatsCollectorWithCgroup) {
+    ASSERT_NO_FATAL_FAILURE(writeUidFile(0, kCgroupCpuStatFile, toCpuStat(12'000'000)));
+    ASSERT_NO_FATAL_FAILURE(writeUidFile(1009, kCgroupCpuStatFile, toCpuStat(1'000'000)));
+
+    UidCpuStatsCollector collector(kInvalidPath, rootPath());
+    collector.init();
+
+    ASSERT_TRUE(collector.enabled()) << "Cgroup backend is unavailable";
+    EXPECT_EQ(collector.filePath(), rootPath() + "/uid_*/cpu.stat");
+    ASSERT_RESULT_OK(collector.collect());
+    EXPECT_THAT(collector.deltaStats(), UnorderedElementsAre(Pair(0, 12'000), Pair(1009, 1'000)));
+
+    ASSERT_NO_FATAL_FAILURE(writeUidFile(0, kCgroupCpuStatFile, toCpuStat(12'500'000)));
+    ASSERT_RESULT_OK(collector.collect());
+
+    EXPECT_THAT(collector.deltaStats(), UnorderedElementsAre(Pair(0, 500)));
+}
+
+TEST_F(CgroupUidStatsReaderTest, TestUidCpuStatsCollectorWithRemovedAndRecreatedUidCgroups) {
+    ASSERT_NO_FATAL_FAILURE(writeUidFile(0, kCgroupCpuStatFile, toCpuStat(12'000'000)));
+    ASSERT_NO_FATAL_FAILURE(writeUidFile(1009, kCgroupCpuStatFile, toCpuStat(1'000'000)));
+    ASSERT_NO_FATAL_FAILURE(writeUidFile(1010, kCgroupCpuStatFile, toCpuStat(2'000'000)));
+
+    UidCpuStatsCollector collector(kInvalidPath, rootPath());
+    collector.init();
+
+    ASSERT_RESULT_OK(collector.collect());
+
+    // UID 1009's last process exited.
+    ASSERT_NO_FATAL_FAILURE(removeUidCgroup(1009, kCgroupCpuStatFile));
+    // UID 1010's cgroup was removed and recreated before the next collection, and its new CPU time
+    // already exceeds the old cgroup's CPU time.
+    ASSERT_NO_FATAL_FAILURE(recreateUidCgroup(1010, kCgroupCpuStatFile, toCpuStat(2'500'000)));
+
+    ASSERT_RESULT_OK(collector.collect());
+
+    EXPECT_THAT(collector.latestStats(), UnorderedElementsAre(Pair(0, 12'000), Pair(1010, 2'500)))
+            << "Removed UID cgroups must be dropped";
+    EXPECT_THAT(collector.deltaStats(), UnorderedElementsAre(Pair(1010, 2'500)));
+
+    ASSERT_NO_FATAL_FAILURE(writeUidFile(1009, kCgroupCpuStatFile, toCpuStat(300'000)));
+    ASSERT_NO_FATAL_FAILURE(writeUidFile(1010, kCgroupCpuStatFile, toCpuStat(2'700'000)));
+
+    ASSERT_RESULT_OK(collector.collect());
+
+    EXPECT_THAT(collector.latestStats(),
+                UnorderedElementsAre(Pair(0, 12'000), Pair(1009, 300), Pair(1010, 2'700)));
+    EXPECT_THAT(collector.deltaStats(), UnorderedElementsAre(Pair(1009, 300), Pair(1010, 200)));
+}
+
+TEST_F(CgroupUidStatsReaderTest, TestUidCpuStatsCollectorPrefersShowUidStat) {
+    ASSERT_NO_FATAL_FAILURE(writeUidFile(0, kCgroupCpuStatFile, toCpuStat(1'000'000)));
+    TemporaryFile tf;
+    ASSERT_NE(tf.fd, -1);
+    ASSERT_TRUE(WriteStringToFile("0: 7000000 5000000\n", tf.path));
+
+    UidCpuStatsCollector collector(tf.path, rootPath());
+    collector.init();
+
+    ASSERT_TRUE(collector.enabled());
+    EXPECT_EQ(collector.filePath(), tf.path)
+            << "Must prefer show_uid_stat, which is cheaper to read than the cgroup files";
+    ASSERT_RESULT_OK(collector.collect());
+    EXPECT_THAT(collector.deltaStats(), UnorderedElementsAre(Pair(0, 12'000)));
+}
+
+TEST_F(CgroupUidStatsReaderTest, TestCollectionCost) {
+    std::string showUidStatContents;
+    for (uid_t uid = 10000; uid < 10000 + kBenchmarkUidCount; ++uid) {
+        StringAppendF(&showUidStatContents, "%d: %d 1000\n", uid, uid);
+        ASSERT_NO_FATAL_FAILURE(writeUidFile(uid, kCgroupCpuStatFile, toCpuStat(uid + 1000)));
+    }
+    TemporaryFile tf;
+    ASSERT_NE(tf.fd, -1);
+    ASSERT_TRUE(WriteStringToFile(showUidStatContents, tf.path));
+
+    UidCpuStatsCollector procfsCollector(tf.path, kInvalidPath);
+    procfsCollector.init();
+    UidCpuStatsCollector cgroupCollector(kInvalidPath, rootPath());
+    cgroupCollector.init();
+    ASSERT_EQ(procfsCollector.filePath(), tf.path);
+    ASSERT_EQ(cgroupCollector.filePath(), rootPath() + "/uid_*/cpu.stat");
+
+    auto start = std::chrono::steady_clock::now();
+    for (int i = 0; i < kBenchmarkIterations; ++i) {
+        ASSERT_RESULT_OK(procfsCollector.collect());
+    }
+    const auto procfsElapsed = std::chrono::duration_cast<std::chrono::nanoseconds>(
+            std::chrono::steady_clock::now() - start);
+
+    start = std::chrono::steady_clock::now();
+    for (int i = 0; i < kBenchmarkIterations; ++i) {
+        ASSERT_RESULT_OK(cgroupCollector.collect());
+    }
+    const auto cgroupElapsed = std::chrono::duration_cast<std::chrono::nanoseconds>(
+            std::chrono::steady_clock::now() - start);
+
+    EXPECT_EQ(cgroupCollector.latestStats(), procfsCollector.latestStats());
+    LOG(INFO) << "Collected the CPU stats of " << kBenchmarkUidCount << " UIDs in "
+              << procfsElapsed.count() / kBenchmarkIterations << " ns from show_uid_stat and in "
+              << cgroupElapsed.count() / kBenchmarkIterations << " ns from cgroup v2 cpu.stat";
+    RecordProperty("showUidStatAvgNs",
+                   std::to_string(procfsElapsed.count() / kBenchmarkIterations));
+    RecordProperty("cgroupCpuStatAvgNs",
+                   std::to_string(cgroupElapsed.count() / kBenchmarkIterations));
+}
+
+}  // namespace watchdog
+}  // namespace automotive
+}  // namespace android
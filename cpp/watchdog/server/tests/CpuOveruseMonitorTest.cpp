@@ -0,0 +1,452 @@
+/*
+ * Copyright (c) 2024, The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "CpuOveruseMonitor.h"
+#include "MockProcStatCollector.h"
+#include "MockThreadPriorityController.h"
+#include "MockUidStatsCollector.h"
+#include "PackageInfoTestUtils.h"
+
+#include <gmock/gmock.h>
+#include <utils/RefBase.h>
+
+#include <sched.h>
+
+#include <string>
+#include <vector>
+
+namespace android {
+namespace automotive {
+namespace watchdog {
+
+using ::aidl::android::automotive::watchdog::internal::ApplicationCategoryType;
+using ::aidl::android::automotive::watchdog::internal::ComponentType;
+using ::aidl::android::automotive::watchdog::internal::PackageInfo;
+using ::aidl::android::automotive::watchdog::internal::ResourceStats;
+using ::aidl::android::automotive::watchdog::internal::ThreadPolicyWithPriority;
+using ::aidl::android::automotive::watchdog::internal::UidType;
+using ::android::sp;
+using ::android::base::Result;
+using ::testing::_;
+using ::testing::ElementsAre;
+using ::testing::Eq;
+using ::testing::IsEmpty;
+using ::testing::Return;
+using ::testing::Test;
+
+namespace {
+
+constexpr std::chrono::milliseconds kTestOveruseWindow = 3min;
+constexpr std::chrono::milliseconds kTestCollectionInterval = 1min;
+// Total CPU time of a 4 core system during |kTestCollectionInterval|.
+constexpr int64_t kTestSystemCpuTimeMillis = 4 * 60'000;
+constexpr int32_t kTestUid = 1'010'001;
+constexpr pid_t kTestPid = 100;
+constexpr pid_t kTestTid = 101;
+// oom_score_adj of a cached app process.
+constexpr int kTestCachedAppOomScoreAdj = 900;
+// oom_score_adj of the top app process.
+constexpr int kTestForegroundAppOomScoreAdj = 0;
+
+class MockSystemCalls : public CpuOveruseMonitor::SystemCallsInterface {
+public:
+    MOCK_METHOD(Result<void>, killProcess, (pid_t pid, uid_t uid), (override));
+    MOCK_METHOD(Result<int>, readOomScoreAdj, (pid_t pid), (override));
+};
+
+// Constructs the per-UID stats for a package that used |cpuSharePercent| of the system CPU time
+// during a collection.
+UidStats constructUidStats(PackageInfo packageInfo, double cpuSharePercent) {
+    UidStats uidStats{
+            .packageInfo = std::move(packageInfo),
+            .cpuTimeMillis = static_cast<int64_t>(kTestSystemCpuTimeMillis * cpuSharePercent / 100),
+    };
+    uidStats.procStats.processStatsByPid[kTestPid] = {
+            .comm = "test.process",
+            .cpuCyclesByTid = {{kTestTid, 1'000}},
+    };
+    return uidStats;
+}
+
+PackageInfo constructTestPackageInfo(const char* packageName, ComponentType componentType,
+                                     ApplicationCategoryType appCategoryType =
+                                             ApplicationCategoryType::OTHERS) {
+    return constructPackageInfo(packageName, kTestUid, UidType::APPLICATION, componentType,
+                                appCategoryType);
+}
+
+MATCHER_P2(ThreadPriorityRequestEq, policy, priority, "") {
+    return ::testing::Value(arg.thread.pid, Eq(kTestPid)) &&
+            ::testing::Value(arg.thread.tid, Eq(kTestTid)) &&
+            ::testing::Value(arg.thread.uid, Eq(kTestUid)) &&
+            ::testing::Value(arg.policy, Eq(policy)) &&
+            ::testing::Value(arg.priority, Eq(priority));
+}
+
+MATCHER_P2(PackageCpuOveruseStatsEq, packageName, action, "") {
+    const auto& actual = arg;
+    return ::testing::Value(actual.packageInfo.packageIdentifier.name, Eq(packageName)) &&
+            ::testing::Value(actual.action, Eq(action));
+}
+
+}  // namespace
+
+namespace internal {
+
+class CpuOveruseMonitorPeer final : public RefBase {
+public:
+    explicit CpuOveruseMonitorPeer(const sp<CpuOveruseMonitor>& monitor) : mMonitor(monitor) {}
+
+    Result<void> init() { return mMonitor->init(); }
+
+    void setSendResourceUsageStatsEnabled(bool enable) {
+        Mutex::Autolock lock(mMonitor->mMutex);
+        mMonitor->mDoSendResourceUsageStats = enable;
+    }
+
+    std::vector<PackageCpuOveruseStats> actionHistory() {
+        Mutex::Autolock lock(mMonitor->mMutex);
+        return mMonitor->mActionHistory;
+    }
+
+private:
+    sp<CpuOveruseMonitor> mMonitor;
+};
+
+}  // namespace internal
+
+class CpuOveruseMonitorTest : public Test {
+protected:
+    void SetUp() override {
+        auto threadPriorityController = std::make_unique<MockThreadPriorityController>();
+        auto systemCalls = std::make_unique<MockSystemCalls>();
+        mMockThreadPriorityController = threadPriorityController.get();
+        mMockSystemCalls = systemCalls.get();
+        mMockUidStatsCollector = sp<MockUidStatsCollector>::make();
+        mMockProcStatCollector = sp<MockProcStatCollector>::make();
+        mMonitor = sp<CpuOveruseMonitor>::make(std::move(threadPriorityController),
+                                               std::move(systemCalls), kTestOveruseWindow);
+        mMonitorPeer = sp<internal::CpuOveruseMonitorPeer>::make(mMonitor);
+        ASSERT_RESULT_OK(mMonitorPeer->init());
+        ASSERT_RESULT_OK(mMonitor->updateCpuOveruseConfigurations(
+                {CpuOveruseConfiguration{.componentType = ComponentType::THIRD_PARTY,
+                                         .componentLevelThreshold = {.name = "THIRD_PARTY",
+                                                                     .maxCpuSharePercent =
+                                                                             25.0}}}));
+        mMonitorPeer->setSendResourceUsageStatsEnabled(true);
+        ON_CALL(*mMockSystemCalls, readOomScoreAdj(_))
+                .WillByDefault(Return(Result<int>(kTestCachedAppOomScoreAdj)));
+        ProcStatInfo procStatInfo;
+        procStatInfo.cpuStats.userTimeMillis = kTestSystemCpuTimeMillis;
+        EXPECT_CALL(*mMockProcStatCollector, deltaStats()).WillRepeatedly(Return(procStatInfo));
+        ON_CALL(*mMockThreadPriorityController, getThreadPriorities(_))
+                .WillByDefault([](const std::vector<ThreadIdentifier>& threads) {
+                    return std::vector<Result<ThreadPolicyWithPriority>>(
+                            threads.size(),
+                            ThreadPolicyWithPriority{.policy = SCHED_OTHER, .priority = 0});
+                });
+        ON_CALL(*mMockThreadPriorityController, setThreadPriorities(_))
+                .WillByDefault([](const std::vector<ThreadPriorityRequest>& requests) {
+                    return std::vector<Result<void>>(requests.size());
+                });
+        mCurrentTime = std::chrono::time_point_cast<std::chrono::milliseconds>(
+                std::chrono::system_clock::now());
+    }
+
+    void TearDown() override {
+        mMonitorPeer.clear();
+        mMonitor.clear();
+        mMockUidStatsCollector.clear();
+        mMockProcStatCollector.clear();
+    }
+
+    // Runs periodic collections until the sliding window is full.
+    void fillWindow(const std::vector<UidStats>& uidStats) {
+        for (auto elapsed = 0ms; elapsed < kTestOveruseWindow; elapsed += kTestCollectionInterval) {
+            runPeriodicCollection(uidStats);
+        }
+    }
+
+    // Runs periodic collections until the next collection is a full window after the last one.
+    void runCollectionsWithinWindow(const std::vector<UidStats>& uidStats) {
+        for (auto elapsed = kTestCollectionInterval; elapsed < kTestOveruseWindow;
+             elapsed += kTestCollectionInterval) {
+            runPeriodicCollection(uidStats);
+        }
+    }
+
+    void runPeriodicCollection(const std::vector<UidStats>& uidStats,
+                               ResourceStats* resourceStats = nullptr) {
+        EXPECT_CALL(*mMockUidStatsCollector, deltaStats()).WillRepeatedly(Return(uidStats));
+        ASSERT_RESULT_OK(mMonitor->onPeriodicCollection(mCurrentTime, SystemState::NORMAL_MODE,
+                                                        mMockUidStatsCollector,
+                                                        mMockProcStatCollector, resourceStats));
+        mCurrentTime += kTestCollectionInterval;
+    }
+
+    MockThreadPriorityController* mMockThreadPriorityController;
+    MockSystemCalls* mMockSystemCalls;
+    sp<MockUidStatsCollector> mMockUidStatsCollector;
+    sp<MockProcStatCollector> mMockProcStatCollector;
+    sp<CpuOveruseMonitor> mMonitor;
+    sp<internal::CpuOveruseMonitorPeer> mMonitorPeer;
+    time_point_millis mCurrentTime;
+};
+
+TEST_F(CpuOveruseMonitorTest, TestNoActionBeforeWindowIsFull) {
+    const std::vector<UidStats> uidStats = {
+            constructUidStats(constructTestPackageInfo("third_party.package",
+                                                       ComponentType::THIRD_PARTY),
+                              /*cpuSharePercent=*/90.0)};
+
+    fillWindow(uidStats);
+
+    EXPECT_THAT(mMonitorPeer->actionHistory(), IsEmpty());
+}
+
+TEST_F(CpuOveruseMonitorTest, TestEscalatesActions) {
+    const std::vector<UidStats> uidStats = {
+            constructUidStats(constructTestPackageInfo("third_party.package",
+                                                       ComponentType::THIRD_PARTY),
+                              /*cpuSharePercent=*/50.0)};
+    fillWindow(uidStats);
+    ResourceStats resourceStats = {};
+
+    runPeriodicCollection(uidStats, &resourceStats);
+
+    ASSERT_TRUE(resourceStats.resourceUsageStats.has_value())
+            << "Overusing package must be reported with the resource stats";
+    ASSERT_EQ(resourceStats.resourceUsageStats->uidResourceUsageStats.size(), 1u);
+    EXPECT_EQ(resourceStats.resourceUsageStats->uidResourceUsageStats[0].packageIdentifier.name,
+              "third_party.package");
+    EXPECT_DOUBLE_EQ(resourceStats.resourceUsageStats->uidResourceUsageStats[0]
+                             .cpuUsageStats.cpuTimePercentage,
+                     50.0);
+
+    // The action escalates only once the share is measured over a full window after the
+    // notification.
+    EXPECT_CALL(*mMockThreadPriorityController, setThreadPriorities(_)).Times(0);
+
+    runCollectionsWithinWindow(uidStats);
+
+    EXPECT_CALL(*mMockThreadPriorityController,
+                setThreadPriorities(ElementsAre(ThreadPriorityRequestEq(SCHED_IDLE, 0))))
+            .Times(1);
+
+    runPeriodicCollection(uidStats);
+
+    EXPECT_CALL(*mMockSystemCalls, killProcess(_, _)).Times(0);
+
+    runCollectionsWithinWindow(uidStats);
+    runPeriodicCollection(uidStats);
+
+    EXPECT_THAT(mMonitorPeer->actionHistory(),
+                ElementsAre(PackageCpuOveruseStatsEq("third_party.package",
+                                                     CpuOveruseAction::NOTIFY),
+                            PackageCpuOveruseStatsEq("third_party.package",
+                                                     CpuOveruseAction::DEPRIORITIZE)));
+}
+
+TEST_F(CpuOveruseMonitorTest, TestNoResourceStatsWhenSyncDisabled) {
+    mMonitorPeer->setSendResourceUsageStatsEnabled(false);
+    const std::vector<UidStats> uidStats = {
+            constructUidStats(constructTestPackageInfo("third_party.package",
+                                                       ComponentType::THIRD_PARTY),
+                              /*cpuSharePercent=*/50.0)};
+    fillWindow(uidStats);
+    ResourceStats resourceStats = {};
+
+    runPeriodicCollection(uidStats, &resourceStats);
+
+    EXPECT_FALSE(resourceStats.resourceUsageStats.has_value())
+            << "Resource usage stats must not be reported when syncing them is disabled";
+    EXPECT_THAT(mMonitorPeer->actionHistory(),
+                ElementsAre(PackageCpuOveruseStatsEq("third_party.package",
+                                                     CpuOveruseAction::NOTIFY)));
+}
+
+TEST_F(CpuOveruseMonitorTest, TestKillsSafeToKillPackage) {
+    ASSERT_RESULT_OK(mMonitor->updateCpuOveruseConfigurations(
+            {CpuOveruseConfiguration{.componentType = ComponentType::THIRD_PARTY,
+                                     .safeToKillPackages = {"third_party.package"},
+                                     .componentLevelThreshold = {.name = "THIRD_PARTY",
+                                                                 .maxCpuSharePercent = 25.0}}}));
+    const std::vector<UidStats> uidStats = {
+            constructUidStats(constructTestPackageInfo("third_party.package",
+                                                       ComponentType::THIRD_PARTY),
+                              /*cpuSharePercent=*/50.0)};
+    fillWindow(uidStats);
+    runPeriodicCollection(uidStats);
+    runCollectionsWithinWindow(uidStats);
+    runPeriodicCollection(uidStats);
+
+    // The deprioritized package isn't killed before its share is measured over a full window.
+    EXPECT_CALL(*mMockSystemCalls, killProcess(_, _)).Times(0);
+
+    runCollectionsWithinWindow(uidStats);
+
+    EXPECT_CALL(*mMockSystemCalls, killProcess(kTestPid, kTestUid))
+            .WillOnce(Return(Result<void>{}));
+
+    runPeriodicCollection(uidStats);
+
+    EXPECT_THAT(mMonitorPeer->actionHistory(),
+                ElementsAre(PackageCpuOveruseStatsEq("third_party.package",
+                                                     CpuOveruseAction::NOTIFY),
+                            PackageCpuOveruseStatsEq("third_party.package",
+                                                     CpuOveruseAction::DEPRIORITIZE),
+                            PackageCpuOveruseStatsEq("third_party.package",
+                                                     CpuOveruseAction::KILL)));
+}
+
+TEST_F(CpuOveruseMonitorTest, TestRestoresPriorityWithinBudget) {
+    const PackageInfo packageInfo =
+            constructTestPackageInfo("third_party.package", ComponentType::THIRD_PARTY);
+    fillWindow({constructUidStats(packageInfo, /*cpuSharePercent=*/50.0)});
+    runPeriodicCollection({constructUidStats(packageInfo, /*cpuSharePercent=*/50.0)});
+    runCollectionsWithinWindow({constructUidStats(packageInfo, /*cpuSharePercent=*/50.0)});
+    EXPECT_CALL(*mMockThreadPriorityController, getThreadPriorities(_))
+            .WillOnce(Return(std::vector<Result<ThreadPolicyWithPriority>>{
+                    ThreadPolicyWithPriority{.policy = SCHED_FIFO, .priority = 10}}));
+    runPeriodicCollection({constructUidStats(packageInfo, /*cpuSharePercent=*/50.0)});
+
+    EXPECT_CALL(*mMockThreadPriorityController,
+                setThreadPriorities(ElementsAre(ThreadPriorityRequestEq(SCHED_FIFO, 10))))
+            .Times(1);
+
+    // The package is back within its budget once the window has two collections without usage.
+    runPeriodicCollection({constructUidStats(packageInfo, /*cpuSharePercent=*/0.0)});
+    runPeriodicCollection({constructUidStats(packageInfo, /*cpuSharePercent=*/0.0)});
+}
+
+TEST_F(CpuOveruseMonitorTest, TestExemptsForegroundAndCriticalPackages) {
+    ASSERT_RESULT_OK(mMonitor->updateCpuOveruseConfigurations(
+            {CpuOveruseConfiguration{.componentType = ComponentType::SYSTEM,
+                                     .exemptPackages = {"system.critical.package"},
+                                     .componentLevelThreshold = {.name = "SYSTEM",
+                                                                 .maxCpuSharePercent = 10.0}}}));
+    const std::vector<UidStats> uidStats = {
+            constructUidStats(constructTestPackageInfo("third_party.package",
+                                                       ComponentType::THIRD_PARTY),
+                              /*cpuSharePercent=*/50.0),
+            constructUidStats(constructTestPackageInfo("system.critical.package",
+                                                       ComponentType::SYSTEM),
+                              /*cpuSharePercent=*/40.0)};
+    fillWindow(uidStats);
+
+    // Only the third-party package's process state is read because the critical package is
+    // exempt by the config.
+    EXPECT_CALL(*mMockSystemCalls, readOomScoreAdj(kTestPid))
+            .WillOnce(Return(Result<int>(kTestForegroundAppOomScoreAdj)));
+
+    runPeriodicCollection(uidStats);
+
+    EXPECT_THAT(mMonitorPeer->actionHistory(), IsEmpty());
+}
+
+TEST_F(CpuOveruseMonitorTest, TestDoesNotExemptBackgroundPackageWithForegroundIo) {
+    UidStats uidStats = constructUidStats(constructTestPackageInfo("third_party.package",
+                                                                   ComponentType::THIRD_PARTY),
+                                          /*cpuSharePercent=*/50.0);
+    // I/O accounted to the foreground state doesn't mean that the package is in the foreground.
+    uidStats.ioStats = UidIoStats(/*fgRdBytes=*/1'000, /*bgRdBytes=*/0, /*fgWrBytes=*/0,
+                                  /*bgWrBytes=*/0, /*fgFsync=*/0, /*bgFsync=*/0);
+    fillWindow({uidStats});
+
+    EXPECT_CALL(*mMockSystemCalls, readOomScoreAdj(kTestPid))
+            .WillOnce(Return(Result<int>(kTestCachedAppOomScoreAdj)));
+
+    runPeriodicCollection({uidStats});
+
+    EXPECT_THAT(mMonitorPeer->actionHistory(),
+                ElementsAre(PackageCpuOveruseStatsEq("third_party.package",
+                                                     CpuOveruseAction::NOTIFY)));
+}
+
+TEST_F(CpuOveruseMonitorTest, TestNoActionWithoutConfigurations) {
+    ASSERT_RESULT_OK(mMonitorPeer->init());
+    const std::vector<UidStats> uidStats = {
+            constructUidStats(constructTestPackageInfo("third_party.package",
+                                                       ComponentType::THIRD_PARTY),
+                              /*cpuSharePercent=*/90.0)};
+    fillWindow(uidStats);
+
+    runPeriodicCollection(uidStats);
+
+    EXPECT_THAT(mMonitorPeer->actionHistory(), IsEmpty());
+}
+
+TEST_F(CpuOveruseMonitorTest, TestResolvesBudgets) {
+    ASSERT_RESULT_OK(mMonitor->updateCpuOveruseConfigurations(
+            {CpuOveruseConfiguration{.componentType = ComponentType::SYSTEM,
+                                     .componentLevelThreshold = {.name = "SYSTEM",
+                                                                 .maxCpuSharePercent = 10.0},
+                                     .packageSpecificThresholds = {{.name = "system.package.B",
+                                                                    .maxCpuSharePercent =
+                                                                            30.0}}},
+             CpuOveruseConfiguration{.componentType = ComponentType::VENDOR,
+                                     .componentLevelThreshold = {.name = "VENDOR",
+                                                                 .maxCpuSharePercent = 10.0},
+                                     .categorySpecificThresholds = {{.name = "MAPS",
+                                                                     .maxCpuSharePercent =
+                                                                             30.0}}}}));
+    const std::vector<UidStats> uidStats = {
+            // Over the component level budget.
+            constructUidStats(constructTestPackageInfo("system.package.A", ComponentType::SYSTEM),
+                              /*cpuSharePercent=*/20.0),
+            // Within the package specific budget.
+            constructUidStats(constructTestPackageInfo("system.package.B", ComponentType::SYSTEM),
+                              /*cpuSharePercent=*/20.0),
+            // Within the application category budget.
+            constructUidStats(constructTestPackageInfo("vendor.package.A", ComponentType::VENDOR,
+                                                       ApplicationCategoryType::MAPS),
+                              /*cpuSharePercent=*/20.0)};
+    fillWindow(uidStats);
+
+    runPeriodicCollection(uidStats);
+
+    EXPECT_THAT(mMonitorPeer->actionHistory(),
+                ElementsAre(
+                        PackageCpuOveruseStatsEq("system.package.A", CpuOveruseAction::NOTIFY)));
+}
+
+TEST_F(CpuOveruseMonitorTest, TestUpdateCpuOveruseConfigurationsWithInvalidConfigs) {
+    EXPECT_FALSE(mMonitor->updateCpuOveruseConfigurations(
+                                 {CpuOveruseConfiguration{
+                                         .componentType = ComponentType::UNKNOWN,
+                                         .componentLevelThreshold = {.maxCpuSharePercent = 10.0}}})
+                         .ok())
+            << "Unknown component type must be rejected";
+    EXPECT_FALSE(mMonitor->updateCpuOveruseConfigurations(
+                                 {CpuOveruseConfiguration{
+                                         .componentType = ComponentType::SYSTEM,
+                                         .componentLevelThreshold = {.maxCpuSharePercent = 0.0}}})
+                         .ok())
+            << "Zero component level budget must be rejected";
+    EXPECT_FALSE(mMonitor->updateCpuOveruseConfigurations(
+                                 {CpuOveruseConfiguration{
+                                         .componentType = ComponentType::SYSTEM,
+                                         .componentLevelThreshold = {.maxCpuSharePercent = 10.0},
+                                         .categorySpecificThresholds = {{.name = "MAPS",
+                                                                         .maxCpuSharePercent =
+                                                                                 10.0}}}})
+                         .ok())
+            << "Category budgets outside the vendor config must be rejected";
+}
+
+}  // namespace watchdog
+}  // namespace automotive
+}  // namespace android
@@ -0,0 +1,108 @@
+/*
+ * Copyright (c) 2024, The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "DataProcessorExecutor.h"
+
+#include <gmock/gmock.h>
+
+#include <atomic>
+#include <chrono>  // NOLINT(build/c++11)
+#include <functional>
+#include <thread>  // NOLINT(build/c++11)
+#include <unordered_set>
+#include <vector>
+
+namespace android {
+namespace automotive {
+namespace watchdog {
+
+using ::testing::ElementsAre;
+
+namespace {
+
+constexpr size_t kTestMaxWorkerThreads = 3;
+
+}  // namespace
+
+TEST(DataProcessorExecutorTest, TestRunAllRunsEveryTask) {
+    DataProcessorExecutor executor(kTestMaxWorkerThreads);
+    std::vector<int> results(8, 0);
+    std::vector<std::function<void()>> tasks;
+    for (size_t i = 0; i < results.size(); ++i) {
+        tasks.push_back([&results, i]() { results[i] = static_cast<int>(i) + 1; });
+    }
+
+    executor.runAll(tasks);
+
+    EXPECT_THAT(results, ElementsAre(1, 2, 3, 4, 5, 6, 7, 8));
+}
+
+TEST(DataProcessorExecutorTest, TestRunAllRunsTasksConcurrently) {
+    DataProcessorExecutor executor(kTestMaxWorkerThreads);
+    std::atomic<int> startedCount = 0;
+    std::atomic<bool> allStarted = false;
+    // Each task waits for the other task to start, which finishes only when they run concurrently.
+    auto task = [&]() {
+        if (++startedCount == 2) {
+            allStarted = true;
+        }
+        const auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(5);
+        while (!allStarted && std::chrono::steady_clock::now() < deadline) {
+            std::this_thread::yield();
+        }
+    };
+
+    executor.runAll({task, task});
+
+    EXPECT_TRUE(allStarted) << "Tasks didn't run concurrently";
+}
+
+TEST(DataProcessorExecutorTest, TestRunAllUsesCallingThread) {
+    DataProcessorExecutor executor(kTestMaxWorkerThreads);
+    const std::thread::id callingThreadId = std::this_thread::get_id();
+    std::thread::id firstTaskThreadId;
+
+    executor.runAll({[&]() { firstTaskThreadId = std::this_thread::get_id(); }, []() {}});
+
+    EXPECT_EQ(firstTaskThreadId, callingThreadId);
+}
+
+TEST(DataProcessorExecutorTest, TestRunAllAfterTerminate) {
+    DataProcessorExecutor executor(kTestMaxWorkerThreads);
+    executor.runAll({[]() {}, []() {}});
+    executor.terminate();
+    const std::thread::id callingThreadId = std::this_thread::get_id();
+    std::unordered_set<std::thread::id> taskThreadIds;
+
+    executor.runAll({[&]() { taskThreadIds.insert(std::this_thread::get_id()); },
+                     [&]() { taskThreadIds.insert(std::this_thread::get_id()); }});
+
+    EXPECT_THAT(taskThreadIds, ElementsAre(callingThreadId))
+            << "Tasks must run on the calling thread after terminate";
+}
+
+TEST(DataProcessorExecutorTest, TestRunAllWithoutWorkerThreads) {
+    DataProcessorExecutor executor(/*maxWorkerThreads=*/0);
+    int count = 0;
+
+    executor.runAll({[&]() { ++count; }, [&]() { ++count; }, [&]() { ++count; }});
+
+    EXPECT_EQ(count, 3);
+}
+
+}  // namespace watchdog
+}  // namespace automotive
+}  // namespace android
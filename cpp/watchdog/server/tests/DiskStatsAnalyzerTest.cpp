@@ -0,0 +1,151 @@
+/*
+ * Copyright (c) 2024, The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "DiskStatsAnalyzer.h"
+
+#include <gmock/gmock.h>
+
+#include <string>
+#include <vector>
+
+namespace android {
+namespace automotive {
+namespace watchdog {
+
+using ::testing::AllOf;
+using ::testing::DoubleEq;
+using ::testing::ElementsAre;
+using ::testing::Field;
+using ::testing::IsEmpty;
+
+namespace {
+
+constexpr int64_t kTestPollDurationMillis = 2'000;
+
+DiskStats sampleDeltaStats(const std::string& deviceName, uint64_t numReads,
+                           uint64_t readTimeMillis, uint64_t numWrites, uint64_t writeTimeMillis) {
+    DiskStats stats;
+    stats.deviceName = deviceName;
+    stats.numReadsCompleted = numReads;
+    stats.readTimeInMillis = readTimeMillis;
+    stats.numWritesCompleted = numWrites;
+    stats.writeTimeInMillis = writeTimeMillis;
+    stats.totalIoTimeInMillis = 500;
+    stats.weightedTotalIoTimeInMillis = readTimeMillis + writeTimeMillis;
+    return stats;
+}
+
+}  // namespace
+
+TEST(DiskStatsAnalyzerTest, TestFromDeltaStats) {
+    DiskStats deltaStats = sampleDeltaStats("sda", 100, 250, 40, 400);
+    deltaStats.numFlushCompleted = 4;
+    deltaStats.flushTimeInMillis = 30;
+
+    const auto stats = DiskPerformanceStats::fromDeltaStats(deltaStats, kTestPollDurationMillis);
+
+    EXPECT_EQ(stats.deviceName, "sda");
+    EXPECT_EQ(stats.numReadsCompleted, 100u);
+    EXPECT_EQ(stats.numWritesCompleted, 40u);
+    EXPECT_EQ(stats.numFlushCompleted, 4u);
+    EXPECT_THAT(stats.avgReadLatencyMillis, DoubleEq(2.5));
+    EXPECT_THAT(stats.avgWriteLatencyMillis, DoubleEq(10.0));
+    EXPECT_THAT(stats.avgFlushLatencyMillis, DoubleEq(7.5));
+    EXPECT_THAT(stats.utilizationPercent, DoubleEq(25.0));
+    EXPECT_THAT(stats.avgQueueDepth, DoubleEq(0.325));
+}
+
+TEST(DiskStatsAnalyzerTest, TestFromDeltaStatsWithoutIo) {
+    DiskStats deltaStats;
+    deltaStats.deviceName = "mmcblk0";
+    deltaStats.totalIoTimeInMillis = 2'100;
+
+    const auto stats = DiskPerformanceStats::fromDeltaStats(deltaStats, kTestPollDurationMillis);
+
+    EXPECT_THAT(stats.avgReadLatencyMillis, DoubleEq(0.0));
+    EXPECT_THAT(stats.avgWriteLatencyMillis, DoubleEq(0.0));
+    EXPECT_THAT(stats.avgFlushLatencyMillis, DoubleEq(0.0));
+    EXPECT_THAT(stats.utilizationPercent, DoubleEq(100.0)) << "Utilization must be capped";
+}
+
+TEST(DiskStatsAnalyzerTest, TestOnPollReportsLatencyDegradation) {
+    DiskStatsAnalyzer analyzer(/*windowSize=*/3);
+
+    for (int i = 0; i < 3; ++i) {
+        EXPECT_THAT(analyzer.onPoll({sampleDeltaStats("sda", 100, 800, 100, 2'000)},
+                                    kTestPollDurationMillis),
+                    IsEmpty());
+    }
+
+    // Read latency grows 4x to 32ms, which is above the floor and the degradation factor.
+    EXPECT_THAT(analyzer.onPoll({sampleDeltaStats("sda", 100, 3'200, 100, 2'000),
+                                 sampleDeltaStats("mmcblk0", 100, 100, 100, 100)},
+                                kTestPollDurationMillis),
+                ElementsAre("sda"));
+
+    // Write latency grows 3x to 60ms but a few slow writes are not enough to alert.
+    EXPECT_THAT(analyzer.onPoll({sampleDeltaStats("sda", 100, 800,
+                                                  kMinIoCountForLatencyAlert - 1, 900)},
+                                kTestPollDurationMillis),
+                IsEmpty());
+
+    // A 10x increase that stays below the floor is not reported.
+    EXPECT_THAT(analyzer.onPoll({sampleDeltaStats("mmcblk0", 100, 1'000, 100, 100)},
+                                kTestPollDurationMillis),
+                IsEmpty());
+}
+
+TEST(DiskStatsAnalyzerTest, TestOnCollection) {
+    DiskStatsAnalyzer analyzer(/*windowSize=*/3);
+
+    analyzer.onPoll({sampleDeltaStats("sda", 100, 400, 50, 500),
+                     sampleDeltaStats("sdb", 0, 0, 0, 0)},
+                    kTestPollDurationMillis);
+    analyzer.onPoll({sampleDeltaStats("sda", 100, 4'000, 50, 500)}, kTestPollDurationMillis);
+
+    const auto stats = analyzer.onCollection();
+
+    ASSERT_EQ(stats.size(), 1u) << "Idle devices must not be reported";
+    EXPECT_EQ(stats[0].deviceName, "sda");
+    EXPECT_EQ(stats[0].numReadsCompleted, 200u);
+    EXPECT_EQ(stats[0].numWritesCompleted, 100u);
+    EXPECT_THAT(stats[0].avgReadLatencyMillis, DoubleEq(22.0));
+    EXPECT_THAT(stats[0].avgWriteLatencyMillis, DoubleEq(10.0));
+    EXPECT_THAT(stats[0].utilizationPercent, DoubleEq(25.0));
+    EXPECT_EQ(stats[0].latencyAlertCount, 1);
+
+    EXPECT_THAT(analyzer.onCollection(), IsEmpty()) << "Stats must be reset after a collection";
+}
+
+TEST(DiskStatsAnalyzerTest, TestWindowStatsEvictsOldestPolls) {
+    DiskStatsAnalyzer analyzer(/*windowSize=*/2);
+
+    analyzer.onPoll({sampleDeltaStats("sda", 10, 1'000, 10, 1'000)}, kTestPollDurationMillis);
+    analyzer.onPoll({sampleDeltaStats("sda", 10, 20, 10, 40)}, kTestPollDurationMillis);
+    analyzer.onPoll({sampleDeltaStats("sda", 30, 20, 10, 40)}, kTestPollDurationMillis);
+
+    EXPECT_THAT(analyzer.windowStats(),
+                ElementsAre(AllOf(Field(&DiskPerformanceStats::deviceName, "sda"),
+                                  Field(&DiskPerformanceStats::numReadsCompleted, 40u),
+                                  Field(&DiskPerformanceStats::avgReadLatencyMillis,
+                                        DoubleEq(1.0)),
+                                  Field(&DiskPerformanceStats::avgWriteLatencyMillis,
+                                        DoubleEq(4.0)))));
+}
+
+}  // namespace watchdog
+}  // namespace automotive
+}  // namespace android
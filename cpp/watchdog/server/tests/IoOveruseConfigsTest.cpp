@@ -15,6 +15,7 @@
  */
 
 #include "IoOveruseConfigs.h"
+#include "OveruseConfigurationCacheHelper.h"
 #include "OveruseConfigurationTestUtils.h"
 #include "OveruseConfigurationXmlHelper.h"
 #include "PackageInfoTestUtils.h"
@@ -247,10 +248,26 @@ public:
             configsByFilepaths[filepath] = config;
             return {};
         };
+        IoOveruseConfigs::sReadCacheFile =
+                [&](const char* filepath) -> Result<ResourceOveruseConfiguration> {
+            if (const auto it = cachedConfigsByFilepaths.find(filepath);
+                it != cachedConfigsByFilepaths.end()) {
+                return it->second;
+            }
+            return Error() << "No cached configs available for the given filepath '" << filepath
+                           << "'";
+        };
+        IoOveruseConfigs::sWriteCacheFile = [&](const ResourceOveruseConfiguration& config,
+                                                const char* filepath) -> Result<void> {
+            cachedConfigsByFilepaths[filepath] = config;
+            return {};
+        };
     }
     ~IoOveruseConfigsPeer() {
         IoOveruseConfigs::sParseXmlFile = &OveruseConfigurationXmlHelper::parseXmlFile;
         IoOveruseConfigs::sWriteXmlFile = &OveruseConfigurationXmlHelper::writeXmlFile;
+        IoOveruseConfigs::sReadCacheFile = &OveruseConfigurationCacheHelper::readCacheFile;
+        IoOveruseConfigs::sWriteCacheFile = &OveruseConfigurationCacheHelper::writeCacheFile;
     }
     void injectErrorOnWriteXmlFile() {
         IoOveruseConfigs::sWriteXmlFile =
@@ -260,6 +277,7 @@ public:
         };
     }
     std::unordered_map<std::string, ResourceOveruseConfiguration> configsByFilepaths;
+    std::unordered_map<std::string, ResourceOveruseConfiguration> cachedConfigsByFilepaths;
 };
 
 }  // namespace internal
@@ -326,6 +344,58 @@ TEST_F(IoOveruseConfigsTest, TestConstructWithLatestConfigs) {
             << "Expected: " << toString(expected) << "Actual:" << toString(actual);
 }
 
+TEST_F(IoOveruseConfigsTest, TestConstructWithCachedLatestConfigs) {
+    const auto latestSystemResourceConfig = sampleUpdateSystemConfig();
+    auto latestVendorResourceConfig = sampleUpdateVendorConfig();
+    const auto latestThirdPartyResourceConfig = sampleUpdateThirdPartyConfig();
+
+    /* Latest XML files are absent so the configs must be read only from the caches. */
+    mPeer->configsByFilepaths = {{kBuildSystemConfigXmlPath, sampleBuildSystemConfig()},
+                                 {kBuildVendorConfigXmlPath, sampleBuildVendorConfig()},
+                                 {kBuildThirdPartyConfigXmlPath, sampleBuildThirdPartyConfig()}};
+    mPeer->cachedConfigsByFilepaths = {{kLatestSystemConfigXmlPath, latestSystemResourceConfig},
+                                       {kLatestVendorConfigXmlPath, latestVendorResourceConfig},
+                                       {kLatestThirdPartyConfigXmlPath,
+                                        latestThirdPartyResourceConfig}};
+
+    IoOveruseConfigs ioOveruseConfigs;
+
+    latestVendorResourceConfig.vendorPackagePrefixes.push_back("vendorPkgB");
+    std::vector<ResourceOveruseConfiguration> expected = {latestSystemResourceConfig,
+                                                          latestVendorResourceConfig,
+                                                          latestThirdPartyResourceConfig};
+
+    std::vector<ResourceOveruseConfiguration> actual;
+    ioOveruseConfigs.get(&actual);
+
+    EXPECT_THAT(actual, UnorderedElementsAreArray(ResourceOveruseConfigurationsMatchers(expected)))
+            << "Expected: " << toString(expected) << "Actual:" << toString(actual);
+}
+
+TEST_F(IoOveruseConfigsTest, TestConstructCachesLatestConfigs) {
+    const auto latestSystemResourceConfig = sampleUpdateSystemConfig();
+    const auto latestVendorResourceConfig = sampleUpdateVendorConfig();
+    const auto latestThirdPartyResourceConfig = sampleUpdateThirdPartyConfig();
+
+    mPeer->configsByFilepaths = {{kBuildSystemConfigXmlPath, sampleBuildSystemConfig()},
+                                 {kLatestSystemConfigXmlPath, latestSystemResourceConfig},
+                                 {kLatestVendorConfigXmlPath, latestVendorResourceConfig},
+                                 {kLatestThirdPartyConfigXmlPath, latestThirdPartyResourceConfig}};
+
+    IoOveruseConfigs ioOveruseConfigs;
+
+    /* Build configs are on read-only partitions so they must not be cached. */
+    std::unordered_map<std::string, ResourceOveruseConfiguration> expected(
+            {{kLatestSystemConfigXmlPath, latestSystemResourceConfig},
+             {kLatestVendorConfigXmlPath, latestVendorResourceConfig},
+             {kLatestThirdPartyConfigXmlPath, latestThirdPartyResourceConfig}});
+
+    EXPECT_THAT(mPeer->cachedConfigsByFilepaths,
+                UnorderedPointwise(ConfigsByFilepathsEq(), expected))
+            << "Expected: " << toString(expected)
+            << "Actual:" << toString(mPeer->cachedConfigsByFilepaths);
+}
+
 TEST_F(IoOveruseConfigsTest, TestConstructWithOnlyBuildSystemConfig) {
     const auto buildSystemResourceConfig = sampleBuildSystemConfig();
 
@@ -1100,6 +1170,11 @@ TEST_F(IoOveruseConfigsTest, TestWriteToDisk) {
     EXPECT_THAT(mPeer->configsByFilepaths, UnorderedPointwise(ConfigsByFilepathsEq(), expected))
             << "Expected: " << toString(expected)
             << "Actual:" << toString(mPeer->configsByFilepaths);
+
+    EXPECT_THAT(mPeer->cachedConfigsByFilepaths,
+                UnorderedPointwise(ConfigsByFilepathsEq(), expected))
+            << "Expected: " << toString(expected)
+            << "Actual:" << toString(mPeer->cachedConfigsByFilepaths);
 }
 
 TEST_F(IoOveruseConfigsTest, TestWriteToDiskFailure) {
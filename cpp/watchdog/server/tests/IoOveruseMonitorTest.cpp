@@ -28,6 +28,8 @@
 #include <utils/RefBase.h>
 
 #include <functional>
+#include <future>  // NOLINT
+#include <thread>  // NOLINT
 #include <tuple>
 #include <unordered_map>
 
@@ -1009,6 +1011,56 @@ TEST_F(IoOveruseMonitorTest, TestOnPeriodicMonitor) {
     EXPECT_TRUE(isAlertReceived) << "Failed to trigger alert when exceeding the threshold";
 }
 
+TEST_F(IoOveruseMonitorTest, TestOnPeriodicMonitorDoesNotWaitForPeriodicCollection) {
+    IoOveruseConfigsInterface::IoOveruseAlertThresholdSet alertThresholds =
+            {toIoOveruseAlertThreshold(
+                    /*durationInSeconds=*/10, /*writtenBytesPerSecond=*/15'360)};
+    ON_CALL(*mMockIoOveruseConfigs, systemWideAlertThresholds())
+            .WillByDefault(ReturnRef(alertThresholds));
+    sp<MockProcDiskStatsCollector> mockProcDiskStatsCollector =
+            sp<MockProcDiskStatsCollector>::make();
+    ON_CALL(*mockProcDiskStatsCollector, deltaSystemWideDiskStats())
+            .WillByDefault(Return(DiskStats{.numKibWritten = 10}));
+    time_t time = std::chrono::system_clock::to_time_t(std::chrono::system_clock::now());
+
+    // Caches the alert thresholds while no collection is running.
+    ASSERT_RESULT_OK(
+            mIoOveruseMonitor->onPeriodicMonitor(time, mockProcDiskStatsCollector, []() {}));
+
+    // Block the collection inside the data processor, after it acquired its lock.
+    std::promise<void> collectionStarted;
+    std::promise<void> releaseCollection;
+    std::shared_future<void> releaseCollectionFuture = releaseCollection.get_future().share();
+    EXPECT_CALL(*mMockUidStatsCollector, deltaStats()).WillOnce([&]() {
+        collectionStarted.set_value();
+        releaseCollectionFuture.wait();
+        return std::vector<UidStats>{};
+    });
+    std::thread collectionThread([&]() {
+        ResourceStats resourceStats = {};
+        auto currentTime = std::chrono::time_point_cast<std::chrono::milliseconds>(
+                std::chrono::system_clock::now());
+        EXPECT_RESULT_OK(mIoOveruseMonitor->onPeriodicCollection(currentTime,
+                                                                 SystemState::NORMAL_MODE,
+                                                                 mMockUidStatsCollector, nullptr,
+                                                                 &resourceStats));
+    });
+    collectionStarted.get_future().wait();
+
+    auto monitorFuture = std::async(std::launch::async, [&]() {
+        return mIoOveruseMonitor->onPeriodicMonitor(time + kTestMonitorInterval.count(),
+                                                    mockProcDiskStatsCollector, []() {});
+    });
+    bool didMonitorFinish = monitorFuture.wait_for(std::chrono::seconds(1)) ==
+            std::future_status::ready;
+
+    releaseCollection.set_value();
+    collectionThread.join();
+
+    ASSERT_TRUE(didMonitorFinish) << "Periodic monitor waited for the periodic collection";
+    ASSERT_RESULT_OK(monitorFuture.get());
+}
+
 TEST_F(IoOveruseMonitorTest, TestRegisterResourceOveruseListener) {
     std::shared_ptr<MockResourceOveruseListener> mockResourceOveruseListener =
             SharedRefBase::make<MockResourceOveruseListener>();
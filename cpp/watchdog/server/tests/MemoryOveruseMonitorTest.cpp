@@ -0,0 +1,409 @@
+/*
+ * Copyright (c) 2024, The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "MemoryOveruseMonitor.h"
+#include "MockPressureMonitor.h"
+#include "MockUidStatsCollector.h"
+#include "PackageInfoTestUtils.h"
+
+#include <gmock/gmock.h>
+#include <utils/RefBase.h>
+
+#include <memory>
+#include <string>
+#include <unordered_set>
+#include <vector>
+
+namespace android {
+namespace automotive {
+namespace watchdog {
+
+using ::aidl::android::automotive::watchdog::internal::ApplicationCategoryType;
+using ::aidl::android::automotive::watchdog::internal::ComponentType;
+using ::aidl::android::automotive::watchdog::internal::PackageInfo;
+using ::aidl::android::automotive::watchdog::internal::ResourceStats;
+using ::aidl::android::automotive::watchdog::internal::UidType;
+using ::android::sp;
+using ::testing::_;
+using ::testing::ElementsAre;
+using ::testing::Eq;
+using ::testing::IsEmpty;
+using ::testing::Return;
+using ::testing::Test;
+
+namespace {
+
+constexpr std::chrono::milliseconds kTestSustainedOveruseDuration = 5min;
+
+UidStats constructUidStats(PackageInfo packageInfo, uint64_t totalRssKb, uint64_t totalPssKb) {
+    return UidStats{.packageInfo = std::move(packageInfo),
+                    .procStats = {.totalRssKb = totalRssKb, .totalPssKb = totalPssKb}};
+}
+
+MemoryOveruseConfiguration constructMemoryOveruseConfig(
+        ComponentType componentType, int64_t componentThresholdKb,
+        const std::vector<MemoryOveruseThreshold>& packageThresholds = {},
+        const std::vector<MemoryOveruseThreshold>& categoryThresholds = {},
+        const std::vector<std::string>& safeToKillPackages = {}) {
+    return MemoryOveruseConfiguration{
+            .componentType = componentType,
+            .safeToKillPackages = safeToKillPackages,
+            .componentLevelThreshold = {.name = toString(componentType),
+                                        .maxMemoryKb = componentThresholdKb},
+            .packageSpecificThresholds = packageThresholds,
+            .categorySpecificThresholds = categoryThresholds,
+    };
+}
+
+MATCHER_P3(PackageMemoryOveruseStatsEq, packageName, memoryKb, thresholdKb, "") {
+    const auto& actual = arg;
+    return ::testing::Value(actual.packageInfo.packageIdentifier.name, Eq(packageName)) &&
+            ::testing::Value(actual.memoryKb, Eq(memoryKb)) &&
+            ::testing::Value(actual.thresholdKb, Eq(thresholdKb));
+}
+
+MATCHER_P3(InternalPackageMemoryOveruseStatsEq, uid, memoryKb, killableOnOveruse, "") {
+    const auto& actual = arg;
+    return ::testing::Value(actual.uid, Eq(static_cast<int32_t>(uid))) &&
+            ::testing::Value(actual.memoryKb, Eq(memoryKb)) &&
+            ::testing::Value(actual.killableOnOveruse, Eq(killableOnOveruse));
+}
+
+}  // namespace
+
+namespace internal {
+
+class MemoryOveruseMonitorPeer final : public RefBase {
+public:
+    explicit MemoryOveruseMonitorPeer(const sp<MemoryOveruseMonitor>& monitor) :
+          mMonitor(monitor) {}
+
+    android::base::Result<void> init() { return mMonitor->init(); }
+
+    void terminate() { mMonitor->terminate(); }
+
+    std::vector<PackageMemoryOveruseStats> overuseStatsHistory() {
+        Mutex::Autolock lock(mMonitor->mMutex);
+        return mMonitor->mOveruseStatsHistory;
+    }
+
+private:
+    sp<MemoryOveruseMonitor> mMonitor;
+};
+
+}  // namespace internal
+
+class MemoryOveruseMonitorTest : public Test {
+protected:
+    void SetUp() override {
+        mMockPressureMonitor = sp<MockPressureMonitor>::make();
+        mMockUidStatsCollector = sp<MockUidStatsCollector>::make();
+        mMonitor = sp<MemoryOveruseMonitor>::make(mMockPressureMonitor, /*isKillEnabled=*/true,
+                                                  kTestSustainedOveruseDuration,
+                                                  PressureMonitorInterface::PRESSURE_LEVEL_MEDIUM);
+        mMonitorPeer = sp<internal::MemoryOveruseMonitorPeer>::make(mMonitor);
+        EXPECT_CALL(*mMockPressureMonitor, isEnabled()).WillRepeatedly(Return(true));
+        EXPECT_CALL(*mMockPressureMonitor, registerPressureChangeCallback(Eq(mMonitor)))
+                .Times(1);
+        ASSERT_RESULT_OK(mMonitorPeer->init());
+        ASSERT_RESULT_OK(mMonitor->updateMemoryOveruseConfigurations(
+                {constructMemoryOveruseConfig(ComponentType::SYSTEM, 100'000,
+                                              {{.name = "system.package.B",
+                                                .maxMemoryKb = 500'000}},
+                                              /*categoryThresholds=*/{},
+                                              /*safeToKillPackages=*/{"system.package.A"}),
+                 constructMemoryOveruseConfig(ComponentType::VENDOR, 200'000,
+                                              /*packageThresholds=*/{},
+                                              {{.name = "MAPS", .maxMemoryKb = 800'000}}),
+                 constructMemoryOveruseConfig(ComponentType::THIRD_PARTY, 300'000)}));
+        mCurrentTime = std::chrono::time_point_cast<std::chrono::milliseconds>(
+                std::chrono::system_clock::now());
+    }
+
+    void TearDown() override {
+        EXPECT_CALL(*mMockPressureMonitor, unregisterPressureChangeCallback(Eq(mMonitor)))
+                .Times(1);
+        mMonitorPeer->terminate();
+        mMonitorPeer.clear();
+        mMonitor.clear();
+        mMockUidStatsCollector.clear();
+        mMockPressureMonitor.clear();
+    }
+
+    // Runs a periodic collection after advancing the current time by |elapsed|. Returns the
+    // resource stats reported by the collection.
+    ResourceStats runPeriodicCollection(std::chrono::milliseconds elapsed,
+                                        const std::vector<UidStats>& uidStats) {
+        mCurrentTime += elapsed;
+        EXPECT_CALL(*mMockUidStatsCollector, latestStats()).WillRepeatedly(Return(uidStats));
+        ResourceStats resourceStats;
+        EXPECT_RESULT_OK(mMonitor->onPeriodicCollection(mCurrentTime, SystemState::NORMAL_MODE,
+                                                        mMockUidStatsCollector, nullptr,
+                                                        &resourceStats));
+        return resourceStats;
+    }
+
+    // Runs a custom collection filtered to |filterPackages| after advancing the current time by
+    // |elapsed|.
+    void runCustomCollection(std::chrono::milliseconds elapsed,
+                             const std::unordered_set<std::string>& filterPackages,
+                             const std::vector<UidStats>& uidStats) {
+        mCurrentTime += elapsed;
+        EXPECT_CALL(*mMockUidStatsCollector, latestStats()).WillRepeatedly(Return(uidStats));
+        ASSERT_RESULT_OK(mMonitor->onCustomCollection(mCurrentTime, SystemState::NORMAL_MODE,
+                                                      filterPackages, mMockUidStatsCollector,
+                                                      nullptr, /*resourceStats=*/nullptr));
+    }
+
+    sp<MockPressureMonitor> mMockPressureMonitor;
+    sp<MockUidStatsCollector> mMockUidStatsCollector;
+    sp<MemoryOveruseMonitor> mMonitor;
+    sp<internal::MemoryOveruseMonitorPeer> mMonitorPeer;
+    time_point_millis mCurrentTime;
+};
+
+TEST_F(MemoryOveruseMonitorTest, TestNoOveruseWithoutMemoryPressure) {
+    const std::vector<UidStats> uidStats = {
+            constructUidStats(constructAppPackageInfo("system.package.A", ComponentType::SYSTEM),
+                              /*totalRssKb=*/900'000, /*totalPssKb=*/900'000)};
+    mMonitor->onPressureChanged(PressureMonitorInterface::PRESSURE_LEVEL_LOW);
+
+    runPeriodicCollection(0ms, uidStats);
+    runPeriodicCollection(kTestSustainedOveruseDuration, uidStats);
+    runPeriodicCollection(kTestSustainedOveruseDuration, uidStats);
+
+    EXPECT_THAT(mMonitorPeer->overuseStatsHistory(), IsEmpty());
+}
+
+TEST_F(MemoryOveruseMonitorTest, TestReportsOnlySustainedOveruse) {
+    const std::vector<UidStats> uidStats = {
+            constructUidStats(constructAppPackageInfo("system.package.A", ComponentType::SYSTEM),
+                              /*totalRssKb=*/900'000, /*totalPssKb=*/150'000)};
+    mMonitor->onPressureChanged(PressureMonitorInterface::PRESSURE_LEVEL_MEDIUM);
+
+    runPeriodicCollection(0ms, uidStats);
+    const ResourceStats resourceStats =
+            runPeriodicCollection(kTestSustainedOveruseDuration / 2, uidStats);
+
+    ASSERT_THAT(mMonitorPeer->overuseStatsHistory(), IsEmpty())
+            << "Overuse must not be reported before the sustained overuse duration";
+    EXPECT_FALSE(resourceStats.resourceOveruseStats.has_value());
+
+    runPeriodicCollection(kTestSustainedOveruseDuration / 2, uidStats);
+
+    const auto actual = mMonitorPeer->overuseStatsHistory();
+    ASSERT_THAT(actual,
+                ElementsAre(PackageMemoryOveruseStatsEq("system.package.A", 150'000, 100'000)));
+    EXPECT_EQ(actual[0].overuseDuration, kTestSustainedOveruseDuration);
+    EXPECT_EQ(actual[0].totalOveruses, 1);
+    EXPECT_TRUE(actual[0].killableOnOveruse);
+}
+
+TEST_F(MemoryOveruseMonitorTest, TestReportsOveruseInResourceStats) {
+    const PackageInfo killablePackageInfo =
+            constructAppPackageInfo("system.package.A", ComponentType::SYSTEM);
+    const PackageInfo unkillablePackageInfo =
+            constructAppPackageInfo("vendor.package.A", ComponentType::VENDOR);
+    const std::vector<UidStats> uidStats =
+            {constructUidStats(killablePackageInfo, /*totalRssKb=*/0, /*totalPssKb=*/150'000),
+             constructUidStats(unkillablePackageInfo, /*totalRssKb=*/0, /*totalPssKb=*/250'000)};
+    mMonitor->onPressureChanged(PressureMonitorInterface::PRESSURE_LEVEL_MEDIUM);
+
+    runPeriodicCollection(0ms, uidStats);
+    const ResourceStats resourceStats =
+            runPeriodicCollection(kTestSustainedOveruseDuration, uidStats);
+
+    ASSERT_TRUE(resourceStats.resourceOveruseStats.has_value());
+    EXPECT_THAT(resourceStats.resourceOveruseStats->packageIoOveruseStats, IsEmpty());
+    const auto& actual = resourceStats.resourceOveruseStats->packageMemoryOveruseStats;
+    ASSERT_THAT(actual,
+                ElementsAre(InternalPackageMemoryOveruseStatsEq(uidStats[0].uid(), 150'000, true),
+                            InternalPackageMemoryOveruseStatsEq(uidStats[1].uid(), 250'000,
+                                                                false)));
+    EXPECT_EQ(actual[0].thresholdKb, 100'000);
+    EXPECT_EQ(actual[0].overuseDurationMillis, kTestSustainedOveruseDuration.count());
+    EXPECT_EQ(actual[0].totalOveruses, 1);
+}
+
+TEST_F(MemoryOveruseMonitorTest, TestSkipsFilteredCustomCollection) {
+    const PackageInfo packageInfo =
+            constructAppPackageInfo("third_party.package.A", ComponentType::THIRD_PARTY);
+    const std::vector<UidStats> uidStats = {constructUidStats(packageInfo, 0, 400'000)};
+    mMonitor->onPressureChanged(PressureMonitorInterface::PRESSURE_LEVEL_MEDIUM);
+
+    runCustomCollection(0ms, /*filterPackages=*/{}, uidStats);
+    // The filtered collection doesn't have the package's stats. This must not end its overuse
+    // window.
+    runCustomCollection(kTestSustainedOveruseDuration / 2, {"third_party.package.B"},
+                        {constructUidStats(constructAppPackageInfo("third_party.package.B",
+                                                                   ComponentType::THIRD_PARTY),
+                                           0, 400'000)});
+    runCustomCollection(kTestSustainedOveruseDuration / 2, /*filterPackages=*/{}, uidStats);
+
+    EXPECT_THAT(mMonitorPeer->overuseStatsHistory(),
+                ElementsAre(PackageMemoryOveruseStatsEq("third_party.package.A", 400'000,
+                                                        300'000)));
+}
+
+TEST_F(MemoryOveruseMonitorTest, TestReportsUnkillableOveruseWhenKillDisabled) {
+    sp<MockPressureMonitor> mockPressureMonitor = sp<MockPressureMonitor>::make();
+    sp<MemoryOveruseMonitor> monitor =
+            sp<MemoryOveruseMonitor>::make(mockPressureMonitor, /*isKillEnabled=*/false,
+                                           kTestSustainedOveruseDuration,
+                                           PressureMonitorInterface::PRESSURE_LEVEL_MEDIUM);
+    sp<internal::MemoryOveruseMonitorPeer> monitorPeer =
+            sp<internal::MemoryOveruseMonitorPeer>::make(monitor);
+    EXPECT_CALL(*mockPressureMonitor, isEnabled()).WillRepeatedly(Return(false));
+    ASSERT_RESULT_OK(monitorPeer->init());
+    ASSERT_RESULT_OK(monitor->updateMemoryOveruseConfigurations(
+            {constructMemoryOveruseConfig(ComponentType::THIRD_PARTY, 300'000)}));
+    const UidStats uidStats = constructUidStats(constructAppPackageInfo("third_party.package.A",
+                                                                        ComponentType::THIRD_PARTY),
+                                                /*totalRssKb=*/0, /*totalPssKb=*/400'000);
+    EXPECT_CALL(*mMockUidStatsCollector, latestStats()).WillRepeatedly(Return(
+            std::vector<UidStats>{uidStats}));
+    monitor->onPressureChanged(PressureMonitorInterface::PRESSURE_LEVEL_HIGH);
+    ResourceStats resourceStats;
+
+    ASSERT_RESULT_OK(monitor->onPeriodicCollection(mCurrentTime, SystemState::NORMAL_MODE,
+                                                   mMockUidStatsCollector, nullptr,
+                                                   &resourceStats));
+    ASSERT_RESULT_OK(monitor->onPeriodicCollection(mCurrentTime + kTestSustainedOveruseDuration,
+                                                   SystemState::NORMAL_MODE,
+                                                   mMockUidStatsCollector, nullptr,
+                                                   &resourceStats));
+
+    const auto actual = monitorPeer->overuseStatsHistory();
+    ASSERT_EQ(actual.size(), 1u);
+    EXPECT_TRUE(actual[0].killableOnOveruse);
+    ASSERT_TRUE(resourceStats.resourceOveruseStats.has_value());
+    EXPECT_THAT(resourceStats.resourceOveruseStats->packageMemoryOveruseStats,
+                ElementsAre(InternalPackageMemoryOveruseStatsEq(uidStats.uid(), 400'000, false)))
+            << "Package must not be reported as killable when killing is disabled";
+
+    monitorPeer->terminate();
+}
+
+TEST_F(MemoryOveruseMonitorTest, TestResetsOveruseWhenUsageDrops) {
+    const PackageInfo packageInfo =
+            constructAppPackageInfo("third_party.package.A", ComponentType::THIRD_PARTY);
+    mMonitor->onPressureChanged(PressureMonitorInterface::PRESSURE_LEVEL_HIGH);
+
+    runPeriodicCollection(0ms, {constructUidStats(packageInfo, 0, 400'000)});
+    runPeriodicCollection(kTestSustainedOveruseDuration / 2,
+                          {constructUidStats(packageInfo, 0, 200'000)});
+    runPeriodicCollection(kTestSustainedOveruseDuration / 2,
+                          {constructUidStats(packageInfo, 0, 400'000)});
+    runPeriodicCollection(kTestSustainedOveruseDuration / 2,
+                          {constructUidStats(packageInfo, 0, 400'000)});
+
+    EXPECT_THAT(mMonitorPeer->overuseStatsHistory(), IsEmpty());
+}
+
+TEST_F(MemoryOveruseMonitorTest, TestResetsOveruseWhenPressureDrops) {
+    const std::vector<UidStats> uidStats = {
+            constructUidStats(constructAppPackageInfo("third_party.package.A",
+                                                      ComponentType::THIRD_PARTY),
+                              /*totalRssKb=*/0, /*totalPssKb=*/400'000)};
+    mMonitor->onPressureChanged(PressureMonitorInterface::PRESSURE_LEVEL_MEDIUM);
+    runPeriodicCollection(0ms, uidStats);
+
+    mMonitor->onPressureChanged(PressureMonitorInterface::PRESSURE_LEVEL_NONE);
+    // Pressure was medium during part of this interval, so the overuse is still tracked.
+    runPeriodicCollection(kTestSustainedOveruseDuration / 2, uidStats);
+    // Pressure stayed below medium through the whole interval, so the overuse is reset.
+    runPeriodicCollection(kTestSustainedOveruseDuration / 2, uidStats);
+
+    mMonitor->onPressureChanged(PressureMonitorInterface::PRESSURE_LEVEL_MEDIUM);
+    runPeriodicCollection(kTestSustainedOveruseDuration / 2, uidStats);
+
+    EXPECT_THAT(mMonitorPeer->overuseStatsHistory(), IsEmpty());
+}
+
+TEST_F(MemoryOveruseMonitorTest, TestResolvesThresholds) {
+    const std::vector<UidStats> uidStats = {
+            // Package specific threshold.
+            constructUidStats(constructAppPackageInfo("system.package.B", ComponentType::SYSTEM),
+                              /*totalRssKb=*/0, /*totalPssKb=*/600'000),
+            // Application category threshold.
+            constructUidStats(constructAppPackageInfo("vendor.package.A", ComponentType::VENDOR,
+                                                      ApplicationCategoryType::MAPS),
+                              /*totalRssKb=*/0, /*totalPssKb=*/900'000),
+            // Component level threshold. Uses RSS when PSS isn't available.
+            constructUidStats(constructAppPackageInfo("third_party.package.A",
+                                                      ComponentType::THIRD_PARTY),
+                              /*totalRssKb=*/350'000, /*totalPssKb=*/0),
+            // Within the application category threshold.
+            constructUidStats(constructAppPackageInfo("vendor.package.B", ComponentType::VENDOR,
+                                                      ApplicationCategoryType::MAPS),
+                              /*totalRssKb=*/0, /*totalPssKb=*/700'000),
+    };
+    mMonitor->onPressureChanged(PressureMonitorInterface::PRESSURE_LEVEL_HIGH);
+
+    runPeriodicCollection(0ms, uidStats);
+    runPeriodicCollection(kTestSustainedOveruseDuration, uidStats);
+
+    EXPECT_THAT(mMonitorPeer->overuseStatsHistory(),
+                ElementsAre(PackageMemoryOveruseStatsEq("system.package.B", 600'000, 500'000),
+                            PackageMemoryOveruseStatsEq("vendor.package.A", 900'000, 800'000),
+                            PackageMemoryOveruseStatsEq("third_party.package.A", 350'000,
+                                                        300'000)));
+}
+
+TEST_F(MemoryOveruseMonitorTest, TestReportsRepeatedOveruse) {
+    const std::vector<UidStats> uidStats = {
+            constructUidStats(constructAppPackageInfo("vendor.package.A", ComponentType::VENDOR),
+                              /*totalRssKb=*/0, /*totalPssKb=*/250'000),
+            constructUidStats(constructPackageInfo("vendor.native.A", 1234, UidType::NATIVE,
+                                                   ComponentType::VENDOR),
+                              /*totalRssKb=*/0, /*totalPssKb=*/250'000)};
+    mMonitor->onPressureChanged(PressureMonitorInterface::PRESSURE_LEVEL_MEDIUM);
+
+    runPeriodicCollection(0ms, uidStats);
+    runPeriodicCollection(kTestSustainedOveruseDuration, uidStats);
+    runPeriodicCollection(kTestSustainedOveruseDuration / 2, uidStats);
+    runPeriodicCollection(kTestSustainedOveruseDuration / 2, uidStats);
+
+    const auto actual = mMonitorPeer->overuseStatsHistory();
+    ASSERT_EQ(actual.size(), 4u);
+    EXPECT_EQ(actual[2].packageInfo.packageIdentifier.name, "vendor.package.A");
+    EXPECT_EQ(actual[2].totalOveruses, 2);
+    EXPECT_FALSE(actual[2].killableOnOveruse)
+            << "Vendor package not in the safe to kill list must not be killable";
+    EXPECT_EQ(actual[3].packageInfo.packageIdentifier.name, "vendor.native.A");
+    EXPECT_FALSE(actual[3].killableOnOveruse) << "Native package must not be killable";
+}
+
+TEST(MemoryOveruseMonitorDisabledTest, TestNoCallbackRegistrationWhenPressureMonitorDisabled) {
+    sp<MockPressureMonitor> mockPressureMonitor = sp<MockPressureMonitor>::make();
+    sp<MemoryOveruseMonitor> monitor =
+            sp<MemoryOveruseMonitor>::make(mockPressureMonitor, /*isKillEnabled=*/false,
+                                           kTestSustainedOveruseDuration,
+                                           PressureMonitorInterface::PRESSURE_LEVEL_MEDIUM);
+    sp<internal::MemoryOveruseMonitorPeer> monitorPeer =
+            sp<internal::MemoryOveruseMonitorPeer>::make(monitor);
+    EXPECT_CALL(*mockPressureMonitor, isEnabled()).WillRepeatedly(Return(false));
+    EXPECT_CALL(*mockPressureMonitor, registerPressureChangeCallback(_)).Times(0);
+    EXPECT_CALL(*mockPressureMonitor, unregisterPressureChangeCallback(_)).Times(0);
+
+    ASSERT_RESULT_OK(monitorPeer->init());
+
+    monitorPeer->terminate();
+}
+
+}  // namespace watchdog
+}  // namespace automotive
+}  // namespace android
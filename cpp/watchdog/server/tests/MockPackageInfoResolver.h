@@ -42,6 +42,7 @@ public:
     MOCK_METHOD(
             (std::unordered_map<uid_t, aidl::android::automotive::watchdog::internal::PackageInfo>),
             getPackageInfosForUids, (const std::vector<uid_t>& uids), (override));
+    MOCK_METHOD(void, asyncPrefetchPackageInfos, (), (override));
     MOCK_METHOD(void, setPackageConfigurations,
                 ((const std::unordered_set<std::string>&),
                  (const std::unordered_map<
@@ -23,6 +23,7 @@
 #include <gmock/gmock.h>
 
 #include <string>
+#include <vector>
 
 namespace android {
 namespace automotive {
@@ -37,6 +38,7 @@ public:
     MOCK_METHOD(android::base::Result<void>, collect, (), (override));
     MOCK_METHOD(PerPartitionDiskStats, latestPerPartitionDiskStats, (), (const, override));
     MOCK_METHOD(DiskStats, deltaSystemWideDiskStats, (), (const, override));
+    MOCK_METHOD(std::vector<DiskStats>, deltaPhysicalDeviceDiskStats, (), (const, override));
     MOCK_METHOD(bool, enabled, (), (const, override));
     MOCK_METHOD(std::string, filePath, (), (const, override));
 };
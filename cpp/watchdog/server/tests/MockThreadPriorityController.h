@@ -0,0 +1,51 @@
+/*
+ * Copyright (c) 2024, The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef CPP_WATCHDOG_SERVER_TESTS_MOCKTHREADPRIORITYCONTROLLER_H_
+#define CPP_WATCHDOG_SERVER_TESTS_MOCKTHREADPRIORITYCONTROLLER_H_
+
+#include "ThreadPriorityController.h"
+
+#include <aidl/android/automotive/watchdog/internal/ThreadPolicyWithPriority.h>
+#include <android-base/result.h>
+#include <gmock/gmock.h>
+
+#include <vector>
+
+namespace android {
+namespace automotive {
+namespace watchdog {
+
+class MockThreadPriorityController : public ThreadPriorityControllerInterface {
+public:
+    MOCK_METHOD(android::base::Result<void>, setThreadPriority,
+                (int pid, int tid, int uid, int policy, int priority), (override));
+    MOCK_METHOD(android::base::Result<void>, getThreadPriority,
+                (int pid, int tid, int uid,
+                 aidl::android::automotive::watchdog::internal::ThreadPolicyWithPriority* result),
+                (override));
+    MOCK_METHOD(std::vector<android::base::Result<void>>, setThreadPriorities,
+                (const std::vector<ThreadPriorityRequest>& requests), (override));
+    MOCK_METHOD(std::vector<android::base::Result<
+                        aidl::android::automotive::watchdog::internal::ThreadPolicyWithPriority>>,
+                getThreadPriorities, (const std::vector<ThreadIdentifier>& threads), (override));
+};
+
+}  // namespace watchdog
+}  // namespace automotive
+}  // namespace android
+
+#endif  //  CPP_WATCHDOG_SERVER_TESTS_MOCKTHREADPRIORITYCONTROLLER_H_
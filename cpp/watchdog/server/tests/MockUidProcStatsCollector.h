@@ -24,6 +24,7 @@
 
 #include <string>
 #include <unordered_map>
+#include <unordered_set>
 
 namespace android {
 namespace automotive {
@@ -41,6 +42,7 @@ public:
     MOCK_METHOD((const std::unordered_map<uid_t, UidProcStats>), deltaStats, (), (const, override));
     MOCK_METHOD(bool, enabled, (), (const, override));
     MOCK_METHOD(const std::string, dirPath, (), (const, override));
+    MOCK_METHOD(void, setFilterUids, (const std::unordered_set<uid_t>&), (override));
 };
 
 }  // namespace watchdog
@@ -24,6 +24,7 @@
 
 #include <string>
 #include <unordered_map>
+#include <unordered_set>
 
 namespace android {
 namespace automotive {
@@ -37,6 +38,7 @@ public:
     MOCK_METHOD((const std::vector<UidStats>), latestStats, (), (const, override));
     MOCK_METHOD((const std::vector<UidStats>), deltaStats, (), (const, override));
     MOCK_METHOD(bool, enabled, (), (const, override));
+    MOCK_METHOD(void, setFilterPackages, (const std::unordered_set<std::string>&), (override));
 };
 
 }  // namespace watchdog
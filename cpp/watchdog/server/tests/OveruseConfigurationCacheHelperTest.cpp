@@ -0,0 +1,169 @@
+/*
+ * Copyright (c) 2024, The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "OveruseConfigurationCacheHelper.h"
+#include "OveruseConfigurationTestUtils.h"
+#include "OveruseConfigurationXmlHelper.h"
+
+#include <android-base/file.h>
+#include <android-base/logging.h>
+#include <android-base/result.h>
+#include <gmock/gmock.h>
+
+#include <chrono>
+#include <functional>
+#include <string>
+
+namespace android {
+namespace automotive {
+namespace watchdog {
+
+using ::aidl::android::automotive::watchdog::internal::ResourceOveruseConfiguration;
+using ::android::base::ReadFileToString;
+using ::android::base::WriteStringToFile;
+
+namespace {
+
+constexpr const char* kTestDataDir = "/tests/data/";
+constexpr const char* kValidVendorConfiguration = "valid_overuse_vendor_configuration.xml";
+constexpr int kLoadBenchmarkIterations = 200;
+
+std::string getTestFilePath(const char* filename) {
+    static std::string baseDir = android::base::GetExecutableDirectory();
+    return baseDir + kTestDataDir + filename;
+}
+
+class OveruseConfigurationCacheHelperTest : public ::testing::Test {
+protected:
+    virtual void SetUp() {
+        std::string contents;
+        ASSERT_TRUE(ReadFileToString(getTestFilePath(kValidVendorConfiguration), &contents));
+        mXmlFilePath = std::string(mTempDir.path) + "/resource_overuse_configuration.xml";
+        ASSERT_TRUE(WriteStringToFile(contents, mXmlFilePath));
+        const auto config = OveruseConfigurationXmlHelper::parseXmlFile(mXmlFilePath.c_str());
+        ASSERT_RESULT_OK(config);
+        mConfig = *config;
+        OveruseConfigurationCacheHelper::sGetBuildFingerprint = []() { return "build/1"; };
+    }
+
+    virtual void TearDown() {
+        OveruseConfigurationCacheHelper::sGetBuildFingerprint = mDefaultGetBuildFingerprint;
+    }
+
+    const std::function<std::string()> mDefaultGetBuildFingerprint =
+            OveruseConfigurationCacheHelper::sGetBuildFingerprint;
+    TemporaryDir mTempDir;
+    std::string mXmlFilePath;
+    ResourceOveruseConfiguration mConfig;
+};
+
+}  // namespace
+
+TEST_F(OveruseConfigurationCacheHelperTest, TestGetCacheFilePath) {
+    EXPECT_EQ(OveruseConfigurationCacheHelper::getCacheFilePath("/data/config.xml"),
+              "/data/config.cache");
+    EXPECT_EQ(OveruseConfigurationCacheHelper::getCacheFilePath("/data/config"),
+              "/data/config.cache");
+}
+
+TEST_F(OveruseConfigurationCacheHelperTest, TestWriteAndReadCacheFile) {
+    ASSERT_RESULT_OK(OveruseConfigurationCacheHelper::writeCacheFile(mConfig,
+                                                                     mXmlFilePath.c_str()));
+
+    const auto actual = OveruseConfigurationCacheHelper::readCacheFile(mXmlFilePath.c_str());
+
+    ASSERT_RESULT_OK(actual);
+    EXPECT_THAT(*actual, ResourceOveruseConfigurationMatcher(mConfig))
+            << "Expected: " << mConfig.toString() << "\nActual: " << actual->toString();
+}
+
+TEST_F(OveruseConfigurationCacheHelperTest, TestReadCacheFileWithoutCache) {
+    EXPECT_FALSE(OveruseConfigurationCacheHelper::readCacheFile(mXmlFilePath.c_str()).ok())
+            << "Must return error when the cache file doesn't exist";
+}
+
+TEST_F(OveruseConfigurationCacheHelperTest, TestReadCacheFileWithCorruptedCache) {
+    ASSERT_RESULT_OK(OveruseConfigurationCacheHelper::writeCacheFile(mConfig,
+                                                                     mXmlFilePath.c_str()));
+    const std::string cacheFilePath =
+            OveruseConfigurationCacheHelper::getCacheFilePath(mXmlFilePath.c_str());
+    std::string contents;
+    ASSERT_TRUE(ReadFileToString(cacheFilePath, &contents));
+    contents.back() ^= 0xff;
+    ASSERT_TRUE(WriteStringToFile(contents, cacheFilePath));
+
+    EXPECT_FALSE(OveruseConfigurationCacheHelper::readCacheFile(mXmlFilePath.c_str()).ok())
+            << "Must return error when the cache's checksum doesn't match";
+
+    contents.resize(contents.size() / 2);
+    ASSERT_TRUE(WriteStringToFile(contents, cacheFilePath));
+
+    EXPECT_FALSE(OveruseConfigurationCacheHelper::readCacheFile(mXmlFilePath.c_str()).ok())
+            << "Must return error when the cache is truncated";
+}
+
+TEST_F(OveruseConfigurationCacheHelperTest, TestReadCacheFileWithUpdatedXmlFile) {
+    ASSERT_RESULT_OK(OveruseConfigurationCacheHelper::writeCacheFile(mConfig,
+                                                                     mXmlFilePath.c_str()));
+    std::string contents;
+    ASSERT_TRUE(ReadFileToString(mXmlFilePath, &contents));
+    ASSERT_TRUE(WriteStringToFile(contents + "\n", mXmlFilePath));
+
+    EXPECT_FALSE(OveruseConfigurationCacheHelper::readCacheFile(mXmlFilePath.c_str()).ok())
+            << "Must return error when the XML file changed after the cache was written";
+}
+
+TEST_F(OveruseConfigurationCacheHelperTest, TestReadCacheFileAfterBuildFingerprintChange) {
+    ASSERT_RESULT_OK(OveruseConfigurationCacheHelper::writeCacheFile(mConfig,
+                                                                     mXmlFilePath.c_str()));
+    OveruseConfigurationCacheHelper::sGetBuildFingerprint = []() { return "build/2"; };
+
+    EXPECT_FALSE(OveruseConfigurationCacheHelper::readCacheFile(mXmlFilePath.c_str()).ok())
+            << "Must return error when the cache was written by a different build";
+}
+
+TEST_F(OveruseConfigurationCacheHelperTest, TestLoadTimeSavedByCache) {
+    ASSERT_RESULT_OK(OveruseConfigurationCacheHelper::writeCacheFile(mConfig,
+                                                                     mXmlFilePath.c_str()));
+
+    auto start = std::chrono::steady_clock::now();
+    for (int i = 0; i < kLoadBenchmarkIterations; ++i) {
+        ASSERT_RESULT_OK(OveruseConfigurationXmlHelper::parseXmlFile(mXmlFilePath.c_str()));
+    }
+    const int64_t avgXmlParseNs = std::chrono::duration_cast<std::chrono::nanoseconds>(
+                                          std::chrono::steady_clock::now() - start)
+                                          .count() /
+            kLoadBenchmarkIterations;
+
+    start = std::chrono::steady_clock::now();
+    for (int i = 0; i < kLoadBenchmarkIterations; ++i) {
+        ASSERT_RESULT_OK(OveruseConfigurationCacheHelper::readCacheFile(mXmlFilePath.c_str()));
+    }
+    const int64_t avgCacheReadNs = std::chrono::duration_cast<std::chrono::nanoseconds>(
+                                           std::chrono::steady_clock::now() - start)
+                                           .count() /
+            kLoadBenchmarkIterations;
+
+    LOG(INFO) << "Loaded the resource overuse configuration in " << avgXmlParseNs
+              << " ns from XML and " << avgCacheReadNs << " ns from cache on average over "
+              << kLoadBenchmarkIterations << " iterations";
+    RecordProperty("avgXmlParseNs", std::to_string(avgXmlParseNs));
+    RecordProperty("avgCacheReadNs", std::to_string(avgCacheReadNs));
+}
+
+}  // namespace watchdog
+}  // namespace automotive
+}  // namespace android
@@ -21,10 +21,13 @@
 #include <aidl/android/automotive/watchdog/internal/ApplicationCategoryType.h>
 #include <aidl/android/automotive/watchdog/internal/ComponentType.h>
 #include <aidl/android/automotive/watchdog/internal/UidType.h>
+#include <android-base/file.h>
+#include <android-base/logging.h>
 #include <android-base/stringprintf.h>
 #include <gmock/gmock.h>
 #include <gtest/gtest.h>
 
+#include <chrono>  // NOLINT(build/c++11)
 #include <future>  // NOLINT(build/c++11)
 
 namespace android {
@@ -37,10 +40,13 @@ using ::aidl::android::automotive::watchdog::internal::PackageInfo;
 using ::aidl::android::automotive::watchdog::internal::UidType;
 using ::android::sp;
 using ::android::base::StringAppendF;
+using ::android::base::StringPrintf;
+using ::android::base::WriteStringToFile;
 using ::ndk::ScopedAStatus;
 using ::testing::_;
 using ::testing::ByMove;
 using ::testing::DoAll;
+using ::testing::Invoke;
 using ::testing::NotNull;
 using ::testing::Pair;
 using ::testing::Return;
@@ -51,6 +57,7 @@ using ::testing::UnorderedElementsAreArray;
 namespace {
 
 constexpr std::chrono::seconds FETCH_PACKAGE_NAMES_TIMEOUT_SECS = 1s;
+constexpr std::chrono::seconds PREFETCH_PACKAGE_INFOS_TIMEOUT_SECS = 1s;
 
 using PackageToAppCategoryMap =
         std::unordered_map<std::string,
@@ -78,6 +85,7 @@ public:
 
     ~PackageInfoResolverPeer() {
         PackageInfoResolver::sGetpwuidHandler = &getpwuid;
+        PackageInfoResolver::sGetRunningUidsHandler = mDefaultGetRunningUidsHandler;
         clearMappingCache();
     }
 
@@ -98,9 +106,21 @@ public:
                                                        packagesToAppCategories);
     }
 
+    void setPackageInfoCacheFilePath(const std::string& path) {
+        mPackageInfoResolver->mPackageInfoCacheFilePath = path;
+    }
+
+    void persistPackageInfoCache() { mPackageInfoResolver->persistPackageInfoCache(); }
+
+    void stubGetRunningUids(const std::unordered_set<uid_t>& uids) {
+        PackageInfoResolver::sGetRunningUidsHandler = [uids]() { return uids; };
+    }
+
     void stubGetpwuid(const std::unordered_map<uid_t, std::string>& nativeUidToPackageNameMapping) {
         updateNativeUidToPackageNameMapping(nativeUidToPackageNameMapping);
+        mGetpwuidCallCount = 0;
         PackageInfoResolver::sGetpwuidHandler = [&](uid_t uid) -> struct passwd* {
+            ++mGetpwuidCallCount;
             const auto& it = mNativeUidToPackageNameMapping.find(uid);
             if (it == mNativeUidToPackageNameMapping.end()) {
                 return nullptr;
@@ -109,6 +129,8 @@ public:
         };
     }
 
+    int getpwuidCallCount() const { return mGetpwuidCallCount; }
+
 private:
     void updateNativeUidToPackageNameMapping(
             const std::unordered_map<uid_t, std::string>& mapping) {
@@ -139,6 +161,9 @@ private:
 
     sp<PackageInfoResolver> mPackageInfoResolver;
     std::unordered_map<uid_t, struct passwd> mNativeUidToPackageNameMapping;
+    int mGetpwuidCallCount = 0;
+    const std::function<std::unordered_set<uid_t>()> mDefaultGetRunningUidsHandler =
+            PackageInfoResolver::sGetRunningUidsHandler;
 };
 
 }  // namespace internal
@@ -146,8 +171,21 @@ private:
 class PackageInfoResolverTest : public ::testing::Test {
 protected:
     virtual void SetUp() {
+        mPackageInfoCacheFilePath = StringPrintf("%s/package_info_cache.txt", mCacheDir.path);
         mPackageInfoResolver = PackageInfoResolver::getInstance();
         mPackageInfoResolverPeer = std::make_unique<internal::PackageInfoResolverPeer>();
+        mPackageInfoResolverPeer->setPackageInfoCacheFilePath(mPackageInfoCacheFilePath);
+        mMockWatchdogServiceHelper = sp<MockWatchdogServiceHelper>::make();
+        ASSERT_NO_FATAL_FAILURE(
+                mPackageInfoResolverPeer->initWatchdogServiceHelper(mMockWatchdogServiceHelper));
+    }
+
+    // Imitates a daemon restart, which drops the in-memory cache but keeps the persisted cache.
+    void restartPackageInfoResolver() {
+        PackageInfoResolver::terminate();
+        mPackageInfoResolver = PackageInfoResolver::getInstance();
+        mPackageInfoResolverPeer = std::make_unique<internal::PackageInfoResolverPeer>();
+        mPackageInfoResolverPeer->setPackageInfoCacheFilePath(mPackageInfoCacheFilePath);
         mMockWatchdogServiceHelper = sp<MockWatchdogServiceHelper>::make();
         ASSERT_NO_FATAL_FAILURE(
                 mPackageInfoResolverPeer->initWatchdogServiceHelper(mMockWatchdogServiceHelper));
@@ -159,6 +197,8 @@ protected:
         mMockWatchdogServiceHelper.clear();
     }
 
+    TemporaryDir mCacheDir;
+    std::string mPackageInfoCacheFilePath;
     sp<PackageInfoResolverInterface> mPackageInfoResolver;
     std::unique_ptr<internal::PackageInfoResolverPeer> mPackageInfoResolverPeer;
     sp<MockWatchdogServiceHelper> mMockWatchdogServiceHelper;
@@ -358,6 +398,234 @@ TEST_F(PackageInfoResolverTest, TestAsyncFetchPackageNamesForUids) {
     ASSERT_EQ(std::future_status::ready, future.wait_for(FETCH_PACKAGE_NAMES_TIMEOUT_SECS));
 }
 
+TEST_F(PackageInfoResolverTest, TestLoadsPersistedCacheAfterRestart) {
+    mPackageInfoResolverPeer->setPackageConfigurations({"vendor.pkg"}, {});
+    mPackageInfoResolverPeer->stubGetpwuid({{7700, "system.package.B"}});
+
+    std::unordered_map<uid_t, PackageInfo> expectedMappings{
+            {7700,
+             constructPackageInfo("system.package.B", 7700, UidType::NATIVE, ComponentType::SYSTEM,
+                                  ApplicationCategoryType::OTHERS)},
+            {15100,
+             constructPackageInfo("shared:vendor.package.A", 15100, UidType::APPLICATION,
+                                  ComponentType::VENDOR, ApplicationCategoryType::MEDIA,
+                                  {"vendor.package.A.1", "vendor.package.A.2"})},
+    };
+
+    EXPECT_CALL(*mMockWatchdogServiceHelper, isServiceConnected()).WillOnce(Return(true));
+    EXPECT_CALL(*mMockWatchdogServiceHelper, getPackageInfosForUids(_, _, _))
+            .WillOnce(DoAll(SetArgPointee<2>(std::vector<PackageInfo>{expectedMappings.at(15100)}),
+                            Return(ByMove(ScopedAStatus::ok()))));
+
+    mPackageInfoResolver->getPackageInfosForUids({7700, 15100});
+    mPackageInfoResolverPeer->persistPackageInfoCache();
+
+    ASSERT_NO_FATAL_FAILURE(restartPackageInfoResolver());
+    mPackageInfoResolverPeer->setPackageConfigurations({"vendor.pkg"}, {});
+    mPackageInfoResolverPeer->stubGetpwuid({});
+
+    // Only the application UIDs are resolved again after the restart.
+    EXPECT_CALL(*mMockWatchdogServiceHelper, isServiceConnected()).WillOnce(Return(true));
+    EXPECT_CALL(*mMockWatchdogServiceHelper, getPackageInfosForUids(UnorderedElementsAre(15100), _, _))
+            .WillOnce(DoAll(SetArgPointee<2>(std::vector<PackageInfo>{expectedMappings.at(15100)}),
+                            Return(ByMove(ScopedAStatus::ok()))));
+
+    auto actualMappings = mPackageInfoResolver->getPackageInfosForUids({7700, 15100});
+
+    EXPECT_THAT(actualMappings, UnorderedElementsAreArray(expectedMappings))
+            << "Expected: " << toString(expectedMappings)
+            << "\nActual: " << toString(actualMappings);
+    EXPECT_EQ(mPackageInfoResolverPeer->getpwuidCallCount(), 0);
+}
+
+TEST_F(PackageInfoResolverTest, TestDoesNotServePersistedApplicationUidsAfterRestart) {
+    std::unordered_map<uid_t, PackageInfo> cachedMappings{
+            {15100,
+             constructPackageInfo("uninstalled.package", 15100, UidType::APPLICATION,
+                                  ComponentType::THIRD_PARTY, ApplicationCategoryType::OTHERS)},
+    };
+    mPackageInfoResolverPeer->injectCacheMapping(cachedMappings);
+    mPackageInfoResolverPeer->persistPackageInfoCache();
+
+    // The UID may be reassigned to a newly installed package while the daemon is not running.
+    ASSERT_NO_FATAL_FAILURE(restartPackageInfoResolver());
+
+    EXPECT_CALL(*mMockWatchdogServiceHelper, isServiceConnected()).WillOnce(Return(false));
+
+    auto actualMappings = mPackageInfoResolver->getPackageInfosForUids({15100});
+
+    EXPECT_TRUE(actualMappings.empty())
+            << "Application UIDs must be resolved by the car watchdog service after a restart: "
+            << toString(actualMappings);
+}
+
+TEST_F(PackageInfoResolverTest, TestDiscardsPersistedCacheOnPackageConfigurationsChange) {
+    mPackageInfoResolverPeer->stubGetpwuid({{5100, "vendor.package.A"}});
+
+    mPackageInfoResolver->getPackageInfosForUids({5100});
+    mPackageInfoResolverPeer->persistPackageInfoCache();
+
+    ASSERT_NO_FATAL_FAILURE(restartPackageInfoResolver());
+    mPackageInfoResolverPeer->setPackageConfigurations({"vendor.package"}, {});
+    mPackageInfoResolverPeer->stubGetpwuid({{5100, "vendor.package.A"}});
+
+    std::unordered_map<uid_t, PackageInfo> expectedMappings{
+            {5100,
+             constructPackageInfo("vendor.package.A", 5100, UidType::NATIVE, ComponentType::VENDOR,
+                                  ApplicationCategoryType::OTHERS)},
+    };
+
+    auto actualMappings = mPackageInfoResolver->getPackageInfosForUids({5100});
+
+    EXPECT_THAT(actualMappings, UnorderedElementsAreArray(expectedMappings))
+            << "Expected: " << toString(expectedMappings)
+            << "\nActual: " << toString(actualMappings);
+    EXPECT_EQ(mPackageInfoResolverPeer->getpwuidCallCount(), 1)
+            << "Cache resolved with stale package configurations must be discarded";
+}
+
+TEST_F(PackageInfoResolverTest, TestDiscardsPersistedCacheWithUnknownFormat) {
+    ASSERT_TRUE(WriteStringToFile("0 fingerprint 0\n5100 1 1 0 vendor.package.A\n",
+                                  mPackageInfoCacheFilePath));
+    mPackageInfoResolverPeer->stubGetpwuid({{5100, "system.package.A"}});
+
+    auto actualMappings = mPackageInfoResolver->getPackageInfosForUids({5100});
+
+    ASSERT_EQ(actualMappings.count(5100), 1u);
+    EXPECT_EQ(actualMappings.at(5100).packageIdentifier.name, "system.package.A");
+    EXPECT_EQ(mPackageInfoResolverPeer->getpwuidCallCount(), 1);
+}
+
+TEST_F(PackageInfoResolverTest, TestAsyncPrefetchPackageInfos) {
+    std::unordered_map<uid_t, PackageInfo> cachedMappings{
+            {15100,
+             constructPackageInfo("vendor.package.A", 15100, UidType::APPLICATION,
+                                  ComponentType::VENDOR, ApplicationCategoryType::OTHERS)},
+            {16100,
+             constructPackageInfo("uninstalled.package", 16100, UidType::APPLICATION,
+                                  ComponentType::THIRD_PARTY, ApplicationCategoryType::OTHERS)},
+    };
+    mPackageInfoResolverPeer->injectCacheMapping(cachedMappings);
+    mPackageInfoResolverPeer->stubGetRunningUids({7700, 17100});
+    mPackageInfoResolverPeer->stubGetpwuid({{7700, "system.package.B"}});
+
+    std::unordered_map<uid_t, PackageInfo> expectedMappings{
+            {7700,
+             constructPackageInfo("system.package.B", 7700, UidType::NATIVE, ComponentType::SYSTEM,
+                                  ApplicationCategoryType::OTHERS)},
+            {15100,
+             constructPackageInfo("vendor.package.A", 15100, UidType::APPLICATION,
+                                  ComponentType::VENDOR, ApplicationCategoryType::MEDIA)},
+            {17100,
+             constructPackageInfo("third_party.package", 17100, UidType::APPLICATION,
+                                  ComponentType::THIRD_PARTY, ApplicationCategoryType::OTHERS)},
+    };
+    std::vector<PackageInfo> injectPackageInfos = {expectedMappings.at(15100),
+                                                   expectedMappings.at(17100),
+                                                   constructPackageInfo("", 16100)};
+
+    auto promise = std::promise<void>();
+    auto future = promise.get_future();
+    EXPECT_CALL(*mMockWatchdogServiceHelper, isServiceConnected()).WillOnce(Return(true));
+    EXPECT_CALL(*mMockWatchdogServiceHelper,
+                getPackageInfosForUids(UnorderedElementsAre(15100, 16100, 17100), _, _))
+            .WillOnce(Invoke([&](const std::vector<int32_t>&, const std::vector<std::string>&,
+                                 std::vector<PackageInfo>* packageInfos) {
+                *packageInfos = injectPackageInfos;
+                promise.set_value();
+                return ScopedAStatus::ok();
+            }));
+
+    mPackageInfoResolver->asyncPrefetchPackageInfos();
+
+    ASSERT_EQ(std::future_status::ready, future.wait_for(PREFETCH_PACKAGE_INFOS_TIMEOUT_SECS));
+
+    // Lookups are served by the cache, even when the car watchdog service is disconnected.
+    EXPECT_CALL(*mMockWatchdogServiceHelper, isServiceConnected()).WillRepeatedly(Return(false));
+
+    auto actualMappings = mPackageInfoResolver->getPackageInfosForUids({7700, 15100, 16100, 17100});
+
+    EXPECT_THAT(actualMappings, UnorderedElementsAreArray(expectedMappings))
+            << "Expected: " << toString(expectedMappings)
+            << "\nActual: " << toString(actualMappings);
+}
+
+TEST_F(PackageInfoResolverTest, TestFirstCollectionLatencyAfterRestart) {
+    constexpr int kNativeUidCount = 200;
+    constexpr int kAppUidCount = 300;
+    std::unordered_map<uid_t, std::string> nativeUidToPackageNameMapping;
+    std::vector<PackageInfo> appPackageInfos;
+    std::vector<uid_t> uids;
+    for (int i = 0; i < kNativeUidCount; ++i) {
+        uid_t uid = 5000 + i;
+        nativeUidToPackageNameMapping[uid] = StringPrintf("native.package.%d", i);
+        uids.push_back(uid);
+    }
+    for (int i = 0; i < kAppUidCount; ++i) {
+        int32_t uid = 1010000 + i;
+        appPackageInfos.push_back(
+                constructPackageInfo(StringPrintf("app.package.%d", i).c_str(), uid,
+                                     UidType::APPLICATION, ComponentType::THIRD_PARTY,
+                                     ApplicationCategoryType::OTHERS));
+        uids.push_back(uid);
+    }
+    int coldServiceCallCount = 0;
+    mPackageInfoResolverPeer->stubGetpwuid(nativeUidToPackageNameMapping);
+    EXPECT_CALL(*mMockWatchdogServiceHelper, isServiceConnected()).WillRepeatedly(Return(true));
+    EXPECT_CALL(*mMockWatchdogServiceHelper, getPackageInfosForUids(_, _, _))
+            .WillRepeatedly(Invoke([&](const std::vector<int32_t>&,
+                                       const std::vector<std::string>&,
+                                       std::vector<PackageInfo>* packageInfos) {
+                ++coldServiceCallCount;
+                *packageInfos = appPackageInfos;
+                return ScopedAStatus::ok();
+            }));
+
+    auto start = std::chrono::steady_clock::now();
+    auto coldMappings = mPackageInfoResolver->getPackageInfosForUids(uids);
+    const auto coldElapsed = std::chrono::duration_cast<std::chrono::microseconds>(
+            std::chrono::steady_clock::now() - start);
+    const int coldGetpwuidCallCount = mPackageInfoResolverPeer->getpwuidCallCount();
+
+    mPackageInfoResolverPeer->persistPackageInfoCache();
+    ASSERT_NO_FATAL_FAILURE(restartPackageInfoResolver());
+    mPackageInfoResolverPeer->stubGetpwuid(nativeUidToPackageNameMapping);
+    int warmServiceCallCount = 0;
+    EXPECT_CALL(*mMockWatchdogServiceHelper, isServiceConnected()).WillRepeatedly(Return(true));
+    EXPECT_CALL(*mMockWatchdogServiceHelper, getPackageInfosForUids(_, _, _))
+            .WillRepeatedly(Invoke([&](const std::vector<int32_t>&,
+                                       const std::vector<std::string>&,
+                                       std::vector<PackageInfo>* packageInfos) {
+                ++warmServiceCallCount;
+                *packageInfos = appPackageInfos;
+                return ScopedAStatus::ok();
+            }));
+
+    start = std::chrono::steady_clock::now();
+    auto warmMappings = mPackageInfoResolver->getPackageInfosForUids(uids);
+    const auto warmElapsed = std::chrono::duration_cast<std::chrono::microseconds>(
+            std::chrono::steady_clock::now() - start);
+
+    ASSERT_EQ(coldMappings.size(), uids.size());
+    EXPECT_EQ(warmMappings.size(), coldMappings.size());
+    EXPECT_EQ(mPackageInfoResolverPeer->getpwuidCallCount(), 0);
+    EXPECT_EQ(warmServiceCallCount, 1) << "Application UIDs must be resolved again";
+    /*
+     * On a device, the cold lookups cost a getpwuid call per native UID and a binder call to the
+     * car watchdog service, whereas the warm lookups read a single file and make the binder call
+     * only for the application UIDs, which are not persisted.
+     */
+    LOG(INFO) << "First collection resolved " << uids.size() << " UIDs in "
+              << coldElapsed.count() << " us with " << coldGetpwuidCallCount
+              << " getpwuid calls and " << coldServiceCallCount
+              << " car watchdog service calls, and in " << warmElapsed.count()
+              << " us from the persisted cache after a restart";
+    RecordProperty("coldFirstCollectionUs", std::to_string(coldElapsed.count()));
+    RecordProperty("warmFirstCollectionUs", std::to_string(warmElapsed.count()));
+    RecordProperty("coldGetpwuidCalls", std::to_string(coldGetpwuidCallCount));
+    RecordProperty("coldServiceCalls", std::to_string(coldServiceCallCount));
+}
+
 }  // namespace watchdog
 }  // namespace automotive
 }  // namespace android
@@ -15,6 +15,7 @@
  */
 
 #include "MockPressureMonitor.h"
+#include "MockProcDiskStatsCollector.h"
 #include "MockProcStatCollector.h"
 #include "MockUidStatsCollector.h"
 #include "MockWatchdogServiceHelper.h"
@@ -31,7 +32,9 @@
 #include <unistd.h>
 
 #include <algorithm>
+#include <future>  // NOLINT
 #include <string>
+#include <thread>  // NOLINT
 #include <type_traits>
 #include <vector>
 
@@ -57,10 +60,12 @@ using ::android::util::ProtoReader;
 using ::google::protobuf::RepeatedPtrField;
 using ::testing::_;
 using ::testing::AllOf;
+using ::testing::DoubleEq;
 using ::testing::ElementsAreArray;
 using ::testing::Eq;
 using ::testing::ExplainMatchResult;
 using ::testing::Field;
+using ::testing::FloatEq;
 using ::testing::IsSubsetOf;
 using ::testing::Matcher;
 using ::testing::Pointer;
@@ -311,7 +316,89 @@ MATCHER_P(UserPackageSummaryStatsEq, expected, "") {
                               arg, result_listener);
 }
 
+MATCHER_P(CoreStatsEq, expected, "") {
+    return ExplainMatchResult(AllOf(Field("coreId", &SystemSummaryStats::CoreStats::coreId,
+                                          Eq(expected.coreId)),
+                                    Field("busyTimeMillis",
+                                          &SystemSummaryStats::CoreStats::busyTimeMillis,
+                                          Eq(expected.busyTimeMillis)),
+                                    Field("ioWaitTimeMillis",
+                                          &SystemSummaryStats::CoreStats::ioWaitTimeMillis,
+                                          Eq(expected.ioWaitTimeMillis)),
+                                    Field("irqTimeMillis",
+                                          &SystemSummaryStats::CoreStats::irqTimeMillis,
+                                          Eq(expected.irqTimeMillis)),
+                                    Field("totalTimeMillis",
+                                          &SystemSummaryStats::CoreStats::totalTimeMillis,
+                                          Eq(expected.totalTimeMillis))),
+                              arg, result_listener);
+}
+
+MATCHER_P(CpuFreqStatsEq, expected, "") {
+    return ExplainMatchResult(AllOf(Field("policyId", &SystemSummaryStats::CpuFreqStats::policyId,
+                                          Eq(expected.policyId)),
+                                    Field("timeMillisByFreqKHz",
+                                          &SystemSummaryStats::CpuFreqStats::timeMillisByFreqKHz,
+                                          ElementsAreArray(expected.timeMillisByFreqKHz))),
+                              arg, result_listener);
+}
+
+MATCHER_P(DiskPerformanceStatsEq, expected, "") {
+    return ExplainMatchResult(AllOf(Field("deviceName", &DiskPerformanceStats::deviceName,
+                                          Eq(expected.deviceName)),
+                                    Field("numReadsCompleted",
+                                          &DiskPerformanceStats::numReadsCompleted,
+                                          Eq(expected.numReadsCompleted)),
+                                    Field("numWritesCompleted",
+                                          &DiskPerformanceStats::numWritesCompleted,
+                                          Eq(expected.numWritesCompleted)),
+                                    Field("numFlushCompleted",
+                                          &DiskPerformanceStats::numFlushCompleted,
+                                          Eq(expected.numFlushCompleted)),
+                                    Field("avgReadLatencyMillis",
+                                          &DiskPerformanceStats::avgReadLatencyMillis,
+                                          DoubleEq(expected.avgReadLatencyMillis)),
+                                    Field("avgWriteLatencyMillis",
+                                          &DiskPerformanceStats::avgWriteLatencyMillis,
+                                          DoubleEq(expected.avgWriteLatencyMillis)),
+                                    Field("avgFlushLatencyMillis",
+                                          &DiskPerformanceStats::avgFlushLatencyMillis,
+                                          DoubleEq(expected.avgFlushLatencyMillis)),
+                                    Field("utilizationPercent",
+                                          &DiskPerformanceStats::utilizationPercent,
+                                          DoubleEq(expected.utilizationPercent)),
+                                    Field("avgQueueDepth", &DiskPerformanceStats::avgQueueDepth,
+                                          DoubleEq(expected.avgQueueDepth)),
+                                    Field("latencyAlertCount",
+                                          &DiskPerformanceStats::latencyAlertCount,
+                                          Eq(expected.latencyAlertCount))),
+                              arg, result_listener);
+}
+
 MATCHER_P(SystemSummaryStatsEq, expected, "") {
+    const auto& coreStatsMatchers = [&](const std::vector<SystemSummaryStats::CoreStats>& stats) {
+        std::vector<Matcher<const SystemSummaryStats::CoreStats&>> matchers;
+        for (const auto& curStats : stats) {
+            matchers.push_back(CoreStatsEq(curStats));
+        }
+        return ElementsAreArray(matchers);
+    };
+    const auto& cpuFreqStatsMatchers =
+            [&](const std::vector<SystemSummaryStats::CpuFreqStats>& stats) {
+                std::vector<Matcher<const SystemSummaryStats::CpuFreqStats&>> matchers;
+                for (const auto& curStats : stats) {
+                    matchers.push_back(CpuFreqStatsEq(curStats));
+                }
+                return ElementsAreArray(matchers);
+            };
+    const auto& diskPerformanceStatsMatchers =
+            [&](const std::vector<DiskPerformanceStats>& stats) {
+                std::vector<Matcher<const DiskPerformanceStats&>> matchers;
+                for (const auto& curStats : stats) {
+                    matchers.push_back(DiskPerformanceStatsEq(curStats));
+                }
+                return ElementsAreArray(matchers);
+            };
     return ExplainMatchResult(AllOf(Field("cpuIoWaitTimeMillis",
                                           &SystemSummaryStats::cpuIoWaitTimeMillis,
                                           Eq(expected.cpuIoWaitTimeMillis)),
@@ -331,7 +418,16 @@ MATCHER_P(SystemSummaryStatsEq, expected, "") {
                                           Eq(expected.ioBlockedProcessCount)),
                                     Field("totalProcessCount",
                                           &SystemSummaryStats::totalProcessCount,
-                                          Eq(expected.totalProcessCount))),
+                                          Eq(expected.totalProcessCount)),
+                                    Field("coreStats", &SystemSummaryStats::coreStats,
+                                          coreStatsMatchers(expected.coreStats)),
+                                    Field("cpuFreqPolicyStats",
+                                          &SystemSummaryStats::cpuFreqPolicyStats,
+                                          cpuFreqStatsMatchers(expected.cpuFreqPolicyStats)),
+                                    Field("diskPerformanceStats",
+                                          &SystemSummaryStats::diskPerformanceStats,
+                                          diskPerformanceStatsMatchers(
+                                                  expected.diskPerformanceStats))),
                               arg, result_listener);
 }
 
@@ -345,7 +441,8 @@ MATCHER_P(PerfStatsRecordEq, expected, "") {
                                                   expected.userPackageSummaryStats)),
                                     Field(&PerfStatsRecord::memoryPressureLevelDurations,
                                           UnorderedElementsAreArray(
-                                                  expected.memoryPressureLevelDurations))),
+                                                  expected.memoryPressureLevelDurations)),
+                                    Field(&PerfStatsRecord::isPartial, Eq(expected.isPartial))),
                               arg, result_listener);
 }
 
@@ -652,13 +749,42 @@ std::tuple<ProcStatInfo, SystemSummaryStats> sampleProcStat(auto int64Multiplier
                               /*ctxtSwitches=*/uint64Multiplier(500),
                               /*runnableCnt=*/uint32Multiplier(100),
                               /*ioBlockedCnt=*/uint32Multiplier(57)};
+    procStatInfo.onlineCores.set(0);
+    procStatInfo.coreCpuStats[0] = {int64Multiplier(1'200), 0, int64Multiplier(300),
+                                    int64Multiplier(400),
+                                    /*ioWaitTimeMillis=*/int64Multiplier(100),
+                                    int64Multiplier(50), int64Multiplier(25), 0, 0, 0};
+    procStatInfo.onlineCores.set(3);
+    procStatInfo.coreCpuStats[3] = {int64Multiplier(800), 0, int64Multiplier(200),
+                                    int64Multiplier(900), /*ioWaitTimeMillis=*/0,
+                                    int64Multiplier(10), int64Multiplier(10), 0, 0, 0};
+    procStatInfo.cpuFreqPolicyCount = 1;
+    procStatInfo.cpuFreqPolicyStats[0].policyId = 0;
+    procStatInfo.cpuFreqPolicyStats[0].stateCount = 2;
+    procStatInfo.cpuFreqPolicyStats[0].residencies[0] = {300'000, int64Multiplier(700)};
+    procStatInfo.cpuFreqPolicyStats[0].residencies[1] = {1'200'000, 0};
     SystemSummaryStats systemSummaryStats{/*cpuIoWaitTimeMillis=*/int64Multiplier(5'900),
                                           /*cpuIdleTimeMillis=*/int64Multiplier(8'900),
                                           /*totalCpuTimeMillis=*/int64Multiplier(48'376),
                                           /*totalCpuCycles=*/64'000,
                                           /*contextSwitchesCount=*/uint64Multiplier(500),
                                           /*ioBlockedProcessCount=*/uint32Multiplier(57),
-                                          /*totalProcessCount=*/uint32Multiplier(157)};
+                                          /*totalProcessCount=*/uint32Multiplier(157),
+                                          /*coreStats=*/
+                                          {{/*coreId=*/0,
+                                            /*busyTimeMillis=*/int64Multiplier(1'575),
+                                            /*ioWaitTimeMillis=*/int64Multiplier(100),
+                                            /*irqTimeMillis=*/int64Multiplier(75),
+                                            /*totalTimeMillis=*/int64Multiplier(2'075)},
+                                           {/*coreId=*/3,
+                                            /*busyTimeMillis=*/int64Multiplier(1'020),
+                                            /*ioWaitTimeMillis=*/0,
+                                            /*irqTimeMillis=*/int64Multiplier(20),
+                                            /*totalTimeMillis=*/int64Multiplier(1'920)}},
+                                          /*cpuFreqPolicyStats=*/
+                                          {{/*policyId=*/0,
+                                            /*timeMillisByFreqKHz=*/{
+                                                    {300'000, int64Multiplier(700)}}}}};
     return std::make_tuple(procStatInfo, systemSummaryStats);
 }
 
@@ -981,7 +1107,76 @@ MATCHER_P2(TimeOfDayProtoEq, expected, nowTimeMs, "") {
                               arg, result_listener);
 }
 
+MATCHER_P(CpuCoreStatsProtoEq, expected, "") {
+    return ExplainMatchResult(AllOf(Property("core_id", &CpuCoreStats::core_id, expected.coreId),
+                                    Property("busy_time_millis", &CpuCoreStats::busy_time_millis,
+                                             expected.busyTimeMillis),
+                                    Property("io_wait_time_millis",
+                                             &CpuCoreStats::io_wait_time_millis,
+                                             expected.ioWaitTimeMillis),
+                                    Property("irq_time_millis", &CpuCoreStats::irq_time_millis,
+                                             expected.irqTimeMillis),
+                                    Property("total_time_millis", &CpuCoreStats::total_time_millis,
+                                             expected.totalTimeMillis)),
+                              arg, result_listener);
+}
+
+MATCHER_P(CpuFreqPolicyStatsProtoEq, expected, "") {
+    std::vector<Matcher<const CpuFreqPolicyStats_FreqResidency&>> freqResidencyMatchers;
+    for (const auto& [freqKHz, timeMillis] : expected.timeMillisByFreqKHz) {
+        freqResidencyMatchers.push_back(
+                AllOf(Property("freq_khz", &CpuFreqPolicyStats_FreqResidency::freq_khz,
+                               static_cast<int>(freqKHz)),
+                      Property("time_millis", &CpuFreqPolicyStats_FreqResidency::time_millis,
+                               timeMillis)));
+    }
+    return ExplainMatchResult(AllOf(Property("policy_id", &CpuFreqPolicyStats::policy_id,
+                                             expected.policyId),
+                                    Property("freq_residencies",
+                                             &CpuFreqPolicyStats::freq_residencies,
+                                             ElementsAreArray(freqResidencyMatchers))),
+                              arg, result_listener);
+}
+
+MATCHER_P(StorageDeviceStatsProtoEq, expected, "") {
+    return ExplainMatchResult(
+            AllOf(Property("device_name", &StorageDeviceStats::device_name, expected.deviceName),
+                  Property("reads_completed", &StorageDeviceStats::reads_completed,
+                           static_cast<int64_t>(expected.numReadsCompleted)),
+                  Property("writes_completed", &StorageDeviceStats::writes_completed,
+                           static_cast<int64_t>(expected.numWritesCompleted)),
+                  Property("flushes_completed", &StorageDeviceStats::flushes_completed,
+                           static_cast<int64_t>(expected.numFlushCompleted)),
+                  Property("avg_read_latency_millis", &StorageDeviceStats::avg_read_latency_millis,
+                           FloatEq(expected.avgReadLatencyMillis)),
+                  Property("avg_write_latency_millis",
+                           &StorageDeviceStats::avg_write_latency_millis,
+                           FloatEq(expected.avgWriteLatencyMillis)),
+                  Property("avg_flush_latency_millis",
+                           &StorageDeviceStats::avg_flush_latency_millis,
+                           FloatEq(expected.avgFlushLatencyMillis)),
+                  Property("utilization_percent", &StorageDeviceStats::utilization_percent,
+                           FloatEq(expected.utilizationPercent)),
+                  Property("avg_queue_depth", &StorageDeviceStats::avg_queue_depth,
+                           FloatEq(expected.avgQueueDepth)),
+                  Property("latency_alert_count", &StorageDeviceStats::latency_alert_count,
+                           expected.latencyAlertCount)),
+            arg, result_listener);
+}
+
 MATCHER_P2(SystemWideStatsProtoEq, userPackageSummaryStats, systemSummaryStats, "") {
+    std::vector<Matcher<const CpuCoreStats&>> cpuCoreStatsMatchers;
+    for (const auto& expectedCoreStats : systemSummaryStats.coreStats) {
+        cpuCoreStatsMatchers.push_back(CpuCoreStatsProtoEq(expectedCoreStats));
+    }
+    std::vector<Matcher<const CpuFreqPolicyStats&>> cpuFreqPolicyStatsMatchers;
+    for (const auto& expectedCpuFreqStats : systemSummaryStats.cpuFreqPolicyStats) {
+        cpuFreqPolicyStatsMatchers.push_back(CpuFreqPolicyStatsProtoEq(expectedCpuFreqStats));
+    }
+    std::vector<Matcher<const StorageDeviceStats&>> storageDeviceStatsMatchers;
+    for (const auto& expectedDiskStats : systemSummaryStats.diskPerformanceStats) {
+        storageDeviceStatsMatchers.push_back(StorageDeviceStatsProtoEq(expectedDiskStats));
+    }
     return ExplainMatchResult(AllOf(Property("io_wait_time_millis",
                                              &SystemWideStats::io_wait_time_millis,
                                              systemSummaryStats.cpuIoWaitTimeMillis),
@@ -1019,7 +1214,15 @@ MATCHER_P2(SystemWideStatsProtoEq, userPackageSummaryStats, systemSummaryStats,
                                                                    userPackageSummaryStats
                                                                            .totalIoStats
                                                                                    [FSYNC_COUNT]
-                                                                                   [BACKGROUND]))),
+                                                                                   [BACKGROUND])),
+                                    Property("cpu_core_stats", &SystemWideStats::cpu_core_stats,
+                                             ElementsAreArray(cpuCoreStatsMatchers)),
+                                    Property("cpu_freq_policy_stats",
+                                             &SystemWideStats::cpu_freq_policy_stats,
+                                             ElementsAreArray(cpuFreqPolicyStatsMatchers)),
+                                    Property("storage_device_stats",
+                                             &SystemWideStats::storage_device_stats,
+                                             ElementsAreArray(storageDeviceStatsMatchers))),
                               arg, result_listener);
 }
 
@@ -1284,6 +1487,10 @@ protected:
         mNowMillis += std::chrono::milliseconds(durationMillis);
     }
 
+    void advanceElapsedRealtime(int64_t durationMillis) {
+        mElapsedRealtimeSinceBootMillis += durationMillis;
+    }
+
     std::tuple<CollectionInfo, ResourceStats> setupFirstCollection(
             size_t maxCollectionCacheSize = std::numeric_limits<std::size_t>::max(),
             bool isSmapsRollupSupported = kTestIsSmapsRollupSupported) {
@@ -1669,7 +1876,7 @@ TEST_F(PerformanceProfilerTest, TestOnCustomCollectionWithPackageFilter) {
     // Filter by package name should ignore this limit with package filter.
     mCollectorPeer->setTopNStatsPerCategory(1);
 
-    auto [expectedCollectionInfo, expectedResourceStats] = setupFirstCollection();
+    auto [expectedCollectionInfo, _] = setupFirstCollection();
 
     ResourceStats actualResourceStats = {};
     ASSERT_RESULT_OK(mCollector->onCustomCollection(getNowMillis(), SystemState::NORMAL_MODE,
@@ -1728,23 +1935,27 @@ TEST_F(PerformanceProfilerTest, TestOnCustomCollectionWithPackageFilter) {
             .totalIoStats = {{1000, 21'600}, {300, 28'300}, {600, 600}},
             .taskCountByUid = {{1009, 1}, {1002001, 5}},
             .totalCpuTimeMillis = 48'376,
-            .totalCpuCycles = 64'000,
-            .totalMajorFaults = 84'345,
-            .totalRssKb = 5010,
-            .totalPssKb = 4145,
+            // The per-process totals aren't computed because the per-process stats are collected
+            // only for the filtered packages.
+            .totalCpuCycles = 0,
+            .totalMajorFaults = 0,
+            .totalRssKb = 0,
+            .totalPssKb = 0,
             .majorFaultsPercentChange = 0.0,
     };
     applyFeatureFilter(&userPackageSummaryStats);
     expectedCollectionInfo.records[0].userPackageSummaryStats = userPackageSummaryStats;
+    expectedCollectionInfo.records[0].systemSummaryStats.totalCpuCycles = 0;
+    expectedCollectionInfo.records[0].isPartial = true;
 
     EXPECT_THAT(actualCollectionInfo, CollectionInfoEq(expectedCollectionInfo))
             << "Custom collection info doesn't match.\nExpected:\n"
             << expectedCollectionInfo.toString() << "\nActual:\n"
             << actualCollectionInfo.toString();
 
-    ASSERT_EQ(actualResourceStats, expectedResourceStats)
-            << "Expected: " << expectedResourceStats.toString()
-            << "\nActual: " << actualResourceStats.toString();
+    ASSERT_EQ(actualResourceStats, ResourceStats{})
+            << "Resource usage stats must not be sent for partial collections. Actual: "
+            << actualResourceStats.toString();
 
     ASSERT_NO_FATAL_FAILURE(checkCustomDumpContents()) << "Custom collection should be reported";
 
@@ -1961,6 +2172,97 @@ TEST_F(PerformanceProfilerTest, TestUserSwitchCollectionCacheEvictionAfterTimeou
     }
 }
 
+TEST_F(PerformanceProfilerTest, TestOnPeriodicMonitorReportsStoragePerformance) {
+    sp<MockProcDiskStatsCollector> mockProcDiskStatsCollector =
+            sp<MockProcDiskStatsCollector>::make();
+    std::vector<DiskStats> firstPollStats = {
+            {8, 0, "sda", 100, 0, 400, 400, 50, 0, 200, 500, 500, 900, 0, 0}};
+    std::vector<DiskStats> secondPollStats = {
+            {8, 0, "sda", 100, 0, 400, 4'000, 50, 0, 200, 500, 1'500, 4'500, 0, 0}};
+    EXPECT_CALL(*mockProcDiskStatsCollector, deltaPhysicalDeviceDiskStats())
+            .WillOnce(Return(firstPollStats))
+            .WillOnce(Return(secondPollStats));
+
+    int alertCount = 0;
+    const auto alertHandler = [&alertCount]() { ++alertCount; };
+
+    // The first poll reports the stats since boot up, so it is not accounted.
+    ASSERT_RESULT_OK(mCollector->onPeriodicMonitor(0, mockProcDiskStatsCollector, alertHandler));
+    advanceElapsedRealtime(/*durationMillis=*/2'000);
+    ASSERT_RESULT_OK(mCollector->onPeriodicMonitor(0, mockProcDiskStatsCollector, alertHandler));
+
+    EXPECT_EQ(alertCount, 0);
+
+    advanceElapsedRealtime(/*durationMillis=*/2'000);
+    ASSERT_RESULT_OK(mCollector->onPeriodicMonitor(0, mockProcDiskStatsCollector, alertHandler));
+
+    EXPECT_EQ(alertCount, 1) << "Read latency degradation should be alerted";
+
+    auto [expectedCollectionInfo, expectedResourceStats] =
+            setupFirstCollection(kTestPeriodicCollectionBufferSize);
+    expectedCollectionInfo.records[0].systemSummaryStats.diskPerformanceStats = {{
+            .deviceName = "sda",
+            .numReadsCompleted = 200,
+            .numWritesCompleted = 100,
+            .numFlushCompleted = 0,
+            .avgReadLatencyMillis = 22.0,
+            .avgWriteLatencyMillis = 10.0,
+            .avgFlushLatencyMillis = 0.0,
+            .utilizationPercent = 50.0,
+            .avgQueueDepth = 1.35,
+            .latencyAlertCount = 1,
+    }};
+
+    ResourceStats actualResourceStats = {};
+    ASSERT_RESULT_OK(mCollector->onPeriodicCollection(getNowMillis(), SystemState::NORMAL_MODE,
+                                                      mMockUidStatsCollector,
+                                                      mMockProcStatCollector,
+                                                      &actualResourceStats));
+
+    const auto actualCollectionInfo = mCollectorPeer->getPeriodicCollectionInfo();
+
+    EXPECT_THAT(actualCollectionInfo, CollectionInfoEq(expectedCollectionInfo))
+            << "Periodic collection info doesn't match.\nExpected:\n"
+            << expectedCollectionInfo.toString() << "\nActual:\n"
+            << actualCollectionInfo.toString();
+}
+
+TEST_F(PerformanceProfilerTest, TestOnPeriodicMonitorDoesNotWaitForPeriodicCollection) {
+    sp<MockProcDiskStatsCollector> mockProcDiskStatsCollector =
+            sp<MockProcDiskStatsCollector>::make();
+    ON_CALL(*mockProcDiskStatsCollector, deltaPhysicalDeviceDiskStats())
+            .WillByDefault(Return(std::vector<DiskStats>{}));
+
+    // Block the collection inside the data processor, after it acquired its lock.
+    std::promise<void> collectionStarted;
+    std::promise<void> releaseCollection;
+    std::shared_future<void> releaseCollectionFuture = releaseCollection.get_future().share();
+    EXPECT_CALL(*mMockUidStatsCollector, deltaStats()).WillOnce([&]() {
+        collectionStarted.set_value();
+        releaseCollectionFuture.wait();
+        return std::vector<UidStats>{};
+    });
+    std::thread collectionThread([&]() {
+        ResourceStats resourceStats = {};
+        EXPECT_RESULT_OK(mCollector->onPeriodicCollection(getNowMillis(), SystemState::NORMAL_MODE,
+                                                          mMockUidStatsCollector,
+                                                          mMockProcStatCollector, &resourceStats));
+    });
+    collectionStarted.get_future().wait();
+
+    auto monitorFuture = std::async(std::launch::async, [&]() {
+        return mCollector->onPeriodicMonitor(0, mockProcDiskStatsCollector, []() {});
+    });
+    bool didMonitorFinish = monitorFuture.wait_for(std::chrono::seconds(1)) ==
+            std::future_status::ready;
+
+    releaseCollection.set_value();
+    collectionThread.join();
+
+    ASSERT_TRUE(didMonitorFinish) << "Periodic monitor waited for the periodic collection";
+    ASSERT_RESULT_OK(monitorFuture.get());
+}
+
 TEST_F(PerformanceProfilerTest, TestOnDumpProto) {
     auto statsInfo = getSampleStatsInfo();
 
@@ -131,6 +131,50 @@ TEST(ProcDiskStatsCollectorTest, TestValidStatsFile) {
             << getDiskStatsLine(actualDiskStats) << "'";
 }
 
+TEST(ProcDiskStatsCollectorTest, TestDeltaPhysicalDeviceDiskStats) {
+    ProcDiskStatsCollectorInterface::PerPartitionDiskStats firstDiskStats =
+            {{179, 0, "mmcblk0", 1000, 10, 4000, 2000, 500, 5, 3000, 4000, 3000, 6000, 50, 100},
+             {179, 1, "mmcblk0p1", 600, 6, 2400, 1200, 300, 3, 1800, 2400, 1800, 3600, 0, 0},
+             {8, 0, "sda", 2000, 20, 8000, 1000, 800, 8, 6000, 1600, 2000, 2600, 80, 160},
+             {8, 1, "sda1", 2000, 20, 8000, 1000, 800, 8, 6000, 1600, 2000, 2600, 0, 0},
+             {7, 0, "loop0", 50, 0, 200, 10, 0, 0, 0, 0, 10, 10, 0, 0},
+             {254, 0, "dm-0", 900, 0, 3600, 1900, 400, 0, 2800, 3800, 2900, 5700, 0, 0},
+             {251, 0, "zram0", 300, 0, 1200, 30, 200, 0, 800, 20, 50, 50, 0, 0}};
+    TemporaryFile tf;
+    ASSERT_NE(tf.fd, -1);
+    ASSERT_TRUE(WriteStringToFile(getDiskStatsFile(firstDiskStats), tf.path));
+
+    ProcDiskStatsCollector collector(tf.path);
+    collector.init();
+
+    ASSERT_TRUE(collector.enabled()) << "Temporary file is inaccessible";
+    ASSERT_RESULT_OK(collector.collect());
+
+    ProcDiskStatsCollectorInterface::PerPartitionDiskStats secondDiskStats =
+            {{179, 0, "mmcblk0", 1100, 10, 4400, 2500, 600, 5, 3400, 5000, 3500, 7600, 60, 180},
+             {179, 1, "mmcblk0p1", 650, 6, 2600, 1400, 350, 3, 2000, 2900, 2100, 4500, 0, 0},
+             {8, 0, "sda", 2400, 20, 9600, 1200, 800, 8, 6000, 1600, 2200, 2800, 80, 160},
+             {8, 1, "sda1", 2400, 20, 9600, 1200, 800, 8, 6000, 1600, 2200, 2800, 0, 0},
+             {7, 0, "loop0", 60, 0, 240, 12, 0, 0, 0, 0, 12, 12, 0, 0},
+             {254, 0, "dm-0", 1000, 0, 4000, 2400, 500, 0, 3200, 4800, 3400, 7200, 0, 0},
+             {251, 0, "zram0", 400, 0, 1600, 40, 300, 0, 1200, 30, 60, 70, 0, 0}};
+    ASSERT_TRUE(WriteStringToFile(getDiskStatsFile(secondDiskStats), tf.path));
+    ASSERT_RESULT_OK(collector.collect());
+
+    std::vector<DiskStats> expectedDiskStats =
+            {{179, 0, "mmcblk0", 100, 0, 400, 500, 100, 0, 400, 1000, 500, 1600, 10, 80},
+             {8, 0, "sda", 400, 0, 1600, 200, 0, 0, 0, 0, 200, 200, 0, 0}};
+
+    const auto actualDiskStats = collector.deltaPhysicalDeviceDiskStats();
+
+    ASSERT_EQ(actualDiskStats.size(), expectedDiskStats.size());
+    for (size_t i = 0; i < expectedDiskStats.size(); ++i) {
+        EXPECT_TRUE(isEquals(expectedDiskStats[i], actualDiskStats[i]))
+                << "Expected: '" << getDiskStatsLine(expectedDiskStats[i]) << "'\nActual: '"
+                << getDiskStatsLine(actualDiskStats[i]) << "'";
+    }
+}
+
 TEST(ProcDiskStatsCollectorTest, TestErrorOnInvalidStatsFile) {
     constexpr char contents[] = "252 0 disk 1200 300 0 CORRUPTED DATA\n";
     TemporaryFile tf;
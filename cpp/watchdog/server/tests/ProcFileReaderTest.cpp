@@ -0,0 +1,194 @@
+/*
+ * Copyright 2024 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "ProcFileReader.h"
+
+#include <android-base/file.h>
+#include <android-base/logging.h>
+#include <android-base/strings.h>
+#include <gmock/gmock.h>
+
+#include <unistd.h>
+
+#include <chrono>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace android {
+namespace automotive {
+namespace watchdog {
+
+using ::android::base::ReadFileToString;
+using ::android::base::Split;
+using ::android::base::WriteStringToFile;
+using ::testing::ElementsAre;
+
+namespace {
+
+constexpr const char kProcStatPath[] = "/proc/stat";
+constexpr int kBenchmarkIterations = 1000;
+
+std::vector<std::string> readLines(std::string_view contents) {
+    std::vector<std::string> lines;
+    LineReader lineReader(contents);
+    for (std::string_view line; lineReader.next(&line);) {
+        lines.emplace_back(line);
+    }
+    return lines;
+}
+
+}  // namespace
+
+TEST(ProcFileReaderTest, TestReadRestartsFromTheBeginning) {
+    TemporaryFile tf;
+    ASSERT_NE(tf.fd, -1);
+    ASSERT_TRUE(WriteStringToFile("first line\nsecond line\n", tf.path));
+
+    ProcFileReader reader(tf.path);
+    auto contents = reader.read();
+
+    ASSERT_RESULT_OK(contents);
+    EXPECT_EQ(*contents, "first line\nsecond line\n");
+
+    ASSERT_TRUE(WriteStringToFile("new line\n", tf.path));
+    contents = reader.read();
+
+    ASSERT_RESULT_OK(contents);
+    EXPECT_EQ(*contents, "new line\n");
+    EXPECT_EQ(contents->data()[contents->size()], '\0') << "Contents must be null-terminated";
+    EXPECT_EQ(reader.readStats().openCount, 1) << "File must be opened only once";
+    EXPECT_EQ(reader.readStats().bufferAllocationCount, 1)
+            << "Buffer must be reused across reads";
+}
+
+TEST(ProcFileReaderTest, TestReadGrowsBufferForLargeFiles) {
+    const std::string largeContents(10'000, 'a');
+    TemporaryFile tf;
+    ASSERT_NE(tf.fd, -1);
+    ASSERT_TRUE(WriteStringToFile(largeContents, tf.path));
+
+    ProcFileReader reader(tf.path);
+    auto contents = reader.read();
+
+    ASSERT_RESULT_OK(contents);
+    EXPECT_EQ(*contents, largeContents);
+
+    const int64_t allocationCount = reader.readStats().bufferAllocationCount;
+    contents = reader.read();
+
+    ASSERT_RESULT_OK(contents);
+    EXPECT_EQ(*contents, largeContents);
+    EXPECT_EQ(reader.readStats().bufferAllocationCount, allocationCount)
+            << "Buffer must not grow when the file size doesn't grow";
+}
+
+TEST(ProcFileReaderTest, TestReadWithMissingFile) {
+    ProcFileReader reader("/invalid/path/to/file");
+
+    EXPECT_FALSE(reader.read().ok()) << "No error returned for a missing file";
+}
+
+TEST(ProcFileReaderTest, TestLineReader) {
+    EXPECT_THAT(readLines("line 1\n\nline 3\n"), ElementsAre("line 1", "", "line 3"));
+    EXPECT_THAT(readLines("line 1\nline 2"), ElementsAre("line 1", "line 2"));
+    EXPECT_THAT(readLines(""), ElementsAre());
+}
+
+TEST(ProcFileReaderTest, TestSplitFields) {
+    std::vector<std::string_view> fields;
+
+    splitFields("cpu  1 2", ' ', &fields);
+
+    EXPECT_THAT(fields, ElementsAre("cpu", "", "1", "2"));
+
+    splitFields("", ' ', &fields);
+
+    EXPECT_THAT(fields, ElementsAre(""));
+}
+
+TEST(ProcFileReaderTest, TestParseIntField) {
+    int64_t signedValue = 0;
+    uint32_t unsignedValue = 0;
+
+    EXPECT_TRUE(parseIntField("-123", &signedValue));
+    EXPECT_EQ(signedValue, -123);
+    EXPECT_TRUE(parseIntField("4294967295", &unsignedValue));
+    EXPECT_EQ(unsignedValue, 4294967295u);
+    EXPECT_FALSE(parseIntField("", &signedValue));
+    EXPECT_FALSE(parseIntField("12a", &signedValue));
+    EXPECT_FALSE(parseIntField("-1", &unsignedValue));
+    EXPECT_FALSE(parseIntField("4294967296", &unsignedValue));
+}
+
+TEST(ProcFileReaderTest, TestReadProcStatFromDevice) {
+    if (access(kProcStatPath, R_OK) != 0) {
+        GTEST_SKIP() << kProcStatPath << " is inaccessible";
+    }
+
+    std::vector<std::string_view> fields;
+    auto start = std::chrono::steady_clock::now();
+    size_t lineCount = 0;
+    for (int i = 0; i < kBenchmarkIterations; ++i) {
+        std::string buffer;
+        ASSERT_TRUE(ReadFileToString(kProcStatPath, &buffer));
+        for (const auto& line : Split(buffer, "\n")) {
+            lineCount += Split(line, " ").size() > 1 ? 1 : 0;
+        }
+    }
+    const auto readFileToStringElapsed = std::chrono::duration_cast<std::chrono::nanoseconds>(
+            std::chrono::steady_clock::now() - start);
+
+    ProcFileReader reader(kProcStatPath);
+    start = std::chrono::steady_clock::now();
+    size_t readerLineCount = 0;
+    for (int i = 0; i < kBenchmarkIterations; ++i) {
+        auto contents = reader.read();
+        ASSERT_RESULT_OK(contents);
+        LineReader lineReader(*contents);
+        for (std::string_view line; lineReader.next(&line);) {
+            splitFields(line, ' ', &fields);
+            readerLineCount += fields.size() > 1 ? 1 : 0;
+        }
+    }
+    const auto readerElapsed = std::chrono::duration_cast<std::chrono::nanoseconds>(
+            std::chrono::steady_clock::now() - start);
+
+    // Both read the same number of lines give or take lines that appear or disappear on CPU
+    // hotplug.
+    EXPECT_GT(readerLineCount, 0u);
+    EXPECT_GT(lineCount, 0u);
+    const auto& readStats = reader.readStats();
+    EXPECT_EQ(readStats.openCount, 1);
+    const double readSyscallsPerCollection =
+            static_cast<double>(readStats.readSyscallCount) / kBenchmarkIterations;
+    LOG(INFO) << "Read " << kProcStatPath << " in "
+              << readFileToStringElapsed.count() / kBenchmarkIterations
+              << " ns with ReadFileToString and Split, and in "
+              << readerElapsed.count() / kBenchmarkIterations << " ns with ProcFileReader ("
+              << readSyscallsPerCollection << " read syscalls per collection and "
+              << readStats.bufferAllocationCount << " buffer allocations in total)";
+    RecordProperty("readFileToStringAvgNs",
+                   std::to_string(readFileToStringElapsed.count() / kBenchmarkIterations));
+    RecordProperty("procFileReaderAvgNs",
+                   std::to_string(readerElapsed.count() / kBenchmarkIterations));
+    RecordProperty("readSyscallsPerCollection", std::to_string(readSyscallsPerCollection));
+    RecordProperty("bufferAllocations", std::to_string(readStats.bufferAllocationCount));
+}
+
+}  // namespace watchdog
+}  // namespace automotive
+}  // namespace android
@@ -17,11 +17,14 @@
 #include "ProcStatCollector.h"
 
 #include <android-base/file.h>
+#include <android-base/logging.h>
 #include <android-base/stringprintf.h>
 #include <gmock/gmock.h>
 
 #include <inttypes.h>
+#include <sys/stat.h>
 
+#include <chrono>
 #include <string>
 
 namespace android {
@@ -30,10 +33,13 @@ namespace watchdog {
 
 namespace {
 
+using ::android::base::StringAppendF;
 using ::android::base::StringPrintf;
 using ::android::base::WriteStringToFile;
 
 const int64_t kMillisPerClockTick = 1000 / sysconf(_SC_CLK_TCK);
+constexpr int kParseBenchmarkCoreCount = 16;
+constexpr int kParseBenchmarkIterations = 2000;
 
 int64_t clockTicksToMillis(int64_t ticks) {
     return ticks * kMillisPerClockTick;
@@ -55,6 +61,24 @@ std::string toString(const ProcStatInfo& info) {
                         info.runnableProcessCount, info.ioBlockedProcessCount);
 }
 
+// Returns `/proc/stat` contents of a device with |coreCount| online cores.
+std::string procStatContentsWithCores(int coreCount) {
+    std::string contents = "cpu  96000 5700 27000 310000 11000 5200 3900 0 0 0\n";
+    for (int i = 0; i < coreCount; ++i) {
+        StringAppendF(&contents, "cpu%d %d %d %d %d %d %d %d 0 0 0\n", i, 6000 + i, 350 + i,
+                      1700 + i, 19000 + i, 690 + i, 320 + i, 240 + i);
+    }
+    contents += "intr 694351583 0 0 0 297062868 0 5922464 0 0 0 0 0 0 0 0 0 0 0 0 0 0 0 0 0 0 0 0 "
+                "0 0 0 0\n"
+                "ctxt 579020168\n"
+                "btime 1579718450\n"
+                "processes 113804\n"
+                "procs_running 17\n"
+                "procs_blocked 5\n"
+                "softirq 33275060 934664 11958403 5111 516325 200333 0 341482 10651335 0 8667407\n";
+    return contents;
+}
+
 }  // namespace
 
 TEST(ProcStatCollectorTest, TestValidStatFile) {
@@ -148,6 +172,166 @@ TEST(ProcStatCollectorTest, TestValidStatFile) {
             << toString(actualSecondDelta);
 }
 
+TEST(ProcStatCollectorTest, TestValidPerCoreStatsAndCpuFreqResidency) {
+    constexpr char firstSnapshot[] =
+            "cpu  6200 5700 1700 3100 1100 5200 3900 0 0 0\n"
+            "cpu0 2400 2900 600 690 340 4300 2100 0 0 0\n"
+            "cpu1 1900 2380 510 760 51 370 1500 0 0 0\n"
+            "cpu3 1000 20 190 650 109 130 140 0 0 0\n"
+            "ctxt 579020168\n"
+            "btime 1579718450\n"
+            "processes 113804\n"
+            "procs_running 17\n"
+            "procs_blocked 5\n";
+    constexpr char secondSnapshot[] =
+            "cpu  16200 8700 2000 4100 2200 6200 5900 0 0 0\n"
+            "cpu0 4400 3400 700 890 800 4500 3100 0 0 0\n"
+            "cpu1 5900 3380 610 960 100 670 2000 0 0 0\n"
+            "cpu2 2900 1000 450 1400 800 600 460 0 0 0\n"
+            "cpu3 3000 920 240 850 500 430 340 0 0 0\n"
+            "ctxt 810020192\n"
+            "btime 1579718450\n"
+            "processes 113804\n"
+            "procs_running 10\n"
+            "procs_blocked 2\n";
+
+    TemporaryFile tf;
+    ASSERT_NE(tf.fd, -1);
+    TemporaryDir cpuFreqDir;
+    const std::string littlePolicyStats = StringPrintf("%s/policy0/stats", cpuFreqDir.path);
+    const std::string bigPolicyStats = StringPrintf("%s/policy4/stats", cpuFreqDir.path);
+    ASSERT_EQ(mkdir(StringPrintf("%s/policy0", cpuFreqDir.path).c_str(), 0700), 0);
+    ASSERT_EQ(mkdir(littlePolicyStats.c_str(), 0700), 0);
+    ASSERT_EQ(mkdir(StringPrintf("%s/policy4", cpuFreqDir.path).c_str(), 0700), 0);
+    ASSERT_EQ(mkdir(bigPolicyStats.c_str(), 0700), 0);
+    ASSERT_TRUE(WriteStringToFile(firstSnapshot, tf.path));
+    ASSERT_TRUE(WriteStringToFile("300000 100\n1000000 50\n", littlePolicyStats + "/time_in_state"));
+    ASSERT_TRUE(WriteStringToFile("500000 10\n2000000 20\n", bigPolicyStats + "/time_in_state"));
+
+    ProcStatCollector collector(tf.path, cpuFreqDir.path);
+    collector.init();
+
+    ASSERT_RESULT_OK(collector.collect());
+
+    ASSERT_TRUE(WriteStringToFile(secondSnapshot, tf.path));
+    ASSERT_TRUE(WriteStringToFile("300000 150\n1000000 55\n", littlePolicyStats + "/time_in_state"));
+    ASSERT_TRUE(WriteStringToFile("500000 10\n2000000 420\n", bigPolicyStats + "/time_in_state"));
+    ASSERT_RESULT_OK(collector.collect());
+
+    const auto& delta = collector.deltaStats();
+    EXPECT_TRUE(delta.onlineCores[0]);
+    EXPECT_TRUE(delta.onlineCores[1]);
+    EXPECT_TRUE(delta.onlineCores[2]);
+    EXPECT_TRUE(delta.onlineCores[3]);
+    EXPECT_FALSE(delta.onlineCores[4]);
+
+    EXPECT_EQ(delta.coreCpuStats[1].userTimeMillis, clockTicksToMillis(4000));
+    EXPECT_EQ(delta.coreCpuStats[1].ioWaitTimeMillis, clockTicksToMillis(49));
+    EXPECT_EQ(delta.coreCpuStats[1].irqTimeMillis, clockTicksToMillis(300));
+    EXPECT_EQ(delta.coreCpuStats[1].softIrqTimeMillis, clockTicksToMillis(500));
+    // Core 2 came online after the first collection so it has no previous sample to diff.
+    EXPECT_EQ(delta.coreCpuStats[2].userTimeMillis, 0);
+    EXPECT_EQ(delta.coreCpuStats[2].totalTimeMillis(), 0);
+    EXPECT_EQ(delta.coreCpuStats[3].idleTimeMillis, clockTicksToMillis(200));
+
+    ASSERT_EQ(delta.cpuFreqPolicyCount, 2);
+    const auto& littlePolicy = delta.cpuFreqPolicyStats[0];
+    EXPECT_EQ(littlePolicy.policyId, 0);
+    ASSERT_EQ(littlePolicy.stateCount, 2);
+    EXPECT_EQ(littlePolicy.residencies[0].freqKHz, 300000u);
+    EXPECT_EQ(littlePolicy.residencies[0].timeMillis, clockTicksToMillis(50));
+    EXPECT_EQ(littlePolicy.residencies[1].freqKHz, 1000000u);
+    EXPECT_EQ(littlePolicy.residencies[1].timeMillis, clockTicksToMillis(5));
+    const auto& bigPolicy = delta.cpuFreqPolicyStats[1];
+    EXPECT_EQ(bigPolicy.policyId, 4);
+    ASSERT_EQ(bigPolicy.stateCount, 2);
+    EXPECT_EQ(bigPolicy.residencies[0].timeMillis, 0);
+    EXPECT_EQ(bigPolicy.residencies[1].freqKHz, 2000000u);
+    EXPECT_EQ(bigPolicy.residencies[1].timeMillis, clockTicksToMillis(400));
+}
+
+TEST(ProcStatCollectorTest, TestZeroCpuFreqResidencyDeltaAfterFailedRead) {
+    constexpr char contents[] =
+            "cpu  6200 5700 1700 3100 1100 5200 3900 0 0 0\n"
+            "cpu0 2400 2900 600 690 340 4300 2100 0 0 0\n"
+            "ctxt 579020168\n"
+            "procs_running 17\n"
+            "procs_blocked 5\n";
+    TemporaryFile tf;
+    ASSERT_NE(tf.fd, -1);
+    ASSERT_TRUE(WriteStringToFile(contents, tf.path));
+    TemporaryDir cpuFreqDir;
+    const std::string policyStats = StringPrintf("%s/policy0/stats", cpuFreqDir.path);
+    ASSERT_EQ(mkdir(StringPrintf("%s/policy0", cpuFreqDir.path).c_str(), 0700), 0);
+    ASSERT_EQ(mkdir(policyStats.c_str(), 0700), 0);
+    ASSERT_TRUE(WriteStringToFile("300000 100\n1000000 50\n", policyStats + "/time_in_state"));
+
+    ProcStatCollector collector(tf.path, cpuFreqDir.path);
+    collector.init();
+
+    // An empty time_in_state file fails the read, so the collection has no residency to diff.
+    ASSERT_TRUE(WriteStringToFile("", policyStats + "/time_in_state"));
+    ASSERT_RESULT_OK(collector.collect());
+    ASSERT_EQ(collector.latestStats().cpuFreqPolicyCount, 0);
+
+    ASSERT_TRUE(WriteStringToFile("300000 150\n1000000 55\n", policyStats + "/time_in_state"));
+    ASSERT_RESULT_OK(collector.collect());
+
+    auto delta = collector.deltaStats();
+    ASSERT_EQ(delta.cpuFreqPolicyCount, 1);
+    ASSERT_EQ(delta.cpuFreqPolicyStats[0].stateCount, 2);
+    EXPECT_EQ(delta.cpuFreqPolicyStats[0].residencies[0].timeMillis, 0)
+            << "Residency without a previous sample must not be reported as the delta";
+    EXPECT_EQ(delta.cpuFreqPolicyStats[0].residencies[1].timeMillis, 0)
+            << "Residency without a previous sample must not be reported as the delta";
+
+    ASSERT_TRUE(WriteStringToFile("300000 170\n1000000 65\n", policyStats + "/time_in_state"));
+    ASSERT_RESULT_OK(collector.collect());
+
+    delta = collector.deltaStats();
+    ASSERT_EQ(delta.cpuFreqPolicyCount, 1);
+    EXPECT_EQ(delta.cpuFreqPolicyStats[0].residencies[0].timeMillis, clockTicksToMillis(20));
+    EXPECT_EQ(delta.cpuFreqPolicyStats[0].residencies[1].timeMillis, clockTicksToMillis(10));
+}
+
+TEST(ProcStatCollectorTest, TestErrorOnCorruptedCoreLine) {
+    constexpr char contents[] =
+            "cpu  6200 5700 1700 3100 1100 5200 3900 0 0 0\n"
+            "cpu0 2400 2900 600 690 340 4300 2100 0 0 0\n"
+            "cpu1 1900 2380 CORRUPTED DATA\n"
+            "ctxt 579020168\n"
+            "procs_running 17\n"
+            "procs_blocked 5\n";
+    TemporaryFile tf;
+    ASSERT_NE(tf.fd, -1);
+    ASSERT_TRUE(WriteStringToFile(contents, tf.path));
+
+    ProcStatCollector collector(tf.path);
+    collector.init();
+
+    ASSERT_TRUE(collector.enabled()) << "Temporary file is inaccessible";
+    EXPECT_FALSE(collector.collect().ok()) << "No error returned for corrupted core line";
+}
+
+TEST(ProcStatCollectorTest, TestErrorOnDuplicateCoreLine) {
+    constexpr char contents[] =
+            "cpu  6200 5700 1700 3100 1100 5200 3900 0 0 0\n"
+            "cpu0 2400 2900 600 690 340 4300 2100 0 0 0\n"
+            "cpu0 1900 2380 510 760 51 370 1500 0 0 0\n"
+            "ctxt 579020168\n"
+            "procs_running 17\n"
+            "procs_blocked 5\n";
+    TemporaryFile tf;
+    ASSERT_NE(tf.fd, -1);
+    ASSERT_TRUE(WriteStringToFile(contents, tf.path));
+
+    ProcStatCollector collector(tf.path);
+    collector.init();
+
+    ASSERT_TRUE(collector.enabled()) << "Temporary file is inaccessible";
+    EXPECT_FALSE(collector.collect().ok()) << "No error returned for duplicate core line";
+}
+
 TEST(ProcStatCollectorTest, TestErrorOnCorruptedStatFile) {
     constexpr char contents[] =
             "cpu  6200 5700 1700 3100 CORRUPTED DATA\n"
@@ -301,6 +485,36 @@ TEST(ProcStatCollectorTest, TestErrorOnUnknownProcsLine) {
     EXPECT_FALSE(collector.collect().ok()) << "No error returned due to unknown procs line";
 }
 
+TEST(ProcStatCollectorTest, TestParse16CoreStatFile) {
+    TemporaryFile tf;
+    ASSERT_NE(tf.fd, -1);
+    ASSERT_TRUE(WriteStringToFile(procStatContentsWithCores(kParseBenchmarkCoreCount), tf.path));
+    TemporaryDir emptyCpuFreqDir;
+
+    ProcStatCollector collector(tf.path, emptyCpuFreqDir.path);
+    collector.init();
+
+    ASSERT_TRUE(collector.enabled()) << "Temporary file is inaccessible";
+
+    const auto start = std::chrono::steady_clock::now();
+    for (int i = 0; i < kParseBenchmarkIterations; ++i) {
+        ASSERT_RESULT_OK(collector.collect());
+    }
+    const auto elapsed = std::chrono::duration_cast<std::chrono::nanoseconds>(
+            std::chrono::steady_clock::now() - start);
+
+    const auto& info = collector.latestStats();
+    ASSERT_EQ(info.onlineCores.count(), static_cast<size_t>(kParseBenchmarkCoreCount));
+    const auto& lastCore = info.coreCpuStats[kParseBenchmarkCoreCount - 1];
+    EXPECT_EQ(lastCore.userTimeMillis, clockTicksToMillis(6000 + kParseBenchmarkCoreCount - 1));
+    EXPECT_EQ(lastCore.softIrqTimeMillis, clockTicksToMillis(240 + kParseBenchmarkCoreCount - 1));
+
+    const int64_t avgNs = elapsed.count() / kParseBenchmarkIterations;
+    LOG(INFO) << "Collected a " << kParseBenchmarkCoreCount << "-core /proc/stat file in " << avgNs
+              << " ns on average over " << kParseBenchmarkIterations << " iterations";
+    RecordProperty("avgCollectNs", std::to_string(avgNs));
+}
+
 TEST(ProcStatCollectorTest, TestProcStatContentsFromDevice) {
     ProcStatCollector collector;
     collector.init();
@@ -0,0 +1,325 @@
+/*
+ * Copyright (c) 2024, The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "ProcPidDir.h"
+#include "ProcessSnapshotter.h"
+
+#include <android-base/file.h>
+#include <android-base/stringprintf.h>
+#include <android-base/unique_fd.h>
+#include <gmock/gmock.h>
+
+#include <fcntl.h>
+#include <sys/stat.h>
+
+#include <chrono>  // NOLINT(build/c++11)
+#include <future>  // NOLINT(build/c++11)
+#include <string>
+#include <thread>  // NOLINT(build/c++11)
+#include <unordered_map>
+#include <vector>
+
+namespace android {
+namespace automotive {
+namespace watchdog {
+
+using ::aidl::android::automotive::watchdog::internal::ProcessIdentifier;
+using ::android::base::unique_fd;
+using ::android::base::StringPrintf;
+using ::android::base::WriteStringToFile;
+using ::testing::AllOf;
+using ::testing::ElementsAre;
+using ::testing::Field;
+using ::testing::HasSubstr;
+using ::testing::IsEmpty;
+using ::testing::Optional;
+
+namespace {
+
+constexpr std::chrono::seconds kTestCaptureTimeout = std::chrono::seconds(5);
+
+ProcessIdentifier toProcessIdentifier(pid_t pid, int64_t startTimeMillis) {
+    ProcessIdentifier processIdentifier;
+    processIdentifier.pid = pid;
+    processIdentifier.startTimeMillis = startTimeMillis;
+    return processIdentifier;
+}
+
+// Makes `<procDirPath>/<pid>/stat` a FIFO, so reading it blocks until a writer opens it.
+std::string makeBlockingStatFile(const char* procDirPath, pid_t pid) {
+    const std::string statPath = StringPrintf("%s/%d/stat", procDirPath, pid);
+    if (mkdir(StringPrintf("%s/%d", procDirPath, pid).c_str(), 0700) != 0 ||
+        mkfifo(statPath.c_str(), 0600) != 0) {
+        return "";
+    }
+    return statPath;
+}
+
+// Opens the FIFO for writing once a reader opened it.
+unique_fd openWhenRead(const std::string& fifoPath, std::chrono::milliseconds timeout) {
+    const auto deadline = std::chrono::steady_clock::now() + timeout;
+    while (std::chrono::steady_clock::now() < deadline) {
+        // Opening a FIFO for writing without blocking fails with ENXIO until it has a reader.
+        if (unique_fd fd(open(fifoPath.c_str(), O_WRONLY | O_NONBLOCK | O_CLOEXEC)); fd.ok()) {
+            return fd;
+        }
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+    return unique_fd();
+}
+
+MATCHER_P4(ThreadSnapshotEq, tid, name, state, wchan, "") {
+    return ExplainMatchResult(AllOf(Field("tid", &ThreadSnapshot::tid, tid),
+                                    Field("name", &ThreadSnapshot::name, name),
+                                    Field("state", &ThreadSnapshot::state, state),
+                                    Field("wchan", &ThreadSnapshot::wchan, wchan)),
+                              arg, result_listener);
+}
+
+}  // namespace
+
+class ProcessSnapshotterTest : public ::testing::Test {
+protected:
+    virtual void SetUp() {
+        const std::unordered_map<pid_t, std::vector<pid_t>> pidToTids = {
+                {1000, {1000, 1001}},
+                {2000, {2000}},
+        };
+        const std::unordered_map<pid_t, std::string> processStat = {
+                {1000, "1000 (system_server) D 1 0 0 0 0 0 0 0 220 0 6 4 0 0 0 0 2 0 19\n"},
+                {2000, "2000 (com.example (app)) S 1 0 0 0 0 0 0 0 1 0 6 4 0 0 0 0 1 0 25\n"},
+        };
+        const std::unordered_map<pid_t, std::string> threadStat = {
+                {1000, "1000 (system_server) D 1 0 0 0 0 0 0 0 200 0 3 2 0 0 0 0 2 0 19\n"},
+                {1001, "1001 (binder:1000_1) S 1 0 0 0 0 0 0 0 20 0 3 2 0 0 0 0 2 0 19\n"},
+                {2000, "2000 (com.example) S 1 0 0 0 0 0 0 0 1 0 6 4 0 0 0 0 1 0 25\n"},
+        };
+        ASSERT_RESULT_OK(testing::populateProcPidDir(mProcDir.path, pidToTids, processStat,
+                                                     /*processStatus=*/{},
+                                                     /*processSmapsRollup=*/{},
+                                                     /*processStatm=*/{}, threadStat,
+                                                     /*threadTimeInState=*/{}));
+        ASSERT_TRUE(WriteStringToFile("io_schedule\n",
+                                      StringPrintf("%s/1000/wchan", mProcDir.path)));
+        ASSERT_TRUE(WriteStringToFile("io_schedule\n",
+                                      StringPrintf("%s/1000/task/1000/wchan", mProcDir.path)));
+        ASSERT_TRUE(WriteStringToFile("binder_wait_for_work\n",
+                                      StringPrintf("%s/1000/task/1001/wchan", mProcDir.path)));
+        ASSERT_TRUE(WriteStringToFile("0", StringPrintf("%s/2000/wchan", mProcDir.path)));
+    }
+
+    TemporaryDir mProcDir;
+};
+
+TEST_F(ProcessSnapshotterTest, TestCaptureSnapshots) {
+    ProcessSnapshotter snapshotter(/*captureNativeStacks=*/false, mProcDir.path);
+
+    snapshotter.captureSnapshots({toProcessIdentifier(1000, 190), toProcessIdentifier(2000, 250),
+                                  toProcessIdentifier(3000, 300)},
+                                 /*detectionTimeMillis=*/5'000);
+
+    ASSERT_TRUE(snapshotter.waitForPendingSnapshots(kTestCaptureTimeout));
+
+    const auto snapshots = snapshotter.getSnapshots();
+
+    ASSERT_EQ(snapshots.size(), 3u);
+    EXPECT_EQ(snapshots[0].pid, 1000);
+    EXPECT_EQ(snapshots[0].startTimeMillis, 190);
+    EXPECT_EQ(snapshots[0].detectionTimeMillis, 5'000);
+    EXPECT_EQ(snapshots[0].comm, "system_server");
+    EXPECT_EQ(snapshots[0].state, 'D');
+    EXPECT_EQ(snapshots[0].wchan, "io_schedule");
+    EXPECT_TRUE(snapshots[0].detectionToCaptureMillis.has_value());
+    EXPECT_THAT(snapshots[0].threads,
+                ElementsAre(ThreadSnapshotEq(1000, "system_server", 'D', "io_schedule"),
+                            ThreadSnapshotEq(1001, "binder:1000_1", 'S', "binder_wait_for_work")));
+    EXPECT_THAT(snapshots[0].error, IsEmpty());
+
+    EXPECT_EQ(snapshots[1].pid, 2000);
+    EXPECT_EQ(snapshots[1].comm, "com.example (app)");
+    EXPECT_EQ(snapshots[1].state, 'S');
+    EXPECT_THAT(snapshots[1].wchan, IsEmpty()) << "Wchan of a running process must be empty";
+    EXPECT_THAT(snapshots[1].threads, ElementsAre(ThreadSnapshotEq(2000, "com.example", 'S', "")));
+
+    EXPECT_EQ(snapshots[2].pid, 3000);
+    EXPECT_THAT(snapshots[2].error, HasSubstr("Failed to read"))
+            << "Must report an error for a process that has already exited";
+}
+
+TEST_F(ProcessSnapshotterTest, TestCaptureSnapshotsKeepsLatestSnapshots) {
+    ProcessSnapshotter snapshotter(/*captureNativeStacks=*/false, mProcDir.path,
+                                   kDefaultMaxPendingSnapshots, /*maxSnapshots=*/2);
+
+    snapshotter.captureSnapshots({toProcessIdentifier(1000, 190), toProcessIdentifier(2000, 250)},
+                                 /*detectionTimeMillis=*/5'000);
+    snapshotter.captureSnapshots({toProcessIdentifier(2000, 250)}, /*detectionTimeMillis=*/9'000);
+
+    ASSERT_TRUE(snapshotter.waitForPendingSnapshots(kTestCaptureTimeout));
+
+    EXPECT_THAT(snapshotter.getSnapshots(),
+                ElementsAre(AllOf(Field(&ProcessSnapshot::pid, 2000),
+                                  Field(&ProcessSnapshot::detectionTimeMillis, 5'000)),
+                            AllOf(Field(&ProcessSnapshot::pid, 2000),
+                                  Field(&ProcessSnapshot::detectionTimeMillis, 9'000))));
+}
+
+TEST_F(ProcessSnapshotterTest, TestOnProcessKilled) {
+    ProcessSnapshotter snapshotter(/*captureNativeStacks=*/false, mProcDir.path);
+
+    snapshotter.captureSnapshots({toProcessIdentifier(1000, 190), toProcessIdentifier(2000, 250)},
+                                 /*detectionTimeMillis=*/5'000);
+
+    // The kill may be reported before the capture is complete.
+    snapshotter.onProcessKilled(toProcessIdentifier(1000, 190), /*killTimeMillis=*/5'750);
+    // A process with a different start time is a different process that reuses the pid.
+    snapshotter.onProcessKilled(toProcessIdentifier(2000, 999), /*killTimeMillis=*/5'800);
+
+    ASSERT_TRUE(snapshotter.waitForPendingSnapshots(kTestCaptureTimeout));
+
+    const auto snapshots = snapshotter.getSnapshots();
+
+    ASSERT_EQ(snapshots.size(), 2u);
+    EXPECT_THAT(snapshots[0].detectionToKillMillis, Optional(750));
+    EXPECT_EQ(snapshots[0].comm, "system_server");
+    EXPECT_FALSE(snapshots[1].detectionToKillMillis.has_value());
+}
+
+TEST_F(ProcessSnapshotterTest, TestCaptureSnapshotsDoesNotWaitForCapture) {
+    // Reading a FIFO blocks until a writer opens it, which stalls the capture of pid 4000.
+    const std::string blockedStatPath = StringPrintf("%s/4000/stat", mProcDir.path);
+    ASSERT_EQ(mkdir(StringPrintf("%s/4000", mProcDir.path).c_str(), 0700), 0);
+    ASSERT_EQ(mkfifo(blockedStatPath.c_str(), 0600), 0);
+    ProcessSnapshotter snapshotter(/*captureNativeStacks=*/false, mProcDir.path,
+                                   /*maxPendingSnapshots=*/2);
+
+    const auto startTime = std::chrono::steady_clock::now();
+    snapshotter.captureSnapshots({toProcessIdentifier(4000, 400), toProcessIdentifier(1000, 190),
+                                  toProcessIdentifier(2000, 250)},
+                                 /*detectionTimeMillis=*/5'000);
+
+    EXPECT_LT(std::chrono::steady_clock::now() - startTime, std::chrono::seconds(1))
+            << "Must not wait for the capture";
+    EXPECT_FALSE(snapshotter.waitForPendingSnapshots(std::chrono::milliseconds(0)));
+
+    {
+        unique_fd writeFd(open(blockedStatPath.c_str(), O_WRONLY | O_CLOEXEC));
+        ASSERT_NE(writeFd.get(), -1);
+        ASSERT_TRUE(android::base::WriteStringToFd("4000 (hung) D 1 0 0 0\n", writeFd.get()));
+    }
+    ASSERT_TRUE(snapshotter.waitForPendingSnapshots(kTestCaptureTimeout));
+
+    const auto snapshots = snapshotter.getSnapshots();
+
+    ASSERT_EQ(snapshots.size(), 3u);
+    EXPECT_EQ(snapshots[0].comm, "hung");
+    EXPECT_EQ(snapshots[1].comm, "system_server");
+    EXPECT_EQ(snapshots[2].pid, 2000);
+    EXPECT_THAT(snapshots[2].error, HasSubstr("Dropped"))
+            << "Must drop processes beyond the pending capture limit";
+}
+
+TEST_F(ProcessSnapshotterTest, TestCaptureSnapshotsInParallelBeforeOnCaptured) {
+    const std::string blockedStatPath1 = makeBlockingStatFile(mProcDir.path, 4000);
+    const std::string blockedStatPath2 = makeBlockingStatFile(mProcDir.path, 5000);
+    ASSERT_FALSE(blockedStatPath1.empty());
+    ASSERT_FALSE(blockedStatPath2.empty());
+    ProcessSnapshotter snapshotter(/*captureNativeStacks=*/false, mProcDir.path,
+                                   kDefaultMaxPendingSnapshots, kDefaultMaxProcessSnapshots,
+                                   /*maxConcurrentSnapshots=*/2, kTestCaptureTimeout);
+    std::promise<std::vector<ProcessSnapshot>> snapshotsOnCaptured;
+
+    snapshotter.captureSnapshots({toProcessIdentifier(4000, 400), toProcessIdentifier(5000, 500)},
+                                 /*detectionTimeMillis=*/5'000, [&]() {
+                                     snapshotsOnCaptured.set_value(snapshotter.getSnapshots());
+                                 });
+
+    // Both processes are being captured at the same time.
+    unique_fd writeFd1 = openWhenRead(blockedStatPath1, kTestCaptureTimeout);
+    unique_fd writeFd2 = openWhenRead(blockedStatPath2, kTestCaptureTimeout);
+    ASSERT_TRUE(writeFd1.ok());
+    ASSERT_TRUE(writeFd2.ok());
+    auto future = snapshotsOnCaptured.get_future();
+    EXPECT_EQ(future.wait_for(std::chrono::milliseconds(0)), std::future_status::timeout)
+            << "Must not call onCaptured before the capture is complete";
+    ASSERT_TRUE(android::base::WriteStringToFd("5000 (hung2) D 1 0 0 0\n", writeFd2.get()));
+    writeFd2.reset();
+    ASSERT_TRUE(android::base::WriteStringToFd("4000 (hung1) D 1 0 0 0\n", writeFd1.get()));
+    writeFd1.reset();
+
+    ASSERT_EQ(future.wait_for(kTestCaptureTimeout), std::future_status::ready);
+
+    EXPECT_THAT(future.get(),
+                ElementsAre(Field(&ProcessSnapshot::comm, "hung1"),
+                            Field(&ProcessSnapshot::comm, "hung2")));
+}
+
+TEST_F(ProcessSnapshotterTest, TestCaptureSnapshotsCallsOnCapturedAtDeadline) {
+    const std::string blockedStatPath = makeBlockingStatFile(mProcDir.path, 4000);
+    ASSERT_FALSE(blockedStatPath.empty());
+    ProcessSnapshotter snapshotter(/*captureNativeStacks=*/false, mProcDir.path,
+                                   kDefaultMaxPendingSnapshots, kDefaultMaxProcessSnapshots,
+                                   /*maxConcurrentSnapshots=*/1,
+                                   /*captureDeadline=*/std::chrono::milliseconds(100));
+    std::promise<void> onCaptured;
+
+    snapshotter.captureSnapshots({toProcessIdentifier(4000, 400), toProcessIdentifier(1000, 190)},
+                                 /*detectionTimeMillis=*/5'000,
+                                 [&]() { onCaptured.set_value(); });
+
+    ASSERT_EQ(onCaptured.get_future().wait_for(kTestCaptureTimeout), std::future_status::ready)
+            << "Must call onCaptured at the deadline while the capture is blocked";
+    {
+        unique_fd writeFd = openWhenRead(blockedStatPath, kTestCaptureTimeout);
+        ASSERT_TRUE(writeFd.ok());
+        ASSERT_TRUE(android::base::WriteStringToFd("4000 (hung) D 1 0 0 0\n", writeFd.get()));
+    }
+    ASSERT_TRUE(snapshotter.waitForPendingSnapshots(kTestCaptureTimeout));
+
+    const auto snapshots = snapshotter.getSnapshots();
+
+    ASSERT_EQ(snapshots.size(), 2u);
+    EXPECT_EQ(snapshots[0].comm, "hung");
+    EXPECT_THAT(snapshots[1].error, HasSubstr("Not captured before the capture deadline"));
+}
+
+TEST_F(ProcessSnapshotterTest, TestCaptureSnapshotsCallsOnCapturedWithoutProcesses) {
+    ProcessSnapshotter snapshotter(/*captureNativeStacks=*/false, mProcDir.path);
+    bool isCalled = false;
+
+    snapshotter.captureSnapshots({}, /*detectionTimeMillis=*/5'000, [&]() { isCalled = true; });
+
+    EXPECT_TRUE(isCalled);
+}
+
+TEST_F(ProcessSnapshotterTest, TestOnDump) {
+    ProcessSnapshotter snapshotter(/*captureNativeStacks=*/false, mProcDir.path);
+    snapshotter.captureSnapshots({toProcessIdentifier(1000, 190)}, /*detectionTimeMillis=*/5'000);
+    snapshotter.onProcessKilled(toProcessIdentifier(1000, 190), /*killTimeMillis=*/6'000);
+    ASSERT_TRUE(snapshotter.waitForPendingSnapshots(kTestCaptureTimeout));
+
+    TemporaryFile dump;
+    snapshotter.onDump(dump.fd);
+
+    std::string contents;
+    ASSERT_TRUE(android::base::ReadFileToString(dump.path, &contents));
+    EXPECT_THAT(contents, HasSubstr("PID: 1000, Start time millis: 190, Comm: system_server"));
+    EXPECT_THAT(contents, HasSubstr("Detection to kill: 1000 ms"));
+    EXPECT_THAT(contents, HasSubstr("TID: 1001, Name: binder:1000_1, State: S"));
+}
+
+}  // namespace watchdog
+}  // namespace automotive
+}  // namespace android
@@ -16,9 +16,14 @@
 
 #include "ThreadPriorityController.h"
 
+#include <android-base/logging.h>
 #include <gmock/gmock.h>
 #include <gtest/gtest.h>
 
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+
 namespace android {
 namespace automotive {
 namespace watchdog {
@@ -28,6 +33,9 @@ using ::aidl::android::automotive::watchdog::internal::ThreadPolicyWithPriority;
 using ::android::base::Result;
 using ::testing::_;
 using ::testing::Return;
+using ::testing::Test;
+
+constexpr int kBenchmarkThreadCount = 100;
 
 MATCHER_P(PriorityEq, priority, "") {
     return (arg->sched_priority) == priority;
@@ -38,6 +46,10 @@ public:
     MockSystemCalls(int tid, int uid, int pid) {
         ON_CALL(*this, readPidStatusFileForPid(tid))
                 .WillByDefault(Return(std::make_tuple(uid, pid)));
+        ON_CALL(*this, readPidStatusFileForPid(pid))
+                .WillByDefault(Return(std::make_tuple(uid, pid)));
+        ON_CALL(*this, readTidsForPid(pid))
+                .WillByDefault(Return(std::unordered_set<pid_t>{pid, tid}));
     }
 
     MOCK_METHOD(int, setScheduler, (pid_t tid, int policy, const sched_param* param), (override));
@@ -45,6 +57,47 @@ public:
     MOCK_METHOD(int, getParam, (pid_t tid, sched_param* param), (override));
     MOCK_METHOD((Result<std::tuple<uid_t, pid_t>>), readPidStatusFileForPid, (pid_t pid),
                 (override));
+    MOCK_METHOD((Result<std::unordered_set<pid_t>>), readTidsForPid, (pid_t pid), (override));
+};
+
+// Keeps |kBenchmarkThreadCount| threads of the current process alive until destroyed.
+class ThreadPool final {
+public:
+    ThreadPool() {
+        std::unique_lock lock(mMutex);
+        for (int i = 0; i < kBenchmarkThreadCount; ++i) {
+            mThreads.emplace_back([this]() {
+                std::unique_lock lock(mMutex);
+                mTids.push_back(gettid());
+                mCondition.notify_all();
+                mCondition.wait(lock, [this]() { return mShouldTerminate; });
+            });
+        }
+        mCondition.wait(lock, [this]() { return mTids.size() == mThreads.size(); });
+    }
+
+    ~ThreadPool() {
+        {
+            std::unique_lock lock(mMutex);
+            mShouldTerminate = true;
+            mCondition.notify_all();
+        }
+        for (auto& thread : mThreads) {
+            thread.join();
+        }
+    }
+
+    std::vector<pid_t> tids() {
+        std::unique_lock lock(mMutex);
+        return mTids;
+    }
+
+private:
+    std::mutex mMutex;
+    std::condition_variable mCondition;
+    std::vector<std::thread> mThreads;
+    std::vector<pid_t> mTids;
+    bool mShouldTerminate = false;
 };
 
 class ThreadPriorityControllerTest : public ::testing::Test {
@@ -89,6 +142,19 @@ TEST_F(ThreadPriorityControllerTest, TestSetThreadPriorityDefaultPolicy) {
     ASSERT_TRUE(result.ok()) << result.error().message();
 }
 
+TEST_F(ThreadPriorityControllerTest, TestSetThreadPriorityIdlePolicy) {
+    int policy = SCHED_IDLE;
+    int setPriority = 1;
+    // Non real-time policies should ignore the provided priority.
+    int expectedPriority = 0;
+    EXPECT_CALL(*mMockSystemCalls, setScheduler(TEST_TID, policy, PriorityEq(expectedPriority)))
+            .WillOnce(Return(0));
+
+    auto result = mController->setThreadPriority(TEST_PID, TEST_TID, TEST_UID, policy, setPriority);
+
+    ASSERT_TRUE(result.ok()) << result.error().message();
+}
+
 TEST_F(ThreadPriorityControllerTest, TestSetThreadPriorityInvalidPid) {
     auto result = mController->setThreadPriority(TEST_PID + 1, TEST_TID, TEST_UID, SCHED_FIFO, 1);
 
@@ -185,6 +251,128 @@ TEST_F(ThreadPriorityControllerTest, TestGetThreadPriorityGetParamFailed) {
     EXPECT_EQ(result.error().code(), EX_SERVICE_SPECIFIC);
 }
 
+TEST_F(ThreadPriorityControllerTest, TestSetThreadPriorities) {
+    constexpr pid_t kSecondTid = TEST_TID + 1;
+    EXPECT_CALL(*mMockSystemCalls, readPidStatusFileForPid(TEST_PID)).Times(1);
+    EXPECT_CALL(*mMockSystemCalls, readTidsForPid(TEST_PID))
+            .WillOnce(Return(std::unordered_set<pid_t>{TEST_PID, TEST_TID, kSecondTid}));
+    EXPECT_CALL(*mMockSystemCalls, readPidStatusFileForPid(TEST_TID)).Times(0);
+    EXPECT_CALL(*mMockSystemCalls, setScheduler(TEST_TID, SCHED_FIFO, PriorityEq(1)))
+            .WillOnce(Return(0));
+    EXPECT_CALL(*mMockSystemCalls, setScheduler(kSecondTid, SCHED_IDLE, PriorityEq(0)))
+            .WillOnce(Return(0));
+
+    auto results = mController->setThreadPriorities(
+            {{.thread = {.pid = TEST_PID, .tid = TEST_TID, .uid = TEST_UID},
+              .policy = SCHED_FIFO,
+              .priority = 1},
+             {.thread = {.pid = TEST_PID, .tid = kSecondTid, .uid = TEST_UID},
+              .policy = SCHED_IDLE,
+              .priority = 1}});
+
+    ASSERT_EQ(results.size(), 2u);
+    EXPECT_TRUE(results[0].ok()) << results[0].error().message();
+    EXPECT_TRUE(results[1].ok()) << results[1].error().message();
+}
+
+TEST_F(ThreadPriorityControllerTest, TestSetThreadPrioritiesReturnsPerRequestResults) {
+    EXPECT_CALL(*mMockSystemCalls, readPidStatusFileForPid(TEST_PID + 5))
+            .WillOnce([](pid_t) -> Result<std::tuple<uid_t, pid_t>> {
+                return android::base::Error() << "Failed to read status file";
+            });
+    EXPECT_CALL(*mMockSystemCalls, readPidStatusFileForPid(TEST_PID)).Times(1);
+    EXPECT_CALL(*mMockSystemCalls, setScheduler(TEST_TID, SCHED_FIFO, PriorityEq(1)))
+            .WillOnce(Return(0));
+
+    auto results = mController->setThreadPriorities(
+            {{.thread = {.pid = TEST_PID + 5, .tid = TEST_TID, .uid = TEST_UID},
+              .policy = SCHED_FIFO,
+              .priority = 1},
+             {.thread = {.pid = TEST_PID, .tid = TEST_TID + 1, .uid = TEST_UID},
+              .policy = SCHED_FIFO,
+              .priority = 1},
+             {.thread = {.pid = TEST_PID, .tid = TEST_TID, .uid = TEST_UID + 1},
+              .policy = SCHED_FIFO,
+              .priority = 1},
+             {.thread = {.pid = TEST_PID, .tid = TEST_TID, .uid = TEST_UID},
+              .policy = -1,
+              .priority = 1},
+             {.thread = {.pid = TEST_PID, .tid = TEST_TID, .uid = TEST_UID},
+              .policy = SCHED_FIFO,
+              .priority = 1}});
+
+    ASSERT_EQ(results.size(), 5u);
+    ASSERT_FALSE(results[0].ok()) << "Invalid process ID must fail";
+    EXPECT_EQ(results[0].error().code(), EX_ILLEGAL_STATE);
+    ASSERT_FALSE(results[1].ok()) << "Invalid thread ID must fail";
+    EXPECT_EQ(results[1].error().code(), EX_ILLEGAL_STATE);
+    ASSERT_FALSE(results[2].ok()) << "Invalid user ID must fail";
+    EXPECT_EQ(results[2].error().code(), EX_ILLEGAL_STATE);
+    ASSERT_FALSE(results[3].ok()) << "Invalid policy must fail";
+    EXPECT_EQ(results[3].error().code(), EX_ILLEGAL_ARGUMENT);
+    EXPECT_TRUE(results[4].ok()) << results[4].error().message();
+}
+
+TEST_F(ThreadPriorityControllerTest, TestGetThreadPriorities) {
+    EXPECT_CALL(*mMockSystemCalls, getScheduler(TEST_TID)).WillOnce(Return(SCHED_FIFO));
+    EXPECT_CALL(*mMockSystemCalls, getParam(TEST_TID, _))
+            .WillOnce([](pid_t, sched_param* param) {
+                param->sched_priority = 10;
+                return 0;
+            });
+
+    auto results = mController->getThreadPriorities(
+            {{.pid = TEST_PID, .tid = TEST_TID, .uid = TEST_UID},
+             {.pid = TEST_PID, .tid = TEST_TID + 1, .uid = TEST_UID}});
+
+    ASSERT_EQ(results.size(), 2u);
+    ASSERT_TRUE(results[0].ok()) << results[0].error().message();
+    EXPECT_EQ(results[0]->policy, SCHED_FIFO);
+    EXPECT_EQ(results[0]->priority, 10);
+    ASSERT_FALSE(results[1].ok()) << "Invalid thread ID must fail";
+    EXPECT_EQ(results[1].error().code(), EX_ILLEGAL_STATE);
+}
+
+TEST(ThreadPriorityControllerBenchmarkTest, TestBatchedVersusSingleCalls) {
+    ThreadPool threadPool;
+    const std::vector<pid_t> tids = threadPool.tids();
+    const int pid = static_cast<int>(getpid());
+    const int uid = static_cast<int>(getuid());
+    ThreadPriorityController controller;
+
+    std::vector<ThreadPriorityRequest> requests;
+    for (const pid_t tid : tids) {
+        // Setting the default policy on threads that already have it doesn't need privileges.
+        requests.push_back({.thread = {.pid = pid, .tid = static_cast<int>(tid), .uid = uid},
+                            .policy = SCHED_OTHER,
+                            .priority = 0});
+    }
+
+    auto start = std::chrono::steady_clock::now();
+    for (const auto& request : requests) {
+        ASSERT_RESULT_OK(controller.setThreadPriority(request.thread.pid, request.thread.tid,
+                                                      request.thread.uid, request.policy,
+                                                      request.priority));
+    }
+    const auto singleElapsed = std::chrono::duration_cast<std::chrono::microseconds>(
+            std::chrono::steady_clock::now() - start);
+
+    start = std::chrono::steady_clock::now();
+    const auto results = controller.setThreadPriorities(requests);
+    const auto batchedElapsed = std::chrono::duration_cast<std::chrono::microseconds>(
+            std::chrono::steady_clock::now() - start);
+
+    ASSERT_EQ(results.size(), requests.size());
+    for (const auto& result : results) {
+        ASSERT_RESULT_OK(result);
+    }
+    LOG(INFO) << "Set the priority of " << kBenchmarkThreadCount << " threads in "
+              << singleElapsed.count() << " us with single calls and " << batchedElapsed.count()
+              << " us with a batched call";
+    RecordProperty("singleCallsUs", std::to_string(singleElapsed.count()));
+    RecordProperty("batchedCallUs", std::to_string(batchedElapsed.count()));
+}
+
 }  // namespace
 }  // namespace watchdog
 }  // namespace automotive
@@ -34,6 +34,9 @@ using ::testing::UnorderedElementsAreArray;
 
 namespace {
 
+// Disables the cgroup v2 backend, so the collector reads the test file.
+constexpr char kInvalidCgroupRootPath[] = "/invalid/cgroup/root";
+
 std::string toString(const std::unordered_map<uid_t, int64_t>& cpuTimeMillisByUid) {
     std::string buffer;
     for (const auto& [uid, cpuTime] : cpuTimeMillisByUid) {
@@ -59,7 +62,7 @@ TEST(UidCpuStatsCollectorTest, TestValidStatFile) {
     ASSERT_NE(tf.fd, -1);
     ASSERT_TRUE(WriteStringToFile(firstSnapshot, tf.path));
 
-    UidCpuStatsCollector collector(tf.path);
+    UidCpuStatsCollector collector(tf.path, kInvalidCgroupRootPath);
     collector.init();
 
     ASSERT_TRUE(collector.enabled()) << "Temporary file is inaccessible";
@@ -94,7 +97,7 @@ TEST(UidCpuStatsCollectorTest, TestErrorOnInvalidStatFile) {
     ASSERT_NE(tf.fd, -1);
     ASSERT_TRUE(WriteStringToFile(contents, tf.path));
 
-    UidCpuStatsCollector collector(tf.path);
+    UidCpuStatsCollector collector(tf.path, kInvalidCgroupRootPath);
     collector.init();
 
     ASSERT_TRUE(collector.enabled()) << "Temporary file is inaccessible";
@@ -105,7 +108,7 @@ TEST(UidCpuStatsCollectorTest, TestErrorOnEmptyStatFile) {
     TemporaryFile tf;
     ASSERT_NE(tf.fd, -1);
 
-    UidCpuStatsCollector collector(tf.path);
+    UidCpuStatsCollector collector(tf.path, kInvalidCgroupRootPath);
     collector.init();
 
     ASSERT_TRUE(collector.enabled()) << "Temporary file is inaccessible";
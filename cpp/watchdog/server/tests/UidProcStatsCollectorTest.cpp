@@ -19,6 +19,7 @@
 #include "UidProcStatsCollectorTestUtils.h"
 
 #include <android-base/file.h>
+#include <android-base/logging.h>
 #include <android-base/stringprintf.h>
 #include <gmock/gmock.h>
 
@@ -26,6 +27,7 @@
 #include <inttypes.h>
 
 #include <algorithm>
+#include <chrono>
 #include <string>
 
 namespace android {
@@ -36,6 +38,9 @@ using ::android::automotive::watchdog::testing::populateProcPidDir;
 using ::android::base::StringAppendF;
 using ::android::base::StringPrintf;
 using ::android::car::feature::car_watchdog_memory_profiling;
+using ::testing::Contains;
+using ::testing::Key;
+using ::testing::UnorderedElementsAre;
 using ::testing::UnorderedPointwise;
 
 namespace {
@@ -1314,6 +1319,156 @@ TEST(UidProcStatsCollectorTest, TestCollectorStatusOnMissingSmapsRollupAndStatmF
             << " and per-process smaps rollup / statm are missing";
 }
 
+TEST(UidProcStatsCollectorTest, TestCollectsOnlyFilteredUids) {
+    std::unordered_map<pid_t, std::vector<pid_t>> pidToTids = {
+            {1, {1}},
+            {1000, {1000, 1100}},
+            {2000, {2000}},
+    };
+
+    std::unordered_map<pid_t, std::string> perProcessStat = {
+            {1, "1 (init) S 0 0 0 0 0 0 0 0 220 0 6 4 0 0 0 0 1 0 19\n"},
+            {1000, "1000 (kitchensink) S 1 0 0 0 0 0 0 0 600 0 80 40 0 0 0 0 2 0 13400\n"},
+            {2000, "2000 (kitchensink) S 1 0 0 0 0 0 0 0 100 0 20 10 0 0 0 0 1 0 14400\n"},
+    };
+
+    // UIDs 10001234 and 1234 share the app ID 1234.
+    std::unordered_map<pid_t, std::string> perProcessStatus = {
+            {1, pidStatusStr(1, 0)},
+            {1000, pidStatusStr(1000, 10001234)},
+            {2000, pidStatusStr(2000, 1234)},
+    };
+
+    std::unordered_map<pid_t, std::string> perProcessSmapsRollup = {
+            {1, smapsRollupStr(/*rssKb=*/1000, /*pssKb=*/865, /*ussKb=*/656, /*swapPssKb=*/200)},
+            {1000,
+             smapsRollupStr(/*rssKb=*/2000, /*pssKb=*/1635, /*ussKb=*/1286, /*swapPssKb=*/600)},
+            {2000,
+             smapsRollupStr(/*rssKb=*/3000, /*pssKb=*/2635, /*ussKb=*/2286, /*swapPssKb=*/600)},
+    };
+
+    std::unordered_map<pid_t, std::string> perThreadStat = {
+            {1, "1 (init) S 0 0 0 0 0 0 0 0 220 0 6 4 0 0 0 0 1 0 19\n"},
+            {1000, "1000 (kitchensink) S 1 0 0 0 0 0 0 0 300 0 40 20 0 0 0 0 2 0 13400\n"},
+            {1100, "1100 (kitchensink) S 1 0 0 0 0 0 0 0 300 0 40 20 0 0 0 0 2 0 13500\n"},
+            {2000, "2000 (kitchensink) S 1 0 0 0 0 0 0 0 100 0 20 10 0 0 0 0 1 0 14400\n"},
+    };
+
+    TemporaryDir procDir;
+    ASSERT_RESULT_OK(populateProcPidDir(procDir.path, pidToTids, perProcessStat, perProcessStatus,
+                                        perProcessSmapsRollup, /*processStatm=*/{}, perThreadStat,
+                                        /*threadTimeInState=*/{}));
+
+    UidProcStatsCollector collector(procDir.path, isSmapsRollupSupported(procDir.path));
+    collector.init();
+
+    ASSERT_TRUE(collector.enabled())
+            << "Files under the path `" << procDir.path << "` are inaccessible";
+    ASSERT_RESULT_OK(collector.collect());
+
+    perProcessStat = {
+            {1, "1 (init) S 0 0 0 0 0 0 0 0 220 0 16 4 0 0 0 0 1 0 19\n"},
+            {1000, "1000 (kitchensink) S 1 0 0 0 0 0 0 0 600 0 100 40 0 0 0 0 2 0 13400\n"},
+            {2000, "2000 (kitchensink) S 1 0 0 0 0 0 0 0 100 0 30 10 0 0 0 0 1 0 14400\n"},
+    };
+    ASSERT_RESULT_OK(populateProcPidDir(procDir.path, pidToTids, perProcessStat, perProcessStatus,
+                                        perProcessSmapsRollup, /*processStatm=*/{}, perThreadStat,
+                                        /*threadTimeInState=*/{}));
+
+    collector.setFilterUids({10001234});
+    ASSERT_RESULT_OK(collector.collect());
+
+    auto actual = collector.deltaStats();
+
+    EXPECT_THAT(actual, UnorderedElementsAre(Key(10001234), Key(1234)))
+            << "Filtered delta stats doesn't match.\nActual:\n"
+            << toString(actual);
+    EXPECT_EQ(actual[10001234].cpuTimeMillis, ticksToMillis(20));
+    EXPECT_EQ(actual[1234].cpuTimeMillis, ticksToMillis(10));
+
+    actual = collector.latestStats();
+
+    ASSERT_THAT(actual, Contains(Key(0))) << "Latest stats of the filtered out UIDs are dropped";
+    EXPECT_EQ(actual[0].cpuTimeMillis, ticksToMillis(10))
+            << "Latest stats of the filtered out UIDs are updated";
+
+    collector.setFilterUids({});
+    ASSERT_RESULT_OK(collector.collect());
+
+    actual = collector.deltaStats();
+
+    EXPECT_THAT(actual, UnorderedElementsAre(Key(0), Key(10001234), Key(1234)))
+            << "Unfiltered delta stats doesn't match.\nActual:\n"
+            << toString(actual);
+    EXPECT_EQ(actual[0].cpuTimeMillis, ticksToMillis(10))
+            << "Delta stats of the previously filtered out UIDs must be relative to their latest "
+               "stats";
+    EXPECT_EQ(actual[10001234].cpuTimeMillis, 0);
+}
+
+TEST(UidProcStatsCollectorTest, TestFilteredCollectionCost) {
+    constexpr int kProcessCount = 300;
+    constexpr int kThreadsPerProcess = 10;
+    constexpr int kIterations = 10;
+    constexpr uid_t kFilteredUid = 10000;
+
+    std::unordered_map<pid_t, std::vector<pid_t>> pidToTids;
+    std::unordered_map<pid_t, std::string> perProcessStat;
+    std::unordered_map<pid_t, std::string> perProcessStatus;
+    std::unordered_map<pid_t, std::string> perProcessStatm;
+    std::unordered_map<pid_t, std::string> perThreadStat;
+    for (pid_t pid = 1; pid <= kProcessCount; ++pid) {
+        const std::string stat =
+                StringPrintf("%d (proc) S 0 0 0 0 0 0 0 0 220 0 6 4 0 0 0 0 1 0 19\n", pid);
+        perProcessStat[pid] = stat;
+        // Only one process belongs to the filtered UID.
+        perProcessStatus[pid] = pidStatusStr(pid, pid == 1 ? kFilteredUid : kFilteredUid + pid);
+        perProcessStatm[pid] = "2969783 1481 938 530 0 5067 0";
+        for (int i = 0; i < kThreadsPerProcess; ++i) {
+            const pid_t tid = i == 0 ? pid : kProcessCount * i + pid;
+            pidToTids[pid].push_back(tid);
+            perThreadStat[tid] =
+                    StringPrintf("%d (proc) S 0 0 0 0 0 0 0 0 220 0 6 4 0 0 0 0 1 0 19\n", tid);
+        }
+    }
+
+    TemporaryDir procDir;
+    ASSERT_RESULT_OK(populateProcPidDir(procDir.path, pidToTids, perProcessStat, perProcessStatus,
+                                        /*processSmapsRollup=*/{}, perProcessStatm, perThreadStat,
+                                        /*threadTimeInState=*/{}));
+
+    UidProcStatsCollector collector(procDir.path, /*isSmapsRollupSupported=*/false);
+    collector.init();
+    ASSERT_TRUE(collector.enabled())
+            << "Files under the path `" << procDir.path << "` are inaccessible";
+
+    auto start = std::chrono::steady_clock::now();
+    for (int i = 0; i < kIterations; ++i) {
+        ASSERT_RESULT_OK(collector.collect());
+    }
+    const auto fullElapsed = std::chrono::duration_cast<std::chrono::nanoseconds>(
+            std::chrono::steady_clock::now() - start);
+
+    ASSERT_EQ(collector.deltaStats().size(), static_cast<size_t>(kProcessCount));
+
+    collector.setFilterUids({kFilteredUid});
+    start = std::chrono::steady_clock::now();
+    for (int i = 0; i < kIterations; ++i) {
+        ASSERT_RESULT_OK(collector.collect());
+    }
+    const auto filteredElapsed = std::chrono::duration_cast<std::chrono::nanoseconds>(
+            std::chrono::steady_clock::now() - start);
+
+    EXPECT_THAT(collector.deltaStats(), UnorderedElementsAre(Key(kFilteredUid)));
+    LOG(INFO) << "Collected " << kProcessCount << " processes with " << kThreadsPerProcess
+              << " threads each in " << fullElapsed.count() / kIterations
+              << " ns without a filter and in " << filteredElapsed.count() / kIterations
+              << " ns with a single UID filter";
+    RecordProperty("unfilteredCollectionAvgNs", std::to_string(fullElapsed.count() / kIterations));
+    RecordProperty("filteredCollectionAvgNs",
+                   std::to_string(filteredElapsed.count() / kIterations));
+}
+
 TEST(UidProcStatsCollectorTest, TestUidProcStatsCollectorContentsFromDevice) {
     UidProcStatsCollector collector;
     collector.init();
@@ -42,6 +42,7 @@ using ::android::base::Error;
 using ::android::base::Result;
 using ::android::base::StringAppendF;
 using ::android::base::StringPrintf;
+using ::testing::_;
 using ::testing::AllOf;
 using ::testing::Eq;
 using ::testing::ExplainMatchResult;
@@ -284,6 +285,35 @@ TEST_F(UidStatsCollectorTest, TestCollectLatestStats) {
     EXPECT_THAT(actual, IsEmpty()) << "Delta UID stats isn't empty.\nActual: " << toString(actual);
 }
 
+TEST_F(UidStatsCollectorTest, TestCollectPushesDownFilterPackages) {
+    EXPECT_CALL(*mMockPackageInfoResolver, getPackageInfosForUids(_))
+            .WillRepeatedly(Return(samplePackageInfoByUid()));
+    EXPECT_CALL(*mMockUidIoStatsCollector, latestStats())
+            .WillRepeatedly(Return(sampleUidIoStatsByUid()));
+    EXPECT_CALL(*mMockUidProcStatsCollector, latestStats())
+            .WillRepeatedly(Return(sampleUidProcStatsByUid()));
+    EXPECT_CALL(*mMockUidCpuStatsCollector, latestStats())
+            .WillRepeatedly(Return(sampleUidCpuStatsByUid()));
+
+    mUidStatsCollector->setFilterPackages({"kitchensink.app"});
+
+    // The package's UID is unknown before the first collection, so all processes are collected.
+    EXPECT_CALL(*mMockUidProcStatsCollector, setFilterUids(IsEmpty())).Times(1);
+
+    ASSERT_RESULT_OK(mUidStatsCollector->collect());
+
+    EXPECT_CALL(*mMockUidProcStatsCollector, setFilterUids(UnorderedElementsAre(1005678)))
+            .Times(1);
+
+    ASSERT_RESULT_OK(mUidStatsCollector->collect());
+
+    mUidStatsCollector->setFilterPackages({});
+
+    EXPECT_CALL(*mMockUidProcStatsCollector, setFilterUids(IsEmpty())).Times(1);
+
+    ASSERT_RESULT_OK(mUidStatsCollector->collect());
+}
+
 TEST_F(UidStatsCollectorTest, TestCollectDeltaStats) {
     const std::unordered_map<uid_t, PackageInfo> packageInfoByUid = samplePackageInfoByUid();
     const std::unordered_map<uid_t, UidIoStats> uidIoStatsByUid = sampleUidIoStatsByUid();
@@ -15,6 +15,8 @@
  */
 
 #include "MockIoOveruseMonitor.h"
+#include "MockPackageInfoResolver.h"
+#include "MockThreadPriorityController.h"
 #include "MockWatchdogPerfService.h"
 #include "MockWatchdogProcessService.h"
 #include "MockWatchdogServiceHelper.h"
@@ -24,10 +26,15 @@
 #include "WatchdogServiceHelper.h"
 
 #include <aidl/android/automotive/watchdog/internal/BootPhase.h>
+#include <aidl/android/automotive/watchdog/internal/BpCarWatchdog.h>
 #include <aidl/android/automotive/watchdog/internal/GarageMode.h>
 #include <aidl/android/automotive/watchdog/internal/PowerCycle.h>
+#include <aidl/android/automotive/watchdog/internal/ThreadId.h>
+#include <aidl/android/automotive/watchdog/internal/ThreadPolicyResult.h>
+#include <aidl/android/automotive/watchdog/internal/ThreadPolicyUpdate.h>
 #include <aidl/android/automotive/watchdog/internal/UserPackageIoUsageStats.h>
 #include <aidl/android/automotive/watchdog/internal/UserState.h>
+#include <android-base/logging.h>
 #include <android-base/result.h>
 #include <binder/IPCThreadState.h>
 #include <gmock/gmock.h>
@@ -39,11 +46,14 @@
 #include <sched.h>
 #include <unistd.h>
 
+#include <chrono>
+
 namespace android {
 namespace automotive {
 namespace watchdog {
 
 using ::aidl::android::automotive::watchdog::internal::BootPhase;
+using ::aidl::android::automotive::watchdog::internal::BpCarWatchdog;
 using ::aidl::android::automotive::watchdog::internal::GarageMode;
 using ::aidl::android::automotive::watchdog::internal::ICarWatchdogMonitor;
 using ::aidl::android::automotive::watchdog::internal::ICarWatchdogMonitorDefault;
@@ -53,11 +63,15 @@ using ::aidl::android::automotive::watchdog::internal::PowerCycle;
 using ::aidl::android::automotive::watchdog::internal::ProcessIdentifier;
 using ::aidl::android::automotive::watchdog::internal::ResourceOveruseConfiguration;
 using ::aidl::android::automotive::watchdog::internal::StateType;
+using ::aidl::android::automotive::watchdog::internal::ThreadId;
+using ::aidl::android::automotive::watchdog::internal::ThreadPolicyResult;
+using ::aidl::android::automotive::watchdog::internal::ThreadPolicyUpdate;
 using ::aidl::android::automotive::watchdog::internal::ThreadPolicyWithPriority;
 using ::aidl::android::automotive::watchdog::internal::UserPackageIoUsageStats;
 using ::aidl::android::automotive::watchdog::internal::UserState;
 using ::android::sp;
 using ::android::String16;
+using ::android::base::Error;
 using ::android::base::Result;
 using ::ndk::ScopedAStatus;
 using ::ndk::SharedRefBase;
@@ -65,6 +79,7 @@ using ::ndk::SpAIBinder;
 using ::testing::_;
 using ::testing::ByMove;
 using ::testing::DoAll;
+using ::testing::ElementsAre;
 using ::testing::Eq;
 using ::testing::Pointer;
 using ::testing::Return;
@@ -76,6 +91,7 @@ constexpr const char kFailOnNonSystemCallingUidMessage[] =
         "should fail with non-system calling uid";
 constexpr const char kFailOnWatchdogServiceHelperErrMessage[] =
         "should fail on watchdog service helper error";
+constexpr int kBenchmarkCallCount = 100;
 
 class ScopedChangeCallingUid final : public RefBase {
 public:
@@ -107,13 +123,13 @@ MATCHER_P(PriorityEq, priority, "") {
     return (arg->sched_priority) == priority;
 }
 
-class MockThreadPriorityController : public ThreadPriorityControllerInterface {
-public:
-    MOCK_METHOD(Result<void>, setThreadPriority,
-                (int pid, int tid, int uid, int policy, int priority), (override));
-    MOCK_METHOD(Result<void>, getThreadPriority,
-                (int pid, int tid, int uid, ThreadPolicyWithPriority* result), (override));
-};
+MATCHER_P3(ThreadIdentifierEq, pid, tid, uid, "") {
+    return arg.pid == pid && arg.tid == tid && arg.uid == uid;
+}
+
+MATCHER_P3(ThreadPriorityRequestEq, tid, policy, priority, "") {
+    return arg.thread.tid == tid && arg.policy == policy && arg.priority == priority;
+}
 
 }  // namespace
 
@@ -128,6 +144,10 @@ public:
         mHandler->setThreadPriorityController(std::move(controller));
     }
 
+    void setPackageInfoResolver(const sp<PackageInfoResolverInterface>& resolver) {
+        mHandler->setPackageInfoResolver(resolver);
+    }
+
 private:
     WatchdogInternalHandler* mHandler;
 };
@@ -151,12 +171,15 @@ protected:
                 std::make_unique<MockThreadPriorityController>();
         mThreadPriorityController = threadPriorityController.get();
         peer.setThreadPriorityController(std::move(threadPriorityController));
+        mMockPackageInfoResolver = sp<MockPackageInfoResolver>::make();
+        peer.setPackageInfoResolver(mMockPackageInfoResolver);
     }
     virtual void TearDown() {
         mMockWatchdogServiceHelper.clear();
         mMockWatchdogProcessService.clear();
         mMockWatchdogPerfService.clear();
         mMockIoOveruseMonitor.clear();
+        mMockPackageInfoResolver.clear();
         mWatchdogInternalHandler.reset();
         mScopedChangeCallingUid.clear();
     }
@@ -170,6 +193,7 @@ protected:
     sp<MockWatchdogProcessService> mMockWatchdogProcessService;
     sp<MockWatchdogPerfService> mMockWatchdogPerfService;
     sp<MockIoOveruseMonitor> mMockIoOveruseMonitor;
+    sp<MockPackageInfoResolver> mMockPackageInfoResolver;
     std::shared_ptr<WatchdogInternalHandler> mWatchdogInternalHandler;
     sp<ScopedChangeCallingUid> mScopedChangeCallingUid;
     MockThreadPriorityController* mThreadPriorityController;
@@ -200,6 +224,7 @@ TEST_F(WatchdogInternalHandlerTest, TestRegisterCarWatchdogService) {
     EXPECT_CALL(*mMockWatchdogPerfService, registerDataProcessor(Eq(mMockIoOveruseMonitor)))
             .WillOnce(Return(Result<void>()));
     EXPECT_CALL(*mMockWatchdogPerfService, onCarWatchdogServiceRegistered()).Times(1);
+    EXPECT_CALL(*mMockPackageInfoResolver, asyncPrefetchPackageInfos()).Times(1);
 
     std::shared_ptr<ICarWatchdogServiceForSystem> service =
             SharedRefBase::make<ICarWatchdogServiceForSystemDefault>();
@@ -229,6 +254,7 @@ TEST_F(WatchdogInternalHandlerTest,
     EXPECT_CALL(*mMockWatchdogServiceHelper, registerService(service))
             .WillOnce(Return(ByMove(ScopedAStatus::fromExceptionCodeWithMessage(EX_ILLEGAL_STATE,
                                                                                 "Illegal state"))));
+    EXPECT_CALL(*mMockPackageInfoResolver, asyncPrefetchPackageInfos()).Times(0);
 
     ASSERT_FALSE(mWatchdogInternalHandler->registerCarWatchdogService(service).isOk())
             << "registerCarWatchdogService " << kFailOnWatchdogServiceHelperErrMessage;
@@ -716,6 +742,119 @@ TEST_F(WatchdogInternalHandlerTest, TestGetThreadPriority) {
     EXPECT_EQ(actual.priority, expectedPriority);
 }
 
+TEST_F(WatchdogInternalHandlerTest, TestSetThreadPriorities) {
+    setSystemCallingUid();
+    std::vector<ThreadPolicyUpdate> updates = {
+            {.thread = {.pid = 1, .tid = 2, .uid = 3},
+             .policyWithPriority = {.policy = SCHED_FIFO, .priority = 1}},
+            {.thread = {.pid = 1, .tid = 4, .uid = 3},
+             .policyWithPriority = {.policy = SCHED_OTHER, .priority = 0}},
+    };
+    EXPECT_CALL(*mThreadPriorityController,
+                setThreadPriorities(ElementsAre(ThreadPriorityRequestEq(2, SCHED_FIFO, 1),
+                                                ThreadPriorityRequestEq(4, SCHED_OTHER, 0))))
+            .WillOnce([](const std::vector<ThreadPriorityRequest>&) {
+                std::vector<Result<void>> results;
+                results.push_back({});
+                results.push_back(Error(EX_ILLEGAL_STATE) << "Invalid thread ID: 4");
+                return results;
+            });
+
+    std::vector<ThreadPolicyResult> actual;
+    auto status = mWatchdogInternalHandler->setThreadPriorities(updates, &actual);
+
+    ASSERT_TRUE(status.isOk()) << status.getMessage();
+    ASSERT_EQ(actual.size(), 2u);
+    EXPECT_EQ(actual[0].exceptionCode, EX_NONE);
+    EXPECT_EQ(actual[1].exceptionCode, EX_ILLEGAL_STATE);
+    EXPECT_EQ(actual[1].errorMessage, "Invalid thread ID: 4");
+}
+
+TEST_F(WatchdogInternalHandlerTest, TestErrorOnSetThreadPrioritiesWithNonSystemCallingUid) {
+    EXPECT_CALL(*mThreadPriorityController, setThreadPriorities(_)).Times(0);
+
+    std::vector<ThreadPolicyResult> actual;
+    ASSERT_FALSE(mWatchdogInternalHandler->setThreadPriorities({}, &actual).isOk())
+            << "setThreadPriorities " << kFailOnNonSystemCallingUidMessage;
+}
+
+TEST_F(WatchdogInternalHandlerTest, TestGetThreadPriorities) {
+    setSystemCallingUid();
+    std::vector<ThreadId> threads = {{.pid = 1, .tid = 2, .uid = 3},
+                                     {.pid = 1, .tid = 4, .uid = 3}};
+    EXPECT_CALL(*mThreadPriorityController,
+                getThreadPriorities(
+                        ElementsAre(ThreadIdentifierEq(1, 2, 3), ThreadIdentifierEq(1, 4, 3))))
+            .WillOnce([](const std::vector<ThreadIdentifier>&) {
+                std::vector<Result<ThreadPolicyWithPriority>> results;
+                results.push_back(ThreadPolicyWithPriority{.policy = SCHED_FIFO, .priority = 1});
+                results.push_back(Error(EX_SERVICE_SPECIFIC) << "Failed to get scheduler");
+                return results;
+            });
+
+    std::vector<ThreadPolicyResult> actual;
+    auto status = mWatchdogInternalHandler->getThreadPriorities(threads, &actual);
+
+    ASSERT_TRUE(status.isOk()) << status.getMessage();
+    ASSERT_EQ(actual.size(), 2u);
+    EXPECT_EQ(actual[0].exceptionCode, EX_NONE);
+    EXPECT_EQ(actual[0].policyWithPriority.policy, SCHED_FIFO);
+    EXPECT_EQ(actual[0].policyWithPriority.priority, 1);
+    EXPECT_EQ(actual[1].exceptionCode, EX_SERVICE_SPECIFIC);
+    EXPECT_EQ(actual[1].errorMessage, "Failed to get scheduler");
+}
+
+TEST_F(WatchdogInternalHandlerTest, TestErrorOnGetThreadPrioritiesWithNonSystemCallingUid) {
+    EXPECT_CALL(*mThreadPriorityController, getThreadPriorities(_)).Times(0);
+
+    std::vector<ThreadPolicyResult> actual;
+    ASSERT_FALSE(mWatchdogInternalHandler->getThreadPriorities({}, &actual).isOk())
+            << "getThreadPriorities " << kFailOnNonSystemCallingUidMessage;
+}
+
+TEST_F(WatchdogInternalHandlerTest, TestBenchmarkBatchedVersusSingleSetCallsOverBinder) {
+    setSystemCallingUid();
+    internal::WatchdogInternalHandlerPeer peer(mWatchdogInternalHandler.get());
+    peer.setThreadPriorityController(std::make_unique<ThreadPriorityController>());
+    // The proxy marshals every call into a parcel and dispatches it through the binder's
+    // transact path, as the car watchdog service's calls are.
+    auto proxy = SharedRefBase::make<BpCarWatchdog>(mWatchdogInternalHandler->asBinder());
+    const int pid = static_cast<int>(getpid());
+    const int tid = static_cast<int>(gettid());
+    const int uid = static_cast<int>(getuid());
+    // Setting the default policy on a thread that already has it doesn't need privileges.
+    std::vector<ThreadPolicyUpdate> updates(kBenchmarkCallCount,
+                                            {.thread = {.pid = pid, .tid = tid, .uid = uid},
+                                             .policyWithPriority = {.policy = SCHED_OTHER,
+                                                                    .priority = 0}});
+
+    auto start = std::chrono::steady_clock::now();
+    for (const auto& update : updates) {
+        auto status = proxy->setThreadPriority(pid, tid, uid, update.policyWithPriority.policy,
+                                               update.policyWithPriority.priority);
+        ASSERT_TRUE(status.isOk()) << status.getMessage();
+    }
+    const auto singleElapsed = std::chrono::duration_cast<std::chrono::microseconds>(
+            std::chrono::steady_clock::now() - start);
+
+    std::vector<ThreadPolicyResult> results;
+    start = std::chrono::steady_clock::now();
+    auto status = proxy->setThreadPriorities(updates, &results);
+    const auto batchedElapsed = std::chrono::duration_cast<std::chrono::microseconds>(
+            std::chrono::steady_clock::now() - start);
+
+    ASSERT_TRUE(status.isOk()) << status.getMessage();
+    ASSERT_EQ(results.size(), updates.size());
+    for (const auto& result : results) {
+        ASSERT_EQ(result.exceptionCode, EX_NONE) << result.errorMessage;
+    }
+    LOG(INFO) << "Set the priority " << kBenchmarkCallCount << " times over binder in "
+              << singleElapsed.count() << " us with single calls and " << batchedElapsed.count()
+              << " us with a batched call";
+    RecordProperty("singleCallsOverBinderUs", std::to_string(singleElapsed.count()));
+    RecordProperty("batchedCallOverBinderUs", std::to_string(batchedElapsed.count()));
+}
+
 TEST_F(WatchdogInternalHandlerTest, TestOnAidlVhalPidFetched) {
     setSystemCallingUid();
 
@@ -38,9 +38,11 @@
 #include <gmock/gmock.h>
 #include <utils/RefBase.h>
 
+#include <atomic>
 #include <future>  // NOLINT(build/c++11)
 #include <queue>
 #include <string>
+#include <thread>  // NOLINT(build/c++11)
 #include <vector>
 
 namespace android {
@@ -81,6 +83,8 @@ constexpr std::chrono::seconds kTestCustomCollectionDurationSecs = 11s;
 constexpr std::chrono::seconds kTestPeriodicMonitorIntervalSecs = 2s;
 constexpr std::chrono::seconds kTestUserSwitchTimeoutSecs = 15s;
 constexpr std::chrono::seconds kTestWakeUpDurationSecs = 20s;
+constexpr std::chrono::seconds kTestMinPeriodicMonitorIntervalSecs = 1s;
+constexpr std::chrono::milliseconds kTestSlowCollectionDurationMs = 3500ms;
 
 std::string toString(const std::vector<ResourceStats>& resourceStats) {
     std::string buffer;
@@ -131,11 +135,15 @@ public:
     void init(const sp<LooperWrapper>& looper,
               const sp<UidStatsCollectorInterface>& uidStatsCollector,
               const sp<ProcStatCollectorInterface>& procStatCollector,
-              const sp<ProcDiskStatsCollectorInterface>& procDiskStatsCollector) {
+              const sp<ProcDiskStatsCollectorInterface>& procDiskStatsCollector,
+              const sp<LooperWrapper>& monitorLooper = nullptr) {
         Mutex::Autolock lock(mService->mMutex);
         mService->mHandlerLooper = looper;
         mService->mUidStatsCollector = uidStatsCollector;
         mService->mProcStatCollector = procStatCollector;
+        Mutex::Autolock monitorLock(mService->mMonitorMutex);
+        // Share the collection looper unless the test runs the monitor on its own thread.
+        mService->mMonitorLooper = monitorLooper == nullptr ? looper : monitorLooper;
         mService->mProcDiskStatsCollector = procDiskStatsCollector;
     }
 
@@ -145,9 +153,14 @@ public:
         mService->mBoottimeCollection.pollingIntervalNs = kTestSystemEventCollectionIntervalSecs;
         mService->mPeriodicCollection.pollingIntervalNs = kTestPeriodicCollectionIntervalSecs;
         mService->mUserSwitchCollection.pollingIntervalNs = kTestSystemEventCollectionIntervalSecs;
-        mService->mPeriodicMonitor.pollingIntervalNs = kTestPeriodicMonitorIntervalSecs;
         mService->mUserSwitchTimeoutNs = kTestUserSwitchTimeoutSecs;
         mService->mWakeUpDurationNs = kTestWakeUpDurationSecs;
+        setPeriodicMonitorInterval(kTestPeriodicMonitorIntervalSecs);
+    }
+
+    void setPeriodicMonitorInterval(std::chrono::nanoseconds interval) {
+        Mutex::Autolock lock(mService->mMonitorMutex);
+        mService->mPeriodicMonitor.pollingIntervalNs = interval;
     }
 
     void clearPostSystemEventDuration() {
@@ -227,9 +240,9 @@ protected:
         mMockProcStatCollector.clear();
     }
 
-    void startService() {
+    void startService(const sp<LooperWrapper>& monitorLooper = nullptr) {
         mServicePeer->init(mLooperStub, mMockUidStatsCollector, mMockProcStatCollector,
-                           mMockProcDiskStatsCollector);
+                           mMockProcDiskStatsCollector, monitorLooper);
 
         EXPECT_CALL(*mMockDataProcessor, init()).Times(1);
         EXPECT_CALL(*mMockDataProcessor, onSystemStartup()).Times(1);
@@ -751,6 +764,81 @@ TEST_F(WatchdogPerfServiceTest, TestBoottimeCollectionWithNoPostSystemEventDurat
     ASSERT_NO_FATAL_FAILURE(verifyAndClearExpectations());
 }
 
+TEST_F(WatchdogPerfServiceTest, TestMergesResourceUsageStatsPerUid) {
+    ASSERT_NO_FATAL_FAILURE(startService());
+    sp<NiceMock<MockDataProcessor>> secondDataProcessor = sp<NiceMock<MockDataProcessor>>::make();
+    ASSERT_RESULT_OK(mService->registerDataProcessor(secondDataProcessor));
+    ASSERT_NO_FATAL_FAILURE(startPeriodicCollection());
+    ASSERT_NO_FATAL_FAILURE(skipPeriodicMonitorEvents());
+
+    UidResourceUsageStats ioOnlyUidStats;
+    ioOnlyUidStats.packageIdentifier.uid = 1001000;
+    ioOnlyUidStats.packageIdentifier.name = "system.package";
+    ioOnlyUidStats.uidUptimeMillis = 1'000;
+    ioOnlyUidStats.ioUsageStats.readBytes.foregroundBytes = 4'096;
+    UidResourceUsageStats cpuOnlyUidStats;
+    cpuOnlyUidStats.packageIdentifier = ioOnlyUidStats.packageIdentifier;
+    cpuOnlyUidStats.uidUptimeMillis = 2'000;
+    cpuOnlyUidStats.cpuUsageStats.cpuTimeMillis = 500;
+    cpuOnlyUidStats.cpuUsageStats.cpuCycles = 1'000;
+    cpuOnlyUidStats.processCpuUsageStats.push_back(
+            {.pid = 100, .name = "system.process", .cpuTimeMillis = 500, .cpuCycles = 1'000});
+    UidResourceUsageStats otherUidStats;
+    otherUidStats.packageIdentifier.uid = 1010000;
+    otherUidStats.packageIdentifier.name = "third_party.package";
+    otherUidStats.cpuUsageStats.cpuTimeMillis = 100;
+
+    UidResourceUsageStats expectedMergedUidStats = cpuOnlyUidStats;
+    expectedMergedUidStats.ioUsageStats = ioOnlyUidStats.ioUsageStats;
+    const std::vector<UidResourceUsageStats> expectedUidStats = {expectedMergedUidStats,
+                                                                 otherUidStats};
+
+    EXPECT_CALL(*mMockUidStatsCollector, collect()).Times(1);
+    EXPECT_CALL(*mMockProcStatCollector, collect()).Times(1);
+    EXPECT_CALL(*mMockDataProcessor,
+                onPeriodicCollection(_, SystemState::NORMAL_MODE, Eq(mMockUidStatsCollector),
+                                     Eq(mMockProcStatCollector), _))
+            .WillOnce([&](auto, auto, auto, auto, auto* resourceStats) -> Result<void> {
+                resourceStats->resourceUsageStats = std::make_optional<ResourceUsageStats>(
+                        constructResourceUsageStats(/*startTimeEpochMillis=*/0,
+                                                    kTestPeriodicCollectionIntervalSecs,
+                                                    /*systemSummaryUsageStats=*/{},
+                                                    {ioOnlyUidStats}));
+                return {};
+            });
+    EXPECT_CALL(*secondDataProcessor,
+                onPeriodicCollection(_, SystemState::NORMAL_MODE, Eq(mMockUidStatsCollector),
+                                     Eq(mMockProcStatCollector), _))
+            .WillOnce([&](auto, auto, auto, auto, auto* resourceStats) -> Result<void> {
+                resourceStats->resourceUsageStats = std::make_optional<ResourceUsageStats>(
+                        constructResourceUsageStats(/*startTimeEpochMillis=*/0,
+                                                    kTestPeriodicCollectionIntervalSecs,
+                                                    /*systemSummaryUsageStats=*/{},
+                                                    {cpuOnlyUidStats, otherUidStats}));
+                return {};
+            });
+    std::vector<ResourceStats> actualResourceStats;
+    EXPECT_CALL(*mMockWatchdogServiceHelper, isServiceConnected()).WillOnce(Return(true));
+    EXPECT_CALL(*mMockWatchdogServiceHelper, onLatestResourceStats(_))
+            .WillOnce([&](auto& resourceStats) -> ndk::ScopedAStatus {
+                actualResourceStats = resourceStats;
+                return ndk::ScopedAStatus::ok();
+            });
+
+    ASSERT_RESULT_OK(mLooperStub->pollCache());
+
+    // Handle the SEND_RESOURCE_STATS message
+    ASSERT_RESULT_OK(mLooperStub->pollCache());
+
+    ASSERT_EQ(actualResourceStats.size(), 1u);
+    ASSERT_TRUE(actualResourceStats[0].resourceUsageStats.has_value());
+    EXPECT_EQ(actualResourceStats[0].resourceUsageStats->uidResourceUsageStats, expectedUidStats)
+            << "Per-UID stats of the same UID must be merged across data processors";
+
+    ASSERT_NO_FATAL_FAILURE(verifyAndClearExpectations());
+    Mock::VerifyAndClearExpectations(secondDataProcessor.get());
+}
+
 TEST_F(WatchdogPerfServiceTest, TestCustomCollection) {
     ASSERT_NO_FATAL_FAILURE(startService());
 
@@ -772,6 +860,10 @@ TEST_F(WatchdogPerfServiceTest, TestCustomCollection) {
     int maxIterations = static_cast<int>(kTestCustomCollectionDurationSecs.count() /
                                          kTestCustomCollectionIntervalSecs.count());
     for (int i = 0; i <= maxIterations; ++i) {
+        EXPECT_CALL(*mMockUidStatsCollector,
+                    setFilterPackages(UnorderedElementsAreArray(
+                            {"android.car.cts", "system_server"})))
+                .Times(1);
         EXPECT_CALL(*mMockUidStatsCollector, collect()).Times(1);
         EXPECT_CALL(*mMockProcStatCollector, collect()).Times(1);
         EXPECT_CALL(*mMockDataProcessor,
@@ -1494,6 +1586,86 @@ TEST_F(WatchdogPerfServiceTest, TestPeriodicMonitorRequestsCollection) {
     EXPECT_CALL(*mMockDataProcessor, terminate()).Times(1);
 }
 
+TEST_F(WatchdogPerfServiceTest, TestPeriodicMonitorRunsDuringSlowCollection) {
+    // The monitor runs on its own thread with a real looper while the collection uses the stub.
+    ASSERT_NO_FATAL_FAILURE(startService(sp<LooperWrapper>::make()));
+
+    mServicePeer->setPeriodicMonitorInterval(kTestMinPeriodicMonitorIntervalSecs);
+
+    ASSERT_NO_FATAL_FAILURE(startPeriodicCollection());
+
+    // Set all the expectations before the first monitor event because the monitor thread calls the
+    // mocks concurrently from here on.
+    std::atomic<int> monitorCount = 0;
+    EXPECT_CALL(*mMockDataProcessor, onPeriodicMonitor(_, Eq(mMockProcDiskStatsCollector), _))
+            .WillRepeatedly([&](auto, auto, auto) -> Result<void> {
+                ++monitorCount;
+                return {};
+            });
+    EXPECT_CALL(*mMockUidStatsCollector, collect()).WillOnce([]() -> Result<void> {
+        std::this_thread::sleep_for(kTestSlowCollectionDurationMs);
+        return {};
+    });
+    EXPECT_CALL(*mMockProcStatCollector, collect()).Times(1);
+    EXPECT_CALL(*mMockDataProcessor,
+                onPeriodicCollection(_, SystemState::NORMAL_MODE, Eq(mMockUidStatsCollector),
+                                     Eq(mMockProcStatCollector), _))
+            .Times(1);
+    EXPECT_CALL(*mMockDataProcessor, terminate()).Times(1);
+
+    const int monitorCountBeforeCollection = monitorCount;
+
+    ASSERT_RESULT_OK(mLooperStub->pollCache());
+
+    EXPECT_GE(monitorCount - monitorCountBeforeCollection, 2)
+            << "Periodic monitor didn't run every "
+            << kTestMinPeriodicMonitorIntervalSecs.count()
+            << " second while the collection took " << kTestSlowCollectionDurationMs.count()
+            << " milliseconds";
+
+    // Terminate here to join the monitor thread before the expectations are verified.
+    mService->terminate();
+}
+
+TEST_F(WatchdogPerfServiceTest, TestPeriodicMonitorRunsDuringSlowDataProcessorCollection) {
+    ASSERT_NO_FATAL_FAILURE(startService(sp<LooperWrapper>::make()));
+
+    mServicePeer->setPeriodicMonitorInterval(kTestMinPeriodicMonitorIntervalSecs);
+
+    ASSERT_NO_FATAL_FAILURE(startPeriodicCollection());
+
+    std::atomic<int> monitorCount = 0;
+    EXPECT_CALL(*mMockDataProcessor, onPeriodicMonitor(_, Eq(mMockProcDiskStatsCollector), _))
+            .WillRepeatedly([&](auto, auto, auto) -> Result<void> {
+                ++monitorCount;
+                return {};
+            });
+    EXPECT_CALL(*mMockUidStatsCollector, collect()).Times(1);
+    EXPECT_CALL(*mMockProcStatCollector, collect()).Times(1);
+    // Block inside the data processor rather than the collectors, so the monitor has to run while
+    // a data processor is in the middle of its collection.
+    EXPECT_CALL(*mMockDataProcessor,
+                onPeriodicCollection(_, SystemState::NORMAL_MODE, Eq(mMockUidStatsCollector),
+                                     Eq(mMockProcStatCollector), _))
+            .WillOnce([](auto, auto, auto, auto, auto) -> Result<void> {
+                std::this_thread::sleep_for(kTestSlowCollectionDurationMs);
+                return {};
+            });
+    EXPECT_CALL(*mMockDataProcessor, terminate()).Times(1);
+
+    const int monitorCountBeforeCollection = monitorCount;
+
+    ASSERT_RESULT_OK(mLooperStub->pollCache());
+
+    EXPECT_GE(monitorCount - monitorCountBeforeCollection, 2)
+            << "Periodic monitor didn't run every "
+            << kTestMinPeriodicMonitorIntervalSecs.count()
+            << " second while the data processor took " << kTestSlowCollectionDurationMs.count()
+            << " milliseconds to process the collection";
+
+    mService->terminate();
+}
+
 TEST_F(WatchdogPerfServiceTest, TestShutdownEnter) {
     ASSERT_NO_FATAL_FAILURE(startService());
 
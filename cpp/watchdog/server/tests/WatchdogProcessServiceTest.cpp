@@ -21,13 +21,16 @@
 #include "MockVhalClient.h"
 #include "MockWatchdogServiceHelper.h"
 #include "PackageInfoResolver.h"
+#include "ProcessSnapshotter.h"
 #include "WatchdogProcessService.h"
 #include "WatchdogServiceHelper.h"
 
+#include <android-base/file.h>
 #include <android/binder_interface_utils.h>
 #include <android/hidl/manager/1.0/IServiceManager.h>
 #include <android/util/ProtoOutputStream.h>
 #include <gmock/gmock.h>
+#include <utils/SystemClock.h>
 
 #include <thread>  // NOLINT(build/c++11)
 
@@ -160,6 +163,10 @@ public:
         mWatchdogProcessService->mPackageInfoResolver = packageInfoResolver;
     }
 
+    void setProcessSnapshotter(const sp<ProcessSnapshotter>& processSnapshotter) {
+        mWatchdogProcessService->mProcessSnapshotter = processSnapshotter;
+    }
+
 private:
     sp<WatchdogProcessService> mWatchdogProcessService;
 };
@@ -607,6 +614,32 @@ TEST_F(WatchdogProcessServiceTest, TestTellDumpFinished) {
     ASSERT_TRUE(status.isOk()) << status.getMessage();
 }
 
+TEST_F(WatchdogProcessServiceTest, TestTellDumpFinishedRecordsDetectionToKillTime) {
+    TemporaryDir emptyProcDir;
+    sp<ProcessSnapshotter> processSnapshotter =
+            sp<ProcessSnapshotter>::make(/*captureNativeStacks=*/false, emptyProcDir.path);
+    mWatchdogProcessServicePeer->setProcessSnapshotter(processSnapshotter);
+    const auto processIdentifier =
+            constructProcessIdentifier(/* pid= */ 1234, /* startTimeMillis= */ 0);
+    processSnapshotter->captureSnapshots({processIdentifier},
+                                         /*detectionTimeMillis=*/elapsedRealtime() - 500);
+
+    std::shared_ptr<ICarWatchdogMonitor> monitor =
+            SharedRefBase::make<ICarWatchdogMonitorDefault>();
+    expectLinkToDeath(monitor->asBinder().get(), std::move(ScopedAStatus::ok()));
+    mWatchdogProcessService->registerMonitor(monitor);
+
+    auto status = mWatchdogProcessService->tellDumpFinished(monitor, processIdentifier);
+
+    ASSERT_TRUE(status.isOk()) << status.getMessage();
+
+    const auto snapshots = processSnapshotter->getSnapshots();
+
+    ASSERT_EQ(snapshots.size(), 1u);
+    ASSERT_TRUE(snapshots[0].detectionToKillMillis.has_value());
+    EXPECT_GE(*snapshots[0].detectionToKillMillis, 500);
+}
+
 TEST_F(WatchdogProcessServiceTest, TestCacheAidlVhalPidFromCarWatchdogService) {
     sp<MockWatchdogServiceHelper> mockServiceHelper = sp<MockWatchdogServiceHelper>::make();
 
@@ -42,6 +42,7 @@ import android.automotive.watchdog.internal.GarageMode;
 import android.automotive.watchdog.internal.ICarWatchdogServiceForSystem;
 import android.automotive.watchdog.internal.PackageInfo;
 import android.automotive.watchdog.internal.PackageIoOveruseStats;
+import android.automotive.watchdog.internal.PackageMemoryOveruseStats;
 import android.automotive.watchdog.internal.PowerCycle;
 import android.automotive.watchdog.internal.ResourceStats;
 import android.automotive.watchdog.internal.StateType;
@@ -948,13 +949,28 @@ public final class CarWatchdogService extends ICarWatchdogService.Stub implement
             }
             for (int i = 0; i < resourceStats.size(); i++) {
                 ResourceStats stats = resourceStats.get(i);
-                if (stats.resourceOveruseStats == null
-                        || stats.resourceOveruseStats.packageIoOveruseStats.isEmpty()) {
-                    Slogf.w(TAG, "Received latest I/O overuse stats is empty");
+                if (stats.resourceOveruseStats == null) {
+                    Slogf.w(TAG, "Received latest resource overuse stats is empty");
                     continue;
                 }
-                service.mWatchdogPerfHandler.latestIoOveruseStats(
-                        stats.resourceOveruseStats.packageIoOveruseStats);
+                List<PackageIoOveruseStats> packageIoOveruseStats =
+                        stats.resourceOveruseStats.packageIoOveruseStats;
+                // Null when the daemon predates the memory overuse monitoring.
+                List<PackageMemoryOveruseStats> packageMemoryOveruseStats =
+                        stats.resourceOveruseStats.packageMemoryOveruseStats;
+                boolean hasMemoryOveruseStats = packageMemoryOveruseStats != null
+                        && !packageMemoryOveruseStats.isEmpty();
+                if (packageIoOveruseStats.isEmpty() && !hasMemoryOveruseStats) {
+                    Slogf.w(TAG, "Received latest resource overuse stats is empty");
+                    continue;
+                }
+                if (!packageIoOveruseStats.isEmpty()) {
+                    service.mWatchdogPerfHandler.latestIoOveruseStats(packageIoOveruseStats);
+                }
+                if (hasMemoryOveruseStats) {
+                    service.mWatchdogPerfHandler.latestMemoryOveruseStats(
+                            packageMemoryOveruseStats);
+                }
             }
         }
 
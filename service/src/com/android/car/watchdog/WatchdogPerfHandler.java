@@ -72,6 +72,7 @@ import android.automotive.watchdog.internal.ComponentType;
 import android.automotive.watchdog.internal.GarageMode;
 import android.automotive.watchdog.internal.IoUsageStats;
 import android.automotive.watchdog.internal.PackageIoOveruseStats;
+import android.automotive.watchdog.internal.PackageMemoryOveruseStats;
 import android.automotive.watchdog.internal.PackageMetadata;
 import android.automotive.watchdog.internal.PerStateIoOveruseThreshold;
 import android.automotive.watchdog.internal.ResourceSpecificConfiguration;
@@ -273,6 +274,11 @@ public final class WatchdogPerfHandler {
      */
     @GuardedBy("mLock")
     private final ArraySet<String> mActionableUserPackages = new ArraySet<>();
+    /**
+     * Generic package names, keyed by UID, that should be killed due to memory overuse.
+     */
+    @GuardedBy("mLock")
+    private final SparseArray<String> mMemoryOveruseActionablePackagesByUid = new SparseArray<>();
     /**
      * Tracks user packages disabled due to resource overuse.
      */
@@ -992,6 +998,53 @@ public final class WatchdogPerfHandler {
         }
     }
 
+    /** Processes the latest memory overuse stats */
+    public void latestMemoryOveruseStats(
+            List<PackageMemoryOveruseStats> packageMemoryOveruseStats) {
+        // Resolving the package names makes binder calls, so handle the stats on the service
+        // handler thread as done for the I/O overuse stats.
+        mServiceHandler.post(() -> latestMemoryOveruseStatsInternal(packageMemoryOveruseStats));
+    }
+
+    private void latestMemoryOveruseStatsInternal(
+            List<PackageMemoryOveruseStats> packageMemoryOveruseStats) {
+        int[] uids = new int[packageMemoryOveruseStats.size()];
+        for (int i = 0; i < packageMemoryOveruseStats.size(); ++i) {
+            uids[i] = packageMemoryOveruseStats.get(i).uid;
+        }
+        SparseArray<String> genericPackageNamesByUid = mPackageInfoHandler.getNamesForUids(uids);
+        synchronized (mLock) {
+            for (int i = 0; i < packageMemoryOveruseStats.size(); ++i) {
+                PackageMemoryOveruseStats stats = packageMemoryOveruseStats.get(i);
+                String genericPackageName = genericPackageNamesByUid.get(stats.uid);
+                if (genericPackageName == null) {
+                    continue;
+                }
+                Slogf.w(TAG, "Package '%s' overused memory for %d seconds under memory pressure. "
+                        + "Used %d KiB with threshold %d KiB", genericPackageName,
+                        TimeUnit.MILLISECONDS.toSeconds(stats.overuseDurationMillis),
+                        stats.memoryKb, stats.thresholdKb);
+                /*
+                 * The daemon reports whether the package is safe-to-kill per the memory overuse
+                 * configuration. The user choices are verified before killing the package.
+                 */
+                if (stats.killableOnOveruse) {
+                    mMemoryOveruseActionablePackagesByUid.put(stats.uid, genericPackageName);
+                }
+            }
+            if (mCurrentUxState == UX_STATE_NO_INTERACTION
+                    && mMemoryOveruseActionablePackagesByUid.size() > 0) {
+                mMainHandler.postDelayed(() -> {
+                    synchronized (mLock) {
+                        performOveruseHandlingLocked();
+                    }}, mOveruseHandlingDelayMills);
+            }
+        }
+        if (DEBUG) {
+            Slogf.d(TAG, "Processed latest memory overuse stats");
+        }
+    }
+
     /** Resets the resource overuse settings and stats for the given generic package names. */
     public void resetResourceOveruseStats(Set<String> genericPackageNames) {
         mServiceHandler.post(() -> {
@@ -1815,7 +1868,11 @@ public final class WatchdogPerfHandler {
             // to the handler should not affect the system behavior.
             mServiceHandler.post(this::notifyUserOnOveruse);
         }
-        if (mActionableUserPackages.isEmpty() || mCurrentUxState != UX_STATE_NO_INTERACTION) {
+        if (mCurrentUxState != UX_STATE_NO_INTERACTION) {
+            return;
+        }
+        killMemoryOverusingPackagesLocked();
+        if (mActionableUserPackages.isEmpty()) {
             return;
         }
         ArraySet<String> killedUserPackageKeys = new ArraySet<>();
@@ -1853,6 +1910,45 @@ public final class WatchdogPerfHandler {
         mActionableUserPackages.clear();
     }
 
+    @GuardedBy("mLock")
+    private void killMemoryOverusingPackagesLocked() {
+        for (int i = 0; i < mMemoryOveruseActionablePackagesByUid.size(); ++i) {
+            int uid = mMemoryOveruseActionablePackagesByUid.keyAt(i);
+            String genericPackageName = mMemoryOveruseActionablePackagesByUid.valueAt(i);
+            int userId = UserHandle.getUserHandleForUid(uid).getIdentifier();
+            // Either the package killable state or the resource overuse configuration could have
+            // been updated since the overuse was detected. So, verify the killable state before
+            // proceeding.
+            PackageResourceUsage usage =
+                    mUsageByUserPackage.get(getUserPackageUniqueId(userId, genericPackageName));
+            int killableState = usage != null ? usage.getKillableState()
+                    : getDefaultKillableStateLocked(genericPackageName);
+            if (killableState != KILLABLE_STATE_YES) {
+                continue;
+            }
+            List<String> packages;
+            if (genericPackageName.startsWith(SHARED_PACKAGE_PREFIX)) {
+                packages = mPackageInfoHandler.getPackagesForUid(uid, genericPackageName);
+            } else {
+                packages = Collections.singletonList(genericPackageName);
+            }
+            for (int pkgIdx = 0; pkgIdx < packages.size(); pkgIdx++) {
+                String packageName = packages.get(pkgIdx);
+                try {
+                    // Unlike I/O overuse, memory overuse ends with the processes, so the package
+                    // is stopped but not disabled.
+                    PackageManagerHelper.forceStopPackageAsUser(mContext, packageName, userId);
+                    Slogf.i(TAG, "Stopped package '%s' on user %d due to memory overuse",
+                            packageName, userId);
+                } catch (Exception e) {
+                    Slogf.e(TAG, e, "Failed to stop package '%s' on user %d", packageName,
+                            userId);
+                }
+            }
+        }
+        mMemoryOveruseActionablePackagesByUid.clear();
+    }
+
     private void notifyUserOnOveruse() {
         SparseArray<String> headsUpNotificationPackagesByNotificationId = new SparseArray<>();
         SparseArray<String> notificationCenterPackagesByNotificationId = new SparseArray<>();
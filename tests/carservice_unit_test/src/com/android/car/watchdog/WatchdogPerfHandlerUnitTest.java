@@ -84,6 +84,7 @@ import android.automotive.watchdog.internal.ComponentType;
 import android.automotive.watchdog.internal.GarageMode;
 import android.automotive.watchdog.internal.IoUsageStats;
 import android.automotive.watchdog.internal.PackageIoOveruseStats;
+import android.automotive.watchdog.internal.PackageMemoryOveruseStats;
 import android.automotive.watchdog.internal.PackageMetadata;
 import android.automotive.watchdog.internal.PerStateIoOveruseThreshold;
 import android.automotive.watchdog.internal.ResourceSpecificConfiguration;
@@ -165,6 +166,7 @@ import java.util.Locale;
 import java.util.Map;
 import java.util.Set;
 import java.util.concurrent.Executor;
+import java.util.concurrent.TimeUnit;
 
 public class WatchdogPerfHandlerUnitTest extends AbstractExtendedMockitoTestCase {
     private static final int UID_IO_USAGE_SUMMARY_TOP_COUNT = 3;
@@ -2718,6 +2720,68 @@ public class WatchdogPerfHandlerUnitTest extends AbstractExtendedMockitoTestCase
                 + "101:third_party_package.B");
     }
 
+    @Test
+    public void testStopMemoryOverusingAppDuringDisabledDisplay() throws Exception {
+        setUpSampleUserAndPackages();
+        setRequiresDistractionOptimization(false);
+        mWatchdogPerfHandler.onDisplayStateChanged(/* isEnabled= */ false);
+        doAnswer(args -> null).when(() -> PackageManagerHelper.forceStopPackageAsUser(any(),
+                anyString(), anyInt()));
+
+        pushLatestMemoryOveruseStatsAndWait(sampleMemoryOveruseStats());
+
+        verify(() -> PackageManagerHelper.forceStopPackageAsUser(any(),
+                eq("vendor_package.non_critical"), eq(100)));
+        verify(() -> PackageManagerHelper.forceStopPackageAsUser(any(),
+                eq("third_party_package.A"), eq(101)));
+        verify(() -> PackageManagerHelper.forceStopPackageAsUser(any(),
+                eq("third_party_package.B"), eq(101)));
+        verify(() -> PackageManagerHelper.forceStopPackageAsUser(any(),
+                eq("system_package.non_critical"), anyInt()), never());
+        verifyNoDisabledPackages("on memory overuse");
+    }
+
+    @Test
+    public void testStopMemoryOverusingAppAfterDisplayDisabled() throws Exception {
+        setUpSampleUserAndPackages();
+        setRequiresDistractionOptimization(false);
+        mWatchdogPerfHandler.onDisplayStateChanged(/* isEnabled= */ true);
+        doAnswer(args -> null).when(() -> PackageManagerHelper.forceStopPackageAsUser(any(),
+                anyString(), anyInt()));
+
+        pushLatestMemoryOveruseStatsAndWait(sampleMemoryOveruseStats());
+
+        verify(() -> PackageManagerHelper.forceStopPackageAsUser(any(), anyString(), anyInt()),
+                never());
+
+        mWatchdogPerfHandler.onDisplayStateChanged(/* isEnabled= */ false);
+
+        verify(() -> PackageManagerHelper.forceStopPackageAsUser(any(),
+                eq("vendor_package.non_critical"), eq(100)));
+        verify(() -> PackageManagerHelper.forceStopPackageAsUser(any(),
+                eq("third_party_package.A"), eq(101)));
+        verify(() -> PackageManagerHelper.forceStopPackageAsUser(any(),
+                eq("third_party_package.B"), eq(101)));
+    }
+
+    @Test
+    public void testNoStopMemoryOverusingAppWithUserKillableStateNo() throws Exception {
+        setUpSampleUserAndPackages();
+        setRequiresDistractionOptimization(false);
+        mWatchdogPerfHandler.setKillablePackageAsUser("vendor_package.non_critical",
+                UserHandle.of(100), /* isKillable= */ false);
+        mWatchdogPerfHandler.onDisplayStateChanged(/* isEnabled= */ false);
+        doAnswer(args -> null).when(() -> PackageManagerHelper.forceStopPackageAsUser(any(),
+                anyString(), anyInt()));
+
+        pushLatestMemoryOveruseStatsAndWait(sampleMemoryOveruseStats());
+
+        verify(() -> PackageManagerHelper.forceStopPackageAsUser(any(),
+                eq("vendor_package.non_critical"), anyInt()), never());
+        verify(() -> PackageManagerHelper.forceStopPackageAsUser(any(),
+                eq("third_party_package.A"), eq(101)));
+    }
+
     @Test
     public void testDisableRecurrentlyOverusingAppWhenDisplayDisabledAfterDateChange()
             throws Exception {
@@ -4272,6 +4336,29 @@ public class WatchdogPerfHandlerUnitTest extends AbstractExtendedMockitoTestCase
         injectPackageInfos(packageInfos);
     }
 
+    private static List<PackageMemoryOveruseStats> sampleMemoryOveruseStats() {
+        return Arrays.asList(
+                // Not safe-to-kill per the memory overuse configuration.
+                constructPackageMemoryOveruseStats(/* uid= */ 10010002,
+                        /* killableOnOveruse= */ false),
+                constructPackageMemoryOveruseStats(/* uid= */ 10010004,
+                        /* killableOnOveruse= */ true),
+                constructPackageMemoryOveruseStats(/* uid= */ 10110005,
+                        /* killableOnOveruse= */ true));
+    }
+
+    private static PackageMemoryOveruseStats constructPackageMemoryOveruseStats(int uid,
+            boolean killableOnOveruse) {
+        PackageMemoryOveruseStats stats = new PackageMemoryOveruseStats();
+        stats.uid = uid;
+        stats.memoryKb = 400_000;
+        stats.thresholdKb = 300_000;
+        stats.overuseDurationMillis = TimeUnit.MINUTES.toMillis(5);
+        stats.totalOveruses = 1;
+        stats.killableOnOveruse = killableOnOveruse;
+        return stats;
+    }
+
     private static List<AtomsProto.CarWatchdogIoOveruseStatsReported> sampleReportedOveruseStats() {
         // The below thresholds are from {@link sampleInternalResourceOveruseConfiguration} and
         // UID/stat are from {@link sampleIoOveruseStats}.
@@ -5053,6 +5140,18 @@ public class WatchdogPerfHandlerUnitTest extends AbstractExtendedMockitoTestCase
         }
     }
 
+    private void pushLatestMemoryOveruseStatsAndWait(
+            List<PackageMemoryOveruseStats> packageMemoryOveruseStats) throws Exception {
+        mWatchdogPerfHandler.latestMemoryOveruseStats(packageMemoryOveruseStats);
+
+        // Handling latest memory overuse stats is done on the CarWatchdogService service handler
+        // thread and the overuse handling is posted to the main thread with
+        // OVERUSE_HANDLING_DELAY_MILLS delay. Wait until both are processed before returning.
+        CarServiceUtils.runEmptyRunnableOnLooperSync(CAR_WATCHDOG_SERVICE_NAME);
+        CarServiceUtils.runOnMainSyncDelayed(() -> {
+        }, OVERUSE_HANDLING_DELAY_MILLS * 2);
+    }
+
     private static final class UserNotificationReflectionCall {
         public final UserHandle userHandle;
         public final SparseArray<String> packagesById;